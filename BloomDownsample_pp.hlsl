@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------------------------
+// Bloom Downsample Post-Processing Pixel Shader
+//--------------------------------------------------------------------------------------
+// Halves the size of a level of the bloom pyramid to make the next level down
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures (texture maps)
+//--------------------------------------------------------------------------------------
+
+// The level being read from, which is a different size to the render target
+Texture2D SceneTexture : register(t0);
+SamplerState BilinearSample : register(s1); // Bilinear filtering with clamp addressing - each sample averages four texels
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+float4 main(PostProcessingInput input) : SV_Target
+{
+    return float4(BloomDownsample13(SceneTexture, BilinearSample, input.sceneUV, false), 1.0f);
+}
@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------------------------
+// Bloom Prefilter Post-Processing Pixel Shader
+//--------------------------------------------------------------------------------------
+// Takes the bright areas of the scene (as Brightness_pp) and halves their size - the first level of the bloom pyramid
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures (texture maps)
+//--------------------------------------------------------------------------------------
+
+// The scene, which is twice the size of the render target
+Texture2D SceneTexture : register(t0);
+SamplerState BilinearSample : register(s1); // Bilinear filtering with clamp addressing - each sample averages four texels
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+float4 main(PostProcessingInput input) : SV_Target
+{
+    return float4(BloomDownsample13(SceneTexture, BilinearSample, input.sceneUV, true), 1.0f);
+}
@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Bloom Upsample Post-Processing Pixel Shader
+//--------------------------------------------------------------------------------------
+// Doubles the size of a level of the bloom pyramid. Used with additive blending to add each level to the one above it.
+// The result is scaled by gBloomLevelScale, which is 1 except on the final pass into the full size bloom texture
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures (texture maps)
+//--------------------------------------------------------------------------------------
+
+// The level being read from, which is a different size to the render target
+Texture2D SceneTexture : register(t0);
+SamplerState BilinearSample : register(s1); // Bilinear filtering with clamp addressing - each sample averages four texels
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+float4 main(PostProcessingInput input) : SV_Target
+{
+    return float4(BloomUpsampleTent(SceneTexture, BilinearSample, input.sceneUV) * gBloomLevelScale, 1.0f);
+}
@@ -20,12 +20,6 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 // Post-processing shader that tints the scene texture to a given colour
 float4 main(PostProcessingInput input) : SV_Target
 {
-    float3 colour = SceneTexture.Sample(PointSample, input.sceneUV).rgb;
-    
-    if (RGBToBrightness(colour) > gBloomThreshold)
-    {
-        return float4(colour, 1.0f);
-    }
-    
-    return 0.0f;
+    // Sample a pixel from the scene texture and keep it if it is bright enough (see BrightnessColour in Common.hlsli)
+    return BrightnessColour(SceneTexture.Sample(PointSample, input.sceneUV), input);
 }
\ No newline at end of file
@@ -20,6 +20,18 @@ Texture2D    BurnMap      : register(t1);
 SamplerState TrilinearWrap : register(s1);
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match SingleValueBlock in PostProcessConstantBlocks.cpp
+cbuffer BurnConstants : register(b2)
+{
+	float  gBurnHeight;
+	float3 paddingBurn;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
@@ -14,6 +14,18 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
                                           // post-processing so this sampler will use "point sampling" - no filtering
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match ChromaticAberrationBlock in PostProcessConstantBlocks.cpp
+cbuffer ChromaticAberrationConstants : register(b2)
+{
+	float3 gColourOffset;
+	float  paddingChromaticAberration;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
@@ -7,9 +7,11 @@
 #include "CVector2.h"
 #include "CVector3.h"
 #include "CMatrix4x4.h"
+#include "PostProcessingConstants.h"
 
 #include <d3d11.h>
 #include <string>
+#include <cstddef>
 
 
 //--------------------------------------------------------------------------------------
@@ -100,6 +102,13 @@ struct PerModelConstants
 
 	CMatrix4x4 boneMatrices[MAX_BONES];
 };
+
+// The shader's cbuffer packs these with no padding, so the matrix classes must stay 16 plain floats
+static_assert(sizeof(CMatrix4x4) == 64 && sizeof(CMatrix4x4A) == 64, "Matrices must be 16 floats to match the shaders");
+static_assert(offsetof(PerModelConstants, objectColour)  == 64 &&
+              offsetof(PerModelConstants, explodeAmount) == 76 &&
+              offsetof(PerModelConstants, boneMatrices)  == 80 &&
+              sizeof(PerModelConstants) == 80 + 64 * MAX_BONES, "PerModelConstants must match the shaders");
 extern PerModelConstants gPerModelConstants;      // This variable holds the CPU-side constant buffer described above
 extern ID3D11Buffer*     gPerModelConstantBuffer; // This variable controls the GPU-side constant buffer related to the above structure
 
@@ -108,113 +117,9 @@ extern ID3D11Buffer*     gPerModelConstantBuffer; // This variable controls the
 
 //**************************
 
-// Settings used by post-processes - must match the similar structure in the Common.hlsli shader file
-struct PostProcessingConstants
-{
-	CVector2 area2DTopLeft; // Top-left of post-process area on screen, provided as coordinate from 0.0->1.0 not as a pixel coordinate
-	CVector2 area2DSize;    // Size of post-process area on screen, provided as sizes from 0.0->1.0 (1 = full screen) not as a size in pixels
-	float    area2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
-	CVector3 paddingA;      // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
-
-	CVector4 polygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
-
-	// Tint post-process settings
-	CVector3 tintColour;
-	
-    // Copy post-process setting (alpha setting for motion blur)
-    float    copyAlpha;
-
-	// Grey noise post-process settings
-    CVector2 noiseScale;
-	CVector2 noiseOffset;
-
-	// Burn post-process settings
-	float    burnHeight;
-	CVector3 paddingC;
-
-	// Distort post-process settings
-	float    distortLevel;
-	CVector3 paddingD;
-
-	// Spiral post-process settings
-	float    spiralLevel;
-	CVector3 paddingE;
-
-	// Heat haze post-process settings
-	float    heatHazeTimer;
-	CVector3 paddingF;
-
-    // Gradient and hue shift post-process settings
-    CVector2 gradientHue;
-    float    hueShift;
-    float    paddingG;
-
-    // Blur post-process settings
-    CVector2 blurSize;
-    float    standardDeviationSquared;
-    float    paddingH;
-
-    // Underwater post-process settings
-    float    underwaterHue;
-    CVector2 underwaterBrightness;
-
-    float    wobbleStrength;
-    float    wobbleTimer;
-    float    paddingI;
-
-    // Retro post-process settings
-    CVector2 pixelNumber;
-    float    pixelBrightnessHueShift;
-
-    float    pixelBrightnessLevels;
-    float    pixelSaturationMin;
-    float    pixelSaturationLevels;
-
-    CVector2 pixelHueRange;
-    float    pixelHueLevels;
-
-    // Bloom post-process settings
-    float    bloomThreshold;
-    float    bloomIntensity;
-    float    paddingJ;
-
-    // Directional blur post-process settings
-    float    directionalBlurSize;
-    float    directionalBlurX;
-    float    directionalBlurY;
-
-    float    directionalBlurIntensity;
-    CVector2 paggingK;
-
-    // Chromatic aberration post-process settings
-    CVector3 colourOffset;
-
-    // Outline post-process settings
-    float    outlineThreshold;
-    float    outlineThickness;
-    float    paddingL;
-
-    // Dilation post-process settings
-    CVector2 dilationSize;
-    float    dilationType;
-
-    CVector2 dilationThreshold;
-    float    paddingM;
-
-    // Depth of field post-process settings
-    float    focalPlane;
-    float    nearPlane;
-    float    farPlane;
-
-    float    focusedObject;
-    CVector2 paddingN;
-
-    // Frosted glass post-process settings
-    float    frostedGlassFrequency;
-    CVector2 frostedGlassoffsetSize;
-};
-extern PostProcessingConstants gPostProcessingConstants;      // This variable holds the CPU-side constant buffer described above
-extern ID3D11Buffer*           gPostProcessingConstantBuffer; // This variable controls the GPU-side constant buffer related to the above structure
+// Settings used by post-processes - see PostProcessingConstants.h. They are sent to the GPU split into an area block and a
+// block for each effect, each only when it changes (see PostProcessConstantBlocks.h and the cbuffers in Common.hlsli)
+extern PostProcessingConstants gPostProcessingConstants; // This variable holds the CPU-side settings described above
 
 //**************************
 
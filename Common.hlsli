@@ -20,6 +20,20 @@ struct BasicVertex
     float2 uv       : uv;
 };
 
+// Vertex data for instanced models (see InstanceBatcher.h) - as above plus the world matrix of the instance, which is
+// read a row at a time from the instance buffer rather than from the per-model constants
+struct InstancedVertex
+{
+    float3 position : position;
+    float3 normal   : normal;
+    float2 uv       : uv;
+
+    float4 worldRow0 : instanceWorld0;
+    float4 worldRow1 : instanceWorld1;
+    float4 worldRow2 : instanceWorld2;
+    float4 worldRow3 : instanceWorld3;
+};
+
 
 
 // This structure describes what data the lighting pixel shader receives from the vertex shader.
@@ -127,112 +141,80 @@ cbuffer PerModelConstants : register(b1) // The b1 gives this constant buffer th
 
 //**************************
 
-// This is where we receive post-processing settings from the C++ side
-// These variables must match exactly the gPostProcessingConstants structure in Scene.cpp
+// This is where we receive post-processing settings from the C++ side. They are split into blocks (see
+// PostProcessConstantBlocks.h) so a pass is only sent the area and the settings of its own effect, and each block is only
+// sent again when it changes. Each cbuffer must match exactly its structure in PostProcessConstantBlocks.cpp
+// The blocks read by the functions below are declared here, each with its own register so a fused shader can read
+// several. The other effects declare their block in their own _pp.hlsl file at register b2
+
+// Area of the screen being processed, read by the vertex shaders
 // Note that this buffer reuses the same index (register) as the per-model buffer above since they won't be used together
-cbuffer PostProcessingConstants : register(b1) 
+cbuffer PostProcessAreaConstants : register(b1)
 {
 	float2 gArea2DTopLeft; // Top-left of post-process area on screen, provided as coordinate from 0.0->1.0 not as a pixel coordinate
 	float2 gArea2DSize;    // Size of post-process area on screen, provided as sizes from 0.0->1.0 (1 = full screen) not as a size in pixels
 	float  gArea2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
 	float3 paddingA;       // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
 
-  	float4 gPolygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+	float4 gPolygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+}
 
-	// Tint post-process settings
+// Tint post-process settings
+cbuffer TintConstants : register(b3)
+{
 	float3 gTintColour;
-    
-	// Copy post-process setting (alpha setting for motion blur)
-    float  gCopyAlpha;
+	float  paddingTint;
+}
 
-	// Grey noise post-process settings
-    float2 gNoiseScale;
-	float2 gNoiseOffset;
+// Gradient post-process settings
+cbuffer GradientConstants : register(b4)
+{
+	float2 gGradientHue;
+	float2 paddingGradient;
+}
 
-	// Burn post-process settings
-	float  gBurnHeight;
-	float3 paddingC;
+// Bloom settings, used by Brightness, Bloom and the bloom pyramid
+cbuffer BloomConstants : register(b5)
+{
+	float gBloomThreshold;
+	float gBloomIntensity;
+	float gBloomLevelScale; // Scale applied by BloomUpsample, used to bring the sum of the pyramid levels back to the range of one level
+	float paddingBloom;
+}
 
-	// Distort post-process settings
-	float  gDistortLevel;
-	float3 paddingD;
+// Blur post-process settings
+cbuffer BlurConstants : register(b6)
+{
+	float2 gBlurSize;
+	float  gStandardDeviationSquared;
+	float  paddingBlur;
+}
 
-	// Spiral post-process settings
-	float  gSpiralLevel;
-	float3 paddingE;
+// Dilation settings, used by Dilation and DepthOfField
+cbuffer DilationConstants : register(b7)
+{
+	float2 gDilationSize;
+	float  gDilationType;
+	float  paddingDilation1;
 
-	// Heat haze post-process settings
-	float  gHeatHazeTimer;
-	float3 paddingF;
-    
-    // Gradient and hue shift post-process settings
-    float2 gGradientHue;
-    float  gHueShift;
-    float  paddingG;
-    
-    // Blur post-process settings
-    float2 gBlurSize;
-    float  gStandardDeviationSquared;
-    float  paddingH;
-    
-    // Underwater post-process settings
-    float  gUnderwaterHue;
-    float2 gUnderwaterBrightness;
-    
-    float  gWobbleStrength;
-    float  gWobbleTimer;
-    float  paddingI;
-    
-    // Retro post-process settings
-    float2 gPixelNumber;
-    float  gPixelBrightnessHueShift;
-    
-    float  gPixelBrightnessLevels;
-    float  gPixelSaturationMin;
-    float  gPixelSaturationLevels;
-    
-    float2 gPixelHueRange;
-    float  gPixelHueLevels;
-    
-    // Bloom post-process settings
-    float  gBloomThreshold;
-    float  gBloomIntensity;
-    float  paddingJ;
-    
-	// Directional blur post-process settings
-    float  gDirectionalBlurSize;
-    float  gDirectionalBlurX;
-    float  gDirectionalBlurY;
-    
-    float  gDirectionalBlurIntensity;
-    float2 paggingK;
-    
-    // Chromatic aberration post-process settings
-    float3 gColourOffset;
-    
-    // Outline post-process settings
-    float  gOutlineThreshold;
-    float  gOutlineThickness;
-    float  paddingL;
-    
-    // Dilation post-process settings
-    float2 gDilationSize;
-    float  gDilationType;
-    
-    float2 gDilationThreshold;
-    float  paddingM;
-    
-    // Depth of field post-process settings
-    float  gFocalPlane;
-    float  gNearPlane;
-    float  gFarPlane;
-    
-    float  gFocusedObject;
-    float2 paddingN;
-    
-    // Frosted glass post-process settings
-    float  gFrostedGlassFrequency;
-    float2 gFrostedGlassoffsetSize;
+	float2 gDilationThreshold;
+	float2 paddingDilation2;
+}
+
+// Depth of field focal planes
+cbuffer DepthOfFieldConstants : register(b8)
+{
+	float gFocalPlane;
+	float gNearPlane;
+	float gFarPlane;
+	float gFocusedObject;
+}
+
+// Hue shift post-process settings
+cbuffer HueShiftConstants : register(b9)
+{
+	float  gHueShift;
+	float3 paddingHueShift;
 }
 
 
@@ -389,4 +371,111 @@ float3 HSLtoRGB(in float3 HSL)
     return (RGB - 0.5) * c + HSL.z;
 }
 
+
+// Bloom pyramid filters, used by the BloomPrefilter, BloomDownsample and BloomUpsample shaders. The texture must be read
+// with a bilinear sampler so each sample is the average of four texels
+
+// Colour if it is brighter than the bloom threshold, otherwise black (as Brightness_pp)
+float3 BloomThreshold(float3 colour)
+{
+    return RGBToBrightness(colour) > gBloomThreshold ? colour : 0.0f;
+}
+
+// Halve the size of a texture with 13 bilinear samples around uv, the centre of the output pixel. Five overlapping 4x4
+// texel boxes are averaged, the centre box with half the weight, which avoids the flickering of a plain 2x2 average
+// (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare"). With threshold set each sample is
+// passed through BloomThreshold first
+float3 BloomDownsample13(Texture2D source, SamplerState bilinear, float2 uv, bool threshold)
+{
+    float width, height;
+    source.GetDimensions(width, height);
+    float2 texel = float2(1.0f / width, 1.0f / height);
+
+    // Samples a-m, laid out as:  a . b . c
+    //                            . d . e .
+    //                            f . g . h
+    //                            . i . j .
+    //                            k . l . m
+    float3 a = source.Sample(bilinear, uv + texel * float2(-2, -2)).rgb;
+    float3 b = source.Sample(bilinear, uv + texel * float2( 0, -2)).rgb;
+    float3 c = source.Sample(bilinear, uv + texel * float2( 2, -2)).rgb;
+    float3 d = source.Sample(bilinear, uv + texel * float2(-1, -1)).rgb;
+    float3 e = source.Sample(bilinear, uv + texel * float2( 1, -1)).rgb;
+    float3 f = source.Sample(bilinear, uv + texel * float2(-2,  0)).rgb;
+    float3 g = source.Sample(bilinear, uv                          ).rgb;
+    float3 h = source.Sample(bilinear, uv + texel * float2( 2,  0)).rgb;
+    float3 i = source.Sample(bilinear, uv + texel * float2(-1,  1)).rgb;
+    float3 j = source.Sample(bilinear, uv + texel * float2( 1,  1)).rgb;
+    float3 k = source.Sample(bilinear, uv + texel * float2(-2,  2)).rgb;
+    float3 l = source.Sample(bilinear, uv + texel * float2( 0,  2)).rgb;
+    float3 m = source.Sample(bilinear, uv + texel * float2( 2,  2)).rgb;
+
+    if (threshold)
+    {
+        a = BloomThreshold(a);  b = BloomThreshold(b);  c = BloomThreshold(c);
+        d = BloomThreshold(d);  e = BloomThreshold(e);
+        f = BloomThreshold(f);  g = BloomThreshold(g);  h = BloomThreshold(h);
+        i = BloomThreshold(i);  j = BloomThreshold(j);
+        k = BloomThreshold(k);  l = BloomThreshold(l);  m = BloomThreshold(m);
+    }
+
+    return (d + e + i + j) * 0.125f + g * 0.125f + (b + f + h + l) * 0.0625f + (a + c + k + m) * 0.03125f;
+}
+
+// Double the size of a texture with a 3x3 tent filter of bilinear samples one texel apart around uv
+float3 BloomUpsampleTent(Texture2D source, SamplerState bilinear, float2 uv)
+{
+    float width, height;
+    source.GetDimensions(width, height);
+    float2 texel = float2(1.0f / width, 1.0f / height);
+
+    float3 colour = source.Sample(bilinear, uv).rgb * 4.0f;
+    colour += (source.Sample(bilinear, uv + texel * float2( 0, -1)).rgb + source.Sample(bilinear, uv + texel * float2(-1, 0)).rgb +
+               source.Sample(bilinear, uv + texel * float2( 1,  0)).rgb + source.Sample(bilinear, uv + texel * float2( 0, 1)).rgb) * 2.0f;
+    colour +=  source.Sample(bilinear, uv + texel * float2(-1, -1)).rgb + source.Sample(bilinear, uv + texel * float2( 1, -1)).rgb +
+               source.Sample(bilinear, uv + texel * float2(-1,  1)).rgb + source.Sample(bilinear, uv + texel * float2( 1,  1)).rgb;
+    return colour / 16.0f;
+}
+
+
+// Point post-processes - the colour a post-process gives a pixel from the scene colour at that pixel. Used by the Tint,
+// Gradient, HueShift and Brightness shaders, and one after another by fused shaders (see PostProcessFusion.h)
+
+float4 TintColour(float4 colour, PostProcessingInput input)
+{
+    // Multiply the scene colour with the tint colour, set alpha to 1 for final output
+    return float4(colour.rgb * gTintColour, 1.0f);
+}
+
+float4 GradientColour(float4 colour, PostProcessingInput input)
+{
+    float hue = lerp(gGradientHue.r, gGradientHue.g, input.sceneUV.y);
+
+    // Change the hue of the pixel and increase its saturation
+    float3 hsl = RGBtoHSL(colour.rgb);
+    hsl.r = hue;
+    hsl.g = clamp(hsl.g + 0.2, 0.0, 1.0f);
+
+    return float4(HSLtoRGB(hsl), GetAreaAlpha(input.areaUV));
+}
+
+float4 HueShiftColour(float4 colour, PostProcessingInput input)
+{
+    // Change the hue of the pixel
+    float3 hsl = RGBtoHSL(colour.rgb);
+    hsl.r += gHueShift;
+    while (hsl.r > 1.0f)
+    {
+        hsl.r -= 1.0f;
+    }
+
+    return float4(HSLtoRGB(hsl), GetAreaAlpha(input.areaUV));
+}
+
+float4 BrightnessColour(float4 colour, PostProcessingInput input)
+{
+    // Keep only the colours brighter than the bloom threshold
+    return RGBToBrightness(colour.rgb) > gBloomThreshold ? float4(colour.rgb, 1.0f) : 0.0f;
+}
+
 //**************************
\ No newline at end of file
@@ -16,6 +16,18 @@ SamplerState PointSample  : register(s0); // We don't usually want to filter (bi
                                           // post-processing so this sampler will use "point sampling" - no filtering
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match CopyBlock in PostProcessConstantBlocks.cpp
+cbuffer CopyConstants : register(b2)
+{
+	float  gCopyAlpha; // Alpha setting for motion blur
+	float3 paddingCopy;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
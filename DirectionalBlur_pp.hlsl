@@ -14,6 +14,20 @@
 Texture2D SceneTexture : register(t0);
 SamplerState PointSample : register(s0); // We don't usually want to filter (bilinear, trilinear etc.) the scene texture when
                                           // post-processing so this sampler will use "point sampling" - no filtering
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match DirectionalBlurBlock in PostProcessConstantBlocks.cpp
+cbuffer DirectionalBlurConstants : register(b2)
+{
+	float gDirectionalBlurSize;
+	float gDirectionalBlurX;
+	float gDirectionalBlurY;
+	float gDirectionalBlurIntensity;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
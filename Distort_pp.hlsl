@@ -21,6 +21,18 @@ SamplerState TrilinearWrap : register(s1);
 
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match SingleValueBlock in PostProcessConstantBlocks.cpp
+cbuffer DistortConstants : register(b2)
+{
+	float  gDistortLevel;
+	float3 paddingDistort;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
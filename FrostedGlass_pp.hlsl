@@ -16,6 +16,19 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 Texture2D NoiseMap : register(t1);
 SamplerState TrilinearWrap : register(s1);
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match FrostedGlassBlock in PostProcessConstantBlocks.cpp
+cbuffer FrostedGlassConstants : register(b2)
+{
+	float  gFrostedGlassFrequency;
+	float2 gFrostedGlassoffsetSize;
+	float  paddingFrostedGlass;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
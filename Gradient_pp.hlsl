@@ -22,20 +22,6 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 // Post-processing shader that tints the scene texture to a given colour
 float4 main(PostProcessingInput input) : SV_Target
 {
-    float hue = lerp(gGradientHue.r, gGradientHue.g, input.sceneUV.y);
-
-	// Sample a pixel from the scene texture.
-    float3 colour = SceneTexture.Sample(PointSample, input.sceneUV).rgb;
-    
-    // Convert the colour of the pixel to HSL.
-    colour = RGBtoHSL(colour);
-    
-    // Change the hue of the pixel and increase its saturation.
-    colour.r = hue;
-    colour.g = clamp(colour.g + 0.2, 0.0, 1.0f);
-    
-    // Convert back to RGB.
-    colour = HSLtoRGB(colour);
-    
-    return float4(colour, GetAreaAlpha(input.areaUV));
+    // Sample a pixel from the scene texture and set its hue from the gradient (see GradientColour in Common.hlsli)
+    return GradientColour(SceneTexture.Sample(PointSample, input.sceneUV), input);
 }
\ No newline at end of file
@@ -20,6 +20,18 @@ Texture2D    NoiseMap      : register(t1);
 SamplerState TrilinearWrap : register(s1);
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match GreyNoiseBlock in PostProcessConstantBlocks.cpp
+cbuffer GreyNoiseConstants : register(b2)
+{
+	float2 gNoiseScale;
+	float2 gNoiseOffset;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
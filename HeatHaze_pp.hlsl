@@ -16,6 +16,18 @@ SamplerState PointSample  : register(s0); // We don't usually want to filter (bi
                                           // post-processing so this sampler will use "point sampling" - no filtering
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match SingleValueBlock in PostProcessConstantBlocks.cpp
+cbuffer HeatHazeConstants : register(b2)
+{
+	float  gHeatHazeTimer;
+	float3 paddingHeatHaze;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
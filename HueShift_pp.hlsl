@@ -22,21 +22,6 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 // Post-processing shader that tints the scene texture to a given colour
 float4 main(PostProcessingInput input) : SV_Target
 {
-	// Sample a pixel from the scene texture.
-    float3 colour = SceneTexture.Sample(PointSample, input.sceneUV).rgb;
-    
-    // Convert the colour of the pixel to HSL.
-    colour = RGBtoHSL(colour);
-    
-    // Change the hue of the pixel
-    colour.r += gHueShift;
-    while (colour.r > 1.0f)
-    {
-        colour.r -= 1.0f;
-    }
-    
-    // Convert back to RGB.
-    colour = HSLtoRGB(colour);
-    
-    return float4(colour, GetAreaAlpha(input.areaUV));
+    // Sample a pixel from the scene texture and shift its hue (see HueShiftColour in Common.hlsli)
+    return HueShiftColour(SceneTexture.Sample(PointSample, input.sceneUV), input);
 }
\ No newline at end of file
@@ -3,8 +3,12 @@
 //--------------------------------------------------------------------------------------
 
 #include "CMatrix4x4.h"
+#include "Float4.h"
 
 #include <algorithm>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
 /*-----------------------------------------------------------------------------------------
     Member functions
@@ -32,47 +36,7 @@ CVector3 CMatrix4x4::GetRow(int iRow) const
 // Post-multiply this matrix by the given one
 CMatrix4x4& CMatrix4x4::operator*=(const CMatrix4x4& m)
 {
-    if (this == &m)
-    {
-        // Special case of multiplying by self - no copy optimisations so use binary version
-        *this = m * m;
-    }
-    else
-    {
-        float t0, t1, t2;
-
-        t0 = e00 * m.e00 + e01 * m.e10 + e02 * m.e20 + e03 * m.e30;
-        t1 = e00 * m.e01 + e01 * m.e11 + e02 * m.e21 + e03 * m.e31;
-        t2 = e00 * m.e02 + e01 * m.e12 + e02 * m.e22 + e03 * m.e32;
-        e03 = e00 * m.e03 + e01 * m.e13 + e02 * m.e23 + e03 * m.e33;
-        e00 = t0;
-        e01 = t1;
-        e02 = t2;
-
-        t0 = e10 * m.e00 + e11 * m.e10 + e12 * m.e20 + e13 * m.e30;
-        t1 = e10 * m.e01 + e11 * m.e11 + e12 * m.e21 + e13 * m.e31;
-        t2 = e10 * m.e02 + e11 * m.e12 + e12 * m.e22 + e13 * m.e32;
-        e13 = e10 * m.e03 + e11 * m.e13 + e12 * m.e23 + e13 * m.e33;
-        e10 = t0;
-        e11 = t1;
-        e12 = t2;
-
-        t0 = e20 * m.e00 + e21 * m.e10 + e22 * m.e20 + e23 * m.e30;
-        t1 = e20 * m.e01 + e21 * m.e11 + e22 * m.e21 + e23 * m.e31;
-        t2 = e20 * m.e02 + e21 * m.e12 + e22 * m.e22 + e23 * m.e32;
-        e23 = e20 * m.e03 + e21 * m.e13 + e22 * m.e23 + e23 * m.e33;
-        e20 = t0;
-        e21 = t1;
-        e22 = t2;
-
-        t0 = e30 * m.e00 + e31 * m.e10 + e32 * m.e20 + e33 * m.e30;
-        t1 = e30 * m.e01 + e31 * m.e11 + e32 * m.e21 + e33 * m.e31;
-        t2 = e30 * m.e02 + e31 * m.e12 + e32 * m.e22 + e33 * m.e32;
-        e33 = e30 * m.e03 + e31 * m.e13 + e32 * m.e23 + e33 * m.e33;
-        e30 = t0;
-        e31 = t1;
-        e32 = t2;
-    }
+    *this = *this * m;
     return *this;
 }
 
@@ -80,14 +44,72 @@ CMatrix4x4& CMatrix4x4::operator*=(const CMatrix4x4& m)
 // Return the given CVector4 transformed by this matrix
 CVector4 CMatrix4x4::operator*=(const CVector4& v)
 {
-    CVector4 vOut;
+    return v * *this;
+}
 
-	vOut.x = v.x * e00 + v.y * e10 + v.z * e20 + v.w * e30;
-	vOut.y = v.x * e01 + v.y * e11 + v.z * e21 + v.w * e31;
-	vOut.z = v.x * e02 + v.y * e12 + v.z * e22 + v.w * e32;
-	vOut.w = v.x * e03 + v.y * e13 + v.z * e23 + v.w * e33;
 
-	return vOut;
+/*-----------------------------------------------------------------------------------------
+    Row helpers
+-----------------------------------------------------------------------------------------*/
+
+// Load four floats, aligned or not
+template <bool Aligned>
+static Float4 LoadRow(const float* p)
+{
+    return Aligned ? Float4::LoadAligned(p) : Float4::Load(p);
+}
+
+// Store four floats, aligned or not
+template <bool Aligned>
+static void StoreRow(Float4 row, float* p)
+{
+    if (Aligned)  row.StoreAligned(p);
+    else          row.Store(p);
+}
+
+// The 16 floats of m1 * m2 into out. Aligned loads and stores need all three on a 16-byte boundary
+template <bool Aligned>
+static void MultiplyMatrices(const float* m1, const float* m2, float* out)
+{
+#if defined(__AVX__)
+    // Two rows of m1 at once, each half of a 256-bit value working as MultiplyRow does
+    const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m2));
+    const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m2 + 4));
+    const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m2 + 8));
+    const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m2 + 12));
+    for (int i = 0; i < 16; i += 8)
+    {
+        const __m256 a = _mm256_loadu_ps(m1 + i);
+        __m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+        r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+        _mm256_storeu_ps(out + i, r);
+    }
+#else
+    const Float4 b0 = LoadRow<Aligned>(m2);
+    const Float4 b1 = LoadRow<Aligned>(m2 + 4);
+    const Float4 b2 = LoadRow<Aligned>(m2 + 8);
+    const Float4 b3 = LoadRow<Aligned>(m2 + 12);
+    for (int i = 0; i < 16; i += 4)
+    {
+        StoreRow<Aligned>(MultiplyRow(LoadRow<Aligned>(m1 + i), b0, b1, b2, b3), out + i);
+    }
+#endif
+}
+
+// Vector v multiplied by the matrix m into out, each four floats
+template <bool Aligned>
+static void TransformVector(const float* v, const float* m, float* out)
+{
+    StoreRow<Aligned>(MultiplyRow(LoadRow<Aligned>(v), LoadRow<Aligned>(m), LoadRow<Aligned>(m + 4),
+                                  LoadRow<Aligned>(m + 8), LoadRow<Aligned>(m + 12)), out);
+}
+
+// Cross product of the x, y and z of two rows. w is not meaningful
+static Float4 CrossRows(Float4 a, Float4 b)
+{
+    return Shuffle<1, 2, 0, 3>(a, a) * Shuffle<2, 0, 1, 3>(b, b) - Shuffle<2, 0, 1, 3>(a, a) * Shuffle<1, 2, 0, 3>(b, b);
 }
 
 
@@ -99,27 +121,7 @@ CVector4 CMatrix4x4::operator*=(const CVector4& v)
 CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2)
 {
     CMatrix4x4 mOut;
-
-    mOut.e00 = m1.e00*m2.e00 + m1.e01*m2.e10 + m1.e02*m2.e20 + m1.e03*m2.e30;
-    mOut.e01 = m1.e00*m2.e01 + m1.e01*m2.e11 + m1.e02*m2.e21 + m1.e03*m2.e31;
-    mOut.e02 = m1.e00*m2.e02 + m1.e01*m2.e12 + m1.e02*m2.e22 + m1.e03*m2.e32;
-    mOut.e03 = m1.e00*m2.e03 + m1.e01*m2.e13 + m1.e02*m2.e23 + m1.e03*m2.e33;
-
-    mOut.e10 = m1.e10*m2.e00 + m1.e11*m2.e10 + m1.e12*m2.e20 + m1.e13*m2.e30;
-    mOut.e11 = m1.e10*m2.e01 + m1.e11*m2.e11 + m1.e12*m2.e21 + m1.e13*m2.e31;
-    mOut.e12 = m1.e10*m2.e02 + m1.e11*m2.e12 + m1.e12*m2.e22 + m1.e13*m2.e32;
-    mOut.e13 = m1.e10*m2.e03 + m1.e11*m2.e13 + m1.e12*m2.e23 + m1.e13*m2.e33;
-
-    mOut.e20 = m1.e20*m2.e00 + m1.e21*m2.e10 + m1.e22*m2.e20 + m1.e23*m2.e30;
-    mOut.e21 = m1.e20*m2.e01 + m1.e21*m2.e11 + m1.e22*m2.e21 + m1.e23*m2.e31;
-    mOut.e22 = m1.e20*m2.e02 + m1.e21*m2.e12 + m1.e22*m2.e22 + m1.e23*m2.e32;
-    mOut.e23 = m1.e20*m2.e03 + m1.e21*m2.e13 + m1.e22*m2.e23 + m1.e23*m2.e33;
-
-    mOut.e30 = m1.e30*m2.e00 + m1.e31*m2.e10 + m1.e32*m2.e20 + m1.e33*m2.e30;
-    mOut.e31 = m1.e30*m2.e01 + m1.e31*m2.e11 + m1.e32*m2.e21 + m1.e33*m2.e31;
-    mOut.e32 = m1.e30*m2.e02 + m1.e31*m2.e12 + m1.e32*m2.e22 + m1.e33*m2.e32;
-    mOut.e33 = m1.e30*m2.e03 + m1.e31*m2.e13 + m1.e32*m2.e23 + m1.e33*m2.e33;
-
+    MultiplyMatrices<false>(&m1.e00, &m2.e00, &mOut.e00);
     return mOut;
 }
 
@@ -127,13 +129,29 @@ CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2)
 CVector4 operator*(const CVector4& v, const CMatrix4x4& m)
 {
     CVector4 vOut;
+    TransformVector<false>(&v.x, &m.e00, &vOut.x);
+    return vOut;
+}
 
-	vOut.x = v.x * m.e00 + v.y * m.e10 + v.z * m.e20 + v.w * m.e30;
-	vOut.y = v.x * m.e01 + v.y * m.e11 + v.z * m.e21 + v.w * m.e31;
-	vOut.z = v.x * m.e02 + v.y * m.e12 + v.z * m.e22 + v.w * m.e32;
-	vOut.w = v.x * m.e03 + v.y * m.e13 + v.z * m.e23 + v.w * m.e33;
 
-	return vOut;
+/*-----------------------------------------------------------------------------------------
+    Aligned matrix
+-----------------------------------------------------------------------------------------*/
+
+// Matrix-matrix multiplication of aligned matrices
+CMatrix4x4A operator*(const CMatrix4x4A& m1, const CMatrix4x4A& m2)
+{
+    CMatrix4x4A mOut;
+    MultiplyMatrices<true>(&m1.e00, &m2.e00, &mOut.e00);
+    return mOut;
+}
+
+// Return the given aligned CVector4 transformed by the given aligned matrix
+CVector4A operator*(const CVector4A& v, const CMatrix4x4A& m)
+{
+    CVector4A vOut;
+    TransformVector<true>(&v.x, &m.e00, &vOut.x);
+    return vOut;
 }
 
 
@@ -224,32 +242,38 @@ CMatrix4x4 MatrixScaling(const float s)
 // Advanced calulation needed to get the view matrix from the camera's positioning matrix
 CMatrix4x4 InverseAffine(const CMatrix4x4& m)
 {
-    CMatrix4x4 mOut;
-
-    // Calculate determinant of upper left 3x3
-    float det0 = m.e11*m.e22 - m.e12*m.e21;
-    float det1 = m.e12*m.e20 - m.e10*m.e22;
-    float det2 = m.e10*m.e21 - m.e11*m.e20;
-    float det = m.e00*det0 + m.e01*det1 + m.e02*det2;
-
-    // Calculate inverse of upper left 3x3
-    float invDet = 1.0f / det;
-    mOut.e00 = invDet * det0;
-    mOut.e10 = invDet * det1;
-    mOut.e20 = invDet * det2;
-
-    mOut.e01 = invDet * (m.e21*m.e02 - m.e22*m.e01);
-    mOut.e11 = invDet * (m.e22*m.e00 - m.e20*m.e02);
-    mOut.e21 = invDet * (m.e20*m.e01 - m.e21*m.e00);
-
-    mOut.e02 = invDet * (m.e01*m.e12 - m.e02*m.e11);
-    mOut.e12 = invDet * (m.e02*m.e10 - m.e00*m.e12);
-    mOut.e22 = invDet * (m.e00*m.e11 - m.e01*m.e10);
+    const Float4 r0 = Float4::Load(&m.e00);
+    const Float4 r1 = Float4::Load(&m.e10);
+    const Float4 r2 = Float4::Load(&m.e20);
+
+    // Columns of the inverse of the upper left 3x3 are the cross products of pairs of its rows over its determinant
+    const Float4 c0 = CrossRows(r1, r2);
+    const Float4 c1 = CrossRows(r2, r0);
+    const Float4 c2 = CrossRows(r0, r1);
+
+    // Determinant of upper left 3x3
+    float products[4];
+    (r0 * c0).Store(products);
+    const Float4 invDet = Float4::Set(1.0f / (products[0] + products[1] + products[2]));
+
+    // Transpose the columns into rows
+    const Float4 zero = Float4::Set(0.0f);
+    const Float4 t0 = Shuffle<0, 1, 0, 1>(c0, c1);
+    const Float4 t1 = Shuffle<2, 3, 2, 3>(c0, c1);
+    const Float4 t2 = Shuffle<0, 1, 0, 1>(c2, zero);
+    const Float4 t3 = Shuffle<2, 3, 2, 3>(c2, zero);
+    const Float4 i0 = invDet * Shuffle<0, 2, 0, 2>(t0, t2);
+    const Float4 i1 = invDet * Shuffle<1, 3, 1, 3>(t0, t2);
+    const Float4 i2 = invDet * Shuffle<0, 2, 0, 2>(t1, t3);
 
     // Transform negative translation by inverted 3x3 to get inverse
-    mOut.e30 = -m.e30*mOut.e00 - m.e31*mOut.e10 - m.e32*mOut.e20;
-    mOut.e31 = -m.e30*mOut.e01 - m.e31*mOut.e11 - m.e32*mOut.e21;
-    mOut.e32 = -m.e30*mOut.e02 - m.e31*mOut.e12 - m.e32*mOut.e22;
+    const Float4 i3 = (Float4::Set(-m.e30) * i0 - Float4::Set(m.e31) * i1) - Float4::Set(m.e32) * i2;
+
+    CMatrix4x4 mOut;
+    i0.Store(&mOut.e00);
+    i1.Store(&mOut.e10);
+    i2.Store(&mOut.e20);
+    i3.Store(&mOut.e30);
 
     // Fill in right column for affine matrix
     mOut.e03 = 0.0f;
@@ -261,6 +285,80 @@ CMatrix4x4 InverseAffine(const CMatrix4x4& m)
 }
 
 
+// 2x2 matrix helpers for Inverse. A Float4 holds a 2x2 matrix as (e00, e01, e10, e11)
+
+// a * b
+static Float4 Mat2Multiply(Float4 a, Float4 b)
+{
+    return a * Shuffle<0, 3, 0, 3>(b, b) + Shuffle<1, 0, 3, 2>(a, a) * Shuffle<2, 1, 2, 1>(b, b);
+}
+
+// Adjugate of a * b
+static Float4 Mat2AdjugateMultiply(Float4 a, Float4 b)
+{
+    return Shuffle<3, 3, 0, 0>(a, a) * b - Shuffle<1, 1, 2, 2>(a, a) * Shuffle<2, 3, 0, 1>(b, b);
+}
+
+// a * adjugate of b
+static Float4 Mat2MultiplyAdjugate(Float4 a, Float4 b)
+{
+    return a * Shuffle<3, 0, 3, 0>(b, b) - Shuffle<1, 0, 3, 2>(a, a) * Shuffle<2, 1, 2, 1>(b, b);
+}
+
+// Return the inverse of any invertible matrix, e.g. to get back from a view-projection matrix to world space
+// Treats the matrix as 2x2 blocks | A B | and builds the inverse from the blocks' adjugates and determinants
+//                                 | C D |
+CMatrix4x4 Inverse(const CMatrix4x4& m)
+{
+    const Float4 r0 = Float4::Load(&m.e00);
+    const Float4 r1 = Float4::Load(&m.e10);
+    const Float4 r2 = Float4::Load(&m.e20);
+    const Float4 r3 = Float4::Load(&m.e30);
+
+    const Float4 a = Shuffle<0, 1, 0, 1>(r0, r1);
+    const Float4 b = Shuffle<2, 3, 2, 3>(r0, r1);
+    const Float4 c = Shuffle<0, 1, 0, 1>(r2, r3);
+    const Float4 d = Shuffle<2, 3, 2, 3>(r2, r3);
+
+    // Determinants of the blocks as (|A|, |B|, |C|, |D|)
+    const Float4 detBlocks = Shuffle<0, 2, 0, 2>(r0, r2) * Shuffle<1, 3, 1, 3>(r1, r3) -
+                             Shuffle<1, 3, 1, 3>(r0, r2) * Shuffle<0, 2, 0, 2>(r1, r3);
+    const Float4 detA = Splat<0>(detBlocks);
+    const Float4 detB = Splat<1>(detBlocks);
+    const Float4 detC = Splat<2>(detBlocks);
+    const Float4 detD = Splat<3>(detBlocks);
+
+    // The inverse is 1/|M| * | X Y |, get the adjugates of X, Y, Z and W
+    //                        | Z W |
+    const Float4 dc = Mat2AdjugateMultiply(d, c);
+    const Float4 ab = Mat2AdjugateMultiply(a, b);
+    Float4 x = detD * a - Mat2Multiply(b, dc);
+    Float4 w = detA * d - Mat2Multiply(c, ab);
+    Float4 y = detB * c - Mat2MultiplyAdjugate(d, ab);
+    Float4 z = detC * b - Mat2MultiplyAdjugate(a, dc);
+
+    // |M| = |A||D| + |B||C| - trace(adj(A)B adj(D)C)
+    Float4 trace = ab * Shuffle<0, 2, 1, 3>(dc, dc);
+    trace = trace + Shuffle<2, 3, 0, 1>(trace, trace);
+    trace = trace + Shuffle<1, 0, 3, 2>(trace, trace);
+    const float invDet = 1.0f / (detA * detD + detB * detC - trace).X();
+
+    // Signs of the adjugate in with the determinant, then the adjugate's swaps in with the stores
+    const Float4 scale = Float4::Set(invDet, -invDet, -invDet, invDet);
+    x = x * scale;
+    y = y * scale;
+    z = z * scale;
+    w = w * scale;
+
+    CMatrix4x4 mOut;
+    Shuffle<3, 1, 3, 1>(x, y).Store(&mOut.e00);
+    Shuffle<2, 0, 2, 0>(x, y).Store(&mOut.e10);
+    Shuffle<3, 1, 3, 1>(z, w).Store(&mOut.e20);
+    Shuffle<2, 0, 2, 0>(z, w).Store(&mOut.e30);
+    return mOut;
+}
+
+
 // Make this matrix an affine 3D transformation matrix to face from current position to given target (in the Z direction)
 // Will retain the matrix's current scaling
 void CMatrix4x4::FaceTarget(const CVector3& target)
@@ -334,3 +432,146 @@ void CMatrix4x4::Transpose()
     std::swap(e13, e31);
     std::swap(e23, e32);
 }
+
+
+/*-----------------------------------------------------------------------------------------
+    Scalar versions
+-----------------------------------------------------------------------------------------*/
+
+// Matrix-matrix multiplication, one element at a time
+CMatrix4x4 MatrixMultiplyScalar(const CMatrix4x4& m1, const CMatrix4x4& m2)
+{
+    CMatrix4x4 mOut;
+
+    mOut.e00 = m1.e00*m2.e00 + m1.e01*m2.e10 + m1.e02*m2.e20 + m1.e03*m2.e30;
+    mOut.e01 = m1.e00*m2.e01 + m1.e01*m2.e11 + m1.e02*m2.e21 + m1.e03*m2.e31;
+    mOut.e02 = m1.e00*m2.e02 + m1.e01*m2.e12 + m1.e02*m2.e22 + m1.e03*m2.e32;
+    mOut.e03 = m1.e00*m2.e03 + m1.e01*m2.e13 + m1.e02*m2.e23 + m1.e03*m2.e33;
+
+    mOut.e10 = m1.e10*m2.e00 + m1.e11*m2.e10 + m1.e12*m2.e20 + m1.e13*m2.e30;
+    mOut.e11 = m1.e10*m2.e01 + m1.e11*m2.e11 + m1.e12*m2.e21 + m1.e13*m2.e31;
+    mOut.e12 = m1.e10*m2.e02 + m1.e11*m2.e12 + m1.e12*m2.e22 + m1.e13*m2.e32;
+    mOut.e13 = m1.e10*m2.e03 + m1.e11*m2.e13 + m1.e12*m2.e23 + m1.e13*m2.e33;
+
+    mOut.e20 = m1.e20*m2.e00 + m1.e21*m2.e10 + m1.e22*m2.e20 + m1.e23*m2.e30;
+    mOut.e21 = m1.e20*m2.e01 + m1.e21*m2.e11 + m1.e22*m2.e21 + m1.e23*m2.e31;
+    mOut.e22 = m1.e20*m2.e02 + m1.e21*m2.e12 + m1.e22*m2.e22 + m1.e23*m2.e32;
+    mOut.e23 = m1.e20*m2.e03 + m1.e21*m2.e13 + m1.e22*m2.e23 + m1.e23*m2.e33;
+
+    mOut.e30 = m1.e30*m2.e00 + m1.e31*m2.e10 + m1.e32*m2.e20 + m1.e33*m2.e30;
+    mOut.e31 = m1.e30*m2.e01 + m1.e31*m2.e11 + m1.e32*m2.e21 + m1.e33*m2.e31;
+    mOut.e32 = m1.e30*m2.e02 + m1.e31*m2.e12 + m1.e32*m2.e22 + m1.e33*m2.e32;
+    mOut.e33 = m1.e30*m2.e03 + m1.e31*m2.e13 + m1.e32*m2.e23 + m1.e33*m2.e33;
+
+    return mOut;
+}
+
+// Return the given CVector4 transformed by the given matrix, one element at a time
+CVector4 TransformScalar(const CVector4& v, const CMatrix4x4& m)
+{
+    CVector4 vOut;
+
+	vOut.x = v.x * m.e00 + v.y * m.e10 + v.z * m.e20 + v.w * m.e30;
+	vOut.y = v.x * m.e01 + v.y * m.e11 + v.z * m.e21 + v.w * m.e31;
+	vOut.z = v.x * m.e02 + v.y * m.e12 + v.z * m.e22 + v.w * m.e32;
+	vOut.w = v.x * m.e03 + v.y * m.e13 + v.z * m.e23 + v.w * m.e33;
+
+	return vOut;
+}
+
+// Return the inverse of given matrix assuming that it is an affine matrix, one element at a time
+CMatrix4x4 InverseAffineScalar(const CMatrix4x4& m)
+{
+    CMatrix4x4 mOut;
+
+    // Calculate determinant of upper left 3x3
+    float det0 = m.e11*m.e22 - m.e12*m.e21;
+    float det1 = m.e12*m.e20 - m.e10*m.e22;
+    float det2 = m.e10*m.e21 - m.e11*m.e20;
+    float det = m.e00*det0 + m.e01*det1 + m.e02*det2;
+
+    // Calculate inverse of upper left 3x3
+    float invDet = 1.0f / det;
+    mOut.e00 = invDet * det0;
+    mOut.e10 = invDet * det1;
+    mOut.e20 = invDet * det2;
+
+    mOut.e01 = invDet * (m.e21*m.e02 - m.e22*m.e01);
+    mOut.e11 = invDet * (m.e22*m.e00 - m.e20*m.e02);
+    mOut.e21 = invDet * (m.e20*m.e01 - m.e21*m.e00);
+
+    mOut.e02 = invDet * (m.e01*m.e12 - m.e02*m.e11);
+    mOut.e12 = invDet * (m.e02*m.e10 - m.e00*m.e12);
+    mOut.e22 = invDet * (m.e00*m.e11 - m.e01*m.e10);
+
+    // Transform negative translation by inverted 3x3 to get inverse
+    mOut.e30 = -m.e30*mOut.e00 - m.e31*mOut.e10 - m.e32*mOut.e20;
+    mOut.e31 = -m.e30*mOut.e01 - m.e31*mOut.e11 - m.e32*mOut.e21;
+    mOut.e32 = -m.e30*mOut.e02 - m.e31*mOut.e12 - m.e32*mOut.e22;
+
+    // Fill in right column for affine matrix
+    mOut.e03 = 0.0f;
+    mOut.e13 = 0.0f;
+    mOut.e23 = 0.0f;
+    mOut.e33 = 1.0f;
+
+    return mOut;
+}
+
+// Return the inverse of any invertible matrix, one element at a time. Uses the 2x2 determinants of the top two rows
+// (s0-s5) and bottom two rows (c0-c5) to build the cofactors
+CMatrix4x4 InverseScalar(const CMatrix4x4& m)
+{
+    float s0 = m.e00*m.e11 - m.e10*m.e01;
+    float s1 = m.e00*m.e12 - m.e10*m.e02;
+    float s2 = m.e00*m.e13 - m.e10*m.e03;
+    float s3 = m.e01*m.e12 - m.e11*m.e02;
+    float s4 = m.e01*m.e13 - m.e11*m.e03;
+    float s5 = m.e02*m.e13 - m.e12*m.e03;
+
+    float c5 = m.e22*m.e33 - m.e32*m.e23;
+    float c4 = m.e21*m.e33 - m.e31*m.e23;
+    float c3 = m.e21*m.e32 - m.e31*m.e22;
+    float c2 = m.e20*m.e33 - m.e30*m.e23;
+    float c1 = m.e20*m.e32 - m.e30*m.e22;
+    float c0 = m.e20*m.e31 - m.e30*m.e21;
+
+    float invDet = 1.0f / (s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0);
+
+    CMatrix4x4 mOut;
+    mOut.e00 = ( m.e11*c5 - m.e12*c4 + m.e13*c3) * invDet;
+    mOut.e01 = (-m.e01*c5 + m.e02*c4 - m.e03*c3) * invDet;
+    mOut.e02 = ( m.e31*s5 - m.e32*s4 + m.e33*s3) * invDet;
+    mOut.e03 = (-m.e21*s5 + m.e22*s4 - m.e23*s3) * invDet;
+
+    mOut.e10 = (-m.e10*c5 + m.e12*c2 - m.e13*c1) * invDet;
+    mOut.e11 = ( m.e00*c5 - m.e02*c2 + m.e03*c1) * invDet;
+    mOut.e12 = (-m.e30*s5 + m.e32*s2 - m.e33*s1) * invDet;
+    mOut.e13 = ( m.e20*s5 - m.e22*s2 + m.e23*s1) * invDet;
+
+    mOut.e20 = ( m.e10*c4 - m.e11*c2 + m.e13*c0) * invDet;
+    mOut.e21 = (-m.e00*c4 + m.e01*c2 - m.e03*c0) * invDet;
+    mOut.e22 = ( m.e30*s4 - m.e31*s2 + m.e33*s0) * invDet;
+    mOut.e23 = (-m.e20*s4 + m.e21*s2 - m.e23*s0) * invDet;
+
+    mOut.e30 = (-m.e10*c3 + m.e11*c1 - m.e12*c0) * invDet;
+    mOut.e31 = ( m.e00*c3 - m.e01*c1 + m.e02*c0) * invDet;
+    mOut.e32 = (-m.e30*s3 + m.e31*s1 - m.e32*s0) * invDet;
+    mOut.e33 = ( m.e20*s3 - m.e21*s1 + m.e22*s0) * invDet;
+
+    return mOut;
+}
+
+
+const char* MatrixInstructionSet()
+{
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(FLOAT4_SSE)
+    return "SSE";
+#elif defined(FLOAT4_NEON)
+    return "NEON";
+#else
+    return "Scalar";
+#endif
+}
@@ -2,6 +2,15 @@
 // Matrix4x4 class (cut down version) to hold matrices for 3D
 //--------------------------------------------------------------------------------------
 // Code in .cpp file
+//
+// Multiplication, transforms and inverses work on a row of four floats at once using Float4 (SSE, NEON or plain floats,
+// and AVX for two rows at once when the compiler targets it, as the app and MathBenchmark projects do with /arch:AVX).
+// Each result element is summed in the same order as the plain float versions in the "Scalar versions" section below,
+// so multiplications, transforms and affine inverses give exactly the same results as they do. The general inverse is a
+// different method to InverseScalar so agrees only to rounding
+//
+// CMatrix4x4 has no alignment beyond float so it can overlay any 16 floats (e.g. SetValues, constant buffers).
+// CMatrix4x4A and CVector4A are the same layout on a 16-byte boundary, for arrays of matrices the code owns
 
 #ifndef _CMATRIX4X4_H_DEFINED_
 #define _CMATRIX4X4_H_DEFINED_
@@ -80,6 +89,27 @@ CMatrix4x4 operator*(const CMatrix4x4& m1, const CMatrix4x4& m2);
 CVector4 operator*(const CVector4& v, const CMatrix4x4& m);
 
 
+/*-----------------------------------------------------------------------------------------
+    Aligned matrix
+-----------------------------------------------------------------------------------------*/
+
+// Same as CMatrix4x4 but always on a 16-byte boundary, so rows load and store aligned. Use for matrices held in arrays
+// and vectors (heap allocations on x64 are 16-byte aligned)
+class alignas(16) CMatrix4x4A : public CMatrix4x4
+{
+public:
+    CMatrix4x4A() {}
+    explicit CMatrix4x4A(const CMatrix4x4& m) : CMatrix4x4(m) {} // Explicit so mixed multiplications use CMatrix4x4's
+    CMatrix4x4A& operator=(const CMatrix4x4& m)  { CMatrix4x4::operator=(m); return *this; }
+};
+
+// Matrix-matrix multiplication of aligned matrices
+CMatrix4x4A operator*(const CMatrix4x4A& m1, const CMatrix4x4A& m2);
+
+// Return the given aligned CVector4 transformed by the given aligned matrix
+CVector4A operator*(const CVector4A& v, const CMatrix4x4A& m);
+
+
 /*-----------------------------------------------------------------------------------------
   Non-member functions
 -----------------------------------------------------------------------------------------*/
@@ -117,5 +147,24 @@ CMatrix4x4 MatrixScaling(const float s);
 // Advanced calulation needed to get the view matrix from the camera's positioning matrix
 CMatrix4x4 InverseAffine(const CMatrix4x4& m);
 
+// Return the inverse of any invertible matrix, e.g. to get back from a view-projection matrix to world space
+// Slower than InverseAffine so use that when the matrix is affine
+CMatrix4x4 Inverse(const CMatrix4x4& m);
+
+// Instructions the operations above use, "AVX", "SSE", "NEON" or "Scalar", for reports. AVX only changes multiplication
+const char* MatrixInstructionSet();
+
+
+/*-----------------------------------------------------------------------------------------
+    Scalar versions
+-----------------------------------------------------------------------------------------*/
+
+// Plain float versions of the operations above, one element at a time. Kept to check the results of the versions
+// above and to compare their speed (see Tools/MathBenchmark)
+CMatrix4x4 MatrixMultiplyScalar(const CMatrix4x4& m1, const CMatrix4x4& m2);
+CVector4   TransformScalar(const CVector4& v, const CMatrix4x4& m);
+CMatrix4x4 InverseAffineScalar(const CMatrix4x4& m);
+CMatrix4x4 InverseScalar(const CMatrix4x4& m);
+
 
 #endif // _CMATRIX4X4_H_DEFINED_
@@ -58,4 +58,16 @@ public:
 };
 
 
+// Same as CVector4 but always on a 16-byte boundary, so it loads and stores aligned
+class alignas(16) CVector4A : public CVector4
+{
+public:
+    CVector4A() {}
+    CVector4A(const float xIn, const float yIn, const float zIn, const float wIn) : CVector4(xIn, yIn, zIn, wIn) {}
+    CVector4A(const CVector3& vIn, const float wIn) : CVector4(vIn, wIn) {}
+    explicit CVector4A(const CVector4& v) : CVector4(v) {}
+    CVector4A& operator=(const CVector4& v)  { CVector4::operator=(v); return *this; }
+};
+
+
 #endif // _CVECTOR3_H_DEFINED_
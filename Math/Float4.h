@@ -0,0 +1,143 @@
+//--------------------------------------------------------------------------------------
+// Four float SIMD values - uses SSE or NEON where the compiler supports them, plain floats otherwise
+//--------------------------------------------------------------------------------------
+// All code in this header. Used by CPU image processing that works on four floats at once (e.g. an RGBA pixel) and by
+// the matrix and vector classes, which work on a row of four floats at once
+//
+// Results are the same on every version - there are no fused multiply-adds, so each operation rounds as the plain float
+// version does
+
+#ifndef _FLOAT4_H_INCLUDED_
+#define _FLOAT4_H_INCLUDED_
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLOAT4_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define FLOAT4_NEON
+#include <arm_neon.h>
+#endif
+
+
+#if defined(FLOAT4_SSE)
+
+struct Float4
+{
+	__m128 v;
+
+	static Float4 Load(const float* p)                     { return { _mm_loadu_ps(p) }; }
+	static Float4 LoadAligned(const float* p)              { return { _mm_load_ps(p) }; } // p must be on a 16-byte boundary
+	static Float4 Set(float x)                             { return { _mm_set1_ps(x) }; }
+	static Float4 Set(float x, float y, float z, float w)  { return { _mm_setr_ps(x, y, z, w) }; }
+	void          Store(float* p) const                    { _mm_storeu_ps(p, v); }
+	void          StoreAligned(float* p) const             { _mm_store_ps(p, v); }  // p must be on a 16-byte boundary
+	void          StoreStream(float* p) const              { _mm_stream_ps(p, v); } // Aligned, bypassing the cache
+	float         X() const                                { return _mm_cvtss_f32(v); }
+};
+
+// Call after a run of StoreStream, before the values are read by another thread
+inline void StreamFence() { _mm_sfence(); }
+
+inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+
+inline Float4 Min(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Float4 Max(Float4 a, Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+
+// Two values picked from a then two from b: { a[i0], a[i1], b[i2], b[i3] }
+template <int i0, int i1, int i2, int i3>
+inline Float4 Shuffle(Float4 a, Float4 b) { return { _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(i3, i2, i1, i0)) }; }
+
+#elif defined(FLOAT4_NEON)
+
+struct Float4
+{
+	float32x4_t v;
+
+	static Float4 Load(const float* p)                     { return { vld1q_f32(p) }; }
+	static Float4 LoadAligned(const float* p)              { return { vld1q_f32(p) }; }
+	static Float4 Set(float x)                             { return { vdupq_n_f32(x) }; }
+	static Float4 Set(float x, float y, float z, float w)  { const float p[4] = { x, y, z, w }; return { vld1q_f32(p) }; }
+	void          Store(float* p) const                    { vst1q_f32(p, v); }
+	void          StoreAligned(float* p) const             { vst1q_f32(p, v); }
+	void          StoreStream(float* p) const              { vst1q_f32(p, v); }
+	float         X() const                                { return vgetq_lane_f32(v, 0); }
+};
+
+inline void StreamFence() {}
+
+inline Float4 operator+(Float4 a, Float4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { vmulq_f32(a.v, b.v) }; }
+
+// Selects rather than vminq/vmaxq so not-a-number gives the second value as the SSE versions do
+inline Float4 Min(Float4 a, Float4 b) { return { vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v) }; }
+inline Float4 Max(Float4 a, Float4 b) { return { vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v) }; }
+
+// Two values picked from a then two from b: { a[i0], a[i1], b[i2], b[i3] }
+template <int i0, int i1, int i2, int i3>
+inline Float4 Shuffle(Float4 a, Float4 b)
+{
+	float32x4_t r = vmovq_n_f32(vgetq_lane_f32(a.v, i0));
+	r = vsetq_lane_f32(vgetq_lane_f32(a.v, i1), r, 1);
+	r = vsetq_lane_f32(vgetq_lane_f32(b.v, i2), r, 2);
+	r = vsetq_lane_f32(vgetq_lane_f32(b.v, i3), r, 3);
+	return { r };
+}
+
+#else
+
+struct Float4
+{
+	float v[4];
+
+	static Float4 Load(const float* p)                     { return { { p[0], p[1], p[2], p[3] } }; }
+	static Float4 LoadAligned(const float* p)              { return Load(p); }
+	static Float4 Set(float x)                             { return { { x, x, x, x } }; }
+	static Float4 Set(float x, float y, float z, float w)  { return { { x, y, z, w } }; }
+	void          Store(float* p) const                    { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+	void          StoreAligned(float* p) const             { Store(p); }
+	void          StoreStream(float* p) const              { Store(p); }
+	float         X() const                                { return v[0]; }
+};
+
+inline void StreamFence() {}
+
+inline Float4 operator+(Float4 a, Float4 b) { return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+// Same argument order as the SSE versions - the second value is returned if either is not a number
+inline Float4 Min(Float4 a, Float4 b) { return { { a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1], a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3] } }; }
+inline Float4 Max(Float4 a, Float4 b) { return { { a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3] } }; }
+
+// Two values picked from a then two from b: { a[i0], a[i1], b[i2], b[i3] }
+template <int i0, int i1, int i2, int i3>
+inline Float4 Shuffle(Float4 a, Float4 b) { return { { a.v[i0], a.v[i1], b.v[i2], b.v[i3] } }; }
+
+#endif
+
+
+// One value copied to all four
+template <int i>
+inline Float4 Splat(Float4 a) { return Shuffle<i, i, i, i>(a, a); }
+
+// Row a (a vector or a row of a matrix) multiplied by the matrix with rows b0-b3. Summed in the same order as the
+// CMatrix4x4 scalar versions: a.x*b0 + a.y*b1 + a.z*b2 + a.w*b3
+inline Float4 MultiplyRow(Float4 a, Float4 b0, Float4 b1, Float4 b2, Float4 b3)
+{
+	Float4 r = Splat<0>(a) * b0;
+	r = r + Splat<1>(a) * b1;
+	r = r + Splat<2>(a) * b2;
+	return r + Splat<3>(a) * b3;
+}
+
+// Clamp to 0->1 as the UNORM render targets do. Not-a-number goes to 0
+inline Float4 Saturate(Float4 a)
+{
+	return Min(Max(a, Float4::Set(0.0f)), Float4::Set(1.0f));
+}
+
+
+#endif //_FLOAT4_H_INCLUDED_
@@ -0,0 +1,371 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling - bounding volumes and testing them against the view of a camera
+//--------------------------------------------------------------------------------------
+
+#include "FrustumCulling.h"
+#include "Float4.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+/*-----------------------------------------------------------------------------------------
+    Bounding volumes
+-----------------------------------------------------------------------------------------*/
+
+BoundingBox EmptyBoundingBox()
+{
+    return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+bool IsEmpty(const BoundingBox& box)
+{
+    return box.minimum.x > box.maximum.x || box.minimum.y > box.maximum.y || box.minimum.z > box.maximum.z;
+}
+
+BoundingSphere EmptyBoundingSphere()
+{
+    return { { 0, 0, 0 }, -1 };
+}
+
+
+// Smallest box holding both boxes
+BoundingBox Combine(const BoundingBox& a, const BoundingBox& b)
+{
+    return { { std::min(a.minimum.x, b.minimum.x), std::min(a.minimum.y, b.minimum.y), std::min(a.minimum.z, b.minimum.z) },
+             { std::max(a.maximum.x, b.maximum.x), std::max(a.maximum.y, b.maximum.y), std::max(a.maximum.z, b.maximum.z) } };
+}
+
+
+// Smallest sphere holding both spheres, reaching from the far side of one to the far side of the other
+BoundingSphere Combine(const BoundingSphere& a, const BoundingSphere& b)
+{
+    if (a.radius < 0)  return b;
+    if (b.radius < 0)  return a;
+
+    CVector3 offset = b.centre - a.centre;
+    float distance = Length(offset);
+    if (distance + b.radius <= a.radius)  return a; // One holds the other
+    if (distance + a.radius <= b.radius)  return b;
+
+    float radius = (distance + a.radius + b.radius) * 0.5f;
+    return { a.centre + offset * ((radius - a.radius) / distance), radius };
+}
+
+
+// Axis-aligned box holding the given box transformed by an affine matrix. The centre is transformed as a point and each
+// half size of the new box is the sum of the old half sizes along the transformed axes (Arvo's method)
+BoundingBox TransformBox(const BoundingBox& box, const CMatrix4x4& m)
+{
+    if (IsEmpty(box))  return box;
+
+    CVector3 centre = (box.minimum + box.maximum) * 0.5f;
+    CVector3 extent = (box.maximum - box.minimum) * 0.5f;
+
+    CVector3 newCentre = { centre.x * m.e00 + centre.y * m.e10 + centre.z * m.e20 + m.e30,
+                           centre.x * m.e01 + centre.y * m.e11 + centre.z * m.e21 + m.e31,
+                           centre.x * m.e02 + centre.y * m.e12 + centre.z * m.e22 + m.e32 };
+    CVector3 newExtent = { extent.x * std::abs(m.e00) + extent.y * std::abs(m.e10) + extent.z * std::abs(m.e20),
+                           extent.x * std::abs(m.e01) + extent.y * std::abs(m.e11) + extent.z * std::abs(m.e21),
+                           extent.x * std::abs(m.e02) + extent.y * std::abs(m.e12) + extent.z * std::abs(m.e22) };
+    return { newCentre - newExtent, newCentre + newExtent };
+}
+
+
+// Sphere holding the given sphere transformed by an affine matrix
+BoundingSphere TransformSphere(const BoundingSphere& sphere, const CMatrix4x4& m)
+{
+    if (sphere.radius < 0)  return sphere;
+
+    const CVector3& c = sphere.centre;
+    CVector3 newCentre = { c.x * m.e00 + c.y * m.e10 + c.z * m.e20 + m.e30,
+                           c.x * m.e01 + c.y * m.e11 + c.z * m.e21 + m.e31,
+                           c.x * m.e02 + c.y * m.e12 + c.z * m.e22 + m.e32 };
+    float scale = std::max({ Length({ m.e00, m.e01, m.e02 }), Length({ m.e10, m.e11, m.e12 }), Length({ m.e20, m.e21, m.e22 }) });
+    return { newCentre, sphere.radius * scale };
+}
+
+
+// Position of the point at the given index of an interleaved array
+static CVector3 PointAt(const void* points, int stride, int index)
+{
+    float position[3];
+    memcpy(position, static_cast<const unsigned char*>(points) + static_cast<size_t>(index) * stride, sizeof(position));
+    return { position[0], position[1], position[2] };
+}
+
+BoundingBox BoxOfPoints(const void* points, int stride, int count)
+{
+    BoundingBox box = EmptyBoundingBox();
+    for (int i = 0; i < count; ++i)
+    {
+        CVector3 point = PointAt(points, stride, i);
+        box = Combine(box, { point, point });
+    }
+    return box;
+}
+
+// Sphere centred on the box of the points. No points give a sphere of radius 0 at the origin
+BoundingSphere SphereOfPoints(const void* points, int stride, int count)
+{
+    if (count <= 0)  return { { 0, 0, 0 }, 0 };
+
+    BoundingBox box = BoxOfPoints(points, stride, count);
+    CVector3 centre = (box.minimum + box.maximum) * 0.5f;
+    float radius = 0;
+    for (int i = 0; i < count; ++i)  radius = std::max(radius, Length(PointAt(points, stride, i) - centre));
+    return { centre, radius };
+}
+
+
+// Centre and half sizes of a box. An empty box gets a negative size, so it is behind every plane
+static void CentreAndExtent(const BoundingBox& box, CVector3& centre, CVector3& extent)
+{
+    bool empty = IsEmpty(box);
+    centre = empty ? CVector3(0, 0, 0) : (box.minimum + box.maximum) * 0.5f;
+    extent = empty ? CVector3(-FLT_MAX, -FLT_MAX, -FLT_MAX) : (box.maximum - box.minimum) * 0.5f;
+}
+
+void BoundingBoxes::Add(const BoundingBox& box)
+{
+    CVector3 centre, extent;
+    CentreAndExtent(box, centre, extent);
+    centreX.push_back(centre.x);  centreY.push_back(centre.y);  centreZ.push_back(centre.z);
+    extentX.push_back(extent.x);  extentY.push_back(extent.y);  extentZ.push_back(extent.z);
+}
+
+void BoundingBoxes::Clear()
+{
+    centreX.clear();  centreY.clear();  centreZ.clear();
+    extentX.clear();  extentY.clear();  extentZ.clear();
+}
+
+void BoundingSpheres::Add(const BoundingSphere& sphere)
+{
+    centreX.push_back(sphere.centre.x);  centreY.push_back(sphere.centre.y);  centreZ.push_back(sphere.centre.z);
+    radius.push_back(sphere.radius < 0 ? -FLT_MAX : sphere.radius); // An empty sphere is behind every plane
+}
+
+void BoundingSpheres::Clear()
+{
+    centreX.clear();  centreY.clear();  centreZ.clear();
+    radius.clear();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Frustum
+-----------------------------------------------------------------------------------------*/
+
+// A vertex v is in the frustum if its clip position v * M satisfies -w <= x <= w, -w <= y <= w and 0 <= z <= w. Each
+// of these is a plane made from the columns of the matrix, e.g. x >= -w is v . (column 3 + column 0) >= 0
+FrustumPlanes FrustumPlanesFromMatrix(const CMatrix4x4& viewProjection)
+{
+    const CMatrix4x4& m = viewProjection;
+    const float columns[4][4] = { { m.e00, m.e10, m.e20, m.e30 }, { m.e01, m.e11, m.e21, m.e31 },
+                                  { m.e02, m.e12, m.e22, m.e32 }, { m.e03, m.e13, m.e23, m.e33 } };
+
+    // Column combination for each plane, column 3 plus (or minus) another column, the near plane is column 2 alone
+    const int   otherColumn[6] = { 0, 0, 1, 1, 2, 2 };
+    const float otherSign[6]   = { 1, -1, 1, -1, 1, -1 };
+
+    FrustumPlanes planes;
+    for (int i = 0; i < 6; ++i)
+    {
+        float plane[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            plane[j] = (i == 4 ? 0.0f : columns[3][j]) + otherSign[i] * columns[otherColumn[i]][j];
+        }
+        float length = Length({ plane[0], plane[1], plane[2] });
+        if (length > 0)  for (float& value : plane)  value /= length;
+        planes.a[i] = plane[0];
+        planes.b[i] = plane[1];
+        planes.c[i] = plane[2];
+        planes.d[i] = plane[3];
+    }
+    return planes;
+}
+
+
+// Signed distance in front of the plane a volume is furthest behind, for a box (centre and half sizes) or a sphere
+// (centre and radius in extentX). Visible if not negative. The SIMD versions below sum in the same order, so give
+// exactly the same result
+template <bool Spheres>
+static float NearestPlaneDistance(const FrustumPlanes& planes, float centreX, float centreY, float centreZ,
+                                  float extentX, float extentY, float extentZ)
+{
+    float nearest = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        float distance = planes.a[i] * centreX + planes.b[i] * centreY + planes.c[i] * centreZ + planes.d[i];
+        float reach = Spheres ? extentX : std::abs(planes.a[i]) * extentX + std::abs(planes.b[i]) * extentY +
+                                          std::abs(planes.c[i]) * extentZ;
+        float value = distance + reach;
+        nearest = (i == 0) ? value : (nearest < value ? nearest : value); // As Min in Float4
+    }
+    return nearest;
+}
+
+bool IsBoxInFrustum(const FrustumPlanes& planes, const BoundingBox& box)
+{
+    CVector3 centre, extent;
+    CentreAndExtent(box, centre, extent);
+    return NearestPlaneDistance<false>(planes, centre.x, centre.y, centre.z, extent.x, extent.y, extent.z) >= 0;
+}
+
+bool IsSphereInFrustum(const FrustumPlanes& planes, const BoundingSphere& sphere)
+{
+    return NearestPlaneDistance<true>(planes, sphere.centre.x, sphere.centre.y, sphere.centre.z, sphere.radius, 0, 0) >= 0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Culling lists
+-----------------------------------------------------------------------------------------*/
+
+// Cull the volumes from begin to end, eight at a time with AVX, then four at a time with Float4, then one at a time.
+// For spheres the radius is in extentX and extentY and extentZ are not read. Returns the number visible
+template <bool Spheres>
+static int CullRange(const FrustumPlanes& planes, const float* centreX, const float* centreY, const float* centreZ,
+                     const float* extentX, const float* extentY, const float* extentZ, uint8_t* visible, int begin, int end)
+{
+    float absA[6], absB[6], absC[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        absA[p] = std::abs(planes.a[p]);
+        absB[p] = std::abs(planes.b[p]);
+        absC[p] = std::abs(planes.c[p]);
+    }
+
+    int numVisible = 0;
+    int i = begin;
+
+#if defined(__AVX__)
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 x  = _mm256_loadu_ps(centreX + i);
+        const __m256 y  = _mm256_loadu_ps(centreY + i);
+        const __m256 z  = _mm256_loadu_ps(centreZ + i);
+        const __m256 ex = _mm256_loadu_ps(extentX + i);
+        const __m256 ey = Spheres ? ex : _mm256_loadu_ps(extentY + i);
+        const __m256 ez = Spheres ? ex : _mm256_loadu_ps(extentZ + i);
+
+        __m256 nearest = _mm256_setzero_ps();
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.a[p]), x);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.b[p]), y));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.c[p]), z));
+            distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.d[p]));
+            __m256 reach = ex;
+            if (!Spheres)
+            {
+                reach = _mm256_mul_ps(_mm256_set1_ps(absA[p]), ex);
+                reach = _mm256_add_ps(reach, _mm256_mul_ps(_mm256_set1_ps(absB[p]), ey));
+                reach = _mm256_add_ps(reach, _mm256_mul_ps(_mm256_set1_ps(absC[p]), ez));
+            }
+            __m256 value = _mm256_add_ps(distance, reach);
+            nearest = (p == 0) ? value : _mm256_min_ps(nearest, value);
+        }
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(nearest, _mm256_setzero_ps(), _CMP_GE_OQ));
+        for (int k = 0; k < 8; ++k)
+        {
+            visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+            numVisible += visible[i + k];
+        }
+    }
+#endif
+
+    for (; i + 4 <= end; i += 4)
+    {
+        const Float4 x  = Float4::Load(centreX + i);
+        const Float4 y  = Float4::Load(centreY + i);
+        const Float4 z  = Float4::Load(centreZ + i);
+        const Float4 ex = Float4::Load(extentX + i);
+        const Float4 ey = Spheres ? ex : Float4::Load(extentY + i);
+        const Float4 ez = Spheres ? ex : Float4::Load(extentZ + i);
+
+        Float4 nearest = Float4::Set(0.0f);
+        for (int p = 0; p < 6; ++p)
+        {
+            Float4 distance = Float4::Set(planes.a[p]) * x + Float4::Set(planes.b[p]) * y + Float4::Set(planes.c[p]) * z +
+                              Float4::Set(planes.d[p]);
+            Float4 reach = Spheres ? ex : Float4::Set(absA[p]) * ex + Float4::Set(absB[p]) * ey + Float4::Set(absC[p]) * ez;
+            Float4 value = distance + reach;
+            nearest = (p == 0) ? value : Min(nearest, value);
+        }
+
+        float distances[4];
+        nearest.Store(distances);
+        for (int k = 0; k < 4; ++k)
+        {
+            visible[i + k] = (distances[k] >= 0) ? 1 : 0;
+            numVisible += visible[i + k];
+        }
+    }
+
+    for (; i < end; ++i)
+    {
+        float nearest = NearestPlaneDistance<Spheres>(planes, centreX[i], centreY[i], centreZ[i], extentX[i],
+                                                      Spheres ? 0 : extentY[i], Spheres ? 0 : extentZ[i]);
+        visible[i] = (nearest >= 0) ? 1 : 0;
+        numVisible += visible[i];
+    }
+    return numVisible;
+}
+
+
+// Run cull(begin, end) over the range 0->count, split across the thread pool if there is one and the list is big
+// enough. Returns the total number visible
+template <typename Cull>
+static int RunCulling(int count, ThreadPool* threads, const Cull& cull)
+{
+    if (count <= 0)  return 0;
+    if (threads == nullptr || threads->NumThreads() < 2 || count <= CULLING_GRAIN)  return cull(0, count);
+
+    std::atomic<int> numVisible(0);
+    threads->ParallelFor(count, CULLING_GRAIN, [&](int begin, int end) { numVisible += cull(begin, end); });
+    return numVisible;
+}
+
+
+int CullBoxes(const FrustumPlanes& planes, const BoundingBoxes& boxes, uint8_t* visible, ThreadPool* threads /*= nullptr*/)
+{
+    return RunCulling(boxes.Size(), threads, [&](int begin, int end)
+    {
+        return CullRange<false>(planes, boxes.centreX.data(), boxes.centreY.data(), boxes.centreZ.data(),
+                                boxes.extentX.data(), boxes.extentY.data(), boxes.extentZ.data(), visible, begin, end);
+    });
+}
+
+int CullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint8_t* visible, ThreadPool* threads /*= nullptr*/)
+{
+    return RunCulling(spheres.Size(), threads, [&](int begin, int end)
+    {
+        return CullRange<true>(planes, spheres.centreX.data(), spheres.centreY.data(), spheres.centreZ.data(),
+                               spheres.radius.data(), nullptr, nullptr, visible, begin, end);
+    });
+}
+
+
+const char* CullingInstructionSet()
+{
+#if defined(__AVX__)
+    return "AVX";
+#elif defined(FLOAT4_SSE)
+    return "SSE";
+#elif defined(FLOAT4_NEON)
+    return "NEON";
+#else
+    return "Scalar";
+#endif
+}
@@ -0,0 +1,131 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling - bounding volumes and testing them against the view of a camera
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Meshes find a bounding box and sphere for each sub-mesh as they load, and models transform them into world space
+// (Mesh::GetWorldBounds). Each frame the six planes of the camera's view frustum are taken from its view-projection
+// matrix and every object's bounds are tested against them, so objects wholly outside the view are not drawn.
+//
+// The bounds of a frame are held as separate arrays of centres and half sizes (BoundingBoxes, BoundingSpheres) so they
+// are tested many at once: eight per instruction with AVX when the build targets it (/arch:AVX or -mavx, as the app and
+// FrustumCullingBenchmark projects do), four with Float4 otherwise. Every version gives exactly the same result as IsBoxInFrustum / IsSphereInFrustum. A volume is culled
+// if it is wholly behind any one plane, so the test is conservative - a volume near a corner of the frustum can be
+// outside it but in front of every plane, and is kept.
+//
+// Pass a thread pool to split a list across its threads. Lists smaller than CULLING_GRAIN run on the calling thread.
+
+#ifndef _FRUSTUM_CULLING_H_INCLUDED_
+#define _FRUSTUM_CULLING_H_INCLUDED_
+
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+
+
+// Bounds each thread takes at a time when a list is split across a thread pool. Smaller lists are not split
+const int CULLING_GRAIN = 16384;
+
+
+/*-----------------------------------------------------------------------------------------
+    Bounding volumes
+-----------------------------------------------------------------------------------------*/
+
+// Axis-aligned box. Empty when minimum is greater than maximum, see EmptyBoundingBox
+struct BoundingBox
+{
+    CVector3 minimum;
+    CVector3 maximum;
+};
+
+struct BoundingSphere
+{
+    CVector3 centre;
+    float    radius;
+};
+
+// A box holding nothing, combining it with another box gives the other box
+BoundingBox EmptyBoundingBox();
+bool        IsEmpty(const BoundingBox& box);
+
+// A sphere holding nothing (negative radius), combining it with another sphere gives the other sphere
+BoundingSphere EmptyBoundingSphere();
+
+// Smallest box holding both boxes, and a sphere holding both spheres (the smallest unless either is empty)
+BoundingBox    Combine(const BoundingBox& a, const BoundingBox& b);
+BoundingSphere Combine(const BoundingSphere& a, const BoundingSphere& b);
+
+// Axis-aligned box holding the given box transformed by an affine matrix
+BoundingBox TransformBox(const BoundingBox& box, const CMatrix4x4& m);
+
+// Sphere holding the given sphere transformed by an affine matrix, the radius scaled by the largest scale of the matrix.
+// An empty sphere stays empty
+BoundingSphere TransformSphere(const BoundingSphere& sphere, const CMatrix4x4& m);
+
+// Bounds of points whose x, y and z are the first three floats of every stride bytes, e.g. the positions of interleaved
+// vertices. The sphere is centred on the box of the points, which is close to the smallest sphere for most meshes
+BoundingBox    BoxOfPoints(const void* points, int stride, int count);
+BoundingSphere SphereOfPoints(const void* points, int stride, int count);
+
+
+// Boxes held as separate arrays of centres and half sizes, for culling many at once. Empty boxes are never visible
+struct BoundingBoxes
+{
+    std::vector<float> centreX, centreY, centreZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void Add(const BoundingBox& box);
+    void Clear();
+    int  Size() const { return static_cast<int>(centreX.size()); }
+};
+
+// Spheres held as separate arrays of centres and radii. Empty spheres are never visible
+struct BoundingSpheres
+{
+    std::vector<float> centreX, centreY, centreZ;
+    std::vector<float> radius;
+
+    void Add(const BoundingSphere& sphere);
+    void Clear();
+    int  Size() const { return static_cast<int>(centreX.size()); }
+};
+
+
+/*-----------------------------------------------------------------------------------------
+    Frustum
+-----------------------------------------------------------------------------------------*/
+
+// The left, right, bottom, top, near and far planes of a view frustum, a point (x, y, z) is in front of plane i when
+// a[i] * x + b[i] * y + c[i] * z + d[i] >= 0. Normals point into the frustum and are unit length
+struct FrustumPlanes
+{
+    float a[6], b[6], c[6], d[6];
+};
+
+// Planes of the frustum of a view-projection matrix (e.g. Camera::ViewProjectionMatrix), the projection using the
+// Direct3D depth range of 0 to 1
+FrustumPlanes FrustumPlanesFromMatrix(const CMatrix4x4& viewProjection);
+
+// Whether a single volume is at least partly in front of every plane
+bool IsBoxInFrustum(const FrustumPlanes& planes, const BoundingBox& box);
+bool IsSphereInFrustum(const FrustumPlanes& planes, const BoundingSphere& sphere);
+
+
+/*-----------------------------------------------------------------------------------------
+    Culling lists
+-----------------------------------------------------------------------------------------*/
+
+// Set visible[i] to 1 for each volume at least partly in front of every plane, 0 otherwise. visible must have space for
+// one byte per volume. Returns the number visible
+int CullBoxes(const FrustumPlanes& planes, const BoundingBoxes& boxes, uint8_t* visible, ThreadPool* threads = nullptr);
+int CullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, uint8_t* visible, ThreadPool* threads = nullptr);
+
+// Instructions the culling lists use, "AVX", "SSE", "NEON" or "Scalar", for reports
+const char* CullingInstructionSet();
+
+
+#endif //_FRUSTUM_CULLING_H_INCLUDED_
@@ -10,7 +10,7 @@
 
 
 // Surprisingly, pi is not *officially* defined anywhere in C++
-const float PI = 3.14159265359f;
+constexpr float PI = 3.14159265359f;
 
 
 
@@ -44,31 +44,86 @@ constexpr float ToDegrees(float r)
 
 
 
+// Seeded random number generator (PCG32, see https://www.pcg-random.org). Unlike rand() it gives the same numbers for
+// the same seed with every compiler and library, so anything using random values can be repeated exactly
+class RandomGenerator
+{
+public:
+	explicit RandomGenerator(uint64_t seed = 0x853c49e6748fea9bull)
+	{
+		Seed(seed);
+	}
+
+	// Restart the sequence of numbers from a seed
+	void Seed(uint64_t seed)
+	{
+		mState = 0;
+		Next();
+		mState += seed;
+		Next();
+	}
+
+	// Random 32-bit integer, all values equally likely
+	uint32_t Next()
+	{
+		uint64_t old = mState;
+		mState = old * 6364136223846793005ull + 1442695040888963407ull;
+		uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+		uint32_t rotate = static_cast<uint32_t>(old >> 59);
+		return (xorShifted >> rotate) | (xorShifted << ((32 - rotate) & 31));
+	}
+
+	// Random integer from a to b (inclusive)
+	uint32_t Range(const uint32_t a, const uint32_t b)
+	{
+		return a + static_cast<uint32_t>((static_cast<uint64_t>(Next()) * (static_cast<uint64_t>(b - a) + 1)) >> 32);
+	}
+
+	// Random 32-bit float from a to b (inclusive), 2^24 different values spread evenly across the range
+	float Range(const float a, const float b)
+	{
+		return a + (b - a) * ((Next() >> 8) * (1.0f / 16777215.0f));
+	}
+
+	// Random 64-bit float from a to b (inclusive), 2^53 different values spread evenly across the range
+	double Range(const double a, const double b)
+	{
+		uint64_t bits = (static_cast<uint64_t>(Next() >> 5) << 26) | (Next() >> 6);
+		return a + (b - a) * (bits * (1.0 / 9007199254740991.0));
+	}
+
+private:
+	uint64_t mState;
+};
+
+// The generator used by the Random functions below. It starts with the same seed each run, call SeedRandom to change it
+inline RandomGenerator& DefaultRandomGenerator()
+{
+	static RandomGenerator generator;
+	return generator;
+}
+
+inline void SeedRandom(const uint64_t seed)
+{
+	DefaultRandomGenerator().Seed(seed);
+}
+
 // Return random integer from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
 inline uint32_t Random(const uint32_t a, const uint32_t b)
 {
-	// Could just use a + rand() % (b-a), but using a more complex form to allow range
-	// to exceed RAND_MAX and still return values spread across the range
-	uint32_t t = (b - a + 1) * rand();
-	return t == 0 ? a : a + (t - 1) / RAND_MAX;
+	return DefaultRandomGenerator().Range(a, b);
 }
 
 // Return random 32-bit float from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
 inline float Random(const float a, const float b)
 {
-	return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
+	return DefaultRandomGenerator().Range(a, b);
 }
 
 // Return random 64-bit float from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
 inline double Random(const double a, const double b)
 {
-	return a + (b - a) * (static_cast<double>(rand()) / RAND_MAX);
+	return DefaultRandomGenerator().Range(a, b);
 }
 
 // Keep a value within boundaries
@@ -0,0 +1,271 @@
+//--------------------------------------------------------------------------------------
+// Batch transforms - transform arrays of points, vectors and matrices at once
+//--------------------------------------------------------------------------------------
+
+#include "TransformBatch.h"
+#include "Float4.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+
+
+/*-----------------------------------------------------------------------------------------
+    Helpers
+-----------------------------------------------------------------------------------------*/
+
+// Run function(begin, end) over the range 0->count, split across the thread pool if there is one and the batch is
+// big enough
+template <typename Function>
+static void RunBatch(int count, ThreadPool* threads, const Function& function)
+{
+    if (count <= 0)  return;
+    if (threads == nullptr || threads->NumThreads() < 2 || count <= TRANSFORM_BATCH_GRAIN)
+    {
+        function(0, count);
+    }
+    else
+    {
+        threads->ParallelFor(count, TRANSFORM_BATCH_GRAIN, function);
+    }
+}
+
+static bool IsAligned(const void* p)
+{
+    return (reinterpret_cast<uintptr_t>(p) & 15) == 0;
+}
+
+// Whether an output of the given size should use streaming stores - large enough and on a 16-byte boundary
+static bool UseStreaming(const void* out, size_t bytes)
+{
+    return bytes >= STREAMING_STORE_BYTES && IsAligned(out);
+}
+
+template <bool Stream>
+static void StoreOutput(Float4 value, float* p)
+{
+    if (Stream)  value.StoreStream(p);
+    else         value.Store(p);
+}
+
+// Rows of a matrix
+struct MatrixRows
+{
+    Float4 r0, r1, r2, r3;
+
+    MatrixRows(const CMatrix4x4& m)
+        : r0(Float4::Load(&m.e00)), r1(Float4::Load(&m.e10)), r2(Float4::Load(&m.e20)), r3(Float4::Load(&m.e30)) {}
+
+    // A point (w = 1) transformed by the rows, summed in the same order as operator*. 1 * r3 is exactly r3
+    Float4 Point(float x, float y, float z) const
+    {
+        return ((Float4::Set(x) * r0 + Float4::Set(y) * r1) + Float4::Set(z) * r2) + r3;
+    }
+
+    // A vector (w = 0) transformed by the rows
+    Float4 Vector(float x, float y, float z) const
+    {
+        return (Float4::Set(x) * r0 + Float4::Set(y) * r1) + Float4::Set(z) * r2;
+    }
+};
+
+
+/*-----------------------------------------------------------------------------------------
+    Points and vectors - arrays of structures
+-----------------------------------------------------------------------------------------*/
+
+template <bool Stream>
+static void TransformPointsRange(const CVector3* points, CVector4* out, int begin, int end, const MatrixRows& rows)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        StoreOutput<Stream>(rows.Point(points[i].x, points[i].y, points[i].z), &out[i].x);
+    }
+    if (Stream)  StreamFence();
+}
+
+// Transform each point (w = 1) by the matrix, out[i] = CVector4(points[i], 1) * m
+void TransformPoints(const CVector3* points, CVector4* out, int count, const CMatrix4x4& m, ThreadPool* threads /*= nullptr*/)
+{
+    const MatrixRows rows(m);
+    const bool stream = UseStreaming(out, count * sizeof(CVector4));
+    RunBatch(count, threads, [&](int begin, int end)
+    {
+        if (stream)  TransformPointsRange<true> (points, out, begin, end, rows);
+        else         TransformPointsRange<false>(points, out, begin, end, rows);
+    });
+}
+
+
+// Transform a range of CVector3 points or vectors into CVector3s. Each result is stored as four floats, the fourth
+// landing on the x of the next output, which is written properly on the next step. The next input is read before that
+// store in case the output is the input. The last of the range is stored as three floats so as not to touch the next range
+template <bool Points>
+static void TransformVector3Range(const CVector3* in, CVector3* out, int begin, int end, const MatrixRows& rows)
+{
+    float x = in[begin].x, y = in[begin].y, z = in[begin].z;
+    for (int i = begin; i < end - 1; ++i)
+    {
+        Float4 result = Points ? rows.Point(x, y, z) : rows.Vector(x, y, z);
+        x = in[i + 1].x;  y = in[i + 1].y;  z = in[i + 1].z;
+        result.Store(&out[i].x);
+    }
+
+    float last[4];
+    (Points ? rows.Point(x, y, z) : rows.Vector(x, y, z)).Store(last);
+    out[end - 1] = CVector3(last[0], last[1], last[2]);
+}
+
+// Transform each point (w = 1) by an affine matrix, keeping x, y and z
+void TransformPoints(const CVector3* points, CVector3* out, int count, const CMatrix4x4& m, ThreadPool* threads /*= nullptr*/)
+{
+    const MatrixRows rows(m);
+    RunBatch(count, threads, [&](int begin, int end) { TransformVector3Range<true>(points, out, begin, end, rows); });
+}
+
+// Transform each vector (w = 0) by the matrix, keeping x, y and z
+void TransformVectors(const CVector3* vectors, CVector3* out, int count, const CMatrix4x4& m, ThreadPool* threads /*= nullptr*/)
+{
+    const MatrixRows rows(m);
+    RunBatch(count, threads, [&](int begin, int end) { TransformVector3Range<false>(vectors, out, begin, end, rows); });
+}
+
+
+template <bool Stream>
+static void TransformRange(const CVector4* v, CVector4* out, int begin, int end, const MatrixRows& rows)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        StoreOutput<Stream>(MultiplyRow(Float4::Load(&v[i].x), rows.r0, rows.r1, rows.r2, rows.r3), &out[i].x);
+    }
+    if (Stream)  StreamFence();
+}
+
+// Transform each CVector4 by the matrix, out[i] = v[i] * m
+void Transform(const CVector4* v, CVector4* out, int count, const CMatrix4x4& m, ThreadPool* threads /*= nullptr*/)
+{
+    const MatrixRows rows(m);
+    const bool stream = UseStreaming(out, count * sizeof(CVector4));
+    RunBatch(count, threads, [&](int begin, int end)
+    {
+        if (stream)  TransformRange<true> (v, out, begin, end, rows);
+        else         TransformRange<false>(v, out, begin, end, rows);
+    });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Points - structure of arrays
+-----------------------------------------------------------------------------------------*/
+
+// Four points at a time, then the last few one at a time. Outputs are only streamed when all of them are aligned at the
+// start of the range, which they are for aligned arrays as ranges start at multiples of TRANSFORM_BATCH_GRAIN
+template <bool Stream>
+static void TransformPointsSoARange(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ,
+                                    float* outW, int begin, int end, const CMatrix4x4& m)
+{
+    const Float4 e00 = Float4::Set(m.e00), e01 = Float4::Set(m.e01), e02 = Float4::Set(m.e02), e03 = Float4::Set(m.e03);
+    const Float4 e10 = Float4::Set(m.e10), e11 = Float4::Set(m.e11), e12 = Float4::Set(m.e12), e13 = Float4::Set(m.e13);
+    const Float4 e20 = Float4::Set(m.e20), e21 = Float4::Set(m.e21), e22 = Float4::Set(m.e22), e23 = Float4::Set(m.e23);
+    const Float4 e30 = Float4::Set(m.e30), e31 = Float4::Set(m.e31), e32 = Float4::Set(m.e32), e33 = Float4::Set(m.e33);
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        const Float4 px = Float4::Load(x + i);
+        const Float4 py = Float4::Load(y + i);
+        const Float4 pz = Float4::Load(z + i);
+        StoreOutput<Stream>(((px * e00 + py * e10) + pz * e20) + e30, outX + i);
+        StoreOutput<Stream>(((px * e01 + py * e11) + pz * e21) + e31, outY + i);
+        StoreOutput<Stream>(((px * e02 + py * e12) + pz * e22) + e32, outZ + i);
+        if (outW != nullptr)  StoreOutput<Stream>(((px * e03 + py * e13) + pz * e23) + e33, outW + i);
+    }
+    for (; i < end; ++i)
+    {
+        const float px = x[i], py = y[i], pz = z[i];
+        outX[i] = ((px * m.e00 + py * m.e10) + pz * m.e20) + m.e30;
+        outY[i] = ((px * m.e01 + py * m.e11) + pz * m.e21) + m.e31;
+        outZ[i] = ((px * m.e02 + py * m.e12) + pz * m.e22) + m.e32;
+        if (outW != nullptr)  outW[i] = ((px * m.e03 + py * m.e13) + pz * m.e23) + m.e33;
+    }
+    if (Stream)  StreamFence();
+}
+
+// Transform points held as separate x, y and z arrays (w = 1) by the matrix into separate output arrays
+void TransformPointsSoA(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, float* outW,
+                        int count, const CMatrix4x4& m, ThreadPool* threads /*= nullptr*/)
+{
+    const bool stream = count * sizeof(float) * (outW != nullptr ? 4 : 3) >= STREAMING_STORE_BYTES;
+    RunBatch(count, threads, [&](int begin, int end)
+    {
+        if (stream && IsAligned(outX + begin) && IsAligned(outY + begin) && IsAligned(outZ + begin) &&
+            (outW == nullptr || IsAligned(outW + begin)))
+        {
+            TransformPointsSoARange<true>(x, y, z, outX, outY, outZ, outW, begin, end, m);
+        }
+        else
+        {
+            TransformPointsSoARange<false>(x, y, z, outX, outY, outZ, outW, begin, end, m);
+        }
+    });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Matrices
+-----------------------------------------------------------------------------------------*/
+
+// out = m1 * the matrix with rows b. The rows of m1 are each read before the matching row of out is written, so out can
+// be m1
+template <bool Stream>
+static void MultiplyMatrixRows(const CMatrix4x4& m1, const MatrixRows& b, CMatrix4x4& out)
+{
+    StoreOutput<Stream>(MultiplyRow(Float4::Load(&m1.e00), b.r0, b.r1, b.r2, b.r3), &out.e00);
+    StoreOutput<Stream>(MultiplyRow(Float4::Load(&m1.e10), b.r0, b.r1, b.r2, b.r3), &out.e10);
+    StoreOutput<Stream>(MultiplyRow(Float4::Load(&m1.e20), b.r0, b.r1, b.r2, b.r3), &out.e20);
+    StoreOutput<Stream>(MultiplyRow(Float4::Load(&m1.e30), b.r0, b.r1, b.r2, b.r3), &out.e30);
+}
+
+template <bool Stream>
+static void MultiplyMatricesRange(const CMatrix4x4* m1, const CMatrix4x4* m2, CMatrix4x4* out, int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        const MatrixRows b(m2[i]); // Read all of m2 first in case out is m2
+        MultiplyMatrixRows<Stream>(m1[i], b, out[i]);
+    }
+    if (Stream)  StreamFence();
+}
+
+// Multiply pairs of matrices, out[i] = m1[i] * m2[i]
+void MultiplyMatrices(const CMatrix4x4* m1, const CMatrix4x4* m2, CMatrix4x4* out, int count, ThreadPool* threads /*= nullptr*/)
+{
+    const bool stream = UseStreaming(out, count * sizeof(CMatrix4x4));
+    RunBatch(count, threads, [&](int begin, int end)
+    {
+        if (stream)  MultiplyMatricesRange<true> (m1, m2, out, begin, end);
+        else         MultiplyMatricesRange<false>(m1, m2, out, begin, end);
+    });
+}
+
+
+template <bool Stream>
+static void MultiplyMatricesRange(const CMatrix4x4* m1, const MatrixRows& b, CMatrix4x4* out, int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        MultiplyMatrixRows<Stream>(m1[i], b, out[i]);
+    }
+    if (Stream)  StreamFence();
+}
+
+// Multiply each matrix by the same matrix, out[i] = m1[i] * m2
+void MultiplyMatrices(const CMatrix4x4* m1, const CMatrix4x4& m2, CMatrix4x4* out, int count, ThreadPool* threads /*= nullptr*/)
+{
+    const MatrixRows b(m2);
+    const bool stream = UseStreaming(out, count * sizeof(CMatrix4x4));
+    RunBatch(count, threads, [&](int begin, int end)
+    {
+        if (stream)  MultiplyMatricesRange<true> (m1, b, out, begin, end);
+        else         MultiplyMatricesRange<false>(m1, b, out, begin, end);
+    });
+}
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Batch transforms - transform arrays of points, vectors and matrices at once
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each function works through its arrays four floats at a time with Float4, so a batch costs much less than the same
+// number of separate operator* calls. Points and matrices give exactly the same results as operator* does.
+//
+// Points and vectors can be held as arrays of CVector3/CVector4 (array of structures) or as separate arrays of x, y,
+// z (and w) values (structure of arrays). Separate arrays transform four points per step, so they are the quicker layout
+// when there are many points.
+//
+// Pass a thread pool to split a batch across its threads. Batches smaller than TRANSFORM_BATCH_GRAIN run on the calling
+// thread. Outputs of at least STREAMING_STORE_BYTES that are on a 16-byte boundary are written with streaming stores,
+// which go straight to memory without filling the cache with values that won't be read again soon.
+
+#ifndef _TRANSFORM_BATCH_H_INCLUDED_
+#define _TRANSFORM_BATCH_H_INCLUDED_
+
+#include "CVector3.h"
+#include "CVector4.h"
+#include "CMatrix4x4.h"
+
+#include <cstddef>
+
+class ThreadPool;
+
+
+// Items each thread takes at a time when a batch is split across a thread pool. Smaller batches are not split
+const int TRANSFORM_BATCH_GRAIN = 4096;
+
+// Outputs of at least this many bytes use streaming stores
+const size_t STREAMING_STORE_BYTES = 4 * 1024 * 1024;
+
+
+/*-----------------------------------------------------------------------------------------
+    Points and vectors - arrays of structures
+-----------------------------------------------------------------------------------------*/
+
+// Transform each point (w = 1) by the matrix, out[i] = CVector4(points[i], 1) * m
+void TransformPoints(const CVector3* points, CVector4* out, int count, const CMatrix4x4& m, ThreadPool* threads = nullptr);
+
+// Transform each point (w = 1) by an affine matrix, keeping x, y and z. The output can be the same array as the input
+void TransformPoints(const CVector3* points, CVector3* out, int count, const CMatrix4x4& m, ThreadPool* threads = nullptr);
+
+// Transform each vector (w = 0) by the matrix, keeping x, y and z. The output can be the same array as the input
+void TransformVectors(const CVector3* vectors, CVector3* out, int count, const CMatrix4x4& m, ThreadPool* threads = nullptr);
+
+// Transform each CVector4 by the matrix, out[i] = v[i] * m. The output can be the same array as the input
+void Transform(const CVector4* v, CVector4* out, int count, const CMatrix4x4& m, ThreadPool* threads = nullptr);
+
+
+/*-----------------------------------------------------------------------------------------
+    Points - structure of arrays
+-----------------------------------------------------------------------------------------*/
+
+// Transform points held as separate x, y and z arrays (w = 1) by the matrix into separate output arrays. Pass nullptr for
+// outW to leave out w, e.g. for affine matrices. Outputs can be the same arrays as the inputs
+void TransformPointsSoA(const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, float* outW,
+                        int count, const CMatrix4x4& m, ThreadPool* threads = nullptr);
+
+
+/*-----------------------------------------------------------------------------------------
+    Matrices
+-----------------------------------------------------------------------------------------*/
+
+// Multiply pairs of matrices, out[i] = m1[i] * m2[i]. The output can be the same array as either input
+void MultiplyMatrices(const CMatrix4x4* m1, const CMatrix4x4* m2, CMatrix4x4* out, int count, ThreadPool* threads = nullptr);
+
+// Multiply each matrix by the same matrix, out[i] = m1[i] * m2, e.g. model matrices by a parent or view-projection
+// matrix. The output can be the same array as the input
+void MultiplyMatrices(const CMatrix4x4* m1, const CMatrix4x4& m2, CMatrix4x4* out, int count, ThreadPool* threads = nullptr);
+
+
+#endif //_TRANSFORM_BATCH_H_INCLUDED_
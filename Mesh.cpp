@@ -6,17 +6,12 @@
 // expected to select these things. A later lab will introduce a more robust loader.
 
 #include "Mesh.h"
-#include "Shader.h" // Needed for helper function CreateSignatureForVertexLayout
+#include "State.h" // Needed for FindOrCreateInputLayout
 #include "GraphicsHelpers.h" // Helper functions to unclutter the code here
-#include "CVector2.h" 
-#include "CVector3.h" 
+#include "MeshData.h"
+#include "MeshFile.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/DefaultLogger.hpp>
-
-#include <memory>
+#include <stdexcept>
 
 
 // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
@@ -24,339 +19,161 @@
 // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
 Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 {
-	Assimp::Importer importer;
-
-	// Flags for processing the mesh. Assimp provides a huge amount of control - right click any of these
-	// and "Peek Definition" to see documention above each constant
-	unsigned int assimpFlags = aiProcess_MakeLeftHanded |
-		aiProcess_GenSmoothNormals |
-		aiProcess_FixInfacingNormals |
-		aiProcess_GenUVCoords |
-		aiProcess_TransformUVCoords |
-		aiProcess_FlipUVs |
-		aiProcess_FlipWindingOrder |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_ImproveCacheLocality |
-		aiProcess_SortByPType |
-		aiProcess_FindInvalidData |
-		aiProcess_OptimizeMeshes |
-		aiProcess_FindInstances |
-		aiProcess_FindDegenerates |
-		aiProcess_RemoveRedundantMaterials |
-		aiProcess_Debone |
-		aiProcess_SplitByBoneCount |
-		aiProcess_LimitBoneWeights |
-		aiProcess_RemoveComponent;
-
-	// Flags to specify what mesh data to ignore
-	int removeComponents = aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_TEXTURES | aiComponent_COLORS |
-		aiComponent_ANIMATIONS | aiComponent_MATERIALS;
-
-	// Add / remove tangents as required by user
-	if (requireTangents)
-	{
-		assimpFlags |= aiProcess_CalcTangentSpace;
-	}
-	else
-	{
-		removeComponents |= aiComponent_TANGENTS_AND_BITANGENTS;
-	}
-
-	// Other miscellaneous settings
-	importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f); // Smoothing angle for normals
-	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);  // Remove points and lines (keep triangles only)
-	importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);                 // Remove degenerate triangles
-	importer.SetPropertyBool(AI_CONFIG_PP_DB_ALL_OR_NONE, true);            // Default to removing bones/weights from meshes that don't need skinning
-
-	// Set maximum bones that can affect one vertex, and also maximum bones affecting a single mesh
-	unsigned int maxBonesPerVertex = 4; // The shaders support 4 bones per verted (null bones are added if necessary)
-	unsigned int maxBonesPerMesh = 256; // Bone indexes are stored in a byte, so no more than 256 
-	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, maxBonesPerVertex);
-	importer.SetPropertyInteger(AI_CONFIG_PP_SBBC_MAX_BONES, maxBonesPerMesh);
-
-	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeComponents);
+	// Binary mesh files are mapped into memory and their vertices and indices go straight to the GPU. Other files are
+	// imported with assimp unless there is an up to date cooked binary file alongside them (see LoadMeshData)
+	MeshFile meshFile;
+	MeshData data;
+	LoadMeshData(fileName, requireTangents, meshFile, data);
+	CreateFromData(data, fileName);
+}
 
-	// Import mesh with assimp given above requirements - log output
-	Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
-	const aiScene* scene = importer.ReadFile(fileName, assimpFlags);
-	Assimp::DefaultLogger::kill();
-	if (scene == nullptr)  throw std::runtime_error("Error loading mesh (" + fileName + "). " + importer.GetErrorString());
-	if (scene->mNumMeshes == 0)  throw std::runtime_error("No usable geometry in mesh: " + fileName);
 
+// Create a mesh from data already loaded, e.g. on another thread with LoadMeshData. The name is used in error messages
+// Will throw a std::runtime_error exception on failure
+Mesh::Mesh(const MeshData& data, const std::string& name)
+{
+	CreateFromData(data, name);
+}
 
-	//-----------------------------------
 
+// Create the nodes and GPU buffers from imported or mapped mesh data
+void Mesh::CreateFromData(const MeshData& data, const std::string& fileName)
+{
 	//*********************************************************************//
 	// Read node hierachy - each node has a matrix and contains sub-meshes //
 
-	// Uses recursive helper functions to build node hierarchy    
-	mNodes.resize(CountNodes(scene->mRootNode));
-	ReadNodes(scene->mRootNode, 0, 0);
+	mNodes.resize(data.nodes.size());
+	for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		auto& node = mNodes[nodeIndex];
+		const auto& nodeData = data.nodes[nodeIndex];
+		node.name          = nodeData.name;
+		node.defaultMatrix = nodeData.defaultMatrix;
+		node.offsetMatrix  = nodeData.offsetMatrix;
+		node.parentIndex   = nodeData.parentIndex;
+		node.childNodes    = nodeData.childNodes;
+		node.subMeshes     = nodeData.subMeshes;
+	}
+	mHasBones = data.hasBones;
 
 
 
 	//******************************************//
 	// Read geometry - multiple parts supported //
 
-	mHasBones = false;
-	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
-		if (scene->mMeshes[m]->HasBones())  mHasBones = true;
-
-
 	// A mesh is made of sub-meshes, each one can have a different material (texture)
-	// Import each sub-mesh in the file to seperate index / vertex buffer (could share buffers between sub-meshes but that would make things more complex)
-	mSubMeshes.resize(scene->mNumMeshes);
-	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+	// Each sub-mesh has a seperate index / vertex buffer (could share buffers between sub-meshes but that would make things more complex)
+	mSubMeshes.resize(data.subMeshes.size());
+	for (unsigned int m = 0; m < mSubMeshes.size(); ++m)
 	{
-		aiMesh* assimpMesh = scene->mMeshes[m];
-		std::string subMeshName = assimpMesh->mName.C_Str();
+		const auto& subMeshData = data.subMeshes[m];
 		auto& subMesh = mSubMeshes[m]; // Short name for the submesh we're currently preparing - makes code below more readable
 
+		subMesh.vertexSize  = subMeshData.vertexSize;
+		subMesh.numVertices = subMeshData.numVertices;
+		subMesh.numIndices  = subMeshData.numIndices;
+
+		// Bounds for frustum culling, from the positions at the start of each vertex
+		subMesh.bounds = BoxOfPoints(subMeshData.vertices, subMesh.vertexSize, subMesh.numVertices);
+		subMesh.sphere = SphereOfPoints(subMeshData.vertices, subMesh.vertexSize, subMesh.numVertices);
+
 
 		//-----------------------------------
 
-		// Check for presence of position and normal data. Tangents and UVs are optional.
+		// Describe the vertex elements to DirectX, in the order MeshData stores them
 		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
 		unsigned int offset = 0;
 
-		if (!assimpMesh->HasPositions())  throw std::runtime_error("No position data for sub-mesh " + subMeshName + " in " + fileName);
-		unsigned int positionOffset = offset;
-		vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
 		offset += 12;
-
-		if (!assimpMesh->HasNormals())  throw std::runtime_error("No normal data for sub-mesh " + subMeshName + " in " + fileName);
-		unsigned int normalOffset = offset;
-		vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
 		offset += 12;
-
-		unsigned int tangentOffset = offset;
-		if (requireTangents)
+		if (subMeshData.vertexElements & MESH_TANGENTS)
 		{
-			if (!assimpMesh->HasTangentsAndBitangents())  throw std::runtime_error("No tangent data for sub-mesh " + subMeshName + " in " + fileName);
-			vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
 			offset += 12;
 		}
-
-		unsigned int uvOffset = offset;
-		if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
+		if (subMeshData.vertexElements & MESH_UVS)
 		{
-			if (assimpMesh->mNumUVComponents[0] != 2)  throw std::runtime_error("Unsupported texture coordinates in " + subMeshName + " in " + fileName);
-			vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, uvOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
 			offset += 8;
 		}
-
-		unsigned int bonesOffset = offset;
-		if (mHasBones)
-		{
-			vertexElements.push_back({ "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, bonesOffset,     D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 4;
-			vertexElements.push_back({ "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, bonesOffset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 16;
-		}
-
-		subMesh.vertexSize = offset;
-
-
-		// Create a "vertex layout" to describe to DirectX what is data in each vertex of this mesh
-		auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
-		HRESULT hr = gD3DDevice->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
-			shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
-			&subMesh.vertexLayout);
-		if (shaderSignature)  shaderSignature->Release();
-		if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
-
-
-
-		//-----------------------------------
-
-		// Create CPU-side buffers to hold current mesh data - exact content is flexible so can't use a structure for a vertex - so just a block of bytes
-		// Note: for large arrays a unique_ptr is better than a vector because vectors default-initialise all the values which is a waste of time.
-		subMesh.numVertices = assimpMesh->mNumVertices;
-		subMesh.numIndices = assimpMesh->mNumFaces * 3;
-		auto vertices = std::make_unique<unsigned char[]>(subMesh.numVertices * subMesh.vertexSize);
-		auto indices  = std::make_unique<unsigned char[]>(subMesh.numIndices * 4); // Using 32 bit indexes (4 bytes) for each indeex
-
-
-		//-----------------------------------
-
-		// Copy mesh data from assimp to our CPU-side vertex buffer
-
-		CVector3* assimpPosition = reinterpret_cast<CVector3*>(assimpMesh->mVertices);
-		unsigned char* position = vertices.get() + positionOffset;
-		unsigned char* positionEnd = position + subMesh.numVertices * subMesh.vertexSize;
-		while (position != positionEnd)
-		{
-			*(CVector3*)position = *assimpPosition;
-			position += subMesh.vertexSize;
-			++assimpPosition;
-		}
-
-		CVector3* assimpNormal = reinterpret_cast<CVector3*>(assimpMesh->mNormals);
-		unsigned char* normal = vertices.get() + normalOffset;
-		unsigned char* normalEnd = normal + subMesh.numVertices * subMesh.vertexSize;
-		while (normal != normalEnd)
-		{
-			*(CVector3*)normal = *assimpNormal;
-			normal += subMesh.vertexSize;
-			++assimpNormal;
-		}
-
-		if (requireTangents)
+		if (subMeshData.vertexElements & MESH_BONES)
 		{
-			CVector3* assimpTangent = reinterpret_cast<CVector3*>(assimpMesh->mTangents);
-			unsigned char* tangent = vertices.get() + tangentOffset;
-			unsigned char* tangentEnd = tangent + subMesh.numVertices * subMesh.vertexSize;
-			while (tangent != tangentEnd)
-			{
-				*(CVector3*)tangent = *assimpTangent;
-				tangent += subMesh.vertexSize;
-				++assimpTangent;
-			}
-		}
-
-		if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
-		{
-			aiVector3D* assimpUV = assimpMesh->mTextureCoords[0];
-			unsigned char* uv = vertices.get() + uvOffset;
-			unsigned char* uvEnd = uv + subMesh.numVertices * subMesh.vertexSize;
-			while (uv != uvEnd)
-			{
-				*(CVector2*)uv = CVector2(assimpUV->x, assimpUV->y);
-				uv += subMesh.vertexSize;
-				++assimpUV;
-			}
+			vertexElements.push_back({ "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, offset,     D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			vertexElements.push_back({ "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			offset += 20;
 		}
 
+		// Get a "vertex layout" to describe to DirectX what is data in each vertex of this mesh. Sub-meshes and other meshes
+		// with the same vertex elements share the layout (see State.h), each sub-mesh holds its own reference
+		subMesh.vertexLayout = FindOrCreateInputLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+		if (subMesh.vertexLayout == nullptr)  throw std::runtime_error("Failure creating input layout for " + fileName);
+		subMesh.vertexLayout->AddRef();
 
-		if (mHasBones)
+		// Instanced rendering reads a world matrix for each instance from a second buffer, a row at a time
+		if (!data.hasBones)
 		{
-			if (assimpMesh->HasBones())
+			for (unsigned int row = 0; row < 4; ++row)
 			{
-				// Set all bones and weights to 0 to start with
-				unsigned char* bones = vertices.get() + bonesOffset;
-				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-				while (bones != bonesEnd)
-				{
-					memset(bones, 0, 20);
-					bones += subMesh.vertexSize;
-				}
-
-				for (auto& node : mNodes)
-				{
-					node.offsetMatrix = MatrixIdentity();
-				}
-
-				// Go through each assimp bone
-				bones = vertices.get() + bonesOffset;
-				for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
-				{
-					// Get offset matrix for the bone (transform from skinned mesh root to bone root
-					aiBone* assimpBone = assimpMesh->mBones[i];
-					std::string boneName = assimpBone->mName.C_Str();
-					unsigned int nodeIndex;
-					for (nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-					{
-						if (mNodes[nodeIndex].name == boneName)
-						{
-							mNodes[nodeIndex].offsetMatrix.SetValues(&assimpBone->mOffsetMatrix.a1);
-							mNodes[nodeIndex].offsetMatrix.Transpose(); // Assimp stores matrices differently to this app
-							break;
-						}
-					}
-					if (nodeIndex == mNodes.size())  throw std::runtime_error("Bone with no matching node in " + fileName);
-
-					// Go through each weight of the bone and update the vertex it influences
-					// Find the first 0 weight on that vertex and put the new influence / weight there.
-					// A vertex can only have up to 4 influences
-					for (unsigned int j = 0; j < assimpBone->mNumWeights; ++j)
-					{
-						unsigned int vertexIndex = assimpBone->mWeights[j].mVertexId;
-						unsigned char* bone = bones + vertexIndex * subMesh.vertexSize;
-						float* weight = (float*)(bone + 4);
-						float* lastWeight = weight + 3;
-						while (*weight != 0.0f && weight != lastWeight)
-						{
-							bone++; weight++;
-						}
-						if (*weight == 0.0f)
-						{
-							*bone = nodeIndex;
-							*weight = assimpBone->mWeights[j].mWeight;
-						}
-					}
-				}
-			}
-			else
-			{
-				// In a mesh that uses skinning any sub-meshes that don't contain bones are given bones so the whole mesh can use one shader
-				unsigned int subMeshNode = 0;
-				for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-				{
-					for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
-					{
-						if (subMeshIndex == m)
-							subMeshNode = nodeIndex;
-					}
-				}
-
-				unsigned char* bones = vertices.get() + bonesOffset;
-				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-				while (bones != bonesEnd)
-				{
-					memset(bones, 0, 20);
-					bones[0] = subMeshNode;
-					*(float*)(bones + 4) = 1.0f;
-					bones += subMesh.vertexSize;
-				}
-
+				vertexElements.push_back({ "instanceWorld", row, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, row * 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 });
 			}
-		}
-
-
-
-		//-----------------------------------
-
-		// Copy face data from assimp to our CPU-side index buffer
-		if (!assimpMesh->HasFaces())  throw std::runtime_error("No face data in " + subMeshName + " in " + fileName);
-
-		DWORD* index = reinterpret_cast<DWORD*>(indices.get());
-		for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
-		{
-			*index++ = assimpMesh->mFaces[face].mIndices[0];
-			*index++ = assimpMesh->mFaces[face].mIndices[1];
-			*index++ = assimpMesh->mFaces[face].mIndices[2];
+			subMesh.instancedVertexLayout = FindOrCreateInputLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+			if (subMesh.instancedVertexLayout == nullptr)  throw std::runtime_error("Failure creating instanced input layout for " + fileName);
+			subMesh.instancedVertexLayout->AddRef();
 		}
 
 
 		//-----------------------------------
 
+		HRESULT hr;
 		D3D11_BUFFER_DESC bufferDesc;
 		D3D11_SUBRESOURCE_DATA initData;
 
-		// Create GPU-side vertex buffer and copy the vertices imported by assimp into it
+		// Create GPU-side vertex buffer and copy the vertices into it. When the data comes from a binary mesh file the
+		// vertices are read straight from the mapped file
 		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Indicate it is a vertex buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;          // Default usage for this buffer - we'll see other usages later
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;        // The mesh never changes after loading
 		bufferDesc.ByteWidth = subMesh.numVertices * subMesh.vertexSize; // Size of the buffer in bytes
 		bufferDesc.CPUAccessFlags = 0;
 		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = vertices.get(); // Fill the new vertex buffer with data loaded by assimp
+		initData.pSysMem = subMeshData.vertices;
 
 		hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.vertexBuffer);
 		if (FAILED(hr))  throw std::runtime_error("Failure creating vertex buffer for " + fileName);
 
 
-		// Create GPU-side index buffer and copy the vertices imported by assimp into it
+		// Create GPU-side index buffer and copy the indices into it
 		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER; // Indicate it is an index buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;         // Default usage for this buffer - we'll see other usages later
-		bufferDesc.ByteWidth = subMesh.numIndices * sizeof(DWORD); // Size of the buffer in bytes
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		bufferDesc.ByteWidth = subMesh.numIndices * sizeof(uint32_t); // Size of the buffer in bytes
 		bufferDesc.CPUAccessFlags = 0;
 		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = indices.get(); // Fill the new index buffer with data loaded by assimp
+		initData.pSysMem = subMeshData.indices;
 
 		hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer);
 		if (FAILED(hr))  throw std::runtime_error("Failure creating index buffer for " + fileName);
 	}
+
+
+	// Bounds of each node from its sub-meshes, and of the whole mesh for skinning
+	mBounds = EmptyBoundingBox();
+	mSphere = EmptyBoundingSphere();
+	for (auto& node : mNodes)
+	{
+		node.bounds = EmptyBoundingBox();
+		node.sphere = EmptyBoundingSphere();
+		for (auto& subMeshIndex : node.subMeshes)
+		{
+			node.bounds = Combine(node.bounds, mSubMeshes[subMeshIndex].bounds);
+			node.sphere = Combine(node.sphere, mSubMeshes[subMeshIndex].sphere);
+		}
+	}
+	for (auto& subMesh : mSubMeshes)
+	{
+		mBounds = Combine(mBounds, subMesh.bounds);
+		mSphere = Combine(mSphere, subMesh.sphere);
+	}
 }
 
 
@@ -367,6 +184,7 @@ Mesh::~Mesh()
 		if (subMesh.indexBuffer)   subMesh.indexBuffer ->Release();
 		if (subMesh.vertexBuffer)  subMesh.vertexBuffer->Release();
 		if (subMesh.vertexLayout)  subMesh.vertexLayout->Release();
+		if (subMesh.instancedVertexLayout)  subMesh.instancedVertexLayout->Release();
 	}
 }
 
@@ -402,8 +220,8 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
 void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices)
 {
 	// Skinning needs all matrices available in the shader at the same time, so first calculate all the absolute
-	// matrices before rendering anything
-	std::vector<CMatrix4x4> absoluteMatrices(modelMatrices.size());
+	// matrices before rendering anything. Aligned matrices as they are multiplied and copied a row at a time
+	std::vector<CMatrix4x4A> absoluteMatrices(modelMatrices.size());
 	absoluteMatrices[0] = modelMatrices[0]; // First matrix for a model is the root matrix, already in world space
 	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
 	{
@@ -470,45 +288,68 @@ void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices)
 }
 
 
-//--------------------------------------------------------------------------------------
-// Helper functions
-//--------------------------------------------------------------------------------------
-
-// Count the number of nodes with given assimp node as root - recursive
-unsigned int Mesh::CountNodes(aiNode* assimpNode)
+// Get the absolute world matrix of each node from a model's matrices, which are relative to their parent nodes
+void Mesh::GetAbsoluteMatrices(const std::vector<CMatrix4x4>& modelMatrices, CMatrix4x4* absoluteMatrices)
 {
-	unsigned int count = 1;
-	for (unsigned int child = 0; child < assimpNode->mNumChildren; ++child)
-		count += CountNodes(assimpNode->mChildren[child]);
-	return count;
+	// Same as the start of Render, the parent of each node comes before it
+	absoluteMatrices[0] = modelMatrices[0];
+	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		absoluteMatrices[nodeIndex] = modelMatrices[nodeIndex] * absoluteMatrices[mNodes[nodeIndex].parentIndex];
+	}
 }
 
 
-// Help build the arrays of submeshes and nodes from the assimp data - recursive
-unsigned int Mesh::ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex)
+// World space bounds of the mesh for a model's matrices. A rigid mesh is bounded by each node's bounds placed by its
+// absolute matrix. A skinned vertex is a weighted average of its position placed by each of its bones, so it is inside
+// the box holding the whole mesh placed by every bone matrix, whatever the pose
+BoundingBox Mesh::GetWorldBounds(const std::vector<CMatrix4x4>& modelMatrices)
 {
-	auto& node = mNodes[nodeIndex];
-	node.parentIndex = parentIndex;
-	unsigned int thisIndex = nodeIndex;
-	++nodeIndex;
+	std::vector<CMatrix4x4> absoluteMatrices(mNodes.size());
+	GetAbsoluteMatrices(modelMatrices, absoluteMatrices.data());
 
-	node.name = assimpNode->mName.C_Str();
+	BoundingBox bounds = EmptyBoundingBox();
+	for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		if (mHasBones)  bounds = Combine(bounds, TransformBox(mBounds, mNodes[nodeIndex].offsetMatrix * absoluteMatrices[nodeIndex]));
+		else            bounds = Combine(bounds, TransformBox(mNodes[nodeIndex].bounds, absoluteMatrices[nodeIndex]));
+	}
+	return bounds;
+}
 
-	node.defaultMatrix.SetValues(&assimpNode->mTransformation.a1);
-	node.defaultMatrix.Transpose(); // Assimp stores matrices differently to this app
+// As GetWorldBounds, for spheres
+BoundingSphere Mesh::GetWorldSphere(const std::vector<CMatrix4x4>& modelMatrices)
+{
+	std::vector<CMatrix4x4> absoluteMatrices(mNodes.size());
+	GetAbsoluteMatrices(modelMatrices, absoluteMatrices.data());
 
-	node.subMeshes.resize(assimpNode->mNumMeshes);
-	for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+	BoundingSphere sphere = EmptyBoundingSphere();
+	for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
 	{
-		node.subMeshes[i] = assimpNode->mMeshes[i];
+		if (mHasBones)  sphere = Combine(sphere, TransformSphere(mSphere, mNodes[nodeIndex].offsetMatrix * absoluteMatrices[nodeIndex]));
+		else            sphere = Combine(sphere, TransformSphere(mNodes[nodeIndex].sphere, absoluteMatrices[nodeIndex]));
 	}
+	return sphere;
+}
+
 
-	node.childNodes.resize(assimpNode->mNumChildren);
-	for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+// Render a node of the mesh for several instances, reading the world matrix of each from the instance buffer
+void Mesh::RenderInstanced(ID3D11Buffer* instanceBuffer, unsigned int node, unsigned int firstInstance, unsigned int numInstances)
+{
+	for (auto& subMeshIndex : mNodes[node].subMeshes)
 	{
-		node.childNodes[i] = nodeIndex;
-		nodeIndex = ReadNodes(assimpNode->mChildren[i], nodeIndex, thisIndex);
+		const SubMesh& subMesh = mSubMeshes[subMeshIndex];
+
+		// Vertices from the mesh's buffer in slot 0, instance matrices from the instance buffer in slot 1
+		ID3D11Buffer* vertexBuffers[2] = { subMesh.vertexBuffer, instanceBuffer };
+		UINT strides[2] = { subMesh.vertexSize, sizeof(CMatrix4x4) };
+		UINT offsets[2] = { 0, 0 };
+		gD3DContext->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		gD3DContext->IASetInputLayout(subMesh.instancedVertexLayout);
+		gD3DContext->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		// The instance number given to the shader starts at firstInstance, selecting the first matrix read
+		gD3DContext->DrawIndexedInstanced(subMesh.numIndices, numInstances, 0, 0, firstInstance);
 	}
-
-	return nodeIndex;
 }
@@ -6,12 +6,14 @@
 // expected to select these things
 
 #include "CMatrix4x4.h"
+#include "FrustumCulling.h"
 #define NOMINMAX // Use this to stop Windows headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
-#include <assimp/scene.h>
 #include <string>
 #include <vector>
 
+struct MeshData;
+
 #ifndef _MESH_H_INCLUDED_
 #define _MESH_H_INCLUDED_
 
@@ -22,10 +24,16 @@ class Mesh
 //--------------------------------------------------------------------------------------
 public:
 
-    // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
+    // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types, or pass
+    // a binary .mesh file (see MeshFile.h) to load it with no processing
     // Optionally request tangents to be calculated (for normal and parallax mapping - see later lab)
     // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
     Mesh(const std::string& fileName, bool requireTangents = false);
+
+    // Create a mesh from data already loaded, e.g. on another thread with LoadMeshData (see MeshFile.h). Only creates the
+    // GPU buffers so must be called on the thread that owns the Direct3D context. The name is used in error messages
+    // Will throw a std::runtime_error exception on failure
+    Mesh(const MeshData& data, const std::string& name);
     ~Mesh();
 
 
@@ -43,6 +51,24 @@ public:
 	void Render(std::vector<CMatrix4x4>& modelMatrices);
 
 
+	// Get the absolute world matrix of each node from a model's matrices, which are relative to their parent nodes.
+	// The output must have space for NumberNodes() matrices
+	void GetAbsoluteMatrices(const std::vector<CMatrix4x4>& modelMatrices, CMatrix4x4* absoluteMatrices);
+
+	// World space bounds of the mesh for a model's matrices (relative to parent nodes, as passed to Render), for frustum
+	// culling. Skinned meshes are bounded for any pose of their bones, so the bounds can be larger than the mesh
+	BoundingBox    GetWorldBounds(const std::vector<CMatrix4x4>& modelMatrices);
+	BoundingSphere GetWorldSphere(const std::vector<CMatrix4x4>& modelMatrices);
+
+	// Meshes with bones are skinned using the per-model constants, so can't be rendered instanced
+	bool CanRenderInstanced()  { return !mHasBones; }
+
+	// Render a node of the mesh for several instances, reading the world matrix of each from the instance buffer, which
+	// holds one CMatrix4x4 per instance (see InstanceBatcher.h). Needs an instanced vertex shader, e.g.
+	// PixelLightingInstanced_vs. The per-model constants are not used
+	void RenderInstanced(ID3D11Buffer* instanceBuffer, unsigned int node, unsigned int firstInstance, unsigned int numInstances);
+
+
 
 //--------------------------------------------------------------------------------------
 // Private data structures
@@ -55,6 +81,7 @@ private:
 	{
 		unsigned int       vertexSize = 0;         // Size in bytes of a single vertex (depends on what it contains, uvs, tangents etc.)
 		ID3D11InputLayout* vertexLayout = nullptr; // DirectX specification of data held in a single vertex
+		ID3D11InputLayout* instancedVertexLayout = nullptr; // As above plus a world matrix per instance from a second buffer. nullptr if the mesh has bones
 
 		// GPU-side vertex and index buffers
 		unsigned int       numVertices = 0;
@@ -62,6 +89,10 @@ private:
 
 		unsigned int       numIndices = 0;
 		ID3D11Buffer*      indexBuffer  = nullptr;
+
+		// Bounds of the vertices, in the space of the sub-mesh's node
+		BoundingBox        bounds;
+		BoundingSphere     sphere;
 	};
 
 
@@ -81,6 +112,9 @@ private:
 
 		std::vector<unsigned int> childNodes; // Child nodes that are controlled by this node (indexes into the mNodes vector below)
 		std::vector<unsigned int> subMeshes;  // The geometry representing this node (indexes into the mSubMeshes vector below)
+
+		BoundingBox    bounds; // Bounds of the node's sub-meshes, in the node's space. Empty if it has none
+		BoundingSphere sphere;
 	};
 
 
@@ -89,11 +123,8 @@ private:
 //--------------------------------------------------------------------------------------
 private:
 
-	// Count the number of nodes with given assimp node as root
-	unsigned int CountNodes(aiNode* assimpNode);
-
-	// Help build the arrays of submeshes and nodes from the assimp data - recursive
-	unsigned int ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex);
+	// Create the nodes and GPU buffers from imported or mapped mesh data
+	void CreateFromData(const MeshData& data, const std::string& fileName);
 
 	// Helper function for Render function - renders a given sub-mesh. World matrices / textures / states etc. must already be set
 	void RenderSubMesh(const SubMesh& subMesh);
@@ -108,6 +139,9 @@ private:
     std::vector<SubMesh> mSubMeshes; // The mesh geometry. Nodes refer to sub-meshes in this vector
     std::vector<Node>    mNodes;     // The mesh hierarchy. First entry is root. remainder aree stored in depth-first order
 
+	BoundingBox    mBounds; // Bounds of all the sub-meshes, used for skinned meshes whose vertices are all in the mesh's space
+	BoundingSphere mSphere;
+
 	bool mHasBones; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
 };
 
@@ -0,0 +1,365 @@
+//--------------------------------------------------------------------------------------
+// Mesh data - the CPU-side content of a mesh, ready to upload to the GPU
+//--------------------------------------------------------------------------------------
+
+#include "MeshData.h"
+#include "CVector2.h"
+#include "CVector3.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/DefaultLogger.hpp>
+
+#include <stdexcept>
+#include <cstring>
+#include <mutex>
+
+
+// Size in bytes of a vertex with the given optional elements
+uint32_t MeshVertexSize(uint32_t vertexElements)
+{
+	uint32_t size = 12 + 12; // Position and normal
+	if (vertexElements & MESH_TANGENTS)  size += 12;
+	if (vertexElements & MESH_UVS)       size += 8;
+	if (vertexElements & MESH_BONES)     size += 4 + 16;
+	return size;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Node hierarchy
+//--------------------------------------------------------------------------------------
+
+// Count the number of nodes with given assimp node as root - recursive
+static unsigned int CountNodes(aiNode* assimpNode)
+{
+	unsigned int count = 1;
+	for (unsigned int child = 0; child < assimpNode->mNumChildren; ++child)
+		count += CountNodes(assimpNode->mChildren[child]);
+	return count;
+}
+
+
+// Help build the array of nodes from the assimp data - recursive
+static unsigned int ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex, std::vector<MeshNodeData>& nodes)
+{
+	auto& node = nodes[nodeIndex];
+	node.parentIndex = parentIndex;
+	unsigned int thisIndex = nodeIndex;
+	++nodeIndex;
+
+	node.name = assimpNode->mName.C_Str();
+
+	node.defaultMatrix.SetValues(&assimpNode->mTransformation.a1);
+	node.defaultMatrix.Transpose(); // Assimp stores matrices differently to this app
+
+	node.subMeshes.resize(assimpNode->mNumMeshes);
+	for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+	{
+		node.subMeshes[i] = assimpNode->mMeshes[i];
+	}
+
+	node.childNodes.resize(assimpNode->mNumChildren);
+	for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+	{
+		node.childNodes[i] = nodeIndex;
+		nodeIndex = ReadNodes(assimpNode->mChildren[i], nodeIndex, thisIndex, nodes);
+	}
+
+	return nodeIndex;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Import
+//--------------------------------------------------------------------------------------
+
+// Import a mesh file of any type assimp supports, optionally calculating tangents
+// Will throw a std::runtime_error exception on failure
+void ImportMesh(const std::string& fileName, bool requireTangents, MeshData& data)
+{
+	Assimp::Importer importer;
+
+	// Flags for processing the mesh. Assimp provides a huge amount of control - right click any of these
+	// and "Peek Definition" to see documention above each constant
+	unsigned int assimpFlags = aiProcess_MakeLeftHanded |
+		aiProcess_GenSmoothNormals |
+		aiProcess_FixInfacingNormals |
+		aiProcess_GenUVCoords |
+		aiProcess_TransformUVCoords |
+		aiProcess_FlipUVs |
+		aiProcess_FlipWindingOrder |
+		aiProcess_Triangulate |
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_ImproveCacheLocality |
+		aiProcess_SortByPType |
+		aiProcess_FindInvalidData |
+		aiProcess_OptimizeMeshes |
+		aiProcess_FindInstances |
+		aiProcess_FindDegenerates |
+		aiProcess_RemoveRedundantMaterials |
+		aiProcess_Debone |
+		aiProcess_SplitByBoneCount |
+		aiProcess_LimitBoneWeights |
+		aiProcess_RemoveComponent;
+
+	// Flags to specify what mesh data to ignore
+	int removeComponents = aiComponent_LIGHTS | aiComponent_CAMERAS | aiComponent_TEXTURES | aiComponent_COLORS |
+		aiComponent_ANIMATIONS | aiComponent_MATERIALS;
+
+	// Add / remove tangents as required by user
+	if (requireTangents)
+	{
+		assimpFlags |= aiProcess_CalcTangentSpace;
+	}
+	else
+	{
+		removeComponents |= aiComponent_TANGENTS_AND_BITANGENTS;
+	}
+
+	// Other miscellaneous settings
+	importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f); // Smoothing angle for normals
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);  // Remove points and lines (keep triangles only)
+	importer.SetPropertyBool(AI_CONFIG_PP_FD_REMOVE, true);                 // Remove degenerate triangles
+	importer.SetPropertyBool(AI_CONFIG_PP_DB_ALL_OR_NONE, true);            // Default to removing bones/weights from meshes that don't need skinning
+
+	// Set maximum bones that can affect one vertex, and also maximum bones affecting a single mesh
+	unsigned int maxBonesPerVertex = 4; // The shaders support 4 bones per verted (null bones are added if necessary)
+	unsigned int maxBonesPerMesh = 256; // Bone indexes are stored in a byte, so no more than 256
+	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, maxBonesPerVertex);
+	importer.SetPropertyInteger(AI_CONFIG_PP_SBBC_MAX_BONES, maxBonesPerMesh);
+
+	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeComponents);
+
+	// Import mesh with assimp given above requirements - log output. The logger is shared by all importers, so it is
+	// created once and kept rather than created and destroyed around each import, which would break imports running on
+	// other threads
+	static std::once_flag createLogger;
+	std::call_once(createLogger, []() { Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE); });
+	const aiScene* scene = importer.ReadFile(fileName, assimpFlags);
+	if (scene == nullptr)  throw std::runtime_error("Error loading mesh (" + fileName + "). " + importer.GetErrorString());
+	if (scene->mNumMeshes == 0)  throw std::runtime_error("No usable geometry in mesh: " + fileName);
+
+
+	//-----------------------------------
+
+	//*********************************************************************//
+	// Read node hierachy - each node has a matrix and contains sub-meshes //
+
+	// Uses recursive helper functions to build node hierarchy
+	auto& nodes = data.nodes;
+	nodes.clear();
+	nodes.resize(CountNodes(scene->mRootNode));
+	ReadNodes(scene->mRootNode, 0, 0, nodes);
+
+
+
+	//******************************************//
+	// Read geometry - multiple parts supported //
+
+	data.hasBones = false;
+	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+		if (scene->mMeshes[m]->HasBones())  data.hasBones = true;
+
+
+	// A mesh is made of sub-meshes, each one can have a different material (texture)
+	data.subMeshes.clear();
+	data.subMeshes.resize(scene->mNumMeshes);
+	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+	{
+		aiMesh* assimpMesh = scene->mMeshes[m];
+		std::string subMeshName = assimpMesh->mName.C_Str();
+		auto& subMesh = data.subMeshes[m]; // Short name for the submesh we're currently preparing - makes code below more readable
+
+
+		//-----------------------------------
+
+		// Check for presence of position and normal data. Tangents and UVs are optional.
+		if (!assimpMesh->HasPositions())  throw std::runtime_error("No position data for sub-mesh " + subMeshName + " in " + fileName);
+		if (!assimpMesh->HasNormals())  throw std::runtime_error("No normal data for sub-mesh " + subMeshName + " in " + fileName);
+		if (requireTangents)
+		{
+			if (!assimpMesh->HasTangentsAndBitangents())  throw std::runtime_error("No tangent data for sub-mesh " + subMeshName + " in " + fileName);
+			subMesh.vertexElements |= MESH_TANGENTS;
+		}
+		if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
+		{
+			if (assimpMesh->mNumUVComponents[0] != 2)  throw std::runtime_error("Unsupported texture coordinates in " + subMeshName + " in " + fileName);
+			subMesh.vertexElements |= MESH_UVS;
+		}
+		if (data.hasBones)  subMesh.vertexElements |= MESH_BONES;
+
+		// Offsets of each element in the vertex
+		unsigned int positionOffset = 0;
+		unsigned int normalOffset   = 12;
+		unsigned int tangentOffset  = 24;
+		unsigned int uvOffset       = tangentOffset + ((subMesh.vertexElements & MESH_TANGENTS) ? 12 : 0);
+		unsigned int bonesOffset    = uvOffset      + ((subMesh.vertexElements & MESH_UVS)      ?  8 : 0);
+		subMesh.vertexSize = MeshVertexSize(subMesh.vertexElements);
+
+
+		//-----------------------------------
+
+		// CPU-side buffers to hold the mesh data - exact content is flexible so can't use a structure for a vertex - so just a block of bytes
+		subMesh.numVertices = assimpMesh->mNumVertices;
+		subMesh.numIndices = assimpMesh->mNumFaces * 3;
+		subMesh.vertexStorage.resize(subMesh.numVertices * subMesh.vertexSize);
+		subMesh.indexStorage.resize(subMesh.numIndices);
+		unsigned char* vertices = subMesh.vertexStorage.data();
+
+
+		//-----------------------------------
+
+		// Copy mesh data from assimp to our CPU-side vertex buffer
+
+		CVector3* assimpPosition = reinterpret_cast<CVector3*>(assimpMesh->mVertices);
+		unsigned char* position = vertices + positionOffset;
+		unsigned char* positionEnd = position + subMesh.numVertices * subMesh.vertexSize;
+		while (position != positionEnd)
+		{
+			*(CVector3*)position = *assimpPosition;
+			position += subMesh.vertexSize;
+			++assimpPosition;
+		}
+
+		CVector3* assimpNormal = reinterpret_cast<CVector3*>(assimpMesh->mNormals);
+		unsigned char* normal = vertices + normalOffset;
+		unsigned char* normalEnd = normal + subMesh.numVertices * subMesh.vertexSize;
+		while (normal != normalEnd)
+		{
+			*(CVector3*)normal = *assimpNormal;
+			normal += subMesh.vertexSize;
+			++assimpNormal;
+		}
+
+		if (subMesh.vertexElements & MESH_TANGENTS)
+		{
+			CVector3* assimpTangent = reinterpret_cast<CVector3*>(assimpMesh->mTangents);
+			unsigned char* tangent = vertices + tangentOffset;
+			unsigned char* tangentEnd = tangent + subMesh.numVertices * subMesh.vertexSize;
+			while (tangent != tangentEnd)
+			{
+				*(CVector3*)tangent = *assimpTangent;
+				tangent += subMesh.vertexSize;
+				++assimpTangent;
+			}
+		}
+
+		if (subMesh.vertexElements & MESH_UVS)
+		{
+			aiVector3D* assimpUV = assimpMesh->mTextureCoords[0];
+			unsigned char* uv = vertices + uvOffset;
+			unsigned char* uvEnd = uv + subMesh.numVertices * subMesh.vertexSize;
+			while (uv != uvEnd)
+			{
+				*(CVector2*)uv = CVector2(assimpUV->x, assimpUV->y);
+				uv += subMesh.vertexSize;
+				++assimpUV;
+			}
+		}
+
+
+		if (data.hasBones)
+		{
+			if (assimpMesh->HasBones())
+			{
+				// Set all bones and weights to 0 to start with
+				unsigned char* bones = vertices + bonesOffset;
+				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
+				while (bones != bonesEnd)
+				{
+					memset(bones, 0, 20);
+					bones += subMesh.vertexSize;
+				}
+
+				for (auto& node : nodes)
+				{
+					node.offsetMatrix = MatrixIdentity();
+				}
+
+				// Go through each assimp bone
+				bones = vertices + bonesOffset;
+				for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
+				{
+					// Get offset matrix for the bone (transform from skinned mesh root to bone root
+					aiBone* assimpBone = assimpMesh->mBones[i];
+					std::string boneName = assimpBone->mName.C_Str();
+					unsigned int nodeIndex;
+					for (nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+					{
+						if (nodes[nodeIndex].name == boneName)
+						{
+							nodes[nodeIndex].offsetMatrix.SetValues(&assimpBone->mOffsetMatrix.a1);
+							nodes[nodeIndex].offsetMatrix.Transpose(); // Assimp stores matrices differently to this app
+							break;
+						}
+					}
+					if (nodeIndex == nodes.size())  throw std::runtime_error("Bone with no matching node in " + fileName);
+
+					// Go through each weight of the bone and update the vertex it influences
+					// Find the first 0 weight on that vertex and put the new influence / weight there.
+					// A vertex can only have up to 4 influences
+					for (unsigned int j = 0; j < assimpBone->mNumWeights; ++j)
+					{
+						unsigned int vertexIndex = assimpBone->mWeights[j].mVertexId;
+						unsigned char* bone = bones + vertexIndex * subMesh.vertexSize;
+						float* weight = (float*)(bone + 4);
+						float* lastWeight = weight + 3;
+						while (*weight != 0.0f && weight != lastWeight)
+						{
+							bone++; weight++;
+						}
+						if (*weight == 0.0f)
+						{
+							*bone = nodeIndex;
+							*weight = assimpBone->mWeights[j].mWeight;
+						}
+					}
+				}
+			}
+			else
+			{
+				// In a mesh that uses skinning any sub-meshes that don't contain bones are given bones so the whole mesh can use one shader
+				unsigned int subMeshNode = 0;
+				for (unsigned int nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex)
+				{
+					for (auto& subMeshIndex : nodes[nodeIndex].subMeshes)
+					{
+						if (subMeshIndex == m)
+							subMeshNode = nodeIndex;
+					}
+				}
+
+				unsigned char* bones = vertices + bonesOffset;
+				unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
+				while (bones != bonesEnd)
+				{
+					memset(bones, 0, 20);
+					bones[0] = subMeshNode;
+					*(float*)(bones + 4) = 1.0f;
+					bones += subMesh.vertexSize;
+				}
+
+			}
+		}
+
+
+
+		//-----------------------------------
+
+		// Copy face data from assimp to our CPU-side index buffer
+		if (!assimpMesh->HasFaces())  throw std::runtime_error("No face data in " + subMeshName + " in " + fileName);
+
+		uint32_t* index = subMesh.indexStorage.data();
+		for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
+		{
+			*index++ = assimpMesh->mFaces[face].mIndices[0];
+			*index++ = assimpMesh->mFaces[face].mIndices[1];
+			*index++ = assimpMesh->mFaces[face].mIndices[2];
+		}
+
+		subMesh.vertices = subMesh.vertexStorage.data();
+		subMesh.indices  = subMesh.indexStorage.data();
+	}
+}
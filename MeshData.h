@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------
+// Mesh data - the CPU-side content of a mesh, ready to upload to the GPU
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Holds the node hierarchy and, for each sub-mesh, the final interleaved vertices and 32-bit indices. A Mesh is created
+// from this data with no further work per vertex. The data comes either from importing a mesh file with assimp
+// (ImportMesh, slow) or from a binary mesh file (MeshFile.h, fast), which is itself written from imported data
+//
+// Vertex layout, in this order: position (float3), normal (float3), tangent (float3, MESH_TANGENTS only),
+// uv (float2, MESH_UVS only), bones (4 x uint8) and weights (float4) (MESH_BONES only)
+
+#ifndef _MESH_DATA_H_INCLUDED_
+#define _MESH_DATA_H_INCLUDED_
+
+#include "CMatrix4x4.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Optional elements of a vertex, combine these for MeshSubMeshData::vertexElements
+const uint32_t MESH_TANGENTS = 1;
+const uint32_t MESH_UVS      = 2;
+const uint32_t MESH_BONES    = 4;
+
+// Size in bytes of a vertex with the given optional elements
+uint32_t MeshVertexSize(uint32_t vertexElements);
+
+
+// A node of the hierarchy, see Mesh::Node
+struct MeshNodeData
+{
+	std::string name;
+	CMatrix4x4  defaultMatrix = MatrixIdentity();
+	CMatrix4x4  offsetMatrix  = MatrixIdentity();
+	uint32_t    parentIndex   = 0;
+
+	std::vector<uint32_t> childNodes;
+	std::vector<uint32_t> subMeshes;
+};
+
+// Geometry of a sub-mesh. vertices and indices point either to the storage vectors or into a mapped mesh file
+struct MeshSubMeshData
+{
+	uint32_t vertexElements = 0; // Combination of MESH_TANGENTS, MESH_UVS and MESH_BONES
+	uint32_t vertexSize     = 0;
+	uint32_t numVertices    = 0;
+	uint32_t numIndices     = 0;
+
+	const unsigned char* vertices = nullptr;
+	const uint32_t*      indices  = nullptr;
+
+	std::vector<unsigned char> vertexStorage;
+	std::vector<uint32_t>      indexStorage;
+
+	// Moving keeps the storage, so the pointers stay valid. A copy would point to the original's storage
+	MeshSubMeshData() {}
+	MeshSubMeshData(MeshSubMeshData&&) = default;
+	MeshSubMeshData& operator=(MeshSubMeshData&&) = default;
+	MeshSubMeshData(const MeshSubMeshData&) = delete;
+	MeshSubMeshData& operator=(const MeshSubMeshData&) = delete;
+};
+
+struct MeshData
+{
+	std::vector<MeshNodeData>    nodes;     // First entry is root, the rest in depth-first order
+	std::vector<MeshSubMeshData> subMeshes;
+	bool                         hasBones = false;
+};
+
+
+// Import a mesh file of any type assimp supports (http://www.assimp.org/), optionally calculating tangents
+// Will throw a std::runtime_error exception on failure
+void ImportMesh(const std::string& fileName, bool requireTangents, MeshData& data);
+
+
+#endif //_MESH_DATA_H_INCLUDED_
@@ -0,0 +1,364 @@
+//--------------------------------------------------------------------------------------
+// Binary mesh file - mesh data saved in a form that loads with no processing
+//--------------------------------------------------------------------------------------
+
+#include "MeshFile.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+
+//--------------------------------------------------------------------------------------
+// File structures
+//--------------------------------------------------------------------------------------
+
+// Header flags
+const uint32_t MESH_FILE_TANGENTS = 1; // Tangents were requested when importing
+const uint32_t MESH_FILE_BONES    = 2; // The mesh has bones, every sub-mesh has bones and weights
+
+struct MeshFileHeader
+{
+	char     magic[4];         // "MESH"
+	uint32_t version;          // MESH_FILE_VERSION
+	uint32_t flags;            // MESH_FILE_TANGENTS, MESH_FILE_BONES
+	uint32_t numNodes;
+	uint32_t numSubMeshes;
+	uint32_t numNodeIndices;   // Child node and sub-mesh indices of all the nodes
+	uint32_t namesSize;        // Bytes of node names
+	uint32_t padding;
+	uint64_t sourceSize;       // Size and modification time of the file the mesh was imported from, 0 if not known
+	uint64_t sourceTime;
+	uint64_t nodesOffset;
+	uint64_t nodeIndicesOffset;
+	uint64_t namesOffset;
+	uint64_t subMeshesOffset;
+	uint64_t fileSize;         // Size of the whole file, to catch files cut short
+};
+
+struct MeshFileNode
+{
+	CMatrix4x4 defaultMatrix;
+	CMatrix4x4 offsetMatrix;
+	uint32_t   parentIndex;
+	uint32_t   nameOffset;     // Into the names
+	uint32_t   nameLength;
+	uint32_t   firstChild;     // Into the node indices
+	uint32_t   numChildren;
+	uint32_t   firstSubMesh;   // Into the node indices
+	uint32_t   numSubMeshes;
+	uint32_t   padding;
+};
+
+struct MeshFileSubMesh
+{
+	uint32_t vertexElements;
+	uint32_t vertexSize;
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint64_t verticesOffset;
+	uint64_t indicesOffset;
+};
+
+static_assert(sizeof(MeshFileHeader) == 88 && sizeof(MeshFileNode) == 160 && sizeof(MeshFileSubMesh) == 32,
+              "Mesh file structures must have no padding");
+
+
+// Round up to a multiple of 16
+static uint64_t Align16(uint64_t offset)
+{
+	return (offset + 15) & ~static_cast<uint64_t>(15);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Reading
+//--------------------------------------------------------------------------------------
+
+// Map a binary mesh file and fill in the mesh data
+bool MeshFile::Read(const std::string& fileName, MeshData& data)
+{
+	if (!mFile.Open(fileName))
+	{
+		mLastError = mFile.LastError();
+		return false;
+	}
+	if (!ReadMapped(fileName, data))
+	{
+		mFile.Close();
+		return false;
+	}
+	return true;
+}
+
+
+// Read the cooked mesh file for a source mesh file if it is up to date
+bool MeshFile::ReadCooked(const std::string& sourceFileName, bool requireTangents, MeshData& data)
+{
+	uint64_t sourceSize, sourceTime;
+	if (!GetFileSizeAndTime(sourceFileName, sourceSize, sourceTime))
+	{
+		mLastError = "Cannot find " + sourceFileName;
+		return false;
+	}
+
+	std::string fileName = CookedMeshFileName(sourceFileName);
+	if (!mFile.Open(fileName))
+	{
+		mLastError = mFile.LastError();
+		return false;
+	}
+
+	// Only the header is checked here, ReadMapped checks the rest
+	if (mFile.Size() >= sizeof(MeshFileHeader))
+	{
+		const MeshFileHeader& header = *reinterpret_cast<const MeshFileHeader*>(mFile.Data());
+		if (header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+		    ((header.flags & MESH_FILE_TANGENTS) != 0) != requireTangents)
+		{
+			mLastError = fileName + " is out of date";
+			mFile.Close();
+			return false;
+		}
+	}
+
+	if (!ReadMapped(fileName, data))
+	{
+		mFile.Close();
+		return false;
+	}
+	return true;
+}
+
+
+// Check the mapped file and fill in the mesh data from it. Everything read is checked to be inside the file, but the
+// vertices and indices themselves are not looked at
+bool MeshFile::ReadMapped(const std::string& fileName, MeshData& data)
+{
+	const unsigned char* file = mFile.Data();
+	const uint64_t fileSize = mFile.Size();
+
+	// Whether count items of the given size starting at offset lie within the file
+	auto inFile = [fileSize](uint64_t offset, uint64_t count, uint64_t size)
+	{
+		return offset <= fileSize && count <= (fileSize - offset) / size;
+	};
+
+	const MeshFileHeader& header = *reinterpret_cast<const MeshFileHeader*>(file);
+	if (fileSize < sizeof(MeshFileHeader) || memcmp(header.magic, "MESH", 4) != 0)
+	{
+		mLastError = fileName + " is not a mesh file";
+		return false;
+	}
+	if (header.version != MESH_FILE_VERSION)
+	{
+		mLastError = fileName + " is an unsupported mesh file version";
+		return false;
+	}
+	if (header.fileSize != fileSize || header.numNodes == 0 || header.numSubMeshes == 0 ||
+	    !inFile(header.nodesOffset,       header.numNodes,       sizeof(MeshFileNode))    ||
+	    !inFile(header.nodeIndicesOffset, header.numNodeIndices, sizeof(uint32_t))        ||
+	    !inFile(header.namesOffset,       header.namesSize,      1)                       ||
+	    !inFile(header.subMeshesOffset,   header.numSubMeshes,   sizeof(MeshFileSubMesh)) ||
+	    (header.nodesOffset | header.nodeIndicesOffset | header.subMeshesOffset) % 16 != 0)
+	{
+		mLastError = fileName + " is damaged or cut short";
+		return false;
+	}
+	const MeshFileNode*    fileNodes     = reinterpret_cast<const MeshFileNode*>(file + header.nodesOffset);
+	const uint32_t*        nodeIndices   = reinterpret_cast<const uint32_t*>(file + header.nodeIndicesOffset);
+	const char*            names         = reinterpret_cast<const char*>(file + header.namesOffset);
+	const MeshFileSubMesh* fileSubMeshes = reinterpret_cast<const MeshFileSubMesh*>(file + header.subMeshesOffset);
+
+	// Nodes are small so are copied
+	data.hasBones = (header.flags & MESH_FILE_BONES) != 0;
+	data.nodes.clear();
+	data.nodes.resize(header.numNodes);
+	for (uint32_t n = 0; n < header.numNodes; ++n)
+	{
+		const MeshFileNode& fileNode = fileNodes[n];
+		if (fileNode.parentIndex >= header.numNodes ||
+		    static_cast<uint64_t>(fileNode.nameOffset)   + fileNode.nameLength   > header.namesSize ||
+		    static_cast<uint64_t>(fileNode.firstChild)   + fileNode.numChildren  > header.numNodeIndices ||
+		    static_cast<uint64_t>(fileNode.firstSubMesh) + fileNode.numSubMeshes > header.numNodeIndices)
+		{
+			mLastError = fileName + " has a damaged node";
+			return false;
+		}
+
+		MeshNodeData& node = data.nodes[n];
+		node.name.assign(names + fileNode.nameOffset, fileNode.nameLength);
+		node.defaultMatrix = fileNode.defaultMatrix;
+		node.offsetMatrix  = fileNode.offsetMatrix;
+		node.parentIndex   = fileNode.parentIndex;
+		node.childNodes.assign(nodeIndices + fileNode.firstChild,   nodeIndices + fileNode.firstChild   + fileNode.numChildren);
+		node.subMeshes .assign(nodeIndices + fileNode.firstSubMesh, nodeIndices + fileNode.firstSubMesh + fileNode.numSubMeshes);
+		for (uint32_t child : node.childNodes)
+		{
+			if (child >= header.numNodes)  { mLastError = fileName + " has a damaged node";  return false; }
+		}
+		for (uint32_t subMesh : node.subMeshes)
+		{
+			if (subMesh >= header.numSubMeshes)  { mLastError = fileName + " has a damaged node";  return false; }
+		}
+	}
+
+	// Sub-mesh geometry points into the file
+	data.subMeshes.clear();
+	data.subMeshes.resize(header.numSubMeshes);
+	for (uint32_t m = 0; m < header.numSubMeshes; ++m)
+	{
+		const MeshFileSubMesh& fileSubMesh = fileSubMeshes[m];
+		if ((fileSubMesh.vertexElements & ~(MESH_TANGENTS | MESH_UVS | MESH_BONES)) != 0 ||
+		    fileSubMesh.vertexSize != MeshVertexSize(fileSubMesh.vertexElements) ||
+		    ((fileSubMesh.vertexElements & MESH_BONES) != 0) != data.hasBones ||
+		    fileSubMesh.numVertices == 0 || fileSubMesh.numIndices == 0 ||
+		    !inFile(fileSubMesh.verticesOffset, fileSubMesh.numVertices, fileSubMesh.vertexSize) ||
+		    !inFile(fileSubMesh.indicesOffset,  fileSubMesh.numIndices,  sizeof(uint32_t)) ||
+		    (fileSubMesh.verticesOffset | fileSubMesh.indicesOffset) % 16 != 0)
+		{
+			mLastError = fileName + " has a damaged sub-mesh";
+			return false;
+		}
+
+		MeshSubMeshData& subMesh = data.subMeshes[m];
+		subMesh.vertexElements = fileSubMesh.vertexElements;
+		subMesh.vertexSize     = fileSubMesh.vertexSize;
+		subMesh.numVertices    = fileSubMesh.numVertices;
+		subMesh.numIndices     = fileSubMesh.numIndices;
+		subMesh.vertices       = file + fileSubMesh.verticesOffset;
+		subMesh.indices        = reinterpret_cast<const uint32_t*>(file + fileSubMesh.indicesOffset);
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Writing
+//--------------------------------------------------------------------------------------
+
+// Write mesh data to a binary mesh file
+bool MeshFile::Write(const std::string& fileName, const MeshData& data, bool requireTangents,
+                     const std::string& sourceFileName /*= ""*/)
+{
+	MeshFileHeader header = {};
+	memcpy(header.magic, "MESH", 4);
+	header.version      = MESH_FILE_VERSION;
+	header.flags        = (requireTangents ? MESH_FILE_TANGENTS : 0) | (data.hasBones ? MESH_FILE_BONES : 0);
+	header.numNodes     = static_cast<uint32_t>(data.nodes.size());
+	header.numSubMeshes = static_cast<uint32_t>(data.subMeshes.size());
+	if (!sourceFileName.empty() && !GetFileSizeAndTime(sourceFileName, header.sourceSize, header.sourceTime))
+	{
+		mLastError = "Cannot find " + sourceFileName;
+		return false;
+	}
+
+	// Node records, index ranges and names
+	std::vector<MeshFileNode> fileNodes(data.nodes.size());
+	std::vector<uint32_t>     nodeIndices;
+	std::string               names;
+	for (size_t n = 0; n < data.nodes.size(); ++n)
+	{
+		const MeshNodeData& node = data.nodes[n];
+		MeshFileNode& fileNode = fileNodes[n];
+		fileNode = {};
+		fileNode.defaultMatrix = node.defaultMatrix;
+		fileNode.offsetMatrix  = node.offsetMatrix;
+		fileNode.parentIndex   = node.parentIndex;
+		fileNode.nameOffset    = static_cast<uint32_t>(names.size());
+		fileNode.nameLength    = static_cast<uint32_t>(node.name.size());
+		names += node.name;
+		fileNode.firstChild    = static_cast<uint32_t>(nodeIndices.size());
+		fileNode.numChildren   = static_cast<uint32_t>(node.childNodes.size());
+		nodeIndices.insert(nodeIndices.end(), node.childNodes.begin(), node.childNodes.end());
+		fileNode.firstSubMesh  = static_cast<uint32_t>(nodeIndices.size());
+		fileNode.numSubMeshes  = static_cast<uint32_t>(node.subMeshes.size());
+		nodeIndices.insert(nodeIndices.end(), node.subMeshes.begin(), node.subMeshes.end());
+	}
+	header.numNodeIndices = static_cast<uint32_t>(nodeIndices.size());
+	header.namesSize      = static_cast<uint32_t>(names.size());
+
+	// Lay out the sections
+	header.nodesOffset       = Align16(sizeof(MeshFileHeader));
+	header.nodeIndicesOffset = Align16(header.nodesOffset + fileNodes.size() * sizeof(MeshFileNode));
+	header.namesOffset       = header.nodeIndicesOffset + nodeIndices.size() * sizeof(uint32_t);
+	header.subMeshesOffset   = Align16(header.namesOffset + names.size());
+	uint64_t offset          = header.subMeshesOffset + data.subMeshes.size() * sizeof(MeshFileSubMesh);
+
+	std::vector<MeshFileSubMesh> fileSubMeshes(data.subMeshes.size());
+	for (size_t m = 0; m < data.subMeshes.size(); ++m)
+	{
+		const MeshSubMeshData& subMesh = data.subMeshes[m];
+		MeshFileSubMesh& fileSubMesh = fileSubMeshes[m];
+		fileSubMesh.vertexElements = subMesh.vertexElements;
+		fileSubMesh.vertexSize     = subMesh.vertexSize;
+		fileSubMesh.numVertices    = subMesh.numVertices;
+		fileSubMesh.numIndices     = subMesh.numIndices;
+		fileSubMesh.verticesOffset = Align16(offset);
+		fileSubMesh.indicesOffset  = Align16(fileSubMesh.verticesOffset + static_cast<uint64_t>(subMesh.numVertices) * subMesh.vertexSize);
+		offset = fileSubMesh.indicesOffset + static_cast<uint64_t>(subMesh.numIndices) * sizeof(uint32_t);
+	}
+	header.fileSize = offset;
+
+	// Build the file in memory and write it in one go
+	std::vector<unsigned char> file(static_cast<size_t>(header.fileSize), 0);
+	memcpy(file.data(), &header, sizeof(header));
+	if (!fileNodes.empty())      memcpy(file.data() + header.nodesOffset, fileNodes.data(), fileNodes.size() * sizeof(MeshFileNode));
+	if (!nodeIndices.empty())    memcpy(file.data() + header.nodeIndicesOffset, nodeIndices.data(), nodeIndices.size() * sizeof(uint32_t));
+	if (!names.empty())          memcpy(file.data() + header.namesOffset, names.data(), names.size());
+	if (!fileSubMeshes.empty())  memcpy(file.data() + header.subMeshesOffset, fileSubMeshes.data(), fileSubMeshes.size() * sizeof(MeshFileSubMesh));
+	for (size_t m = 0; m < data.subMeshes.size(); ++m)
+	{
+		const MeshSubMeshData& subMesh = data.subMeshes[m];
+		memcpy(file.data() + fileSubMeshes[m].verticesOffset, subMesh.vertices, static_cast<size_t>(subMesh.numVertices) * subMesh.vertexSize);
+		memcpy(file.data() + fileSubMeshes[m].indicesOffset, subMesh.indices, static_cast<size_t>(subMesh.numIndices) * sizeof(uint32_t));
+	}
+
+	std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(file.data()), file.size());
+	out.close();
+	if (!out)
+	{
+		mLastError = "Error writing " + fileName;
+		return false;
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// File names
+//--------------------------------------------------------------------------------------
+
+// Name of the cooked mesh file for a source mesh file
+std::string CookedMeshFileName(const std::string& sourceFileName)
+{
+	return sourceFileName + ".mesh";
+}
+
+// Whether a file name is a binary mesh file
+bool IsMeshFileName(const std::string& fileName)
+{
+	return fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".mesh") == 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Loading
+//--------------------------------------------------------------------------------------
+
+// Get the mesh data for a mesh file the way Mesh does, reading binary or cooked files where possible
+// Will throw a std::runtime_error exception on failure
+void LoadMeshData(const std::string& fileName, bool requireTangents, MeshFile& meshFile, MeshData& data)
+{
+	if (IsMeshFileName(fileName))
+	{
+		if (!meshFile.Read(fileName, data))  throw std::runtime_error("Error loading mesh (" + fileName + "). " + meshFile.LastError());
+	}
+	else if (!meshFile.ReadCooked(fileName, requireTangents, data))
+	{
+		ImportMesh(fileName, requireTangents, data);
+		meshFile.Write(CookedMeshFileName(fileName), data, requireTangents, fileName);
+	}
+}
@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// Binary mesh file - mesh data saved in a form that loads with no processing
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// A binary mesh file (.mesh) holds the MeshData imported from a mesh file: the node hierarchy with default and bone
+// offset matrices, and for each sub-mesh its vertex layout and final interleaved vertices and indices. Reading maps the
+// file into memory and points the sub-mesh data straight at the mapped vertices and indices, so nothing is copied or
+// converted - the GPU buffers are created directly from the file's pages.
+//
+// File layout (little-endian, sections start on 16-byte boundaries, offsets are from the start of the file):
+//   Header          magic "MESH", version, flags, counts, size and time of the source file, section offsets
+//   Nodes           MeshFileNode for each node, in depth-first order
+//   Node indices    uint32 child node and sub-mesh indices, each node refers to a range of them
+//   Names           node names, not terminated, each node has an offset and length
+//   Sub-meshes      MeshFileSubMesh for each sub-mesh
+//   Geometry        for each sub-mesh its vertices then its uint32 indices
+// The version changes whenever the layout or the import settings (MeshData.cpp) change, and files of other versions are
+// rejected.
+//
+// Mesh files are written by the MeshConverter tool (Tools/MeshConverter). Mesh also writes a cooked file next to each
+// mesh it imports (CookedMeshFileName), and reads that instead of importing while the source file is unchanged
+
+#ifndef _MESH_FILE_H_INCLUDED_
+#define _MESH_FILE_H_INCLUDED_
+
+#include "MeshData.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <cstdint>
+
+
+// Version of the file layout and import settings
+const uint32_t MESH_FILE_VERSION = 1;
+
+
+class MeshFile
+{
+public:
+	// Reading
+
+	// Map a binary mesh file and fill in the mesh data. The sub-mesh vertices and indices point into the mapped file,
+	// so are only valid until this object is closed or destroyed. Returns false on failure, see LastError
+	bool Read(const std::string& fileName, MeshData& data);
+
+	// Read the cooked mesh file for a source mesh file, as Read does. Returns false if there is no cooked file, or it was
+	// not converted from the source file as it is now with the same tangent setting
+	bool ReadCooked(const std::string& sourceFileName, bool requireTangents, MeshData& data);
+
+	// Unmap the file
+	void Close() { mFile.Close(); }
+
+
+	// Writing
+
+	// Write mesh data to a binary mesh file. Pass the name of the file the data was imported from so ReadCooked can check
+	// it is up to date, and whether tangents were requested. Returns false on failure, see LastError
+	bool Write(const std::string& fileName, const MeshData& data, bool requireTangents, const std::string& sourceFileName = "");
+
+
+	// Description of the last error
+	const std::string& LastError() { return mLastError; }
+
+
+private:
+	bool ReadMapped(const std::string& fileName, MeshData& data);
+
+	MappedFile  mFile;
+	std::string mLastError;
+};
+
+
+// Name of the cooked mesh file for a source mesh file - the source name with .mesh added, e.g. Troll.x.mesh
+std::string CookedMeshFileName(const std::string& sourceFileName);
+
+// Whether a file name is a binary mesh file (ends .mesh)
+bool IsMeshFileName(const std::string& fileName);
+
+
+// Get the mesh data for a mesh file the way Mesh does. A binary mesh file is read directly. Any other file is imported
+// with assimp unless it has an up to date cooked file, and after importing a cooked file is written so the next run can
+// skip the import (failing to write it is not an error). Binary data points into the given MeshFile, so keep it open
+// while using the data. Will throw a std::runtime_error exception on failure
+void LoadMeshData(const std::string& fileName, bool requireTangents, MeshFile& meshFile, MeshData& data);
+
+
+#endif //_MESH_FILE_H_INCLUDED_
@@ -29,6 +29,25 @@ void Model::Render()
 }
 
 
+// The absolute world matrix of each node, e.g. to render the model instanced
+void Model::GetAbsoluteMatrices(CMatrix4x4* absoluteMatrices)
+{
+    mMesh->GetAbsoluteMatrices(mWorldMatrices, absoluteMatrices);
+}
+
+
+// Bounds of the model in world space, for frustum culling
+BoundingBox Model::WorldBounds()
+{
+    return mMesh->GetWorldBounds(mWorldMatrices);
+}
+
+BoundingSphere Model::WorldSphere()
+{
+    return mMesh->GetWorldSphere(mWorldMatrices);
+}
+
+
 // Control a given node in the model using keys provided. Amount of motion performed depends on frame time
 void Model::Control(int node, float frameTime, KeyCode turnUp, KeyCode turnDown, KeyCode turnLeft, KeyCode turnRight,
                                                KeyCode turnCW, KeyCode turnCCW, KeyCode moveForward, KeyCode moveBackward)
@@ -6,6 +6,7 @@
 
 #include "CVector3.h"
 #include "CMatrix4x4.h"
+#include "FrustumCulling.h"
 #include "Input.h"
 
 #include <vector>
@@ -51,6 +52,18 @@ public:
                                                 Length(mWorldMatrices[node].GetRow(2)) }; } // Scale is length of rows 0-2 in matrix
 	CMatrix4x4 WorldMatrix(int node = 0)  { return mWorldMatrices[node]; }
 
+    // The mesh this model renders, e.g. to group models that share a mesh
+	Mesh* GetMesh()  { return mMesh; }
+
+    // The absolute world matrix of each node, e.g. to render the model instanced (see InstanceBatcher.h). The output must
+    // have space for NumberNodes() matrices
+	int  NumberNodes()  { return static_cast<int>(mWorldMatrices.size()); }
+	void GetAbsoluteMatrices(CMatrix4x4* absoluteMatrices);
+
+    // Bounds of the model in world space from the bounds of its mesh, for frustum culling
+	BoundingBox    WorldBounds();
+	BoundingSphere WorldSphere();
+
     // Setters - model only stores matricies , so if user sets position, rotation or scale, just update those aspects of the matrix
 	void SetPosition(CVector3 position, int node = 0)  { mWorldMatrices[node].SetRow(3, position); }
 
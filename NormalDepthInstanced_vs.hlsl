@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------------------------
+// Instanced Normal Depth Vertex Shader
+//--------------------------------------------------------------------------------------
+// The same as NormalDepth_vs but reads the world matrix of each instance from the instance buffer (see InstanceBatcher.h)
+
+#include "Common.hlsli" // Shaders can also use include files - note the extension
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+NormalDepthPixelShaderInput main(InstancedVertex modelVertex)
+{
+    NormalDepthPixelShaderInput output; // This is the data the pixel shader requires from this vertex shader
+
+    // The rows of the matrix are as stored in C++, so the vertex is on the left of the multiply
+    float4x4 worldMatrix = float4x4(modelVertex.worldRow0, modelVertex.worldRow1, modelVertex.worldRow2, modelVertex.worldRow3);
+
+    float4 modelNormal = float4(modelVertex.normal, 0);
+    output.worldNormal = mul(modelNormal, worldMatrix).xyz;
+
+    float4 modelPosition = float4(modelVertex.position, 1);
+    float4 worldPosition = mul(modelPosition, worldMatrix);
+    float4 viewPosition = mul(gViewMatrix, worldPosition);
+    output.projectedPosition = mul(gProjectionMatrix, viewPosition);
+
+    output.depthPosition = output.projectedPosition;
+
+    return output; // Ouput data sent down the pipeline (to the pixel shader)
+}
@@ -16,6 +16,19 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 
 Texture2D NormalDepthMap : register(t1);
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match OutlineBlock in PostProcessConstantBlocks.cpp
+cbuffer OutlineConstants : register(b2)
+{
+	float  gOutlineThreshold;
+	float  gOutlineThickness;
+	float2 paddingOutline;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Instanced Per-Pixel Lighting Vertex Shader
+//--------------------------------------------------------------------------------------
+// The same as PixelLighting_vs but reads the world matrix of each instance from the instance buffer (see InstanceBatcher.h)
+
+#include "Common.hlsli" // Shaders can also use include files - note the extension
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+LightingPixelShaderInput main(InstancedVertex modelVertex)
+{
+    LightingPixelShaderInput output; // This is the data the pixel shader requires from this vertex shader
+
+    // The rows of the matrix are as stored in C++, so the vertex is on the left of the multiply
+    float4x4 worldMatrix = float4x4(modelVertex.worldRow0, modelVertex.worldRow1, modelVertex.worldRow2, modelVertex.worldRow3);
+
+    // Transform the vertex position into world, view then projection space, as in PixelLighting_vs
+    float4 modelPosition     = float4(modelVertex.position, 1);
+    float4 worldPosition     = mul(modelPosition, worldMatrix);
+    float4 viewPosition      = mul(gViewMatrix, worldPosition);
+    output.projectedPosition = mul(gProjectionMatrix, viewPosition);
+
+    // World normal and position for per-pixel lighting
+    float4 modelNormal = float4(modelVertex.normal, 0);
+    output.worldNormal = mul(modelNormal, worldMatrix).xyz;
+    output.worldPosition = worldPosition.xyz;
+
+    output.uv = modelVertex.uv;
+
+    return output; // Ouput data sent down the pipeline (to the pixel shader)
+}
@@ -0,0 +1,168 @@
+//--------------------------------------------------------------------------------------
+// Fast bloom pyramid passes - versions of BloomPrefilter_pp, BloomDownsample_pp and BloomUpsample_pp
+//--------------------------------------------------------------------------------------
+
+#include "FastBloom.h"
+#include "ShaderFunctions.h"
+#include "Float4.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Bilinear samples
+//--------------------------------------------------------------------------------------
+
+// Where a bilinear sample lands along one axis - the two texels either side and the weight of the second
+struct BilinearTap
+{
+	int   first;
+	int   second;
+	float weight;
+};
+
+// A sample of a filter, offset from the pixel centre in source texels
+struct FilterSample
+{
+	int   x, y;
+	float weight;
+};
+
+// Bilinear taps along one axis for each target pixel and each sample offset (targetSize * numOffsets entries), using
+// clamp addressing as gBilinearClampSampler does. Offset k is at offsets[k] texels from the pixel centre
+static std::vector<BilinearTap> BuildTaps(int targetSize, int sourceSize, const int* offsets, int numOffsets)
+{
+	std::vector<BilinearTap> taps(static_cast<size_t>(targetSize) * numOffsets);
+	for (int i = 0; i < targetSize; ++i)
+	{
+		float uv = (i + 0.5f) / targetSize;
+		for (int k = 0; k < numOffsets; ++k)
+		{
+			float position = (uv + static_cast<float>(offsets[k]) / sourceSize) * sourceSize - 0.5f;
+			float first = std::floor(position);
+			BilinearTap& tap = taps[i * numOffsets + k];
+			tap.first  = static_cast<int>(std::max(0.0f, std::min(first, sourceSize - 1.0f)));
+			tap.second = static_cast<int>(std::max(0.0f, std::min(first + 1.0f, sourceSize - 1.0f)));
+			tap.weight = position - first;
+		}
+	}
+	return taps;
+}
+
+// Bilinear sample of the source from the taps along each axis
+static inline Float4 SampleBilinear(const ImageBuffer& source, const BilinearTap& tapX, const BilinearTap& tapY)
+{
+	const float* row0 = reinterpret_cast<const float*>(source.Row(tapY.first));
+	const float* row1 = reinterpret_cast<const float*>(source.Row(tapY.second));
+	Float4 c00 = Float4::Load(row0 + tapX.first * 4);
+	Float4 c10 = Float4::Load(row0 + tapX.second * 4);
+	Float4 c01 = Float4::Load(row1 + tapX.first * 4);
+	Float4 c11 = Float4::Load(row1 + tapX.second * 4);
+
+	Float4 fx = Float4::Set(tapX.weight);
+	Float4 top    = c00 + (c10 - c00) * fx;
+	Float4 bottom = c01 + (c11 - c01) * fx;
+	return top + (bottom - top) * Float4::Set(tapY.weight);
+}
+
+// Apply a filter made of bilinear samples to every target pixel. Offsets lists the distinct sample offsets along each
+// axis, the samples give their x and y as indexes into the offsets. Passes (result, target pixel) to store
+template <typename SampleFunction, typename StoreFunction>
+static void ApplyFilter(const ImageBuffer& source, ImageBuffer& target, const int* offsets, int numOffsets,
+                        const FilterSample* samples, int numSamples, SampleFunction sampleFunction, StoreFunction store,
+                        ThreadPool& threads)
+{
+	const int width = target.Width();
+	const int height = target.Height();
+	std::vector<BilinearTap> tapsX = BuildTaps(width, source.Width(), offsets, numOffsets);
+	std::vector<BilinearTap> tapsY = BuildTaps(height, source.Height(), offsets, numOffsets);
+
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			const BilinearTap* rowTaps = &tapsY[y * numOffsets];
+			float* targetRow = reinterpret_cast<float*>(target.Row(y));
+			for (int x = 0; x < width; ++x)
+			{
+				const BilinearTap* columnTaps = &tapsX[x * numOffsets];
+				Float4 result = Float4::Set(0.0f);
+				for (int s = 0; s < numSamples; ++s)
+				{
+					Float4 colour = sampleFunction(SampleBilinear(source, columnTaps[samples[s].x], rowTaps[samples[s].y]));
+					result = result + colour * Float4::Set(samples[s].weight);
+				}
+				store(result, targetRow + x * 4);
+			}
+		}
+	});
+}
+
+
+//--------------------------------------------------------------------------------------
+// Pyramid passes
+//--------------------------------------------------------------------------------------
+
+// Halve the size of the source into the target with the 13 sample filter (BloomDownsample13 in Common.hlsli)
+void FastBloomDownsample(const ImageBuffer& source, ImageBuffer& target, bool threshold,
+                         const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	if (source.Empty() || target.Empty())  return;
+
+	// Offsets -2, -1, 0, 1, 2 are indexes 0-4
+	static const int offsets[] = { -2, -1, 0, 1, 2 };
+	static const FilterSample samples[] =
+	{
+		{ 0, 0, 0.03125f }, { 2, 0, 0.0625f }, { 4, 0, 0.03125f },
+		{ 1, 1, 0.125f   }, { 3, 1, 0.125f  },
+		{ 0, 2, 0.0625f  }, { 2, 2, 0.125f  }, { 4, 2, 0.0625f  },
+		{ 1, 3, 0.125f   }, { 3, 3, 0.125f  },
+		{ 0, 4, 0.03125f }, { 2, 4, 0.0625f }, { 4, 4, 0.03125f },
+	};
+
+	// Samples no brighter than the threshold are black (BloomThreshold in Common.hlsli)
+	const float bloomThreshold = constants.bloomThreshold;
+	auto thresholdSample = [&](Float4 colour)
+	{
+		if (!threshold)  return colour;
+		float rgba[4];
+		colour.Store(rgba);
+		return RGBToBrightness(CVector3{ rgba[0], rgba[1], rgba[2] }) > bloomThreshold ? colour : Float4::Set(0.0f);
+	};
+	auto store = [](Float4 result, float* pixel)
+	{
+		result.Store(pixel);
+		pixel[3] = 1.0f;
+	};
+	ApplyFilter(source, target, offsets, 5, samples, 13, thresholdSample, store, threads);
+}
+
+// Double the size of the source into the target with the 3x3 tent filter (BloomUpsampleTent in Common.hlsli)
+void FastBloomUpsample(const ImageBuffer& source, ImageBuffer& target, bool additive, bool clamp,
+                       const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	if (source.Empty() || target.Empty())  return;
+
+	// Offsets -1, 0, 1 are indexes 0-2. The level scale is folded into the weights
+	static const int offsets[] = { -1, 0, 1 };
+	const float scale = constants.bloomLevelScale / 16.0f;
+	const FilterSample samples[] =
+	{
+		{ 0, 0, scale        }, { 1, 0, scale * 2.0f }, { 2, 0, scale        },
+		{ 0, 1, scale * 2.0f }, { 1, 1, scale * 4.0f }, { 2, 1, scale * 2.0f },
+		{ 0, 2, scale        }, { 1, 2, scale * 2.0f }, { 2, 2, scale        },
+	};
+
+	auto unchanged = [](Float4 colour) { return colour; };
+	auto store = [&](Float4 result, float* pixel)
+	{
+		// Additive blend state adds colour but replaces alpha
+		if (additive)  result = result + Float4::Load(pixel);
+		if (clamp)     result = Saturate(result);
+		result.Store(pixel);
+		pixel[3] = 1.0f;
+	};
+	ApplyFilter(source, target, offsets, 3, samples, 9, unchanged, store, threads);
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// Fast bloom pyramid passes - versions of BloomPrefilter_pp, BloomDownsample_pp and BloomUpsample_pp
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// The pyramid shaders take a fixed pattern of bilinear samples around each pixel. Where each sample lands depends on
+// the pixel's column and row separately, so the texels and weights of every sample are worked out once per column and
+// once per row instead of for every pixel. Pixels are then processed four floats at a time with SSE where available.
+// Results match the kernel versions (BloomPrefilterKernel etc.) to within rounding
+
+#ifndef _FAST_BLOOM_H_INCLUDED_
+#define _FAST_BLOOM_H_INCLUDED_
+
+#include "ImageBuffer.h"
+#include "PostProcessingConstants.h"
+#include "ThreadPool.h"
+
+
+// Halve the size of the source into the target with the 13 sample filter, as BloomDownsample_pp. With threshold set
+// each sample is thresholded against bloomThreshold first, as BloomPrefilter_pp. The target must already be sized
+// Results are not clamped - the pyramid levels are 16-bit float textures on the GPU
+void FastBloomDownsample(const ImageBuffer& source, ImageBuffer& target, bool threshold,
+                         const PostProcessingConstants& constants, ThreadPool& threads);
+
+// Double the size of the source into the target with the 3x3 tent filter, scaled by bloomLevelScale, as
+// BloomUpsample_pp. Results are added to the target if additive is set. The target must already be sized
+// Results are clamped to 0->1 if clamp is set, for the final pass into the 8-bit bloom texture
+void FastBloomUpsample(const ImageBuffer& source, ImageBuffer& target, bool additive, bool clamp,
+                       const PostProcessingConstants& constants, ThreadPool& threads);
+
+
+#endif //_FAST_BLOOM_H_INCLUDED_
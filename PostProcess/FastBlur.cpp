@@ -0,0 +1,215 @@
+//--------------------------------------------------------------------------------------
+// Fast separable blurs - versions of BlurX_pp / BlurY_pp whose cost does not depend on the blur size
+//--------------------------------------------------------------------------------------
+
+#include "FastBlur.h"
+#include "ShaderFunctions.h"
+#include "Float4.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Box filters
+//--------------------------------------------------------------------------------------
+
+// A box filter centred on the pixel. Pixels -innerRadius to +innerRadius have weight innerWeight,
+// the two pixels just outside that have weight edgeWeight (the part of those pixels the box covers)
+struct BlurBox
+{
+	int   innerRadius;
+	float innerWeight;
+	float edgeWeight;
+};
+
+// Build the box filters that make up a blur blurSize wide (in UVs) over a line of the given number of pixels
+static std::vector<BlurBox> BuildBlurBoxes(float blurSize, int size, float standardDeviationSquared)
+{
+	std::vector<BlurBox> boxes;
+
+	// All the samples land on the centre pixel for blurs narrower than a pixel
+	float radius = std::abs(blurSize) * size * 0.5f;
+	if (radius < 0.5f)
+	{
+		boxes.push_back({ 0, 1.0f, 0.0f });
+		return boxes;
+	}
+
+	// Gauss() from Common.hlsli, which takes offsets in UVs, relative to its value at another offset. The normalisation at the
+	// end removes the difference, and working relative to the largest weight used avoids overflow and underflow
+	auto relativeWeight = [&](float pixels, float relativeToPixels)
+	{
+		if (standardDeviationSquared < SHADER_EPSILON)  return 1.0f;
+		float x = pixels / size;
+		float relativeTo = relativeToPixels / size;
+		return std::pow(SHADER_EPSILON, -(x * x - relativeTo * relativeTo) / (2.0f * standardDeviationSquared));
+	};
+
+	// A flat weight curve is a single box, otherwise split it into rings. Use enough rings that the weight changes by
+	// less than FAST_BLUR_RING_STEP from one ring to the next, within the limits
+	float weightChange = std::abs(relativeWeight(radius, 0.0f) - 1.0f);
+	int numBoxes = static_cast<int>(std::ceil(std::min(weightChange / FAST_BLUR_RING_STEP, static_cast<float>(FAST_BLUR_MAX_BOXES))));
+	numBoxes = std::max(1, std::min(numBoxes, static_cast<int>(std::ceil(radius))));
+
+	// The weight curve rises away from the centre so the outer ring has the largest weight
+	float outerRing = radius * (numBoxes - 0.5f) / numBoxes;
+	auto weight = [&](float pixels) { return relativeWeight(pixels, outerRing); };
+
+	// Ring j has the weight of the curve at its middle. A stack of boxes gives the same result: box j has
+	// the weight of ring j less the weight of the ring outside it
+	float totalWeight = 0.0f;
+	for (int j = 1; j <= numBoxes; ++j)
+	{
+		float boxRadius = radius * j / numBoxes;
+		float ringWeight = weight(radius * (j - 0.5f) / numBoxes);
+		float outerWeight = (j < numBoxes) ? weight(radius * (j + 0.5f) / numBoxes) : 0.0f;
+		float boxWeight = ringWeight - outerWeight;
+
+		BlurBox box;
+		if (boxRadius < 0.5f)
+		{
+			box = { 0, boxWeight * 2.0f * boxRadius, 0.0f };
+		}
+		else
+		{
+			box.innerRadius = static_cast<int>(std::floor(boxRadius - 0.5f));
+			box.innerWeight = boxWeight;
+			box.edgeWeight  = boxWeight * (boxRadius - 0.5f - box.innerRadius);
+		}
+		totalWeight += box.innerWeight * (2 * box.innerRadius + 1) + 2.0f * box.edgeWeight;
+		boxes.push_back(box);
+	}
+
+	for (auto& box : boxes)
+	{
+		box.innerWeight /= totalWeight;
+		box.edgeWeight  /= totalWeight;
+	}
+	return boxes;
+}
+
+
+// Blur one line of count elements, each made up of numFloats floats (a multiple of 4). Elements of the source and
+// target lines are stride floats apart. Pixels beyond the ends of the line repeat the end pixels, as clamp addressing
+// does. Sums is workspace for (count + 1) * numFloats floats
+static void BlurLine(const float* source, int sourceStride, float* target, int targetStride, int count, int numFloats,
+                     const std::vector<BlurBox>& boxes, float* sums)
+{
+	// Running sums along the line, sums[i] is the total of elements 0 to i-1
+	std::fill(sums, sums + numFloats, 0.0f);
+	for (int i = 0; i < count; ++i)
+	{
+		for (int f = 0; f < numFloats; f += 4)
+		{
+			Float4 sum = Float4::Load(sums + i * numFloats + f) + Float4::Load(source + i * sourceStride + f);
+			sum.Store(sums + (i + 1) * numFloats + f);
+		}
+	}
+
+	const float* first = source;
+	const float* last = source + (count - 1) * sourceStride;
+
+	// Element i with clamp addressing
+	auto element = [&](int i, int f)
+	{
+		i = std::max(0, std::min(count - 1, i));
+		return Float4::Load(source + i * sourceStride + f);
+	};
+
+	// Total of elements before i, continuing the end elements beyond the line
+	auto runningSum = [&](int i, int f)
+	{
+		if (i <= 0)      return Float4::Set(static_cast<float>(i)) * Float4::Load(first + f);
+		if (i >= count)  return Float4::Load(sums + count * numFloats + f) + Float4::Set(static_cast<float>(i - count)) * Float4::Load(last + f);
+		return Float4::Load(sums + i * numFloats + f);
+	};
+
+	// Elements far enough from the ends that every box lies within the line can skip the clamping
+	int reach = 0;
+	for (const auto& box : boxes)  reach = std::max(reach, box.innerRadius + 1);
+	int innerBegin = std::min(reach, count);
+	int innerEnd = std::max(innerBegin, count - reach);
+
+	for (int i = 0; i < count; ++i)
+	{
+		bool inside = i >= innerBegin && i < innerEnd;
+		for (int f = 0; f < numFloats; f += 4)
+		{
+			Float4 result = Float4::Set(0.0f);
+			for (const auto& box : boxes)
+			{
+				Float4 inner, edges;
+				if (inside)
+				{
+					inner = Float4::Load(sums + (i + box.innerRadius + 1) * numFloats + f) - Float4::Load(sums + (i - box.innerRadius) * numFloats + f);
+					edges = Float4::Load(source + (i - box.innerRadius - 1) * sourceStride + f) + Float4::Load(source + (i + box.innerRadius + 1) * sourceStride + f);
+				}
+				else
+				{
+					inner = runningSum(i + box.innerRadius + 1, f) - runningSum(i - box.innerRadius, f);
+					edges = element(i - box.innerRadius - 1, f) + element(i + box.innerRadius + 1, f);
+				}
+				result = result + Float4::Set(box.innerWeight) * inner + Float4::Set(box.edgeWeight) * edges;
+			}
+			Saturate(result).Store(target + i * targetStride + f);
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Blurs
+//--------------------------------------------------------------------------------------
+
+// Blur the source horizontally into the target using blurSize.x and standardDeviationSquared (as BlurX_pp)
+void FastBlurX(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	const int width = source.Width();
+	const int height = source.Height();
+	target.Resize(width, height);
+	if (source.Empty())  return;
+
+	std::vector<BlurBox> boxes = BuildBlurBoxes(constants.blurSize.x, width, constants.standardDeviationSquared);
+
+	// Each row is a line of pixels, four floats per pixel
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		std::vector<float> sums((width + 1) * 4);
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			const float* sourceRow = reinterpret_cast<const float*>(source.Row(y));
+			float* targetRow = reinterpret_cast<float*>(target.Row(y));
+			BlurLine(sourceRow, 4, targetRow, 4, width, 4, boxes, sums.data());
+		}
+	});
+}
+
+// Blur the source vertically into the target using blurSize.y and standardDeviationSquared (as BlurY_pp)
+void FastBlurY(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	const int width = source.Width();
+	const int height = source.Height();
+	target.Resize(width, height);
+	if (source.Empty())  return;
+
+	std::vector<BlurBox> boxes = BuildBlurBoxes(constants.blurSize.y, height, constants.standardDeviationSquared);
+
+	// The image is split into strips of columns. Each strip is blurred as a single line whose elements are the strip's
+	// part of each row, so neighbouring columns are summed together in the same SIMD operations
+	const int STRIP_WIDTH = 16;
+	const int numStrips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+	threads.ParallelFor(numStrips, 1, [&](int stripBegin, int stripEnd)
+	{
+		std::vector<float> sums((height + 1) * STRIP_WIDTH * 4);
+		for (int strip = stripBegin; strip < stripEnd; ++strip)
+		{
+			int x = strip * STRIP_WIDTH;
+			int stripWidth = std::min(STRIP_WIDTH, width - x);
+			const float* sourceColumn = reinterpret_cast<const float*>(source.Row(0) + x);
+			float* targetColumn = reinterpret_cast<float*>(target.Row(0) + x);
+			BlurLine(sourceColumn, width * 4, targetColumn, width * 4, height, stripWidth * 4, boxes, sums.data());
+		}
+	});
+}
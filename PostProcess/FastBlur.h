@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// Fast separable blurs - versions of BlurX_pp / BlurY_pp whose cost does not depend on the blur size
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// The blur shaders take 150 samples spread evenly across blurSize and weight them with Gauss(). With the samples
+// that close together this is the same as integrating the weight curve over each pixel, so the blur can be built
+// from a few box filters of different widths. Each box filter is a difference of two running sums along the line,
+// which costs the same however wide the box is. When the weight curve is flat over the blur, which it is for the
+// settings used in UpdateScene, a single box is needed; otherwise the curve is split into rings, up to
+// FAST_BLUR_MAX_BOXES boxes. The running sums are done four floats at a time with SSE where available.
+//
+// Results differ a little from the shader port (BlurXKernel / BlurYKernel) because the shader's point samples do
+// not land evenly on the pixels - use ImageBuffer::MaxDifference to compare the two
+
+#ifndef _FAST_BLUR_H_INCLUDED_
+#define _FAST_BLUR_H_INCLUDED_
+
+#include "ImageBuffer.h"
+#include "PostProcessingConstants.h"
+#include "ThreadPool.h"
+
+
+// Maximum number of box filters used to follow a weight curve that is not flat, and the change in relative weight
+// between neighbouring boxes that is aimed for. Well below the 1/255 step of the 8-bit render targets
+const int   FAST_BLUR_MAX_BOXES = 16;
+const float FAST_BLUR_RING_STEP = 0.001f;
+
+
+// Blur the source horizontally into the target using blurSize.x and standardDeviationSquared (as BlurX_pp)
+// Target is resized to match the source. Source and target must be different images
+void FastBlurX(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads);
+
+// Blur the source vertically into the target using blurSize.y and standardDeviationSquared (as BlurY_pp)
+// Target is resized to match the source. Source and target must be different images
+void FastBlurY(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads);
+
+
+#endif //_FAST_BLUR_H_INCLUDED_
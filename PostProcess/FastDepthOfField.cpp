@@ -0,0 +1,205 @@
+//--------------------------------------------------------------------------------------
+// Fast depth of field - a version of DepthOfField_pp that only samples where something can be out of focus
+//--------------------------------------------------------------------------------------
+
+#include "FastDepthOfField.h"
+#include "PostProcessKernels.h"
+#include "ShaderFunctions.h"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Gather offsets
+//--------------------------------------------------------------------------------------
+
+// The dilation a sample must have to affect another pixel in the shader
+const float DOF_MIN_DILATION = 0.01f;
+
+// One of the shader's sample offsets in pixels, with its distance from the centre as a fraction of dilationSize
+struct DepthOfFieldOffset
+{
+	int   x, y;
+	float distance;
+};
+
+// The shader's offsets in pixels for an image of the given size, rounded as the shader port does
+static std::vector<DepthOfFieldOffset> BuildPixelOffsets(const PostProcessingConstants& constants, int width, int height)
+{
+	std::vector<DepthOfFieldOffset> offsets;
+	for (const CVector2& unitOffset : DepthOfFieldOffsets())
+	{
+		PixelOffset pixelOffset = DepthOfFieldPixelOffset(unitOffset, constants.dilationSize, width, height);
+		DepthOfFieldOffset offset;
+		offset.x = pixelOffset.x;
+		offset.y = pixelOffset.y;
+		offset.distance = std::sqrt(unitOffset.x * unitOffset.x + unitOffset.y * unitOffset.y);
+		offsets.push_back(offset);
+	}
+	return offsets;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Depth of field
+//--------------------------------------------------------------------------------------
+
+// Apply depth of field to the source into the target using the depth in the alpha of normalDepth, focalPlane,
+// nearPlane, farPlane, dilationSize and dilationThreshold (as DepthOfField_pp)
+void FastDepthOfField(const ImageBuffer& source, const ImageBuffer& normalDepth, ImageBuffer& target,
+                      const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	const int width = source.Width();
+	const int height = source.Height();
+	target.Resize(width, height);
+	if (source.Empty() || normalDepth.Empty())  return;
+
+	// Depth, circle of confusion and brightness of every pixel, worked out once rather than for every sample
+	const size_t numPixels = static_cast<size_t>(width) * height;
+	std::vector<float> depths(numPixels);
+	std::vector<float> dilations(numPixels);
+	std::vector<float> brightnesses(numPixels);
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				size_t i = static_cast<size_t>(y) * width + x;
+				CVector2 uv = { (x + 0.5f) / width, (y + 0.5f) / height };
+				depths[i] = normalDepth.SamplePoint(uv).a;
+				dilations[i] = DilationForDepth(depths[i], constants);
+				brightnesses[i] = RGBToBrightness(source.Data()[i]);
+			}
+		}
+	});
+
+	// Smallest and largest circle of confusion in each tile
+	const int tilesX = (width + FAST_DOF_TILE_SIZE - 1) / FAST_DOF_TILE_SIZE;
+	const int tilesY = (height + FAST_DOF_TILE_SIZE - 1) / FAST_DOF_TILE_SIZE;
+	std::vector<float> tileMinimums(static_cast<size_t>(tilesX) * tilesY, FLT_MAX);
+	std::vector<float> tileMaximums(static_cast<size_t>(tilesX) * tilesY, 0.0f);
+	threads.ParallelFor(tilesY, 1, [&](int tileRowBegin, int tileRowEnd)
+	{
+		for (int ty = tileRowBegin; ty < tileRowEnd; ++ty)
+		{
+			int yEnd = std::min(height, (ty + 1) * FAST_DOF_TILE_SIZE);
+			for (int y = ty * FAST_DOF_TILE_SIZE; y < yEnd; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					float dilation = dilations[static_cast<size_t>(y) * width + x];
+					float& tileMinimum = tileMinimums[ty * tilesX + x / FAST_DOF_TILE_SIZE];
+					float& tileMaximum = tileMaximums[ty * tilesX + x / FAST_DOF_TILE_SIZE];
+					tileMinimum = std::min(tileMinimum, dilation);
+					tileMaximum = std::max(tileMaximum, dilation);
+				}
+			}
+		}
+	});
+
+	// The offsets in pixels and how far they reach, then the offsets used at each gather radius, in the shader's order
+	// as a sample can change which later samples are taken
+	std::vector<DepthOfFieldOffset> offsets = BuildPixelOffsets(constants, width, height);
+	int reachX = 0, reachY = 0;
+	for (const auto& offset : offsets)
+	{
+		reachX = std::max(reachX, std::abs(offset.x));
+		reachY = std::max(reachY, std::abs(offset.y));
+	}
+	std::vector<DepthOfFieldOffset> levelOffsets[FAST_DOF_GATHER_LEVELS];
+	for (int level = 0; level < FAST_DOF_GATHER_LEVELS; ++level)
+	{
+		float radius = static_cast<float>(level + 1) / FAST_DOF_GATHER_LEVELS;
+		for (const auto& offset : offsets)
+		{
+			if (offset.distance <= radius + 1e-5f)  levelOffsets[level].push_back(offset);
+		}
+	}
+
+	threads.ParallelFor(tilesY * tilesX, 4, [&](int tileBegin, int tileEnd)
+	{
+		for (int tile = tileBegin; tile < tileEnd; ++tile)
+		{
+			const int x0 = (tile % tilesX) * FAST_DOF_TILE_SIZE;
+			const int y0 = (tile / tilesX) * FAST_DOF_TILE_SIZE;
+			const int x1 = std::min(width, x0 + FAST_DOF_TILE_SIZE);
+			const int y1 = std::min(height, y0 + FAST_DOF_TILE_SIZE);
+
+			// Smallest and largest circle of confusion of any pixel the tile's samples can land on
+			int neighbourX0 = std::max(0, x0 - reachX) / FAST_DOF_TILE_SIZE;
+			int neighbourX1 = std::min(width - 1, x1 - 1 + reachX) / FAST_DOF_TILE_SIZE;
+			int neighbourY0 = std::max(0, y0 - reachY) / FAST_DOF_TILE_SIZE;
+			int neighbourY1 = std::min(height - 1, y1 - 1 + reachY) / FAST_DOF_TILE_SIZE;
+			float minDilation = FLT_MAX;
+			float maxDilation = 0.0f;
+			for (int ty = neighbourY0; ty <= neighbourY1; ++ty)
+			{
+				for (int tx = neighbourX0; tx <= neighbourX1; ++tx)
+				{
+					minDilation = std::min(minDilation, tileMinimums[ty * tilesX + tx]);
+					maxDilation = std::max(maxDilation, tileMaximums[ty * tilesX + tx]);
+				}
+			}
+
+			// Nothing nearby is out of focus - the shader would take no samples so the colour is unchanged
+			if (maxDilation <= DOF_MIN_DILATION)
+			{
+				for (int y = y0; y < y1; ++y)
+				{
+					for (int x = x0; x < x1; ++x)
+					{
+						size_t i = static_cast<size_t>(y) * width + x;
+						target.Data()[i] = Saturate(ToRGBA(ToRGB(source.Data()[i]), dilations[i]));
+					}
+				}
+				continue;
+			}
+
+			// Everything nearby is fully out of focus, so every sample reaches the full dilationSize as in the shader and
+			// all of them are gathered without testing each one's reach. Otherwise gather out as far as the largest
+			// circle of confusion nearby, samples further away cannot reach this tile
+			const bool fullyBlurred = (minDilation >= 1.0f);
+			int level = static_cast<int>(std::ceil(std::min(maxDilation, 1.0f) * FAST_DOF_GATHER_LEVELS)) - 1;
+			const std::vector<DepthOfFieldOffset>& gatherOffsets = fullyBlurred ? offsets : levelOffsets[std::max(0, level)];
+			for (int y = y0; y < y1; ++y)
+			{
+				for (int x = x0; x < x1; ++x)
+				{
+					size_t i = static_cast<size_t>(y) * width + x;
+					size_t brightest = i;
+					float depth = depths[i];
+					float dilation = dilations[i];
+					float brightness = brightnesses[i];
+
+					for (const auto& offset : gatherOffsets)
+					{
+						int sampleX = std::max(0, std::min(width - 1, x + offset.x));
+						int sampleY = std::max(0, std::min(height - 1, y + offset.y));
+						size_t s = static_cast<size_t>(sampleY) * width + sampleX;
+
+						float sampleDilation = dilations[s];
+						if (!fullyBlurred && sampleDilation < offset.distance)  continue; // Sample's blur does not reach this far
+
+						if (brightnesses[s] > brightness && sampleDilation > DOF_MIN_DILATION &&
+						    depth + 0.005f > depths[s] && sampleDilation + 0.5f > dilation)
+						{
+							brightest = s;
+							brightness = brightnesses[s];
+							dilation = sampleDilation;
+							depth = depths[s];
+						}
+					}
+
+					CVector3 focusColour = ToRGB(source.Data()[i]);
+					CVector3 finalColour = ToRGB(source.Data()[brightest]);
+					finalColour = LerpUnclamped(focusColour, finalColour, SmoothStep(constants.dilationThreshold.x, constants.dilationThreshold.y, dilation * brightness));
+					target.Data()[i] = Saturate(ToRGBA(finalColour, dilation));
+				}
+			}
+		}
+	});
+}
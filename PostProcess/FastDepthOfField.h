@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Fast depth of field - a version of DepthOfField_pp that only samples where something can be out of focus
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// The depth of field shader takes 525 samples around every pixel and works out the dilation (circle of confusion) of
+// each one from the depth map, even where the whole area is in focus. Here:
+// - The circle of confusion of every pixel is worked out once, with DilationForDepth (focalPlane, nearPlane, farPlane)
+// - The image is split into tiles and the smallest and largest circle of confusion in each tile is found. A pixel can
+//   only change if some pixel within dilationSize of it is out of focus, so tiles with no such pixel nearby are a plain
+//   copy
+// - Tiles where everything within dilationSize is fully out of focus take all the shader's samples, with nothing else
+//   to test, and match the shader exactly
+// - Other tiles gather samples as the shader does, but only out as far as the largest circle of confusion near the
+//   tile, so the number of samples rises with the amount of blur
+//
+// In the last kind of tile a sample only spreads as far as its own circle of confusion (as a fraction of dilationSize),
+// whereas the shader lets every out of focus sample reach the full dilationSize. Around objects that are only just out
+// of focus the blur is tighter than the shader's and single pixels can differ completely, so compare with the shader
+// port (DepthOfFieldKernel) by PSNR and the number of pixels that differ rather than ImageBuffer::MaxDifference. Both
+// take their samples at DepthOfFieldPixelOffset, so they land on the same pixels
+
+#ifndef _FAST_DEPTH_OF_FIELD_H_INCLUDED_
+#define _FAST_DEPTH_OF_FIELD_H_INCLUDED_
+
+#include "ImageBuffer.h"
+#include "PostProcessingConstants.h"
+#include "ThreadPool.h"
+
+
+// Size in pixels of the square tiles the circles of confusion are gathered into, and the number of different gather
+// radiuses used (each a fraction of dilationSize)
+const int FAST_DOF_TILE_SIZE = 16;
+const int FAST_DOF_GATHER_LEVELS = 16;
+
+
+// Apply depth of field to the source into the target using the depth in the alpha of normalDepth, focalPlane,
+// nearPlane, farPlane, dilationSize and dilationThreshold (as DepthOfField_pp)
+// Target is resized to match the source. Source and target must be different images
+void FastDepthOfField(const ImageBuffer& source, const ImageBuffer& normalDepth, ImageBuffer& target,
+                      const PostProcessingConstants& constants, ThreadPool& threads);
+
+
+#endif //_FAST_DEPTH_OF_FIELD_H_INCLUDED_
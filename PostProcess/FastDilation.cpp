@@ -0,0 +1,254 @@
+//--------------------------------------------------------------------------------------
+// Fast dilation - a version of Dilation_pp built from running maximums along lines
+//--------------------------------------------------------------------------------------
+
+#include "FastDilation.h"
+#include "ShaderFunctions.h"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Line maximums
+//--------------------------------------------------------------------------------------
+
+// The brightness of a pixel and where it came from. Dilation passes these around rather than colours
+struct DilationSample
+{
+	float brightness;
+	int   index;
+};
+
+// The brighter of two samples, the first if they are equal (the shader only takes strictly brighter samples)
+static inline DilationSample Brighter(const DilationSample& a, const DilationSample& b)
+{
+	return b.brightness > a.brightness ? b : a;
+}
+
+// Maximum over a window of samples in a line. The line has count elements, each made up of numLanes samples that are
+// processed side by side (e.g. a whole row when working down the image). Elements are stride samples apart. The window
+// for element i covers elements i + windowStart to i + windowEnd, ignoring any beyond the ends of the line. Results are
+// combined with the target if merge is set, otherwise they replace it. Forward and backward are workspace
+//
+// Long windows use the van Herk/Gil-Werman method. The line is split into blocks the size of the window and running
+// maximums are taken forwards and backwards within each block. Every window covers the end of one block and the start
+// of the next, so its maximum is the larger of one backward and one forward running maximum
+static void WindowMaximum(const DilationSample* source, DilationSample* target, int count, int numLanes, int stride,
+                          int windowStart, int windowEnd, bool merge,
+                          std::vector<DilationSample>& forward, std::vector<DilationSample>& backward)
+{
+	const DilationSample padding = { -FLT_MAX, -1 };
+	auto store = [&](int i, int lane, const DilationSample& sample)
+	{
+		DilationSample& result = target[i * stride + lane];
+		result = merge ? Brighter(result, sample) : sample;
+	};
+
+	// Short windows are quicker to check directly
+	const int windowSize = windowEnd - windowStart + 1;
+	if (windowSize <= 3)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			int first = std::max(0, i + windowStart);
+			int last = std::min(count - 1, i + windowEnd);
+			for (int lane = 0; lane < numLanes; ++lane)
+			{
+				DilationSample sample = padding;
+				for (int j = first; j <= last; ++j)
+				{
+					sample = Brighter(sample, source[j * stride + lane]);
+				}
+				store(i, lane, sample);
+			}
+		}
+		return;
+	}
+
+	// Running maximums cover every element in any window, from windowStart before the line to windowEnd after it
+	const int paddedStart = windowStart;
+	const int paddedCount = count + windowEnd - windowStart;
+	auto element = [&](int p, int lane)
+	{
+		int i = p + paddedStart;
+		return (i >= 0 && i < count) ? source[i * stride + lane] : padding;
+	};
+
+	forward.resize(static_cast<size_t>(paddedCount) * numLanes);
+	backward.resize(static_cast<size_t>(paddedCount) * numLanes);
+	for (int p = 0; p < paddedCount; ++p)
+	{
+		DilationSample* f = &forward[p * numLanes];
+		if (p % windowSize == 0)
+		{
+			for (int lane = 0; lane < numLanes; ++lane)  f[lane] = element(p, lane);
+		}
+		else
+		{
+			for (int lane = 0; lane < numLanes; ++lane)  f[lane] = Brighter(f[lane - numLanes], element(p, lane));
+		}
+	}
+	for (int p = paddedCount - 1; p >= 0; --p)
+	{
+		DilationSample* b = &backward[p * numLanes];
+		if (p % windowSize == windowSize - 1 || p == paddedCount - 1)
+		{
+			for (int lane = 0; lane < numLanes; ++lane)  b[lane] = element(p, lane);
+		}
+		else
+		{
+			for (int lane = 0; lane < numLanes; ++lane)  b[lane] = Brighter(b[lane + numLanes], element(p, lane));
+		}
+	}
+
+	// The window for element i starts at padded element i and ends at padded element i + windowSize - 1
+	for (int i = 0; i < count; ++i)
+	{
+		const DilationSample* b = &backward[i * numLanes];
+		const DilationSample* f = &forward[(i + windowSize - 1) * numLanes];
+		for (int lane = 0; lane < numLanes; ++lane)
+		{
+			store(i, lane, Brighter(b[lane], f[lane]));
+		}
+	}
+}
+
+
+// Maximum along each row over a window of halfWidth samples either side of each sample
+static void RowMaximum(const std::vector<DilationSample>& source, std::vector<DilationSample>& target, int width, int height,
+                       int halfWidth, ThreadPool& threads)
+{
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		std::vector<DilationSample> forward, backward;
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			WindowMaximum(&source[y * width], &target[y * width], width, 1, 1, -halfWidth, halfWidth, false, forward, backward);
+		}
+	});
+}
+
+// Maximum down each column over rows windowStart to windowEnd from each sample, combined with the target. Strips of
+// columns are processed side by side so each step reads a run of neighbouring samples
+static void ColumnMaximum(const std::vector<DilationSample>& source, std::vector<DilationSample>& target, int width, int height,
+                          int windowStart, int windowEnd, ThreadPool& threads)
+{
+	const int STRIP_WIDTH = 64;
+	const int numStrips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+	threads.ParallelFor(numStrips, 1, [&](int stripBegin, int stripEnd)
+	{
+		std::vector<DilationSample> forward, backward;
+		for (int strip = stripBegin; strip < stripEnd; ++strip)
+		{
+			int x = strip * STRIP_WIDTH;
+			int stripWidth = std::min(STRIP_WIDTH, width - x);
+			WindowMaximum(&source[x], &target[x], height, stripWidth, width, windowStart, windowEnd, true, forward, backward);
+		}
+	});
+}
+
+
+//--------------------------------------------------------------------------------------
+// Dilation
+//--------------------------------------------------------------------------------------
+
+// Samples either side of the centre of the shader's grid
+const int DILATION_SAMPLES = 13;
+
+// Dilate the source into the target using dilationSize, dilationType and dilationThreshold (as Dilation_pp)
+void FastDilation(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads)
+{
+	const int width = source.Width();
+	const int height = source.Height();
+	target.Resize(width, height);
+	if (source.Empty())  return;
+
+	// Size of the shape in pixels from the centre to the edge. The shader's outermost samples are at dilationSize and
+	// land on the nearest pixel
+	const float radiusX = std::abs(constants.dilationSize.x) * width;
+	const float radiusY = std::abs(constants.dilationSize.y) * height;
+	const int rowRadius = static_cast<int>(std::floor(radiusY + 0.5f));
+
+	// Half-width of the shape on each row from -rowRadius to +rowRadius. Each row of the shader's grid lands on a row
+	// of pixels and its samples reach the nearest pixel to its outermost sample, so those rows get that half-width
+	std::vector<int> halfWidths(2 * rowRadius + 1, -1);
+	const float stepX = radiusX / DILATION_SAMPLES;
+	const float stepY = radiusY / DILATION_SAMPLES;
+	for (int j = -DILATION_SAMPLES; j <= DILATION_SAMPLES; ++j)
+	{
+		int samples = DILATION_SAMPLES - (constants.dilationType >= 2.0f ? std::abs(j) : 0);  // Diamond
+		if (constants.dilationType >= 1.0f)                                                   // Circle
+		{
+			while (samples * samples + j * j > DILATION_SAMPLES * DILATION_SAMPLES)  --samples;
+		}
+		int row = Clamp(static_cast<int>(std::floor(j * stepY + 0.5f)), -rowRadius, rowRadius);
+		int& halfWidth = halfWidths[row + rowRadius];
+		halfWidth = std::max(halfWidth, static_cast<int>(std::floor(samples * stepX + 0.5f)));
+	}
+
+	// Rows between the shader's samples, when they are more than a pixel apart, get the width of the shape at that height
+	for (int row = -rowRadius; row <= rowRadius; ++row)
+	{
+		if (halfWidths[row + rowRadius] >= 0)  continue;
+		float v = std::min(1.0f, std::abs(row) / radiusY);
+		float extent = 1.0f;                                                          // Square
+		if      (constants.dilationType >= 2.0f)  extent = 1.0f - v;                  // Diamond
+		else if (constants.dilationType >= 1.0f)  extent = std::sqrt(1.0f - v * v);  // Circle
+		halfWidths[row + rowRadius] = static_cast<int>(std::floor(radiusX * extent + 0.5f));
+	}
+
+	// Brightness of each pixel
+	const size_t numPixels = static_cast<size_t>(width) * height;
+	std::vector<DilationSample> samples(numPixels);
+	std::vector<DilationSample> rowMaximums(numPixels);
+	std::vector<DilationSample> brightest(numPixels, { -FLT_MAX, -1 });
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		for (int i = rowBegin * width; i < rowEnd * width; ++i)
+		{
+			samples[i] = { RGBToBrightness(source.Data()[i]), i };
+		}
+	});
+
+	// For each different half-width, take the maximum along the rows then down each run of rows that have that half-width
+	std::vector<int> differentWidths = halfWidths;
+	std::sort(differentWidths.begin(), differentWidths.end());
+	differentWidths.erase(std::unique(differentWidths.begin(), differentWidths.end()), differentWidths.end());
+	for (int halfWidth : differentWidths)
+	{
+		RowMaximum(samples, rowMaximums, width, height, halfWidth, threads);
+
+		int row = 0;
+		while (row < static_cast<int>(halfWidths.size()))
+		{
+			if (halfWidths[row] != halfWidth)
+			{
+				++row;
+				continue;
+			}
+			int runStart = row;
+			while (row < static_cast<int>(halfWidths.size()) && halfWidths[row] == halfWidth)  ++row;
+			ColumnMaximum(rowMaximums, brightest, width, height, runStart - rowRadius, row - 1 - rowRadius, threads);
+		}
+	}
+
+	// The brighter the brightest colour found is, the more of an effect it has on the final colour
+	threads.ParallelFor(height, 16, [&](int rowBegin, int rowEnd)
+	{
+		for (int i = rowBegin * width; i < rowEnd * width; ++i)
+		{
+			const ColourRGBA& originalColour = source.Data()[i];
+			ColourRGBA colour = originalColour;
+			float brightness = RGBToBrightness(originalColour);
+			if (brightest[i].brightness > brightness)
+			{
+				colour = source.Data()[brightest[i].index];
+				brightness = brightest[i].brightness;
+			}
+			target.Data()[i] = Saturate(LerpUnclamped(originalColour, colour, SmoothStep(constants.dilationThreshold.x, constants.dilationThreshold.y, brightness)));
+		}
+	});
+}
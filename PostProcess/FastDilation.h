@@ -0,0 +1,31 @@
+//--------------------------------------------------------------------------------------
+// Fast dilation - a version of Dilation_pp built from running maximums along lines
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// The dilation shader looks at a 27x27 grid of samples around each pixel and picks the brightest. Here each pixel
+// picks the brightest of every pixel within the shape instead. Each row of the shape spans the same pixels as the
+// shader's samples on that row, so while the samples are no more than a pixel apart (dilationSize up to 13 pixels) the
+// result is the same as the shader's. Larger shapes also take the pixels between the shader's samples rather than
+// missing small bright features. The shape is built from horizontal lines:
+// - The maximum along a line of any length is found with the van Herk/Gil-Werman method, which costs three
+//   comparisons per pixel
+// - Each row of the shape is a line. The maximum along each line length is taken once for the whole image, then the
+//   maximum down each run of rows of the shape that use that length, the same method working down the columns
+// A square has one line length, so it is two passes whatever its size. A diamond or circle needs a pass for each
+// different line length, so the cost rises with the size of the shape but far more slowly than sampling every pixel.
+
+#ifndef _FAST_DILATION_H_INCLUDED_
+#define _FAST_DILATION_H_INCLUDED_
+
+#include "ImageBuffer.h"
+#include "PostProcessingConstants.h"
+#include "ThreadPool.h"
+
+
+// Dilate the source into the target using dilationSize, dilationType and dilationThreshold (as Dilation_pp)
+// Target is resized to match the source. Source and target must be different images
+void FastDilation(const ImageBuffer& source, ImageBuffer& target, const PostProcessingConstants& constants, ThreadPool& threads);
+
+
+#endif //_FAST_DILATION_H_INCLUDED_
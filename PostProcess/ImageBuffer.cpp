@@ -0,0 +1,162 @@
+//--------------------------------------------------------------------------------------
+// Image buffer - an RGBA float image in CPU memory, the CPU equivalent of a post-processing texture
+//--------------------------------------------------------------------------------------
+
+#include "ImageBuffer.h"
+
+#include <algorithm>
+
+
+// Constructors - an empty image or one of the given size filled with a colour
+ImageBuffer::ImageBuffer() : mWidth(0), mHeight(0)
+{
+}
+
+ImageBuffer::ImageBuffer(int width, int height, const ColourRGBA& colour) : mWidth(0), mHeight(0)
+{
+	Resize(width, height);
+	Clear(colour);
+}
+
+
+// Change the size of the image. Pixel content is undefined afterwards
+void ImageBuffer::Resize(int width, int height)
+{
+	if (width < 0)  width = 0;
+	if (height < 0) height = 0;
+	mWidth = width;
+	mHeight = height;
+	mPixels.resize(static_cast<size_t>(width) * height);
+}
+
+// Fill the image with a colour
+void ImageBuffer::Clear(const ColourRGBA& colour)
+{
+	std::fill(mPixels.begin(), mPixels.end(), colour);
+}
+
+// Exchange contents with another image without copying the pixels
+void ImageBuffer::Swap(ImageBuffer& other)
+{
+	std::swap(mWidth, other.mWidth);
+	std::swap(mHeight, other.mHeight);
+	mPixels.swap(other.mPixels);
+}
+
+
+// Bilinear sampling with wrap addressing
+ColourRGBA ImageBuffer::SampleBilinearWrap(const CVector2& uv) const
+{
+	// Texel centres are at half-texel positions, so step back half a texel to find the four surrounding texels
+	float x = uv.x * mWidth - 0.5f;
+	float y = uv.y * mHeight - 0.5f;
+	float x0f = std::floor(x);
+	float y0f = std::floor(y);
+	float fx = x - x0f;
+	float fy = y - y0f;
+
+	// Wrap into range, the modulus of a negative number is negative in C++ so adjust for that
+	int x0 = static_cast<int>(std::fmod(x0f, static_cast<float>(mWidth)));
+	int y0 = static_cast<int>(std::fmod(y0f, static_cast<float>(mHeight)));
+	if (x0 < 0)  x0 += mWidth;
+	if (y0 < 0)  y0 += mHeight;
+	int x1 = (x0 + 1 == mWidth)  ? 0 : x0 + 1;
+	int y1 = (y0 + 1 == mHeight) ? 0 : y0 + 1;
+
+	const ColourRGBA& c00 = Pixel(x0, y0);
+	const ColourRGBA& c10 = Pixel(x1, y0);
+	const ColourRGBA& c01 = Pixel(x0, y1);
+	const ColourRGBA& c11 = Pixel(x1, y1);
+
+	ColourRGBA top    = c00 + (c10 - c00) * fx;
+	ColourRGBA bottom = c01 + (c11 - c01) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// Bilinear sampling with clamp addressing
+ColourRGBA ImageBuffer::SampleBilinearClamp(const CVector2& uv) const
+{
+	float x = uv.x * mWidth - 0.5f;
+	float y = uv.y * mHeight - 0.5f;
+	float x0f = std::floor(x);
+	float y0f = std::floor(y);
+	float fx = x - x0f;
+	float fy = y - y0f;
+
+	// Texels beyond the edges repeat the edge texels
+	int x0 = static_cast<int>(std::max(0.0f, std::min(x0f, mWidth - 1.0f)));
+	int y0 = static_cast<int>(std::max(0.0f, std::min(y0f, mHeight - 1.0f)));
+	int x1 = static_cast<int>(std::max(0.0f, std::min(x0f + 1.0f, mWidth - 1.0f)));
+	int y1 = static_cast<int>(std::max(0.0f, std::min(y0f + 1.0f, mHeight - 1.0f)));
+
+	const ColourRGBA& c00 = Pixel(x0, y0);
+	const ColourRGBA& c10 = Pixel(x1, y0);
+	const ColourRGBA& c01 = Pixel(x0, y1);
+	const ColourRGBA& c11 = Pixel(x1, y1);
+
+	ColourRGBA top    = c00 + (c10 - c00) * fx;
+	ColourRGBA bottom = c01 + (c11 - c01) * fx;
+	return top + (bottom - top) * fy;
+}
+
+
+// Conversion from 8-bit RGBA data
+void ImageBuffer::FromRGBA8(const uint8_t* data, int width, int height, int pitch)
+{
+	Resize(width, height);
+	const float scale = 1.0f / 255.0f;
+	for (int y = 0; y < height; ++y)
+	{
+		const uint8_t* source = data + static_cast<size_t>(y) * pitch;
+		ColourRGBA* row = Row(y);
+		for (int x = 0; x < width; ++x)
+		{
+			row[x] = { source[0] * scale, source[1] * scale, source[2] * scale, source[3] * scale };
+			source += 4;
+		}
+	}
+}
+
+// Conversion to 8-bit RGBA data, values are clamped to 0->1 and rounded as the GPU does when writing to a UNORM target
+void ImageBuffer::ToRGBA8(uint8_t* data, int pitch) const
+{
+	auto toByte = [](float value)
+	{
+		if (!(value > 0.0f))  return static_cast<uint8_t>(0);
+		if (value >= 1.0f)    return static_cast<uint8_t>(255);
+		return static_cast<uint8_t>(value * 255.0f + 0.5f);
+	};
+
+	for (int y = 0; y < mHeight; ++y)
+	{
+		uint8_t* target = data + static_cast<size_t>(y) * pitch;
+		const ColourRGBA* row = Row(y);
+		for (int x = 0; x < mWidth; ++x)
+		{
+			target[0] = toByte(row[x].r);
+			target[1] = toByte(row[x].g);
+			target[2] = toByte(row[x].b);
+			target[3] = toByte(row[x].a);
+			target += 4;
+		}
+	}
+}
+
+
+// Largest difference between any channel of this image and another of the same size
+float ImageBuffer::MaxDifference(const ImageBuffer& other) const
+{
+	if (mWidth != other.mWidth || mHeight != other.mHeight)  return -1.0f;
+
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < mPixels.size(); ++i)
+	{
+		const ColourRGBA& a = mPixels[i];
+		const ColourRGBA& b = other.mPixels[i];
+		maxDifference = std::max(maxDifference, std::abs(a.r - b.r));
+		maxDifference = std::max(maxDifference, std::abs(a.g - b.g));
+		maxDifference = std::max(maxDifference, std::abs(a.b - b.b));
+		maxDifference = std::max(maxDifference, std::abs(a.a - b.a));
+	}
+	return maxDifference;
+}
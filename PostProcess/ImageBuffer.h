@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------------------
+// Image buffer - an RGBA float image in CPU memory, the CPU equivalent of a post-processing texture
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+
+#ifndef _IMAGE_BUFFER_H_INCLUDED_
+#define _IMAGE_BUFFER_H_INCLUDED_
+
+#include "ColourRGBA.h"
+#include "CVector2.h"
+
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+
+
+class ImageBuffer
+{
+public:
+	// Constructors - an empty image or one of the given size filled with a colour
+	ImageBuffer();
+	ImageBuffer(int width, int height, const ColourRGBA& colour = { 0, 0, 0, 0 });
+
+
+	// Change the size of the image. Pixel content is undefined afterwards
+	void Resize(int width, int height);
+
+	// Fill the image with a colour
+	void Clear(const ColourRGBA& colour);
+
+	// Exchange contents with another image without copying the pixels
+	void Swap(ImageBuffer& other);
+
+
+	// Image size
+	int  Width()  const { return mWidth; }
+	int  Height() const { return mHeight; }
+	bool Empty()  const { return mPixels.empty(); }
+
+	// Direct pixel access, rows are stored top to bottom with no padding
+	ColourRGBA*       Data()                   { return mPixels.data(); }
+	const ColourRGBA* Data()             const { return mPixels.data(); }
+	ColourRGBA*       Row(int y)               { return mPixels.data() + y * mWidth; }
+	const ColourRGBA* Row(int y)         const { return mPixels.data() + y * mWidth; }
+	ColourRGBA&       Pixel(int x, int y)       { return mPixels[y * mWidth + x]; }
+	const ColourRGBA& Pixel(int x, int y) const { return mPixels[y * mWidth + x]; }
+
+
+	// Sampling - matches the samplers used by the post-processing shaders
+
+	// Point sampling with clamp addressing (gPointSampler)
+	ColourRGBA SamplePoint(const CVector2& uv) const
+	{
+		return mPixels[ClampIndex(uv.y, mHeight) * mWidth + ClampIndex(uv.x, mWidth)];
+	}
+
+	// Point sampling of the texel a whole number of texels across and down from the one containing uv, clamped
+	ColourRGBA SamplePointOffset(const CVector2& uv, int offsetX, int offsetY) const
+	{
+		int x = ClampIndex(uv.x, mWidth) + offsetX;
+		int y = ClampIndex(uv.y, mHeight) + offsetY;
+		x = x < 0 ? 0 : (x >= mWidth  ? mWidth - 1  : x);
+		y = y < 0 ? 0 : (y >= mHeight ? mHeight - 1 : y);
+		return mPixels[y * mWidth + x];
+	}
+
+	// Bilinear sampling with wrap addressing, used in place of gTrilinearSampler for the noise, burn and distort
+	// maps. These are only ever sampled at around their full size so only the top mip-level is used
+	ColourRGBA SampleBilinearWrap(const CVector2& uv) const;
+
+	// Bilinear sampling with clamp addressing (gBilinearClampSampler), used by the bloom pyramid
+	ColourRGBA SampleBilinearClamp(const CVector2& uv) const;
+
+
+	// Conversion to and from 8-bit RGBA data, as held in the R8G8B8A8_UNORM textures. Pitch is in bytes
+	void FromRGBA8(const uint8_t* data, int width, int height, int pitch);
+	void ToRGBA8(uint8_t* data, int pitch) const;
+
+
+	// Largest difference between any channel of this image and another of the same size, used to compare different
+	// implementations of a post-process. Returns a negative value if the sizes differ
+	float MaxDifference(const ImageBuffer& other) const;
+
+
+private:
+	// Texel index containing a texture coordinate, clamped to the image. Coordinates that are not a number go to 0
+	static int ClampIndex(float uv, int size)
+	{
+		float texel = std::floor(uv * size);
+		if (!(texel > 0.0f))  return 0;
+		if (texel >= size)    return size - 1;
+		return static_cast<int>(texel);
+	}
+
+	int mWidth;
+	int mHeight;
+	std::vector<ColourRGBA> mPixels;
+};
+
+
+#endif //_IMAGE_BUFFER_H_INCLUDED_
@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// Post-process descriptors - which effect to run and over which part of the screen
+//--------------------------------------------------------------------------------------
+
+#include "PostProcess.h"
+
+
+// Name of a post-process type, used for reports and log output
+const char* PostProcessTypeName(PostProcessType type)
+{
+	switch (type)
+	{
+	case PostProcessType::None:                return "None";
+	case PostProcessType::Copy:                return "Copy";
+	case PostProcessType::Tint:                return "Tint";
+	case PostProcessType::GreyNoise:           return "GreyNoise";
+	case PostProcessType::Burn:                return "Burn";
+	case PostProcessType::Distort:             return "Distort";
+	case PostProcessType::Spiral:              return "Spiral";
+	case PostProcessType::HeatHaze:            return "HeatHaze";
+	case PostProcessType::Gradient:            return "Gradient";
+	case PostProcessType::BlurX:               return "BlurX";
+	case PostProcessType::BlurY:               return "BlurY";
+	case PostProcessType::Underwater:          return "Underwater";
+	case PostProcessType::DepthOfField:        return "DepthOfField";
+	case PostProcessType::Retro:               return "Retro";
+	case PostProcessType::Bloom:               return "Bloom";
+	case PostProcessType::Brightness:          return "Brightness";
+	case PostProcessType::DirectionalBlur:     return "DirectionalBlur";
+	case PostProcessType::BloomPrefilter:      return "BloomPrefilter";
+	case PostProcessType::BloomDownsample:     return "BloomDownsample";
+	case PostProcessType::BloomUpsample:       return "BloomUpsample";
+	case PostProcessType::HueShift:            return "HueShift";
+	case PostProcessType::ChromaticAberration: return "ChromaticAberration";
+	case PostProcessType::Outline:             return "Outline";
+	case PostProcessType::Dilation:            return "Dilation";
+	case PostProcessType::FrostedGlass:        return "FrostedGlass";
+	case PostProcessType::Selection:           return "Selection";
+	}
+	return "Unknown";
+}
+
+// Name of a post-process mode, used for reports and log output
+const char* PostProcessModeName(PostProcessMode mode)
+{
+	switch (mode)
+	{
+	case PostProcessMode::Fullscreen: return "Fullscreen";
+	case PostProcessMode::Area:       return "Area";
+	case PostProcessMode::Polygon:    return "Polygon";
+	}
+	return "Unknown";
+}
+
+// Name of a bloom mode, used for reports and log output
+const char* BloomModeName(BloomMode mode)
+{
+	switch (mode)
+	{
+	case BloomMode::FullResolution: return "FullResolution";
+	case BloomMode::Pyramid:        return "Pyramid";
+	}
+	return "Unknown";
+}
@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------------------------
+// Post-process descriptors - which effect to run and over which part of the screen
+//--------------------------------------------------------------------------------------
+// Used by the GPU path in Scene.cpp and by the CPU PostProcessEngine
+
+#ifndef _POST_PROCESS_H_INCLUDED_
+#define _POST_PROCESS_H_INCLUDED_
+
+#include "CVector3.h"
+#include "CMatrix4x4.h"
+#include "PostProcessingConstants.h"
+
+#include <array>
+
+// Available post-processes
+enum class PostProcessType
+{
+	None,
+	Copy,
+	Tint,
+	GreyNoise,
+	Burn,
+	Distort,
+	Spiral,
+	HeatHaze,
+	Gradient,
+	BlurX,
+	BlurY,
+	Underwater,
+	DepthOfField,
+	Retro,
+	Bloom,
+	Brightness,
+	DirectionalBlur,
+	BloomPrefilter,
+	BloomDownsample,
+	BloomUpsample,
+	HueShift,
+	ChromaticAberration,
+	Outline,
+	Dilation,
+	FrostedGlass,
+	Selection,
+};
+const int NUM_POST_PROCESS_TYPES = static_cast<int>(PostProcessType::Selection) + 1;
+
+enum class PostProcessMode
+{
+	Fullscreen,
+	Area,
+	Polygon,
+};
+
+// How the bloom texture is built
+// - FullResolution: Brightness, BlurY and BlurX at full size, then the diagonal DirectionalBlur streaks added on top
+// - Pyramid: the bright areas are taken and halved in size once, then halved again down to 1/32 size with
+//   BloomDownsample. The levels are added back up the pyramid with BloomUpsample. Streaks are added at half size
+enum class BloomMode
+{
+	FullResolution,
+	Pyramid,
+};
+
+// Number of levels in the bloom pyramid, from 1/2 to 1/32 size. Streaks read level BLOOM_STREAK_LEVEL and are
+// added to the level above it
+const int BLOOM_PYRAMID_LEVELS = 5;
+const int BLOOM_STREAK_LEVEL = 1;
+
+// Width or height of a bloom pyramid level given the full size, level 0 is half size
+inline int BloomLevelSize(int size, int level)
+{
+	int levelSize = size >> (level + 1);
+	return levelSize > 0 ? levelSize : 1;
+}
+
+class PolygonData
+{
+public:
+	std::array<CVector3, 4> Points;
+	CMatrix4x4 Matrix;
+
+	PolygonData(std::array<CVector3, 4> points, CMatrix4x4 matrix)
+	{
+		Points = points;
+		Matrix = matrix;
+	}
+};
+
+class PostProcess
+{
+public:
+	PostProcessType Type;
+	PostProcessMode Mode;
+	PolygonData* PolyData;
+
+	// Settings for this post-process alone, or nullptr to use the shared settings. Only the fields its shader reads are
+	// used (see PostProcessConstantBlocks), the area always comes from the shared settings. Owned by the post-process
+	PostProcessingConstants* Constants;
+
+	PostProcess(PostProcessType type, PostProcessMode mode = PostProcessMode::Fullscreen, PolygonData* polyData = nullptr,
+	            PostProcessingConstants* constants = nullptr)
+	{
+		Type = type;
+		Mode = mode;
+		PolyData = polyData;
+		Constants = constants;
+	}
+
+	~PostProcess()
+	{
+		if (PolyData) delete PolyData;
+		if (Constants) delete Constants;
+	}
+};
+
+
+// Post-processes that move pixels around rather than just changing their colour. When one of these runs on the scene
+// the same distortion has to be applied to the normal/depth and focused object maps so they stay lined up with it
+inline bool IsDistortingPostProcess(PostProcessType type)
+{
+	return type == PostProcessType::Retro    ||
+	       type == PostProcessType::Spiral   || type == PostProcessType::Underwater ||
+	       type == PostProcessType::BlurX    || type == PostProcessType::BlurY      ||
+	       type == PostProcessType::Dilation || type == PostProcessType::FrostedGlass;
+}
+
+// Name of a post-process type, used for reports and log output
+const char* PostProcessTypeName(PostProcessType type);
+
+// Name of a post-process mode, used for reports and log output
+const char* PostProcessModeName(PostProcessMode mode);
+
+// Name of a bloom mode, used for reports and log output
+const char* BloomModeName(BloomMode mode);
+
+
+#endif //_POST_PROCESS_H_INCLUDED_
@@ -0,0 +1,532 @@
+//--------------------------------------------------------------------------------------
+// Post-process constant blocks - the settings sent to the post-processing shaders, split
+// into a small block for the area plus one block for each effect
+//--------------------------------------------------------------------------------------
+
+#include "PostProcessConstantBlocks.h"
+
+#include <cstring>
+
+
+//--------------------------------------------------------------------------------------
+// Block layouts
+//--------------------------------------------------------------------------------------
+// Each structure must match its cbuffer in Common.hlsli or the effect's _pp.hlsl file
+
+struct AreaBlock
+{
+	CVector2 area2DTopLeft;
+	CVector2 area2DSize;
+	float    area2DDepth;
+	float    padding[3];
+	CVector4 polygon2DPoints[4];
+};
+
+struct CopyBlock
+{
+	float copyAlpha;
+	float padding[3];
+};
+
+struct TintBlock
+{
+	CVector3 tintColour;
+	float    padding;
+};
+
+struct GreyNoiseBlock
+{
+	CVector2 noiseScale;
+	CVector2 noiseOffset;
+};
+
+// Burn, Distort, Spiral, HeatHaze and HueShift each have a single value
+struct SingleValueBlock
+{
+	float value;
+	float padding[3];
+};
+
+struct GradientBlock
+{
+	CVector2 gradientHue;
+	float    padding[2];
+};
+
+struct BlurBlock
+{
+	CVector2 blurSize;
+	float    standardDeviationSquared;
+	float    padding;
+};
+
+struct UnderwaterBlock
+{
+	float    underwaterHue;
+	CVector2 underwaterBrightness;
+	float    wobbleStrength;
+
+	float    wobbleTimer;
+	float    padding[3];
+};
+
+struct RetroBlock
+{
+	CVector2 pixelNumber;
+	float    pixelBrightnessHueShift;
+	float    pixelBrightnessLevels;
+
+	float    pixelSaturationMin;
+	float    pixelSaturationLevels;
+	CVector2 pixelHueRange;
+
+	float    pixelHueLevels;
+	float    padding[3];
+};
+
+struct BloomBlock
+{
+	float bloomThreshold;
+	float bloomIntensity;
+	float bloomLevelScale;
+	float padding;
+};
+
+struct DirectionalBlurBlock
+{
+	float directionalBlurSize;
+	float directionalBlurX;
+	float directionalBlurY;
+	float directionalBlurIntensity;
+};
+
+struct ChromaticAberrationBlock
+{
+	CVector3 colourOffset;
+	float    padding;
+};
+
+struct OutlineBlock
+{
+	float outlineThreshold;
+	float outlineThickness;
+	float padding[2];
+};
+
+struct DilationBlock
+{
+	CVector2 dilationSize;
+	float    dilationType;
+	float    padding1;
+
+	CVector2 dilationThreshold;
+	float    padding2[2];
+};
+
+struct DepthOfFieldBlock
+{
+	float focalPlane;
+	float nearPlane;
+	float farPlane;
+	float focusedObject;
+};
+
+struct FrostedGlassBlock
+{
+	float    frostedGlassFrequency;
+	CVector2 frostedGlassoffsetSize;
+	float    padding;
+};
+
+static_assert(sizeof(AreaBlock) == MAX_CONSTANT_BLOCK_BYTES && sizeof(UnderwaterBlock) == 32 && sizeof(RetroBlock) == 48 &&
+              sizeof(DilationBlock) == 32 && sizeof(FrostedGlassBlock) == 16, "Constant blocks must match the shaders");
+
+
+// Size of a block's cbuffer in bytes, a multiple of 16
+size_t ConstantBlockBytes(ConstantBlock block)
+{
+	switch (block)
+	{
+	case ConstantBlock::None:                return 0;
+	case ConstantBlock::Area:                return sizeof(AreaBlock);
+	case ConstantBlock::Copy:                return sizeof(CopyBlock);
+	case ConstantBlock::Tint:                return sizeof(TintBlock);
+	case ConstantBlock::GreyNoise:           return sizeof(GreyNoiseBlock);
+	case ConstantBlock::Burn:
+	case ConstantBlock::Distort:
+	case ConstantBlock::Spiral:
+	case ConstantBlock::HeatHaze:
+	case ConstantBlock::HueShift:            return sizeof(SingleValueBlock);
+	case ConstantBlock::Gradient:            return sizeof(GradientBlock);
+	case ConstantBlock::Blur:                return sizeof(BlurBlock);
+	case ConstantBlock::Underwater:          return sizeof(UnderwaterBlock);
+	case ConstantBlock::Retro:               return sizeof(RetroBlock);
+	case ConstantBlock::Bloom:               return sizeof(BloomBlock);
+	case ConstantBlock::DirectionalBlur:     return sizeof(DirectionalBlurBlock);
+	case ConstantBlock::ChromaticAberration: return sizeof(ChromaticAberrationBlock);
+	case ConstantBlock::Outline:             return sizeof(OutlineBlock);
+	case ConstantBlock::Dilation:            return sizeof(DilationBlock);
+	case ConstantBlock::DepthOfField:        return sizeof(DepthOfFieldBlock);
+	case ConstantBlock::FrostedGlass:        return sizeof(FrostedGlassBlock);
+	}
+	return 0;
+}
+
+// Shader register (bN) of a block, must match the cbuffers in the shaders
+int ConstantBlockRegister(ConstantBlock block)
+{
+	switch (block)
+	{
+	case ConstantBlock::Area:         return 1;
+	case ConstantBlock::Tint:         return 3;
+	case ConstantBlock::Gradient:     return 4;
+	case ConstantBlock::Bloom:        return 5;
+	case ConstantBlock::Blur:         return 6;
+	case ConstantBlock::Dilation:     return 7;
+	case ConstantBlock::DepthOfField: return 8;
+	case ConstantBlock::HueShift:     return 9;
+	default:                          return 2;
+	}
+}
+
+
+static void WriteSingleValue(float value, void* data)
+{
+	SingleValueBlock block = { value, { 0, 0, 0 } };
+	memcpy(data, &block, sizeof(block));
+}
+
+// Write a block's values from the settings in the layout of its cbuffer
+void WriteConstantBlock(ConstantBlock block, const PostProcessingConstants& s, void* data)
+{
+	switch (block)
+	{
+	case ConstantBlock::None:
+		break;
+
+	case ConstantBlock::Area:
+	{
+		AreaBlock area = { s.area2DTopLeft, s.area2DSize, s.area2DDepth, { 0, 0, 0 },
+		                   { s.polygon2DPoints[0], s.polygon2DPoints[1], s.polygon2DPoints[2], s.polygon2DPoints[3] } };
+		memcpy(data, &area, sizeof(area));
+		break;
+	}
+	case ConstantBlock::Copy:
+	{
+		CopyBlock copy = { s.copyAlpha, { 0, 0, 0 } };
+		memcpy(data, &copy, sizeof(copy));
+		break;
+	}
+	case ConstantBlock::Tint:
+	{
+		TintBlock tint = { s.tintColour, 0 };
+		memcpy(data, &tint, sizeof(tint));
+		break;
+	}
+	case ConstantBlock::GreyNoise:
+	{
+		GreyNoiseBlock greyNoise = { s.noiseScale, s.noiseOffset };
+		memcpy(data, &greyNoise, sizeof(greyNoise));
+		break;
+	}
+	case ConstantBlock::Burn:      WriteSingleValue(s.burnHeight,    data);  break;
+	case ConstantBlock::Distort:   WriteSingleValue(s.distortLevel,  data);  break;
+	case ConstantBlock::Spiral:    WriteSingleValue(s.spiralLevel,   data);  break;
+	case ConstantBlock::HeatHaze:  WriteSingleValue(s.heatHazeTimer, data);  break;
+	case ConstantBlock::HueShift:  WriteSingleValue(s.hueShift,      data);  break;
+
+	case ConstantBlock::Gradient:
+	{
+		GradientBlock gradient = { s.gradientHue, { 0, 0 } };
+		memcpy(data, &gradient, sizeof(gradient));
+		break;
+	}
+	case ConstantBlock::Blur:
+	{
+		BlurBlock blur = { s.blurSize, s.standardDeviationSquared, 0 };
+		memcpy(data, &blur, sizeof(blur));
+		break;
+	}
+	case ConstantBlock::Underwater:
+	{
+		UnderwaterBlock underwater = { s.underwaterHue, s.underwaterBrightness, s.wobbleStrength, s.wobbleTimer, { 0, 0, 0 } };
+		memcpy(data, &underwater, sizeof(underwater));
+		break;
+	}
+	case ConstantBlock::Retro:
+	{
+		RetroBlock retro = { s.pixelNumber, s.pixelBrightnessHueShift, s.pixelBrightnessLevels,
+		                     s.pixelSaturationMin, s.pixelSaturationLevels, s.pixelHueRange, s.pixelHueLevels, { 0, 0, 0 } };
+		memcpy(data, &retro, sizeof(retro));
+		break;
+	}
+	case ConstantBlock::Bloom:
+	{
+		BloomBlock bloom = { s.bloomThreshold, s.bloomIntensity, s.bloomLevelScale, 0 };
+		memcpy(data, &bloom, sizeof(bloom));
+		break;
+	}
+	case ConstantBlock::DirectionalBlur:
+	{
+		DirectionalBlurBlock blur = { s.directionalBlurSize, s.directionalBlurX, s.directionalBlurY, s.directionalBlurIntensity };
+		memcpy(data, &blur, sizeof(blur));
+		break;
+	}
+	case ConstantBlock::ChromaticAberration:
+	{
+		ChromaticAberrationBlock aberration = { s.colourOffset, 0 };
+		memcpy(data, &aberration, sizeof(aberration));
+		break;
+	}
+	case ConstantBlock::Outline:
+	{
+		OutlineBlock outline = { s.outlineThreshold, s.outlineThickness, { 0, 0 } };
+		memcpy(data, &outline, sizeof(outline));
+		break;
+	}
+	case ConstantBlock::Dilation:
+	{
+		DilationBlock dilation = { s.dilationSize, s.dilationType, 0, s.dilationThreshold, { 0, 0 } };
+		memcpy(data, &dilation, sizeof(dilation));
+		break;
+	}
+	case ConstantBlock::DepthOfField:
+	{
+		DepthOfFieldBlock depthOfField = { s.focalPlane, s.nearPlane, s.farPlane, s.focusedObject };
+		memcpy(data, &depthOfField, sizeof(depthOfField));
+		break;
+	}
+	case ConstantBlock::FrostedGlass:
+	{
+		FrostedGlassBlock frostedGlass = { s.frostedGlassFrequency, s.frostedGlassoffsetSize, 0 };
+		memcpy(data, &frostedGlass, sizeof(frostedGlass));
+		break;
+	}
+	}
+}
+
+
+// The blocks of settings a post-process's pixel shader reads besides the area. Must list every cbuffer the shader reads,
+// Tools/PostProcessConformance checks this against the shader files
+PostProcessBlocks PostProcessConstantBlocks(PostProcessType type)
+{
+	typedef ConstantBlock B;
+	switch (type)
+	{
+	case PostProcessType::Copy:                return { { B::Copy },                      1 };
+	case PostProcessType::Tint:                return { { B::Tint },                      1 };
+	case PostProcessType::GreyNoise:           return { { B::GreyNoise },                 1 };
+	case PostProcessType::Burn:                return { { B::Burn },                      1 };
+	case PostProcessType::Distort:             return { { B::Distort },                   1 };
+	case PostProcessType::Spiral:              return { { B::Spiral },                    1 };
+	case PostProcessType::HeatHaze:            return { { B::HeatHaze },                  1 };
+	case PostProcessType::Gradient:            return { { B::Gradient },                  1 };
+	case PostProcessType::BlurX:
+	case PostProcessType::BlurY:               return { { B::Blur },                      1 };
+	case PostProcessType::Underwater:          return { { B::Underwater },                1 };
+	case PostProcessType::DepthOfField:        return { { B::Dilation, B::DepthOfField }, 2 };
+	case PostProcessType::Retro:               return { { B::Retro },                     1 };
+	case PostProcessType::Bloom:
+	case PostProcessType::Brightness:
+	case PostProcessType::BloomPrefilter:
+	case PostProcessType::BloomDownsample:     // Through BloomDownsample13, though it doesn't use the threshold
+	case PostProcessType::BloomUpsample:       return { { B::Bloom },                     1 };
+	case PostProcessType::DirectionalBlur:     return { { B::DirectionalBlur, B::Blur },  2 }; // Blur for Gauss
+	case PostProcessType::HueShift:            return { { B::HueShift },                  1 };
+	case PostProcessType::ChromaticAberration: return { { B::ChromaticAberration },       1 };
+	case PostProcessType::Outline:
+	case PostProcessType::Selection:           return { { B::Outline },                   1 };
+	case PostProcessType::Dilation:            return { { B::Dilation },                  1 };
+	case PostProcessType::FrostedGlass:        return { { B::FrostedGlass },              1 };
+	default:                                   return { { B::None },                      0 };
+	}
+}
+
+
+const char* ConstantBlockName(ConstantBlock block)
+{
+	switch (block)
+	{
+	case ConstantBlock::None:                return "None";
+	case ConstantBlock::Area:                return "Area";
+	case ConstantBlock::Copy:                return "Copy";
+	case ConstantBlock::Tint:                return "Tint";
+	case ConstantBlock::GreyNoise:           return "GreyNoise";
+	case ConstantBlock::Burn:                return "Burn";
+	case ConstantBlock::Distort:             return "Distort";
+	case ConstantBlock::Spiral:              return "Spiral";
+	case ConstantBlock::HeatHaze:            return "HeatHaze";
+	case ConstantBlock::Gradient:            return "Gradient";
+	case ConstantBlock::HueShift:            return "HueShift";
+	case ConstantBlock::Blur:                return "Blur";
+	case ConstantBlock::Underwater:          return "Underwater";
+	case ConstantBlock::Retro:               return "Retro";
+	case ConstantBlock::Bloom:               return "Bloom";
+	case ConstantBlock::DirectionalBlur:     return "DirectionalBlur";
+	case ConstantBlock::ChromaticAberration: return "ChromaticAberration";
+	case ConstantBlock::Outline:             return "Outline";
+	case ConstantBlock::Dilation:            return "Dilation";
+	case ConstantBlock::DepthOfField:        return "DepthOfField";
+	case ConstantBlock::FrostedGlass:        return "FrostedGlass";
+	}
+	return "Unknown";
+}
+
+
+//--------------------------------------------------------------------------------------
+// Cache
+//--------------------------------------------------------------------------------------
+
+PostProcessConstantCache::PostProcessConstantCache(ConstantBufferBackend* backend)
+	: mBackend(backend)
+{
+}
+
+PostProcessConstantCache::~PostProcessConstantCache()
+{
+	DestroyAll();
+}
+
+
+// Get the buffer holding a block of the given settings for an owner, uploading the block first if it has changed
+int PostProcessConstantCache::Update(ConstantBlock block, const void* owner, const PostProcessingConstants& settings)
+{
+	const size_t bytes = ConstantBlockBytes(block);
+	if (bytes == 0)  return -1;
+
+	++mFrameStats.updates;
+	if (block == ConstantBlock::Area)
+	{
+		++mFrameStats.passes;
+		mFrameStats.wholeBytes += sizeof(PostProcessingConstants);
+	}
+
+	// Create the buffer the first time an owner uses a block, at the lowest free index
+	auto found = mBlocks.find(BlockKey(owner, block));
+	if (found == mBlocks.end())
+	{
+		int buffer = mNextBuffer;
+		if (!mFreeBuffers.empty())
+		{
+			buffer = mFreeBuffers.back();
+			mFreeBuffers.pop_back();
+		}
+		if (!mBackend->CreateBuffer(buffer, bytes))
+		{
+			if (buffer != mNextBuffer)  mFreeBuffers.push_back(buffer);
+			return -1;
+		}
+		if (buffer == mNextBuffer)  ++mNextBuffer;
+
+		CachedBlock cached;
+		cached.buffer = buffer;
+		cached.uploaded = false;
+		found = mBlocks.insert({ BlockKey(owner, block), cached }).first;
+		++mStats.numBuffers;
+	}
+
+	// Only upload if the values differ from what the buffer already has
+	CachedBlock& cached = found->second;
+	cached.lastUsedFrame = mFrame;
+	uint8_t data[MAX_CONSTANT_BLOCK_BYTES];
+	WriteConstantBlock(block, settings, data);
+	if (!cached.uploaded || memcmp(cached.data, data, bytes) != 0)
+	{
+		mBackend->Upload(cached.buffer, data, bytes);
+		memcpy(cached.data, data, bytes);
+		cached.uploaded = true;
+		++mFrameStats.uploads;
+		mFrameStats.uploadedBytes += bytes;
+	}
+	return cached.buffer;
+}
+
+// Whether the next Update of a block for an owner would upload it
+bool PostProcessConstantCache::IsDirty(ConstantBlock block, const void* owner, const PostProcessingConstants& settings) const
+{
+	auto found = mBlocks.find(BlockKey(owner, block));
+	if (found == mBlocks.end() || !found->second.uploaded)  return true;
+
+	uint8_t data[MAX_CONSTANT_BLOCK_BYTES];
+	WriteConstantBlock(block, settings, data);
+	return memcmp(found->second.data, data, ConstantBlockBytes(block)) != 0;
+}
+
+
+// Call at the end of each frame
+void PostProcessConstantCache::EndFrame()
+{
+	for (auto cached = mBlocks.begin(); cached != mBlocks.end(); )
+	{
+		if (mFrame - cached->second.lastUsedFrame >= mMaxUnusedFrames)
+		{
+			mBackend->DestroyBuffer(cached->second.buffer);
+			mFreeBuffers.push_back(cached->second.buffer);
+			cached = mBlocks.erase(cached);
+			--mStats.numBuffers;
+		}
+		else
+		{
+			++cached;
+		}
+	}
+
+	mStats.passes        = mFrameStats.passes;
+	mStats.updates       = mFrameStats.updates;
+	mStats.uploads       = mFrameStats.uploads;
+	mStats.uploadedBytes = mFrameStats.uploadedBytes;
+	mStats.wholeBytes    = mFrameStats.wholeBytes;
+	mStats.totalPasses        += mFrameStats.passes;
+	mStats.totalUploads       += mFrameStats.uploads;
+	mStats.totalUploadedBytes += mFrameStats.uploadedBytes;
+	mStats.totalWholeBytes    += mFrameStats.wholeBytes;
+	++mStats.numFrames;
+
+	mFrameStats = ConstantUploadStats();
+	++mFrame;
+}
+
+// Restart the totals from now
+void PostProcessConstantCache::ResetStats()
+{
+	mStats.totalPasses = 0;
+	mStats.totalUploads = 0;
+	mStats.totalUploadedBytes = 0;
+	mStats.totalWholeBytes = 0;
+	mStats.numFrames = 0;
+}
+
+// Destroy every buffer
+void PostProcessConstantCache::DestroyAll()
+{
+	for (auto& cached : mBlocks)  mBackend->DestroyBuffer(cached.second.buffer);
+	mBlocks.clear();
+	mFreeBuffers.clear();
+	mNextBuffer = 0;
+	mStats.numBuffers = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Memory backend
+//--------------------------------------------------------------------------------------
+
+bool MemoryConstantBackend::CreateBuffer(int buffer, size_t bytes)
+{
+	if (buffer >= static_cast<int>(mBuffers.size()))  mBuffers.resize(buffer + 1);
+	mBuffers[buffer].assign(bytes, 0);
+	return true;
+}
+
+void MemoryConstantBackend::Upload(int buffer, const void* data, size_t bytes)
+{
+	const uint8_t* bytePointer = static_cast<const uint8_t*>(data);
+	mBuffers[buffer].assign(bytePointer, bytePointer + bytes);
+	++mNumUploads;
+	mUploadedBytes += bytes;
+}
+
+void MemoryConstantBackend::DestroyBuffer(int buffer)
+{
+	mBuffers[buffer].clear();
+}
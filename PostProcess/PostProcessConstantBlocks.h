@@ -0,0 +1,221 @@
+//--------------------------------------------------------------------------------------
+// Post-process constant blocks - the settings sent to the post-processing shaders, split
+// into a small block for the area plus one block for each effect
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// PostProcessingConstants holds the settings of every post-process, but a pass only reads the area it covers and the
+// settings of its own effect. Each is sent to the shaders as its own constant buffer (see the cbuffers in Common.hlsli
+// and the _pp.hlsl files), so a pass sends at most 96 bytes for the area and a few bytes for its effect rather than the
+// whole structure.
+//
+// PostProcessConstantCache keeps one buffer for each block and owner, with a copy of what the buffer was last sent. A
+// block is only uploaded when it differs from that copy, so settings that don't change from pass to pass or frame to
+// frame are not sent again. The owner lets a post-process have its own copy of a block - each area and polygon
+// post-process has its own area buffer, and a post-process with its own settings (PostProcess::Constants) has its own
+// effect buffer, so two instances of the same effect with different settings don't replace each other's values.
+//
+// The buffers are made by a backend - Scene.cpp creates Direct3D constant buffers, MemoryConstantBackend below keeps
+// them in memory so the uploads can be checked and counted without a GPU
+
+#ifndef _POST_PROCESS_CONSTANT_BLOCKS_H_INCLUDED_
+#define _POST_PROCESS_CONSTANT_BLOCKS_H_INCLUDED_
+
+#include "PostProcess.h"
+#include "PostProcessingConstants.h"
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+
+// Blocks of post-processing settings, each a cbuffer in the shaders
+enum class ConstantBlock
+{
+	None,
+	Area,                // Area or polygon of the screen covered, read by the vertex shaders and some pixel shaders
+	Copy,
+	Tint,
+	GreyNoise,
+	Burn,
+	Distort,
+	Spiral,
+	HeatHaze,
+	Gradient,
+	HueShift,
+	Blur,                // BlurX and BlurY, and the Gauss function DirectionalBlur uses
+	Underwater,
+	Retro,
+	Bloom,               // Bloom, Brightness and the bloom pyramid passes
+	DirectionalBlur,
+	ChromaticAberration,
+	Outline,             // Outline and Selection
+	Dilation,            // Dilation and DepthOfField
+	DepthOfField,        // Focal planes, read by DepthOfField through DilationForDepth
+	FrostedGlass,
+};
+const int NUM_CONSTANT_BLOCKS = static_cast<int>(ConstantBlock::FrostedGlass) + 1;
+
+// Largest block, the area with its polygon points
+const size_t MAX_CONSTANT_BLOCK_BYTES = 96;
+
+// Shader register (bN) of a block. Blocks read by functions in Common.hlsli have their own register so a fused pass can
+// read several of them, the rest are only read by their own shader and share register 2
+int ConstantBlockRegister(ConstantBlock block);
+
+// Size of a block's cbuffer in bytes, a multiple of 16
+size_t ConstantBlockBytes(ConstantBlock block);
+
+// Write a block's values from the settings in the layout of its cbuffer, data must hold ConstantBlockBytes
+void WriteConstantBlock(ConstantBlock block, const PostProcessingConstants& settings, void* data);
+
+// Most blocks of settings a single post-process's pixel shader reads besides the area
+const int MAX_POST_PROCESS_BLOCKS = 2;
+
+// The blocks of settings a post-process's pixel shader reads besides the area, including those read by the functions in
+// Common.hlsli it calls (e.g. DepthOfField reads the focal planes through DilationForDepth). Empty if it reads none
+struct PostProcessBlocks
+{
+	ConstantBlock blocks[MAX_POST_PROCESS_BLOCKS];
+	int           count;
+
+	const ConstantBlock* begin() const { return blocks; }
+	const ConstantBlock* end()   const { return blocks + count; }
+};
+PostProcessBlocks PostProcessConstantBlocks(PostProcessType type);
+
+// Name of a block, used for reports and log output
+const char* ConstantBlockName(ConstantBlock block);
+
+
+//--------------------------------------------------------------------------------------
+// Backend
+//--------------------------------------------------------------------------------------
+
+// Creates, fills and destroys the buffers of a cache. Buffers are identified by their index in the cache, and an index
+// is only reused once the buffer that had it is destroyed
+class ConstantBufferBackend
+{
+public:
+	virtual ~ConstantBufferBackend() {}
+
+	// Create the buffer with the given index and size, returns true on success
+	virtual bool CreateBuffer(int buffer, size_t bytes) = 0;
+
+	// Replace the whole content of a buffer (one Map/Unmap)
+	virtual void Upload(int buffer, const void* data, size_t bytes) = 0;
+
+	// Destroy the buffer with the given index
+	virtual void DestroyBuffer(int buffer) = 0;
+};
+
+
+// Uploads made by a cache. A pass is counted each time the Area block is asked for, which every pass does once
+struct ConstantUploadStats
+{
+	int    passes        = 0; // Passes in the last frame
+	int    updates       = 0; // Blocks asked for in the last frame
+	int    uploads       = 0; // Of those, blocks that had changed and were uploaded, one Map each
+	size_t uploadedBytes = 0; // Bytes uploaded in the last frame
+	size_t wholeBytes    = 0; // Bytes sending the whole PostProcessingConstants to every pass of the last frame would take
+
+	int    totalPasses        = 0; // As above, over all frames counted
+	int    totalUploads       = 0;
+	size_t totalUploadedBytes = 0;
+	size_t totalWholeBytes    = 0;
+
+	int    numBuffers = 0; // Buffers held now
+	int    numFrames  = 0; // Frames counted
+};
+
+
+//--------------------------------------------------------------------------------------
+// Cache
+//--------------------------------------------------------------------------------------
+
+class PostProcessConstantCache
+{
+public:
+	// Frames a buffer can go unused before it is destroyed, by default
+	static const int DEFAULT_MAX_UNUSED_FRAMES = 60;
+
+	// The backend must stay valid for the life of the cache
+	PostProcessConstantCache(ConstantBufferBackend* backend);
+	~PostProcessConstantCache();
+
+	// Prevent copying, the buffers belong to the backend
+	PostProcessConstantCache(const PostProcessConstantCache&) = delete;
+	PostProcessConstantCache& operator=(const PostProcessConstantCache&) = delete;
+
+
+	// Get the buffer holding a block of the given settings for an owner, uploading the block first if it differs from
+	// what that buffer was last sent. Pass nullptr as the owner for the buffer shared by everything without its own.
+	// Returns the index of the buffer, or -1 if it could not be created
+	int Update(ConstantBlock block, const void* owner, const PostProcessingConstants& settings);
+
+	// Whether the next Update of a block for an owner would upload it
+	bool IsDirty(ConstantBlock block, const void* owner, const PostProcessingConstants& settings) const;
+
+	// Call at the end of each frame. Destroys buffers that have gone unused for the maximum number of frames, such as
+	// those of deleted post-processes, and updates the stats
+	void EndFrame();
+
+	// Frames a buffer can go unused before it is destroyed, at least 1
+	void SetMaxUnusedFrames(int frames) { mMaxUnusedFrames = (frames < 1 ? 1 : frames); }
+
+	// Uploads made by the cache
+	const ConstantUploadStats& Stats() const { return mStats; }
+
+	// Restart the totals from now
+	void ResetStats();
+
+	// Destroy every buffer, e.g. before the device is released
+	void DestroyAll();
+
+
+private:
+	struct CachedBlock
+	{
+		int     buffer;
+		bool    uploaded;
+		int     lastUsedFrame;
+		uint8_t data[MAX_CONSTANT_BLOCK_BYTES]; // What the buffer was last sent
+	};
+	typedef std::pair<const void*, ConstantBlock> BlockKey;
+
+	ConstantBufferBackend*          mBackend;
+	std::map<BlockKey, CachedBlock> mBlocks;
+	std::vector<int>                mFreeBuffers; // Indexes of destroyed buffers, to reuse
+	int                             mNextBuffer = 0;
+	int                             mMaxUnusedFrames = DEFAULT_MAX_UNUSED_FRAMES;
+	int                             mFrame = 0;
+
+	ConstantUploadStats mFrameStats; // Counts for the frame in progress
+	ConstantUploadStats mStats;
+};
+
+
+// Backend that keeps each buffer in memory, to check what the shaders would read and count uploads without a GPU
+class MemoryConstantBackend : public ConstantBufferBackend
+{
+public:
+	bool CreateBuffer(int buffer, size_t bytes) override;
+	void Upload(int buffer, const void* data, size_t bytes) override;
+	void DestroyBuffer(int buffer) override;
+
+	// Content of a buffer, empty if it has been destroyed
+	const std::vector<uint8_t>& Contents(int buffer) const { return mBuffers[buffer]; }
+
+	int    NumUploads()    const { return mNumUploads; }
+	size_t UploadedBytes() const { return mUploadedBytes; }
+
+private:
+	std::vector<std::vector<uint8_t>> mBuffers;
+	int    mNumUploads = 0;
+	size_t mUploadedBytes = 0;
+};
+
+
+#endif //_POST_PROCESS_CONSTANT_BLOCKS_H_INCLUDED_
@@ -0,0 +1,639 @@
+//--------------------------------------------------------------------------------------
+// CPU post-processing engine - runs post-process chains on image buffers without a GPU
+//--------------------------------------------------------------------------------------
+
+#include "PostProcessEngine.h"
+#include "ShaderFunctions.h"
+#include "FastBlur.h"
+#include "FastDilation.h"
+#include "FastDepthOfField.h"
+#include "FastBloom.h"
+#include "PostProcessFusion.h"
+#include "PostProcessGraph.h"
+#include "MathHelpers.h"
+#include "TransformBatch.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+
+// Kernel that returns the scene pixel unchanged, used to place a result calculated for the whole image within an area or polygon
+static ColourRGBA PassThroughKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return inputs.scene->SamplePoint(pixel.sceneUV);
+}
+
+// Settings a post-process runs with: its own if it has them, otherwise the shared ones. The area and polygon always come
+// from the shared settings, as on the GPU
+static PostProcessingConstants PassConstants(const PostProcess& postProcess, const PostProcessingConstants& shared)
+{
+	if (postProcess.Constants == nullptr)  return shared;
+
+	PostProcessingConstants constants = *postProcess.Constants;
+	constants.area2DTopLeft = shared.area2DTopLeft;
+	constants.area2DSize    = shared.area2DSize;
+	constants.area2DDepth   = shared.area2DDepth;
+	for (int i = 0; i < 4; ++i)  constants.polygon2DPoints[i] = shared.polygon2DPoints[i];
+	return constants;
+}
+
+
+// Constructor - pass the number of threads to use, 0 to use all cores
+PostProcessEngine::PostProcessEngine(unsigned int numThreads)
+	: mThreads(numThreads), mViewProjection(MatrixIdentity()), mDiagonalBlurs(3), mFusion(true), mLazyMapDistortion(true), mBloomMode(BloomMode::FullResolution), mTileHeight(16)
+{
+	for (auto& method : mMethods)  method = ProcessMethod::Fast;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Post-process chains
+//--------------------------------------------------------------------------------------
+
+// Run a chain of post-processes on the scene image, the result is left in the scene image
+bool PostProcessEngine::Run(const std::vector<PostProcess*>& postProcesses, const PostProcessingConstants& constants,
+                            ImageBuffer& scene, ImageBuffer* normalDepth, ImageBuffer* focus)
+{
+	mTimings.clear();
+	mLastError.clear();
+
+	if (scene.Empty())
+	{
+		mLastError = "Empty scene image";
+		return false;
+	}
+	if ((normalDepth && (normalDepth->Width() != scene.Width() || normalDepth->Height() != scene.Height())) ||
+	    (focus       && (focus->Width()       != scene.Width() || focus->Height()       != scene.Height())))
+	{
+		mLastError = "Normal/depth and focused object maps must be the same size as the scene";
+		return false;
+	}
+
+	// Ping-pong between the given images and a second image for each. Unlike the GPU version there is no need for
+	// copies after area and polygon effects because Apply copies the source into the target itself
+	ImageBuffer* sceneSource = &scene;
+	ImageBuffer* sceneTarget = &mSceneTarget;
+	ImageBuffer* ndSource    = normalDepth;
+	ImageBuffer* ndTarget    = &mNormalDepthTarget;
+	ImageBuffer* focusSource = focus;
+	ImageBuffer* focusTarget = &mFocusTarget;
+
+	// As in RenderScene, selection does nothing without a focused object. Leave out skipped post-processes first so they
+	// don't split up runs that can be fused
+	mChain.clear();
+	for (const PostProcess* postProcess : postProcesses)
+	{
+		if (postProcess == nullptr || postProcess->Type == PostProcessType::None)  continue;
+		if (postProcess->Type == PostProcessType::Selection && focusSource == nullptr)  continue;
+		mChain.push_back(postProcess);
+	}
+
+	mNormalDepthDistortions.clear();
+	mFocusDistortions.clear();
+
+	bool ok = true;
+	int numStages = 1;
+	for (int i = 0; i < static_cast<int>(mChain.size()); i += numStages)
+	{
+		// Runs of fused post-processes are one pass on the scene. Only the first can be distorting, so the maps are
+		// distorted by the first alone below
+		const PostProcess* postProcess = mChain[i];
+		numStages = mFusion ? FusedRunLength(&mChain[i], static_cast<int>(mChain.size()) - i) : 1;
+
+		// Bring the maps the post-process reads up to date
+		unsigned int reads = PostProcessReads(postProcess->Type);
+		if (((reads & GraphImageBit(GraphImage::NormalDepth)) && !ApplyMapDistortions(mNormalDepthDistortions, constants, ndSource, ndTarget)) ||
+		    ((reads & GraphImageBit(GraphImage::Focus))       && !ApplyMapDistortions(mFocusDistortions, constants, focusSource, focusTarget)))
+		{
+			ok = false;
+			break;
+		}
+
+		bool applied = (numStages > 1) ? ApplyFused(&mChain[i], numStages, constants, *sceneSource, *sceneTarget)
+		                               : Apply(*postProcess, constants, *sceneSource, *sceneTarget, ndSource, focusSource);
+		if (!applied)
+		{
+			ok = false;
+			break;
+		}
+		std::swap(sceneSource, sceneTarget);
+
+		// If the post process distorts the image, the same distortion must be applied to the normal/depth and focus maps
+		// as well. It waits until a post-process reads the map, unless lazy map distortion is off
+		if (IsDistortingPostProcess(postProcess->Type))
+		{
+			if (ndSource)     mNormalDepthDistortions.push_back(postProcess);
+			if (focusSource)  mFocusDistortions.push_back(postProcess);
+			if (!mLazyMapDistortion &&
+			    (!ApplyMapDistortions(mNormalDepthDistortions, constants, ndSource, ndTarget) ||
+			     !ApplyMapDistortions(mFocusDistortions, constants, focusSource, focusTarget)))
+			{
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	// Results should end up in the images passed in. Swap the buffers rather than copying if they ended up in the second images
+	if (sceneSource != &scene)                scene.Swap(*sceneSource);
+	if (normalDepth && ndSource != normalDepth)  normalDepth->Swap(*ndSource);
+	if (focus && focusSource != focus)        focus->Swap(*focusSource);
+
+	return ok;
+}
+
+
+// Apply the distortions waiting for a map to it, switching source and target after each
+bool PostProcessEngine::ApplyMapDistortions(std::vector<const PostProcess*>& distortions, const PostProcessingConstants& constants,
+                                            ImageBuffer*& source, ImageBuffer*& target)
+{
+	for (const PostProcess* distortion : distortions)
+	{
+		if (!Apply(*distortion, constants, *source, *target))  return false;
+		std::swap(source, target);
+	}
+	distortions.clear();
+	return true;
+}
+
+
+// Apply a single post-process from source to target
+bool PostProcessEngine::Apply(const PostProcess& postProcess, const PostProcessingConstants& constants, const ImageBuffer& source, ImageBuffer& target,
+                              const ImageBuffer* normalDepth, const ImageBuffer* focus)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	PostProcessKernel kernel = GetPostProcessKernel(postProcess.Type);
+	if (kernel == nullptr)
+	{
+		mLastError = "Unknown post-process type";
+		return false;
+	}
+
+	// Local copy of the settings so the area can be set for each pass as FullScreenPostProcess etc. do
+	PostProcessingConstants passConstants = PassConstants(postProcess, constants);
+
+	PostProcessInputs inputs;
+	inputs.scene       = &source;
+	inputs.normalDepth = normalDepth;
+	inputs.focus       = focus;
+	inputs.noiseMap    = mTextures.noiseMap;
+	inputs.burnMap     = mTextures.burnMap;
+	inputs.distortMap  = mTextures.distortMap;
+	inputs.noiseMap2   = mTextures.noiseMap2;
+	inputs.constants   = &passConstants;
+
+	// Render a texture that shows blurred bright areas to use in the bloom post-process
+	if (postProcess.Type == PostProcessType::Bloom)
+	{
+		if (!RenderBloomTexture(source, constants))  return false;
+		inputs.bloom = &mBloomTexture;
+	}
+
+	const char* inputError = CheckPostProcessInputs(postProcess.Type, inputs);
+	if (inputError != nullptr)
+	{
+		mLastError = std::string(PostProcessTypeName(postProcess.Type)) + ": " + inputError;
+		return false;
+	}
+
+	if (target.Width() != source.Width() || target.Height() != source.Height())
+	{
+		target.Resize(source.Width(), source.Height());
+	}
+
+	// Fast passes work on the whole image at once rather than per-pixel. For areas and polygons the whole image is processed
+	// first, then the result is passed through the area or polygon as the shader output would be
+	if (UsesFastPass(postProcess.Type) && postProcess.Mode != PostProcessMode::Fullscreen)
+	{
+		ImagePass(postProcess.Type, inputs, mFastPassTemp);
+		inputs.scene = &mFastPassTemp;
+		kernel = PassThroughKernel;
+	}
+
+	if (postProcess.Mode == PostProcessMode::Fullscreen)
+	{
+		passConstants.area2DTopLeft = { 0, 0 };
+		passConstants.area2DSize    = { 1, 1 };
+		passConstants.area2DDepth   = 0;
+		ImagePass(postProcess.Type, inputs, target);
+	}
+	else if (postProcess.Mode == PostProcessMode::Area)
+	{
+		// The area top-left and size are calculated by the caller from the camera, as AreaPostProcess does
+		AreaPass(kernel, inputs, source, target);
+	}
+	else if (postProcess.Mode == PostProcessMode::Polygon)
+	{
+		if (postProcess.PolyData == nullptr)
+		{
+			mLastError = "Polygon post-process without polygon data";
+			return false;
+		}
+
+		// Transform the points to 2D as PolygonPostProcess does. The area settings are those of a full screen pass, as they
+		// are on the GPU after the initial copy
+		passConstants.area2DTopLeft = { 0, 0 };
+		passConstants.area2DSize    = { 1, 1 };
+		passConstants.area2DDepth   = 0;
+		CVector4 worldPoints[4];
+		TransformPoints(postProcess.PolyData->Points.data(), worldPoints, 4, postProcess.PolyData->Matrix);
+		Transform(worldPoints, passConstants.polygon2DPoints, 4, mViewProjection);
+		PolygonPass(kernel, inputs, source, target);
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+	mTimings.push_back({ postProcess.Type, postProcess.Mode, source.Width() * source.Height(),
+	                     std::chrono::duration<double>(endTime - startTime).count(), 1 });
+	return true;
+}
+
+
+// Apply a run of full screen post-processes that can be fused from source to target in one pass
+bool PostProcessEngine::ApplyFused(const PostProcess* const* stages, int numStages, const PostProcessingConstants& constants,
+                                   const ImageBuffer& source, ImageBuffer& target)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	const PostProcessType headType = stages[0]->Type;
+	PostProcessKernel kernel = GetPostProcessKernel(headType);
+	std::vector<PointPostProcess> pointPostProcesses;
+	for (int i = 1; i < numStages; ++i)
+	{
+		pointPostProcesses.push_back(GetPointPostProcess(stages[i]->Type));
+	}
+	if (kernel == nullptr || std::find(pointPostProcesses.begin(), pointPostProcesses.end(), nullptr) != pointPostProcesses.end())
+	{
+		mLastError = "Post-processes cannot be fused";
+		return false;
+	}
+
+	PostProcessingConstants passConstants = PassConstants(*stages[0], constants);
+	passConstants.area2DTopLeft = { 0, 0 };
+	passConstants.area2DSize    = { 1, 1 };
+	passConstants.area2DDepth   = 0;
+
+	// The point post-processes after the first read their own settings if they have them
+	std::vector<const PostProcessingConstants*> stageConstants;
+	for (int i = 1; i < numStages; ++i)
+	{
+		stageConstants.push_back(stages[i]->Constants != nullptr ? stages[i]->Constants : &passConstants);
+	}
+
+	PostProcessInputs inputs;
+	inputs.scene     = &source;
+	inputs.constants = &passConstants;
+
+	const char* inputError = CheckPostProcessInputs(headType, inputs);
+	if (inputError != nullptr)
+	{
+		mLastError = std::string(PostProcessTypeName(headType)) + ": " + inputError;
+		return false;
+	}
+
+	target.Resize(source.Width(), source.Height());
+
+	// A fast first post-process works on the whole image, the point post-processes are then applied to its result
+	if (UsesFastPass(headType))
+	{
+		ImagePass(headType, inputs, mFastPassTemp);
+		inputs.scene = &mFastPassTemp;
+		kernel = PassThroughKernel;
+	}
+
+	const int width = target.Width();
+	const int height = target.Height();
+	const float invWidth = 1.0f / width;
+	const float invHeight = 1.0f / height;
+
+	mThreads.ParallelFor(height, mTileHeight, [&](int rowBegin, int rowEnd)
+	{
+		PostProcessPixel pixel;
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			pixel.sceneUV.y = (y + 0.5f) * invHeight;
+			for (int x = 0; x < width; ++x)
+			{
+				pixel.sceneUV.x = (x + 0.5f) * invWidth;
+				pixel.areaUV = pixel.sceneUV;
+
+				// Each stage is clamped as if it had been written to a render target and read back by the next
+				ColourRGBA colour = Saturate(kernel(inputs, pixel));
+				for (size_t stage = 0; stage < pointPostProcesses.size(); ++stage)
+				{
+					colour = Saturate(pointPostProcesses[stage](colour, pixel, *stageConstants[stage]));
+				}
+				row[x] = colour;
+			}
+		}
+	});
+
+	auto endTime = std::chrono::steady_clock::now();
+	mTimings.push_back({ headType, PostProcessMode::Fullscreen, source.Width() * source.Height(),
+	                     std::chrono::duration<double>(endTime - startTime).count(), numStages });
+	return true;
+}
+
+
+// Render the blurred bright areas of the source into mBloomTexture (RenderBloomTexture in Scene.cpp)
+bool PostProcessEngine::RenderBloomTexture(const ImageBuffer& source, const PostProcessingConstants& constants)
+{
+	if (mBloomMode == BloomMode::Pyramid)  return RenderBloomPyramid(source, constants);
+
+	PostProcessingConstants bloomConstants = constants;
+	bloomConstants.area2DTopLeft = { 0, 0 };
+	bloomConstants.area2DSize    = { 1, 1 };
+	bloomConstants.area2DDepth   = 0;
+
+	mBloomTexture.Resize(source.Width(), source.Height());
+	mBloomTemp.Resize(source.Width(), source.Height());
+
+	PostProcessInputs inputs;
+	inputs.constants = &bloomConstants;
+
+	// Brightness -> BlurY -> BlurX
+	inputs.scene = &source;
+	FullscreenPass(BrightnessKernel, inputs, mBloomTexture);
+	inputs.scene = &mBloomTexture;
+	ImagePass(PostProcessType::BlurY, inputs, mBloomTemp);
+	inputs.scene = &mBloomTemp;
+	ImagePass(PostProcessType::BlurX, inputs, mBloomTexture);
+
+	// Directional blurs are added to the blurred texture. As on the GPU they read the texture blurred in Y only
+	if (mDiagonalBlurs > 0)
+	{
+		inputs.scene = &mBloomTemp;
+
+		// The base direction was set in UpdateScene from the current bloom timer, recover the angle from it
+		float baseAngle = std::atan2(constants.directionalBlurY, constants.directionalBlurX);
+		for (int j = 0; j < mDiagonalBlurs; ++j)
+		{
+			float angle = baseAngle + static_cast<float>(j) * (PI / mDiagonalBlurs);
+			bloomConstants.directionalBlurX = std::cos(angle);
+			bloomConstants.directionalBlurY = std::sin(angle);
+			FullscreenPass(DirectionalBlurKernel, inputs, mBloomTexture, true);
+		}
+	}
+	return true;
+}
+
+// Render the bloom texture using the downsample pyramid (RenderBloomPyramid in Scene.cpp). The levels are held as
+// 16-bit floats on the GPU so they are not clamped here
+bool PostProcessEngine::RenderBloomPyramid(const ImageBuffer& source, const PostProcessingConstants& constants)
+{
+	PostProcessingConstants bloomConstants = constants;
+	bloomConstants.area2DTopLeft = { 0, 0 };
+	bloomConstants.area2DSize    = { 1, 1 };
+	bloomConstants.area2DDepth   = 0;
+
+	PostProcessInputs inputs;
+	inputs.constants = &bloomConstants;
+
+	// Take the bright areas at half size, then keep halving down to the smallest level
+	for (int level = 0; level < BLOOM_PYRAMID_LEVELS; ++level)
+	{
+		mBloomLevels[level].Resize(BloomLevelSize(source.Width(), level), BloomLevelSize(source.Height(), level));
+		inputs.scene = (level == 0) ? &source : &mBloomLevels[level - 1];
+		PyramidPass(level == 0 ? PostProcessType::BloomPrefilter : PostProcessType::BloomDownsample, inputs, mBloomLevels[level], false, true);
+	}
+
+	// Optional streaks, read from one level and added to the level above it. The final pass scales the sum of the levels
+	// back down, so scale the streaks up to match
+	if (mDiagonalBlurs > 0)
+	{
+		inputs.scene = &mBloomLevels[BLOOM_STREAK_LEVEL];
+		bloomConstants.directionalBlurIntensity *= BLOOM_PYRAMID_LEVELS;
+		float baseAngle = std::atan2(constants.directionalBlurY, constants.directionalBlurX);
+		for (int j = 0; j < mDiagonalBlurs; ++j)
+		{
+			float angle = baseAngle + static_cast<float>(j) * (PI / mDiagonalBlurs);
+			bloomConstants.directionalBlurX = std::cos(angle);
+			bloomConstants.directionalBlurY = std::sin(angle);
+			FullscreenPass(DirectionalBlurKernel, inputs, mBloomLevels[BLOOM_STREAK_LEVEL - 1], true, true);
+		}
+	}
+
+	// Add each level to the one above it, working back up the pyramid
+	bloomConstants.bloomLevelScale = 1.0f;
+	for (int level = BLOOM_PYRAMID_LEVELS - 2; level >= 0; --level)
+	{
+		inputs.scene = &mBloomLevels[level + 1];
+		PyramidPass(PostProcessType::BloomUpsample, inputs, mBloomLevels[level], true, true);
+	}
+
+	// Up to full size, bringing the sum of the levels back to the range of a single level
+	bloomConstants.bloomLevelScale = 1.0f / BLOOM_PYRAMID_LEVELS;
+	mBloomTexture.Resize(source.Width(), source.Height());
+	inputs.scene = &mBloomLevels[0];
+	PyramidPass(PostProcessType::BloomUpsample, inputs, mBloomTexture, false, false);
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Passes
+//--------------------------------------------------------------------------------------
+
+// Whether a post-process will use its fast version
+bool PostProcessEngine::UsesFastPass(PostProcessType type)
+{
+	if (mMethods[static_cast<int>(type)] != ProcessMethod::Fast)  return false;
+	return type == PostProcessType::BlurX || type == PostProcessType::BlurY || type == PostProcessType::Dilation ||
+	       type == PostProcessType::DepthOfField;
+}
+
+// Run a post-process over the whole target, using its fast version if selected
+void PostProcessEngine::ImagePass(PostProcessType type, const PostProcessInputs& inputs, ImageBuffer& target)
+{
+	if (UsesFastPass(type))
+	{
+		if      (type == PostProcessType::BlurX)         FastBlurX(*inputs.scene, target, *inputs.constants, mThreads);
+		else if (type == PostProcessType::BlurY)         FastBlurY(*inputs.scene, target, *inputs.constants, mThreads);
+		else if (type == PostProcessType::Dilation)      FastDilation(*inputs.scene, target, *inputs.constants, mThreads);
+		else if (type == PostProcessType::DepthOfField)  FastDepthOfField(*inputs.scene, *inputs.normalDepth, target, *inputs.constants, mThreads);
+	}
+	else
+	{
+		FullscreenPass(GetPostProcessKernel(type), inputs, target);
+	}
+}
+
+
+// Run a pass of the bloom pyramid into a target that is already sized, using its fast version (FastBloom.h) if selected.
+// Downsample passes always replace the target
+void PostProcessEngine::PyramidPass(PostProcessType type, const PostProcessInputs& inputs, ImageBuffer& target, bool additive, bool unclamped)
+{
+	if (mMethods[static_cast<int>(type)] != ProcessMethod::Fast)
+	{
+		FullscreenPass(GetPostProcessKernel(type), inputs, target, additive, unclamped);
+	}
+	else if (type == PostProcessType::BloomUpsample)
+	{
+		FastBloomUpsample(*inputs.scene, target, additive, !unclamped, *inputs.constants, mThreads);
+	}
+	else
+	{
+		FastBloomDownsample(*inputs.scene, target, type == PostProcessType::BloomPrefilter, *inputs.constants, mThreads);
+	}
+}
+
+
+// Run a kernel over the whole target. Additive passes add to the target as gAdditiveBlendingState does
+void PostProcessEngine::FullscreenPass(PostProcessKernel kernel, const PostProcessInputs& inputs, ImageBuffer& target, bool additive, bool unclamped)
+{
+	const int width = target.Width();
+	const int height = target.Height();
+	const float invWidth = 1.0f / width;
+	const float invHeight = 1.0f / height;
+
+	mThreads.ParallelFor(height, mTileHeight, [&](int rowBegin, int rowEnd)
+	{
+		PostProcessPixel pixel;
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			pixel.sceneUV.y = (y + 0.5f) * invHeight;
+			for (int x = 0; x < width; ++x)
+			{
+				pixel.sceneUV.x = (x + 0.5f) * invWidth;
+				pixel.areaUV = pixel.sceneUV;
+
+				// Values are clamped to 0->1 as they are when written to the R8G8B8A8_UNORM render targets
+				ColourRGBA colour = kernel(inputs, pixel);
+				if (!unclamped)  colour = Saturate(colour);
+				if (additive)
+				{
+					// Additive blend state adds colour but replaces alpha
+					colour = ColourRGBA(row[x].r + colour.r, row[x].g + colour.g, row[x].b + colour.b, colour.a);
+					if (!unclamped)  colour = Saturate(colour);
+				}
+				row[x] = colour;
+			}
+		}
+	});
+}
+
+
+// Run a kernel over the area given in the constants and alpha blend it over a copy of the source (gAlphaBlendingState)
+void PostProcessEngine::AreaPass(PostProcessKernel kernel, const PostProcessInputs& inputs, const ImageBuffer& source, ImageBuffer& target)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const int width = target.Width();
+	const int height = target.Height();
+	const float invWidth = 1.0f / width;
+	const float invHeight = 1.0f / height;
+
+	// Pixels whose centres lie within the area
+	int left   = std::max(0,      static_cast<int>(std::ceil(c.area2DTopLeft.x * width - 0.5f)));
+	int right  = std::min(width,  static_cast<int>(std::ceil((c.area2DTopLeft.x + c.area2DSize.x) * width - 0.5f)));
+	int top    = std::max(0,      static_cast<int>(std::ceil(c.area2DTopLeft.y * height - 0.5f)));
+	int bottom = std::min(height, static_cast<int>(std::ceil((c.area2DTopLeft.y + c.area2DSize.y) * height - 0.5f)));
+
+	mThreads.ParallelFor(height, mTileHeight, [&](int rowBegin, int rowEnd)
+	{
+		PostProcessPixel pixel;
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			std::copy(source.Row(y), source.Row(y) + width, row);
+			if (y < top || y >= bottom)  continue;
+
+			pixel.sceneUV.y = (y + 0.5f) * invHeight;
+			pixel.areaUV.y = (pixel.sceneUV.y - c.area2DTopLeft.y) / c.area2DSize.y;
+			for (int x = left; x < right; ++x)
+			{
+				pixel.sceneUV.x = (x + 0.5f) * invWidth;
+				pixel.areaUV.x = (pixel.sceneUV.x - c.area2DTopLeft.x) / c.area2DSize.x;
+
+				// Alpha blending: colour = source * alpha + destination * (1 - alpha), alpha is replaced
+				ColourRGBA colour = Saturate(kernel(inputs, pixel));
+				float a = colour.a;
+				row[x] = { colour.r * a + row[x].r * (1.0f - a), colour.g * a + row[x].g * (1.0f - a), colour.b * a + row[x].b * (1.0f - a), a };
+			}
+		}
+	});
+}
+
+
+// Run a kernel within the polygon given in the constants, over a copy of the source
+void PostProcessEngine::PolygonPass(PostProcessKernel kernel, const PostProcessInputs& inputs, const ImageBuffer& source, ImageBuffer& target)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const int width = target.Width();
+	const int height = target.Height();
+	const float invWidth = 1.0f / width;
+	const float invHeight = 1.0f / height;
+
+	// Area UVs of the four points, as given in the 2D polygon vertex shader
+	const CVector2 polygonUVs[4] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+
+	// Convert the projected points to pixel coordinates. The GPU clips polygons crossing the camera plane,
+	// that is not supported here so such polygons are skipped
+	CVector2 points[4];
+	float    w[4];
+	bool     visible = true;
+	for (int i = 0; i < 4; ++i)
+	{
+		const CVector4& p = c.polygon2DPoints[i];
+		if (p.w <= EPSILON)  visible = false;
+		w[i] = p.w;
+		points[i] = { (p.x / p.w + 1.0f) * 0.5f * width, (1.0f - p.y / p.w) * 0.5f * height };
+	}
+
+	// Bounding rows of the polygon
+	int top = height, bottom = 0;
+	if (visible)
+	{
+		float minY = std::min(std::min(points[0].y, points[1].y), std::min(points[2].y, points[3].y));
+		float maxY = std::max(std::max(points[0].y, points[1].y), std::max(points[2].y, points[3].y));
+		top    = std::max(0,      static_cast<int>(std::floor(minY)));
+		bottom = std::min(height, static_cast<int>(std::ceil(maxY)));
+	}
+
+	// Four points drawn as a triangle strip
+	const int triangles[2][3] = { { 0, 1, 2 }, { 1, 3, 2 } };
+
+	mThreads.ParallelFor(height, mTileHeight, [&](int rowBegin, int rowEnd)
+	{
+		PostProcessPixel pixel;
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			std::copy(source.Row(y), source.Row(y) + width, row);
+			if (y < top || y >= bottom)  continue;
+
+			pixel.sceneUV.y = (y + 0.5f) * invHeight;
+			for (int x = 0; x < width; ++x)
+			{
+				CVector2 centre = { x + 0.5f, y + 0.5f };
+				for (const auto& t : triangles)
+				{
+					const CVector2& a = points[t[0]];
+					const CVector2& b = points[t[1]];
+					const CVector2& d = points[t[2]];
+
+					// Barycentric coordinates from edge functions, accepting either winding (no culling)
+					float area = (b.x - a.x) * (d.y - a.y) - (b.y - a.y) * (d.x - a.x);
+					if (area == 0.0f)  continue;
+					float l0 = ((b.x - centre.x) * (d.y - centre.y) - (b.y - centre.y) * (d.x - centre.x)) / area;
+					float l1 = ((d.x - centre.x) * (a.y - centre.y) - (d.y - centre.y) * (a.x - centre.x)) / area;
+					float l2 = 1.0f - l0 - l1;
+					if (l0 < 0.0f || l1 < 0.0f || l2 < 0.0f)  continue;
+
+					// Scene UVs are not perspective corrected (noperspective in the shader), area UVs are
+					float p0 = l0 / w[t[0]];
+					float p1 = l1 / w[t[1]];
+					float p2 = l2 / w[t[2]];
+					float invSum = 1.0f / (p0 + p1 + p2);
+					pixel.sceneUV.x = centre.x * invWidth;
+					pixel.areaUV = (polygonUVs[t[0]] * p0 + polygonUVs[t[1]] * p1 + polygonUVs[t[2]] * p2) * invSum;
+
+					row[x] = Saturate(kernel(inputs, pixel));
+					break;
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,179 @@
+//--------------------------------------------------------------------------------------
+// CPU post-processing engine - runs post-process chains on image buffers without a GPU
+//--------------------------------------------------------------------------------------
+// Code in .cpp file. Follows the same steps as RenderScene in Scene.cpp so a chain gives the same result
+// on the CPU as on the GPU. Work is split into tiles of rows that are processed on all cores
+
+#ifndef _POST_PROCESS_ENGINE_H_INCLUDED_
+#define _POST_PROCESS_ENGINE_H_INCLUDED_
+
+#include "PostProcess.h"
+#include "PostProcessingConstants.h"
+#include "PostProcessKernels.h"
+#include "ImageBuffer.h"
+#include "ThreadPool.h"
+#include "CMatrix4x4.h"
+
+#include <vector>
+#include <string>
+
+
+// Additional textures used by specific post-processes, loaded by the caller (Noise.png, Burn.png, Distort.png, Noise2.png)
+struct PostProcessTextures
+{
+	const ImageBuffer* noiseMap   = nullptr;
+	const ImageBuffer* burnMap    = nullptr;
+	const ImageBuffer* distortMap = nullptr;
+	const ImageBuffer* noiseMap2  = nullptr;
+};
+
+// How a post-process is calculated. Some post-processes have a fast version that works on the whole image at once
+// rather than per-pixel: BlurX, BlurY (FastBlur.h), Dilation (FastDilation.h) and DepthOfField (FastDepthOfField.h).
+// The bloom pyramid passes BloomPrefilter, BloomDownsample and BloomUpsample have fast versions in FastBloom.h
+enum class ProcessMethod
+{
+	ShaderPort, // Same samples as the shader
+	Fast,       // Fast version where there is one, otherwise the same as ShaderPort
+};
+
+// Time taken by one post-process in the last Run
+struct PostProcessTiming
+{
+	PostProcessType type;
+	PostProcessMode mode;
+	int             pixels;  // Pixels in the image processed
+	double          seconds;
+	int             stages;  // Post-processes run in the pass, more than 1 for a fused pass (type is the first of them)
+};
+
+
+class PostProcessEngine
+{
+public:
+	// Constructor - pass the number of threads to use, 0 to use all cores
+	PostProcessEngine(unsigned int numThreads = 0);
+
+
+	// Settings
+
+	// Set the additional textures used by GreyNoise, Burn, Distort and FrostedGlass
+	void SetTextures(const PostProcessTextures& textures) { mTextures = textures; }
+
+	// Set the camera view-projection matrix used to place polygon post-processes
+	void SetViewProjectionMatrix(const CMatrix4x4& viewProjection) { mViewProjection = viewProjection; }
+
+	// Set the number of directional blur passes added to the bloom texture (gTempDiagonalBlurs in Scene.cpp)
+	void SetDiagonalBlurs(int diagonalBlurs) { mDiagonalBlurs = diagonalBlurs; }
+
+	// Choose whether Run fuses runs of full screen post-processes into one pass (see PostProcessFusion.h), on by default
+	void SetFusion(bool fusion) { mFusion = fusion; }
+
+	// Choose whether Run holds back the distortion of the maps until a post-process reads them, on by default (as
+	// PostProcessGraph::SetLazyMapDistortion). When off the maps are distorted straight after each distorting post-process
+	void SetLazyMapDistortion(bool lazy) { mLazyMapDistortion = lazy; }
+
+	// Choose how the bloom texture is built (gBloomMode in Scene.cpp), the default is BloomMode::FullResolution
+	void SetBloomMode(BloomMode mode) { mBloomMode = mode; }
+
+	// Choose how a type of post-process is calculated, the default is ProcessMethod::Fast
+	// The BlurX and BlurY settings are also used for the blurs in the bloom texture
+	void SetMethod(PostProcessType type, ProcessMethod method) { mMethods[static_cast<int>(type)] = method; }
+	ProcessMethod Method(PostProcessType type) { return mMethods[static_cast<int>(type)]; }
+
+	// Set the number of rows in each tile of work handed to a thread
+	void SetTileHeight(int rows) { mTileHeight = rows < 1 ? 1 : rows; }
+
+	// Access the thread pool, so other CPU processing can share the same threads
+	ThreadPool& Threads() { return mThreads; }
+
+
+	// Processing
+
+	// Run a chain of post-processes on the scene image, the result is left in the scene image. The normal/depth and focused
+	// object maps are optional. When given, distorting post-processes are also applied to them to keep them lined up with the
+	// scene (as RenderScene does). With lazy map distortion the maps are only distorted as far as the last post-process
+	// that reads them. Without a focused object map, Selection post-processes are skipped. Post-processes with their own
+	// settings (PostProcess::Constants) use those rather than the given ones, apart from the area
+	// Returns false on error, see LastError
+	bool Run(const std::vector<PostProcess*>& postProcesses, const PostProcessingConstants& constants,
+	         ImageBuffer& scene, ImageBuffer* normalDepth = nullptr, ImageBuffer* focus = nullptr);
+
+	// Apply a single post-process from source to target. Target is resized to match the source if necessary
+	// Fullscreen processes write every target pixel, area and polygon processes copy the source and update the affected region
+	// Returns false on error, see LastError
+	bool Apply(const PostProcess& postProcess, const PostProcessingConstants& constants, const ImageBuffer& source, ImageBuffer& target,
+	           const ImageBuffer* normalDepth = nullptr, const ImageBuffer* focus = nullptr);
+
+	// Apply a run of full screen post-processes that can be fused (FusedRunLength in PostProcessFusion.h) from source to
+	// target in one pass. Target is resized to match the source if necessary
+	// Returns false on error, see LastError
+	bool ApplyFused(const PostProcess* const* stages, int numStages, const PostProcessingConstants& constants,
+	                const ImageBuffer& source, ImageBuffer& target);
+
+
+	// Results
+
+	// Time taken by each post-process applied since the last call to Run, in order
+	const std::vector<PostProcessTiming>& Timings() { return mTimings; }
+
+	// Description of the last error
+	const std::string& LastError() { return mLastError; }
+
+
+private:
+	// Render the blurred bright areas of the source into mBloomTexture (RenderBloomTexture in Scene.cpp)
+	bool RenderBloomTexture(const ImageBuffer& source, const PostProcessingConstants& constants);
+
+	// Render the bloom texture using the downsample pyramid (RenderBloomPyramid in Scene.cpp)
+	bool RenderBloomPyramid(const ImageBuffer& source, const PostProcessingConstants& constants);
+
+	// Whether a post-process will use its fast version
+	bool UsesFastPass(PostProcessType type);
+
+	// Apply the distortions waiting for a map to it, switching source and target after each
+	bool ApplyMapDistortions(std::vector<const PostProcess*>& distortions, const PostProcessingConstants& constants,
+	                         ImageBuffer*& source, ImageBuffer*& target);
+
+	// Run a post-process over the whole target, using its fast version if selected
+	void ImagePass(PostProcessType type, const PostProcessInputs& inputs, ImageBuffer& target);
+
+	// Run a pass of the bloom pyramid into a target that is already sized, using its fast version if selected
+	void PyramidPass(PostProcessType type, const PostProcessInputs& inputs, ImageBuffer& target, bool additive, bool unclamped);
+
+	// Run a kernel over the whole target, over an area with alpha blending, or within a polygon. Fullscreen results are
+	// clamped to 0->1 like the 8-bit render targets unless unclamped is set (the 16-bit float bloom pyramid levels)
+	void FullscreenPass(PostProcessKernel kernel, const PostProcessInputs& inputs, ImageBuffer& target, bool additive = false, bool unclamped = false);
+	void AreaPass      (PostProcessKernel kernel, const PostProcessInputs& inputs, const ImageBuffer& source, ImageBuffer& target);
+	void PolygonPass   (PostProcessKernel kernel, const PostProcessInputs& inputs, const ImageBuffer& source, ImageBuffer& target);
+
+	ThreadPool mThreads;
+
+	PostProcessTextures mTextures;
+	CMatrix4x4          mViewProjection;
+	int                 mDiagonalBlurs;
+	bool                mFusion;
+	bool                mLazyMapDistortion;
+	BloomMode           mBloomMode;
+	int                 mTileHeight;
+	ProcessMethod       mMethods[NUM_POST_PROCESS_TYPES];
+
+	// Second image of each ping-pong pair, plus textures used to build the bloom texture and
+	// to hold fast pass results for areas and polygons
+	ImageBuffer mSceneTarget;
+	ImageBuffer mNormalDepthTarget;
+	ImageBuffer mFocusTarget;
+	ImageBuffer mBloomTexture;
+	ImageBuffer mBloomTemp;
+	ImageBuffer mBloomLevels[BLOOM_PYRAMID_LEVELS];
+	ImageBuffer mFastPassTemp;
+
+	std::vector<const PostProcess*> mChain; // Post-processes being run by Run
+	std::vector<const PostProcess*> mNormalDepthDistortions; // Distortions waiting to be applied to each map
+	std::vector<const PostProcess*> mFocusDistortions;
+
+	std::vector<PostProcessTiming> mTimings;
+	std::string                    mLastError;
+};
+
+
+#endif //_POST_PROCESS_ENGINE_H_INCLUDED_
@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------
+// Post-process fusion - runs of full screen post-processes run as a single pass
+//--------------------------------------------------------------------------------------
+
+#include "PostProcessFusion.h"
+#include "PostProcessKernels.h"
+#include "PostProcessConstantBlocks.h"
+
+#include <sstream>
+
+
+// Whether a post-process only changes the colour of each pixel, so can be fused onto the one before it
+bool IsPointPostProcess(PostProcessType type)
+{
+	return GetPointPostProcess(type) != nullptr;
+}
+
+// Whether a post-process can be the head of a fused run - its shader reads nothing but the scene texture
+bool CanStartFusedRun(PostProcessType type)
+{
+	switch (type)
+	{
+	case PostProcessType::Spiral:
+	case PostProcessType::HeatHaze:
+	case PostProcessType::BlurX:
+	case PostProcessType::BlurY:
+	case PostProcessType::Underwater:
+	case PostProcessType::Retro:
+	case PostProcessType::ChromaticAberration:
+	case PostProcessType::Dilation:
+		return true;
+	default:
+		return IsPointPostProcess(type);
+	}
+}
+
+// Number of post-processes from the first of the given ones that can run as one pass
+int FusedRunLength(const PostProcess* const* postProcesses, int count)
+{
+	if (count < 2 || postProcesses[0]->Mode != PostProcessMode::Fullscreen || !CanStartFusedRun(postProcesses[0]->Type))
+	{
+		return 1;
+	}
+
+	// Each stage's settings are bound to its blocks' registers, so a run can't have two stages reading the same block
+	bool blockUsed[NUM_CONSTANT_BLOCKS] = {};
+	for (ConstantBlock block : PostProcessConstantBlocks(postProcesses[0]->Type))  blockUsed[static_cast<int>(block)] = true;
+
+	int length = 1;
+	while (length < count && postProcesses[length]->Mode == PostProcessMode::Fullscreen &&
+	       IsPointPostProcess(postProcesses[length]->Type))
+	{
+		PostProcessBlocks blocks = PostProcessConstantBlocks(postProcesses[length]->Type);
+		bool shared = false;
+		for (ConstantBlock block : blocks)  shared = shared || blockUsed[static_cast<int>(block)];
+		if (shared)  break;
+		for (ConstantBlock block : blocks)  blockUsed[static_cast<int>(block)] = true;
+		++length;
+	}
+	return length;
+}
+
+// HLSL source of a pixel shader that runs a fused run in one pass
+std::string FusedShaderSource(const PostProcess* const* stages, int numStages)
+{
+	std::ostringstream source;
+	source << "// Fused post-process:";
+	for (int i = 0; i < numStages; ++i)  source << " " << PostProcessTypeName(stages[i]->Type);
+	source << "\n\n";
+
+	// The head's shader is included with its main function renamed. It includes Common.hlsli, which has the *Colour
+	// functions for the point post-processes that follow
+	source << "#define main FusedHead\n";
+	source << "#include \"" << PostProcessTypeName(stages[0]->Type) << "_pp.hlsl\"\n";
+	source << "#undef main\n\n";
+
+	source << "float4 main(PostProcessingInput input) : SV_Target\n";
+	source << "{\n";
+	source << "    float4 colour = saturate(FusedHead(input));\n";
+	for (int i = 1; i < numStages; ++i)
+	{
+		source << "    colour = saturate(" << PostProcessTypeName(stages[i]->Type) << "Colour(colour, input));\n";
+	}
+	source << "    return colour;\n";
+	source << "}\n";
+	return source.str();
+}
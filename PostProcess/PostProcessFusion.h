@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// Post-process fusion - runs of full screen post-processes run as a single pass
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Point post-processes (Tint, Gradient, HueShift, Brightness) only change the colour of each pixel, so when one follows
+// another full screen post-process it can be applied to that post-process's result straight away rather than writing
+// the result out and reading it back in. A run is any full screen post-process whose shader only reads the scene
+// texture (the head), followed by one or more full screen point post-processes. Each stage's result is clamped to 0->1
+// as it would be when written to a render target, so fused and separate passes give the same result:
+// - The CPU engine runs the head kernel then each point function (GetPointPostProcess) in one loop over the pixels
+// - The GPU uses a pixel shader generated from the head's _pp.hlsl file and the *Colour functions in Common.hlsli
+//
+// A run never has two post-processes that read the same constant block (e.g. two Tints), as the shader reads each block
+// from a single register (see PostProcessConstantBlocks.h). Area and polygon post-processes are never fused. Only the head can be distorting, so its distortion of the
+// normal/depth and focused object maps is still applied on its own
+
+#ifndef _POST_PROCESS_FUSION_H_INCLUDED_
+#define _POST_PROCESS_FUSION_H_INCLUDED_
+
+#include "PostProcess.h"
+
+#include <string>
+
+
+// Whether a post-process only changes the colour of each pixel, so can be fused onto the one before it
+bool IsPointPostProcess(PostProcessType type);
+
+// Whether a post-process can be the head of a fused run - its shader reads nothing but the scene texture
+bool CanStartFusedRun(PostProcessType type);
+
+// Number of post-processes from the first of the given ones that can run as one pass, 1 if the first can't be fused
+// with those after it. Pass the post-processes still to run and how many there are
+int FusedRunLength(const PostProcess* const* postProcesses, int count);
+
+// HLSL source of a pixel shader that runs a fused run in one pass. It includes the head's _pp.hlsl file, so compile it
+// with an include handler that can find the shader files
+std::string FusedShaderSource(const PostProcess* const* stages, int numStages);
+
+
+#endif //_POST_PROCESS_FUSION_H_INCLUDED_
@@ -0,0 +1,327 @@
+//--------------------------------------------------------------------------------------
+// Post-processing graph - works out which textures each post-process reads and writes and
+// which copies are needed between them
+//--------------------------------------------------------------------------------------
+
+#include "PostProcessGraph.h"
+#include "PostProcessFusion.h"
+
+#include <sstream>
+
+
+// Images a post-process reads when run on the scene (the scene plus any maps it uses)
+unsigned int PostProcessReads(PostProcessType type)
+{
+	unsigned int reads = GraphImageBit(GraphImage::Scene);
+	switch (type)
+	{
+	case PostProcessType::Bloom:
+		reads |= GraphImageBit(GraphImage::Bloom);
+		break;
+	case PostProcessType::DepthOfField:
+	case PostProcessType::Outline:
+		reads |= GraphImageBit(GraphImage::NormalDepth);
+		break;
+	case PostProcessType::Selection:
+		reads |= GraphImageBit(GraphImage::NormalDepth) | GraphImageBit(GraphImage::Focus);
+		break;
+	default:
+		break;
+	}
+	return reads;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Declaring passes
+//--------------------------------------------------------------------------------------
+
+// Remove all passes, ready to declare the next frame
+void PostProcessGraph::Clear()
+{
+	mPasses.clear();
+	mSteps.clear();
+	mStages.clear();
+	for (auto& slot : mFinalSlots)  slot = 0;
+	mUsedImages = 0;
+}
+
+// Declare a pass
+void PostProcessGraph::AddPass(const GraphPass& pass)
+{
+	mPasses.push_back(pass);
+}
+
+// Declare the passes RenderScene uses for a post-process
+void PostProcessGraph::AddPostProcess(const PostProcess* postProcess, bool useFocus)
+{
+	if (postProcess == nullptr || postProcess->Type == PostProcessType::None)  return;
+	if (postProcess->Type == PostProcessType::Selection && !useFocus)  return;
+	if (postProcess->Mode == PostProcessMode::Polygon && postProcess->PolyData == nullptr)  return;
+
+	if (postProcess->Type == PostProcessType::Bloom)
+	{
+		AddPass({ postProcess, GraphImageBit(GraphImage::Scene), GraphImage::Bloom });
+	}
+
+	AddPass({ postProcess, PostProcessReads(postProcess->Type), GraphImage::Scene });
+
+	// Distortions are applied to the maps as well to keep them lined up with the scene
+	if (IsDistortingPostProcess(postProcess->Type))
+	{
+		AddMapDistortions(postProcess, useFocus);
+	}
+}
+
+// Declare the distortion of the maps for a distorting post-process
+void PostProcessGraph::AddMapDistortions(const PostProcess* postProcess, bool useFocus)
+{
+	GraphPass pass = { postProcess, GraphImageBit(GraphImage::NormalDepth), GraphImage::NormalDepth };
+	pass.mapDistortion = true;
+	AddPass(pass);
+	if (useFocus)
+	{
+		pass.reads = GraphImageBit(GraphImage::Focus);
+		pass.write = GraphImage::Focus;
+		AddPass(pass);
+	}
+}
+
+
+// Declare the passes for a list of post-processes, fusing runs of full screen post-processes if fusion is on
+void PostProcessGraph::AddPostProcesses(const std::vector<PostProcess*>& postProcesses, bool useFocus)
+{
+	// Leave out the post-processes AddPostProcess would skip so they don't split up runs
+	mChain.clear();
+	for (const PostProcess* postProcess : postProcesses)
+	{
+		if (postProcess == nullptr || postProcess->Type == PostProcessType::None)  continue;
+		if (postProcess->Type == PostProcessType::Selection && !useFocus)  continue;
+		mChain.push_back(postProcess);
+	}
+
+	int i = 0;
+	while (i < static_cast<int>(mChain.size()))
+	{
+		int numStages = mFusion ? FusedRunLength(&mChain[i], static_cast<int>(mChain.size()) - i) : 1;
+		if (numStages == 1)
+		{
+			AddPostProcess(mChain[i], useFocus);
+			++i;
+			continue;
+		}
+
+		// Fused pass on the scene. Only the head can be distorting, so it alone is applied to the maps
+		const PostProcess* head = mChain[i];
+		GraphPass pass = { head, GraphImageBit(GraphImage::Scene), GraphImage::Scene };
+		pass.firstStage = static_cast<int>(mStages.size());
+		pass.numStages  = numStages;
+		mStages.insert(mStages.end(), mChain.begin() + i, mChain.begin() + i + numStages);
+		AddPass(pass);
+
+		if (IsDistortingPostProcess(head->Type))
+		{
+			AddMapDistortions(head, useFocus);
+		}
+		i += numStages;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Compiling and running
+//--------------------------------------------------------------------------------------
+
+// Work out the slots and copies for the declared passes
+void PostProcessGraph::Compile()
+{
+	mSteps.clear();
+
+	// Map distortions wait until a pass reads or writes their map, then run in order just before it. Those still
+	// waiting at the end are never read so are dropped
+	mOrder.clear();
+	std::vector<const GraphPass*> waiting[NUM_GRAPH_IMAGES];
+	for (const GraphPass& pass : mPasses)
+	{
+		if (pass.mapDistortion && mLazyMapDistortion)
+		{
+			waiting[static_cast<int>(pass.write)].push_back(&pass);
+			continue;
+		}
+		for (int image = 0; image < NUM_GRAPH_IMAGES; ++image)
+		{
+			if ((pass.reads | GraphImageBit(pass.write)) & GraphImageBit(static_cast<GraphImage>(image)))
+			{
+				mOrder.insert(mOrder.end(), waiting[image].begin(), waiting[image].end());
+				waiting[image].clear();
+			}
+		}
+		mOrder.push_back(&pass);
+	}
+
+	int       slots[NUM_GRAPH_IMAGES] = {};
+	SlotState states[NUM_GRAPH_IMAGES][2];
+	for (auto& imageStates : states)  imageStates[1].missingAll = true;
+
+	for (const GraphPass* passPointer : mOrder)
+	{
+		const GraphPass& pass = *passPointer;
+		const int image = static_cast<int>(pass.write);
+
+		// The bloom texture is built with its own temporary textures and replaces the whole of its single slot
+		if (pass.write == GraphImage::Bloom)
+		{
+			GraphStep step = MakeStep(GraphStepType::Pass, pass.postProcess, pass.write, 0, 0, slots);
+			step.reads = pass.reads;
+			mSteps.push_back(step);
+			continue;
+		}
+
+		const int source = slots[image];
+		const int target = 1 - source;
+		SlotState& sourceState = states[image][source];
+		SlotState& targetState = states[image][target];
+
+		// Area and polygon passes leave the rest of the target as it was, so bring the target up to date first
+		const bool fullWrite = (pass.postProcess->Mode == PostProcessMode::Fullscreen);
+		if (!fullWrite)
+		{
+			if (targetState.missingAll || static_cast<int>(targetState.missingRegions.size()) > MAX_REGION_COPIES)
+			{
+				mSteps.push_back(MakeStep(GraphStepType::Copy, nullptr, pass.write, source, target, slots));
+			}
+			else
+			{
+				for (const PostProcess* region : targetState.missingRegions)
+				{
+					mSteps.push_back(MakeStep(GraphStepType::RegionCopy, region, pass.write, source, target, slots));
+				}
+			}
+		}
+
+		GraphStep step = MakeStep(GraphStepType::Pass, pass.postProcess, pass.write, source, target, slots);
+		step.reads = pass.reads;
+		if (pass.numStages > 1)
+		{
+			step.stages    = mStages.data() + pass.firstStage;
+			step.numStages = pass.numStages;
+		}
+		mSteps.push_back(step);
+
+		// The target now holds the current image and the source is missing whatever the pass wrote
+		targetState.missingAll = false;
+		targetState.missingRegions.clear();
+		sourceState.missingAll = fullWrite;
+		sourceState.missingRegions.clear();
+		if (!fullWrite)  sourceState.missingRegions.push_back(pass.postProcess);
+
+		slots[image] = target;
+	}
+
+	for (int image = 0; image < NUM_GRAPH_IMAGES; ++image)  mFinalSlots[image] = slots[image];
+
+	// Last step to use each slot. The scene's final slot is used after the graph, so is left out
+	int lastStep[NUM_GRAPH_IMAGES][2];
+	for (auto& imageSteps : lastStep)  imageSteps[0] = imageSteps[1] = -1;
+	mUsedImages = GraphImageBit(GraphImage::Scene);
+	for (int i = 0; i < static_cast<int>(mSteps.size()); ++i)
+	{
+		const GraphStep& step = mSteps[i];
+		const int image = static_cast<int>(step.image);
+		lastStep[image][step.source] = i;
+		lastStep[image][step.target] = i;
+		mUsedImages |= GraphImageBit(step.image);
+		if (step.type != GraphStepType::Pass)  continue;
+
+		for (int read = 0; read < NUM_GRAPH_IMAGES; ++read)
+		{
+			if (read != image && (step.reads & GraphImageBit(static_cast<GraphImage>(read))))
+			{
+				lastStep[read][step.slots[read]] = i;
+				mUsedImages |= GraphImageBit(static_cast<GraphImage>(read));
+			}
+		}
+	}
+	lastStep[static_cast<int>(GraphImage::Scene)][mFinalSlots[static_cast<int>(GraphImage::Scene)]] = -1;
+
+	for (int image = 0; image < NUM_GRAPH_IMAGES; ++image)
+	{
+		for (int slot = 0; slot < 2; ++slot)
+		{
+			if (lastStep[image][slot] >= 0)  mSteps[lastStep[image][slot]].lastUses |= GraphSlotBit(static_cast<GraphImage>(image), slot);
+		}
+	}
+}
+
+// Pass each step of the compiled graph to the backend in turn
+void PostProcessGraph::Execute(PostProcessGraphBackend& backend)
+{
+	for (const GraphStep& step : mSteps)
+	{
+		if (step.type == GraphStepType::Pass)  backend.RunPass(step);
+		else                                   backend.Copy(step);
+	}
+}
+
+
+GraphStep PostProcessGraph::MakeStep(GraphStepType type, const PostProcess* postProcess, GraphImage image, int source, int target,
+                                     const int* slots)
+{
+	GraphStep step;
+	step.type        = type;
+	step.postProcess = postProcess;
+	step.image       = image;
+	step.source      = source;
+	step.target      = target;
+	for (int i = 0; i < NUM_GRAPH_IMAGES; ++i)  step.slots[i] = slots[i];
+	step.reads       = 0;
+	step.lastUses    = 0;
+	step.stages      = nullptr;
+	step.numStages   = 1;
+	return step;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Recording backend
+//--------------------------------------------------------------------------------------
+
+// Number of steps received of the given type
+int RecordingGraphBackend::Count(GraphStepType type)
+{
+	int count = 0;
+	for (const GraphStep& step : mSteps)
+	{
+		if (step.type == type)  ++count;
+	}
+	return count;
+}
+
+// The steps as text, one line per step
+std::string RecordingGraphBackend::Describe()
+{
+	static const char* imageNames[NUM_GRAPH_IMAGES] = { "Scene", "NormalDepth", "Focus", "Bloom" };
+
+	std::ostringstream text;
+	for (const GraphStep& step : mSteps)
+	{
+		if      (step.type == GraphStepType::Pass)  text << "Pass ";
+		else if (step.type == GraphStepType::Copy)  text << "Copy ";
+		else                                        text << "RegionCopy ";
+
+		if (step.numStages > 1)
+		{
+			for (int i = 0; i < step.numStages; ++i)
+			{
+				text << (i > 0 ? "+" : "") << PostProcessTypeName(step.stages[i]->Type);
+			}
+			text << " " << PostProcessModeName(step.postProcess->Mode) << " ";
+		}
+		else if (step.postProcess != nullptr)
+		{
+			text << PostProcessTypeName(step.postProcess->Type) << " " << PostProcessModeName(step.postProcess->Mode) << " ";
+		}
+		text << imageNames[static_cast<int>(step.image)] << " " << step.source << "->" << step.target << "\n";
+	}
+	return text.str();
+}
@@ -0,0 +1,221 @@
+//--------------------------------------------------------------------------------------
+// Post-processing graph - works out which textures each post-process reads and writes and
+// which copies are needed between them
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each pass declares the images it reads (scene, normal/depth, focused object, bloom) and the image it writes. The scene,
+// normal/depth and focused object images each have two textures (slots) and a pass reads from one and writes to the
+// other. Compile works out the slots from the order of the passes and adds copies:
+// - A full screen pass writes every pixel of its target so it never needs a copy, whatever the target held before
+// - An area or polygon pass only writes part of its target, so the rest of the target must already hold the source. The
+//   graph tracks what each slot is missing compared to the current image. A slot missing a full screen pass gets a full
+//   copy, a slot only missing a few area or polygon passes gets a copy of just those areas or polygons
+//
+// Runs of full screen post-processes can be declared as a single fused pass (see PostProcessFusion.h)
+//
+// Distortions of the normal/depth and focused object maps (GraphPass::mapDistortion) are only there to keep the maps
+// lined up for passes that read them. Compile holds them back until a pass reads the map, runs them in order just
+// before it, and drops any no pass reads. A chain of distortions with nothing reading the maps costs no map passes
+//
+// Compile also works out the last step to use each slot (GraphStep::lastUses), so a backend can take the texture for a
+// slot from a pool just before its first use and hand it back straight after its last (see TransientTexturePool.h)
+//
+// The steps are run by a backend - RenderScene in Scene.cpp uses the GPU, RecordingGraphBackend below just keeps a list
+// of the steps so a chain can be checked without a GPU
+
+#ifndef _POST_PROCESS_GRAPH_H_INCLUDED_
+#define _POST_PROCESS_GRAPH_H_INCLUDED_
+
+#include "PostProcess.h"
+
+#include <vector>
+#include <string>
+
+
+// Images the post-processing chain works on. Slot 0 of Scene, NormalDepth and Focus is the texture rendered into before
+// post-processing, slot 1 is the second texture of each pair. Bloom has a single slot, rebuilt from the scene when needed
+enum class GraphImage
+{
+	Scene,
+	NormalDepth,
+	Focus,
+	Bloom,
+};
+const int NUM_GRAPH_IMAGES = static_cast<int>(GraphImage::Bloom) + 1;
+
+// Bit for an image, combine these for GraphPass::reads
+inline unsigned int GraphImageBit(GraphImage image)
+{
+	return 1u << static_cast<int>(image);
+}
+
+// Bit for a slot of an image, combine these for GraphStep::lastUses
+inline unsigned int GraphSlotBit(GraphImage image, int slot)
+{
+	return 1u << (static_cast<int>(image) * 2 + slot);
+}
+
+// Images a post-process reads when run on the scene (the scene plus any maps it uses)
+unsigned int PostProcessReads(PostProcessType type);
+
+
+// A pass as declared. Writing to GraphImage::Bloom builds the bloom texture from the scene (RenderBloomTexture),
+// otherwise the post-process is run from the current slot of the written image into its other slot
+struct GraphPass
+{
+	const PostProcess* postProcess;     // Type, mode and polygon of the pass, the first stage of a fused pass
+	unsigned int       reads;           // GraphImageBit of each image read
+	GraphImage         write;           // Image written
+	int                firstStage = 0;  // Fused passes only - the stages are held by the graph, see AddPostProcesses
+	int                numStages  = 1;
+	bool               mapDistortion = false; // Distortion of a map to keep it lined up with the scene, only run if read
+};
+
+
+// Kinds of step in a compiled graph
+enum class GraphStepType
+{
+	Pass,       // Run a pass
+	Copy,       // Copy the whole of an image from one slot to the other
+	RegionCopy, // Copy the area or polygon of an earlier pass from one slot to the other
+};
+
+// A step of a compiled graph, passed to the backend
+struct GraphStep
+{
+	GraphStepType      type;
+	const PostProcess* postProcess;             // Pass: post-process to run. RegionCopy: pass whose area or polygon to copy
+	GraphImage         image;                   // Image written or copied
+	int                source;                  // Slot of the image read
+	int                target;                  // Slot of the image written
+	int                slots[NUM_GRAPH_IMAGES]; // Slot to read each of the other images from
+	unsigned int       reads;                   // Pass: GraphImageBit of each image read
+	unsigned int       lastUses;                // GraphSlotBit of each slot no later step uses
+	const PostProcess* const* stages;           // Pass with numStages > 1: the post-processes fused into the pass
+	int                numStages;
+};
+
+
+// Runs the steps of a compiled graph
+class PostProcessGraphBackend
+{
+public:
+	virtual ~PostProcessGraphBackend() {}
+
+	// Run a pass - step.postProcess from slot step.source of step.image to step.target, other images from step.slots.
+	// Fused passes run each of step.stages in turn (see PostProcessFusion.h)
+	virtual void RunPass(const GraphStep& step) = 0;
+
+	// Copy step.image from slot step.source to step.target. For a region copy only within the area or polygon of
+	// step.postProcess
+	virtual void Copy(const GraphStep& step) = 0;
+};
+
+
+class PostProcessGraph
+{
+public:
+	// Most area and polygon passes a slot can be missing before a full copy is used rather than a copy of each
+	static const int MAX_REGION_COPIES = 4;
+
+
+	// Declaring passes
+
+	// Remove all passes, ready to declare the next frame
+	void Clear();
+
+	// Declare a pass. Passes run in the order they are declared. The post-process must stay valid until the graph is cleared
+	void AddPass(const GraphPass& pass);
+
+	// Declare the passes RenderScene uses for a post-process: the bloom texture for Bloom, the post-process on the scene,
+	// then for distorting post-processes (IsDistortingPostProcess) map distortions of the normal/depth map and, if useFocus
+	// is set, the focused object map. Selection is left out without useFocus, and polygons without polygon data
+	void AddPostProcess(const PostProcess* postProcess, bool useFocus);
+
+	// Declare the passes for a list of post-processes as AddPostProcess does. With fusion on, runs of full screen
+	// post-processes that can be fused (FusedRunLength) are declared as one pass on the scene
+	void AddPostProcesses(const std::vector<PostProcess*>& postProcesses, bool useFocus);
+
+	// Choose whether AddPostProcesses fuses runs of post-processes, on by default
+	void SetFusion(bool fusion) { mFusion = fusion; }
+
+	// Choose whether Compile holds back map distortions until a pass reads the map and drops those never read, on by
+	// default. When off every map distortion runs straight after its pass on the scene
+	void SetLazyMapDistortion(bool lazy) { mLazyMapDistortion = lazy; }
+
+
+	// Compiling and running
+
+	// Work out the slots and copies for the declared passes. Slot 0 of each image holds the image at the start, slot 1 is
+	// treated as holding nothing useful
+	void Compile();
+
+	// Steps of the compiled graph, in order
+	const std::vector<GraphStep>& Steps() { return mSteps; }
+
+	// Slot holding each image once the compiled graph has run. The final slot of the scene is never in lastUses, as it
+	// is shown after the graph has run
+	int FinalSlot(GraphImage image) { return mFinalSlots[static_cast<int>(image)]; }
+
+	// GraphImageBit of each image any step of the compiled graph uses. The normal/depth and focused object maps only
+	// need rendering before the graph runs if they are used. The scene is always used
+	unsigned int UsedImages() { return mUsedImages; }
+
+	// Pass each step of the compiled graph to the backend in turn
+	void Execute(PostProcessGraphBackend& backend);
+
+
+private:
+	// What a slot is missing compared to the current image - everything, or just the areas/polygons of some passes
+	struct SlotState
+	{
+		bool                            missingAll = false;
+		std::vector<const PostProcess*> missingRegions;
+	};
+
+	// Declare the distortion of the maps for a distorting post-process
+	void AddMapDistortions(const PostProcess* postProcess, bool useFocus);
+
+	GraphStep MakeStep(GraphStepType type, const PostProcess* postProcess, GraphImage image, int source, int target,
+	                   const int* slots);
+
+	bool                            mFusion = true;
+	bool                            mLazyMapDistortion = true;
+	std::vector<const PostProcess*> mChain;  // Post-processes being declared by AddPostProcesses
+	std::vector<const PostProcess*> mStages; // Stages of the fused passes
+
+	std::vector<GraphPass> mPasses;
+	std::vector<const GraphPass*> mOrder; // Passes in the order they run, after map distortions are moved or dropped
+	std::vector<GraphStep> mSteps;
+	int                    mFinalSlots[NUM_GRAPH_IMAGES] = {};
+	unsigned int           mUsedImages = 0;
+};
+
+
+// Backend that runs nothing but keeps a record of the steps, to check the passes and copies made for a chain
+class RecordingGraphBackend : public PostProcessGraphBackend
+{
+public:
+	void RunPass(const GraphStep& step) override { mSteps.push_back(step); }
+	void Copy   (const GraphStep& step) override { mSteps.push_back(step); }
+
+	// Steps received, in order
+	const std::vector<GraphStep>& Steps() { return mSteps; }
+
+	// Number of steps received of the given type
+	int Count(GraphStepType type);
+
+	// The steps as text, one line per step, e.g. "Pass Tint Polygon Scene 0->1". Fused passes list each stage, e.g.
+	// "Pass Retro+Tint+HueShift Fullscreen Scene 1->0"
+	std::string Describe();
+
+	// Forget the steps received
+	void Clear() { mSteps.clear(); }
+
+private:
+	std::vector<GraphStep> mSteps;
+};
+
+
+#endif //_POST_PROCESS_GRAPH_H_INCLUDED_
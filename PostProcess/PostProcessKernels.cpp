@@ -0,0 +1,675 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the post-processing pixel shaders (*_pp.hlsl)
+//--------------------------------------------------------------------------------------
+// Each function follows its shader line by line - see the .hlsl files for more detailed comments
+
+#include "PostProcessKernels.h"
+#include "ShaderFunctions.h"
+#include "MathHelpers.h"
+
+#include <cmath>
+#include <vector>
+
+
+// Offsets around the centre of a pixel that are checked for neighbouring edges in Outline and Selection
+static const CVector2 NeighbourOffsets[8] =
+{
+	{ -1, -1 }, { -1, 0 }, { -1, 1 },
+	{  0, -1 },            {  0, 1 },
+	{  1, -1 }, {  1, 0 }, {  1, 1 },
+};
+
+
+//--------------------------------------------------------------------------------------
+// Simple colour effects
+//--------------------------------------------------------------------------------------
+
+ColourRGBA CopyKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	ColourRGBA colour = inputs.scene->SamplePoint(pixel.sceneUV);
+
+	// Lower alpha can be set to create a motion blur effect
+	if (inputs.constants->copyAlpha < 1.0f - SHADER_EPSILON)
+	{
+		colour.a = inputs.constants->copyAlpha;
+	}
+	return colour;
+}
+
+ColourRGBA TintKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return TintColour(inputs.scene->SamplePoint(pixel.sceneUV), pixel, *inputs.constants);
+}
+
+ColourRGBA GreyNoiseKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const float NoiseStrength = 0.5f;
+
+	ColourRGBA sceneColour = inputs.scene->SamplePoint(pixel.sceneUV);
+	float grey = (sceneColour.r + sceneColour.g + sceneColour.b) / 3.0f;
+
+	CVector2 noiseUV = { pixel.sceneUV.x * c.noiseScale.x + c.noiseOffset.x, pixel.sceneUV.y * c.noiseScale.y + c.noiseOffset.y };
+	grey += NoiseStrength * (inputs.noiseMap->SampleBilinearWrap(noiseUV).r - 0.5f);
+
+	return { grey, grey, grey, GetAreaAlpha(pixel.areaUV) };
+}
+
+ColourRGBA BurnKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const CVector3 burnColour = { 0.8f, 0.4f, 0.0f };
+	const CVector3 glowColour = { 1.0f, 0.8f, 0.0f };
+	const float glowAmount = 0.25f;
+	const float crinkle = 0.15f;
+
+	ColourRGBA burnTexture = inputs.burnMap->SampleBilinearWrap(pixel.areaUV);
+	float burnLevelMax = c.burnHeight + glowAmount;
+
+	CVector3 outputColour;
+	if (burnTexture.r <= c.burnHeight)
+	{
+		outputColour = { 0.0f, 0.0f, 0.0f };
+	}
+	else if (burnTexture.r >= burnLevelMax)
+	{
+		outputColour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV));
+	}
+	else
+	{
+		float glowLevel = 1.0f - (burnTexture.r - c.burnHeight) / glowAmount;
+		CVector2 crinkleVector = { burnTexture.g - 0.5f, burnTexture.b - 0.5f };
+		CVector3 texColour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV - glowLevel * crinkle * crinkleVector));
+
+		glowLevel *= 2.0f;
+		if (glowLevel < 1.0f)
+		{
+			outputColour = LerpUnclamped(texColour, Multiply(burnColour, texColour), glowLevel);
+		}
+		else
+		{
+			outputColour = LerpUnclamped(Multiply(burnColour, texColour), glowColour, glowLevel - 1.0f);
+		}
+	}
+	return ToRGBA(outputColour, GetAreaAlpha(pixel.areaUV));
+}
+
+ColourRGBA DistortKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const float lightStrength = 0.015f;
+	const float glassDarken = 0.8f;
+
+	ColourRGBA distortTexture = inputs.distortMap->SampleBilinearWrap(pixel.areaUV);
+	CVector2 distortVector = { distortTexture.g - 0.5f, distortTexture.b - 0.5f };
+
+	float light = Dot(Normalise(distortVector), CVector2(0.707f, 0.707f)) * lightStrength;
+
+	ColourRGBA sceneColour = inputs.scene->SamplePoint(pixel.sceneUV + inputs.constants->distortLevel * distortVector) * glassDarken;
+	return sceneColour + ColourRGBA(light, light, light, light);
+}
+
+ColourRGBA GradientKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return GradientColour(inputs.scene->SamplePoint(pixel.sceneUV), pixel, *inputs.constants);
+}
+
+ColourRGBA HueShiftKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return HueShiftColour(inputs.scene->SamplePoint(pixel.sceneUV), pixel, *inputs.constants);
+}
+
+ColourRGBA BrightnessKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return BrightnessColour(inputs.scene->SamplePoint(pixel.sceneUV), pixel, *inputs.constants);
+}
+
+ColourRGBA BloomKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	CVector3 bloom = ToRGB(inputs.bloom->SamplePoint(pixel.areaUV)) * inputs.constants->bloomIntensity;
+	CVector3 colour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV)) + bloom;
+	return ToRGBA(colour, GetAreaAlpha(pixel.areaUV));
+}
+
+ColourRGBA ChromaticAberrationKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const CVector3& offset = inputs.constants->colourOffset;
+	float r = inputs.scene->SamplePoint({ pixel.sceneUV.x + offset.x, pixel.sceneUV.y }).r;
+	float g = inputs.scene->SamplePoint({ pixel.sceneUV.x + offset.y, pixel.sceneUV.y }).g;
+	float b = inputs.scene->SamplePoint({ pixel.sceneUV.x + offset.z, pixel.sceneUV.y }).b;
+	return { r, g, b, 1.0f };
+}
+
+
+//--------------------------------------------------------------------------------------
+// Point post-processes
+//--------------------------------------------------------------------------------------
+
+ColourRGBA TintColour(const ColourRGBA& colour, const PostProcessPixel& /*pixel*/, const PostProcessingConstants& constants)
+{
+	return ToRGBA(Multiply(ToRGB(colour), constants.tintColour), 1.0f);
+}
+
+ColourRGBA GradientColour(const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants)
+{
+	float hue = LerpUnclamped(constants.gradientHue.x, constants.gradientHue.y, pixel.sceneUV.y);
+
+	CVector3 hsl = RGBtoHSL(ToRGB(colour));
+	hsl.x = hue;
+	hsl.y = Clamp(hsl.y + 0.2f, 0.0f, 1.0f);
+
+	return ToRGBA(HSLtoRGB(hsl), GetAreaAlpha(pixel.areaUV));
+}
+
+ColourRGBA HueShiftColour(const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants)
+{
+	CVector3 hsl = RGBtoHSL(ToRGB(colour));
+
+	// The shader subtracts 1 until the hue is back in range. The shift keeps growing while the app
+	// runs so do the same thing in one step
+	hsl.x += constants.hueShift;
+	if (hsl.x > 1.0f)
+	{
+		hsl.x -= std::ceil(hsl.x - 1.0f);
+	}
+
+	return ToRGBA(HSLtoRGB(hsl), GetAreaAlpha(pixel.areaUV));
+}
+
+ColourRGBA BrightnessColour(const ColourRGBA& colour, const PostProcessPixel& /*pixel*/, const PostProcessingConstants& constants)
+{
+	if (RGBToBrightness(ToRGB(colour)) > constants.bloomThreshold)
+	{
+		return ToRGBA(ToRGB(colour), 1.0f);
+	}
+	return { 0.0f, 0.0f, 0.0f, 0.0f };
+}
+
+
+//--------------------------------------------------------------------------------------
+// Distortion effects
+//--------------------------------------------------------------------------------------
+
+ColourRGBA SpiralKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+
+	const CVector2 centreUV = c.area2DTopLeft + c.area2DSize * 0.5f;
+	CVector2 centreOffsetUV = pixel.sceneUV - centreUV;
+	float centreDistance = std::sqrt(Dot(centreOffsetUV, centreOffsetUV));
+
+	float angle = centreDistance * c.spiralLevel * c.spiralLevel;
+	float s = std::sin(angle);
+	float co = std::cos(angle);
+
+	// Row vector multiplied by the 2x2 matrix { c, s, -s, c } as in the shader
+	CVector2 rotatedOffsetUV = { centreOffsetUV.x * co - centreOffsetUV.y * s, centreOffsetUV.x * s + centreOffsetUV.y * co };
+
+	return inputs.scene->SamplePoint(centreUV + rotatedOffsetUV);
+}
+
+ColourRGBA HeatHazeKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const float effectStrength = 0.01f;
+	const float softEdge = 0.15f;
+
+	CVector2 centreVector = pixel.areaUV - CVector2(0.5f, 0.5f);
+	float centreLengthSq = Dot(centreVector, centreVector);
+	float alpha = 1.0f - Saturate((centreLengthSq - 0.25f + softEdge) / softEdge);
+
+	float sinX = std::sin(pixel.areaUV.x * ToRadians(1440.0f) + c.heatHazeTimer * 3.0f);
+	float sinY = std::sin(pixel.areaUV.y * ToRadians(3600.0f) + c.heatHazeTimer * 3.7f);
+
+	CVector2 hazeOffset = { sinY * effectStrength * alpha * c.area2DSize.x, sinX * effectStrength * alpha * c.area2DSize.y };
+
+	CVector3 colour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV + hazeOffset));
+	alpha *= Saturate(sinX * sinY * 0.33f + 0.66f);
+	return ToRGBA(colour, alpha);
+}
+
+ColourRGBA UnderwaterKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const float effectStrength = c.wobbleStrength;
+
+	float sinX = std::sin(pixel.sceneUV.x * 35.0f + c.wobbleTimer * 1.0f);
+	float sinY = std::sin(pixel.sceneUV.y * 20.0f + c.wobbleTimer * 0.8f);
+	CVector2 offset = CVector2(sinY, sinX) * effectStrength;
+
+	ColourRGBA sampledColour = inputs.scene->SamplePoint(pixel.sceneUV + offset);
+
+	float hue = c.underwaterHue;
+	float brightness = LerpUnclamped(c.underwaterBrightness.x, c.underwaterBrightness.y, pixel.sceneUV.y);
+
+	CVector3 colour = RGBtoHSL(ToRGB(sampledColour));
+	colour.x = hue;
+	colour.z = Clamp(colour.z * brightness, 0.0f, 1.0f);
+	colour.y = Clamp(colour.y + 0.4f, 0.0f, 1.0f);
+	colour = HSLtoRGB(colour);
+
+	return ToRGBA(colour, sampledColour.a);
+}
+
+ColourRGBA RetroKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+
+	CVector2 uv = { std::floor(pixel.sceneUV.x * c.pixelNumber.x) / c.pixelNumber.x, std::floor(pixel.sceneUV.y * c.pixelNumber.y) / c.pixelNumber.y };
+	ColourRGBA sampledColour = inputs.scene->SamplePoint(uv);
+	CVector3 colour = RGBtoHSL(ToRGB(sampledColour));
+
+	// Limit brightness levels
+	colour.z = Clamp(std::ceil(colour.z * c.pixelBrightnessLevels) / c.pixelBrightnessLevels, 0.0f, 1.0f);
+
+	// Minimum saturation and limited saturation levels
+	if (colour.y < c.pixelSaturationMin)
+	{
+		if (colour.y < SHADER_EPSILON)
+		{
+			colour.x = 0.6f;
+		}
+		colour.y = c.pixelSaturationMin;
+	}
+	colour.y = Clamp(c.pixelSaturationMin + std::ceil(colour.y * c.pixelSaturationLevels) / c.pixelSaturationLevels * c.pixelSaturationMin / 1.0f, 0.0f, 1.0f);
+
+	// Limit hue
+	float range = c.pixelHueRange.y - c.pixelHueRange.x;
+	colour.x = c.pixelHueRange.x + std::ceil(colour.x * c.pixelHueLevels) / c.pixelHueLevels * (range / 1.0f) + colour.z * c.pixelBrightnessHueShift;
+	while (colour.x > 1.0f)
+	{
+		colour.x -= 1.0f;
+	}
+	while (colour.x < 0.0f)
+	{
+		colour.x += 1.0f;
+	}
+
+	colour = HSLtoRGB(colour);
+	return ToRGBA(colour, sampledColour.a);
+}
+
+ColourRGBA FrostedGlassKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	CVector2 ox = { c.frostedGlassoffsetSize.x, 0.0f };
+	CVector2 oy = { 0.0f, c.frostedGlassoffsetSize.y };
+
+	ColourRGBA colours[9];
+	CVector2 pp = pixel.sceneUV - oy;
+	colours[0] = inputs.scene->SamplePoint(pp - ox);
+	colours[1] = inputs.scene->SamplePoint(pp);
+	colours[2] = inputs.scene->SamplePoint(pp + ox);
+	pp = pixel.sceneUV;
+	colours[3] = inputs.scene->SamplePoint(pp - ox);
+	colours[4] = inputs.scene->SamplePoint(pp);
+	colours[5] = inputs.scene->SamplePoint(pp + ox);
+	pp = pixel.sceneUV + oy;
+	colours[6] = inputs.scene->SamplePoint(pp - ox);
+	colours[7] = inputs.scene->SamplePoint(pp);
+	colours[8] = inputs.scene->SamplePoint(pp + ox);
+
+	float n = inputs.noiseMap2->SampleBilinearWrap(c.frostedGlassFrequency * pixel.areaUV).r;
+	n = std::fmod(n, 0.111111f) / 0.111111f;
+
+	return Spline(n, colours);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Blurs
+//--------------------------------------------------------------------------------------
+
+ColourRGBA BlurXKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const int SAMPLES = 150;
+	const PostProcessingConstants& c = *inputs.constants;
+
+	ColourRGBA colour = { 0, 0, 0, 0 };
+	float sum = 0;
+	for (int i = 0; i < SAMPLES; ++i)
+	{
+		float offset = (static_cast<float>(i) / (SAMPLES - 1) - 0.5f) * c.blurSize.x;
+		float gauss = Gauss(offset, c.standardDeviationSquared);
+		sum += gauss;
+		colour += inputs.scene->SamplePoint({ pixel.sceneUV.x + offset, pixel.sceneUV.y }) * gauss;
+	}
+	return colour / sum;
+}
+
+ColourRGBA BlurYKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const int SAMPLES = 150;
+	const PostProcessingConstants& c = *inputs.constants;
+
+	ColourRGBA colour = { 0, 0, 0, 0 };
+	float sum = 0;
+	for (int i = 0; i < SAMPLES; ++i)
+	{
+		float offset = (static_cast<float>(i) / (SAMPLES - 1) - 0.5f) * c.blurSize.y;
+		float gauss = Gauss(offset, c.standardDeviationSquared);
+		sum += gauss;
+		colour += inputs.scene->SamplePoint({ pixel.sceneUV.x, pixel.sceneUV.y + offset }) * gauss;
+	}
+	return colour / sum;
+}
+
+ColourRGBA DirectionalBlurKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const int SAMPLES = 40;
+	const PostProcessingConstants& c = *inputs.constants;
+
+	CVector3 colour = { 0, 0, 0 };
+	float sum = 0;
+	for (int i = 0; i < SAMPLES; ++i)
+	{
+		float offsetLength = (static_cast<float>(i) / (SAMPLES - 1) - 0.5f) * c.directionalBlurSize;
+		CVector2 uv = { pixel.sceneUV.x + c.directionalBlurX * offsetLength, pixel.sceneUV.y + c.directionalBlurY * offsetLength };
+		if (uv.x < 0 || uv.x > 1 || uv.y < 0 || uv.y > 1)
+		{
+			continue;
+		}
+
+		float gauss = Gauss(offsetLength, c.standardDeviationSquared);
+		sum += gauss;
+		colour += ToRGB(inputs.scene->SamplePoint(uv)) * gauss;
+	}
+	colour = (colour / sum) * c.directionalBlurIntensity;
+	return ToRGBA(colour, 1.0f);
+}
+
+
+// Bloom pyramid filters from Common.hlsli, reading the texture with bilinear filtering and clamp addressing
+
+static CVector3 BloomThreshold(const CVector3& colour, const PostProcessingConstants& c)
+{
+	return RGBToBrightness(colour) > c.bloomThreshold ? colour : CVector3{ 0, 0, 0 };
+}
+
+static CVector3 BloomDownsample13(const ImageBuffer& source, const CVector2& uv, bool threshold, const PostProcessingConstants& constants)
+{
+	const CVector2 texel = { 1.0f / source.Width(), 1.0f / source.Height() };
+	auto sample = [&](float x, float y)
+	{
+		CVector3 colour = ToRGB(source.SampleBilinearClamp({ uv.x + texel.x * x, uv.y + texel.y * y }));
+		return threshold ? BloomThreshold(colour, constants) : colour;
+	};
+
+	CVector3 a = sample(-2, -2), b = sample(0, -2), c = sample(2, -2);
+	CVector3 d = sample(-1, -1), e = sample(1, -1);
+	CVector3 f = sample(-2,  0), g = sample(0,  0), h = sample(2,  0);
+	CVector3 i = sample(-1,  1), j = sample(1,  1);
+	CVector3 k = sample(-2,  2), l = sample(0,  2), m = sample(2,  2);
+	return (d + e + i + j) * 0.125f + g * 0.125f + (b + f + h + l) * 0.0625f + (a + c + k + m) * 0.03125f;
+}
+
+static CVector3 BloomUpsampleTent(const ImageBuffer& source, const CVector2& uv)
+{
+	const CVector2 texel = { 1.0f / source.Width(), 1.0f / source.Height() };
+	auto sample = [&](float x, float y) { return ToRGB(source.SampleBilinearClamp({ uv.x + texel.x * x, uv.y + texel.y * y })); };
+
+	CVector3 colour = sample(0, 0) * 4.0f;
+	colour += (sample(0, -1) + sample(-1, 0) + sample(1, 0) + sample(0, 1)) * 2.0f;
+	colour +=  sample(-1, -1) + sample(1, -1) + sample(-1, 1) + sample(1, 1);
+	return colour / 16.0f;
+}
+
+ColourRGBA BloomPrefilterKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return ToRGBA(BloomDownsample13(*inputs.scene, pixel.sceneUV, true, *inputs.constants), 1.0f);
+}
+
+ColourRGBA BloomDownsampleKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return ToRGBA(BloomDownsample13(*inputs.scene, pixel.sceneUV, false, *inputs.constants), 1.0f);
+}
+
+ColourRGBA BloomUpsampleKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	return ToRGBA(BloomUpsampleTent(*inputs.scene, pixel.sceneUV) * inputs.constants->bloomLevelScale, 1.0f);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Effects using the normal/depth and focus maps
+//--------------------------------------------------------------------------------------
+
+// The shader lists 525 offsets - every point on a grid of 1/14 horizontally and 1/12 vertically that
+// lies within the unit circle, ordered by x then y
+static std::vector<CVector2> BuildDepthOfFieldOffsets()
+{
+	std::vector<CVector2> offsets;
+	for (int x = -14; x <= 14; ++x)
+	{
+		for (int y = -12; y <= 12; ++y)
+		{
+			float fx = x / 14.0f;
+			float fy = y / 12.0f;
+			if (fx * fx + fy * fy <= 1.0f + 1e-5f)
+			{
+				offsets.push_back({ fx, fy });
+			}
+		}
+	}
+	return offsets;
+}
+
+// The sample offsets used by DepthOfField_pp, built once
+const std::vector<CVector2>& DepthOfFieldOffsets()
+{
+	static const std::vector<CVector2> offsets = BuildDepthOfFieldOffsets();
+	return offsets;
+}
+
+// One of the depth of field offsets in whole pixels, rounded to the nearest
+PixelOffset DepthOfFieldPixelOffset(const CVector2& unitOffset, const CVector2& dilationSize, int width, int height)
+{
+	PixelOffset offset;
+	offset.x = static_cast<int>(std::floor(0.5f + unitOffset.x * dilationSize.x * width));
+	offset.y = static_cast<int>(std::floor(0.5f + unitOffset.y * dilationSize.y * height));
+	return offset;
+}
+
+ColourRGBA DepthOfFieldKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+
+	CVector3 focusColour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV));
+	CVector3 finalColour = focusColour;
+	float depth = inputs.normalDepth->SamplePoint(pixel.sceneUV).a;
+	float dilation = DilationForDepth(depth, c);
+	float brightness = RGBToBrightness(finalColour);
+
+	// Offsets rounded to whole pixels, where the shader's land on the pixel containing the offset position. The two only
+	// differ for offsets exactly between two pixels, which the GPU can round either way too
+	for (const CVector2& unitOffset : DepthOfFieldOffsets())
+	{
+		PixelOffset offset = DepthOfFieldPixelOffset(unitOffset, c.dilationSize, inputs.scene->Width(), inputs.scene->Height());
+		CVector3 sampledColour = ToRGB(inputs.scene->SamplePointOffset(pixel.sceneUV, offset.x, offset.y));
+
+		float sampleBrightness = RGBToBrightness(sampledColour);
+		float sampleDepth = inputs.normalDepth->SamplePointOffset(pixel.sceneUV, offset.x, offset.y).a;
+		float sampleDilation = DilationForDepth(sampleDepth, c);
+		if (sampleBrightness > brightness && sampleDilation > 0.01f && depth + 0.005f > sampleDepth && sampleDilation + 0.5f > dilation)
+		{
+			finalColour = sampledColour;
+			brightness = sampleBrightness;
+			dilation = sampleDilation;
+			depth = sampleDepth;
+		}
+	}
+
+	finalColour = LerpUnclamped(focusColour, finalColour, SmoothStep(c.dilationThreshold.x, c.dilationThreshold.y, dilation * brightness));
+	return ToRGBA(finalColour, dilation);
+}
+
+ColourRGBA OutlineKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	const float depthWeight = 12.0f;
+
+	CVector3 colour = ToRGB(inputs.scene->SamplePoint(pixel.sceneUV));
+	ColourRGBA normalDepthValue = inputs.normalDepth->SamplePoint(pixel.sceneUV);
+	normalDepthValue.a *= depthWeight;
+
+	ColourRGBA sampledValue = { 0, 0, 0, 0 };
+	for (int i = 0; i < 8; ++i)
+	{
+		sampledValue += inputs.normalDepth->SamplePoint(pixel.sceneUV + NeighbourOffsets[i] * c.outlineThickness);
+	}
+	sampledValue.a *= depthWeight;
+	sampledValue = sampledValue / 8;
+
+	ColourRGBA difference = normalDepthValue - sampledValue;
+	float edgeValue = std::sqrt(difference.r * difference.r + difference.g * difference.g + difference.b * difference.b + difference.a * difference.a);
+	if (edgeValue >= c.outlineThreshold)
+	{
+		colour *= 0.1f;
+	}
+	return ToRGBA(colour, 1.0f);
+}
+
+ColourRGBA DilationKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const int SAMPLES = 13;
+	const PostProcessingConstants& c = *inputs.constants;
+
+	ColourRGBA originalColour = inputs.scene->SamplePoint(pixel.sceneUV);
+	ColourRGBA colour = originalColour;
+	float brightness = RGBToBrightness(colour);
+
+	for (int i = -SAMPLES; i <= SAMPLES; ++i)
+	{
+		for (int j = -SAMPLES; j <= SAMPLES; ++j)
+		{
+			// Ignore this position if it's not within the desired shape
+			if ((c.dilationType >= 2.0f && (std::abs(i) > SAMPLES - std::abs(j))) ||                // Diamond shape
+			    (c.dilationType >= 1.0f && (std::sqrt(static_cast<float>(i * i + j * j)) > SAMPLES))) // Circle shape
+			{
+				continue;
+			}
+
+			CVector2 offset = { (static_cast<float>(i) / SAMPLES) * c.dilationSize.x, (static_cast<float>(j) / SAMPLES) * c.dilationSize.y };
+			ColourRGBA sampledColour = inputs.scene->SamplePoint(pixel.sceneUV + offset);
+
+			float sampleBrightness = RGBToBrightness(sampledColour);
+			if (sampleBrightness > brightness)
+			{
+				colour = sampledColour;
+				brightness = sampleBrightness;
+			}
+		}
+	}
+
+	return LerpUnclamped(originalColour, colour, SmoothStep(c.dilationThreshold.x, c.dilationThreshold.y, brightness));
+}
+
+ColourRGBA SelectionKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+
+	ColourRGBA colour = inputs.scene->SamplePoint(pixel.sceneUV);
+	if (inputs.focus->SamplePoint(pixel.sceneUV).a > SHADER_EPSILON)
+	{
+		return colour;
+	}
+
+	float depth = inputs.normalDepth->SamplePoint(pixel.sceneUV).a;
+	for (int i = 0; i < 8; ++i)
+	{
+		float sampledValue = inputs.focus->SamplePoint(pixel.sceneUV + NeighbourOffsets[i] * c.outlineThickness).a;
+		if (sampledValue > SHADER_EPSILON && sampledValue < depth)
+		{
+			return { 1.0f, 1.0f, 1.0f, 1.0f };
+		}
+	}
+	return colour;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Kernel selection
+//--------------------------------------------------------------------------------------
+
+// Return the kernel for a post-process type, or nullptr for PostProcessType::None
+PostProcessKernel GetPostProcessKernel(PostProcessType type)
+{
+	switch (type)
+	{
+	case PostProcessType::Copy:                return CopyKernel;
+	case PostProcessType::Tint:                return TintKernel;
+	case PostProcessType::GreyNoise:           return GreyNoiseKernel;
+	case PostProcessType::Burn:                return BurnKernel;
+	case PostProcessType::Distort:             return DistortKernel;
+	case PostProcessType::Spiral:              return SpiralKernel;
+	case PostProcessType::HeatHaze:            return HeatHazeKernel;
+	case PostProcessType::Gradient:            return GradientKernel;
+	case PostProcessType::BlurX:               return BlurXKernel;
+	case PostProcessType::BlurY:               return BlurYKernel;
+	case PostProcessType::Underwater:          return UnderwaterKernel;
+	case PostProcessType::DepthOfField:        return DepthOfFieldKernel;
+	case PostProcessType::Retro:               return RetroKernel;
+	case PostProcessType::Bloom:               return BloomKernel;
+	case PostProcessType::Brightness:          return BrightnessKernel;
+	case PostProcessType::DirectionalBlur:     return DirectionalBlurKernel;
+	case PostProcessType::BloomPrefilter:      return BloomPrefilterKernel;
+	case PostProcessType::BloomDownsample:     return BloomDownsampleKernel;
+	case PostProcessType::BloomUpsample:       return BloomUpsampleKernel;
+	case PostProcessType::HueShift:            return HueShiftKernel;
+	case PostProcessType::ChromaticAberration: return ChromaticAberrationKernel;
+	case PostProcessType::Outline:             return OutlineKernel;
+	case PostProcessType::Dilation:            return DilationKernel;
+	case PostProcessType::FrostedGlass:        return FrostedGlassKernel;
+	case PostProcessType::Selection:           return SelectionKernel;
+	default:                                   return nullptr;
+	}
+}
+
+// Return the point version of a post-process type, or nullptr if it is not a point post-process
+PointPostProcess GetPointPostProcess(PostProcessType type)
+{
+	switch (type)
+	{
+	case PostProcessType::Tint:       return TintColour;
+	case PostProcessType::Gradient:   return GradientColour;
+	case PostProcessType::HueShift:   return HueShiftColour;
+	case PostProcessType::Brightness: return BrightnessColour;
+	default:                          return nullptr;
+	}
+}
+
+// Check the inputs a post-process needs are present. Returns an error message, or nullptr if everything is available
+const char* CheckPostProcessInputs(PostProcessType type, const PostProcessInputs& inputs)
+{
+	if (inputs.scene == nullptr || inputs.scene->Empty())  return "No source image";
+	if (inputs.constants == nullptr)                        return "No post-processing constants";
+
+	switch (type)
+	{
+	case PostProcessType::GreyNoise:
+		if (inputs.noiseMap == nullptr || inputs.noiseMap->Empty())  return "GreyNoise requires the noise map";
+		break;
+	case PostProcessType::Burn:
+		if (inputs.burnMap == nullptr || inputs.burnMap->Empty())  return "Burn requires the burn map";
+		break;
+	case PostProcessType::Distort:
+		if (inputs.distortMap == nullptr || inputs.distortMap->Empty())  return "Distort requires the distort map";
+		break;
+	case PostProcessType::FrostedGlass:
+		if (inputs.noiseMap2 == nullptr || inputs.noiseMap2->Empty())  return "FrostedGlass requires the second noise map";
+		break;
+	case PostProcessType::Bloom:
+		if (inputs.bloom == nullptr || inputs.bloom->Empty())  return "Bloom requires a bloom texture";
+		break;
+	case PostProcessType::DepthOfField:
+	case PostProcessType::Outline:
+		if (inputs.normalDepth == nullptr || inputs.normalDepth->Empty())  return "Effect requires the normal/depth map";
+		break;
+	case PostProcessType::Selection:
+		if (inputs.normalDepth == nullptr || inputs.normalDepth->Empty())  return "Selection requires the normal/depth map";
+		if (inputs.focus == nullptr || inputs.focus->Empty())              return "Selection requires the focused object map";
+		break;
+	default:
+		break;
+	}
+	return nullptr;
+}
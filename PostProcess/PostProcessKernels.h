@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the post-processing pixel shaders (*_pp.hlsl)
+//--------------------------------------------------------------------------------------
+// Code in .cpp file. Each kernel is a direct port of its shader and returns the colour
+// the shader would output for one pixel. They are the reference the faster CPU paths are checked against
+
+#ifndef _POST_PROCESS_KERNELS_H_INCLUDED_
+#define _POST_PROCESS_KERNELS_H_INCLUDED_
+
+#include "PostProcess.h"
+#include "PostProcessingConstants.h"
+#include "ImageBuffer.h"
+#include "ColourRGBA.h"
+#include "CVector2.h"
+
+#include <vector>
+
+
+// The textures and settings a post-process shader has access to. Pointers are null when not available
+struct PostProcessInputs
+{
+	const ImageBuffer* scene       = nullptr; // Texture being processed (t0)
+	const ImageBuffer* normalDepth = nullptr; // Normals in rgb, depth in alpha - DepthOfField, Outline, Selection
+	const ImageBuffer* focus       = nullptr; // Focused object normals and depth - Selection
+	const ImageBuffer* bloom       = nullptr; // Blurred bright areas - Bloom
+
+	const ImageBuffer* noiseMap    = nullptr; // Noise.png  - GreyNoise
+	const ImageBuffer* burnMap     = nullptr; // Burn.png   - Burn
+	const ImageBuffer* distortMap  = nullptr; // Distort.png - Distort
+	const ImageBuffer* noiseMap2   = nullptr; // Noise2.png - FrostedGlass
+
+	const PostProcessingConstants* constants = nullptr;
+};
+
+// Data a post-process pixel shader receives from the vertex shader, see PostProcessingInput in Common.hlsli
+struct PostProcessPixel
+{
+	CVector2 sceneUV; // Position in the scene texture
+	CVector2 areaUV;  // Position within the area being processed, 0->1
+};
+
+
+// Function type of a CPU post-process kernel
+typedef ColourRGBA (*PostProcessKernel)(const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+
+// Return the kernel for a post-process type, or nullptr for PostProcessType::None
+PostProcessKernel GetPostProcessKernel(PostProcessType type);
+
+// Check the inputs a post-process needs are present. Returns an error message, or nullptr if everything is available
+const char* CheckPostProcessInputs(PostProcessType type, const PostProcessInputs& inputs);
+
+// Function type of a point post-process - one whose result at a pixel only depends on the scene colour at that pixel.
+// Takes the scene colour and returns the post-processed colour, as the *Colour functions in Common.hlsli
+typedef ColourRGBA (*PointPostProcess)(const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants);
+
+// Return the point version of a post-process type, or nullptr if it is not a point post-process
+PointPostProcess GetPointPostProcess(PostProcessType type);
+
+// The sample offsets used by DepthOfField_pp, within the unit circle and in the shader's order. Scaled by dilationSize
+const std::vector<CVector2>& DepthOfFieldOffsets();
+
+// One of DepthOfFieldOffsets scaled by dilationSize and rounded to whole pixels for an image of the given size. The
+// shader port and FastDepthOfField both take their samples from this, so they land on the same pixels however the
+// compiler orders the sums
+struct PixelOffset
+{
+	int x, y;
+};
+PixelOffset DepthOfFieldPixelOffset(const CVector2& unitOffset, const CVector2& dilationSize, int width, int height);
+
+
+//--------------------------------------------------------------------------------------
+// Kernels
+//--------------------------------------------------------------------------------------
+
+ColourRGBA CopyKernel               (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA TintKernel               (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA GreyNoiseKernel          (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BurnKernel               (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA DistortKernel            (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA SpiralKernel             (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA HeatHazeKernel           (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA GradientKernel           (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BlurXKernel              (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BlurYKernel              (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA UnderwaterKernel         (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA DepthOfFieldKernel       (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA RetroKernel              (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BloomKernel              (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BrightnessKernel         (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA DirectionalBlurKernel    (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BloomPrefilterKernel     (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BloomDownsampleKernel    (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA BloomUpsampleKernel      (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA HueShiftKernel           (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA ChromaticAberrationKernel(const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA OutlineKernel            (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA DilationKernel           (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA FrostedGlassKernel       (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+ColourRGBA SelectionKernel          (const PostProcessInputs& inputs, const PostProcessPixel& pixel);
+
+ColourRGBA TintColour      (const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants);
+ColourRGBA GradientColour  (const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants);
+ColourRGBA HueShiftColour  (const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants);
+ColourRGBA BrightnessColour(const ColourRGBA& colour, const PostProcessPixel& pixel, const PostProcessingConstants& constants);
+
+
+#endif //_POST_PROCESS_KERNELS_H_INCLUDED_
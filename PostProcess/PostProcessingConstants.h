@@ -0,0 +1,122 @@
+//--------------------------------------------------------------------------------------
+// Settings shared by the post-processes, both the GPU shaders and the CPU engine
+//--------------------------------------------------------------------------------------
+// Kept apart from Common.h so code that runs without a DirectX device can use it
+
+#ifndef _POST_PROCESSING_CONSTANTS_H_INCLUDED_
+#define _POST_PROCESSING_CONSTANTS_H_INCLUDED_
+
+#include "CVector2.h"
+#include "CVector3.h"
+#include "CVector4.h"
+
+
+// Settings used by post-processes. The CPU engine reads them directly, the shaders receive them split into an area block
+// and a block for each effect (see PostProcessConstantBlocks.h), so this layout need not match the shaders
+struct PostProcessingConstants
+{
+	CVector2 area2DTopLeft; // Top-left of post-process area on screen, provided as coordinate from 0.0->1.0 not as a pixel coordinate
+	CVector2 area2DSize;    // Size of post-process area on screen, provided as sizes from 0.0->1.0 (1 = full screen) not as a size in pixels
+	float    area2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
+	CVector3 paddingA;      // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
+
+	CVector4 polygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+
+	// Tint post-process settings
+	CVector3 tintColour;
+	
+    // Copy post-process setting (alpha setting for motion blur)
+    float    copyAlpha;
+
+	// Grey noise post-process settings
+    CVector2 noiseScale;
+	CVector2 noiseOffset;
+
+	// Burn post-process settings
+	float    burnHeight;
+	CVector3 paddingC;
+
+	// Distort post-process settings
+	float    distortLevel;
+	CVector3 paddingD;
+
+	// Spiral post-process settings
+	float    spiralLevel;
+	CVector3 paddingE;
+
+	// Heat haze post-process settings
+	float    heatHazeTimer;
+	CVector3 paddingF;
+
+    // Gradient and hue shift post-process settings
+    CVector2 gradientHue;
+    float    hueShift;
+    float    paddingG;
+
+    // Blur post-process settings
+    CVector2 blurSize;
+    float    standardDeviationSquared;
+    float    paddingH;
+
+    // Underwater post-process settings
+    float    underwaterHue;
+    CVector2 underwaterBrightness;
+
+    float    wobbleStrength;
+    float    wobbleTimer;
+    float    paddingI;
+
+    // Retro post-process settings
+    CVector2 pixelNumber;
+    float    pixelBrightnessHueShift;
+
+    float    pixelBrightnessLevels;
+    float    pixelSaturationMin;
+    float    pixelSaturationLevels;
+
+    CVector2 pixelHueRange;
+    float    pixelHueLevels;
+
+    // Bloom post-process settings
+    float    bloomThreshold;
+    float    bloomIntensity;
+    float    bloomLevelScale; // Scale applied by BloomUpsample, used to bring the sum of the pyramid levels back to the range of one level
+
+    // Directional blur post-process settings
+    float    directionalBlurSize;
+    float    directionalBlurX;
+    float    directionalBlurY;
+
+    float    directionalBlurIntensity;
+    CVector2 paggingK;
+
+    // Chromatic aberration post-process settings
+    CVector3 colourOffset;
+
+    // Outline post-process settings
+    float    outlineThreshold;
+    float    outlineThickness;
+    float    paddingL;
+
+    // Dilation post-process settings
+    CVector2 dilationSize;
+    float    dilationType;
+
+    CVector2 dilationThreshold;
+    float    paddingM;
+
+    // Depth of field post-process settings
+    float    focalPlane;
+    float    nearPlane;
+    float    farPlane;
+
+    float    focusedObject;
+    CVector2 paddingN;
+
+    // Frosted glass post-process settings
+    float    frostedGlassFrequency;
+    CVector2 frostedGlassoffsetSize;
+};
+
+
+#endif //_POST_PROCESSING_CONSTANTS_H_INCLUDED_
@@ -0,0 +1,122 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the functions shared by the post-processing shaders (Common.hlsli)
+//--------------------------------------------------------------------------------------
+
+#include "ShaderFunctions.h"
+#include "MathHelpers.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Common post-processing functions
+//--------------------------------------------------------------------------------------
+
+// Alpha to display an area effect in a softened circle, uv is the area UV
+float GetAreaAlpha(const CVector2& uv)
+{
+	const float softEdge = 0.20f; // Softness of the edge of the circle - range 0.001 (hard edge) to 0.25 (very soft)
+	CVector2 centreVector = uv - CVector2(0.5f, 0.5f);
+	float centreLengthSq = Dot(centreVector, centreVector);
+	return 1.0f - Saturate((centreLengthSq - 0.25f + softEdge) / softEdge); // Circle of radius 0.5 as area UVs go from 0->1
+}
+
+// Gaussian weight for a blur sample at the given offset
+float Gauss(float x, float standardDeviationSquared)
+{
+	if (standardDeviationSquared < SHADER_EPSILON)
+	{
+		return 1.0f;
+	}
+	return (1.0f / std::sqrt(2.0f * PI * standardDeviationSquared)) * std::pow(SHADER_EPSILON, -(x * x) / (2.0f * standardDeviationSquared));
+}
+
+// Amount of depth of field blur for a depth value
+float DilationForDepth(float depth, const PostProcessingConstants& constants)
+{
+	float f = 0.0f;
+
+	if (depth < constants.focalPlane)
+	{
+		f = -(depth - constants.focalPlane) / (constants.focalPlane - constants.nearPlane);
+	}
+	else
+	{
+		f = (depth - constants.focalPlane) / (constants.farPlane - constants.focalPlane);
+		f = Clamp(f, 0.0f, 1.0f);
+	}
+
+	return f;
+}
+
+// Blend between nine colours, x in the range 0->1 moves from the first to the last
+ColourRGBA Spline(float x, const ColourRGBA colours[9])
+{
+	// The shader finds which pair of colours x lies between and blends linearly between them
+	float tmp = x * 8.0f;
+	int   first;
+	if      (tmp <= 1.0f)  first = 0;
+	else if (tmp <= 2.0f)  first = 1;
+	else if (tmp <= 3.0f)  first = 2;
+	else if (tmp <= 4.0f)  first = 3;
+	else if (tmp <= 5.0f)  first = 4;
+	else if (tmp <= 6.0f)  first = 5;
+	else if (tmp <= 7.0f)  first = 6;
+	else                   first = 7;
+
+	float t = tmp - first;
+	if (first == 7)  t = Saturate(t);
+
+	return colours[first] * (1.0f - t) + colours[first + 1] * t;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Colour conversion functions
+//--------------------------------------------------------------------------------------
+
+CVector3 HUEtoRGB(float h)
+{
+	float r = std::abs(h * 6 - 3) - 1;
+	float g = 2 - std::abs(h * 6 - 2);
+	float b = 2 - std::abs(h * 6 - 4);
+	return Saturate(CVector3(r, g, b));
+}
+
+CVector3 RGBtoHCV(const CVector3& rgb)
+{
+	// P and Q are float4 in the shader - (x, y, z, w) here
+	float px, py, pz, pw;
+	if (rgb.y < rgb.z) { px = rgb.z;  py = rgb.y;  pz = -1.0f;  pw = 2.0f / 3.0f; }
+	else               { px = rgb.y;  py = rgb.z;  pz = 0.0f;   pw = -1.0f / 3.0f; }
+
+	float qx, qy, qz, qw;
+	if (rgb.x < px) { qx = px;     qy = py;  qz = pw;  qw = rgb.x; }
+	else            { qx = rgb.x;  qy = py;  qz = pz;  qw = px; }
+
+	float c = qx - std::min(qw, qy);
+	float h = std::abs((qw - qy) / (6 * c + SHADER_EPSILON) + qz);
+	return { h, c, qx };
+}
+
+CVector3 HSVtoRGB(const CVector3& hsv)
+{
+	CVector3 rgb = HUEtoRGB(hsv.x);
+	return ((rgb - CVector3(1, 1, 1)) * hsv.y + CVector3(1, 1, 1)) * hsv.z;
+}
+
+CVector3 RGBtoHSL(const CVector3& rgb)
+{
+	CVector3 hcv = RGBtoHCV(rgb);
+	float z = hcv.z - hcv.y * 0.5f;
+	float s = Clamp(hcv.y / (1.0f - std::abs(z * 2.0f - 1.0f) + SHADER_EPSILON), 0.0f, 1.0f);
+	return { hcv.x, s, z };
+}
+
+CVector3 HSLtoRGB(const CVector3& hsl)
+{
+	CVector3 rgb = HUEtoRGB(hsl.x);
+	float c = (1.0f - std::abs(2.0f * hsl.z - 1.0f)) * hsl.y;
+	return (rgb - CVector3(0.5f, 0.5f, 0.5f)) * c + CVector3(hsl.z, hsl.z, hsl.z);
+}
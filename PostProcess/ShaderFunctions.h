@@ -0,0 +1,119 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the functions shared by the post-processing shaders (Common.hlsli)
+//--------------------------------------------------------------------------------------
+// Code in .cpp file. These follow the shader code line by line so CPU results match the GPU
+
+#ifndef _SHADER_FUNCTIONS_H_INCLUDED_
+#define _SHADER_FUNCTIONS_H_INCLUDED_
+
+#include "PostProcessingConstants.h"
+#include "ColourRGBA.h"
+#include "CVector2.h"
+#include "CVector3.h"
+
+
+// EPSILON in Common.hlsli - smaller than the C++ EPSILON in MathHelpers.h
+const float SHADER_EPSILON = 1e-10f;
+
+
+//--------------------------------------------------------------------------------------
+// HLSL intrinsics
+//--------------------------------------------------------------------------------------
+
+// Clamp to 0->1. Not-a-number goes to 0 as it does on the GPU
+inline float Saturate(float x)
+{
+	return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+}
+
+inline CVector3 Saturate(const CVector3& v)
+{
+	return { Saturate(v.x), Saturate(v.y), Saturate(v.z) };
+}
+
+inline ColourRGBA Saturate(const ColourRGBA& c)
+{
+	return { Saturate(c.r), Saturate(c.g), Saturate(c.b), Saturate(c.a) };
+}
+
+// HLSL smoothstep
+inline float SmoothStep(float min, float max, float x)
+{
+	float t = Saturate((x - min) / (max - min));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+// HLSL lerp - unlike Lerp in MathHelpers.h the blend amount is not clamped
+inline float LerpUnclamped(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+inline CVector3 LerpUnclamped(const CVector3& a, const CVector3& b, float t)
+{
+	return a + (b - a) * t;
+}
+
+inline ColourRGBA LerpUnclamped(const ColourRGBA& a, const ColourRGBA& b, float t)
+{
+	return a + (b - a) * t;
+}
+
+// Component-wise multiply of two float3 values
+inline CVector3 Multiply(const CVector3& a, const CVector3& b)
+{
+	return { a.x * b.x, a.y * b.y, a.z * b.z };
+}
+
+// Conversions between colours and float3
+inline CVector3 ToRGB(const ColourRGBA& c)
+{
+	return { c.r, c.g, c.b };
+}
+
+inline ColourRGBA ToRGBA(const CVector3& rgb, float a)
+{
+	return { rgb.x, rgb.y, rgb.z, a };
+}
+
+
+//--------------------------------------------------------------------------------------
+// Common post-processing functions
+//--------------------------------------------------------------------------------------
+
+// Alpha to display an area effect in a softened circle, uv is the area UV
+float GetAreaAlpha(const CVector2& uv);
+
+// Gaussian weight for a blur sample at the given offset
+float Gauss(float x, float standardDeviationSquared);
+
+// Amount of depth of field blur for a depth value
+float DilationForDepth(float depth, const PostProcessingConstants& constants);
+
+// Blend between nine colours, x in the range 0->1 moves from the first to the last
+ColourRGBA Spline(float x, const ColourRGBA colours[9]);
+
+
+//--------------------------------------------------------------------------------------
+// Colour conversion functions
+//--------------------------------------------------------------------------------------
+// Source: https://www.chilliant.com/rgb2hsv.html
+
+CVector3 HUEtoRGB(float h);
+CVector3 RGBtoHCV(const CVector3& rgb);
+CVector3 HSVtoRGB(const CVector3& hsv);
+CVector3 RGBtoHSL(const CVector3& rgb);
+CVector3 HSLtoRGB(const CVector3& hsl);
+
+inline float RGBToBrightness(const CVector3& rgb)
+{
+	return rgb.x * 0.2126f + rgb.y * 0.7152f + rgb.z * 0.0722f;
+}
+
+inline float RGBToBrightness(const ColourRGBA& colour)
+{
+	return colour.r * 0.2126f + colour.g * 0.7152f + colour.b * 0.0722f;
+}
+
+
+#endif //_SHADER_FUNCTIONS_H_INCLUDED_
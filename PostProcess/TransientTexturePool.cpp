@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// Transient texture pool - hands out post-processing textures for the span of the passes
+// that use them
+//--------------------------------------------------------------------------------------
+
+#include "TransientTexturePool.h"
+
+#include <algorithm>
+
+
+// Bytes of each pixel of a format
+int TextureFormatBytes(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::RGBA8:       return 4;
+	case TextureFormat::RGBA16Float: return 8;
+	case TextureFormat::R8:          return 1;
+	case TextureFormat::R16Float:    return 2;
+	case TextureFormat::R32Float:    return 4;
+	}
+	return 4;
+}
+
+// Bytes of a texture with the given description
+size_t TextureBytes(const TextureDesc& desc)
+{
+	return static_cast<size_t>(desc.width) * desc.height * TextureFormatBytes(desc.format);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+TransientTexturePool::TransientTexturePool(TransientTextureBackend* backend)
+	: mBackend(backend)
+{
+}
+
+TransientTexturePool::~TransientTexturePool()
+{
+	DestroyAll();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Acquiring and releasing
+//--------------------------------------------------------------------------------------
+
+// Get a texture with the given description that is not in use, creating one if there isn't one
+int TransientTexturePool::Acquire(const TextureDesc& desc)
+{
+	// Use a free texture of the same description, otherwise create one at the first unused index
+	int texture = -1;
+	int freeIndex = -1;
+	for (int i = 0; i < static_cast<int>(mTextures.size()); ++i)
+	{
+		const PoolTexture& poolTexture = mTextures[i];
+		if (poolTexture.created && !poolTexture.inUse && poolTexture.desc == desc)
+		{
+			texture = i;
+			break;
+		}
+		if (!poolTexture.created && freeIndex < 0)  freeIndex = i;
+	}
+
+	const size_t bytes = TextureBytes(desc);
+	if (texture < 0)
+	{
+		if (freeIndex < 0)
+		{
+			freeIndex = static_cast<int>(mTextures.size());
+			mTextures.push_back({ desc, false, false, 0 });
+		}
+		if (!mBackend->CreateTexture(freeIndex, desc))  return -1;
+
+		texture = freeIndex;
+		mTextures[texture].desc = desc;
+		mTextures[texture].created = true;
+		mStats.heldBytes += bytes;
+		mStats.peakHeldBytes = std::max(mStats.peakHeldBytes, mStats.heldBytes);
+		mFramePeakHeldBytes = std::max(mFramePeakHeldBytes, mStats.heldBytes);
+		++mStats.numTextures;
+		++mStats.numCreated;
+	}
+
+	mTextures[texture].inUse = true;
+	mTextures[texture].lastUsedFrame = mFrame;
+	mInUseBytes += bytes;
+	mFrameAcquiredBytes += bytes;
+	mStats.peakInUseBytes = std::max(mStats.peakInUseBytes, mInUseBytes);
+	return texture;
+}
+
+// Hand a texture back to the pool once its last use is done
+void TransientTexturePool::Release(int texture)
+{
+	if (texture < 0 || texture >= static_cast<int>(mTextures.size()) || !mTextures[texture].inUse)  return;
+
+	mTextures[texture].inUse = false;
+	mTextures[texture].lastUsedFrame = mFrame;
+	mInUseBytes -= TextureBytes(mTextures[texture].desc);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Frames and memory
+//--------------------------------------------------------------------------------------
+
+// Call at the end of each frame, after all textures are released
+void TransientTexturePool::EndFrame()
+{
+	for (int i = 0; i < static_cast<int>(mTextures.size()); ++i)
+	{
+		PoolTexture& poolTexture = mTextures[i];
+		if (poolTexture.created && !poolTexture.inUse && mFrame - poolTexture.lastUsedFrame >= mMaxUnusedFrames)
+		{
+			mBackend->DestroyTexture(i);
+			poolTexture.created = false;
+			mStats.heldBytes -= TextureBytes(poolTexture.desc);
+			--mStats.numTextures;
+		}
+	}
+
+	++mStats.numFrames;
+	mTotalFrameBytes += static_cast<double>(mFramePeakHeldBytes);
+	mStats.averageHeldBytes = mTotalFrameBytes / mStats.numFrames;
+	mStats.unsharedBytes = mFrameAcquiredBytes;
+
+	mFramePeakHeldBytes = mStats.heldBytes;
+	mFrameAcquiredBytes = 0;
+	++mFrame;
+}
+
+// Restart the peak and average counts from the memory held now
+void TransientTexturePool::ResetStats()
+{
+	mStats.peakHeldBytes = mStats.heldBytes;
+	mStats.averageHeldBytes = 0;
+	mStats.peakInUseBytes = mInUseBytes;
+	mStats.numCreated = 0;
+	mStats.numFrames = 0;
+	mTotalFrameBytes = 0;
+	mFramePeakHeldBytes = mStats.heldBytes;
+}
+
+// Destroy every texture
+void TransientTexturePool::DestroyAll()
+{
+	for (int i = 0; i < static_cast<int>(mTextures.size()); ++i)
+	{
+		if (mTextures[i].created)  mBackend->DestroyTexture(i);
+	}
+	mTextures.clear();
+	mInUseBytes = 0;
+	mStats.heldBytes = 0;
+	mStats.numTextures = 0;
+	mFramePeakHeldBytes = 0;
+}
@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// Transient texture pool - hands out post-processing textures for the span of the passes
+// that use them
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// A texture is acquired by its description (width, height and format) just before its first use and released straight
+// after its last. A released texture goes back to the pool and is handed out to the next acquire with the same
+// description, so textures whose uses don't overlap share the same memory. Textures are only created when no free one
+// matches, and are destroyed once they have gone unused for a number of frames, so textures for effects that are not
+// in the chain don't stay resident.
+//
+// Direct3D 11 can't place two textures in the same memory, so only textures with the same description are shared.
+// Reduced size and single channel textures are pooled separately from full size RGBA ones.
+//
+// The textures themselves are made by a backend - Scene.cpp creates GPU textures, CountingTextureBackend below creates
+// nothing so the memory a chain needs can be worked out at any size without a GPU
+
+#ifndef _TRANSIENT_TEXTURE_POOL_H_INCLUDED_
+#define _TRANSIENT_TEXTURE_POOL_H_INCLUDED_
+
+#include <vector>
+#include <cstddef>
+
+
+// Texture formats the pool can hand out
+enum class TextureFormat
+{
+	RGBA8,       // 8-bit unsigned normalised RGBA, the scene and map textures
+	RGBA16Float, // 16-bit float RGBA, the bloom pyramid levels
+	R8,          // 8-bit unsigned normalised single channel
+	R16Float,    // 16-bit float single channel
+	R32Float,    // 32-bit float single channel
+};
+
+// Bytes of each pixel of a format
+int TextureFormatBytes(TextureFormat format);
+
+
+// Description of a texture - textures are only shared with others of the same description
+struct TextureDesc
+{
+	int           width;
+	int           height;
+	TextureFormat format;
+};
+
+inline bool operator==(const TextureDesc& a, const TextureDesc& b)
+{
+	return a.width == b.width && a.height == b.height && a.format == b.format;
+}
+
+// Bytes of a texture with the given description, not counting any padding the driver adds
+size_t TextureBytes(const TextureDesc& desc);
+
+
+// Creates and destroys the textures of a pool. Textures are identified by their index in the pool, and an index is
+// only reused once the texture that had it is destroyed
+class TransientTextureBackend
+{
+public:
+	virtual ~TransientTextureBackend() {}
+
+	// Create the texture with the given index, returns true on success
+	virtual bool CreateTexture(int texture, const TextureDesc& desc) = 0;
+
+	// Destroy the texture with the given index
+	virtual void DestroyTexture(int texture) = 0;
+};
+
+
+// Memory used by a pool. Bytes held is all the textures the pool has created, in use or not
+struct TransientPoolStats
+{
+	size_t heldBytes        = 0; // Bytes held now
+	size_t peakHeldBytes    = 0; // Most bytes held at once
+	double averageHeldBytes = 0; // Average over the frames of the most bytes held during each frame
+	size_t peakInUseBytes   = 0; // Most bytes of textures acquired at once, the least the pool could hold
+	size_t unsharedBytes    = 0; // Bytes of every acquire in the last frame, what a texture for each use would need
+	int    numTextures      = 0; // Textures held now
+	int    numCreated       = 0; // Textures created
+	int    numFrames        = 0; // Frames counted
+};
+
+
+class TransientTexturePool
+{
+public:
+	// Frames a texture can go unused before it is destroyed, by default
+	static const int DEFAULT_MAX_UNUSED_FRAMES = 60;
+
+	// The backend must stay valid for the life of the pool
+	TransientTexturePool(TransientTextureBackend* backend);
+	~TransientTexturePool();
+
+
+	// Acquiring and releasing
+
+	// Get a texture with the given description that is not in use, creating one if there isn't one. Returns the index
+	// of the texture, or -1 if a texture could not be created
+	int Acquire(const TextureDesc& desc);
+
+	// Hand a texture back to the pool once its last use is done. Its content is undefined when next acquired
+	void Release(int texture);
+
+	// Description of a texture
+	const TextureDesc& Desc(int texture) { return mTextures[texture].desc; }
+
+
+	// Frames and memory
+
+	// Call at the end of each frame, after all textures are released. Destroys textures that have gone unused for the
+	// maximum number of frames and updates the stats
+	void EndFrame();
+
+	// Frames a texture can go unused before it is destroyed, at least 1
+	void SetMaxUnusedFrames(int frames) { mMaxUnusedFrames = (frames < 1 ? 1 : frames); }
+
+	// Memory used by the pool
+	const TransientPoolStats& Stats() { return mStats; }
+
+	// Restart the peak and average counts from the memory held now
+	void ResetStats();
+
+	// Destroy every texture, e.g. before the device is released. No texture can be in use
+	void DestroyAll();
+
+
+private:
+	struct PoolTexture
+	{
+		TextureDesc desc;
+		bool        created;
+		bool        inUse;
+		int         lastUsedFrame;
+	};
+
+	TransientTextureBackend* mBackend;
+	std::vector<PoolTexture> mTextures;
+	int                      mMaxUnusedFrames = DEFAULT_MAX_UNUSED_FRAMES;
+	int                      mFrame = 0;
+
+	size_t             mInUseBytes = 0;
+	size_t             mFramePeakHeldBytes = 0; // Most bytes held during this frame
+	size_t             mFrameAcquiredBytes = 0; // Bytes of each acquire this frame
+	double             mTotalFrameBytes = 0;    // Sum of the most bytes held in each frame, for the average
+	TransientPoolStats mStats;
+};
+
+
+// Backend that creates nothing, to count the memory a chain needs without a GPU
+class CountingTextureBackend : public TransientTextureBackend
+{
+public:
+	bool CreateTexture(int, const TextureDesc&) override { return true; }
+	void DestroyTexture(int) override {}
+};
+
+
+#endif //_TRANSIENT_TEXTURE_POOL_H_INCLUDED_
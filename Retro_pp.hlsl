@@ -16,6 +16,26 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 										  // post-processing so this sampler will use "point sampling" - no filtering
 
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match RetroBlock in PostProcessConstantBlocks.cpp
+cbuffer RetroConstants : register(b2)
+{
+	float2 gPixelNumber;
+	float  gPixelBrightnessHueShift;
+	float  gPixelBrightnessLevels;
+
+	float  gPixelSaturationMin;
+	float  gPixelSaturationLevels;
+	float2 gPixelHueRange;
+
+	float  gPixelHueLevels;
+	float3 paddingRetro;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
@@ -11,10 +11,27 @@
 #include "Shader.h"
 #include "Input.h"
 #include "Common.h"
+#include "PostProcess.h"
+#include "PostProcessGraph.h"
+#include "PostProcessFusion.h"
+#include "TransientTexturePool.h"
+#include "PostProcessConstantBlocks.h"
+#include "RenderStateFilter.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "ThreadPool.h"
+#include "MeshData.h"
+#include "MeshFile.h"
+#include "AssetLoader.h"
+#include "CookedTexture.h"
+#include "Profiler.h"
+#include "FrameStatistics.h"
 
 #include "CVector2.h" 
 #include "CVector3.h" 
 #include "CMatrix4x4.h"
+#include "TransformBatch.h"
+#include "FrustumCulling.h"
 #include "MathHelpers.h"     // Helper functions for maths
 #include "GraphicsHelpers.h" // Helper functions to unclutter the code here
 #include "ColourRGBA.h" 
@@ -22,83 +39,23 @@
 #include <array>
 #include <sstream>
 #include <memory>
+#include <map>
+#include <algorithm>
+#include <cstring>
 
 //--------------------------------------------------------------------------------------
 // Scene Data
 //--------------------------------------------------------------------------------------
 
 //********************
-// Available post-processes
-enum class PostProcessType
-{
-	None,
-	Copy,
-	Tint,
-	GreyNoise,
-	Burn,
-	Distort,
-	Spiral,
-	HeatHaze,
-	Gradient,
-	BlurX,
-	BlurY,
-	Underwater,
-	DepthOfField,
-	Retro,
-	Bloom,
-	Brightness,
-	DirectionalBlur,
-	HueShift,
-	ChromaticAberration,
-	Outline,
-	Dilation,
-	FrostedGlass,
-	Selection,
-};
-
-enum class PostProcessMode
-{
-	Fullscreen,
-	Area,
-	Polygon,
-};
-
-class PolygonData
-{
-public:
-	std::array<CVector3, 4> Points;
-	CMatrix4x4 Matrix;
-
-	PolygonData(std::array<CVector3, 4> points, CMatrix4x4 matrix)
-	{
-		Points = points;
-		Matrix = matrix;
-	}
-};
-
-class PostProcess
-{
-public:
-	PostProcessType Type;
-	PostProcessMode Mode;
-	PolygonData* PolyData;
-
-	PostProcess(PostProcessType type, PostProcessMode mode = PostProcessMode::Fullscreen, PolygonData* polyData = nullptr)
-	{
-		Type = type;
-		Mode = mode;
-		PolyData = polyData;
-	}
-
-	~PostProcess()
-	{
-		if (PolyData) delete PolyData;
-	}
-};
-
+// Post-processes to apply each frame, polygon effects first (see PostProcess.h for the available post-processes)
 std::vector<PostProcess*> gFullScreenPostProcesses;
 std::vector<PostProcess*> gPolygonPostProcesses;
 
+// Works out the textures and copies for the post-processes each frame (see PostProcessGraph.h)
+PostProcessGraph gPostProcessGraph;
+bool gFusePostProcesses = true; // Run runs of full screen colour effects as one pass (see PostProcessFusion.h), F9 to switch
+
 //********************
 
 
@@ -109,6 +66,9 @@ const float MOVEMENT_SPEED = 50.0f; // Units per second for movement (what a uni
 // Lock FPS to monitor refresh rate, which will typically set it to 60fps. Press 'p' to toggle to full fps
 bool lockFPS = true;
 
+// Percentiles and pacing problems of every frame's time, kept apart for locked and unlocked FPS (see FrameStatistics.h)
+FrameStatistics gFrameStatistics;
+
 
 // Meshes, models and cameras, same meaning as TL-Engine. Meshes prepared in InitGeometry function, Models & camera in InitScene
 Mesh* gStarsMesh;
@@ -163,6 +123,52 @@ struct Light
 Light gLights[NUM_LIGHTS];
 
 
+// The draws of the scene for the current frame. Built and sorted once in RenderScene, then each pass that renders the
+// scene (colour, normals and depth, focused object) walks the same queue, binding state only when it changes
+enum class SceneShader
+{
+	PixelLighting, // Lit and textured
+	TintedTexture, // Unlit texture times objectColour
+};
+
+struct SceneDraw
+{
+	Model*                    model;       // nullptr for a static instance set
+	ID3D11ShaderResourceView* texture;
+	CVector3                  colour;      // Tint for the tinted texture shader
+	int                       object;      // Index in gObjects, -1 for the sky, lights and instance sets
+	int                       instanceSet; // Instance set drawing this draw and the rest of its run, -1 to render the model alone
+	int                       runLength;   // Draws in the queue drawn by the instance set, 0 for the draws after the first
+};
+std::vector<SceneDraw> gSceneDraws;  // Indexed by the draw numbers in gRenderQueue
+RenderQueue            gRenderQueue;
+SortKeyIds             gTextureIds;  // Ids of the textures and meshes in the sort keys, kept for the life of the app
+SortKeyIds             gMeshIds;
+
+// Runs of at least this many opaque models in the queue with the same mesh and texture are drawn instanced, from a
+// dynamic instance set for each mesh and texture
+const int INSTANCING_MIN_RUN = 2;
+std::map<std::pair<Mesh*, ID3D11ShaderResourceView*>, int> gRunInstanceSets;
+
+// A field of crates drawn from a static instance set, their matrices are sent to the GPU once. G to show
+const int CRATE_FIELD_SIZE    = 32;    // Crates along each side
+const float CRATE_FIELD_SPACING = 12.0f;
+const CVector3 gCrateFieldCentre = { 0, 0, 300 };
+bool gShowCrateField = false;
+int  gCrateFieldSet  = -1;
+BoundingBox gCrateFieldBounds; // World bounds of the whole field, culled as one draw
+
+// The objects, lights and crate field are culled against the view frustum before they are added to the render queue, so
+// every pass drawing from the queue skips them. J to switch off. The sky surrounds the camera so is never culled
+bool                 gFrustumCulling = true;
+BoundingBoxes        gCullBounds;  // The objects, then the lights, then the crate field
+std::vector<uint8_t> gCullVisible; // For each of gCullBounds
+int                  gCullVisibleCount = 0;
+long long            gCullTotalTested  = 0; // Bounds tested and found visible over all frames culled, for the report on exit
+long long            gCullTotalVisible = 0;
+std::unique_ptr<ThreadPool> gCullingThreads; // Splits large lists of bounds, see CULLING_GRAIN
+
+
 // Additional light information
 CVector3 gAmbientColour = { 0.3f, 0.3f, 0.4f }; // Background level of light (slightly bluish to match the far background, which is dark blue)
 float    gSpecularPower = 256; // Specular power controls shininess - same for all models in this app
@@ -177,6 +183,7 @@ const float gLightOrbitSpeed = 0.7f;
 // Bloom variables
 float gTempTimer = 0.0f;
 int gTempDiagonalBlurs = 3;
+BloomMode gBloomMode = BloomMode::FullResolution; // F8 to switch
 
 // Motion blur
 float gCopyAlpha = 1.0f;
@@ -196,8 +203,8 @@ PerModelConstants gPerModelConstants;      // As above, but constants (settings)
 ID3D11Buffer*     gPerModelConstantBuffer; // --"--
 
 //**************************
-PostProcessingConstants gPostProcessingConstants;       // As above, but constants (settings) for each post-process
-ID3D11Buffer*           gPostProcessingConstantBuffer; // --"--
+PostProcessingConstants gPostProcessingConstants; // As above, but constants (settings) for each post-process. Sent to the
+                                                  // GPU in blocks by gPostProcessConstants below
 //**************************
 
 
@@ -229,43 +236,264 @@ ID3D11ShaderResourceView* gLightDiffuseMapSRV = nullptr;
 //****************************
 // Post processing textures
 
-// This texture will have the scene renderered on it. Then the texture is then used for post-processing
-ID3D11Texture2D*          gSceneTexture				= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gSceneRenderTarget		= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gSceneTextureSRV			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+// Post-processing textures (scene, normal/depth and focused object images, bloom and temporary textures) are taken from
+// this pool for the span of the passes that use them, so textures whose uses don't overlap share memory and textures for
+// effects that are not in use are not kept (see TransientTexturePool.h)
+class GPUTextureBackend : public TransientTextureBackend
+{
+public:
+	// Create a texture that can be rendered to and read by shaders
+	bool CreateTexture(int texture, const TextureDesc& desc) override
+	{
+		if (texture >= static_cast<int>(mTextures.size()))
+		{
+			mTextures.resize(texture + 1, nullptr);
+			mRenderTargets.resize(texture + 1, nullptr);
+			mSRVs.resize(texture + 1, nullptr);
+		}
+
+		// Many settings to prepare for a texture we can render to
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = desc.width;
+		textureDesc.Height = desc.height;
+		textureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
+		textureDesc.ArraySize = 1;
+		textureDesc.Format = ToDXGIFormat(desc.format);
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.SampleDesc.Quality = 0;
+		textureDesc.Usage = D3D11_USAGE_DEFAULT;
+		textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
+		textureDesc.CPUAccessFlags = 0;
+		textureDesc.MiscFlags = 0;
+
+		// A "view" of the texture as a render target is used when rendering to it, and a shader-resource "view" to
+		// send it to shaders (SRV = shader resource view)
+		D3D11_SHADER_RESOURCE_VIEW_DESC srDesc = {};
+		srDesc.Format = textureDesc.Format;
+		srDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srDesc.Texture2D.MostDetailedMip = 0;
+		srDesc.Texture2D.MipLevels = 1;
+
+		if (FAILED(gD3DDevice->CreateTexture2D(&textureDesc, NULL, &mTextures[texture])) ||
+			FAILED(gD3DDevice->CreateRenderTargetView(mTextures[texture], NULL, &mRenderTargets[texture])) ||
+			FAILED(gD3DDevice->CreateShaderResourceView(mTextures[texture], &srDesc, &mSRVs[texture])))
+		{
+			gLastError = "Error creating post-processing texture";
+			DestroyTexture(texture);
+			return false;
+		}
+		return true;
+	}
+
+	void DestroyTexture(int texture) override
+	{
+		if (mSRVs[texture])           mSRVs[texture]->Release();
+		if (mRenderTargets[texture])  mRenderTargets[texture]->Release();
+		if (mTextures[texture])       mTextures[texture]->Release();
+		mSRVs[texture] = nullptr;
+		mRenderTargets[texture] = nullptr;
+		mTextures[texture] = nullptr;
+	}
+
+	// Views of a texture, nullptr for -1 (a texture that could not be created)
+	ID3D11RenderTargetView*   RenderTarget(int texture) { return texture < 0 ? nullptr : mRenderTargets[texture]; }
+	ID3D11ShaderResourceView* SRV(int texture)          { return texture < 0 ? nullptr : mSRVs[texture]; }
+
+private:
+	static DXGI_FORMAT ToDXGIFormat(TextureFormat format)
+	{
+		switch (format)
+		{
+		case TextureFormat::RGBA8:       return DXGI_FORMAT_R8G8B8A8_UNORM;
+		case TextureFormat::RGBA16Float: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case TextureFormat::R8:          return DXGI_FORMAT_R8_UNORM;
+		case TextureFormat::R16Float:    return DXGI_FORMAT_R16_FLOAT;
+		case TextureFormat::R32Float:    return DXGI_FORMAT_R32_FLOAT;
+		}
+		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	std::vector<ID3D11Texture2D*>          mTextures;
+	std::vector<ID3D11RenderTargetView*>   mRenderTargets;
+	std::vector<ID3D11ShaderResourceView*> mSRVs;
+};
+
+GPUTextureBackend    gRenderTargetBackend;
+TransientTexturePool gRenderTargetPool(&gRenderTargetBackend);
+
+
+// The post-processing settings are sent to the shaders as an area block and a block for each effect, each only uploaded
+// when it has changed (see PostProcessConstantBlocks.h)
+class GPUConstantBufferBackend : public ConstantBufferBackend
+{
+public:
+	bool CreateBuffer(int buffer, size_t bytes) override
+	{
+		if (buffer >= static_cast<int>(mBuffers.size()))  mBuffers.resize(buffer + 1, nullptr);
+		mBuffers[buffer] = CreateConstantBuffer(static_cast<int>(bytes));
+		if (mBuffers[buffer] == nullptr)
+		{
+			gLastError = "Error creating post-processing constant buffer";
+			return false;
+		}
+		return true;
+	}
+
+	void Upload(int buffer, const void* data, size_t bytes) override
+	{
+		D3D11_MAPPED_SUBRESOURCE cb;
+		gD3DContext->Map(mBuffers[buffer], 0, D3D11_MAP_WRITE_DISCARD, 0, &cb);
+		memcpy(cb.pData, data, bytes);
+		gD3DContext->Unmap(mBuffers[buffer], 0);
+	}
+
+	void DestroyBuffer(int buffer) override
+	{
+		if (mBuffers[buffer])  mBuffers[buffer]->Release();
+		mBuffers[buffer] = nullptr;
+	}
+
+	// The Direct3D buffer, nullptr for -1 (a buffer that could not be created)
+	ID3D11Buffer* Buffer(int buffer) { return buffer < 0 ? nullptr : mBuffers[buffer]; }
+
+private:
+	std::vector<ID3D11Buffer*> mBuffers;
+};
+
+GPUConstantBufferBackend gPostProcessConstantBackend;
+PostProcessConstantCache gPostProcessConstants(&gPostProcessConstantBackend);
+
+
+// The post-processing passes bind their targets, textures, shaders and states through a filter that drops calls binding
+// what is already bound (see RenderStateFilter.h)
+class D3DStateBackend : public RenderStateBackend
+{
+public:
+	void SetRenderTarget(void* renderTarget, void* depthStencil) override
+	{
+		auto renderTargetView = static_cast<ID3D11RenderTargetView*>(renderTarget);
+		gD3DContext->OMSetRenderTargets(1, &renderTargetView, static_cast<ID3D11DepthStencilView*>(depthStencil));
+	}
+
+	void SetShaderResource(int slot, void* shaderResource) override
+	{
+		auto srv = static_cast<ID3D11ShaderResourceView*>(shaderResource);
+		gD3DContext->PSSetShaderResources(slot, 1, &srv);
+	}
+
+	void SetSampler(int slot, void* sampler) override
+	{
+		auto samplerState = static_cast<ID3D11SamplerState*>(sampler);
+		gD3DContext->PSSetSamplers(slot, 1, &samplerState);
+	}
+
+	void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) override
+	{
+		auto constantBuffer = static_cast<ID3D11Buffer*>(buffer);
+		if (stage == ShaderStage::Vertex)  gD3DContext->VSSetConstantBuffers(slot, 1, &constantBuffer);
+		else                               gD3DContext->PSSetConstantBuffers(slot, 1, &constantBuffer);
+	}
+
+	void SetVertexShader(void* shader) override   { gD3DContext->VSSetShader(static_cast<ID3D11VertexShader*>(shader), nullptr, 0); }
+	void SetGeometryShader(void* shader) override { gD3DContext->GSSetShader(static_cast<ID3D11GeometryShader*>(shader), nullptr, 0); }
+	void SetPixelShader(void* shader) override    { gD3DContext->PSSetShader(static_cast<ID3D11PixelShader*>(shader), nullptr, 0); }
+
+	void SetBlendState(void* state) override        { gD3DContext->OMSetBlendState(static_cast<ID3D11BlendState*>(state), nullptr, 0xffffff); }
+	void SetDepthStencilState(void* state) override { gD3DContext->OMSetDepthStencilState(static_cast<ID3D11DepthStencilState*>(state), 0); }
+	void SetRasterizerState(void* state) override   { gD3DContext->RSSetState(static_cast<ID3D11RasterizerState*>(state)); }
 
-ID3D11Texture2D*		  gSceneTexture2			= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*	  gSceneRenderTarget2		= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gSceneTextureSRV2			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+	void SetInputLayout(void* layout) override { gD3DContext->IASetInputLayout(static_cast<ID3D11InputLayout*>(layout)); }
+	void SetTopology(int topology) override    { gD3DContext->IASetPrimitiveTopology(static_cast<D3D11_PRIMITIVE_TOPOLOGY>(topology)); }
+};
+
+D3DStateBackend   gStateBackend;
+RenderStateFilter gStateFilter(&gStateBackend);
 
-ID3D11Texture2D*		  gTempTexture				= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gTempRenderTarget			= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gTempTextureSRV			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
 
-ID3D11Texture2D*		  gTempTexture2				= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gTempRenderTarget2		= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gTempTextureSRV2			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+// Models that share a mesh are drawn instanced, the world matrices of each instance set sent to its own vertex buffer
+// (see InstanceBatcher.h). Static sets use a buffer only the GPU accesses, dynamic sets one mapped each time they change
+class D3DInstanceBackend : public InstanceBackend
+{
+public:
+	bool UploadInstances(int set, InstanceUsage usage, const CMatrix4x4* matrices, int count) override
+	{
+		if (set >= static_cast<int>(mBuffers.size()))  mBuffers.resize(set + 1);
+		auto& buffer = mBuffers[set];
+
+		// Make a new buffer when the set outgrows the old one, with room for the set to double before the next
+		if (buffer.buffer == nullptr || count > buffer.capacity || usage != buffer.usage)
+		{
+			if (buffer.buffer)  buffer.buffer->Release();
+			buffer.buffer   = nullptr;
+			buffer.capacity = std::max(count, buffer.capacity * 2);
+			buffer.usage    = usage;
+
+			D3D11_BUFFER_DESC bufferDesc;
+			bufferDesc.ByteWidth      = buffer.capacity * sizeof(CMatrix4x4);
+			bufferDesc.BindFlags      = D3D11_BIND_VERTEX_BUFFER;
+			bufferDesc.Usage          = (usage == InstanceUsage::Dynamic) ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+			bufferDesc.CPUAccessFlags = (usage == InstanceUsage::Dynamic) ? D3D11_CPU_ACCESS_WRITE : 0;
+			bufferDesc.MiscFlags      = 0;
+			bufferDesc.StructureByteStride = 0;
+			if (FAILED(gD3DDevice->CreateBuffer(&bufferDesc, nullptr, &buffer.buffer)))
+			{
+				buffer.buffer   = nullptr;
+				buffer.capacity = 0;
+				return false;
+			}
+		}
 
-ID3D11ShaderResourceView* gCurrentBloomTextureSRV	= nullptr;
+		if (usage == InstanceUsage::Dynamic)
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			if (FAILED(gD3DContext->Map(buffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+			memcpy(mapped.pData, matrices, count * sizeof(CMatrix4x4));
+			gD3DContext->Unmap(buffer.buffer, 0);
+		}
+		else
+		{
+			D3D11_BOX box = { 0, 0, 0, static_cast<UINT>(count * sizeof(CMatrix4x4)), 1, 1 };
+			gD3DContext->UpdateSubresource(buffer.buffer, 0, &box, matrices, 0, 0);
+		}
+		return true;
+	}
 
-ID3D11Texture2D*		  gNormalDepthTexture		= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gNormalDepthRenderTarget	= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gNormalDepthTextureSRV	= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+	void DrawInstances(int set, void* mesh, int node, int firstInstance, int numInstances) override
+	{
+		static_cast<Mesh*>(mesh)->RenderInstanced(mBuffers[set].buffer, node, firstInstance, numInstances);
+	}
 
-ID3D11Texture2D*		  gNormalDepthTexture2		= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gNormalDepthRenderTarget2	= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gNormalDepthTextureSRV2	= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+	void Release()
+	{
+		for (auto& buffer : mBuffers)
+		{
+			if (buffer.buffer)  buffer.buffer->Release();
+		}
+		mBuffers.clear();
+	}
 
-ID3D11ShaderResourceView* gCurrentNormalDepthTextureSRV = nullptr;
+private:
+	struct InstanceBuffer
+	{
+		ID3D11Buffer* buffer   = nullptr;
+		int           capacity = 0; // In matrices
+		InstanceUsage usage    = InstanceUsage::Static;
+	};
+	std::vector<InstanceBuffer> mBuffers; // Indexed by set
+};
 
-ID3D11Texture2D*		  gFocusedObjectTexture				= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gFocusedObjectRenderTarget		= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gFocusedObjectTextureSRV			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+D3DInstanceBackend gInstanceBackend;
+InstanceBatcher    gInstanceBatcher(&gInstanceBackend, sizeof(PerModelConstants));
 
-ID3D11Texture2D*		  gFocusedObjectTexture2			= nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gFocusedObjectRenderTarget2		= nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gFocusedObjectTextureSRV2			= nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+// Full size RGBA texture (8-bits each), used for the scene, normal/depth and focused object images and the bloom texture
+TextureDesc ViewportTextureDesc()
+{
+	return { gViewportWidth, gViewportHeight, TextureFormat::RGBA8 };
+}
 
+// Textures used by the post-process being run
+ID3D11ShaderResourceView* gCurrentBloomTextureSRV         = nullptr;
+ID3D11ShaderResourceView* gCurrentNormalDepthTextureSRV   = nullptr;
 ID3D11ShaderResourceView* gCurrentFocusedObjectTextureSRV = nullptr;
 
 // Additional textures used for specific post-processes
@@ -282,6 +510,126 @@ ID3D11ShaderResourceView* gNoiseMapSRV2 = nullptr;
 
 
 
+//--------------------------------------------------------------------------------------
+// Asset loading
+//--------------------------------------------------------------------------------------
+
+// Loads the meshes and textures on a thread pool, from StartLoadingAssets until InitGeometry has created them
+std::unique_ptr<AssetLoader> gAssetLoader;
+
+// Data passed from the load stage of a mesh or texture to its create stage
+struct LoadedMesh
+{
+	MeshFile meshFile; // Binary mesh data points into this mapped file
+	MeshData data;
+};
+struct LoadedTexture
+{
+	std::vector<uint8_t> fileData;
+	std::string fileName; // Name of the file read, the cooked file if there is one
+};
+
+
+// Add a mesh to the asset loader. The load stage imports or maps the file, the create stage creates the Mesh
+static void AddMesh(const std::string& fileName, Mesh** mesh)
+{
+	auto loaded = std::make_shared<LoadedMesh>();
+	gAssetLoader->Add(fileName,
+		[=]()
+		{
+			try
+			{
+				LoadMeshData(fileName, false, loaded->meshFile, loaded->data);
+				return true;
+			}
+			catch (std::runtime_error& e)
+			{
+				AssetLoader::SetError(e.what());
+				return false;
+			}
+		},
+		[=]()
+		{
+			try
+			{
+				*mesh = new Mesh(loaded->data, fileName);
+				return true;
+			}
+			catch (std::runtime_error& e)
+			{
+				AssetLoader::SetError(e.what());
+				return false;
+			}
+		});
+}
+
+// Add a texture to the asset loader. The load stage reads the file, or the cooked DDS file made from it by the
+// TextureCooker tool if there is one for the current contents. The create stage decodes it into a texture, or uploads
+// the cooked file as it is
+static void AddTexture(const std::string& fileName, ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV)
+{
+	auto loaded = std::make_shared<LoadedTexture>();
+	gAssetLoader->Add(fileName,
+		[=]()
+		{
+			loaded->fileName = fileName;
+			if (!ReadWholeFile(fileName, loaded->fileData))  return false;
+
+			// DDS files are already ready to upload
+			if (fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".dds") == 0)  return true;
+
+			std::string cookedFileName = CookedTextureFileName(fileName, HashTextureSource(loaded->fileData.data(), loaded->fileData.size()));
+			std::vector<uint8_t> cookedData;
+			if (ReadWholeFile(cookedFileName, cookedData))
+			{
+				loaded->fileData.swap(cookedData);
+				loaded->fileName = cookedFileName;
+			}
+			return true;
+		},
+		[=]() { return LoadTextureFromMemory(loaded->fileName, loaded->fileData.data(), loaded->fileData.size(), texture, textureSRV); });
+}
+
+
+// Start loading the scene's meshes and textures in the background. Call before creating the Direct3D device so loading
+// overlaps with it, InitGeometry waits for the loading to finish
+void StartLoadingAssets()
+{
+	gAssetLoader = std::make_unique<AssetLoader>();
+
+	// Load mesh geometry data, just like TL-Engine this doesn't create anything in the scene. Create a Model for that.
+	AddMesh("Stars.x",          &gStarsMesh);
+	AddMesh("Hills.x",          &gGroundMesh);
+	AddMesh("Cube.x",           &gCubeMesh);
+	AddMesh("CargoContainer.x", &gCrateMesh);
+	AddMesh("Light.x",          &gLightMesh);
+	AddMesh("Wall1.x",          &gWall1Mesh);
+	AddMesh("Wall2.x",          &gWall2Mesh);
+	AddMesh("Teapot.x",         &gTeapotMesh);
+	AddMesh("Troll.x",          &gTrollMesh);
+
+	// Load textures and create DirectX objects for them
+	// Pass a ID3D11Resource* (e.g. &gCubeDiffuseMap), which manages the GPU memory for the texture and also a
+	// ID3D11ShaderResourceView* (e.g. &gCubeDiffuseMapSRV), which allows us to use the texture in shaders
+	// These pointers are filled in with usable data by InitGeometry. The variables used here are globals found near the top of the file.
+	AddTexture("Stars.jpg",                &gStarsDiffuseSpecularMap,  &gStarsDiffuseSpecularMapSRV);
+	AddTexture("GrassDiffuseSpecular.dds", &gGroundDiffuseSpecularMap, &gGroundDiffuseSpecularMapSRV);
+	AddTexture("StoneDiffuseSpecular.dds", &gCubeDiffuseSpecularMap,   &gCubeDiffuseSpecularMapSRV);
+	AddTexture("CargoA.dds",               &gCrateDiffuseSpecularMap,  &gCrateDiffuseSpecularMapSRV);
+	AddTexture("Flare.jpg",                &gLightDiffuseMap,          &gLightDiffuseMapSRV);
+	AddTexture("Noise.png",                &gNoiseMap,                 &gNoiseMapSRV);
+	AddTexture("Burn.png",                 &gBurnMap,                  &gBurnMapSRV);
+	AddTexture("Distort.png",              &gDistortMap,               &gDistortMapSRV);
+	AddTexture("Noise2.png",               &gNoiseMap2,                &gNoiseMapSRV2);
+	AddTexture("brick_35.jpg",             &gWallMap,                  &gWallMapSRV);
+	AddTexture("TrollDiffuseSpecular.dds", &gTrollDiffuseSpecularMap,  &gTrollDiffuseSpecularMapSRV);
+	AddTexture("Saturn.jpg",               &gTeapotMap,                &gTeapotMapSRV);
+
+	gAssetLoader->Start();
+}
+
+
+
 //--------------------------------------------------------------------------------------
 // Initialise scene geometry, constant buffers and states
 //--------------------------------------------------------------------------------------
@@ -290,50 +638,19 @@ ID3D11ShaderResourceView* gNoiseMapSRV2 = nullptr;
 // Returns true on success
 bool InitGeometry()
 {
-	////--------------- Load meshes ---------------////
+	////--------------- Load meshes and textures ---------------////
 
-	// Load mesh geometry data, just like TL-Engine this doesn't create anything in the scene. Create a Model for that.
-	try
+	// Wait for the meshes and textures started in StartLoadingAssets, creating the GPU resources for each as it is ready
+	if (gAssetLoader == nullptr)  StartLoadingAssets();
+	bool loaded = gAssetLoader->Finish();
+	OutputDebugStringA(("Asset loading times (ms)\n" + gAssetLoader->Timings()).c_str());
+	if (!loaded)
 	{
-		gStarsMesh  = new Mesh("Stars.x");
-		gGroundMesh = new Mesh("Hills.x");
-		gCubeMesh   = new Mesh("Cube.x");
-		gCrateMesh  = new Mesh("CargoContainer.x");
-		gLightMesh  = new Mesh("Light.x");
-		gWall1Mesh  = new Mesh("Wall1.x");
-		gWall2Mesh  = new Mesh("Wall2.x");
-		gTeapotMesh = new Mesh("Teapot.x");
-		gTrollMesh  = new Mesh("Troll.x");
-	}
-	catch (std::runtime_error e)  // Constructors cannot return error messages so use exceptions to catch mesh errors (fairly standard approach this)
-	{
-		gLastError = e.what(); // This picks up the error message put in the exception (see Mesh.cpp)
-		return false;
-	}
-
-
-	////--------------- Load / prepare textures & GPU states ---------------////
-
-	// Load textures and create DirectX objects for them
-	// The LoadTexture function requires you to pass a ID3D11Resource* (e.g. &gCubeDiffuseMap), which manages the GPU memory for the
-	// texture and also a ID3D11ShaderResourceView* (e.g. &gCubeDiffuseMapSRV), which allows us to use the texture in shaders
-	// The function will fill in these pointers with usable data. The variables used here are globals found near the top of the file.
-	if (!LoadTexture("Stars.jpg",                &gStarsDiffuseSpecularMap,  &gStarsDiffuseSpecularMapSRV) ||
-		!LoadTexture("GrassDiffuseSpecular.dds", &gGroundDiffuseSpecularMap, &gGroundDiffuseSpecularMapSRV) ||
-		!LoadTexture("StoneDiffuseSpecular.dds", &gCubeDiffuseSpecularMap,   &gCubeDiffuseSpecularMapSRV) ||
-		!LoadTexture("CargoA.dds",               &gCrateDiffuseSpecularMap,  &gCrateDiffuseSpecularMapSRV) ||
-		!LoadTexture("Flare.jpg",                &gLightDiffuseMap,          &gLightDiffuseMapSRV) ||
-		!LoadTexture("Noise.png",				 &gNoiseMap,				 &gNoiseMapSRV) ||
-		!LoadTexture("Burn.png",                 &gBurnMap,					 &gBurnMapSRV) ||
-		!LoadTexture("Distort.png",              &gDistortMap,				 &gDistortMapSRV) ||
-		!LoadTexture("Noise2.png",				 &gNoiseMap2,				 &gNoiseMapSRV2) ||
-		!LoadTexture("brick_35.jpg",			 &gWallMap,					 &gWallMapSRV) ||
-		!LoadTexture("TrollDiffuseSpecular.dds", &gTrollDiffuseSpecularMap,	 &gTrollDiffuseSpecularMapSRV) ||
-		!LoadTexture("Saturn.jpg",				 &gTeapotMap,				 &gTeapotMapSRV))
-	{
-		gLastError = "Error loading textures";
+		gLastError = gAssetLoader->LastError();
+		gAssetLoader = nullptr;
 		return false;
 	}
+	gAssetLoader = nullptr; // Frees the loaded data and the loading threads
 
 
 	// Create all filtering modes, blending modes etc. used by the app (see State.cpp/.h)
@@ -356,10 +673,10 @@ bool InitGeometry()
 	// Create GPU-side constant buffers to receive the gPerFrameConstants and gPerModelConstants structures above
 	// These allow us to pass data from CPU to shaders such as lighting information or matrices
 	// See the comments above where these variable are declared and also the UpdateScene function
-	gPerFrameConstantBuffer       = CreateConstantBuffer(sizeof(gPerFrameConstants));
-	gPerModelConstantBuffer       = CreateConstantBuffer(sizeof(gPerModelConstants));
-	gPostProcessingConstantBuffer = CreateConstantBuffer(sizeof(gPostProcessingConstants));
-	if (gPerFrameConstantBuffer == nullptr || gPerModelConstantBuffer == nullptr || gPostProcessingConstantBuffer == nullptr)
+	// The post-processing constant buffers are created as they are first used (see gPostProcessConstants)
+	gPerFrameConstantBuffer = CreateConstantBuffer(sizeof(gPerFrameConstants));
+	gPerModelConstantBuffer = CreateConstantBuffer(sizeof(gPerModelConstants));
+	if (gPerFrameConstantBuffer == nullptr || gPerModelConstantBuffer == nullptr)
 	{
 		gLastError = "Error creating constant buffers";
 		return false;
@@ -368,157 +685,18 @@ bool InitGeometry()
 
 
 	//********************************************
-	//**** Create Scene Texture
-
-	// We will render the scene to this texture instead of the back-buffer (screen), then we post-process the texture onto the screen
-	// This is exactly the same code we used in the graphics module when we were rendering the scene onto a cube using a texture
-
-	// Using a helper function to load textures from files above. Here we create the scene texture manually
-	// as we are creating a special kind of texture (one that we can render to). Many settings to prepare:
-	D3D11_TEXTURE2D_DESC sceneTextureDesc = {};
-	sceneTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
-	sceneTextureDesc.Height = gViewportHeight;
-	sceneTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
-	sceneTextureDesc.ArraySize = 1;
-	sceneTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	sceneTextureDesc.SampleDesc.Count = 1;
-	sceneTextureDesc.SampleDesc.Quality = 0;
-	sceneTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	sceneTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
-	sceneTextureDesc.CPUAccessFlags = 0;
-	sceneTextureDesc.MiscFlags = 0;
-	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTexture)) ||
-		FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTexture2)))
-	{
-		gLastError = "Error creating scene texture";
-		return false;
-	}
-
-	// We created the scene texture above, now we get a "view" of it as a render target, i.e. get a special pointer to the texture that
-	// we use when rendering to it (see RenderScene function below)
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gSceneTexture, NULL, &gSceneRenderTarget)) ||
-		FAILED(gD3DDevice->CreateRenderTargetView(gSceneTexture2, NULL, &gSceneRenderTarget2)))
-	{
-		gLastError = "Error creating scene render target view";
-		return false;
-	}
-
-	// We also need to send this texture (resource) to the shaders. To do that we must create a shader-resource "view"
-	D3D11_SHADER_RESOURCE_VIEW_DESC srDesc = {};
-	srDesc.Format = sceneTextureDesc.Format;
-	srDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srDesc.Texture2D.MostDetailedMip = 0;
-	srDesc.Texture2D.MipLevels = 1;
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gSceneTexture, &srDesc, &gSceneTextureSRV)) || 
-		FAILED(gD3DDevice->CreateShaderResourceView(gSceneTexture2, &srDesc, &gSceneTextureSRV2)))
-	{
-		gLastError = "Error creating scene shader resource view";
-		return false;
-	}
-
-	//********************************************
-	//**** Create Temp Texture for bloom and depth of field effects
-	D3D11_TEXTURE2D_DESC tempTextureDesc = {};
-	tempTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
-	tempTextureDesc.Height = gViewportHeight;
-	tempTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
-	tempTextureDesc.ArraySize = 1;
-	tempTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	tempTextureDesc.SampleDesc.Count = 1;
-	tempTextureDesc.SampleDesc.Quality = 0;
-	tempTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	tempTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
-	tempTextureDesc.CPUAccessFlags = 0;
-	tempTextureDesc.MiscFlags = 0;
-
-	if (FAILED(gD3DDevice->CreateTexture2D(&tempTextureDesc, NULL, &gTempTexture)) || 
-		FAILED(gD3DDevice->CreateTexture2D(&tempTextureDesc, NULL, &gTempTexture2)))
-	{
-		gLastError = "Error creating bloom texture";
-		return false;
-	}
-
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gTempTexture, NULL, &gTempRenderTarget)) ||
-		FAILED(gD3DDevice->CreateRenderTargetView(gTempTexture2, NULL, &gTempRenderTarget2)))
-	{
-		gLastError = "Error creating bloom render target view";
-		return false;
-	}
-
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gTempTexture, &srDesc, &gTempTextureSRV)) ||
-		FAILED(gD3DDevice->CreateShaderResourceView(gTempTexture2, &srDesc, &gTempTextureSRV2)))
-	{
-		gLastError = "Error creating bloom shader resource view";
-		return false;
-	}
-
-	//********************************************
-	//**** Create Normal and Depth Map
-	D3D11_TEXTURE2D_DESC ndTextureDesc = {};
-	ndTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
-	ndTextureDesc.Height = gViewportHeight;
-	ndTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
-	ndTextureDesc.ArraySize = 1;
-	ndTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	ndTextureDesc.SampleDesc.Count = 1;
-	ndTextureDesc.SampleDesc.Quality = 0;
-	ndTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	ndTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
-	ndTextureDesc.CPUAccessFlags = 0;
-	ndTextureDesc.MiscFlags = 0;
-
-	if (FAILED(gD3DDevice->CreateTexture2D(&ndTextureDesc, NULL, &gNormalDepthTexture))||
-		FAILED(gD3DDevice->CreateTexture2D(&ndTextureDesc, NULL, &gNormalDepthTexture2)))
-	{
-		gLastError = "Error creating normal depth texture";
-		return false;
-	}
+	//**** Create Scene Textures
 
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gNormalDepthTexture, NULL,  &gNormalDepthRenderTarget))||
-		FAILED(gD3DDevice->CreateRenderTargetView(gNormalDepthTexture2, NULL, &gNormalDepthRenderTarget2)))
+	// We will render the scene to a texture instead of the back-buffer (screen), then we post-process the texture onto the screen
+	// Post-processing textures are taken from a pool when needed (see RenderScene), but create the pair of scene textures
+	// used every frame now so any problem is reported here
+	int sceneTexture  = gRenderTargetPool.Acquire(ViewportTextureDesc());
+	int sceneTexture2 = gRenderTargetPool.Acquire(ViewportTextureDesc());
+	gRenderTargetPool.Release(sceneTexture);
+	gRenderTargetPool.Release(sceneTexture2);
+	if (sceneTexture < 0 || sceneTexture2 < 0)
 	{
-		gLastError = "Error creating normal depth render target view";
-		return false;
-	}
-
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gNormalDepthTexture, &srDesc,  &gNormalDepthTextureSRV))||
-		FAILED(gD3DDevice->CreateShaderResourceView(gNormalDepthTexture2, &srDesc, &gNormalDepthTextureSRV2)))
-	{
-		gLastError = "Error creating normal depth shader resource view";
-		return false;
-	}
-
-	// Focused object
-	D3D11_TEXTURE2D_DESC foTextureDesc = {};
-	foTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
-	foTextureDesc.Height = gViewportHeight;
-	foTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
-	foTextureDesc.ArraySize = 1;
-	foTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	foTextureDesc.SampleDesc.Count = 1;
-	foTextureDesc.SampleDesc.Quality = 0;
-	foTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	foTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
-	foTextureDesc.CPUAccessFlags = 0;
-	foTextureDesc.MiscFlags = 0;
-	if (FAILED(gD3DDevice->CreateTexture2D(&foTextureDesc, NULL, &gFocusedObjectTexture)) ||
-		FAILED(gD3DDevice->CreateTexture2D(&foTextureDesc, NULL, &gFocusedObjectTexture2)))
-	{
-		gLastError = "Error creating normal depth texture";
-		return false;
-	}
-
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gFocusedObjectTexture, NULL, &gFocusedObjectRenderTarget)) ||
-		FAILED(gD3DDevice->CreateRenderTargetView(gFocusedObjectTexture2, NULL, &gFocusedObjectRenderTarget2)))
-	{
-		gLastError = "Error creating normal depth render target view";
-		return false;
-	}
-
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gFocusedObjectTexture, &srDesc, &gFocusedObjectTextureSRV)) ||
-		FAILED(gD3DDevice->CreateShaderResourceView(gFocusedObjectTexture2, &srDesc, &gFocusedObjectTextureSRV2)))
-	{
-		gLastError = "Error creating normal depth shader resource view";
+		gLastError = "Error creating scene texture";
 		return false;
 	}
 
@@ -542,6 +720,29 @@ bool InitScene()
 	gObjects.push_back(new Object(gTeapotMesh, CVector3(35, 0, 65), CVector3(0, 2, 0), 1.6f, gTeapotMapSRV));										//5
 	gObjects.push_back(new Object(gTrollMesh, CVector3(-20, 5, 55), CVector3(0.3f, 2, 0.1f), 10.0f, gTrollDiffuseSpecularMapSRV));					//6
 
+	// InitGeometry has freed the asset loader's threads by now, so the culling has the cores to itself
+	gCullingThreads = std::make_unique<ThreadPool>();
+
+	// The crate field is a static instance set, its matrices only go to the GPU when it is first drawn
+	gCrateFieldSet = gInstanceBatcher.AddSet(gCrateMesh, gCrateMesh->NumberNodes(), InstanceUsage::Static);
+	Model crate(gCrateMesh);
+	std::vector<CMatrix4x4> crateMatrices(crate.NumberNodes());
+	gCrateFieldBounds = EmptyBoundingBox();
+	for (int row = 0; row < CRATE_FIELD_SIZE; ++row)
+	{
+		for (int column = 0; column < CRATE_FIELD_SIZE; ++column)
+		{
+			float x = (column - (CRATE_FIELD_SIZE - 1) * 0.5f) * CRATE_FIELD_SPACING;
+			float z = (row    - (CRATE_FIELD_SIZE - 1) * 0.5f) * CRATE_FIELD_SPACING;
+			crate.SetPosition(gCrateFieldCentre + CVector3(x, 0, z));
+			crate.SetRotation({ 0, ToRadians(static_cast<float>((row * 37 + column * 53) % 360)), 0 });
+			crate.SetScale(2.0f);
+			crate.GetAbsoluteMatrices(crateMatrices.data());
+			gInstanceBatcher.AddInstance(gCrateFieldSet, crateMatrices.data());
+			gCrateFieldBounds = Combine(gCrateFieldBounds, crate.WorldBounds());
+		}
+	}
+
 	// Polygon postprocesses
 
 	// An array of four points in world space - a tapered square centred at the origin
@@ -564,8 +765,12 @@ bool InitScene()
 	const std::array<CVector3, 4> points4 = { { {0,28,0}, {0,18,0}, {-10,28,0}, {-10,18,0} } };
 	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::ChromaticAberration, PostProcessMode::Polygon, new PolygonData(points4, polyMatrix)));
 
+	// This hue shift has its own settings, a fixed half turn of the hue, while the one above follows the shared setting
 	const std::array<CVector3, 4> points5 = { { {-10,28,0}, {-10,18,0}, {-20,28,0}, {-20,18,0} } };
-	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::HueShift, PostProcessMode::Polygon, new PolygonData(points5, polyMatrix)));
+	auto hueShiftConstants = new PostProcessingConstants();
+	hueShiftConstants->hueShift = 0.5f;
+	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::HueShift, PostProcessMode::Polygon, new PolygonData(points5, polyMatrix),
+	                                                hueShiftConstants));
 	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::Retro, PostProcessMode::Polygon, new PolygonData(points5, polyMatrix)));
 	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::Spiral, PostProcessMode::Polygon, new PolygonData(points5, polyMatrix)));
 	gPolygonPostProcesses.push_back(new PostProcess(PostProcessType::Distort, PostProcessMode::Polygon, new PolygonData(points5, polyMatrix)));
@@ -602,38 +807,11 @@ bool InitScene()
 void ReleaseResources()
 {
 	ReleaseStates();
+	gInstanceBackend.Release();
+	gCullingThreads = nullptr;
 
-	if (gSceneTextureSRV)              gSceneTextureSRV->Release();
-	if (gSceneRenderTarget)            gSceneRenderTarget->Release();
-	if (gSceneTexture)                 gSceneTexture->Release();
-
-	if (gSceneTextureSRV2)             gSceneTextureSRV2->Release();
-	if (gSceneRenderTarget2)           gSceneRenderTarget2->Release();
-	if (gSceneTexture2)                gSceneTexture2->Release();
-									   
-	if (gTempTextureSRV)               gTempTextureSRV->Release();
-	if (gTempRenderTarget)             gTempRenderTarget->Release();
-	if (gTempTexture)                  gTempTexture->Release();
-									   
-	if (gTempTextureSRV2)              gTempTextureSRV2->Release();
-	if (gTempRenderTarget2)            gTempRenderTarget2->Release();
-	if (gTempTexture2)                 gTempTexture2->Release();
-									   
-	if (gNormalDepthTextureSRV)        gNormalDepthTextureSRV->Release();
-	if (gNormalDepthRenderTarget)      gNormalDepthRenderTarget->Release();
-	if (gNormalDepthTexture)           gNormalDepthTexture->Release();
-							   		   
-	if (gNormalDepthTextureSRV2)       gNormalDepthTextureSRV2->Release();
-	if (gNormalDepthRenderTarget2)     gNormalDepthRenderTarget2->Release();
-	if (gNormalDepthTexture2)          gNormalDepthTexture2->Release();
-									   
-	if (gFocusedObjectTextureSRV)      gFocusedObjectTextureSRV->Release();
-	if (gFocusedObjectRenderTarget)    gFocusedObjectRenderTarget->Release();
-	if (gFocusedObjectTexture)         gFocusedObjectTexture->Release();
-									   
-	if (gFocusedObjectTextureSRV2)     gFocusedObjectTextureSRV2->Release();
-	if (gFocusedObjectRenderTarget2)   gFocusedObjectRenderTarget2->Release();
-	if (gFocusedObjectTexture2)        gFocusedObjectTexture2->Release();
+	gRenderTargetPool.DestroyAll();
+	gPostProcessConstants.DestroyAll();
 
 	if (gDistortMapSRV)                gDistortMapSRV->Release();
 	if (gDistortMap)                   gDistortMap->Release();
@@ -655,7 +833,6 @@ void ReleaseResources()
 	if (gStarsDiffuseSpecularMapSRV)   gStarsDiffuseSpecularMapSRV->Release();
 	if (gStarsDiffuseSpecularMap)      gStarsDiffuseSpecularMap->Release();
 
-	if (gPostProcessingConstantBuffer) gPostProcessingConstantBuffer->Release();
 	if (gPerModelConstantBuffer)       gPerModelConstantBuffer->Release();
 	if (gPerFrameConstantBuffer)       gPerFrameConstantBuffer->Release();
 
@@ -700,87 +877,241 @@ void ReleaseResources()
 // Scene Rendering
 //--------------------------------------------------------------------------------------
 
-// Render everything in the scene from the given camera
-void RenderSceneFromCamera(Camera* camera)
+// Add a draw to the render queue. Depth is the distance from the camera to the position given
+static void AddSceneDraw(RenderPass pass, SceneShader shader, Mesh* mesh, CVector3 position, CVector3 cameraPosition,
+                         const SceneDraw& draw)
 {
-	// Set camera matrices in the constant buffer and send over to GPU
-	gPerFrameConstants.cameraMatrix = camera->WorldMatrix();
-	gPerFrameConstants.viewMatrix = camera->ViewMatrix();
-	gPerFrameConstants.projectionMatrix = camera->ProjectionMatrix();
-	gPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
-	UpdateConstantBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
+	uint64_t key = MakeSortKey(pass, static_cast<int>(shader), gTextureIds.Id(draw.texture), gMeshIds.Id(mesh),
+	                           Length(position - cameraPosition));
+	gRenderQueue.Add(key, static_cast<uint32_t>(gSceneDraws.size()));
+	gSceneDraws.push_back(draw);
+}
 
-	// Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
-	gD3DContext->VSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer); // First parameter must match constant buffer number in the shader 
-	gD3DContext->GSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
-	gD3DContext->PSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
+static void AddModelDraw(RenderPass pass, SceneShader shader, Model* model, ID3D11ShaderResourceView* texture,
+                         CVector3 colour, int object, CVector3 cameraPosition)
+{
+	AddSceneDraw(pass, shader, model->GetMesh(), model->Position(), cameraPosition, { model, texture, colour, object, -1, 1 });
+}
 
-	gD3DContext->PSSetShader(gPixelLightingPixelShader, nullptr, 0);
 
+// Draw runs of opaque models in the sorted queue that share a mesh and texture instanced
+static void BatchRenderQueueRuns()
+{
+	for (auto& set : gRunInstanceSets)  gInstanceBatcher.ClearInstances(set.second);
 
-	////--------------- Render ordinary models ---------------///
+	std::vector<CMatrix4x4> nodeMatrices;
+	size_t start = 0;
+	while (start < gRenderQueue.Size())
+	{
+		SceneDraw& first = gSceneDraws[gRenderQueue[start].draw];
+		size_t end = start + 1;
+		if (SortKeyPass(gRenderQueue[start].key) == RenderPass::Opaque && first.model != nullptr &&
+		    first.model->GetMesh()->CanRenderInstanced())
+		{
+			while (end < gRenderQueue.Size())
+			{
+				const SceneDraw& next = gSceneDraws[gRenderQueue[end].draw];
+				if (SortKeyPass(gRenderQueue[end].key) != RenderPass::Opaque ||
+				    SortKeyShader(gRenderQueue[end].key) != SortKeyShader(gRenderQueue[start].key) || next.model == nullptr ||
+				    next.model->GetMesh() != first.model->GetMesh() || next.texture != first.texture)  break;
+				++end;
+			}
+		}
 
-	// Select which shaders to use next
-	gD3DContext->VSSetShader(gPixelLightingVertexShader, nullptr, 0);
-	gD3DContext->PSSetShader(gPixelLightingPixelShader, nullptr, 0);
-	gD3DContext->GSSetShader(nullptr, nullptr, 0);  // Switch off geometry shader when not using it (pass nullptr for first parameter)
+		if (static_cast<int>(end - start) >= INSTANCING_MIN_RUN)
+		{
+			auto setKey = std::make_pair(first.model->GetMesh(), first.texture);
+			auto found = gRunInstanceSets.find(setKey);
+			if (found == gRunInstanceSets.end())
+			{
+				int newSet = gInstanceBatcher.AddSet(first.model->GetMesh(), first.model->NumberNodes(), InstanceUsage::Dynamic);
+				found = gRunInstanceSets.insert({ setKey, newSet }).first;
+			}
 
-	// States - no blending, normal depth buffer and back-face culling (standard set-up for opaque models)
-	gD3DContext->OMSetBlendState(gNoBlendingState, nullptr, 0xffffff);
-	gD3DContext->OMSetDepthStencilState(gUseDepthBufferState, 0);
-	gD3DContext->RSSetState(gCullBackState);
+			// Instances are added in queue order so they are still drawn front to back
+			first.instanceSet = found->second;
+			first.runLength   = static_cast<int>(end - start);
+			for (size_t i = start; i < end; ++i)
+			{
+				SceneDraw& draw = gSceneDraws[gRenderQueue[i].draw];
+				nodeMatrices.resize(draw.model->NumberNodes());
+				draw.model->GetAbsoluteMatrices(nodeMatrices.data());
+				gInstanceBatcher.AddInstance(found->second, nodeMatrices.data());
+				if (i > start)  draw.runLength = 0;
+			}
+		}
+		start = end;
+	}
+}
 
-	// Render lit models, only change textures for each one
-	gD3DContext->PSSetSamplers(0, 1, &gAnisotropic4xSampler);
 
+// Build and sort the draws of the scene as seen from the given camera
+void BuildRenderQueue(Camera* camera)
+{
+	PROFILE_ZONE("BuildRenderQueue");
+
+	gSceneDraws.clear();
+	gRenderQueue.Clear();
+
+	// Cull in the order of gCullBounds, the hidden crate field is left empty so it is never visible
+	gCullBounds.Clear();
+	for (auto object : gObjects)  gCullBounds.Add(object->mModel->WorldBounds());
+	for (int i = 0; i < NUM_LIGHTS; ++i)  gCullBounds.Add(gLights[i].model->WorldBounds());
+	gCullBounds.Add(gShowCrateField ? gCrateFieldBounds : EmptyBoundingBox());
+	gCullVisible.resize(gCullBounds.Size());
+	if (gFrustumCulling)
+	{
+		FrustumPlanes planes = FrustumPlanesFromMatrix(camera->ViewProjectionMatrix());
+		gCullVisibleCount = CullBoxes(planes, gCullBounds, gCullVisible.data(), gCullingThreads.get());
+		gCullTotalTested  += gCullBounds.Size();
+		gCullTotalVisible += gCullVisibleCount;
+	}
+	else
+	{
+		std::fill(gCullVisible.begin(), gCullVisible.end(), static_cast<uint8_t>(1));
+		gCullVisibleCount = gCullBounds.Size();
+	}
+	const uint8_t* objectVisible = gCullVisible.data();
+	const uint8_t* lightVisible  = objectVisible + gObjects.size();
+	bool crateFieldVisible = gShowCrateField && lightVisible[NUM_LIGHTS];
+
+	CVector3 cameraPosition = camera->Position();
 	for (int i = 0; i < gObjects.size(); i++)
 	{
-		gD3DContext->PSSetShaderResources(0, 1, &gObjects[i]->mTexture); // First parameter must match texture slot number in the shader
-		gObjects[i]->mModel->Render();
+		if (!objectVisible[i])  continue;
+		AddModelDraw(RenderPass::Opaque, SceneShader::PixelLighting, gObjects[i]->mModel, gObjects[i]->mTexture,
+		             { 1, 1, 1 }, i, cameraPosition);
+	}
+	if (crateFieldVisible)
+	{
+		AddSceneDraw(RenderPass::Opaque, SceneShader::PixelLighting, gCrateMesh, gCrateFieldCentre, cameraPosition,
+		             { nullptr, gCrateDiffuseSpecularMapSRV, { 1, 1, 1 }, -1, gCrateFieldSet, 1 });
 	}
 
-	////--------------- Render sky ---------------////
+	// Using a pixel shader that tints the texture - don't need a tint on the sky so set it to white
+	AddModelDraw(RenderPass::Sky, SceneShader::TintedTexture, gStars, gStarsDiffuseSpecularMapSRV, { 1, 1, 1 }, -1, cameraPosition);
 
-	// Select which shaders to use next
-	gD3DContext->VSSetShader(gBasicTransformVertexShader, nullptr, 0);
-	gD3DContext->PSSetShader(gTintedTexturePixelShader, nullptr, 0);
+	for (int i = 0; i < NUM_LIGHTS; ++i)
+	{
+		if (!lightVisible[i])  continue;
+		AddModelDraw(RenderPass::Blended, SceneShader::TintedTexture, gLights[i].model, gLightDiffuseMapSRV,
+		             gLights[i].colour, -1, cameraPosition);
+	}
 
-	// Using a pixel shader that tints the texture - don't need a tint on the sky so set it to white
-	gPerModelConstants.objectColour = { 1, 1, 1 };
+	gRenderQueue.Sort();
+	BatchRenderQueueRuns();
+}
 
-	// Stars point inwards
-	gD3DContext->RSSetState(gCullNoneState);
 
-	// Render sky
-	gD3DContext->PSSetShaderResources(0, 1, &gStarsDiffuseSpecularMapSRV);
-	gStars->Render();
+// Select the states for a pass of the render queue
+static void SelectScenePassStates(RenderPass pass)
+{
+	if (pass == RenderPass::Opaque)
+	{
+		// No blending, normal depth buffer and back-face culling (standard set-up for opaque models)
+		gD3DContext->OMSetBlendState(gNoBlendingState, nullptr, 0xffffff);
+		gD3DContext->OMSetDepthStencilState(gUseDepthBufferState, 0);
+		gD3DContext->RSSetState(gCullBackState);
+	}
+	else if (pass == RenderPass::Sky)
+	{
+		// Stars point inwards
+		gD3DContext->OMSetBlendState(gNoBlendingState, nullptr, 0xffffff);
+		gD3DContext->OMSetDepthStencilState(gUseDepthBufferState, 0);
+		gD3DContext->RSSetState(gCullNoneState);
+	}
+	else
+	{
+		// Additive blending, read-only depth buffer and no culling (standard set-up for blending)
+		gD3DContext->OMSetBlendState(gAdditiveBlendingState, nullptr, 0xffffff);
+		gD3DContext->OMSetDepthStencilState(gDepthReadOnlyState, 0);
+		gD3DContext->RSSetState(gCullNoneState);
+	}
+}
+
+// Select the shaders for a draw of the render queue. Only opaque models are drawn instanced
+static void SelectSceneShaders(SceneShader shader, bool instanced)
+{
+	if (shader == SceneShader::PixelLighting)
+	{
+		gD3DContext->VSSetShader(instanced ? gPixelLightingInstancedVertexShader : gPixelLightingVertexShader, nullptr, 0);
+		gD3DContext->PSSetShader(gPixelLightingPixelShader, nullptr, 0);
+	}
+	else
+	{
+		gD3DContext->VSSetShader(gBasicTransformVertexShader, nullptr, 0);
+		gD3DContext->PSSetShader(gTintedTexturePixelShader, nullptr, 0);
+	}
+}
 
 
+// Render everything in the scene from the given camera. The render queue must have been built for the same camera
+void RenderSceneFromCamera(Camera* camera)
+{
+	PROFILE_ZONE("RenderSceneFromCamera");
 
-	////--------------- Render lights ---------------////
+	// Set camera matrices in the constant buffer and send over to GPU
+	gPerFrameConstants.cameraMatrix = camera->WorldMatrix();
+	gPerFrameConstants.viewMatrix = camera->ViewMatrix();
+	gPerFrameConstants.projectionMatrix = camera->ProjectionMatrix();
+	gPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
+	UpdateConstantBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
 
-	// Select which shaders to use next (actually same as before, so we could skip this)
-	gD3DContext->VSSetShader(gBasicTransformVertexShader, nullptr, 0);
-	gD3DContext->PSSetShader(gTintedTexturePixelShader, nullptr, 0);
+	// Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
+	gD3DContext->VSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer); // First parameter must match constant buffer number in the shader 
+	gD3DContext->GSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
+	gD3DContext->PSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
 
-	// Select the texture and sampler to use in the pixel shader
-	gD3DContext->PSSetShaderResources(0, 1, &gLightDiffuseMapSRV); // First parameter must match texture slot number in the shaer
+	gD3DContext->GSSetShader(nullptr, nullptr, 0);  // Switch off geometry shader when not using it (pass nullptr for first parameter)
+	gD3DContext->PSSetSamplers(0, 1, &gAnisotropic4xSampler);
 
-	// States - additive blending, read-only depth buffer and no culling (standard set-up for blending)
-	gD3DContext->OMSetBlendState(gAdditiveBlendingState, nullptr, 0xffffff);
-	gD3DContext->OMSetDepthStencilState(gDepthReadOnlyState, 0);
-	gD3DContext->RSSetState(gCullNoneState);
+	////--------------- Render the queue: opaque models front to back, then the sky, then the lights back to front ---------------////
 
-	// Render all the lights in the array
-	for (int i = 0; i < NUM_LIGHTS; ++i)
+	// Bind states, shaders and textures only when they differ from the draw before
+	bool first = true;
+	RenderPass boundPass = RenderPass::Opaque;
+	int        boundShader = 0;
+	bool       boundInstanced = false;
+	ID3D11ShaderResourceView* boundTexture = nullptr;
+	for (const RenderQueueItem& item : gRenderQueue)
 	{
-		gPerModelConstants.objectColour = gLights[i].colour; // Set any per-model constants apart from the world matrix just before calling render (light colour here)
-		gLights[i].model->Render();
+		const SceneDraw& draw = gSceneDraws[item.draw];
+		if (draw.runLength == 0)  continue; // Drawn instanced with the first draw of its run
+
+		RenderPass pass = SortKeyPass(item.key);
+		int shader = SortKeyShader(item.key);
+		bool instanced = (draw.instanceSet >= 0);
+		if (first || pass != boundPass)  SelectScenePassStates(pass);
+		if (first || shader != boundShader || instanced != boundInstanced)
+		{
+			SelectSceneShaders(static_cast<SceneShader>(shader), instanced);
+		}
+		if (first || draw.texture != boundTexture)
+		{
+			gD3DContext->PSSetShaderResources(0, 1, &draw.texture); // First parameter must match texture slot number in the shader
+		}
+		first = false;
+		boundPass      = pass;
+		boundShader    = shader;
+		boundInstanced = instanced;
+		boundTexture   = draw.texture;
+
+		if (instanced)
+		{
+			gInstanceBatcher.Render(draw.instanceSet); // A set whose matrices can't be sent is left out of the frame
+		}
+		else
+		{
+			gPerModelConstants.objectColour = draw.colour; // Set any per-model constants apart from the world matrix just before calling render
+			draw.model->Render();
+		}
 	}
 }
 
 void RenderSceneNormalsAndDepth(ID3D11RenderTargetView* renderTarget)
 {
+	PROFILE_ZONE("RenderSceneNormalsAndDepth");
+
 	////--------------- Render depths and normals of each pixel to use in post-processing ---------------////
 	
 	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
@@ -798,15 +1129,30 @@ void RenderSceneNormalsAndDepth(ID3D11RenderTargetView* renderTarget)
 	gD3DContext->OMSetDepthStencilState(gUseDepthBufferState, 0);
 	gD3DContext->RSSetState(gCullBackState);
 
-	// Render the models with depth
-	for (int i = 0; i < gObjects.size(); i++)
+	// Render the opaque models with depth, in the order of the render queue so they are drawn front to back. Instance
+	// sets were sent to the GPU for the colour pass so are only drawn here
+	bool instancedShader = false;
+	for (const RenderQueueItem& item : gRenderQueue)
 	{
-		gObjects[i]->mModel->Render();
+		const SceneDraw& draw = gSceneDraws[item.draw];
+		if (SortKeyPass(item.key) != RenderPass::Opaque || draw.runLength == 0)  continue;
+
+		bool instanced = (draw.instanceSet >= 0);
+		if (instanced != instancedShader)
+		{
+			gD3DContext->VSSetShader(instanced ? gNormalDepthInstancedVertexShader : gNormalDepthVertexShader, nullptr, 0);
+			instancedShader = instanced;
+		}
+
+		if (instanced)  gInstanceBatcher.Render(draw.instanceSet);
+		else            draw.model->Render();
 	}
 }
 
-void RenderFocusedObject()
+void RenderFocusedObject(ID3D11RenderTargetView* renderTarget)
 {
+	PROFILE_ZONE("RenderFocusedObject");
+
 	if (gFocusedObject == 0)
 	{
 		return;
@@ -816,8 +1162,8 @@ void RenderFocusedObject()
 
 	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
 	gD3DContext->ClearDepthStencilView(gDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
-	gD3DContext->ClearRenderTargetView(gFocusedObjectRenderTarget, &gNDBackgroundColor.r);
-	gD3DContext->OMSetRenderTargets(1, &gFocusedObjectRenderTarget, gDepthStencil);
+	gD3DContext->ClearRenderTargetView(renderTarget, &gNDBackgroundColor.r);
+	gD3DContext->OMSetRenderTargets(1, &renderTarget, gDepthStencil);
 
 	// Shaders
 	gD3DContext->VSSetShader(gNormalDepthVertexShader, nullptr, 0);
@@ -828,8 +1174,11 @@ void RenderFocusedObject()
 	gD3DContext->OMSetDepthStencilState(gNoDepthBufferState, 0);
 	gD3DContext->RSSetState(gCullNoneState);
 
-	// Render the models with depth
-	gObjects[gFocusedObject]->mModel->Render();
+	// Render the focused object with depth, found in the render queue. Rendered alone even if it is in an instanced run
+	for (const RenderQueueItem& item : gRenderQueue)
+	{
+		if (gSceneDraws[item.draw].object == gFocusedObject)  gSceneDraws[item.draw].model->Render();
+	}
 }
 
 //**************************
@@ -840,175 +1189,228 @@ void SelectPostProcessShaderAndTextures(PostProcessType postProcess)
 {
 	if (postProcess == PostProcessType::Copy)
 	{
-		gD3DContext->PSSetShader(gCopyPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gCopyPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::Gradient)
 	{
-		gD3DContext->PSSetShader(gGradientPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gGradientPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::BlurY)
 	{
-		gD3DContext->PSSetShader(gBlurYPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gBlurYPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::BlurX)
 	{
-		gD3DContext->PSSetShader(gBlurXPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gBlurXPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::Underwater)
 	{
-		gD3DContext->PSSetShader(gUnderwaterPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gUnderwaterPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::DepthOfField)
 	{
-		gD3DContext->PSSetShader(gDepthOfFieldPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gDepthOfFieldPostProcess);
 
-		gD3DContext->PSSetShaderResources(1, 1, &gCurrentNormalDepthTextureSRV);
+		gStateFilter.SetShaderResource(1, gCurrentNormalDepthTextureSRV);
 	}
 
 	else if (postProcess == PostProcessType::Retro)
 	{
-		gD3DContext->PSSetShader(gRetroPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gRetroPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::Bloom)
 	{
-		gD3DContext->PSSetShader(gBloomPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gBloomPostProcess);
 
-		gD3DContext->PSSetShaderResources(1, 1, &gCurrentBloomTextureSRV);
+		gStateFilter.SetShaderResource(1, gCurrentBloomTextureSRV);
 	}
 
 	else if (postProcess == PostProcessType::Brightness)
 	{
-		gD3DContext->PSSetShader(gBrightnessPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gBrightnessPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::DirectionalBlur)
 	{
-		gD3DContext->PSSetShader(gDirectionalBlurPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gDirectionalBlurPostProcess);
+	}
+
+	else if (postProcess == PostProcessType::BloomPrefilter)
+	{
+		gStateFilter.SetPixelShader(gBloomPrefilterPostProcess);
+		gStateFilter.SetSampler(1, gBilinearClampSampler);
+	}
+
+	else if (postProcess == PostProcessType::BloomDownsample)
+	{
+		gStateFilter.SetPixelShader(gBloomDownsamplePostProcess);
+		gStateFilter.SetSampler(1, gBilinearClampSampler);
+	}
+
+	else if (postProcess == PostProcessType::BloomUpsample)
+	{
+		gStateFilter.SetPixelShader(gBloomUpsamplePostProcess);
+		gStateFilter.SetSampler(1, gBilinearClampSampler);
 	}
 
 	else if (postProcess == PostProcessType::HueShift)
 	{
-		gD3DContext->PSSetShader(gHueShiftPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gHueShiftPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::ChromaticAberration)
 	{
-		gD3DContext->PSSetShader(gChromaticAberrationPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gChromaticAberrationPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::Outline)
 	{
-		gD3DContext->PSSetShader(gOutlinePostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gOutlinePostProcess);
 
-		gD3DContext->PSSetShaderResources(1, 1, &gCurrentNormalDepthTextureSRV);
+		gStateFilter.SetShaderResource(1, gCurrentNormalDepthTextureSRV);
 	}
 
 	else if (postProcess == PostProcessType::Dilation)
 	{
-		gD3DContext->PSSetShader(gDilationPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gDilationPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::FrostedGlass)
 	{
-		gD3DContext->PSSetShader(gFrostedGlassPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gFrostedGlassPostProcess);
 
-		gD3DContext->PSSetShaderResources(1, 1, &gNoiseMapSRV2);
-		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
+		gStateFilter.SetShaderResource(1, gNoiseMapSRV2);
+		gStateFilter.SetSampler(1, gTrilinearSampler);
 	}
 
 	else if (postProcess == PostProcessType::Selection)
 	{
-		gD3DContext->PSSetShader(gSelectionPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gSelectionPostProcess);
 
-		gD3DContext->PSSetShaderResources(1, 1, &gCurrentNormalDepthTextureSRV);
-		gD3DContext->PSSetShaderResources(2, 1, &gCurrentFocusedObjectTextureSRV);
+		gStateFilter.SetShaderResource(1, gCurrentNormalDepthTextureSRV);
+		gStateFilter.SetShaderResource(2, gCurrentFocusedObjectTextureSRV);
 	}
 
 	else if (postProcess == PostProcessType::Tint)
 	{
-		gD3DContext->PSSetShader(gTintPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gTintPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::GreyNoise)
 	{
-		gD3DContext->PSSetShader(gGreyNoisePostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gGreyNoisePostProcess);
 
 		// Give pixel shader access to the noise texture
-		gD3DContext->PSSetShaderResources(1, 1, &gNoiseMapSRV);
-		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
+		gStateFilter.SetShaderResource(1, gNoiseMapSRV);
+		gStateFilter.SetSampler(1, gTrilinearSampler);
 	}
 
 	else if (postProcess == PostProcessType::Burn)
 	{
-		gD3DContext->PSSetShader(gBurnPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gBurnPostProcess);
 
 		// Give pixel shader access to the burn texture (basically a height map that the burn level ascends)
-		gD3DContext->PSSetShaderResources(1, 1, &gBurnMapSRV);
-		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
+		gStateFilter.SetShaderResource(1, gBurnMapSRV);
+		gStateFilter.SetSampler(1, gTrilinearSampler);
 	}
 
 	else if (postProcess == PostProcessType::Distort)
 	{
-		gD3DContext->PSSetShader(gDistortPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gDistortPostProcess);
 
 		// Give pixel shader access to the distortion texture (containts 2D vectors (in R & G) to shift the texture UVs to give a cut-glass impression)
-		gD3DContext->PSSetShaderResources(1, 1, &gDistortMapSRV);
-		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
+		gStateFilter.SetShaderResource(1, gDistortMapSRV);
+		gStateFilter.SetSampler(1, gTrilinearSampler);
 	}
 
 	else if (postProcess == PostProcessType::Spiral)
 	{
-		gD3DContext->PSSetShader(gSpiralPostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gSpiralPostProcess);
 	}
 
 	else if (postProcess == PostProcessType::HeatHaze)
 	{
-		gD3DContext->PSSetShader(gHeatHazePostProcess, nullptr, 0);
+		gStateFilter.SetPixelShader(gHeatHazePostProcess);
 	}
 }
 
 
-void PostProcessSetup(ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, ID3D11BlendState* blendState)
+// Bind everything a post-process pass uses besides its shader and textures. The calls go through gStateFilter, so only
+// what differs from the last pass is sent to the device
+void PostProcessSetup(ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, ID3D11BlendState* blendState,
+                      ID3D11DepthStencilView* depthStencil = gDepthStencil, ID3D11VertexShader* vertexShader = g2DQuadVertexShader)
 {
 	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-	gD3DContext->OMSetRenderTargets(1, &renderTarget, gDepthStencil);
+	gStateFilter.SetRenderTarget(renderTarget, depthStencil);
 
 	// Give the pixel shader (post-processing shader) access to the scene texture 
-	gD3DContext->PSSetShaderResources(0, 1, &srv);
+	gStateFilter.SetShaderResource(0, srv);
 
-	gD3DContext->PSSetSamplers(0, 1, &gPointSampler); // Use point sampling (no bilinear, trilinear, mip-mapping etc. for most post-processes)
+	gStateFilter.SetSampler(0, gPointSampler); // Use point sampling (no bilinear, trilinear, mip-mapping etc. for most post-processes)
 
 
-	// Using special vertex shader that creates its own data for a 2D screen quad
-	gD3DContext->VSSetShader(g2DQuadVertexShader, nullptr, 0);
-	gD3DContext->GSSetShader(nullptr, nullptr, 0);  // Switch off geometry shader when not using it (pass nullptr for first parameter)
+	// Using special vertex shader that creates its own data for a 2D screen quad (or polygon)
+	gStateFilter.SetVertexShader(vertexShader);
+	gStateFilter.SetGeometryShader(nullptr);  // Switch off geometry shader when not using it
 
 
 	// States - no blending, don't write to depth buffer and ignore back-face culling
-	gD3DContext->OMSetBlendState(blendState, nullptr, 0xffffff);
-	gD3DContext->OMSetDepthStencilState(gDepthReadOnlyState, 0);
-	gD3DContext->RSSetState(gCullNoneState);
+	gStateFilter.SetBlendState(blendState);
+	gStateFilter.SetDepthStencilState(gDepthReadOnlyState);
+	gStateFilter.SetRasterizerState(gCullNoneState);
 
 
 	// No need to set vertex/index buffer (see 2D quad vertex shader), just indicate that the quad will be created as a triangle strip
-	gD3DContext->IASetInputLayout(NULL); // No vertex data
-	gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	gStateFilter.SetInputLayout(nullptr); // No vertex data
+	gStateFilter.SetTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+}
+
+
+// Send the area set in gPostProcessingConstants to the shaders. Full screen passes share one buffer and each area or
+// polygon post-process has its own (areaOwner), so the area is only uploaded when it moves
+void SendPostProcessArea(const PostProcess* areaOwner)
+{
+	int buffer = gPostProcessConstants.Update(ConstantBlock::Area, areaOwner, gPostProcessingConstants);
+	ID3D11Buffer* constantBuffer = gPostProcessConstantBackend.Buffer(buffer);
+	gStateFilter.SetConstantBuffer(ShaderStage::Vertex, ConstantBlockRegister(ConstantBlock::Area), constantBuffer);
+	gStateFilter.SetConstantBuffer(ShaderStage::Pixel, ConstantBlockRegister(ConstantBlock::Area), constantBuffer);
+}
+
+// Send the blocks of settings a post-process's shader reads, only uploading each if it has changed. Uses the settings of
+// the given post-process if it has its own (PostProcess::Constants), otherwise the shared gPostProcessingConstants
+void SendPostProcessSettings(PostProcessType postProcess, const PostProcess* settings)
+{
+	bool ownSettings = (settings != nullptr && settings->Constants != nullptr);
+	for (ConstantBlock block : PostProcessConstantBlocks(postProcess))
+	{
+		int buffer = gPostProcessConstants.Update(block, ownSettings ? settings : nullptr,
+		                                          ownSettings ? *settings->Constants : gPostProcessingConstants);
+		ID3D11Buffer* constantBuffer = gPostProcessConstantBackend.Buffer(buffer);
+		gStateFilter.SetConstantBuffer(ShaderStage::Pixel, ConstantBlockRegister(block), constantBuffer);
+	}
 }
 
 
 // Perform a full-screen post process from "scene texture" to back buffer
-void FullScreenPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, ID3D11BlendState* blendState)
+// Pass a pixel shader to use in place of the post-process's own, e.g. for a fused post-process starting with this one.
+// Pass the post-process being run as settings to use its own settings if it has them
+void FullScreenPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, ID3D11BlendState* blendState,
+                           ID3D11PixelShader* pixelShader = nullptr, const PostProcess* settings = nullptr)
 {
 	PostProcessSetup(srv, renderTarget, blendState);
 
 	// Select shader and textures needed for the required post-processes (helper function above)
 	SelectPostProcessShaderAndTextures(postProcess);
+	if (pixelShader != nullptr)
+	{
+		gStateFilter.SetPixelShader(pixelShader);
+	}
 
 
 	// Set 2D area for full-screen post-processing (coordinates in 0->1 range)
@@ -1017,10 +1419,9 @@ void FullScreenPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView
 	gPostProcessingConstants.area2DDepth   = 0;        // Depth buffer value for full screen is as close as possible
 
 
-	// Pass over the above post-processing settings (also the per-process settings prepared in UpdateScene function below)
-	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
-	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
-	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
+	// Pass over the above area and the post-process's settings (prepared in UpdateScene function below) if they have changed
+	SendPostProcessArea(nullptr);
+	SendPostProcessSettings(postProcess, settings);
 
 
 	// Draw a quad
@@ -1029,8 +1430,10 @@ void FullScreenPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView
 
 
 // Perform an area post process from "scene texture" to back buffer at a given point in the world, with a given size (world units)
+// The area is kept in areaOwner's own buffer. Pass the post-process being run as settings to use its own settings if it has them
 void AreaPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, 
-					 ID3D11BlendState* blendState, CVector3 worldPoint, CVector2 areaSize)
+					 ID3D11BlendState* blendState, CVector3 worldPoint, CVector2 areaSize,
+					 const PostProcess* areaOwner, const PostProcess* settings = nullptr)
 {
 	PostProcessSetup(srv, renderTarget, blendState);
 
@@ -1073,9 +1476,8 @@ void AreaPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv,
 	gPostProcessingConstants.area2DDepth /= areaDistance;
 
 	// Pass over this post-processing area to shaders (also sends the per-process settings prepared in UpdateScene function below)
-	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
-	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
-	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
+	SendPostProcessArea(areaOwner);
+	SendPostProcessSettings(postProcess, settings);
 
 
 	// Draw a quad
@@ -1084,31 +1486,27 @@ void AreaPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv,
 
 
 // Perform an post process from "scene texture" to back buffer within the given four-point polygon and a world matrix to position/rotate/scale the polygon
+// The polygon is kept in areaOwner's own buffer. Pass the post-process being run as settings to use its own settings if it has them
 void PolygonPostProcess(PostProcessType postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget, ID3D11BlendState* blendState, 
-						const std::array<CVector3, 4>& points, const CMatrix4x4& worldMatrix)
+						const std::array<CVector3, 4>& points, const CMatrix4x4& worldMatrix,
+						const PostProcess* areaOwner, const PostProcess* settings = nullptr)
 {
-	PostProcessSetup(srv, renderTarget, blendState);
+	// Select the special 2D polygon post-processing vertex shader
+	PostProcessSetup(srv, renderTarget, blendState, gDepthStencil, g2DPolygonVertexShader);
 
 	// Select shader/textures needed for required post-process
 	SelectPostProcessShaderAndTextures(postProcess);
 
-	// Loop through the given points, transform each to 2D (this is what the vertex shader normally does in most labs)
-	for (unsigned int i = 0; i < points.size(); ++i)
-	{
-		CVector4 modelPosition = CVector4(points[i], 1);
-		CVector4 worldPosition = modelPosition * worldMatrix;
-		CVector4 viewportPosition = worldPosition * gCamera->ViewProjectionMatrix();
-
-		gPostProcessingConstants.polygon2DPoints[i] = viewportPosition;
-	}
+	// Transform the given points to 2D (this is what the vertex shader normally does in most labs)
+	CVector4 worldPoints[4];
+	TransformPoints(points.data(), worldPoints, 4, worldMatrix);
+	Transform(worldPoints, gPostProcessingConstants.polygon2DPoints, 4, gCamera->ViewProjectionMatrix());
 
 	// Pass over the polygon points to the shaders (also sends the per-process settings prepared in UpdateScene function below)
-	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
-	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
-	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
+	SendPostProcessArea(areaOwner);
+	SendPostProcessSettings(postProcess, settings);
 
-	// Select the special 2D polygon post-processing vertex shader and draw the polygon
-	gD3DContext->VSSetShader(g2DPolygonVertexShader, nullptr, 0);
+	// Draw the polygon
 	gD3DContext->Draw(4, 0);
 }
 
@@ -1120,58 +1518,134 @@ void UpdateBloomEffectDirection(float directionOffset)
 	gPostProcessingConstants.directionalBlurY = sin(gTempTimer + directionOffset);
 }
 
-void RenderBloomTexture(ID3D11ShaderResourceView* srv)
+// Set the viewport to cover a render target of the given size
+void SetViewport(int width, int height)
 {
-	auto bloomSRV = srv;
-	auto bloomRT = gTempRenderTarget2;
+	D3D11_VIEWPORT vp;
+	vp.Width = static_cast<FLOAT>(width);
+	vp.Height = static_cast<FLOAT>(height);
+	vp.MinDepth = 0.0f;
+	vp.MaxDepth = 1.0f;
+	vp.TopLeftX = 0;
+	vp.TopLeftY = 0;
+	gD3DContext->RSSetViewports(1, &vp);
+}
 
-	FullScreenPostProcess(PostProcessType::Brightness, bloomSRV, bloomRT, gNoBlendingState);
+// Perform a full-screen post process into one of the bloom pyramid levels, or the full size bloom texture for the last pass.
+// The pyramid levels are smaller than the depth buffer so it is not bound
+void BloomPyramidPass(PostProcessType postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget,
+					  ID3D11BlendState* blendState, int width, int height)
+{
+	PostProcessSetup(srv, renderTarget, blendState, nullptr);
+	SetViewport(width, height);
 
-	bloomSRV = gTempTextureSRV2;
-	bloomRT = gTempRenderTarget;
+	SelectPostProcessShaderAndTextures(postProcess);
 
-	FullScreenPostProcess(PostProcessType::BlurY, bloomSRV, bloomRT, gNoBlendingState);
+	gPostProcessingConstants.area2DTopLeft = { 0, 0 };
+	gPostProcessingConstants.area2DSize    = { 1, 1 };
+	gPostProcessingConstants.area2DDepth   = 0;
+	SendPostProcessArea(nullptr);
+	SendPostProcessSettings(postProcess, nullptr);
 
-	bloomSRV = gTempTextureSRV;
-	bloomRT = gTempRenderTarget2;
+	gD3DContext->Draw(4, 0);
+}
 
-	FullScreenPostProcess(PostProcessType::BlurX, bloomSRV, bloomRT, gNoBlendingState);
+// Render the bloom texture with a pyramid of smaller textures (BloomMode::Pyramid). Only the first pass reads the full
+// size scene and only the last writes a full size texture. Each level is handed back to the pool once added to the
+// level above
+void RenderBloomPyramid(ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* bloomRenderTarget)
+{
+	// 16-bit float levels so they can be added together without being clamped to 1
+	int levels[BLOOM_PYRAMID_LEVELS];
+	for (int level = 0; level < BLOOM_PYRAMID_LEVELS; ++level)
+	{
+		levels[level] = gRenderTargetPool.Acquire({ BloomLevelSize(gViewportWidth, level), BloomLevelSize(gViewportHeight, level),
+		                                            TextureFormat::RGBA16Float });
+	}
 
-	for (int j = 0; j < gTempDiagonalBlurs; j++)
+	// Take the bright areas at half size, then keep halving down to the smallest level
+	for (int level = 0; level < BLOOM_PYRAMID_LEVELS; ++level)
 	{
-		UpdateBloomEffectDirection((float)j * (PI / gTempDiagonalBlurs));
+		BloomPyramidPass(level == 0 ? PostProcessType::BloomPrefilter : PostProcessType::BloomDownsample,
+						 level == 0 ? srv : gRenderTargetBackend.SRV(levels[level - 1]), gRenderTargetBackend.RenderTarget(levels[level]),
+						 gNoBlendingState, BloomLevelSize(gViewportWidth, level), BloomLevelSize(gViewportHeight, level));
+	}
 
-		FullScreenPostProcess(PostProcessType::DirectionalBlur, bloomSRV, bloomRT, gAdditiveBlendingState);
+	// Optional streaks, read from one level and added to the level above it. The final pass scales the sum of the levels
+	// back down, so scale the streaks up to match
+	if (gTempDiagonalBlurs > 0)
+	{
+		float streakIntensity = gPostProcessingConstants.directionalBlurIntensity;
+		gPostProcessingConstants.directionalBlurIntensity *= BLOOM_PYRAMID_LEVELS;
+		for (int j = 0; j < gTempDiagonalBlurs; j++)
+		{
+			UpdateBloomEffectDirection((float)j * (PI / gTempDiagonalBlurs));
+			BloomPyramidPass(PostProcessType::DirectionalBlur, gRenderTargetBackend.SRV(levels[BLOOM_STREAK_LEVEL]),
+							 gRenderTargetBackend.RenderTarget(levels[BLOOM_STREAK_LEVEL - 1]), gAdditiveBlendingState,
+							 BloomLevelSize(gViewportWidth, BLOOM_STREAK_LEVEL - 1), BloomLevelSize(gViewportHeight, BLOOM_STREAK_LEVEL - 1));
+		}
+		gPostProcessingConstants.directionalBlurIntensity = streakIntensity;
 	}
 
-	bloomSRV = gTempTextureSRV2;
-	bloomRT = gTempRenderTarget;
+	// Add each level to the one above it, working back up the pyramid
+	gPostProcessingConstants.bloomLevelScale = 1.0f;
+	for (int level = BLOOM_PYRAMID_LEVELS - 2; level >= 0; --level)
+	{
+		BloomPyramidPass(PostProcessType::BloomUpsample, gRenderTargetBackend.SRV(levels[level + 1]), gRenderTargetBackend.RenderTarget(levels[level]),
+						 gAdditiveBlendingState, BloomLevelSize(gViewportWidth, level), BloomLevelSize(gViewportHeight, level));
+		gRenderTargetPool.Release(levels[level + 1]);
+	}
 
-	gCurrentBloomTextureSRV = bloomSRV;
+	// Up to full size, bringing the sum of the levels back to the range of a single level
+	gPostProcessingConstants.bloomLevelScale = 1.0f / BLOOM_PYRAMID_LEVELS;
+	BloomPyramidPass(PostProcessType::BloomUpsample, gRenderTargetBackend.SRV(levels[0]), bloomRenderTarget, gNoBlendingState, gViewportWidth, gViewportHeight);
+	gRenderTargetPool.Release(levels[0]);
 }
 
-void ApplyPostProcess(PostProcess* postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget)
+// Render a texture that shows blurred bright areas of the scene into bloomRenderTarget, using a temporary texture from the pool
+void RenderBloomTexture(ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* bloomRenderTarget, ID3D11ShaderResourceView* bloomSRV)
 {
-	if (postProcess->Type == PostProcessType::Selection && gFocusedObject <= 0)
+	PROFILE_ZONE("RenderBloomTexture", BloomModeName(gBloomMode));
+
+	if (gBloomMode == BloomMode::Pyramid)
 	{
+		RenderBloomPyramid(srv, bloomRenderTarget);
 		return;
 	}
 
-	if (postProcess->Type == PostProcessType::Bloom)
+	int tempTexture = gRenderTargetPool.Acquire(ViewportTextureDesc());
+	auto tempRT  = gRenderTargetBackend.RenderTarget(tempTexture);
+	auto tempSRV = gRenderTargetBackend.SRV(tempTexture);
+
+	FullScreenPostProcess(PostProcessType::Brightness, srv, bloomRenderTarget, gNoBlendingState);
+	FullScreenPostProcess(PostProcessType::BlurY, bloomSRV, tempRT, gNoBlendingState);
+	FullScreenPostProcess(PostProcessType::BlurX, tempSRV, bloomRenderTarget, gNoBlendingState);
+
+	for (int j = 0; j < gTempDiagonalBlurs; j++)
 	{
-		// Render a texture that shows blurred bright areas to use in the bloom post-process.
-		RenderBloomTexture(srv);
+		UpdateBloomEffectDirection((float)j * (PI / gTempDiagonalBlurs));
+
+		FullScreenPostProcess(PostProcessType::DirectionalBlur, tempSRV, bloomRenderTarget, gAdditiveBlendingState);
 	}
 
+	gRenderTargetPool.Release(tempTexture);
+}
+
+// Run a post-process from srv to renderTarget in its mode. The bloom texture must already be rendered for Bloom
+void ApplyPostProcess(const PostProcess* postProcess, ID3D11ShaderResourceView* srv, ID3D11RenderTargetView* renderTarget)
+{
+	PROFILE_ZONE("ApplyPostProcess", PostProcessTypeName(postProcess->Type), PostProcessModeName(postProcess->Mode));
+
 	if (postProcess->Mode == PostProcessMode::Fullscreen)
 	{
-		FullScreenPostProcess(postProcess->Type, srv, renderTarget, gNoBlendingState);
+		FullScreenPostProcess(postProcess->Type, srv, renderTarget, gNoBlendingState, nullptr, postProcess);
 	}
 
 	else if (postProcess->Mode == PostProcessMode::Area)
 	{
 		// Pass a 3D point for the centre of the affected area and the size of the (rectangular) area in world units
-		AreaPostProcess(postProcess->Type, srv, renderTarget, gAlphaBlendingState, gLights[0].model->Position(), { 10, 10 });
+		AreaPostProcess(postProcess->Type, srv, renderTarget, gAlphaBlendingState, gLights[0].model->Position(), { 10, 10 },
+		                postProcess, postProcess);
 	}
 
 	else if (postProcess->Mode == PostProcessMode::Polygon)
@@ -1179,14 +1653,158 @@ void ApplyPostProcess(PostProcess* postProcess, ID3D11ShaderResourceView* srv, I
 		// Pass an array of 4 points and a matrix. Only supports 4 points.
 		if (postProcess->PolyData != nullptr)
 		{
-			PolygonPostProcess(postProcess->Type, srv, renderTarget, gNoBlendingState, postProcess->PolyData->Points, postProcess->PolyData->Matrix);
+			PolygonPostProcess(postProcess->Type, srv, renderTarget, gNoBlendingState, postProcess->PolyData->Points, postProcess->PolyData->Matrix,
+			                   postProcess, postProcess);
 		}
 	}
 }
 
+
+// Runs the steps of the post-processing graph on the GPU. Each slot of each image takes a texture from the pool the first
+// time it is used and hands it back after the step that last uses it
+class GPUPostProcessBackend : public PostProcessGraphBackend
+{
+public:
+	GPUPostProcessBackend()
+	{
+		for (auto& imageTextures : mTextures)  imageTextures[0] = imageTextures[1] = -1;
+	}
+
+	// Views of the texture for a slot of an image, taken from the pool if the slot has none yet
+	ID3D11ShaderResourceView* SRV(GraphImage image, int slot)          { return gRenderTargetBackend.SRV(Texture(image, slot)); }
+	ID3D11RenderTargetView*   RenderTarget(GraphImage image, int slot) { return gRenderTargetBackend.RenderTarget(Texture(image, slot)); }
+
+	// Hand back the textures of every slot to the pool
+	void ReleaseTextures()
+	{
+		for (auto& imageTextures : mTextures)
+		{
+			for (int& texture : imageTextures)
+			{
+				gRenderTargetPool.Release(texture);
+				texture = -1;
+			}
+		}
+	}
+
+	void RunPass(const GraphStep& step) override
+	{
+		// Render a texture that shows blurred bright areas to use in the bloom post-process
+		if (step.image == GraphImage::Bloom)
+		{
+			RenderBloomTexture(SRV(GraphImage::Scene, step.slots[static_cast<int>(GraphImage::Scene)]),
+			                   RenderTarget(GraphImage::Bloom, 0), SRV(GraphImage::Bloom, 0));
+			ReleaseLastUses(step);
+			return;
+		}
+
+		if (step.numStages > 1)
+		{
+			RunFusedPass(step);
+			ReleaseLastUses(step);
+			return;
+		}
+
+		// Other images are read from their current slots
+		gCurrentNormalDepthTextureSRV   = ReadSRV(step, GraphImage::NormalDepth);
+		gCurrentFocusedObjectTextureSRV = ReadSRV(step, GraphImage::Focus);
+		gCurrentBloomTextureSRV         = ReadSRV(step, GraphImage::Bloom);
+		ApplyPostProcess(step.postProcess, SRV(step.image, step.source), RenderTarget(step.image, step.target));
+		ReleaseLastUses(step);
+	}
+
+	void Copy(const GraphStep& step) override
+	{
+		auto srv = SRV(step.image, step.source);
+		auto renderTarget = RenderTarget(step.image, step.target);
+		if (step.type == GraphStepType::Copy || step.postProcess->Mode == PostProcessMode::Fullscreen)
+		{
+			FullScreenPostProcess(PostProcessType::Copy, srv, renderTarget, gNoBlendingState);
+		}
+		else if (step.postProcess->Mode == PostProcessMode::Area)
+		{
+			// Same area as ApplyPostProcess uses, so the copy covers exactly the pixels the pass wrote
+			AreaPostProcess(PostProcessType::Copy, srv, renderTarget, gNoBlendingState, gLights[0].model->Position(), { 10, 10 },
+			                step.postProcess);
+		}
+		else
+		{
+			PolygonPostProcess(PostProcessType::Copy, srv, renderTarget, gNoBlendingState,
+			                   step.postProcess->PolyData->Points, step.postProcess->PolyData->Matrix, step.postProcess);
+		}
+		ReleaseLastUses(step);
+	}
+
+private:
+	int Texture(GraphImage image, int slot)
+	{
+		int& texture = mTextures[static_cast<int>(image)][slot];
+		if (texture < 0)  texture = gRenderTargetPool.Acquire(ViewportTextureDesc());
+		return texture;
+	}
+
+	// Current slot of an image a pass reads, nullptr if it doesn't read it
+	ID3D11ShaderResourceView* ReadSRV(const GraphStep& step, GraphImage image)
+	{
+		if ((step.reads & GraphImageBit(image)) == 0)  return nullptr;
+		return SRV(image, step.slots[static_cast<int>(image)]);
+	}
+
+	void ReleaseLastUses(const GraphStep& step)
+	{
+		for (int image = 0; image < NUM_GRAPH_IMAGES; ++image)
+		{
+			for (int slot = 0; slot < 2; ++slot)
+			{
+				int& texture = mTextures[image][slot];
+				if ((step.lastUses & GraphSlotBit(static_cast<GraphImage>(image), slot)) && texture >= 0)
+				{
+					gRenderTargetPool.Release(texture);
+					texture = -1;
+				}
+			}
+		}
+	}
+
+	// Run fused post-processes in one pass with a shader generated for them. The textures the first post-process needs
+	// are bound, the others only use the scene. If the shader did not compile, run each post-process in turn, switching
+	// between a temporary texture and the target so the last one writes to the target
+	void RunFusedPass(const GraphStep& step)
+	{
+		PROFILE_ZONE("FusedPostProcess", PostProcessTypeName(step.stages[0]->Type));
+
+		auto srv = SRV(step.image, step.source);
+		auto renderTarget = RenderTarget(step.image, step.target);
+
+		ID3D11PixelShader* fusedShader = FusedPostProcessShader(FusedShaderSource(step.stages, step.numStages));
+		if (fusedShader != nullptr)
+		{
+			// Each stage reads its settings from its own register, the first stage's are sent with the pass
+			for (int i = 1; i < step.numStages; ++i)  SendPostProcessSettings(step.stages[i]->Type, step.stages[i]);
+			FullScreenPostProcess(step.stages[0]->Type, srv, renderTarget, gNoBlendingState, fusedShader, step.stages[0]);
+			return;
+		}
+
+		int tempTexture = gRenderTargetPool.Acquire(ViewportTextureDesc());
+		for (int i = 0; i < step.numStages; ++i)
+		{
+			bool toTarget = ((step.numStages - 1 - i) % 2 == 0);
+			FullScreenPostProcess(step.stages[i]->Type, srv, toTarget ? renderTarget : gRenderTargetBackend.RenderTarget(tempTexture), gNoBlendingState,
+			                      nullptr, step.stages[i]);
+			srv = toTarget ? SRV(step.image, step.target) : gRenderTargetBackend.SRV(tempTexture);
+		}
+		gRenderTargetPool.Release(tempTexture);
+	}
+
+	// Pool texture of each slot of each image, -1 for none
+	int mTextures[NUM_GRAPH_IMAGES][2];
+};
+
 // Rendering the scene
 void RenderScene()
 {
+	PROFILE_ZONE("RenderScene");
+
 	//// Common settings ////
 
 	// Set up the light information in the constant buffer
@@ -1207,11 +1825,24 @@ void RenderScene()
 
 	////--------------- Main scene rendering ---------------////
 
+	// Declare the post-processes, polygon effects first. The graph works out which textures each one reads and writes and
+	// adds copies only where an area or polygon effect needs the rest of its target to match its source
+	bool useFocus = (gFocusedObject > 0);
+	gPostProcessGraph.Clear();
+	gPostProcessGraph.SetFusion(gFusePostProcesses);
+	gPostProcessGraph.AddPostProcesses(gPolygonPostProcesses, useFocus);
+	gPostProcessGraph.AddPostProcesses(gFullScreenPostProcesses, useFocus);
+	gPostProcessGraph.Compile();
+
+	// Textures for the graph's images are taken from the pool as they are needed
+	GPUPostProcessBackend postProcessBackend;
+
 	// Set the target for rendering and select the main depth buffer.
 	// If using post-processing then render to the scene texture, otherwise to the usual back buffer
 	// Also clear the render target to a fixed colour and the depth buffer to the far distance
-	gD3DContext->OMSetRenderTargets(1, &gSceneRenderTarget, gDepthStencil);
-	gD3DContext->ClearRenderTargetView(gSceneRenderTarget, &gNDBackgroundColor.r);
+	auto sceneRenderTarget = postProcessBackend.RenderTarget(GraphImage::Scene, 0);
+	gD3DContext->OMSetRenderTargets(1, &sceneRenderTarget, gDepthStencil);
+	gD3DContext->ClearRenderTargetView(sceneRenderTarget, &gNDBackgroundColor.r);
 
 
 	// Setup the viewport to the size of the main window
@@ -1224,120 +1855,32 @@ void RenderScene()
 	vp.TopLeftY = 0;
 	gD3DContext->RSSetViewports(1, &vp);
 
+	// Sort the scene's draws once, every pass that renders the scene below uses the same queue
+	BuildRenderQueue(gCamera);
+
 	// Render the scene from the main camera
 	RenderSceneFromCamera(gCamera);
 
 	////--------------- Scene completion ---------------////
 
-	// Run any post-processing steps
-	RenderFocusedObject();
-	gCurrentFocusedObjectTextureSRV = gFocusedObjectTextureSRV;
-	auto foRenderTarget = gFocusedObjectRenderTarget2;
-
-	RenderSceneNormalsAndDepth(gNormalDepthRenderTarget);
-	gCurrentNormalDepthTextureSRV = gNormalDepthTextureSRV;
-	auto ndRenderTarget = gNormalDepthRenderTarget2;
-
-	auto srv = gSceneTextureSRV;
-	auto renderTarget = gSceneRenderTarget2;
-
-	gPostProcessingConstants.copyAlpha = 1.0f;
-
-	FullScreenPostProcess(PostProcessType::Copy, srv, renderTarget, gNoBlendingState);
-	
-	FullScreenPostProcess(PostProcessType::Copy, gCurrentNormalDepthTextureSRV, ndRenderTarget, gNoBlendingState);
-
-	if (gFocusedObject > 0)
+	// Render the maps only if a post-process uses them
+	unsigned int usedImages = gPostProcessGraph.UsedImages();
+	if (usedImages & GraphImageBit(GraphImage::Focus))
 	{
-		FullScreenPostProcess(PostProcessType::Copy, gCurrentFocusedObjectTextureSRV, foRenderTarget, gNoBlendingState);
+		RenderFocusedObject(postProcessBackend.RenderTarget(GraphImage::Focus, 0));
 	}
-
-	auto itA = gPolygonPostProcesses.begin();
-	auto itB = gFullScreenPostProcesses.begin();
-	int i = 0;
-	int j = 0;
-
-	while (itA != gPolygonPostProcesses.end() || itB != gFullScreenPostProcesses.end())
+	if (usedImages & GraphImageBit(GraphImage::NormalDepth))
 	{
-		PostProcess* postProcess = *((itA != gPolygonPostProcesses.end()) ? itA : itB);
-
-		ApplyPostProcess(postProcess, srv, renderTarget);
-
-		// Switch between textures and render targets to apply multiple postprocesses.
-		if (i % 2 == 0)
-		{
-			srv = gSceneTextureSRV2;
-			renderTarget = gSceneRenderTarget;
-		}
-		else
-		{
-			srv = gSceneTextureSRV;
-			renderTarget = gSceneRenderTarget2;
-		}
-
-		if (postProcess->Mode == PostProcessMode::Polygon || postProcess->Mode == PostProcessMode::Area)
-		{
-			FullScreenPostProcess(PostProcessType::Copy, srv, renderTarget, gNoBlendingState);
-		}
-
-		// If the post process distorts the image, apply that distortion to the normal/depth map as well. 
-		if (postProcess->Type == PostProcessType::Retro	   ||
-			postProcess->Type == PostProcessType::Spiral   || postProcess->Type == PostProcessType::Underwater ||
-			postProcess->Type == PostProcessType::BlurX    || postProcess->Type == PostProcessType::BlurY      ||
-			postProcess->Type == PostProcessType::Dilation || postProcess->Type == PostProcessType::FrostedGlass)
-		{
-			ApplyPostProcess(postProcess, gCurrentNormalDepthTextureSRV, ndRenderTarget);
-			if (gFocusedObject != 0)
-			{
-				ApplyPostProcess(postProcess, gCurrentFocusedObjectTextureSRV, foRenderTarget);
-			}
-
-			// Switch between textures and render targets to apply multiple postprocesses.
-			if (j % 2 == 0)
-			{
-				gCurrentNormalDepthTextureSRV = gNormalDepthTextureSRV2;
-				ndRenderTarget = gNormalDepthRenderTarget;
-				if (gFocusedObject != 0)
-				{
-					gCurrentFocusedObjectTextureSRV = gFocusedObjectTextureSRV2;
-					foRenderTarget = gFocusedObjectRenderTarget;
-				}
-			}
-			else
-			{
-				gCurrentNormalDepthTextureSRV = gNormalDepthTextureSRV;
-				ndRenderTarget = gNormalDepthRenderTarget2;
-				if (gFocusedObject != 0)
-				{
-					gCurrentFocusedObjectTextureSRV = gFocusedObjectTextureSRV;
-					foRenderTarget = gFocusedObjectRenderTarget2;
-				}
-			}
-
-			if (j == 0 && (postProcess->Mode == PostProcessMode::Polygon || postProcess->Mode == PostProcessMode::Area))
-			{
-				FullScreenPostProcess(PostProcessType::Copy, gCurrentNormalDepthTextureSRV, ndRenderTarget, gNoBlendingState);
-				if (gFocusedObject != 0)
-				{
-					FullScreenPostProcess(PostProcessType::Copy, gCurrentFocusedObjectTextureSRV, foRenderTarget, gNoBlendingState);
-				}
-			}
-
-			j++;
-		}
-
-		if (itA != gPolygonPostProcesses.end())
-		{
-			++itA;
-		}
-		else if (itB != gFullScreenPostProcesses.end())
-		{
-			++itB;
-		}
-
-		++i;
+		RenderSceneNormalsAndDepth(postProcessBackend.RenderTarget(GraphImage::NormalDepth, 0));
 	}
 
+	// Run any post-processing steps. The scene and maps were rendered with direct calls, so the state filter can't know
+	// what is bound until the post-processes have bound it
+	gStateFilter.Invalidate();
+	gPostProcessingConstants.copyAlpha = 1.0f;
+	gPostProcessGraph.Execute(postProcessBackend);
+
+	auto srv = postProcessBackend.SRV(GraphImage::Scene, gPostProcessGraph.FinalSlot(GraphImage::Scene));
 	if (gCopyAlpha < 1.0f)
 	{
 		gPostProcessingConstants.copyAlpha = gCopyAlpha;
@@ -1347,16 +1890,23 @@ void RenderScene()
 	{
 		FullScreenPostProcess(PostProcessType::Copy, srv, gBackBufferRenderTarget, gNoBlendingState);
 	}
+	postProcessBackend.ReleaseTextures();
+	gRenderTargetPool.EndFrame();
+	gPostProcessConstants.EndFrame();
 
 	// These lines unbind the scene texture from the pixel shader to stop DirectX issuing a warning when we try to render to it again next frame
-	ID3D11ShaderResourceView* nullSRV = nullptr;
-	gD3DContext->PSSetShaderResources(0, 1, &nullSRV);
+	gStateFilter.SetShaderResource(0, nullptr);
+	gStateFilter.EndFrame();
+	gInstanceBatcher.EndFrame();
 
 	gD3DContext->ClearDepthStencilView(gDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
 
 	// When drawing to the off-screen back buffer is complete, we "present" the image to the front buffer (the screen)
 	// Set first parameter to 1 to lock to vsync
-	gSwapChain->Present(lockFPS ? 1 : 0, 0);
+	{
+		PROFILE_ZONE("Present", lockFPS ? "VSync" : "Unlocked");
+		gSwapChain->Present(lockFPS ? 1 : 0, 0);
+	}
 }
 
 
@@ -1364,9 +1914,13 @@ void RenderScene()
 // Scene Update
 //--------------------------------------------------------------------------------------
 
-// Update models and camera. frameTime is the time passed since the last frame
-void UpdateScene(float frameTime)
+// Update models and camera. frameTime is the time to move the scene on by, measuredFrameTime is how long the last frame
+// actually took (they differ when replaying input at a fixed timestep)
+void UpdateScene(float frameTime, float measuredFrameTime)
 {
+	PROFILE_ZONE("UpdateScene");
+	gFrameStatistics.AddFrame(measuredFrameTime, lockFPS ? FramePacing::VSync : FramePacing::Unlocked);
+
 	//***********
 
 	// Select post process on keys
@@ -1594,6 +2148,26 @@ void UpdateScene(float frameTime)
 		gTempDiagonalBlurs = Clamp(gTempDiagonalBlurs + 1, 0, 20);
 	}
 
+	if (KeyHit(Key_F8))
+	{
+		gBloomMode = (gBloomMode == BloomMode::Pyramid) ? BloomMode::FullResolution : BloomMode::Pyramid;
+	}
+
+	if (KeyHit(Key_F9))
+	{
+		gFusePostProcesses = !gFusePostProcesses;
+	}
+
+	if (KeyHit(Key_G))
+	{
+		gShowCrateField = !gShowCrateField;
+	}
+
+	if (KeyHit(Key_J))
+	{
+		gFrustumCulling = !gFrustumCulling;
+	}
+
 	// Chromatic aberration
 	static float aberrationTimer = 0.0f;
 	float colourOffset = cos(aberrationTimer) * 0.011f;
@@ -1753,7 +2327,7 @@ void UpdateScene(float frameTime)
 	const float fpsUpdateTime = 0.5f; // How long between updates (in seconds)
 	static float totalFrameTime = 0;
 	static int frameCount = 0;
-	totalFrameTime += frameTime;
+	totalFrameTime += measuredFrameTime;
 	++frameCount;
 	if (totalFrameTime > fpsUpdateTime)
 	{
@@ -1762,10 +2336,52 @@ void UpdateScene(float frameTime)
 		std::ostringstream frameTimeMs;
 		frameTimeMs.precision(2);
 		frameTimeMs << std::fixed << avgFrameTime * 1000;
+		// The slowest 1% of frames in the current FPS mode are what show up as stutters
+		frameTimeMs << "ms (p99 " << gFrameStatistics.Summary(lockFPS ? FramePacing::VSync : FramePacing::Unlocked).p99Ms;
 		std::string windowTitle = "CO3303 Week 14: Area Post Processing - Frame Time: " + frameTimeMs.str() +
-			"ms, FPS: " + std::to_string(static_cast<int>(1 / avgFrameTime + 0.5f));
+			"ms), FPS: " + std::to_string(static_cast<int>(1 / avgFrameTime + 0.5f));
 		SetWindowTextA(gHWnd, windowTitle.c_str());
 		totalFrameTime = 0;
 		frameCount = 0;
 	}
 }
+
+
+// Report the frame time statistics and rendering counters since starting to the debugger and write the frame times to a
+// CSV file, with any frame pacing problems in a second CSV file
+void ReportFrameStatistics(const std::string& statisticsFile, const std::string& anomaliesFile)
+{
+	OutputDebugStringA(("Frame times (ms)\n" + gFrameStatistics.Report()).c_str());
+	gFrameStatistics.WriteCSV(statisticsFile);
+	gFrameStatistics.WriteAnomaliesCSV(anomaliesFile);
+
+	std::ostringstream report;
+	report.precision(1);
+	report << std::fixed << "Rendering counters (totals over all frames)\n";
+
+	// Memory of the post-processing textures, averaged over the frames and at its peak
+	const TransientPoolStats& poolStats = gRenderTargetPool.Stats();
+	report << "  Targets:     " << poolStats.averageHeldBytes / (1024 * 1024) << "MB avg, "
+	       << static_cast<double>(poolStats.peakHeldBytes) / (1024 * 1024) << "MB peak, "
+	       << poolStats.numCreated << " textures created over " << poolStats.numFrames << " frames\n";
+
+	// Post-processing constants uploaded, and what sending all the settings to every pass would have taken
+	const ConstantUploadStats& constantStats = gPostProcessConstants.Stats();
+	report << "  Constants:   " << constantStats.totalUploadedBytes << "B in " << constantStats.totalUploads
+	       << " uploads for " << constantStats.totalPasses << " passes (whole " << constantStats.totalWholeBytes << "B)\n";
+
+	// Post-processing binding calls made, and those dropped as they bound what was already bound
+	const StateFilterStats& stateStats = gStateFilter.Stats();
+	report << "  State calls: " << stateStats.totalIssued << " issued, " << stateStats.totalSkipped << " skipped\n";
+
+	// Instanced draws and matrices sent, and what rendering each instance as a model would have taken
+	const InstanceBatchStats& instanceStats = gInstanceBatcher.Stats();
+	report << "  Instancing:  " << instanceStats.totalDraws << " draws, " << instanceStats.totalUploadedBytes
+	       << "B (as models " << instanceStats.totalModelDraws << " draws, " << instanceStats.totalModelUploadedBytes << "B)\n";
+
+	// Bounds in front of every frustum plane out of those tested, over the frames with culling on
+	report << "  Culling:     " << gCullTotalVisible << " of " << gCullTotalTested << " bounds visible, with "
+	       << CullingInstructionSet() << "\n";
+
+	OutputDebugStringA(report.str().c_str());
+}
@@ -6,11 +6,17 @@
 #ifndef _SCENE_H_INCLUDED_
 #define _SCENE_H_INCLUDED_
 
+#include <string>
+
 //--------------------------------------------------------------------------------------
 // Scene Geometry and Layout
 //--------------------------------------------------------------------------------------
 
-// Prepare the geometry required for the scene
+// Start loading the scene's meshes and textures in the background. Call before creating the Direct3D device so loading
+// overlaps with it. Optional, InitGeometry starts loading if it hasn't been started
+void StartLoadingAssets();
+
+// Prepare the geometry required for the scene, waiting for the meshes and textures to load
 // Returns true on success
 bool InitGeometry();
 
@@ -28,8 +34,14 @@ void ReleaseResources();
 
 void RenderScene();
 
-// frameTime is the time passed since the last frame
-void UpdateScene(float frameTime);
+// frameTime is the time to move the scene on by, measuredFrameTime is how long the last frame actually took. They are the
+// same except when replaying input, which uses a fixed timestep
+void UpdateScene(float frameTime, float measuredFrameTime);
+
+// Report the frame time statistics and rendering counters since starting to the debugger and write the frame times to a
+// CSV file, with any frame pacing problems in a second CSV file
+void ReportFrameStatistics(const std::string& statisticsFile = "FrameStatistics.csv",
+                           const std::string& anomaliesFile = "FrameAnomalies.csv");
 
 
 #endif //_SCENE_H_INCLUDED_
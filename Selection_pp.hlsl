@@ -17,6 +17,19 @@ SamplerState PointSample : register(s0); // We don't usually want to filter (bil
 Texture2D DepthMap : register(t1);
 Texture2D FocusMap : register(t2);
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match OutlineBlock in PostProcessConstantBlocks.cpp
+cbuffer OutlineConstants : register(b2)
+{
+	float  gOutlineThreshold; // Not used here, the block is shared with the outline post-process
+	float  gOutlineThickness;
+	float2 paddingOutline;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
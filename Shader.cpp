@@ -8,6 +8,7 @@
 #include <d3dcompiler.h>
 #include <fstream>
 #include <vector>
+#include <map>
 
 //--------------------------------------------------------------------------------------
 // Global Variables
@@ -19,6 +20,8 @@
 ID3D11VertexShader*   gBasicTransformVertexShader = nullptr;
 ID3D11VertexShader*   gPixelLightingVertexShader  = nullptr;
 ID3D11VertexShader*   gNormalDepthVertexShader	  = nullptr;
+ID3D11VertexShader*   gPixelLightingInstancedVertexShader = nullptr;
+ID3D11VertexShader*   gNormalDepthInstancedVertexShader   = nullptr;
 ID3D11PixelShader*    gTintedTexturePixelShader   = nullptr;
 ID3D11PixelShader*    gPixelLightingPixelShader   = nullptr;
 ID3D11PixelShader*	  gNormalDepthPixelShader	  = nullptr;
@@ -47,6 +50,9 @@ ID3D11PixelShader* gRetroPostProcess				= nullptr;
 ID3D11PixelShader* gBloomPostProcess  				= nullptr;
 ID3D11PixelShader* gBrightnessPostProcess			= nullptr;
 ID3D11PixelShader* gDirectionalBlurPostProcess		= nullptr;
+ID3D11PixelShader* gBloomPrefilterPostProcess		= nullptr;
+ID3D11PixelShader* gBloomDownsamplePostProcess		= nullptr;
+ID3D11PixelShader* gBloomUpsamplePostProcess		= nullptr;
 ID3D11PixelShader* gHueShiftPostProcess				= nullptr;
 ID3D11PixelShader* gChromaticAberrationPostProcess	= nullptr;
 ID3D11PixelShader* gOutlinePostProcess				= nullptr;
@@ -56,6 +62,9 @@ ID3D11PixelShader* gSelectionPostProcess			= nullptr;
 
 std::vector<ID3D11PixelShader*> gPostProcessShaders;
 
+// Pixel shaders compiled at runtime for fused post-processes, by shader source. Null if the source failed to compile
+std::map<std::string, ID3D11PixelShader*> gFusedPostProcessShaders;
+
 //--------------------------------------------------------------------------------------
 // Shader creation / destruction
 //--------------------------------------------------------------------------------------
@@ -69,6 +78,8 @@ bool LoadShaders()
 	gBasicTransformVertexShader   = LoadVertexShader  ("BasicTransform_vs"  );
 	gPixelLightingVertexShader    = LoadVertexShader  ("PixelLighting_vs"   );
 	gNormalDepthVertexShader	  = LoadVertexShader  ("NormalDepth_vs"		);
+	gPixelLightingInstancedVertexShader = LoadVertexShader("PixelLightingInstanced_vs");
+	gNormalDepthInstancedVertexShader   = LoadVertexShader("NormalDepthInstanced_vs");
 	gTintedTexturePixelShader     = LoadPixelShader   ("TintedTexture_ps"   );
 	gPixelLightingPixelShader     = LoadPixelShader   ("PixelLighting_ps"   );
 	gNormalDepthPixelShader		  = LoadPixelShader   ("NormalDepth_ps"		);
@@ -95,6 +106,9 @@ bool LoadShaders()
 	gBloomPostProcess				= LoadPixelShader("Bloom_pp");
 	gBrightnessPostProcess			= LoadPixelShader("Brightness_pp");
 	gDirectionalBlurPostProcess		= LoadPixelShader("DirectionalBlur_pp");
+	gBloomPrefilterPostProcess		= LoadPixelShader("BloomPrefilter_pp");
+	gBloomDownsamplePostProcess		= LoadPixelShader("BloomDownsample_pp");
+	gBloomUpsamplePostProcess		= LoadPixelShader("BloomUpsample_pp");
 	gHueShiftPostProcess			= LoadPixelShader("HueShift_pp");
 	gChromaticAberrationPostProcess = LoadPixelShader("ChromaticAberration_pp");
 	gOutlinePostProcess				= LoadPixelShader("Outline_pp");
@@ -118,6 +132,9 @@ bool LoadShaders()
 	gPostProcessShaders.push_back(gBloomPostProcess);
 	gPostProcessShaders.push_back(gBrightnessPostProcess);
 	gPostProcessShaders.push_back(gDirectionalBlurPostProcess);
+	gPostProcessShaders.push_back(gBloomPrefilterPostProcess);
+	gPostProcessShaders.push_back(gBloomDownsamplePostProcess);
+	gPostProcessShaders.push_back(gBloomUpsamplePostProcess);
 	gPostProcessShaders.push_back(gHueShiftPostProcess);
 	gPostProcessShaders.push_back(gChromaticAberrationPostProcess);
 	gPostProcessShaders.push_back(gOutlinePostProcess);
@@ -136,7 +153,8 @@ bool LoadShaders()
 	if (gBasicTransformVertexShader == nullptr || gPixelLightingVertexShader == nullptr ||
 		gTintedTexturePixelShader == nullptr   || gPixelLightingPixelShader == nullptr  ||
 		g2DQuadVertexShader == nullptr         || gNormalDepthVertexShader == nullptr   ||
-		gNormalDepthPixelShader == nullptr	   || gPositionPixelShader == nullptr )
+		gNormalDepthPixelShader == nullptr	   || gPositionPixelShader == nullptr       ||
+		gPixelLightingInstancedVertexShader == nullptr || gNormalDepthInstancedVertexShader == nullptr)
 	{
 		gLastError = "Error loading shaders";
 		return false;
@@ -155,6 +173,8 @@ void ReleaseShaders()
 	if (gPixelLightingVertexShader)   gPixelLightingVertexShader ->Release();
 	if (gBasicTransformVertexShader)  gBasicTransformVertexShader->Release();
 	if (gNormalDepthVertexShader)	  gNormalDepthVertexShader	 ->Release();
+	if (gPixelLightingInstancedVertexShader)  gPixelLightingInstancedVertexShader->Release();
+	if (gNormalDepthInstancedVertexShader)    gNormalDepthInstancedVertexShader  ->Release();
 	if (gNormalDepthPixelShader)	  gNormalDepthPixelShader	 ->Release();
 	if (gPositionPixelShader)		  gPositionPixelShader ->Release();
 
@@ -167,6 +187,12 @@ void ReleaseShaders()
 	}
 
 	gPostProcessShaders.clear();
+
+	for (auto& fusedShader : gFusedPostProcessShaders)
+	{
+		if (fusedShader.second)  fusedShader.second->Release();
+	}
+	gFusedPostProcessShaders.clear();
 }
 
 
@@ -308,6 +334,43 @@ ID3D11PixelShader* LoadPixelShader(std::string shaderName)
 
 
 
+// Compile a pixel shader from source at runtime. #include paths are relative to the working folder, where the .hlsl
+// files are. The returned pointer needs to be released before quitting. Returns nullptr on failure
+ID3D11PixelShader* CompilePixelShader(const std::string& shaderSource)
+{
+	ID3DBlob* compiledShader = nullptr;
+	HRESULT hr = D3DCompile(shaderSource.c_str(), shaderSource.length(), NULL, NULL, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
+	                        "ps_5_0", D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &compiledShader, NULL);
+	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	ID3D11PixelShader* shader;
+	hr = gD3DDevice->CreatePixelShader(compiledShader->GetBufferPointer(), compiledShader->GetBufferSize(), nullptr, &shader);
+	compiledShader->Release();
+	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	return shader;
+}
+
+
+// Pixel shader for a fused post-process given its source (see PostProcessFusion.h). Compiled the first time the source is
+// seen and kept until ReleaseShaders. Returns nullptr if the source does not compile
+ID3D11PixelShader* FusedPostProcessShader(const std::string& shaderSource)
+{
+	auto fusedShader = gFusedPostProcessShaders.find(shaderSource);
+	if (fusedShader != gFusedPostProcessShaders.end())  return fusedShader->second;
+
+	ID3D11PixelShader* shader = CompilePixelShader(shaderSource);
+	gFusedPostProcessShaders[shaderSource] = shader;
+	return shader;
+}
+
+
 // Very advanced topic: When creating a vertex layout for geometry (see Scene.cpp), you need the signature
 // (bytecode) of a shader that uses that vertex layout. This is an annoying requirement and tends to create
 // unnecessary coupling between shaders and vertex buffers.
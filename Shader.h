@@ -20,6 +20,8 @@
 extern ID3D11VertexShader*   gBasicTransformVertexShader;
 extern ID3D11VertexShader*   gPixelLightingVertexShader;
 extern ID3D11VertexShader*   gNormalDepthVertexShader;
+extern ID3D11VertexShader*   gPixelLightingInstancedVertexShader; // Read the world matrix from an instance buffer, see InstanceBatcher.h
+extern ID3D11VertexShader*   gNormalDepthInstancedVertexShader;
 extern ID3D11PixelShader*    gTintedTexturePixelShader;
 extern ID3D11PixelShader*    gPixelLightingPixelShader;
 extern ID3D11PixelShader*    gNormalDepthPixelShader;
@@ -47,6 +49,9 @@ extern ID3D11PixelShader* gRetroPostProcess;
 extern ID3D11PixelShader* gBloomPostProcess;
 extern ID3D11PixelShader* gBrightnessPostProcess;
 extern ID3D11PixelShader* gDirectionalBlurPostProcess;
+extern ID3D11PixelShader* gBloomPrefilterPostProcess;
+extern ID3D11PixelShader* gBloomDownsamplePostProcess;
+extern ID3D11PixelShader* gBloomUpsamplePostProcess;
 extern ID3D11PixelShader* gHueShiftPostProcess;
 extern ID3D11PixelShader* gChromaticAberrationPostProcess;
 extern ID3D11PixelShader* gOutlinePostProcess;
@@ -95,5 +100,13 @@ ID3D11GeometryShader* LoadStreamOutGeometryShader(std::string shaderName, D3D11_
 // Helper function. Returns nullptr on failure.
 ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLayout[], int numElements);
 
+// Compile a pixel shader from source at runtime. #include paths are relative to the working folder, where the .hlsl
+// files are. The returned pointer needs to be released before quitting. Returns nullptr on failure
+ID3D11PixelShader* CompilePixelShader(const std::string& shaderSource);
+
+// Pixel shader for a fused post-process given its source (see PostProcessFusion.h). Compiled the first time the source is
+// seen and released by ReleaseShaders. Returns nullptr if the source does not compile
+ID3D11PixelShader* FusedPostProcessShader(const std::string& shaderSource);
+
 
 #endif //_SHADER_H_INCLUDED_
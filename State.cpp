@@ -4,11 +4,18 @@
 // - Blender state (Additive blending, alpha blending etc.)
 // - Rasterizer state (Wireframe mode, don't cull back faces etc.)
 // - Depth stencil state (How to use the depth and stencil buffer)
+// - Input layouts (What is in each vertex of a mesh)
 //--------------------------------------------------------------------------------------
 
 #include "State.h"
+#include "Shader.h" // Needed for helper function CreateSignatureForVertexLayout
 #include "Common.h"
 
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
 
 //--------------------------------------------------------------------------------------
 // Global Variables
@@ -22,6 +29,7 @@
 ID3D11SamplerState* gPointSampler         = nullptr;
 ID3D11SamplerState* gTrilinearSampler     = nullptr;
 ID3D11SamplerState* gAnisotropic4xSampler = nullptr;
+ID3D11SamplerState* gBilinearClampSampler = nullptr;
 
 // Blend states allow us to switch between blending modes (none, additive, multiplicative etc.)
 ID3D11BlendState* gNoBlendingState       = nullptr;
@@ -41,6 +49,176 @@ ID3D11DepthStencilState* gNoDepthBufferState  = nullptr;
 
 
 
+//--------------------------------------------------------------------------------------
+// State lookup
+//--------------------------------------------------------------------------------------
+// Every state and input layout is made through the FindOrCreate functions below, which hand back the object already made
+// for an identical description. The description is turned into a key of its bytes - field by field where the structure
+// has padding, and with the text of semantic names rather than their pointers - and the key's hash finds the object
+
+// Bytes of a description, built up a field at a time
+class DescriptionKey
+{
+public:
+	template <class T>
+	void Add(const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		mBytes.insert(mBytes.end(), bytes, bytes + sizeof(T));
+	}
+
+	void AddString(const char* text)
+	{
+		if (text != nullptr)  mBytes.insert(mBytes.end(), text, text + strlen(text));
+		mBytes.push_back(0);
+	}
+
+	// FNV-1a
+	uint64_t Hash() const
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (uint8_t byte : mBytes)  hash = (hash ^ byte) * 0x100000001b3ull;
+		return hash;
+	}
+
+	const std::vector<uint8_t>& Bytes() const { return mBytes; }
+
+private:
+	std::vector<uint8_t> mBytes;
+};
+
+
+// Objects of one type made so far, each held with one reference until Release
+template <class Object>
+class StateObjectCache
+{
+public:
+	// The object made for the key, or nullptr if there isn't one yet
+	Object* Find(const DescriptionKey& key) const
+	{
+		auto range = mObjects.equal_range(key.Hash());
+		for (auto entry = range.first; entry != range.second; ++entry)
+		{
+			if (entry->second.key == key.Bytes())  return entry->second.object;
+		}
+		return nullptr;
+	}
+
+	void Add(const DescriptionKey& key, Object* object)
+	{
+		mObjects.insert({ key.Hash(), { key.Bytes(), object } });
+	}
+
+	void Release()
+	{
+		for (auto& entry : mObjects)  entry.second.object->Release();
+		mObjects.clear();
+	}
+
+private:
+	struct Entry
+	{
+		std::vector<uint8_t> key;
+		Object*              object;
+	};
+	std::unordered_multimap<uint64_t, Entry> mObjects;
+};
+
+
+static StateObjectCache<ID3D11SamplerState>      gSamplerStates;
+static StateObjectCache<ID3D11BlendState>        gBlendStates;
+static StateObjectCache<ID3D11RasterizerState>   gRasterizerStates;
+static StateObjectCache<ID3D11DepthStencilState> gDepthStencilStates;
+static StateObjectCache<ID3D11InputLayout>       gInputLayouts;
+
+
+// The sampler and rasterizer descriptions are all 4-byte fields with no padding, so their bytes can be taken whole
+ID3D11SamplerState* FindOrCreateSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+	DescriptionKey key;
+	key.Add(desc);
+	ID3D11SamplerState* state = gSamplerStates.Find(key);
+	if (state == nullptr && SUCCEEDED(gD3DDevice->CreateSamplerState(&desc, &state)))  gSamplerStates.Add(key, state);
+	return state;
+}
+
+ID3D11RasterizerState* FindOrCreateRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+	DescriptionKey key;
+	key.Add(desc);
+	ID3D11RasterizerState* state = gRasterizerStates.Find(key);
+	if (state == nullptr && SUCCEEDED(gD3DDevice->CreateRasterizerState(&desc, &state)))  gRasterizerStates.Add(key, state);
+	return state;
+}
+
+// Each render target's description ends with a single byte write mask, so is padded
+ID3D11BlendState* FindOrCreateBlendState(const D3D11_BLEND_DESC& desc)
+{
+	DescriptionKey key;
+	key.Add(desc.AlphaToCoverageEnable);
+	key.Add(desc.IndependentBlendEnable);
+	for (const auto& target : desc.RenderTarget)
+	{
+		key.Add(target.BlendEnable);
+		key.Add(target.SrcBlend);
+		key.Add(target.DestBlend);
+		key.Add(target.BlendOp);
+		key.Add(target.SrcBlendAlpha);
+		key.Add(target.DestBlendAlpha);
+		key.Add(target.BlendOpAlpha);
+		key.Add(target.RenderTargetWriteMask);
+	}
+	ID3D11BlendState* state = gBlendStates.Find(key);
+	if (state == nullptr && SUCCEEDED(gD3DDevice->CreateBlendState(&desc, &state)))  gBlendStates.Add(key, state);
+	return state;
+}
+
+// The stencil masks are single bytes, so the description is padded
+ID3D11DepthStencilState* FindOrCreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	DescriptionKey key;
+	key.Add(desc.DepthEnable);
+	key.Add(desc.DepthWriteMask);
+	key.Add(desc.DepthFunc);
+	key.Add(desc.StencilEnable);
+	key.Add(desc.StencilReadMask);
+	key.Add(desc.StencilWriteMask);
+	key.Add(desc.FrontFace);
+	key.Add(desc.BackFace);
+	ID3D11DepthStencilState* state = gDepthStencilStates.Find(key);
+	if (state == nullptr && SUCCEEDED(gD3DDevice->CreateDepthStencilState(&desc, &state)))  gDepthStencilStates.Add(key, state);
+	return state;
+}
+
+// The layout is made against a signature generated for the elements (see CreateSignatureForVertexLayout)
+ID3D11InputLayout* FindOrCreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, int numElements)
+{
+	DescriptionKey key;
+	for (int i = 0; i < numElements; ++i)
+	{
+		key.AddString(elements[i].SemanticName);
+		key.Add(elements[i].SemanticIndex);
+		key.Add(elements[i].Format);
+		key.Add(elements[i].InputSlot);
+		key.Add(elements[i].AlignedByteOffset);
+		key.Add(elements[i].InputSlotClass);
+		key.Add(elements[i].InstanceDataStepRate);
+	}
+	ID3D11InputLayout* layout = gInputLayouts.Find(key);
+	if (layout != nullptr)  return layout;
+
+	auto signature = CreateSignatureForVertexLayout(elements, numElements);
+	if (signature == nullptr)  return nullptr;
+	HRESULT hr = gD3DDevice->CreateInputLayout(elements, static_cast<UINT>(numElements),
+	                                           signature->GetBufferPointer(), signature->GetBufferSize(), &layout);
+	signature->Release();
+	if (FAILED(hr))  return nullptr;
+	gInputLayouts.Add(key, layout);
+	return layout;
+}
+
+
+
 //--------------------------------------------------------------------------------------
 // State creation / destruction
 //--------------------------------------------------------------------------------------
@@ -65,7 +243,7 @@ bool CreateStates()
 	samplerDesc.MinLOD = 0;                 // --"--
 
 	// Then create a DirectX object for your description that can be used by a shader
-	if (FAILED(gD3DDevice->CreateSamplerState(&samplerDesc, &gPointSampler)))
+	if ((gPointSampler = FindOrCreateSamplerState(samplerDesc)) == nullptr)
 	{
 		gLastError = "Error creating point sampler";
 		return false;
@@ -83,7 +261,7 @@ bool CreateStates()
 	samplerDesc.MinLOD = 0;                 // --"--
 
 	// Then create a DirectX object for your description that can be used by a shader
-	if (FAILED(gD3DDevice->CreateSamplerState(&samplerDesc, &gTrilinearSampler)))
+	if ((gTrilinearSampler = FindOrCreateSamplerState(samplerDesc)) == nullptr)
 	{
 		gLastError = "Error creating point sampler";
 		return false;
@@ -101,13 +279,31 @@ bool CreateStates()
 	samplerDesc.MinLOD = 0;                 // --"--
 
 	// Then create a DirectX object for your description that can be used by a shader
-	if (FAILED(gD3DDevice->CreateSamplerState(&samplerDesc, &gAnisotropic4xSampler)))
+	if ((gAnisotropic4xSampler = FindOrCreateSamplerState(samplerDesc)) == nullptr)
 	{
 		gLastError = "Error creating anisotropic 4x sampler";
 		return false;
 	}
 
 
+	////-------- Bilinear Sampling with clamp (bloom pyramid) --------////
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT; // Bilinear filtering, the bloom levels have no mip-maps
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;        // Clamp addressing mode for texture coordinates outside 0->1
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;        // --"--
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;        // --"--
+	samplerDesc.MaxAnisotropy = 1;                             // Number of samples used if using anisotropic filtering, more is better but max value depends on GPU
+
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX; // Controls how much mip-mapping can be used. These settings are full mip-mapping, the usual values
+	samplerDesc.MinLOD = 0;                 // --"--
+
+	// Then create a DirectX object for your description that can be used by a shader
+	if ((gBilinearClampSampler = FindOrCreateSamplerState(samplerDesc)) == nullptr)
+	{
+		gLastError = "Error creating bilinear clamp sampler";
+		return false;
+	}
+
+
     //--------------------------------------------------------------------------------------
 	// Rasterizer States
 	//--------------------------------------------------------------------------------------
@@ -123,7 +319,7 @@ bool CreateStates()
     rasterizerDesc.DepthClipEnable       = TRUE; // Advanced setting - only used in rare cases
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateRasterizerState(&rasterizerDesc, &gCullBackState)))
+    if ((gCullBackState = FindOrCreateRasterizerState(rasterizerDesc)) == nullptr)
     {
         gLastError = "Error creating cull-back state";
         return false;
@@ -137,7 +333,7 @@ bool CreateStates()
     rasterizerDesc.DepthClipEnable       = TRUE; // Advanced setting - only used in rare cases
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateRasterizerState(&rasterizerDesc, &gCullFrontState)))
+    if ((gCullFrontState = FindOrCreateRasterizerState(rasterizerDesc)) == nullptr)
     {
         gLastError = "Error creating cull-front state";
         return false;
@@ -151,7 +347,7 @@ bool CreateStates()
     rasterizerDesc.DepthClipEnable       = TRUE; // Advanced setting - only used in rare cases
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateRasterizerState(&rasterizerDesc, &gCullNoneState)))
+    if ((gCullNoneState = FindOrCreateRasterizerState(rasterizerDesc)) == nullptr)
     {
         gLastError = "Error creating cull-none state";
         return false;
@@ -178,7 +374,7 @@ bool CreateStates()
     blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
     // Then create a DirectX object for the description that can be used by a shader
-    if (FAILED(gD3DDevice->CreateBlendState(&blendDesc, &gNoBlendingState)))
+    if ((gNoBlendingState = FindOrCreateBlendState(blendDesc)) == nullptr)
     {
         gLastError = "Error creating no-blend state";
         return false;
@@ -199,7 +395,7 @@ bool CreateStates()
     blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
     // Then create a DirectX object for the description that can be used by a shader
-    if (FAILED(gD3DDevice->CreateBlendState(&blendDesc, &gAdditiveBlendingState)))
+    if ((gAdditiveBlendingState = FindOrCreateBlendState(blendDesc)) == nullptr)
     {
         gLastError = "Error creating additive blending state";
         return false;
@@ -220,7 +416,7 @@ bool CreateStates()
     blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
     // Then create a DirectX object for the description that can be used by a shader
-    if (FAILED(gD3DDevice->CreateBlendState(&blendDesc, &gAlphaBlendingState)))
+    if ((gAlphaBlendingState = FindOrCreateBlendState(blendDesc)) == nullptr)
     {
         gLastError = "Error creating additive blending state";
         return false;
@@ -242,7 +438,7 @@ bool CreateStates()
     depthStencilDesc.StencilEnable    = FALSE;
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateDepthStencilState(&depthStencilDesc, &gUseDepthBufferState)))
+    if ((gUseDepthBufferState = FindOrCreateDepthStencilState(depthStencilDesc)) == nullptr)
     {
         gLastError = "Error creating use-depth-buffer state";
         return false;
@@ -257,7 +453,7 @@ bool CreateStates()
     depthStencilDesc.StencilEnable    = FALSE;
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateDepthStencilState(&depthStencilDesc, &gDepthReadOnlyState)))
+    if ((gDepthReadOnlyState = FindOrCreateDepthStencilState(depthStencilDesc)) == nullptr)
     {
         gLastError = "Error creating depth-read-only state";
         return false;
@@ -271,7 +467,7 @@ bool CreateStates()
     depthStencilDesc.StencilEnable    = FALSE;
 
     // Create a DirectX object for the description above that can be used by a shader
-    if (FAILED(gD3DDevice->CreateDepthStencilState(&depthStencilDesc, &gNoDepthBufferState)))
+    if ((gNoDepthBufferState = FindOrCreateDepthStencilState(depthStencilDesc)) == nullptr)
     {
         gLastError = "Error creating no-depth-buffer state";
         return false;
@@ -281,19 +477,26 @@ bool CreateStates()
 }
 
 
-// Release DirectX state objects
+// Release DirectX state objects, including every state and input layout made by the FindOrCreate functions
 void ReleaseStates()
 {
-    if (gUseDepthBufferState)    gUseDepthBufferState->Release();
-    if (gDepthReadOnlyState)     gDepthReadOnlyState->Release();
-    if (gNoDepthBufferState)     gNoDepthBufferState->Release();
-    if (gCullBackState)          gCullBackState->Release();
-    if (gCullFrontState)         gCullFrontState->Release();
-    if (gCullNoneState)          gCullNoneState->Release();
-    if (gNoBlendingState)        gNoBlendingState->Release();
-    if (gAlphaBlendingState)     gAlphaBlendingState->Release();
-    if (gAdditiveBlendingState)  gAdditiveBlendingState->Release();
-    if (gAnisotropic4xSampler)   gAnisotropic4xSampler->Release();
-    if (gTrilinearSampler)       gTrilinearSampler->Release();
-    if (gPointSampler)           gPointSampler->Release();
+    gSamplerStates.Release();
+    gBlendStates.Release();
+    gRasterizerStates.Release();
+    gDepthStencilStates.Release();
+    gInputLayouts.Release();
+
+    gUseDepthBufferState   = nullptr;
+    gDepthReadOnlyState    = nullptr;
+    gNoDepthBufferState    = nullptr;
+    gCullBackState         = nullptr;
+    gCullFrontState        = nullptr;
+    gCullNoneState         = nullptr;
+    gNoBlendingState       = nullptr;
+    gAlphaBlendingState    = nullptr;
+    gAdditiveBlendingState = nullptr;
+    gBilinearClampSampler  = nullptr;
+    gAnisotropic4xSampler  = nullptr;
+    gTrilinearSampler      = nullptr;
+    gPointSampler          = nullptr;
 }
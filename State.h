@@ -4,6 +4,7 @@
 // - Blender state (Additive blending, alpha blending etc.)
 // - Rasterizer state (Wireframe mode, don't cull back faces etc.)
 // - Depth stencil state (How to use the depth and stencil buffer)
+// - Input layouts (What is in each vertex of a mesh)
 //--------------------------------------------------------------------------------------
 #ifndef _STATE_H_INCLUDED_
 #define _STATE_H_INCLUDED_
@@ -21,6 +22,7 @@
 extern ID3D11SamplerState* gPointSampler;
 extern ID3D11SamplerState* gTrilinearSampler;
 extern ID3D11SamplerState* gAnisotropic4xSampler;
+extern ID3D11SamplerState* gBilinearClampSampler;
 
 extern ID3D11BlendState* gNoBlendingState;
 extern ID3D11BlendState* gAdditiveBlendingState;
@@ -42,8 +44,24 @@ extern ID3D11DepthStencilState* gNoDepthBufferState;
 // Create all the states used in this app, returns true on success
 bool CreateStates();
 
-// Release DirectX state objects
+// Release DirectX state objects, including every object made by the functions below
 void ReleaseStates();
 
 
+//--------------------------------------------------------------------------------------
+// State lookup
+//--------------------------------------------------------------------------------------
+// Get the object for a description, only creating one if none has been made for an identical description. Objects are
+// looked up by a hash of their description and belong to this file - AddRef one to hold it past ReleaseStates.
+// Returns nullptr on failure
+
+ID3D11SamplerState*      FindOrCreateSamplerState(const D3D11_SAMPLER_DESC& desc);
+ID3D11BlendState*        FindOrCreateBlendState(const D3D11_BLEND_DESC& desc);
+ID3D11RasterizerState*   FindOrCreateRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+ID3D11DepthStencilState* FindOrCreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+
+// Input layout for the given vertex elements
+ID3D11InputLayout* FindOrCreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, int numElements);
+
+
 #endif //_STATE_H_INCLUDED_
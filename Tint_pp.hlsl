@@ -23,9 +23,6 @@ SamplerState PointSample  : register(s0); // We don't usually want to filter (bi
 // Post-processing shader that tints the scene texture to a given colour
 float4 main(PostProcessingInput input) : SV_Target
 {
-	// Sample a pixel from the scene texture and multiply it with the tint colour (comes from a constant buffer defined in Common.hlsli)
-	float3 colour = SceneTexture.Sample(PointSample, input.sceneUV).rgb * gTintColour;
-	
-	// Got the RGB from the scene texture, set alpha to 1 for final output
-	return float4(colour, 1.0f);
+	// Sample a pixel from the scene texture and multiply it with the tint colour (see TintColour in Common.hlsli)
+	return TintColour(SceneTexture.Sample(PointSample, input.sceneUV), input);
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// Asset load benchmark - times the load stages of the scene's assets on one thread and
+// on a thread pool, without creating a Direct3D device
+//--------------------------------------------------------------------------------------
+// Usage: AssetLoadBenchmark [--threads n] [--no-cache] [files...]
+// Runs the same load stages the app's AssetLoader runs at startup: meshes are mapped from binary or cooked files, or
+// imported with assimp, and textures are read into memory (decoding them into textures needs the device so isn't timed
+// here). The files default to the scene's assets, run it from the folder holding them. --no-cache imports every mesh
+// with assimp, ignoring and not writing cooked mesh files, to time the imports themselves.
+//
+// All the files are loaded once before timing so both timed runs see the same (warm) file cache. A table of the times
+// for each asset is printed for each run, then the speed-up.
+//
+// Only needs the Math and Utility folders, MeshData.cpp and MeshFile.cpp, and assimp, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -pthread -I. -IMath -IUtility Tools/AssetLoadBenchmark/AssetLoadBenchmark.cpp MeshData.cpp
+//     MeshFile.cpp Utility/AssetLoader.cpp Utility/ThreadPool.cpp Utility/Clock.cpp Utility/MappedFile.cpp Math/*.cpp -lassimp
+
+#include "AssetLoader.h"
+#include "MeshData.h"
+#include "MeshFile.h"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <iterator>
+
+
+// The meshes and textures the scene loads (see StartLoadingAssets in Scene.cpp)
+static const char* SCENE_ASSETS[] =
+{
+	"Stars.x", "Hills.x", "Cube.x", "CargoContainer.x", "Light.x", "Wall1.x", "Wall2.x", "Teapot.x", "Troll.x",
+	"Stars.jpg", "GrassDiffuseSpecular.dds", "StoneDiffuseSpecular.dds", "CargoA.dds", "Flare.jpg", "Noise.png",
+	"Burn.png", "Distort.png", "Noise2.png", "brick_35.jpg", "TrollDiffuseSpecular.dds", "Saturn.jpg",
+};
+
+
+// Whether a file is a texture rather than a mesh, from its extension
+static bool IsTextureFile(const std::string& fileName)
+{
+	std::string extension = fileName.substr(std::min(fileName.size(), fileName.find_last_of('.')));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".dds" || extension == ".jpg" || extension == ".jpeg" || extension == ".png" ||
+	       extension == ".bmp" || extension == ".tga" || extension == ".tif" || extension == ".tiff";
+}
+
+
+// Load the files on the given number of threads, prints the times if requested and returns the total time in seconds,
+// or a negative value if any file failed
+static double LoadAssets(const std::vector<std::string>& files, unsigned int numThreads, bool noCache, bool report)
+{
+	AssetLoader loader(numThreads);
+	for (auto& fileName : files)
+	{
+		if (IsTextureFile(fileName))
+		{
+			loader.Add(fileName, [fileName]()
+			{
+				std::vector<uint8_t> data;
+				return ReadWholeFile(fileName, data);
+			}, nullptr);
+		}
+		else
+		{
+			loader.Add(fileName, [fileName, noCache]()
+			{
+				try
+				{
+					MeshFile meshFile;
+					MeshData data;
+					if (noCache)  ImportMesh(fileName, false, data);
+					else          LoadMeshData(fileName, false, meshFile, data);
+
+					// Touch the vertices and indices as creating the GPU buffers would
+					unsigned int sum = 0;
+					for (auto& subMesh : data.subMeshes)
+					{
+						const size_t vertexBytes = static_cast<size_t>(subMesh.numVertices) * subMesh.vertexSize;
+						for (size_t i = 0; i < vertexBytes; i += 64)  sum += subMesh.vertices[i];
+						for (unsigned int i = 0; i < subMesh.numIndices; i += 16)  sum += subMesh.indices[i];
+					}
+					volatile unsigned int keep = sum;
+					(void)keep;
+					return true;
+				}
+				catch (std::runtime_error& e)
+				{
+					AssetLoader::SetError(e.what());
+					return false;
+				}
+			}, nullptr);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	if (!loader.LoadOnly())
+	{
+		printf("%s\n", loader.LastError().c_str());
+		return -1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (report)  printf("%s\n", loader.Timings().c_str());
+	return seconds;
+}
+
+
+int main(int argc, char* argv[])
+{
+	unsigned int numThreads = 0;
+	bool noCache = false;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)  numThreads = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--no-cache") == 0)           noCache = true;
+		else                                                     files.push_back(argv[i]);
+	}
+	if (files.empty())  files.assign(std::begin(SCENE_ASSETS), std::end(SCENE_ASSETS));
+
+	// Warm the file cache and write any missing cooked files
+	if (LoadAssets(files, numThreads, noCache, false) < 0)  return 1;
+
+	printf("One thread\n");
+	double serial = LoadAssets(files, 1, noCache, true);
+	if (serial < 0)  return 1;
+
+	printf("Thread pool\n");
+	double parallel = LoadAssets(files, numThreads, noCache, true);
+	if (parallel < 0)  return 1;
+
+	printf("Speed-up %.2fx\n", serial / std::max(parallel, 1e-9));
+	return 0;
+}
@@ -0,0 +1,444 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling benchmark - checks the bounding volumes and frustum culling against
+// plain clip space tests and times culling scenes of random objects
+//--------------------------------------------------------------------------------------
+// Usage: FrustumCullingBenchmark [options]
+//   --objects list      Numbers of objects in the scenes (default 10000,100000,1000000)
+//   --seed n            Seed for the scenes (default 1)
+//   --repetitions n     Timed culls of each scene, the fastest is reported (default 5)
+// Lists are separated by commas. Returns 1 if any check fails.
+//
+// First the bounding volume functions are checked on random boxes, spheres and affine matrices: a transformed box or
+// sphere must hold the transformed corners or surface points of the original, combined volumes must hold both, and the
+// volumes of a set of points must hold every point.
+//
+// Then each scene is a camera, set up as Camera::UpdateMatrices does, among objects with random boxes spread around it.
+// The planes from its view-projection matrix must agree with testing points in clip space, and culling the scene must:
+//   - give exactly the same result as IsBoxInFrustum / IsSphereInFrustum for each volume, on one thread and on a pool
+//   - keep every box with a corner inside the view (no visible object is lost)
+//   - only cull boxes whose corners are all outside the same side of clip space
+// Culling is timed one box at a time with IsBoxInFrustum, as lists of boxes and of spheres on one thread, and as lists
+// of boxes on a thread pool. The project builds with AVX (/arch:AVX) so the eight-wide version is timed, builds without
+// it use Float4. The instructions used are reported first.
+//
+// Only needs the Math and Utility folders, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -mavx -IMath -IUtility Tools/FrustumCullingBenchmark/FrustumCullingBenchmark.cpp
+//     Math/FrustumCulling.cpp Math/CMatrix4x4.cpp Math/CVector3.cpp Math/CVector4.cpp Utility/ThreadPool.cpp
+//     Utility/Clock.cpp -lpthread
+
+#include "FrustumCulling.h"
+#include "CMatrix4x4.h"
+#include "CVector4.h"
+#include "ThreadPool.h"
+#include "Clock.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+
+//--------------------------------------------------------------------------------------
+// Bounding volume checks
+//--------------------------------------------------------------------------------------
+
+// Slack for rounding when checking a point is inside a volume, relative to the size of the values
+const float BOUNDS_TOLERANCE = 1e-4f;
+
+static CMatrix4x4 RandomAffine(RandomGenerator& random)
+{
+	return MatrixScaling({ random.Range(0.2f, 5.0f), random.Range(0.2f, 5.0f), random.Range(0.2f, 5.0f) }) *
+	       MatrixRotationX(random.Range(-PI, PI)) * MatrixRotationY(random.Range(-PI, PI)) *
+	       MatrixRotationZ(random.Range(-PI, PI)) *
+	       MatrixTranslation({ random.Range(-100.0f, 100.0f), random.Range(-100.0f, 100.0f), random.Range(-100.0f, 100.0f) });
+}
+
+static CVector3 RandomPoint(RandomGenerator& random, float range)
+{
+	return { random.Range(-range, range), random.Range(-range, range), random.Range(-range, range) };
+}
+
+static CVector3 TransformPoint(const CVector3& point, const CMatrix4x4& m)
+{
+	CVector4 result = CVector4(point, 1) * m;
+	return { result.x, result.y, result.z };
+}
+
+static CVector3 Corner(const BoundingBox& box, int corner)
+{
+	return { (corner & 1) ? box.maximum.x : box.minimum.x, (corner & 2) ? box.maximum.y : box.minimum.y,
+	         (corner & 4) ? box.maximum.z : box.minimum.z };
+}
+
+static bool BoxHolds(const BoundingBox& box, const CVector3& point)
+{
+	float slack = BOUNDS_TOLERANCE * std::max({ 1.0f, Length(box.minimum), Length(box.maximum) });
+	return point.x >= box.minimum.x - slack && point.x <= box.maximum.x + slack &&
+	       point.y >= box.minimum.y - slack && point.y <= box.maximum.y + slack &&
+	       point.z >= box.minimum.z - slack && point.z <= box.maximum.z + slack;
+}
+
+static bool SphereHolds(const BoundingSphere& sphere, const CVector3& point)
+{
+	float slack = BOUNDS_TOLERANCE * std::max({ 1.0f, Length(sphere.centre), sphere.radius });
+	return Length(point - sphere.centre) <= sphere.radius + slack;
+}
+
+static bool Fail(const char* message)
+{
+	printf("  %s\n", message);
+	return false;
+}
+
+// Transforming, combining and building volumes from points, on random volumes
+static bool CheckBoundingVolumes(RandomGenerator& random)
+{
+	const int NUM_CHECKS = 1000;
+	for (int check = 0; check < NUM_CHECKS; ++check)
+	{
+		CVector3 a = RandomPoint(random, 50), b = RandomPoint(random, 50);
+		BoundingBox box = { { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) },
+		                    { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) } };
+		BoundingSphere sphere = { RandomPoint(random, 50), random.Range(0.0f, 20.0f) };
+		CMatrix4x4 m = RandomAffine(random);
+
+		BoundingBox transformedBox = TransformBox(box, m);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			if (!BoxHolds(transformedBox, TransformPoint(Corner(box, corner), m)))  return Fail("TransformBox lost a corner");
+		}
+		BoundingSphere transformedSphere = TransformSphere(sphere, m);
+		for (int point = 0; point < 8; ++point)
+		{
+			CVector3 surface = sphere.centre + Normalise(RandomPoint(random, 1)) * sphere.radius;
+			if (!SphereHolds(transformedSphere, TransformPoint(surface, m)))  return Fail("TransformSphere lost a point");
+		}
+
+		BoundingBox otherBox = TransformBox(box, RandomAffine(random));
+		BoundingBox combinedBox = Combine(box, otherBox);
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			if (!BoxHolds(combinedBox, Corner(box, corner)) || !BoxHolds(combinedBox, Corner(otherBox, corner)))
+			{
+				return Fail("Combined box lost a corner");
+			}
+		}
+		BoundingSphere otherSphere = { RandomPoint(random, 50), random.Range(0.0f, 20.0f) };
+		BoundingSphere combinedSphere = Combine(sphere, otherSphere);
+		for (int point = 0; point < 8; ++point)
+		{
+			// The first points are on the line through the centres, where the far sides of the spheres are
+			CVector3 direction = Normalise(RandomPoint(random, 1));
+			if (point < 2 && Length(otherSphere.centre - sphere.centre) > 0)
+			{
+				direction = Normalise(otherSphere.centre - sphere.centre) * (point == 0 ? 1.0f : -1.0f);
+			}
+			if (!SphereHolds(combinedSphere, sphere.centre + direction * sphere.radius) ||
+			    !SphereHolds(combinedSphere, otherSphere.centre + direction * otherSphere.radius))
+			{
+				return Fail("Combined sphere lost a point");
+			}
+		}
+
+		// Interleaved as mesh vertices are, position then other values
+		std::vector<float> vertices;
+		int numPoints = static_cast<int>(random.Range(1u, 64u));
+		for (int point = 0; point < numPoints; ++point)
+		{
+			CVector3 position = TransformPoint(RandomPoint(random, 10), m);
+			vertices.insert(vertices.end(), { position.x, position.y, position.z, random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f) });
+		}
+		BoundingBox    pointsBox    = BoxOfPoints(vertices.data(), 5 * sizeof(float), numPoints);
+		BoundingSphere pointsSphere = SphereOfPoints(vertices.data(), 5 * sizeof(float), numPoints);
+		for (int point = 0; point < numPoints; ++point)
+		{
+			CVector3 position = { vertices[point * 5], vertices[point * 5 + 1], vertices[point * 5 + 2] };
+			if (!BoxHolds(pointsBox, position) || !SphereHolds(pointsSphere, position))  return Fail("Bounds of points lost a point");
+		}
+	}
+
+	// Empty volumes
+	BoundingBox box = { { -1, -1, -1 }, { 1, 1, 1 } };
+	BoundingSphere sphere = { { 1, 2, 3 }, 4 };
+	if (!IsEmpty(EmptyBoundingBox()) || IsEmpty(box))  return Fail("IsEmpty wrong");
+	if (!IsEmpty(TransformBox(EmptyBoundingBox(), RandomAffine(random))))  return Fail("Transformed empty box not empty");
+	BoundingBox combined = Combine(EmptyBoundingBox(), box);
+	if (memcmp(&combined, &box, sizeof(box)) != 0)  return Fail("Combining with an empty box changed the box");
+	BoundingSphere combinedSphere = Combine(sphere, EmptyBoundingSphere());
+	if (memcmp(&combinedSphere, &sphere, sizeof(sphere)) != 0)  return Fail("Combining with an empty sphere changed the sphere");
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Scenes
+//--------------------------------------------------------------------------------------
+
+// A camera as Camera::UpdateMatrices sets it up, with a 60 degree field of view
+static CMatrix4x4 CameraViewProjection(const CVector3& position, const CVector3& rotation)
+{
+	const float fov = ToRadians(60.0f), aspectRatio = 16.0f / 9.0f, nearClip = 1.0f, farClip = 2000.0f;
+	CMatrix4x4 world = MatrixRotationZ(rotation.z) * MatrixRotationX(rotation.x) * MatrixRotationY(rotation.y) *
+	                   MatrixTranslation(position);
+	float tanFOVx = std::tan(fov * 0.5f);
+	float scaleZa = farClip / (farClip - nearClip);
+	CMatrix4x4 projection = { 1.0f / tanFOVx, 0.0f,                  0.0f,                 0.0f,
+	                          0.0f,           aspectRatio / tanFOVx, 0.0f,                 0.0f,
+	                          0.0f,           0.0f,                  scaleZa,              1.0f,
+	                          0.0f,           0.0f,                  -nearClip * scaleZa,  0.0f };
+	return InverseAffine(world) * projection;
+}
+
+// How far a clip space point is inside each side of the view, 0 <= z and -w <= x, y <= w. Negative when outside
+static void ClipMargins(const CVector3& point, const CMatrix4x4& viewProjection, float margins[6])
+{
+	CVector4 clip = CVector4(point, 1) * viewProjection;
+	margins[0] = clip.w + clip.x;  margins[1] = clip.w - clip.x;
+	margins[2] = clip.w + clip.y;  margins[3] = clip.w - clip.y;
+	margins[4] = clip.z;           margins[5] = clip.w - clip.z;
+}
+
+// Boxes of random sizes spread through the far clip distance around the camera, so most are out of view
+static std::vector<BoundingBox> MakeScene(int numObjects, const CVector3& cameraPosition, RandomGenerator& random)
+{
+	std::vector<BoundingBox> boxes(numObjects);
+	for (auto& box : boxes)
+	{
+		CVector3 centre = cameraPosition + RandomPoint(random, 2000);
+		CVector3 extent = { random.Range(0.5f, 20.0f), random.Range(0.5f, 20.0f), random.Range(0.5f, 20.0f) };
+		box = { centre - extent, centre + extent };
+	}
+	return boxes;
+}
+
+// Planes against clip space for random points, skipping points too close to a side to tell
+static bool CheckPlanes(const FrustumPlanes& planes, const CMatrix4x4& viewProjection, const CVector3& cameraPosition,
+                        RandomGenerator& random)
+{
+	for (int check = 0; check < 20000; ++check)
+	{
+		// Half the points close to the camera to check the near plane
+		CVector3 point = cameraPosition + RandomPoint(random, (check & 1) ? 2500.0f : 3.0f);
+		float margins[6];
+		ClipMargins(point, viewProjection, margins);
+		float nearest = *std::min_element(margins, margins + 6);
+		if (std::abs(nearest) < 1e-2f)  continue;
+
+		bool inside = IsBoxInFrustum(planes, { point, point });
+		if (inside != (nearest > 0))  return Fail(inside ? "Planes keep a point outside clip space" : "Planes cull a point inside clip space");
+	}
+	return true;
+}
+
+// Lists of each length up to a few SIMD widths, so every mix of eight, four and one at a time is used. The lists are
+// taken from boxes that are visible and boxes that are not, in a varying pattern
+static bool CheckListLengths(const FrustumPlanes& planes, const std::vector<BoundingBox>& boxes, RandomGenerator& random)
+{
+	const int MAX_LENGTH = 40;
+	std::vector<BoundingBox> visibleBoxes, hiddenBoxes;
+	for (auto& box : boxes)
+	{
+		auto& list = IsBoxInFrustum(planes, box) ? visibleBoxes : hiddenBoxes;
+		if (list.size() < MAX_LENGTH)  list.push_back(box);
+	}
+	std::vector<BoundingBox> mixed;
+	while (mixed.size() < MAX_LENGTH && !(visibleBoxes.empty() && hiddenBoxes.empty()))
+	{
+		bool takeVisible = hiddenBoxes.empty() || (!visibleBoxes.empty() && random.Range(0u, 1u) == 0);
+		auto& list = takeVisible ? visibleBoxes : hiddenBoxes;
+		mixed.push_back(list.back());
+		list.pop_back();
+	}
+
+	for (int length = 1; length <= static_cast<int>(mixed.size()); ++length)
+	{
+		BoundingBoxes list;
+		for (int i = 0; i < length; ++i)  list.Add(mixed[i]);
+
+		std::vector<uint8_t> visible(length, 0xff);
+		int numVisible = CullBoxes(planes, list, visible.data());
+		int numExpected = 0;
+		for (int i = 0; i < length; ++i)
+		{
+			uint8_t expected = IsBoxInFrustum(planes, mixed[i]) ? 1 : 0;
+			numExpected += expected;
+			if (visible[i] != expected)  return Fail("Short box list differs from IsBoxInFrustum");
+		}
+		if (numVisible != numExpected)  return Fail("Short box list counted the wrong number visible");
+	}
+	return true;
+}
+
+// Culled boxes must have all corners outside one side of clip space, and boxes with a corner inside must be kept
+static bool CheckConservative(const std::vector<BoundingBox>& boxes, const uint8_t* visible, const CMatrix4x4& viewProjection)
+{
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		float margins[8][6];
+		for (int corner = 0; corner < 8; ++corner)  ClipMargins(Corner(boxes[i], corner), viewProjection, margins[corner]);
+
+		bool cornerInside = false;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			if (*std::min_element(margins[corner], margins[corner] + 6) > 1e-2f)  cornerInside = true;
+		}
+		bool allOutsideOneSide = false;
+		for (int side = 0; side < 6; ++side)
+		{
+			bool outside = true;
+			for (int corner = 0; corner < 8; ++corner)  outside = outside && margins[corner][side] < 1e-2f;
+			allOutsideOneSide = allOutsideOneSide || outside;
+		}
+
+		if (cornerInside && !visible[i])  return Fail("Culled a box with a corner in view");
+		if (!visible[i] && !allOutsideOneSide)  return Fail("Culled a box that is not outside one side of the view");
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Timing
+//--------------------------------------------------------------------------------------
+
+// Fastest of the repetitions in milliseconds
+template <typename Function>
+static double TimeCulling(int repetitions, Function function)
+{
+	int64_t fastest = 0;
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+	{
+		int64_t start = ClockNanoseconds();
+		function();
+		int64_t time = ClockNanoseconds() - start;
+		if (repetition == 0 || time < fastest)  fastest = time;
+	}
+	return NanosecondsToSeconds(fastest) * 1000.0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Main
+//--------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)  end = list.size();
+		if (end > start)  items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<int> objectCounts = { 10000, 100000, 1000000 };
+	uint64_t seed = 1;
+	int repetitions = 5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--objects")
+		{
+			objectCounts.clear();
+			for (auto& count : SplitList(value))  objectCounts.push_back(std::max(1, atoi(count.c_str())));
+		}
+		else if (option == "--seed")         seed = strtoull(value.c_str(), nullptr, 10);
+		else if (option == "--repetitions")  repetitions = std::max(1, atoi(value.c_str()));
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	RandomGenerator random(seed);
+	ThreadPool threads;
+	ThreadPool checkThreads(4); // At least four threads, so splitting the lists is checked even with fewer cores
+
+	bool passed = CheckBoundingVolumes(random);
+	printf("Bounding volumes: %s\n\n", passed ? "ok" : "FAILED");
+
+	printf("Culling with %s, thread pool of %u threads\n\n", CullingInstructionSet(), threads.NumThreads());
+	printf("%8s | %-6s | %8s | %10s %10s %10s %10s | %9s\n", "Objects", "Check", "Visible",
+	       "Single ms", "Boxes ms", "Spheres ms", "Threads ms", "M boxes/s");
+
+	for (int numObjects : objectCounts)
+	{
+		CVector3 cameraPosition = RandomPoint(random, 100);
+		CMatrix4x4 viewProjection = CameraViewProjection(cameraPosition, { random.Range(-0.5f, 0.5f), random.Range(-PI, PI), 0 });
+		FrustumPlanes planes = FrustumPlanesFromMatrix(viewProjection);
+		std::vector<BoundingBox> sceneBoxes = MakeScene(numObjects, cameraPosition, random);
+
+		BoundingBoxes boxes;
+		BoundingSpheres spheres;
+		std::vector<BoundingSphere> sceneSpheres;
+		for (auto& box : sceneBoxes)
+		{
+			boxes.Add(box);
+			sceneSpheres.push_back({ (box.minimum + box.maximum) * 0.5f, Length(box.maximum - box.minimum) * 0.5f });
+			spheres.Add(sceneSpheres.back());
+		}
+
+		// Every version of the culling must agree exactly with the one at a time tests
+		// Filled with a value culling never writes, so any volume left out is seen
+		std::vector<uint8_t> single(numObjects), visible(numObjects, 0xff), threaded(numObjects, 0xff), sphereVisible(numObjects, 0xff);
+		int numVisible = CullBoxes(planes, boxes, visible.data());
+		int numThreaded = CullBoxes(planes, boxes, threaded.data(), &checkThreads);
+		int numSphereVisible = CullSpheres(planes, spheres, sphereVisible.data(), &checkThreads);
+
+		bool ok = CheckPlanes(planes, viewProjection, cameraPosition, random);
+		ok = CheckListLengths(planes, sceneBoxes, random) && ok;
+		int numSingle = 0, numSingleSpheres = 0;
+		for (int i = 0; i < numObjects; ++i)
+		{
+			single[i] = IsBoxInFrustum(planes, sceneBoxes[i]) ? 1 : 0;
+			numSingle += single[i];
+			numSingleSpheres += IsSphereInFrustum(planes, sceneSpheres[i]) ? 1 : 0;
+			if (sphereVisible[i] != (IsSphereInFrustum(planes, sceneSpheres[i]) ? 1 : 0))
+			{
+				ok = Fail("Sphere list differs from IsSphereInFrustum");
+				break;
+			}
+		}
+		if (visible != single || numVisible != numSingle)   ok = Fail("Box list differs from IsBoxInFrustum");
+		if (threaded != single || numThreaded != numSingle)  ok = Fail("Threaded box list differs from IsBoxInFrustum");
+		if (numSphereVisible != numSingleSpheres)            ok = Fail("Sphere list count differs from IsSphereInFrustum");
+		ok = CheckConservative(sceneBoxes, visible.data(), viewProjection) && ok;
+		passed = passed && ok;
+
+		double singleTime = TimeCulling(repetitions, [&]()
+		{
+			for (int i = 0; i < numObjects; ++i)  single[i] = IsBoxInFrustum(planes, sceneBoxes[i]) ? 1 : 0;
+		});
+		double boxesTime   = TimeCulling(repetitions, [&]() { CullBoxes(planes, boxes, visible.data()); });
+		double spheresTime = TimeCulling(repetitions, [&]() { CullSpheres(planes, spheres, sphereVisible.data()); });
+		double threadsTime = TimeCulling(repetitions, [&]() { CullBoxes(planes, boxes, threaded.data(), &threads); });
+
+		printf("%8d | %-6s | %7.1f%% | %10.3f %10.3f %10.3f %10.3f | %9.1f\n", numObjects, ok ? "ok" : "FAILED",
+		       100.0 * numVisible / numObjects, singleTime, boxesTime, spheresTime, threadsTime,
+		       numObjects / (std::min(boxesTime, threadsTime) * 1000.0));
+	}
+
+	printf("\nTimes are the fastest of %d culls of the whole scene: one box at a time with IsBoxInFrustum, then lists of\n"
+	       "boxes and spheres on one thread and boxes on the thread pool. Boxes a second are for the faster box list\n", repetitions);
+	printf("\n%s\n", passed ? "All checks passed" : "Some checks FAILED");
+	return passed ? 0 : 1;
+}
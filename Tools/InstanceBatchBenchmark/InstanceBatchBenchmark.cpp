@@ -0,0 +1,294 @@
+//--------------------------------------------------------------------------------------
+// Instance batch benchmark - checks what the instance batcher sends and draws for sets
+// of models sharing a mesh, and counts the draws and bytes it saves over rendering each
+// model alone
+//--------------------------------------------------------------------------------------
+// Usage: InstanceBatchBenchmark [options]
+//   --instances list    Numbers of instances in a set (default 10,100,1000,10000)
+//   --nodes n           Nodes in the mesh of the sets (default 3)
+//   --frames n          Frames to render each set for (default 60)
+//   --seed n            Seed for the matrices (default 1)
+// Lists are separated by commas. Returns 1 if any check fails.
+//
+// For each number of instances a static set and a dynamic set are made, with random matrices for each node of each
+// instance, and rendered three times a frame to a MemoryInstanceBackend: twice as Scene.cpp does (colour, then normals
+// and depth), which is timed, then once more to check it sends nothing new. The dynamic set is cleared and refilled each
+// frame with moved matrices, as the runs of the render queue are. Each render must:
+//   - draw each node once for all the instances, reading the instances of that node from the buffer
+//   - leave the buffer holding every matrix of every instance, in node order, as they were last added or set
+//   - send the static set once over all the frames, unless an instance is changed, and the dynamic set once a frame
+// An empty set must draw nothing. The draws and bytes of constants Model::Render would have taken for the same instances
+// are reported with the batcher's, and the time to render each set a frame, refilling it first if it is dynamic.
+//
+// Only needs the Math and Utility folders, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -IMath -IUtility Tools/InstanceBatchBenchmark/InstanceBatchBenchmark.cpp Utility/InstanceBatcher.cpp
+//     Utility/Clock.cpp
+
+#include "InstanceBatcher.h"
+#include "Clock.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+
+// Size of the per-model constants Model::Render sends for each draw, PerModelConstants in Common.h: the world matrix,
+// colour and padding then the bone matrices
+const int PER_MODEL_CONSTANTS_BYTES = 80 + 64 * 64;
+
+// Handle passed for the mesh of the sets, only compared
+static int gBenchmarkMesh;
+
+
+//--------------------------------------------------------------------------------------
+// Instances
+//--------------------------------------------------------------------------------------
+
+// Matrices of each node of each instance, instance order as they are added to a set
+static std::vector<CMatrix4x4> MakeInstances(int numInstances, int numNodes, RandomGenerator& random)
+{
+	// The batcher only copies matrices, so any 16 values will do
+	std::vector<CMatrix4x4> matrices(numInstances * numNodes);
+	for (auto& matrix : matrices)
+	{
+		float* values = &matrix.e00;
+		for (int i = 0; i < 16; ++i)  values[i] = random.Range(-100.0f, 100.0f);
+	}
+	return matrices;
+}
+
+// Move every instance a little, as a dynamic set's instances move from frame to frame
+static void MoveInstances(std::vector<CMatrix4x4>& matrices, RandomGenerator& random)
+{
+	for (auto& matrix : matrices)
+	{
+		matrix.e30 += random.Range(-1.0f, 1.0f);
+		matrix.e31 += random.Range(-1.0f, 1.0f);
+		matrix.e32 += random.Range(-1.0f, 1.0f);
+	}
+}
+
+static void AddInstances(InstanceBatcher& batcher, int set, const std::vector<CMatrix4x4>& matrices, int numNodes)
+{
+	for (size_t i = 0; i < matrices.size(); i += numNodes)  batcher.AddInstance(set, &matrices[i]);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Checks
+//--------------------------------------------------------------------------------------
+
+static bool SameMatrix(const CMatrix4x4& a, const CMatrix4x4& b)
+{
+	return memcmp(&a, &b, sizeof(CMatrix4x4)) == 0;
+}
+
+// Check the draws of one render of a set and what its buffer holds against the instances last given to it
+static bool CheckRender(const MemoryInstanceBackend& backend, int set, const std::vector<CMatrix4x4>& matrices,
+                        int numNodes, const char* name)
+{
+	int numInstances = static_cast<int>(matrices.size()) / numNodes;
+	const auto& draws = backend.Draws();
+	if (numInstances == 0)
+	{
+		if (draws.empty())  return true;
+		printf("  %s: %d draws of an empty set\n", name, static_cast<int>(draws.size()));
+		return false;
+	}
+
+	if (static_cast<int>(draws.size()) != numNodes)
+	{
+		printf("  %s: %d draws for a mesh of %d nodes\n", name, static_cast<int>(draws.size()), numNodes);
+		return false;
+	}
+	for (int node = 0; node < numNodes; ++node)
+	{
+		const RecordedInstanceDraw& draw = draws[node];
+		if (draw.set != set || draw.mesh != &gBenchmarkMesh || draw.node != node ||
+		    draw.firstInstance != node * numInstances || draw.numInstances != numInstances)
+		{
+			printf("  %s: draw %d is set %d node %d instances %d to %d, expected set %d node %d instances %d to %d\n", name,
+			       node, draw.set, draw.node, draw.firstInstance, draw.firstInstance + draw.numInstances - 1,
+			       set, node, node * numInstances, (node + 1) * numInstances - 1);
+			return false;
+		}
+	}
+
+	const std::vector<CMatrix4x4>& buffer = backend.Buffer(set);
+	if (buffer.size() != matrices.size())
+	{
+		printf("  %s: buffer holds %d matrices, expected %d\n", name, static_cast<int>(buffer.size()),
+		       static_cast<int>(matrices.size()));
+		return false;
+	}
+	for (int instance = 0; instance < numInstances; ++instance)
+	{
+		for (int node = 0; node < numNodes; ++node)
+		{
+			if (!SameMatrix(buffer[node * numInstances + instance], matrices[instance * numNodes + node]))
+			{
+				printf("  %s: buffer has the wrong matrix for node %d of instance %d\n", name, node, instance);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool CheckUploads(int uploads, int expected, const char* name)
+{
+	if (uploads == expected)  return true;
+	printf("  %s: sent %d times, expected %d\n", name, uploads, expected);
+	return false;
+}
+
+// Render a set for the colour and the normals and depth passes of a frame, checking each render. Returns false if a
+// check fails
+static bool RenderFrame(InstanceBatcher& batcher, MemoryInstanceBackend& backend, int set,
+                        const std::vector<CMatrix4x4>& matrices, int numNodes, const char* name)
+{
+	bool ok = true;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		backend.ClearDraws();
+		if (!batcher.Render(set))
+		{
+			printf("  %s: %s\n", name, batcher.LastError().c_str());
+			return false;
+		}
+		ok = CheckRender(backend, set, matrices, numNodes, name) && ok;
+	}
+	return ok;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Main
+//--------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)  end = list.size();
+		if (end > start)  items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<int> instanceCounts = { 10, 100, 1000, 10000 };
+	int numNodes  = 3;
+	int numFrames = 60;
+	uint64_t seed = 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--instances")
+		{
+			instanceCounts.clear();
+			for (auto& count : SplitList(value))  instanceCounts.push_back(std::max(1, atoi(count.c_str())));
+		}
+		else if (option == "--nodes")   numNodes  = std::max(1, atoi(value.c_str()));
+		else if (option == "--frames")  numFrames = std::max(2, atoi(value.c_str()));
+		else if (option == "--seed")    seed = strtoull(value.c_str(), nullptr, 10);
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	RandomGenerator random(seed);
+	bool passed = true;
+
+	printf("Sets of a mesh of %d nodes rendered three times a frame (two timed, one to check) for %d frames\n\n",
+	       numNodes, numFrames);
+	printf("%9s | %-7s | %-6s | %19s | %25s | %7s | %11s\n", "Instances", "Usage", "Check",
+	       "Draws (as models)", "KB sent (as models)", "Sends", "ms a frame");
+
+	for (int numInstances : instanceCounts)
+	{
+		for (InstanceUsage usage : { InstanceUsage::Static, InstanceUsage::Dynamic })
+		{
+			MemoryInstanceBackend backend;
+			InstanceBatcher batcher(&backend, PER_MODEL_CONSTANTS_BYTES);
+			const char* name = InstanceUsageName(usage);
+
+			// An empty set first, so the set being checked is not set 0
+			int emptySet = batcher.AddSet(&gBenchmarkMesh, numNodes, usage);
+			int set = batcher.AddSet(&gBenchmarkMesh, numNodes, usage);
+			std::vector<CMatrix4x4> matrices = MakeInstances(numInstances, numNodes, random);
+			AddInstances(batcher, set, matrices, numNodes);
+			bool ok = RenderFrame(batcher, backend, emptySet, {}, numNodes, "Empty set");
+
+			int uploads = 0;
+			int64_t frameTime = 0;
+			for (int frame = 0; frame < numFrames; ++frame)
+			{
+				int64_t start = ClockNanoseconds();
+				if (usage == InstanceUsage::Dynamic)
+				{
+					MoveInstances(matrices, random);
+					batcher.ClearInstances(set);
+					AddInstances(batcher, set, matrices, numNodes);
+				}
+				for (int pass = 0; pass < 2; ++pass)
+				{
+					backend.ClearDraws();
+					batcher.Render(set);
+				}
+				frameTime += ClockNanoseconds() - start;
+
+				// The timed renders are checked with one more render, which must not send the set again
+				ok = CheckRender(backend, set, matrices, numNodes, name) && ok;
+				backend.ClearDraws();
+				batcher.Render(set);
+				ok = CheckRender(backend, set, matrices, numNodes, name) && ok;
+				batcher.EndFrame();
+				uploads += batcher.Stats().uploads;
+				if (usage == InstanceUsage::Dynamic)  ok = CheckUploads(batcher.Stats().uploads, 1, "Dynamic frame") && ok;
+			}
+			ok = CheckUploads(uploads, usage == InstanceUsage::Static ? 1 : numFrames, name) && ok;
+			InstanceBatchStats stats = batcher.Stats();
+
+			// Changing an instance of a static set sends it again, once
+			std::vector<CMatrix4x4> changed = MakeInstances(1, numNodes, random);
+			int instance = numInstances / 2;
+			std::copy(changed.begin(), changed.end(), matrices.begin() + instance * numNodes);
+			batcher.SetInstance(set, instance, changed.data());
+			ok = RenderFrame(batcher, backend, set, matrices, numNodes, "Changed instance") && ok;
+			batcher.EndFrame();
+			ok = CheckUploads(batcher.Stats().uploads, 1, "Changed instance") && ok;
+
+			passed = passed && ok;
+			printf("%9d | %-7s | %-6s | %8lld (%8lld) | %11.1f (%11.1f) | %7d | %11.4f\n", numInstances, name,
+			       ok ? "ok" : "FAILED", stats.totalDraws, stats.totalModelDraws, stats.totalUploadedBytes / 1024.0,
+			       stats.totalModelUploadedBytes / 1024.0, uploads, NanosecondsToSeconds(frameTime) * 1000.0 / numFrames);
+		}
+	}
+
+	printf("\nDraws and KB are totals over all the frames, three renders a frame, then in brackets the draws and per-model\n"
+	       "constants Model::Render would take for the same instances (%d bytes a draw). Sends are the times the set's\n"
+	       "matrices went to its buffer. Frame times are for rendering a set twice, refilling it first if it is dynamic\n",
+	       PER_MODEL_CONSTANTS_BYTES);
+	printf("\n%s\n", passed ? "All checks passed" : "Some checks FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+//--------------------------------------------------------------------------------------
+// Matrix maths benchmark - times the scalar, SIMD and aligned SIMD versions of the
+// CMatrix4x4 operations and checks they agree
+//--------------------------------------------------------------------------------------
+// Usage: MathBenchmark [count] [repeats] [batch count]
+// Each operation is run over count matrices (default 4096), repeats times (default 200), and the fastest run is
+// reported as nanoseconds per operation. Counts much above 16384 no longer fit in cache and time memory rather than
+// maths. Build Release to get meaningful times. The project builds with AVX (/arch:AVX) so the AVX multiplication is
+// timed, the instructions used are reported first
+//
+// The batch transforms (TransformBatch.h) are then compared with one-at-a-time operator* over batch count points and
+// matrices (default 1048576), large enough to use streaming stores, on one thread and on a thread pool
+
+#include "CMatrix4x4.h"
+#include "TransformBatch.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+
+//--------------------------------------------------------------------------------------
+// Test data
+//--------------------------------------------------------------------------------------
+
+// A random affine matrix - scale, rotation and translation as models and cameras use
+static CMatrix4x4 RandomAffine()
+{
+	return MatrixScaling({ Random(0.5f, 2.0f), Random(0.5f, 2.0f), Random(0.5f, 2.0f) }) *
+	       MatrixRotationX(Random(-PI, PI)) * MatrixRotationY(Random(-PI, PI)) * MatrixRotationZ(Random(-PI, PI)) *
+	       MatrixTranslation({ Random(-100.0f, 100.0f), Random(-100.0f, 100.0f), Random(-100.0f, 100.0f) });
+}
+
+// A random affine matrix followed by a projection, so it has no affine shortcut
+static CMatrix4x4 RandomProjective()
+{
+	CMatrix4x4 projection = MatrixIdentity();
+	projection.e00 = Random(0.5f, 2.0f);
+	projection.e11 = Random(0.5f, 2.0f);
+	projection.e22 = Random(1.0f, 1.1f);
+	projection.e23 = 1.0f;
+	projection.e32 = Random(-1.0f, -0.1f);
+	projection.e33 = 0.0f;
+	return RandomAffine() * projection;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Timing
+//--------------------------------------------------------------------------------------
+
+// Fastest of the given number of runs of a function, in nanoseconds per operation
+template <typename Function>
+static double Time(int count, int repeats, Function function)
+{
+	double best = 1e30;
+	for (int repeat = 0; repeat < repeats; ++repeat)
+	{
+		auto start = std::chrono::steady_clock::now();
+		function();
+		std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+		best = std::min(best, time.count() / count);
+	}
+	return best;
+}
+
+static void Report(const char* name, double scalar, double simd, double aligned)
+{
+	if (aligned > 0)  printf("%-16s %8.2f %8.2f %8.2f   %5.2fx %5.2fx\n", name, scalar, simd, aligned, scalar / simd, scalar / aligned);
+	else              printf("%-16s %8.2f %8.2f %8s   %5.2fx\n", name, scalar, simd, "-", scalar / simd);
+}
+
+// Largest difference between two sets of matrices, relative to the size of the element for elements above 1
+static float MaxDifference(const CMatrix4x4* a, const CMatrix4x4* b, int count)
+{
+	float maxDifference = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		for (int e = 0; e < 16; ++e)
+		{
+			float difference = std::abs((&a[i].e00)[e] - (&b[i].e00)[e]) / std::max(1.0f, std::abs((&b[i].e00)[e]));
+			maxDifference = std::max(maxDifference, difference);
+		}
+	}
+	return maxDifference;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Main
+//--------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	int count   = (argc > 1 ? std::max(1, atoi(argv[1])) : 4096);
+	int repeats = (argc > 2 ? std::max(1, atoi(argv[2])) : 200);
+	int batchCount = (argc > 3 ? std::max(1, atoi(argv[3])) : 1048576);
+	SeedRandom(12345); // Same matrices every run
+
+	std::vector<CMatrix4x4>  a(count), b(count), projective(count), result(count), check(count);
+	std::vector<CMatrix4x4A> aAligned(count), bAligned(count), resultAligned(count);
+	std::vector<CVector4>    v(count), vResult(count), vCheck(count);
+	std::vector<CVector4A>   vAligned(count), vResultAligned(count);
+	for (int i = 0; i < count; ++i)
+	{
+		a[i] = aAligned[i] = RandomAffine();
+		b[i] = bAligned[i] = RandomAffine();
+		projective[i] = RandomProjective();
+		v[i] = vAligned[i] = CVector4(Random(-100.0f, 100.0f), Random(-100.0f, 100.0f), Random(-100.0f, 100.0f), 1.0f);
+	}
+
+	printf("%d matrices, best of %d runs, ns per operation, SIMD with %s\n\n", count, repeats, MatrixInstructionSet());
+	printf("%-16s %8s %8s %8s   %6s %6s\n", "", "Scalar", "SIMD", "Aligned", "SIMD", "Aligned");
+
+	// Multiplication
+	double scalar  = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = MatrixMultiplyScalar(a[i], b[i]); });
+	double simd    = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = a[i] * b[i]; });
+	double aligned = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  resultAligned[i] = aAligned[i] * bAligned[i]; });
+	Report("Multiply", scalar, simd, aligned);
+	for (int i = 0; i < count; ++i)  check[i] = MatrixMultiplyScalar(a[i], b[i]);
+	bool multiplyExact = memcmp(result.data(), check.data(), count * sizeof(CMatrix4x4)) == 0;
+	for (int i = 0; i < count; ++i)  multiplyExact = multiplyExact && memcmp(&resultAligned[i], &check[i], sizeof(CMatrix4x4)) == 0;
+
+	// Vector transform
+	scalar  = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  vResult[i] = TransformScalar(v[i], a[i]); });
+	simd    = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  vResult[i] = v[i] * a[i]; });
+	aligned = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  vResultAligned[i] = vAligned[i] * aAligned[i]; });
+	Report("Transform", scalar, simd, aligned);
+	for (int i = 0; i < count; ++i)  vCheck[i] = TransformScalar(v[i], a[i]);
+	bool transformExact = memcmp(vResult.data(), vCheck.data(), count * sizeof(CVector4)) == 0;
+	for (int i = 0; i < count; ++i)  transformExact = transformExact && memcmp(&vResultAligned[i], &vCheck[i], sizeof(CVector4)) == 0;
+
+	// Affine inverse
+	scalar = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = InverseAffineScalar(a[i]); });
+	simd   = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = InverseAffine(a[i]); });
+	Report("InverseAffine", scalar, simd, 0);
+	for (int i = 0; i < count; ++i)  check[i] = InverseAffineScalar(a[i]);
+	bool inverseAffineExact = memcmp(result.data(), check.data(), count * sizeof(CMatrix4x4)) == 0;
+
+	// General inverse
+	scalar = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = InverseScalar(projective[i]); });
+	simd   = Time(count, repeats, [&]() { for (int i = 0; i < count; ++i)  result[i] = Inverse(projective[i]); });
+	Report("Inverse", scalar, simd, 0);
+	for (int i = 0; i < count; ++i)  check[i] = InverseScalar(projective[i]);
+	float inverseDifference = MaxDifference(result.data(), check.data(), count);
+
+
+	// Batch transforms
+	ThreadPool threads;
+	int batchRepeats = std::max(1, repeats / 20);
+	std::vector<CVector3>   points(batchCount);
+	std::vector<float>      pointsX(batchCount), pointsY(batchCount), pointsZ(batchCount);
+	std::vector<CVector4A>  pointsOut(batchCount);
+	std::vector<float>      outX(batchCount), outY(batchCount), outZ(batchCount), outW(batchCount);
+	std::vector<CMatrix4x4A> matrices(batchCount), matricesOut(batchCount);
+	for (int i = 0; i < batchCount; ++i)
+	{
+		points[i] = { Random(-100.0f, 100.0f), Random(-100.0f, 100.0f), Random(-100.0f, 100.0f) };
+		pointsX[i] = points[i].x;  pointsY[i] = points[i].y;  pointsZ[i] = points[i].z;
+		matrices[i] = a[i % count];
+	}
+	const CMatrix4x4 viewProjection = projective[0];
+
+	printf("\n%d item batches, best of %d runs, ns per item\n\n", batchCount, batchRepeats);
+	printf("%-16s %8s %8s %8s   %6s %6s\n", "", "Single", "Batch", "Threads", "Batch", "Threads");
+
+	double single  = Time(batchCount, batchRepeats, [&]() { for (int i = 0; i < batchCount; ++i)  pointsOut[i] = CVector4(points[i], 1) * viewProjection; });
+	double batch   = Time(batchCount, batchRepeats, [&]() { TransformPoints(points.data(), pointsOut.data(), batchCount, viewProjection); });
+	double batchMT = Time(batchCount, batchRepeats, [&]() { TransformPoints(points.data(), pointsOut.data(), batchCount, viewProjection, &threads); });
+	Report("Points", single, batch, batchMT);
+	bool batchExact = true;
+	for (int i = 0; i < batchCount; ++i)
+	{
+		CVector4 expected = CVector4(points[i], 1) * viewProjection;
+		batchExact = batchExact && memcmp(&expected, &pointsOut[i], sizeof(CVector4)) == 0;
+	}
+
+	batch   = Time(batchCount, batchRepeats, [&]() { TransformPointsSoA(pointsX.data(), pointsY.data(), pointsZ.data(), outX.data(), outY.data(), outZ.data(), outW.data(), batchCount, viewProjection); });
+	batchMT = Time(batchCount, batchRepeats, [&]() { TransformPointsSoA(pointsX.data(), pointsY.data(), pointsZ.data(), outX.data(), outY.data(), outZ.data(), outW.data(), batchCount, viewProjection, &threads); });
+	Report("Points SoA", single, batch, batchMT);
+	for (int i = 0; i < batchCount; ++i)
+	{
+		CVector4 expected = CVector4(points[i], 1) * viewProjection;
+		batchExact = batchExact && expected.x == outX[i] && expected.y == outY[i] && expected.z == outZ[i] && expected.w == outW[i];
+	}
+
+	single  = Time(batchCount, batchRepeats, [&]() { for (int i = 0; i < batchCount; ++i)  matricesOut[i] = matrices[i] * viewProjection; });
+	batch   = Time(batchCount, batchRepeats, [&]() { MultiplyMatrices(matrices.data(), viewProjection, matricesOut.data(), batchCount); });
+	batchMT = Time(batchCount, batchRepeats, [&]() { MultiplyMatrices(matrices.data(), viewProjection, matricesOut.data(), batchCount, &threads); });
+	Report("Matrices", single, batch, batchMT);
+	for (int i = 0; i < batchCount; ++i)
+	{
+		CMatrix4x4 expected = matrices[i] * viewProjection;
+		batchExact = batchExact && memcmp(&expected, &matricesOut[i], sizeof(CMatrix4x4)) == 0;
+	}
+
+	printf("\nMultiply matches scalar exactly: %s\n", multiplyExact ? "yes" : "NO");
+	printf("Transform matches scalar exactly: %s\n", transformExact ? "yes" : "NO");
+	printf("InverseAffine matches scalar exactly: %s\n", inverseAffineExact ? "yes" : "NO");
+	printf("Inverse largest difference from scalar: %g\n", inverseDifference);
+	printf("Batches match one at a time exactly: %s\n", batchExact ? "yes" : "NO");
+
+	return (multiplyExact && transformExact && inverseAffineExact && batchExact) ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// Mesh converter - imports a mesh file with assimp and saves it as a binary mesh file
+//--------------------------------------------------------------------------------------
+// Usage: MeshConverter [--tangents] input [output]
+// The input can be any file type assimp supports. The output defaults to the cooked file name the app looks for
+// (CookedMeshFileName, e.g. Troll.x.mesh) so the app loads it instead of importing the input. Name a .mesh output to
+// have the app load it directly, e.g. new Mesh("Troll.mesh"). Pass --tangents for meshes the app loads with tangents.
+// The written file is read back to check it
+
+#include "MeshData.h"
+#include "MeshFile.h"
+
+#include <stdexcept>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+
+int main(int argc, char* argv[])
+{
+	bool requireTangents = false;
+	std::string input, output;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--tangents") == 0)  requireTangents = true;
+		else if (input.empty())                   input = argv[i];
+		else if (output.empty())                  output = argv[i];
+	}
+	if (input.empty())
+	{
+		printf("Usage: MeshConverter [--tangents] input [output]\n");
+		return 1;
+	}
+	if (output.empty())  output = CookedMeshFileName(input);
+
+	MeshData data;
+	try
+	{
+		ImportMesh(input, requireTangents, data);
+	}
+	catch (std::runtime_error& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	// Only a cooked file records the source file, a file loaded directly doesn't need to be checked against it
+	MeshFile meshFile;
+	if (!meshFile.Write(output, data, requireTangents, output == CookedMeshFileName(input) ? input : ""))
+	{
+		printf("%s\n", meshFile.LastError().c_str());
+		return 1;
+	}
+
+	MeshData check;
+	if (!meshFile.Read(output, check))
+	{
+		printf("%s\n", meshFile.LastError().c_str());
+		return 1;
+	}
+
+	unsigned int numVertices = 0, numIndices = 0;
+	for (auto& subMesh : check.subMeshes)
+	{
+		numVertices += subMesh.numVertices;
+		numIndices  += subMesh.numIndices;
+	}
+	printf("%s -> %s: %u nodes, %u sub-meshes, %u vertices, %u triangles%s%s\n", input.c_str(), output.c_str(),
+	       static_cast<unsigned int>(check.nodes.size()), static_cast<unsigned int>(check.subMeshes.size()),
+	       numVertices, numIndices / 3, check.hasBones ? ", skinned" : "", requireTangents ? ", tangents" : "");
+	return 0;
+}
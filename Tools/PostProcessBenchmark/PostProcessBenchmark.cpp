@@ -0,0 +1,733 @@
+//--------------------------------------------------------------------------------------
+// Post-process benchmark - times every post-process on the CPU engine at a range of
+// image sizes, modes, settings and thread counts
+//--------------------------------------------------------------------------------------
+// Usage: PostProcessBenchmark [options]
+//   --resolutions list  Image sizes to run at from 720p, 1080p, 1440p, 4k and 8k, or WxH (default all five)
+//   --effects list      Post-processes to run by name, e.g. BlurX,Bloom (default Copy to Selection)
+//   --modes list        From fullscreen, area and polygon (default all)
+//   --methods list      From fast and shader, see ProcessMethod in PostProcessEngine.h (default fast). Only changes
+//                       the post-processes with a fast version
+//   --threads list      Thread counts to run with, "max" for all cores or "scaling" for 1, 2, 4... up to all cores
+//                       (default max)
+//   --warmup n          Untimed runs before timing each case (default 2)
+//   --repetitions n     Timed runs of each case, the median is reported (default 5)
+//   --json file         Write the results as JSON
+//   --baseline file     Compare with results written earlier with --json
+//   --threshold percent Slow-down over the baseline reported as a regression (default 10)
+// Lists are separated by commas. Returns 2 if any case has regressed compared to the baseline, 1 on error.
+//
+// Each post-process is applied on its own from a synthetic scene, with the normal/depth and focused object maps and
+// noise textures it needs, using PostProcessEngine::Apply. Settings that change the amount of work are run over the
+// range UpdateScene in Scene.cpp can produce, e.g. blur and dilation sizes and the number of diagonal bloom blurs
+// (gTempDiagonalBlurs). Times are per call, so area and polygon cases include copying the rest of the image, and
+// throughput is given for the whole image in megapixels per second and nanoseconds per pixel.
+//
+// Images are RGBA floats, so 8K needs about 4GB of memory. Build Release to get meaningful times.
+//
+// Only needs the Math, Utility and PostProcess folders, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -pthread -IMath -IUtility -IPostProcess Tools/PostProcessBenchmark/PostProcessBenchmark.cpp
+//     PostProcess/*.cpp Utility/ThreadPool.cpp Utility/Clock.cpp Math/*.cpp
+
+#include "PostProcessEngine.h"
+#include "Clock.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+
+//--------------------------------------------------------------------------------------
+// Cases
+//--------------------------------------------------------------------------------------
+
+struct Resolution
+{
+	std::string name;
+	int width;
+	int height;
+};
+
+static const Resolution RESOLUTIONS[] =
+{
+	{ "720p",  1280,  720 },
+	{ "1080p", 1920, 1080 },
+	{ "1440p", 2560, 1440 },
+	{ "4k",    3840, 2160 },
+	{ "8k",    7680, 4320 },
+};
+
+
+// One group of settings for a post-process, e.g. a blur size. The function changes the settings from the defaults
+struct Settings
+{
+	std::string name; // e.g. "blur 0.03", empty for the defaults
+	std::function<void(PostProcessingConstants&, PostProcessEngine&, int width, int height)> apply;
+};
+
+// One post-process to time with one group of settings
+struct BenchmarkCase
+{
+	PostProcessType type;
+	PostProcessMode mode;
+	ProcessMethod   method;
+	bool            hasMethod; // Whether the post-process has a fast version, so the method is part of the name
+	Settings        settings;
+
+	std::string Name() const
+	{
+		std::string name = std::string(PostProcessTypeName(type)) + " " + PostProcessModeName(mode);
+		if (hasMethod)  name += (method == ProcessMethod::Fast) ? " fast" : " shader";
+		if (!settings.name.empty())  name += ", " + settings.name;
+		return name;
+	}
+};
+
+
+// Settings at the values UpdateScene starts with
+static PostProcessingConstants DefaultConstants(int width, int height)
+{
+	PostProcessingConstants c = {};
+	c.tintColour = { 1, 0, 0 };
+	c.copyAlpha = 0.5f;
+	c.noiseScale = { width / 140.0f, height / 140.0f };
+	c.noiseOffset = { 0.3f, 0.7f };
+	c.burnHeight = 0.5f;
+	c.distortLevel = 0.03f;
+	c.spiralLevel = 4.0f;
+	c.heatHazeTimer = 1.0f;
+	c.gradientHue = { 0.5f, 0.0f };
+	c.hueShift = 0.25f;
+	c.blurSize = { 0.03f, 0.03f };
+	c.standardDeviationSquared = 5.2f * 5.2f;
+	c.underwaterHue = 0.6f;
+	c.underwaterBrightness = { 1.1f, 0.75f };
+	c.wobbleStrength = 0.005f;
+	c.wobbleTimer = 1.0f;
+	c.pixelNumber = { width / 8.0f, height / 8.0f };
+	c.pixelBrightnessHueShift = 0.3f;
+	c.pixelBrightnessLevels = 12.0f;
+	c.pixelSaturationMin = 0.8f;
+	c.pixelSaturationLevels = 2.0f;
+	c.pixelHueRange = { 160.0f / 360.0f, 305.0f / 360.0f };
+	c.pixelHueLevels = 7.0f;
+	c.bloomThreshold = 0.9f;
+	c.bloomIntensity = 1.2f;
+	c.bloomLevelScale = 1.0f;
+	c.directionalBlurSize = 0.55f;
+	c.directionalBlurX = 1.0f;
+	c.directionalBlurY = 0.0f;
+	c.directionalBlurIntensity = 0.6f;
+	c.colourOffset = { 0.011f, 0.0f, -0.011f };
+	c.outlineThreshold = 0.12f;
+	c.outlineThickness = 0.0012f;
+	c.dilationSize = { 0.01f, 0.01f };
+	c.dilationType = 1.0f;
+	c.dilationThreshold = { 0.05f, 0.5f };
+	c.focalPlane = 0.2f;
+	c.nearPlane = 0.05f;
+	c.farPlane = 0.35f;
+	c.frostedGlassFrequency = 0.1f;
+	c.frostedGlassoffsetSize = { 0.01f, 0.01f };
+	return c;
+}
+
+
+static std::string FormatSetting(const char* name, float value)
+{
+	char text[64];
+	snprintf(text, sizeof(text), "%s %g", name, value);
+	return text;
+}
+
+// The groups of settings to time a post-process with, covering the range UpdateScene can produce for the settings
+// that change the amount of work. Post-processes whose cost doesn't depend on their settings have just the defaults
+static std::vector<Settings> EffectSettings(PostProcessType type)
+{
+	std::vector<Settings> settings;
+	switch (type)
+	{
+	case PostProcessType::BlurX:
+	case PostProcessType::BlurY:
+		// Starts at 0.03, Y/U change it from 0 upwards
+		for (float size : { 0.0f, 0.03f, 0.1f })
+		{
+			settings.push_back({ FormatSetting("blur", size), [size](PostProcessingConstants& c, PostProcessEngine&, int, int)
+			{
+				c.blurSize = { size, size };
+			} });
+		}
+		break;
+
+	case PostProcessType::Retro:
+		// Pixel size from 1 upwards, starts at 8
+		for (float pixelSize : { 1.0f, 8.0f, 32.0f })
+		{
+			settings.push_back({ FormatSetting("pixel", pixelSize), [pixelSize](PostProcessingConstants& c, PostProcessEngine&, int width, int height)
+			{
+				c.pixelNumber = { width / pixelSize, height / pixelSize };
+			} });
+		}
+		break;
+
+	case PostProcessType::DirectionalBlur:
+		// gTempTimer moves the size between 0.15 and 0.95
+		for (float size : { 0.15f, 0.95f })
+		{
+			settings.push_back({ FormatSetting("size", size), [size](PostProcessingConstants& c, PostProcessEngine&, int, int)
+			{
+				c.directionalBlurSize = size;
+			} });
+		}
+		break;
+
+	case PostProcessType::Bloom:
+		// Both ways of building the bloom texture, with gTempDiagonalBlurs from 0 to 20 (starts at 3)
+		for (BloomMode bloomMode : { BloomMode::FullResolution, BloomMode::Pyramid })
+		{
+			for (int diagonalBlurs : { 0, 3, 20 })
+			{
+				settings.push_back({ std::string(BloomModeName(bloomMode)) + ", " + FormatSetting("diagonals", static_cast<float>(diagonalBlurs)),
+				                     [bloomMode, diagonalBlurs](PostProcessingConstants&, PostProcessEngine& engine, int, int)
+				{
+					engine.SetBloomMode(bloomMode);
+					engine.SetDiagonalBlurs(diagonalBlurs);
+				} });
+			}
+		}
+		break;
+
+	case PostProcessType::Dilation:
+		// Size from 0 to 0.05 (starts at 0.01), Q cycles the type through 0, 1 and 2
+		for (float dilationType : { 0.0f, 1.0f, 2.0f })
+		{
+			for (float size : { 0.0f, 0.01f, 0.05f })
+			{
+				settings.push_back({ FormatSetting("type", dilationType) + ", " + FormatSetting("size", size),
+				                     [dilationType, size](PostProcessingConstants& c, PostProcessEngine&, int, int)
+				{
+					c.dilationType = dilationType;
+					c.dilationSize = { size, size };
+				} });
+			}
+		}
+		break;
+
+	case PostProcessType::DepthOfField:
+		// Distance from the focal plane to the near and far planes, from 0.02 to 0.5 (starts at 0.15)
+		for (float planeDistance : { 0.02f, 0.15f, 0.5f })
+		{
+			settings.push_back({ FormatSetting("planes", planeDistance), [planeDistance](PostProcessingConstants& c, PostProcessEngine&, int, int)
+			{
+				c.nearPlane = Clamp(c.focalPlane - planeDistance);
+				c.farPlane  = Clamp(c.focalPlane + planeDistance);
+			} });
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if (settings.empty())  settings.push_back({ "", nullptr });
+	return settings;
+}
+
+
+// Whether the engine has a fast version of a post-process, so the method changes how it is calculated
+static bool HasFastVersion(PostProcessType type)
+{
+	return type == PostProcessType::BlurX || type == PostProcessType::BlurY || type == PostProcessType::Dilation ||
+	       type == PostProcessType::DepthOfField || type == PostProcessType::Bloom;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Test images
+//--------------------------------------------------------------------------------------
+
+// Repeatable pseudo-random value from 0 to 1 for integer coordinates
+static float HashNoise(int x, int y, uint32_t seed)
+{
+	uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return (h & 0xffffff) / static_cast<float>(0xffffff);
+}
+
+// A noise texture like Noise.png etc. The post-processes sample these by UV so the size doesn't change the work
+static ImageBuffer NoiseTexture(int size, uint32_t seed)
+{
+	ImageBuffer texture(size, size);
+	for (int y = 0; y < size; ++y)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			texture.Pixel(x, y) = { HashNoise(x, y, seed), HashNoise(x, y, seed + 1), HashNoise(x, y, seed + 2), 1.0f };
+		}
+	}
+	return texture;
+}
+
+
+// The images a post-process reads, with content that exercises the content-dependent paths: bright spots for bloom,
+// a range of depths for depth of field (near to far from top to bottom) and a focused object in the middle
+struct TestImages
+{
+	ImageBuffer scene;
+	ImageBuffer normalDepth;
+	ImageBuffer focus;
+
+	TestImages(int width, int height)
+		: scene(width, height), normalDepth(width, height), focus(width, height)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			ColourRGBA* sceneRow = scene.Row(y);
+			ColourRGBA* normalDepthRow = normalDepth.Row(y);
+			ColourRGBA* focusRow = focus.Row(y);
+			float v = (y + 0.5f) / height;
+			for (int x = 0; x < width; ++x)
+			{
+				float u = (x + 0.5f) / width;
+				bool bright = HashNoise(x / 32, y / 32, 7) > 0.9f;
+				sceneRow[x] = bright ? ColourRGBA(1.0f, 0.95f, 0.9f, 1.0f) : ColourRGBA(u, v, 0.5f * (u + v), 1.0f);
+				normalDepthRow[x] = { 0.5f, 0.5f, 1.0f, Clamp(v + 0.1f * std::sin(u * 40.0f)) };
+				bool focused = std::abs(u - 0.5f) < 0.15f && std::abs(v - 0.5f) < 0.2f;
+				focusRow[x] = { 0.0f, 0.0f, 0.0f, focused ? 1.0f : 0.0f };
+			}
+		}
+	}
+};
+
+
+//--------------------------------------------------------------------------------------
+// Timing
+//--------------------------------------------------------------------------------------
+
+struct BenchmarkResult
+{
+	std::string name;
+	int         width;
+	int         height;
+	int         threads;
+	int         repetitions;
+	double      medianMs;
+	double      minMs;
+	double      maxMs;
+	double      megapixelsPerSecond;
+	double      nsPerPixel;
+
+	// Identifies the same case in a baseline
+	std::string Key() const { return name + " @ " + std::to_string(width) + "x" + std::to_string(height) + ", threads " + std::to_string(threads); }
+};
+
+
+// Time one case, returns false on error
+static bool RunCase(const BenchmarkCase& benchmarkCase, PostProcessEngine& engine, const TestImages& images,
+                    ImageBuffer& target, int threads, int warmup, int repetitions, BenchmarkResult& result)
+{
+	const int width = images.scene.Width();
+	const int height = images.scene.Height();
+
+	PostProcessingConstants constants = DefaultConstants(width, height);
+	engine.SetBloomMode(BloomMode::FullResolution);
+	engine.SetDiagonalBlurs(3);
+	for (int type = 0; type < NUM_POST_PROCESS_TYPES; ++type)  engine.SetMethod(static_cast<PostProcessType>(type), ProcessMethod::Fast);
+	engine.SetMethod(benchmarkCase.type, benchmarkCase.method);
+
+	// The bloom texture is built with the blur and pyramid passes, so they follow the method of the bloom case
+	if (benchmarkCase.type == PostProcessType::Bloom)
+	{
+		for (PostProcessType type : { PostProcessType::BlurX, PostProcessType::BlurY, PostProcessType::BloomPrefilter,
+		                              PostProcessType::BloomDownsample, PostProcessType::BloomUpsample })
+		{
+			engine.SetMethod(type, benchmarkCase.method);
+		}
+	}
+	if (benchmarkCase.settings.apply)  benchmarkCase.settings.apply(constants, engine, width, height);
+
+	// Area in the middle quarter of the screen, polygon over the same area given directly in clip space
+	constants.area2DTopLeft = { 0.25f, 0.25f };
+	constants.area2DSize = { 0.5f, 0.5f };
+	PostProcess postProcess(benchmarkCase.type, benchmarkCase.mode);
+	if (benchmarkCase.mode == PostProcessMode::Polygon)
+	{
+		engine.SetViewProjectionMatrix(MatrixIdentity());
+		postProcess.PolyData = new PolygonData({ CVector3{ -0.5f, 0.5f, 0.5f }, CVector3{ -0.5f, -0.5f, 0.5f },
+		                                         CVector3{ 0.5f, 0.5f, 0.5f }, CVector3{ 0.5f, -0.5f, 0.5f } }, MatrixIdentity());
+	}
+
+	std::vector<double> times;
+	for (int run = 0; run < warmup + repetitions; ++run)
+	{
+		int64_t start = ClockNanoseconds();
+		if (!engine.Apply(postProcess, constants, images.scene, target, &images.normalDepth, &images.focus))
+		{
+			printf("%s: %s\n", benchmarkCase.Name().c_str(), engine.LastError().c_str());
+			return false;
+		}
+		int64_t end = ClockNanoseconds();
+		if (run >= warmup)  times.push_back(NanosecondsToSeconds(end - start) * 1000.0);
+	}
+
+	std::sort(times.begin(), times.end());
+	double medianMs = (times[(times.size() - 1) / 2] + times[times.size() / 2]) * 0.5;
+	const double pixels = static_cast<double>(width) * height;
+
+	result.name = benchmarkCase.Name();
+	result.width = width;
+	result.height = height;
+	result.threads = threads;
+	result.repetitions = repetitions;
+	result.medianMs = medianMs;
+	result.minMs = times.front();
+	result.maxMs = times.back();
+	result.megapixelsPerSecond = pixels / (medianMs * 1000.0);
+	result.nsPerPixel = medianMs * 1e6 / pixels;
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Results
+//--------------------------------------------------------------------------------------
+
+// Quote a string for JSON, the names only hold printable characters
+static std::string JSONString(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')  quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// Write the results as JSON, one result to a line. Returns false if the file can't be written
+static bool WriteJSON(const std::string& fileName, const std::vector<BenchmarkResult>& results, int warmup)
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << "{\"hardwareThreads\":" << std::thread::hardware_concurrency() << ",\"warmup\":" << warmup << ",\"results\":[\n";
+	char numbers[256];
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		snprintf(numbers, sizeof(numbers), "\"medianMs\":%.6f,\"minMs\":%.6f,\"maxMs\":%.6f,\"megapixelsPerSecond\":%.3f,\"nsPerPixel\":%.6f",
+		         r.medianMs, r.minMs, r.maxMs, r.megapixelsPerSecond, r.nsPerPixel);
+		file << "{\"key\":" << JSONString(r.Key()) << ",\"name\":" << JSONString(r.name) << ",\"width\":" << r.width
+		     << ",\"height\":" << r.height << ",\"threads\":" << r.threads << ",\"repetitions\":" << r.repetitions << ","
+		     << numbers << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "]}\n";
+	return static_cast<bool>(file);
+}
+
+
+// Read the nanoseconds per pixel of each case from a file written by WriteJSON, by key. Only reads the layout WriteJSON
+// writes, one result to a line. Returns false if the file can't be read
+static bool ReadBaseline(const std::string& fileName, std::map<std::string, double>& nsPerPixel)
+{
+	std::ifstream file(fileName);
+	if (!file)  return false;
+
+	const std::string keyField = "{\"key\":\"";
+	const std::string nsField = "\"nsPerPixel\":";
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, keyField.size(), keyField) != 0)  continue;
+		std::string key;
+		size_t i = keyField.size();
+		for (; i < line.size() && line[i] != '"'; ++i)
+		{
+			if (line[i] == '\\' && i + 1 < line.size())  ++i;
+			key += line[i];
+		}
+		size_t ns = line.find(nsField, i);
+		if (ns != std::string::npos)  nsPerPixel[key] = atof(line.c_str() + ns + nsField.size());
+	}
+	return true;
+}
+
+
+// Compare results with a baseline, printing the changes. Returns the number of cases slower by more than the threshold
+static int CompareWithBaseline(const std::vector<BenchmarkResult>& results, const std::map<std::string, double>& baseline, double thresholdPercent)
+{
+	int regressions = 0;
+	int improvements = 0;
+	int compared = 0;
+	printf("\nCompared with baseline (threshold %.1f%%)\n", thresholdPercent);
+	for (const BenchmarkResult& result : results)
+	{
+		auto found = baseline.find(result.Key());
+		if (found == baseline.end() || found->second <= 0)  continue;
+		++compared;
+
+		double change = (result.nsPerPixel / found->second - 1.0) * 100.0;
+		const char* verdict = nullptr;
+		if (change > thresholdPercent)        { verdict = "REGRESSION"; ++regressions; }
+		else if (change < -thresholdPercent)  { verdict = "faster";     ++improvements; }
+		if (verdict)  printf("  %-10s %+7.1f%%  %8.3f -> %8.3f ns/pixel  %s\n", verdict, change, found->second, result.nsPerPixel, result.Key().c_str());
+	}
+	printf("%d cases compared, %d regressions, %d faster, %d not in the baseline\n", compared, regressions, improvements,
+	       static_cast<int>(results.size()) - compared);
+	return regressions;
+}
+
+
+// Throughput of each case at each thread count, relative to the first thread count
+static void ReportScaling(const std::vector<BenchmarkResult>& results, const std::vector<int>& threadCounts)
+{
+	printf("\nThread scaling (Mpixel/s, speed-up over %d thread%s)\n", threadCounts[0], threadCounts[0] == 1 ? "" : "s");
+	printf("%-54s %-11s", "Case", "Size");
+	for (int threads : threadCounts)  printf(" %15d", threads);
+	printf("\n");
+
+	// Results are in thread count order for each resolution, find the other thread counts for each first one
+	for (const BenchmarkResult& first : results)
+	{
+		if (first.threads != threadCounts[0])  continue;
+		printf("%-54s %5dx%-5d", first.name.c_str(), first.width, first.height);
+		for (int threads : threadCounts)
+		{
+			auto found = std::find_if(results.begin(), results.end(), [&](const BenchmarkResult& r)
+			{
+				return r.threads == threads && r.width == first.width && r.height == first.height && r.name == first.name;
+			});
+			if (found != results.end())  printf(" %8.1f %5.2fx", found->megapixelsPerSecond, found->megapixelsPerSecond / first.megapixelsPerSecond);
+			else                         printf(" %15s", "-");
+		}
+		printf("\n");
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		std::transform(item.begin(), item.end(), item.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (!item.empty())  items.push_back(item);
+	}
+	return items;
+}
+
+static bool LowerCaseEqual(const std::string& a, const char* b)
+{
+	if (a.size() != strlen(b))  return false;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))  return false;
+	}
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const int cores = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Resolution>      resolutions(std::begin(RESOLUTIONS), std::end(RESOLUTIONS));
+	std::vector<PostProcessType> types;
+	std::vector<PostProcessMode> modes = { PostProcessMode::Fullscreen, PostProcessMode::Area, PostProcessMode::Polygon };
+	std::vector<ProcessMethod>   methods = { ProcessMethod::Fast };
+	std::vector<int>             threadCounts = { cores };
+	int warmup = 2;
+	int repetitions = 5;
+	double threshold = 10.0;
+	std::string jsonFile;
+	std::string baselineFile;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--resolutions")
+		{
+			resolutions.clear();
+			for (auto& name : SplitList(value))
+			{
+				auto found = std::find_if(std::begin(RESOLUTIONS), std::end(RESOLUTIONS), [&](const Resolution& r) { return r.name == name; });
+				int width = 0, height = 0;
+				if (found != std::end(RESOLUTIONS))  resolutions.push_back(*found);
+				else if (sscanf(name.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0)  resolutions.push_back({ name, width, height });
+				else
+				{
+					printf("Unknown resolution %s\n", name.c_str());
+					return 1;
+				}
+			}
+		}
+		else if (option == "--effects")
+		{
+			for (auto& name : SplitList(value))
+			{
+				int type = static_cast<int>(PostProcessType::Copy);
+				while (type < NUM_POST_PROCESS_TYPES && !LowerCaseEqual(name, PostProcessTypeName(static_cast<PostProcessType>(type))))  ++type;
+				if (type == NUM_POST_PROCESS_TYPES)
+				{
+					printf("Unknown post-process %s\n", name.c_str());
+					return 1;
+				}
+				types.push_back(static_cast<PostProcessType>(type));
+			}
+		}
+		else if (option == "--modes")
+		{
+			modes.clear();
+			for (auto& name : SplitList(value))
+			{
+				if      (name == "fullscreen")  modes.push_back(PostProcessMode::Fullscreen);
+				else if (name == "area")        modes.push_back(PostProcessMode::Area);
+				else if (name == "polygon")     modes.push_back(PostProcessMode::Polygon);
+				else
+				{
+					printf("Unknown mode %s\n", name.c_str());
+					return 1;
+				}
+			}
+		}
+		else if (option == "--methods")
+		{
+			methods.clear();
+			for (auto& name : SplitList(value))
+			{
+				if      (name == "fast")    methods.push_back(ProcessMethod::Fast);
+				else if (name == "shader")  methods.push_back(ProcessMethod::ShaderPort);
+				else
+				{
+					printf("Unknown method %s\n", name.c_str());
+					return 1;
+				}
+			}
+		}
+		else if (option == "--threads")
+		{
+			threadCounts.clear();
+			for (auto& name : SplitList(value))
+			{
+				if (name == "max")  threadCounts.push_back(cores);
+				else if (name == "scaling")
+				{
+					for (int threads = 1; threads < cores; threads *= 2)  threadCounts.push_back(threads);
+					threadCounts.push_back(cores);
+				}
+				else  threadCounts.push_back(std::max(1, atoi(name.c_str())));
+			}
+		}
+		else if (option == "--warmup")       warmup = std::max(0, atoi(value.c_str()));
+		else if (option == "--repetitions")  repetitions = std::max(1, atoi(value.c_str()));
+		else if (option == "--threshold")    threshold = std::max(0.0, atof(value.c_str()));
+		else if (option == "--json")         jsonFile = value;
+		else if (option == "--baseline")     baselineFile = value;
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			return 1;
+		}
+	}
+	if (resolutions.empty() || modes.empty() || methods.empty() || threadCounts.empty())
+	{
+		printf("Nothing to run\n");
+		return 1;
+	}
+	if (types.empty())
+	{
+		for (int type = static_cast<int>(PostProcessType::Copy); type < NUM_POST_PROCESS_TYPES; ++type)  types.push_back(static_cast<PostProcessType>(type));
+	}
+
+	// Read the baseline first so a bad file name doesn't waste a long run
+	std::map<std::string, double> baseline;
+	if (!baselineFile.empty() && !ReadBaseline(baselineFile, baseline))
+	{
+		printf("Cannot read baseline %s\n", baselineFile.c_str());
+		return 1;
+	}
+
+	std::vector<BenchmarkCase> cases;
+	for (PostProcessType type : types)
+	{
+		for (PostProcessMode mode : modes)
+		{
+			for (ProcessMethod method : methods)
+			{
+				// Post-processes without a fast version are the same whichever method is chosen, so only run them once
+				if (!HasFastVersion(type) && method != methods[0])  continue;
+				for (auto& settings : EffectSettings(type))  cases.push_back({ type, mode, method, HasFastVersion(type), settings });
+			}
+		}
+	}
+
+	ImageBuffer noise    = NoiseTexture(256, 1);
+	ImageBuffer burn     = NoiseTexture(256, 2);
+	ImageBuffer distort  = NoiseTexture(256, 3);
+	ImageBuffer noise2   = NoiseTexture(256, 4);
+	PostProcessTextures textures;
+	textures.noiseMap   = &noise;
+	textures.burnMap    = &burn;
+	textures.distortMap = &distort;
+	textures.noiseMap2  = &noise2;
+
+	std::vector<BenchmarkResult> results;
+	for (const Resolution& resolution : resolutions)
+	{
+		TestImages images(resolution.width, resolution.height);
+		ImageBuffer target(resolution.width, resolution.height);
+		for (int threads : threadCounts)
+		{
+			PostProcessEngine engine(threads);
+			engine.SetTextures(textures);
+
+			printf("\n%dx%d (%s), %d thread%s\n", resolution.width, resolution.height, resolution.name.c_str(), threads, threads == 1 ? "" : "s");
+			printf("%-54s %10s %10s %10s %10s\n", "Case", "Median ms", "Min ms", "Mpixel/s", "ns/pixel");
+			for (const BenchmarkCase& benchmarkCase : cases)
+			{
+				BenchmarkResult result;
+				if (!RunCase(benchmarkCase, engine, images, target, threads, warmup, repetitions, result))  return 1;
+				printf("%-54s %10.3f %10.3f %10.1f %10.3f\n", result.name.c_str(), result.medianMs, result.minMs,
+				       result.megapixelsPerSecond, result.nsPerPixel);
+				fflush(stdout);
+				results.push_back(result);
+			}
+		}
+	}
+
+	if (threadCounts.size() > 1)  ReportScaling(results, threadCounts);
+
+	if (!jsonFile.empty() && !WriteJSON(jsonFile, results, warmup))
+	{
+		printf("Cannot write %s\n", jsonFile.c_str());
+		return 1;
+	}
+
+	if (!baselineFile.empty() && CompareWithBaseline(results, baseline, threshold) > 0)  return 2;
+	return 0;
+}
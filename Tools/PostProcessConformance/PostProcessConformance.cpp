@@ -0,0 +1,1324 @@
+//--------------------------------------------------------------------------------------
+// Post-process conformance - checks the optimised CPU post-processes against the
+// reference ports of the shaders, and times both
+//--------------------------------------------------------------------------------------
+// Usage: PostProcessConformance [--seed n] [--size WxH] [--threads n] [--repetitions n] [--shaders folder]
+// First the shared shader functions in ShaderFunctions.cpp (Gauss, DilationForDepth, Spline, RGBtoHSL/HSLtoRGB and
+// GetAreaAlpha) are compared with double precision versions written straight from Common.hlsli, over random inputs.
+//
+// Then each optimised path of the CPU engine is compared with the reference: every post-process calculated with the
+// same samples as its shader (ProcessMethod::ShaderPort), one pass at a time, with the normal/depth and focused object
+// maps distorted straight after each distorting post-process. The optimised paths are the fast versions (FastBlur.h,
+// FastDilation.h, FastDepthOfField.h and FastBloom.h), fused passes (PostProcessFusion.h) and lazy map distortion.
+// Each check has its own limits on the largest difference in any channel, on the PSNR of the colour channels and on the
+// fraction of pixels differing by more than DIFFERENT_PIXEL, as some fast versions are approximations. The limits of
+// approximations are measured at the default size and seed, other sizes and seeds may go past them. Both paths are timed, the fastest of the repetitions (default 3) is reported.
+//
+// Then fusion alone is checked: every post-process that can start a fused run is followed by runs of point
+// post-processes and run on two engines that differ only in fusion. Each chain must fuse into one pass and give
+// exactly the same scene and maps as running its post-processes one at a time.
+//
+// Then each post-process's pixel shader (<type>_pp.hlsl, read from the --shaders folder, default the current folder) is
+// checked to read exactly the constant blocks PostProcessConstantBlocks gives for it, each at the register
+// ConstantBlockRegister binds it to. The cbuffers it reads are found by following main through the functions of
+// Common.hlsli it calls, so a block only read by e.g. Gauss or DilationForDepth must still be sent.
+//
+// Then the constant blocks (PostProcessConstantBlocks.h) are sent for frames of a post-processing graph as the GPU path
+// sends them, to buffers kept in memory. After every send the buffer must hold the block written from the settings, so
+// a block wrongly skipped as unchanged fails, and frames where nothing changes must upload no more than the bloom
+// streak directions. The uploads and bytes are reported against sending the whole PostProcessingConstants each pass.
+// Last, runs of passes shaped like the GPU path bind their targets, textures and states both straight to a recording
+// backend and through a RenderStateFilter (RenderStateFilter.h). Both backends unbind views as Direct3D does, and at
+// every draw the filtered one must have the same bindings as the other.
+//
+// Inputs are made from a seeded RandomGenerator (MathHelpers.h), so a seed (default 1) always gives the same images
+// and the same results. Images default to 320x180. Returns 1 if any check fails.
+//
+// Only needs the Math, Utility and PostProcess folders (and the shader files to read), so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -pthread -IMath -IUtility -IPostProcess Tools/PostProcessConformance/PostProcessConformance.cpp
+//     PostProcess/*.cpp Utility/ThreadPool.cpp Utility/Clock.cpp Utility/RenderStateFilter.cpp Math/*.cpp
+
+#include "PostProcessEngine.h"
+#include "PostProcessGraph.h"
+#include "PostProcessFusion.h"
+#include "PostProcessConstantBlocks.h"
+#include "ShaderFunctions.h"
+#include "RenderStateFilter.h"
+#include "Clock.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+
+
+//--------------------------------------------------------------------------------------
+// Shader functions
+//--------------------------------------------------------------------------------------
+
+// Double precision versions of the functions in Common.hlsli, for comparison with the float versions in ShaderFunctions
+static const double REFERENCE_EPSILON = 1e-10;
+
+static double Saturate(double x)
+{
+	return std::min(std::max(x, 0.0), 1.0);
+}
+
+static double ReferenceGetAreaAlpha(double u, double v)
+{
+	const double softEdge = 0.20;
+	double centreLengthSq = (u - 0.5) * (u - 0.5) + (v - 0.5) * (v - 0.5);
+	return 1.0 - Saturate((centreLengthSq - 0.25 + softEdge) / softEdge);
+}
+
+static double ReferenceGauss(double x, double standardDeviationSquared)
+{
+	if (standardDeviationSquared < REFERENCE_EPSILON)  return 1.0;
+	return (1.0 / std::sqrt(2.0 * 3.14159265358979 * standardDeviationSquared)) *
+	       std::pow(REFERENCE_EPSILON, -(x * x) / (2.0 * standardDeviationSquared));
+}
+
+static double ReferenceDilationForDepth(double depth, double focalPlane, double nearPlane, double farPlane)
+{
+	if (depth < focalPlane)  return -(depth - focalPlane) / (focalPlane - nearPlane);
+	return Saturate((depth - focalPlane) / (farPlane - focalPlane));
+}
+
+static double ReferenceSpline(double x, const double values[9])
+{
+	double tmp = x * 8.0;
+	int first = std::min(7, std::max(0, static_cast<int>(std::ceil(tmp)) - 1));
+	double t = tmp - first;
+	if (first == 7)  t = Saturate(t);
+	return values[first] * (1.0 - t) + values[first + 1] * t;
+}
+
+// Textbook RGB to HSL with hue from 0 to 1, rather than the branch-free version in the shader
+static void ReferenceRGBtoHSL(const double rgb[3], double hsl[3])
+{
+	double maximum = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+	double minimum = std::min(rgb[0], std::min(rgb[1], rgb[2]));
+	double chroma = maximum - minimum;
+	double lightness = (maximum + minimum) * 0.5;
+
+	double hue = 0.0;
+	if      (chroma <= 0.0)        hue = 0.0;
+	else if (maximum == rgb[0])  hue = std::fmod((rgb[1] - rgb[2]) / chroma + 6.0, 6.0);
+	else if (maximum == rgb[1])  hue = (rgb[2] - rgb[0]) / chroma + 2.0;
+	else                           hue = (rgb[0] - rgb[1]) / chroma + 4.0;
+
+	hsl[0] = hue / 6.0;
+	hsl[1] = (chroma <= 0.0) ? 0.0 : chroma / (1.0 - std::abs(2.0 * lightness - 1.0));
+	hsl[2] = lightness;
+}
+
+
+// Largest difference found by a function check
+struct FunctionCheck
+{
+	const char* name;
+	double      maxError;
+	double      limit;
+};
+
+static std::vector<FunctionCheck> CheckShaderFunctions(RandomGenerator& random, int count)
+{
+	double areaError = 0, gaussError = 0, dilationError = 0, splineError = 0, hslError = 0, roundTripError = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		float u = random.Range(-0.2f, 1.2f);
+		float v = random.Range(-0.2f, 1.2f);
+		areaError = std::max(areaError, std::abs(GetAreaAlpha({ u, v }) - ReferenceGetAreaAlpha(u, v)));
+
+		// Offsets are in UVs, at most half the blur size either side
+		float x = random.Range(-0.5f, 0.5f);
+		float deviationSquared = random.Range(1.0f, 60.0f);
+		double gauss = ReferenceGauss(x, deviationSquared);
+		gaussError = std::max(gaussError, std::abs(Gauss(x, deviationSquared) - gauss) / gauss);
+
+		PostProcessingConstants constants = {};
+		constants.focalPlane = random.Range(0.1f, 0.9f);
+		constants.nearPlane  = constants.focalPlane - random.Range(0.02f, 0.5f);
+		constants.farPlane   = constants.focalPlane + random.Range(0.02f, 0.5f);
+		float depth = random.Range(0.0f, 1.0f);
+		double dilation = ReferenceDilationForDepth(depth, constants.focalPlane, constants.nearPlane, constants.farPlane);
+		dilationError = std::max(dilationError, std::abs(DilationForDepth(depth, constants) - dilation) / std::max(1.0, std::abs(dilation)));
+
+		ColourRGBA colours[9];
+		double reds[9];
+		for (int j = 0; j < 9; ++j)
+		{
+			colours[j] = { random.Range(0.0f, 1.0f), 0.0f, 0.0f, 1.0f };
+			reds[j] = colours[j].r;
+		}
+		float splineX = random.Range(0.0f, 1.0f);
+		splineError = std::max(splineError, std::abs(Spline(splineX, colours).r - ReferenceSpline(splineX, reds)));
+
+		// Hue is compared around the colour circle and only where it is well defined
+		CVector3 rgb = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f) };
+		const double rgbDouble[3] = { rgb.x, rgb.y, rgb.z };
+		double hsl[3];
+		ReferenceRGBtoHSL(rgbDouble, hsl);
+		CVector3 shaderHSL = RGBtoHSL(rgb);
+		double hueError = std::abs(shaderHSL.x - hsl[0]);
+		hueError = std::min(hueError, 1.0 - hueError);
+		if (hsl[1] < 0.01 || hsl[2] < 0.01 || hsl[2] > 0.99)  hueError = 0;
+		hslError = std::max(hslError, std::max(hueError, std::max(std::abs(shaderHSL.y - hsl[1]), std::abs(shaderHSL.z - hsl[2]))));
+
+		CVector3 roundTrip = HSLtoRGB(shaderHSL);
+		roundTripError = std::max(roundTripError, static_cast<double>(std::max(std::abs(roundTrip.x - rgb.x),
+		                                                                       std::max(std::abs(roundTrip.y - rgb.y), std::abs(roundTrip.z - rgb.z)))));
+	}
+
+	return
+	{
+		{ "GetAreaAlpha",        areaError,      1e-5 },
+		{ "Gauss",               gaussError,     1e-5 },
+		{ "DilationForDepth",    dilationError,  1e-5 },
+		{ "Spline",              splineError,    1e-5 },
+		{ "RGBtoHSL",            hslError,       1e-4 },
+		{ "HSLtoRGB(RGBtoHSL)",  roundTripError, 1e-4 },
+	};
+}
+
+
+//--------------------------------------------------------------------------------------
+// Test images
+//--------------------------------------------------------------------------------------
+
+// The images the post-processes read, made from random shapes so the content is the same for the same seed
+struct TestImages
+{
+	ImageBuffer scene;
+	ImageBuffer normalDepth;
+	ImageBuffer focus;
+	ImageBuffer noise;
+	ImageBuffer burn;
+	ImageBuffer distort;
+	ImageBuffer noise2;
+
+	TestImages(int width, int height, RandomGenerator& random)
+		: scene(width, height), normalDepth(width, height), focus(width, height, { 0, 0, 0, 0 })
+	{
+		// A smooth background with rectangles of random colour and depth on it, some bright enough to bloom. Sharp edges
+		// show up differences in the blurs, dilation and depth of field
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				float u = (x + 0.5f) / width;
+				float v = (y + 0.5f) / height;
+				scene.Pixel(x, y) = { u, v, 0.5f * (1.0f - u), 1.0f };
+				normalDepth.Pixel(x, y) = { 0.5f, 0.5f, 1.0f, 0.2f + 0.7f * v };
+			}
+		}
+		for (int rectangle = 0; rectangle < 40; ++rectangle)
+		{
+			int left = random.Range(0u, width - 1u);
+			int top = random.Range(0u, height - 1u);
+			int right = std::min(width, left + static_cast<int>(random.Range(2u, width / 4u)));
+			int bottom = std::min(height, top + static_cast<int>(random.Range(2u, height / 4u)));
+			ColourRGBA colour = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), 1.0f };
+			if (random.Range(0u, 3u) == 0)  colour = { 1.0f, 1.0f, random.Range(0.8f, 1.0f), 1.0f };
+			ColourRGBA normalDepthValue = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f) };
+			bool focused = (rectangle == 0);
+			for (int y = top; y < bottom; ++y)
+			{
+				for (int x = left; x < right; ++x)
+				{
+					scene.Pixel(x, y) = colour;
+					normalDepth.Pixel(x, y) = normalDepthValue;
+					if (focused)  focus.Pixel(x, y) = { 1, 1, 1, 1 };
+				}
+			}
+		}
+
+		noise = RandomTexture(256, random);
+		burn = RandomTexture(256, random);
+		distort = RandomTexture(256, random);
+		noise2 = RandomTexture(256, random);
+	}
+
+	static ImageBuffer RandomTexture(int size, RandomGenerator& random)
+	{
+		ImageBuffer texture(size, size);
+		for (int i = 0; i < size * size; ++i)
+		{
+			texture.Data()[i] = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), 1.0f };
+		}
+		return texture;
+	}
+};
+
+
+// Settings at the values UpdateScene starts with
+static PostProcessingConstants DefaultConstants(int width, int height, RandomGenerator& random)
+{
+	PostProcessingConstants c = {};
+	c.area2DTopLeft = { 0.2f, 0.3f };
+	c.area2DSize = { 0.5f, 0.4f };
+	c.tintColour = { 1, 0, 0 };
+	c.copyAlpha = 0.5f;
+	c.noiseScale = { width / 140.0f, height / 140.0f };
+	c.noiseOffset = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f) };
+	c.burnHeight = 0.5f;
+	c.distortLevel = 0.03f;
+	c.spiralLevel = 4.0f;
+	c.heatHazeTimer = 1.0f;
+	c.gradientHue = { 0.5f, 0.0f };
+	c.hueShift = 0.25f;
+	c.blurSize = { 0.03f, 0.03f };
+	c.standardDeviationSquared = 5.2f * 5.2f;
+	c.underwaterHue = 0.6f;
+	c.underwaterBrightness = { 1.1f, 0.75f };
+	c.wobbleStrength = 0.005f;
+	c.wobbleTimer = 1.0f;
+	c.pixelNumber = { width / 8.0f, height / 8.0f };
+	c.pixelBrightnessHueShift = 0.3f;
+	c.pixelBrightnessLevels = 12.0f;
+	c.pixelSaturationMin = 0.8f;
+	c.pixelSaturationLevels = 2.0f;
+	c.pixelHueRange = { 160.0f / 360.0f, 305.0f / 360.0f };
+	c.pixelHueLevels = 7.0f;
+	c.bloomThreshold = 0.9f;
+	c.bloomIntensity = 1.2f;
+	c.bloomLevelScale = 1.0f;
+	c.directionalBlurSize = 0.55f;
+	c.directionalBlurX = 1.0f;
+	c.directionalBlurY = 0.0f;
+	c.directionalBlurIntensity = 0.6f;
+	c.colourOffset = { 0.011f, 0.0f, -0.011f };
+	c.outlineThreshold = 0.12f;
+	c.outlineThickness = 0.0012f;
+	c.dilationSize = { 0.01f, 0.01f };
+	c.dilationType = 1.0f;
+	c.dilationThreshold = { 0.05f, 0.5f };
+	c.focalPlane = 0.2f;
+	c.nearPlane = 0.05f;
+	c.farPlane = 0.35f;
+	c.frostedGlassFrequency = 0.1f;
+	c.frostedGlassoffsetSize = { 0.01f, 0.01f };
+	return c;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Effect checks
+//--------------------------------------------------------------------------------------
+
+// A chain of post-processes run by the reference and the optimised engine, and how close the results must be
+// Difference in a channel over which a pixel counts as different, for the limits of approximations
+const float DIFFERENT_PIXEL = 0.05f;
+
+struct EffectCheck
+{
+	std::string                  name;
+	std::vector<PostProcessType> chain;
+	PostProcessMode              mode;
+	std::function<void(PostProcessingConstants&, PostProcessEngine&)> settings; // Changes to the defaults, may be empty
+	float                        maxError; // Largest difference allowed in any channel
+	double                       minPSNR;  // Lowest PSNR of the colour channels allowed, in dB
+	double                       maxOver = 0.0; // Largest fraction of pixels allowed to differ by more than DIFFERENT_PIXEL in
+	                                            // any channel. None unless given, as is implied by a maxError below it
+};
+
+static std::vector<EffectCheck> EffectChecks()
+{
+	typedef PostProcessType T;
+	const PostProcessMode fullscreen = PostProcessMode::Fullscreen;
+	std::vector<EffectCheck> checks;
+
+	// Fast versions. These are not sample for sample the same as the shaders, the limits are set from the differences
+	// each is known to have with some margin, so a change that makes one less accurate is caught:
+	// - The blurs integrate the weights over each pixel where the shaders take point samples, small differences at edges
+	// - Dilation takes the brightest pixel anywhere in the shape where the shader only looks at a 27x27 grid, see below
+	// - Depth of field lets each sample spread only as far as its own circle of confusion, except where everything
+	//   nearby is fully out of focus, so edges of objects just out of focus differ. See below
+	// - The bloom pyramid passes take the same samples as the shaders in a different order
+	for (float size : { 0.0f, 0.03f, 0.1f })
+	{
+		auto blur = [size](PostProcessingConstants& c, PostProcessEngine&) { c.blurSize = { size, size }; };
+		char name[64];
+		snprintf(name, sizeof(name), "BlurX fast, blur %g", size);
+		checks.push_back({ name, { T::BlurX }, fullscreen, blur, 0.02f, 50.0 });
+		snprintf(name, sizeof(name), "BlurY fast, blur %g", size);
+		checks.push_back({ name, { T::BlurY }, fullscreen, blur, 0.02f, 50.0 });
+	}
+	// Dilation, with limits measured at the default size and seed. At size 0.01 the shader's samples are less than a
+	// pixel apart, so both take every pixel in the shape and must match. Further apart, the fast version still takes
+	// every pixel so it also finds bright pixels between the shader's samples. Squares only differ a little, but a
+	// circle or diamond 0.15 across differs by whole pixels next to small bright features, so for those the number of
+	// pixels that differ is limited rather than the largest error
+	struct DilationLimits { float type; float size; float maxError; double minPSNR; double maxOver; };
+	const DilationLimits dilationLimits[] =
+	{
+		{ 0, 0.01f, 1e-6f, 120.0, 0 },  { 0, 0.05f, 0.01f, 76.6, 0 },  { 0, 0.15f, 0.02f, 72.4, 0 },
+		{ 1, 0.01f, 1e-6f, 120.0, 0 },  { 1, 0.05f, 0.01f, 79.0, 0 },  { 1, 0.15f, 1.0f,  22.5, 0.03 },
+		{ 2, 0.01f, 1e-6f, 120.0, 0 },  { 2, 0.05f, 0.01f, 79.2, 0 },  { 2, 0.15f, 1.0f,  25.5, 0.015 },
+	};
+	for (const DilationLimits& limits : dilationLimits)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "Dilation fast, type %g, size %g", limits.type, limits.size);
+		float type = limits.type, size = limits.size;
+		checks.push_back({ name, { T::Dilation }, fullscreen, [type, size](PostProcessingConstants& c, PostProcessEngine&)
+		{
+			c.dilationType = type;
+			c.dilationSize = { size, size };
+		}, limits.maxError, limits.minPSNR, limits.maxOver });
+	}
+	// Depth of field, with limits measured at the default size and seed plus a margin. Pixels next to objects only just
+	// out of focus can take a different sample to the shader's and differ completely, so rather than the largest error
+	// the number of pixels that differ is limited. With everything fully out of focus every tile takes all the shader's
+	// samples and must match
+	struct DepthOfFieldLimits { float planeDistance; double minPSNR; double maxOver; };
+	const DepthOfFieldLimits depthOfFieldLimits[] = { { 0.02f, 49.0, 0.025 }, { 0.15f, 30.0, 0.08 }, { 0.5f, 31.0, 0.03 } };
+	for (const DepthOfFieldLimits& limits : depthOfFieldLimits)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "DepthOfField fast, planes %g", limits.planeDistance);
+		float planeDistance = limits.planeDistance;
+		checks.push_back({ name, { T::DepthOfField }, fullscreen, [planeDistance](PostProcessingConstants& c, PostProcessEngine&)
+		{
+			c.nearPlane = Clamp(c.focalPlane - planeDistance);
+			c.farPlane  = Clamp(c.focalPlane + planeDistance);
+		}, 1.0f, limits.minPSNR, limits.maxOver });
+	}
+	checks.push_back({ "DepthOfField fast, all out of focus", { T::DepthOfField }, fullscreen, [](PostProcessingConstants& c, PostProcessEngine&)
+	{
+		c.focalPlane = 0.0f;
+		c.nearPlane  = 0.0f;
+		c.farPlane   = 0.001f;
+	}, 1e-6f, 120.0 });
+	for (BloomMode bloomMode : { BloomMode::FullResolution, BloomMode::Pyramid })
+	{
+		for (int diagonalBlurs : { 0, 3 })
+		{
+			std::string name = std::string("Bloom fast, ") + BloomModeName(bloomMode) + ", diagonals " + std::to_string(diagonalBlurs);
+			checks.push_back({ name, { T::Bloom }, fullscreen, [bloomMode, diagonalBlurs](PostProcessingConstants&, PostProcessEngine& engine)
+			{
+				engine.SetBloomMode(bloomMode);
+				engine.SetDiagonalBlurs(diagonalBlurs);
+			}, bloomMode == BloomMode::Pyramid ? 1e-4f : 0.02f, bloomMode == BloomMode::Pyramid ? 100.0 : 55.0 });
+		}
+	}
+
+	// Fast versions in areas and polygons, where the whole image is processed then passed through the area or polygon
+	checks.push_back({ "BlurX fast, area",       { T::BlurX },    PostProcessMode::Area,    nullptr, 0.02f, 60.0 });
+	checks.push_back({ "Dilation fast, polygon", { T::Dilation }, PostProcessMode::Polygon, nullptr, 1e-6f, 120.0 });
+
+	// Fused runs, which clamp between stages as the separate passes do so should match exactly. Runs starting with a
+	// fast post-process have its limits
+	checks.push_back({ "Fused Copy, Tint, Gradient, HueShift", { T::Copy, T::Tint, T::Gradient, T::HueShift }, fullscreen, nullptr, 1e-6f, 120.0 });
+	checks.push_back({ "Fused Spiral, Brightness, Tint",       { T::Spiral, T::Brightness, T::Tint },           fullscreen, nullptr, 1e-6f, 120.0 });
+	checks.push_back({ "Fused BlurY, HueShift",                { T::BlurY, T::HueShift },                       fullscreen, nullptr, 0.02f, 50.0 });
+
+	// Lazy map distortion, with distorting post-processes before the ones that read the maps. The maps are distorted in
+	// the same order either way, so these have the limits of the fast post-processes in them
+	checks.push_back({ "Lazy maps Spiral, Underwater, Outline",      { T::Spiral, T::Underwater, T::Outline },      fullscreen, nullptr, 1e-6f, 120.0 });
+	checks.push_back({ "Lazy maps Retro, BlurX, Selection",          { T::Retro, T::BlurX, T::Selection },          fullscreen, nullptr, 0.02f, 50.0 });
+	checks.push_back({ "Lazy maps FrostedGlass, Tint, DepthOfField", { T::FrostedGlass, T::Tint, T::DepthOfField }, fullscreen, nullptr, 1.0f, 52.0, 0.08 });
+	return checks;
+}
+
+
+// Peak signal to noise ratio of the colour channels of b compared with a, for values from 0 to 1. Identical images
+// give infinity
+static double PSNR(const ImageBuffer& a, const ImageBuffer& b)
+{
+	double sumSquares = 0;
+	const int pixels = a.Width() * a.Height();
+	for (int i = 0; i < pixels; ++i)
+	{
+		const ColourRGBA& p = a.Data()[i];
+		const ColourRGBA& q = b.Data()[i];
+		sumSquares += (p.r - q.r) * (p.r - q.r) + (p.g - q.g) * (p.g - q.g) + (p.b - q.b) * (p.b - q.b);
+	}
+	double meanSquare = sumSquares / (3.0 * pixels);
+	return meanSquare > 0 ? 10.0 * std::log10(1.0 / meanSquare) : INFINITY;
+}
+
+// Fraction of pixels of b that differ from a by more than threshold in any channel
+static double FractionOver(const ImageBuffer& a, const ImageBuffer& b, float threshold)
+{
+	int over = 0;
+	const int pixels = a.Width() * a.Height();
+	for (int i = 0; i < pixels; ++i)
+	{
+		const ColourRGBA& p = a.Data()[i];
+		const ColourRGBA& q = b.Data()[i];
+		if (std::abs(p.r - q.r) > threshold || std::abs(p.g - q.g) > threshold ||
+		    std::abs(p.b - q.b) > threshold || std::abs(p.a - q.a) > threshold)  ++over;
+	}
+	return pixels > 0 ? static_cast<double>(over) / pixels : 0.0;
+}
+
+
+// Set up an engine as the reference or the optimised version
+static void ConfigureEngine(PostProcessEngine& engine, bool optimised, const TestImages& images)
+{
+	PostProcessTextures textures;
+	textures.noiseMap   = &images.noise;
+	textures.burnMap    = &images.burn;
+	textures.distortMap = &images.distort;
+	textures.noiseMap2  = &images.noise2;
+	engine.SetTextures(textures);
+	engine.SetFusion(optimised);
+	engine.SetLazyMapDistortion(optimised);
+	for (int type = 0; type < NUM_POST_PROCESS_TYPES; ++type)
+	{
+		engine.SetMethod(static_cast<PostProcessType>(type), optimised ? ProcessMethod::Fast : ProcessMethod::ShaderPort);
+	}
+}
+
+// Run a check's chain on copies of the test images with an engine, returns the fastest time in milliseconds or a negative
+// value on error. The result is left in result
+static double RunChain(const EffectCheck& check, PostProcessEngine& engine, const PostProcessingConstants& defaults,
+                       const TestImages& images, int repetitions, ImageBuffer& result)
+{
+	PostProcessingConstants constants = defaults;
+	engine.SetBloomMode(BloomMode::FullResolution);
+	engine.SetDiagonalBlurs(3);
+	if (check.settings)  check.settings(constants, engine);
+
+	// A polygon over the middle of the screen, given directly in clip space
+	std::vector<std::unique_ptr<PostProcess>> postProcesses;
+	std::vector<PostProcess*> chain;
+	for (PostProcessType type : check.chain)
+	{
+		postProcesses.emplace_back(new PostProcess(type, check.mode));
+		if (check.mode == PostProcessMode::Polygon)
+		{
+			postProcesses.back()->PolyData = new PolygonData({ CVector3{ -0.6f, 0.4f, 0.5f }, CVector3{ -0.4f, -0.5f, 0.5f },
+			                                                   CVector3{ 0.5f, 0.6f, 0.5f }, CVector3{ 0.6f, -0.3f, 0.5f } }, MatrixIdentity());
+		}
+		chain.push_back(postProcesses.back().get());
+	}
+	engine.SetViewProjectionMatrix(MatrixIdentity());
+
+	double bestMs = 1e30;
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+	{
+		ImageBuffer scene = images.scene;
+		ImageBuffer normalDepth = images.normalDepth;
+		ImageBuffer focus = images.focus;
+		int64_t start = ClockNanoseconds();
+		if (!engine.Run(chain, constants, scene, &normalDepth, &focus))
+		{
+			printf("%s: %s\n", check.name.c_str(), engine.LastError().c_str());
+			return -1;
+		}
+		bestMs = std::min(bestMs, NanosecondsToSeconds(ClockNanoseconds() - start) * 1000.0);
+		if (repetition == 0)  result.Swap(scene);
+	}
+	return bestMs;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Fusion
+//--------------------------------------------------------------------------------------
+
+// Chains run with and without fusion
+struct FusionCheck
+{
+	int chains;
+	int fusedPasses;   // Passes on the scene with fusion
+	int unfusedPasses; // and without
+	int notFused;      // Chains that were not fused into one pass, or whose fused shader source is wrong
+	int mismatches;    // Chains whose scene or maps were not identical with and without fusion
+};
+
+// Run every post-process that can start a fused run followed by runs of point post-processes, on engines that differ
+// only in fusion. The results must be identical, maps included. Each chain must fuse into one pass, the last stage has
+// its own settings to check the fused pass reads them, and the shader source for the GPU must include the head and
+// call each stage's colour function in order
+static FusionCheck CheckFusion(const TestImages& images, const PostProcessingConstants& defaults, unsigned int threads)
+{
+	PostProcessEngine fused(threads);
+	PostProcessEngine unfused(threads);
+	ConfigureEngine(fused, true, images);
+	ConfigureEngine(unfused, true, images);
+	fused.SetLazyMapDistortion(false);
+	unfused.SetLazyMapDistortion(false);
+	unfused.SetFusion(false);
+
+	std::vector<PostProcessType> points;
+	for (int type = 1; type < NUM_POST_PROCESS_TYPES; ++type)
+	{
+		if (IsPointPostProcess(static_cast<PostProcessType>(type)))  points.push_back(static_cast<PostProcessType>(type));
+	}
+
+	// Settings the last stage has of its own
+	PostProcessingConstants own = defaults;
+	own.tintColour = { 0.3f, 0.9f, 0.6f };
+	own.gradientHue = { 0.1f, 0.8f };
+	own.hueShift = 0.7f;
+	own.bloomThreshold = 0.4f;
+
+	FusionCheck result = {};
+	for (int head = 1; head < NUM_POST_PROCESS_TYPES; ++head)
+	{
+		if (!CanStartFusedRun(static_cast<PostProcessType>(head)))  continue;
+
+		// One or two point post-processes in every order, then all of them, never repeating the head
+		std::vector<PostProcessType> followers;
+		for (PostProcessType point : points)  if (point != static_cast<PostProcessType>(head))  followers.push_back(point);
+		std::vector<std::vector<PostProcessType>> runs;
+		for (PostProcessType first : followers)
+		{
+			runs.push_back({ first });
+			for (PostProcessType second : followers)  if (second != first)  runs.push_back({ first, second });
+		}
+		runs.push_back(followers);
+
+		for (const auto& run : runs)
+		{
+			std::vector<std::unique_ptr<PostProcess>> postProcesses;
+			std::vector<PostProcess*> chain;
+			postProcesses.emplace_back(new PostProcess(static_cast<PostProcessType>(head)));
+			for (size_t i = 0; i < run.size(); ++i)
+			{
+				bool last = (i + 1 == run.size());
+				postProcesses.emplace_back(new PostProcess(run[i], PostProcessMode::Fullscreen, nullptr,
+				                                           last ? new PostProcessingConstants(own) : nullptr));
+			}
+			for (auto& postProcess : postProcesses)  chain.push_back(postProcess.get());
+			const int numStages = static_cast<int>(chain.size());
+
+			++result.chains;
+			++result.fusedPasses;
+			result.unfusedPasses += numStages;
+
+			std::string source = FusedShaderSource(chain.data(), numStages);
+			size_t position = source.find(std::string("#include \"") + PostProcessTypeName(chain[0]->Type) + "_pp.hlsl\"");
+			for (int i = 1; i < numStages && position != std::string::npos; ++i)
+			{
+				position = source.find(std::string(PostProcessTypeName(chain[i]->Type)) + "Colour(", position);
+			}
+			if (FusedRunLength(chain.data(), numStages) != numStages || position == std::string::npos)
+			{
+				printf("  %s and %d more were not fused\n", PostProcessTypeName(chain[0]->Type), numStages - 1);
+				++result.notFused;
+			}
+
+			ImageBuffer scene[2] = { images.scene, images.scene };
+			ImageBuffer normalDepth[2] = { images.normalDepth, images.normalDepth };
+			ImageBuffer focus[2] = { images.focus, images.focus };
+			if (!fused.Run(chain, defaults, scene[0], &normalDepth[0], &focus[0]) ||
+			    !unfused.Run(chain, defaults, scene[1], &normalDepth[1], &focus[1]))
+			{
+				PostProcessEngine& failed = fused.LastError().empty() ? unfused : fused;
+				printf("  %s: %s\n", PostProcessTypeName(chain[0]->Type), failed.LastError().c_str());
+				++result.mismatches;
+				continue;
+			}
+			if (scene[0].MaxDifference(scene[1]) != 0 || normalDepth[0].MaxDifference(normalDepth[1]) != 0 ||
+			    focus[0].MaxDifference(focus[1]) != 0)
+			{
+				printf("  %s and %d more: fused result differs by up to %g\n", PostProcessTypeName(chain[0]->Type),
+				       numStages - 1, scene[0].MaxDifference(scene[1]));
+				++result.mismatches;
+			}
+		}
+	}
+	return result;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shader constant buffers
+//--------------------------------------------------------------------------------------
+
+// A cbuffer or function declared at the top level of a shader file
+struct ShaderDeclaration
+{
+	int                   reg = -1; // Register (bN) of a cbuffer, -1 for a function
+	std::set<std::string> names;    // Members of a cbuffer, or every identifier in the body of a function
+};
+typedef std::map<std::string, ShaderDeclaration> ShaderDeclarations;
+
+static bool IsIdentifierStart(char c) { return isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+static bool IsIdentifierChar(char c)  { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+// Identifiers in some HLSL, in order
+static std::vector<std::string> Identifiers(const std::string& code)
+{
+	std::vector<std::string> identifiers;
+	for (size_t i = 0; i < code.size(); )
+	{
+		if (!IsIdentifierStart(code[i]))
+		{
+			// Skip numbers whole so the suffix of e.g. 1.0f is not taken as an identifier
+			if (isdigit(static_cast<unsigned char>(code[i])))  while (i < code.size() && IsIdentifierChar(code[i]))  ++i;
+			else  ++i;
+			continue;
+		}
+		size_t start = i;
+		while (i < code.size() && IsIdentifierChar(code[i]))  ++i;
+		identifiers.push_back(code.substr(start, i - start));
+	}
+	return identifiers;
+}
+
+// Read the cbuffers and functions of a shader file into declarations, ignoring comments, preprocessor lines, structs
+// and variables. Returns false if the file can't be read
+static bool ReadShaderDeclarations(const std::string& fileName, ShaderDeclarations& declarations)
+{
+	std::ifstream file(fileName);
+	if (!file)  return false;
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string text = contents.str();
+
+	// Remove comments and preprocessor lines
+	std::string code;
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		bool preprocessor = (text[i] == '#' && (i == 0 || text[i - 1] == '\n'));
+		if (text.compare(i, 2, "//") == 0 || preprocessor)
+		{
+			i = std::min(text.find('\n', i), text.size()) - 1;
+		}
+		else if (text.compare(i, 2, "/*") == 0)
+		{
+			i = std::min(text.find("*/", i + 2), text.size() - 2) + 1;
+		}
+		else
+		{
+			code += text[i];
+		}
+	}
+
+	// Each top level block is a cbuffer, function or struct, named by what comes before it
+	size_t headerStart = 0;
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		if (code[i] == ';')  headerStart = i + 1;
+		if (code[i] != '{')  continue;
+
+		size_t end = i + 1;
+		for (int depth = 1; end < code.size() && depth > 0; ++end)
+		{
+			if      (code[end] == '{')  ++depth;
+			else if (code[end] == '}')  --depth;
+		}
+		const std::string header = code.substr(headerStart, i - headerStart);
+		const std::string body   = code.substr(i + 1, end - i - 2);
+		std::vector<std::string> headerNames = Identifiers(header);
+
+		if (!headerNames.empty() && headerNames[0] == "cbuffer" && headerNames.size() > 1)
+		{
+			// Members are the last identifier of each declaration, e.g. float4 gPolygon2DPoints[4]
+			ShaderDeclaration& cbuffer = declarations[headerNames[1]];
+			size_t reg = header.find("register(b");
+			cbuffer.reg = (reg == std::string::npos) ? 0 : atoi(header.c_str() + reg + 10);
+			size_t start = 0;
+			for (size_t semicolon = body.find(';'); semicolon != std::string::npos; semicolon = body.find(';', start))
+			{
+				std::vector<std::string> names = Identifiers(body.substr(start, semicolon - start));
+				if (!names.empty())  cbuffer.names.insert(names.back());
+				start = semicolon + 1;
+			}
+		}
+		else if (header.find('(') != std::string::npos)
+		{
+			std::vector<std::string> names = Identifiers(header.substr(0, header.find('(')));
+			if (!names.empty())
+			{
+				std::vector<std::string> bodyNames = Identifiers(body);
+				declarations[names.back()].names.insert(bodyNames.begin(), bodyNames.end());
+			}
+		}
+		i = end - 1;
+		headerStart = end;
+	}
+	return true;
+}
+
+// Add the cbuffers a function reads to a set, including those read by the functions it calls
+static void CbuffersRead(const ShaderDeclarations& declarations, const std::string& function,
+                         std::set<std::string>& visited, std::set<std::string>& cbuffers)
+{
+	auto found = declarations.find(function);
+	if (found == declarations.end() || found->second.reg >= 0 || !visited.insert(function).second)  return;
+
+	for (const std::string& name : found->second.names)
+	{
+		for (const auto& declaration : declarations)
+		{
+			if (declaration.second.reg >= 0 && declaration.second.names.count(name) > 0)  cbuffers.insert(declaration.first);
+		}
+		CbuffersRead(declarations, name, visited, cbuffers);
+	}
+}
+
+// The block a cbuffer holds, from its name ("PostProcessAreaConstants" or <block name>"Constants"). Other cbuffers,
+// such as the per-frame constants, give ConstantBlock::None
+static ConstantBlock CbufferBlock(const std::string& cbuffer)
+{
+	for (int block = 1; block < NUM_CONSTANT_BLOCKS; ++block)
+	{
+		std::string name = ConstantBlockName(static_cast<ConstantBlock>(block)) + std::string("Constants");
+		if (cbuffer == name || cbuffer == "PostProcess" + name)  return static_cast<ConstantBlock>(block);
+	}
+	return ConstantBlock::None;
+}
+
+// Check each post-process's pixel shader, <type>_pp.hlsl in the given folder, reads exactly the blocks that
+// PostProcessConstantBlocks gives for it (and the area, which every pass sends), each at the register it is bound to.
+// Returns the number of shaders checked, failures are counted and printed
+static int CheckShaderConstantBuffers(const std::string& folder, int& failures)
+{
+	ShaderDeclarations common;
+	if (!ReadShaderDeclarations(folder + "/Common.hlsli", common))
+	{
+		printf("  Can't read %s/Common.hlsli, pass the folder of the shaders with --shaders\n", folder.c_str());
+		++failures;
+		return 0;
+	}
+
+	int numShaders = 0;
+	for (int type = 1; type < NUM_POST_PROCESS_TYPES; ++type)
+	{
+		std::string fileName = PostProcessTypeName(static_cast<PostProcessType>(type)) + std::string("_pp.hlsl");
+		ShaderDeclarations declarations = common;
+		if (!ReadShaderDeclarations(folder + "/" + fileName, declarations))
+		{
+			printf("  Can't read %s\n", fileName.c_str());
+			++failures;
+			continue;
+		}
+		++numShaders;
+
+		std::set<std::string> visited, cbuffers;
+		CbuffersRead(declarations, "main", visited, cbuffers);
+		PostProcessBlocks sent = PostProcessConstantBlocks(static_cast<PostProcessType>(type));
+
+		std::string problems;
+		for (const std::string& cbuffer : cbuffers)
+		{
+			ConstantBlock block = CbufferBlock(cbuffer);
+			if (block == ConstantBlock::None)  continue;
+			if (declarations[cbuffer].reg != ConstantBlockRegister(block))
+			{
+				problems += " " + cbuffer + " is at b" + std::to_string(declarations[cbuffer].reg) + " not b" +
+				            std::to_string(ConstantBlockRegister(block)) + ",";
+			}
+			if (block != ConstantBlock::Area && std::find(sent.begin(), sent.end(), block) == sent.end())
+			{
+				problems += " reads " + cbuffer + ", which is not sent,";
+			}
+		}
+		for (ConstantBlock block : sent)
+		{
+			bool read = false;
+			for (const std::string& cbuffer : cbuffers)  read = read || CbufferBlock(cbuffer) == block;
+			if (!read)  problems += std::string(" is sent ") + ConstantBlockName(block) + " but does not read it,";
+		}
+		if (!problems.empty())
+		{
+			problems.pop_back();
+			printf("  %s%s\n", fileName.c_str(), problems.c_str());
+			++failures;
+		}
+	}
+	return numShaders;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Constant uploads
+//--------------------------------------------------------------------------------------
+
+// Sends the settings for each step of a post-processing graph as the GPU path in Scene.cpp does, to buffers kept in
+// memory. After each send the buffer is compared with the block written straight from the settings, so a block that
+// was skipped as unchanged when it had changed is found
+class ConstantUploadCheck : public PostProcessGraphBackend
+{
+public:
+	ConstantUploadCheck(PostProcessingConstants& shared, int diagonalBlurs)
+		: mCache(&mMemory), mShared(shared), mDiagonalBlurs(diagonalBlurs) {}
+
+	void RunPass(const GraphStep& step) override
+	{
+		// The full resolution bloom texture (RenderBloomTexture), the streaks change direction each pass
+		if (step.image == GraphImage::Bloom)
+		{
+			FullScreen(PostProcessType::Brightness, nullptr);
+			FullScreen(PostProcessType::BlurY, nullptr);
+			FullScreen(PostProcessType::BlurX, nullptr);
+			for (int j = 0; j < mDiagonalBlurs; ++j)
+			{
+				mShared.directionalBlurX = std::cos(j * PI / mDiagonalBlurs);
+				mShared.directionalBlurY = std::sin(j * PI / mDiagonalBlurs);
+				FullScreen(PostProcessType::DirectionalBlur, nullptr);
+			}
+		}
+		else if (step.numStages > 1)
+		{
+			for (int i = 1; i < step.numStages; ++i)  SendSettings(step.stages[i]->Type, step.stages[i]);
+			FullScreen(step.stages[0]->Type, step.stages[0]);
+		}
+		else if (step.postProcess->Mode == PostProcessMode::Fullscreen)
+		{
+			FullScreen(step.postProcess->Type, step.postProcess);
+		}
+		else
+		{
+			SendArea(step.postProcess);
+			SendSettings(step.postProcess->Type, step.postProcess);
+		}
+	}
+
+	void Copy(const GraphStep& step) override
+	{
+		if (step.type == GraphStepType::Copy || step.postProcess->Mode == PostProcessMode::Fullscreen)
+		{
+			FullScreen(PostProcessType::Copy, nullptr);
+		}
+		else
+		{
+			SendArea(step.postProcess);
+			SendSettings(PostProcessType::Copy, nullptr);
+		}
+	}
+
+	// A full screen pass, e.g. the copy to the back buffer at the end of the frame
+	void FullScreen(PostProcessType type, const PostProcess* settings)
+	{
+		SendArea(nullptr);
+		SendSettings(type, settings);
+	}
+
+	PostProcessConstantCache& Cache() { return mCache; }
+
+	// Sends that left a buffer holding something other than the settings it was sent
+	int StaleBuffers() const { return mStaleBuffers; }
+
+private:
+	// Area as AreaPostProcess and PolygonPostProcess set it, a fixed area for area post-processes
+	void SendArea(const PostProcess* areaOwner)
+	{
+		if (areaOwner == nullptr || areaOwner->Mode == PostProcessMode::Fullscreen)
+		{
+			mShared.area2DTopLeft = { 0, 0 };
+			mShared.area2DSize    = { 1, 1 };
+			mShared.area2DDepth   = 0;
+		}
+		else if (areaOwner->Mode == PostProcessMode::Area)
+		{
+			mShared.area2DTopLeft = { 0.4f, 0.3f };
+			mShared.area2DSize    = { 0.2f, 0.3f };
+			mShared.area2DDepth   = 0.5f;
+		}
+		else
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				mShared.polygon2DPoints[i] = CVector4(areaOwner->PolyData->Points[i], 1) * areaOwner->PolyData->Matrix;
+			}
+		}
+		Send(ConstantBlock::Area, areaOwner, mShared);
+	}
+
+	void SendSettings(PostProcessType type, const PostProcess* settings)
+	{
+		bool ownSettings = (settings != nullptr && settings->Constants != nullptr);
+		for (ConstantBlock block : PostProcessConstantBlocks(type))
+		{
+			Send(block, ownSettings ? settings : nullptr, ownSettings ? *settings->Constants : mShared);
+		}
+	}
+
+	void Send(ConstantBlock block, const void* owner, const PostProcessingConstants& settings)
+	{
+		int buffer = mCache.Update(block, owner, settings);
+		uint8_t expected[MAX_CONSTANT_BLOCK_BYTES];
+		WriteConstantBlock(block, settings, expected);
+		const size_t bytes = ConstantBlockBytes(block);
+		if (buffer < 0 || mMemory.Contents(buffer).size() != bytes || memcmp(mMemory.Contents(buffer).data(), expected, bytes) != 0)
+		{
+			++mStaleBuffers;
+		}
+	}
+
+	MemoryConstantBackend    mMemory;
+	PostProcessConstantCache mCache;
+	PostProcessingConstants& mShared;
+	int                      mDiagonalBlurs;
+	int                      mStaleBuffers = 0;
+};
+
+
+// Uploads over a number of frames of one kind
+struct UploadCheck
+{
+	const char* name;
+	int         frames;
+	int         uploads;       // Map calls
+	size_t      uploadedBytes;
+	size_t      wholeBytes;    // Bytes sending the whole of PostProcessingConstants to every pass would take
+	int         maxUploads;    // Most uploads allowed in each frame, -1 for no limit
+};
+
+// Run frames of a scene-like chain through a graph with its settings sent as the GPU path does: polygon post-processes,
+// including two hue shifts with different settings, an area post-process then full screen ones with bloom and a fused
+// run. The first frame uploads everything, then the settings are animated as UpdateScene does, then nothing changes
+static std::vector<UploadCheck> CheckConstantUploads(PostProcessingConstants defaults, RandomGenerator& random, int& failures)
+{
+	typedef PostProcessType T;
+	const int diagonalBlurs = 3;
+	const int animatedFrames = 60;
+
+	// Polygons given directly in clip space, the second hue shift has its own settings
+	auto polygon = [](float x) { return new PolygonData({ CVector3{ x, 0.4f, 0.5f }, CVector3{ x, -0.4f, 0.5f },
+	                                                      CVector3{ x + 0.3f, 0.4f, 0.5f }, CVector3{ x + 0.3f, -0.4f, 0.5f } },
+	                                                    MatrixIdentity()); };
+	PostProcessingConstants* hueShiftConstants = new PostProcessingConstants(defaults);
+	hueShiftConstants->hueShift = 0.5f;
+	std::vector<std::unique_ptr<PostProcess>> postProcesses;
+	postProcesses.emplace_back(new PostProcess(T::Underwater, PostProcessMode::Polygon, polygon(-0.9f)));
+	postProcesses.emplace_back(new PostProcess(T::HueShift,   PostProcessMode::Polygon, polygon(-0.5f)));
+	postProcesses.emplace_back(new PostProcess(T::HueShift,   PostProcessMode::Polygon, polygon(-0.1f), hueShiftConstants));
+	postProcesses.emplace_back(new PostProcess(T::Retro,      PostProcessMode::Polygon, polygon(0.3f)));
+	postProcesses.emplace_back(new PostProcess(T::Spiral,     PostProcessMode::Area));
+	postProcesses.emplace_back(new PostProcess(T::Bloom));
+	postProcesses.emplace_back(new PostProcess(T::GreyNoise));
+	postProcesses.emplace_back(new PostProcess(T::BlurX));
+	postProcesses.emplace_back(new PostProcess(T::Tint));
+	postProcesses.emplace_back(new PostProcess(T::HueShift));
+	std::vector<PostProcess*> chain;
+	for (auto& postProcess : postProcesses)  chain.push_back(postProcess.get());
+
+	PostProcessingConstants shared = defaults;
+	shared.copyAlpha = 1.0f;
+	ConstantUploadCheck check(shared, diagonalBlurs);
+	PostProcessGraph graph;
+
+	// Returns the uploads of the frame
+	auto runFrame = [&]()
+	{
+		graph.Clear();
+		graph.AddPostProcesses(chain, false);
+		graph.Compile();
+		graph.Execute(check);
+		check.FullScreen(T::Copy, nullptr);
+		check.Cache().EndFrame();
+		return check.Cache().Stats();
+	};
+	auto addFrame = [](UploadCheck& result, const ConstantUploadStats& stats)
+	{
+		++result.frames;
+		result.uploads += stats.uploads;
+		result.uploadedBytes += stats.uploadedBytes;
+		result.wholeBytes += stats.wholeBytes;
+	};
+
+	std::vector<UploadCheck> results;
+	results.push_back({ "First frame", 0, 0, 0, 0, -1 });
+	addFrame(results.back(), runFrame());
+
+	// Settings UpdateScene changes every frame
+	results.push_back({ "Animated frames", 0, 0, 0, 0, -1 });
+	for (int frame = 0; frame < animatedFrames; ++frame)
+	{
+		shared.noiseOffset = { random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f) };
+		shared.heatHazeTimer += 1.0f / 60;
+		shared.hueShift = std::fmod(shared.hueShift + 0.01f, 1.0f);
+		shared.wobbleTimer += 1.0f / 60;
+		addFrame(results.back(), runFrame());
+	}
+
+	// Only the streak directions change within a frame, so nothing else should be sent again
+	results.push_back({ "Unchanged frames", 0, 0, 0, 0, diagonalBlurs });
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		ConstantUploadStats stats = runFrame();
+		if (stats.uploads > diagonalBlurs)  ++failures;
+		addFrame(results.back(), stats);
+	}
+
+	if (check.StaleBuffers() > 0)
+	{
+		printf("  %d buffers did not hold the settings they were sent\n", check.StaleBuffers());
+		++failures;
+	}
+
+	// Both hue shifts keep their own values - with a single buffer one would replace the other every frame
+	const PostProcess* ownHueShift = chain[2];
+	if (check.Cache().IsDirty(ConstantBlock::HueShift, ownHueShift, *hueShiftConstants) ||
+	    check.Cache().IsDirty(ConstantBlock::HueShift, nullptr, shared))
+	{
+		printf("  Post-processes with their own settings replaced the shared settings\n");
+		++failures;
+	}
+	return results;
+}
+
+
+//--------------------------------------------------------------------------------------
+// State filter
+//--------------------------------------------------------------------------------------
+
+// Records calls and, as Direct3D does, unbinds a texture's shader resource views when it becomes the render target and
+// refuses to bind a view of the current render target. Each texture has a shader resource view and a render target
+// view, given as handles into an array of two entries per texture so the texture of a handle can be found
+class HazardStateBackend : public RecordingStateBackend
+{
+public:
+	static const int NUM_TEXTURES = 6;
+
+	// The views array must stay valid for the life of the backend
+	HazardStateBackend(int (*views)[2]) : mViews(views) {}
+
+	void* ShaderResource(int texture) { return &mViews[texture][0]; }
+	void* RenderTarget(int texture)   { return &mViews[texture][1]; }
+
+	void SetRenderTarget(void* renderTarget, void* depthStencil) override
+	{
+		RecordingStateBackend::SetRenderTarget(renderTarget, depthStencil);
+		for (auto& shaderResource : Bindings().shaderResources)
+		{
+			if (shaderResource != nullptr && Texture(shaderResource) == Texture(renderTarget))  shaderResource = nullptr;
+		}
+	}
+
+	void SetShaderResource(int slot, void* shaderResource) override
+	{
+		RecordingStateBackend::SetShaderResource(slot, shaderResource);
+		void* renderTarget = Bindings().renderTarget;
+		if (shaderResource != nullptr && renderTarget != nullptr && Texture(shaderResource) == Texture(renderTarget))
+		{
+			Bindings().shaderResources[slot] = nullptr;
+		}
+	}
+
+private:
+	int Texture(void* view) const { return static_cast<int>((static_cast<const int*>(view) - &mViews[0][0]) / 2); }
+
+	int (*mViews)[2];
+};
+
+
+// Calls made with and without the filter over a run of passes
+struct StateFilterCheck
+{
+	int passes;
+	int unfilteredCalls;
+	int issued;
+	int skipped;
+	int mismatches; // Draws where the filtered device had something different bound
+};
+
+// Run frames of post-processing passes shaped like those in Scene.cpp - ping-ponging between two scene textures, a bloom
+// pyramid with no depth buffer, area and polygon passes with their own vertex shader and blend state and a final copy
+// with the scene left bound - with and without a filter. Before each frame the device is changed directly, as rendering
+// the models does, and the filter invalidated. At each draw the filtered device must have the same bindings
+static StateFilterCheck CheckStateFilter(RandomGenerator& random, int frames)
+{
+	int views[HazardStateBackend::NUM_TEXTURES][2] = {};
+	HazardStateBackend direct(views);
+	HazardStateBackend filtered(views);
+	RenderStateFilter filter(&filtered);
+
+	// Other handles, only compared so any distinct addresses will do
+	int objects[16] = {};
+	void* depthBuffer   = &objects[0];
+	void* quadShader    = &objects[1];
+	void* polygonShader = &objects[2];
+	void* pointSampler  = &objects[3];
+	void* otherSampler  = &objects[4];
+	void* noBlending    = &objects[5];
+	void* alphaBlending = &objects[6];
+	void* depthReadOnly = &objects[7];
+	void* cullNone      = &objects[8];
+	void* noiseMap      = &objects[9];
+	void* pixelShaders  = &objects[10]; // 4 shaders from here
+	void* areaBuffers   = &objects[14]; // 2 area buffers from here
+	const int triangleStrip = 5;
+
+	StateFilterCheck result = {};
+	auto both = [&](std::function<void(RenderStateBackend&)> call) { call(direct); call(filter); };
+	auto pass = [&](int source, int target, void* depthStencil, bool polygon, void* blendState, int shader, void* texture1)
+	{
+		both([&](RenderStateBackend& device) { device.SetRenderTarget(direct.RenderTarget(target), depthStencil); });
+		both([&](RenderStateBackend& device) { device.SetShaderResource(0, direct.ShaderResource(source)); });
+		both([&](RenderStateBackend& device) { device.SetSampler(0, pointSampler); });
+		both([&](RenderStateBackend& device) { device.SetVertexShader(polygon ? polygonShader : quadShader); });
+		both([&](RenderStateBackend& device) { device.SetGeometryShader(nullptr); });
+		both([&](RenderStateBackend& device) { device.SetBlendState(blendState); });
+		both([&](RenderStateBackend& device) { device.SetDepthStencilState(depthReadOnly); });
+		both([&](RenderStateBackend& device) { device.SetRasterizerState(cullNone); });
+		both([&](RenderStateBackend& device) { device.SetInputLayout(nullptr); });
+		both([&](RenderStateBackend& device) { device.SetTopology(triangleStrip); });
+		both([&](RenderStateBackend& device) { device.SetPixelShader(static_cast<int*>(pixelShaders) + shader); });
+		if (texture1 != nullptr)
+		{
+			both([&](RenderStateBackend& device) { device.SetShaderResource(1, texture1); });
+			both([&](RenderStateBackend& device) { device.SetSampler(1, otherSampler); });
+		}
+		void* areaBuffer = static_cast<int*>(areaBuffers) + (polygon ? 1 : 0);
+		both([&](RenderStateBackend& device) { device.SetConstantBuffer(ShaderStage::Vertex, 1, areaBuffer); });
+		both([&](RenderStateBackend& device) { device.SetConstantBuffer(ShaderStage::Pixel, 1, areaBuffer); });
+
+		// Draw
+		if (filtered.Bindings() != direct.Bindings())  ++result.mismatches;
+		++result.passes;
+	};
+
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		// Models rendered with direct calls, then the filter told it no longer knows what is bound
+		for (HazardStateBackend* device : { &direct, &filtered })
+		{
+			device->SetRenderTarget(device->RenderTarget(0), depthBuffer);
+			device->SetInputLayout(&objects[random.Range(0u, 15u)]);
+			device->SetTopology(4);
+			device->SetShaderResource(0, device->ShaderResource(random.Range(2u, 5u)));
+		}
+		filter.Invalidate();
+
+		// Bloom pyramid into textures 2 to 5, streaks added with alpha blending, then the post-processes between the two
+		// scene textures. Some read the noise map or a normal/depth map, which other passes distort between textures 4
+		// and 5, so a texture read may have been a render target since it was last read
+		pass(0, 2, nullptr, false, noBlending, 0, nullptr);
+		for (int level = 3; level < HazardStateBackend::NUM_TEXTURES; ++level)  pass(level - 1, level, nullptr, false, noBlending, 1, nullptr);
+		for (int level = HazardStateBackend::NUM_TEXTURES - 1; level > 2; --level)  pass(level, level - 1, nullptr, false, alphaBlending, 2, nullptr);
+		int scene = 0;
+		int map = 4;
+		int numPasses = random.Range(2u, 8u);
+		for (int i = 0; i < numPasses; ++i)
+		{
+			int texture1 = random.Range(0u, 2u);
+			bool polygon = (random.Range(0u, 2u) == 0);
+			pass(scene, 1 - scene, depthBuffer, polygon, polygon ? alphaBlending : noBlending, random.Range(0u, 3u),
+			     texture1 == 0 ? nullptr : texture1 == 1 ? noiseMap : direct.ShaderResource(map));
+			scene = 1 - scene;
+			if (random.Range(0u, 1u) == 1)
+			{
+				pass(map, 9 - map, depthBuffer, false, noBlending, 0, nullptr);
+				map = 9 - map;
+			}
+		}
+		pass(scene, 1 - scene, depthBuffer, false, noBlending, 3, nullptr);
+		both([&](RenderStateBackend& device) { device.SetShaderResource(0, nullptr); });
+		filter.EndFrame();
+	}
+
+	result.unfilteredCalls = static_cast<int>(direct.Calls().size()) - frames * 4; // Not counting the direct calls
+	result.issued  = static_cast<int>(filter.Stats().totalIssued);
+	result.skipped = static_cast<int>(filter.Stats().totalSkipped);
+	return result;
+}
+
+
+int main(int argc, char* argv[])
+{
+	uint64_t seed = 1;
+	int width = 320;
+	int height = 180;
+	unsigned int threads = 0;
+	int repetitions = 3;
+	std::string shaderFolder = ".";
+	for (int i = 1; i < argc; ++i)
+	{
+		if      (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)         seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)      threads = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)  repetitions = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc)      shaderFolder = argv[++i];
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2 &&
+		         width > 0 && height > 0)  ++i;
+		else
+		{
+			printf("Usage: PostProcessConformance [--seed n] [--size WxH] [--threads n] [--repetitions n] [--shaders folder]\n");
+			return 1;
+		}
+	}
+
+	RandomGenerator random(seed);
+	int failures = 0;
+
+	printf("Shader functions (largest difference from double precision)\n");
+	for (const FunctionCheck& check : CheckShaderFunctions(random, 100000))
+	{
+		bool pass = check.maxError <= check.limit;
+		if (!pass)  ++failures;
+		printf("  %-24s %12.3g  limit %8.1g  %s\n", check.name, check.maxError, check.limit, pass ? "pass" : "FAIL");
+	}
+
+	TestImages images(width, height, random);
+	PostProcessingConstants defaults = DefaultConstants(width, height, random);
+	PostProcessEngine reference(threads);
+	PostProcessEngine optimised(threads);
+	ConfigureEngine(reference, false, images);
+	ConfigureEngine(optimised, true, images);
+
+	printf("\nEffects at %dx%d, seed %llu (optimised compared with reference)\n", width, height, static_cast<unsigned long long>(seed));
+	printf("  %-44s %10s %8s %8s %10s %8s %8s %9s %9s %8s\n", "Check", "Max error", "PSNR", "Over", "Limits", "", "", "Ref ms",
+	       "Opt ms", "Speed-up");
+	for (const EffectCheck& check : EffectChecks())
+	{
+		ImageBuffer referenceResult, optimisedResult;
+		double referenceMs = RunChain(check, reference, defaults, images, repetitions, referenceResult);
+		double optimisedMs = RunChain(check, optimised, defaults, images, repetitions, optimisedResult);
+		if (referenceMs < 0 || optimisedMs < 0)  return 1;
+
+		float maxError = referenceResult.MaxDifference(optimisedResult);
+		double psnr = PSNR(referenceResult, optimisedResult);
+		double over = FractionOver(referenceResult, optimisedResult, DIFFERENT_PIXEL);
+		bool pass = maxError >= 0 && maxError <= check.maxError && psnr >= check.minPSNR && over <= check.maxOver;
+		if (!pass)  ++failures;
+		printf("  %-44s %10.2g %8.1f %7.3f%% %10.2g %8.1f %7.3f%% %9.2f %9.2f %7.2fx  %s\n", check.name.c_str(), maxError,
+		       std::min(psnr, 999.9), over * 100, check.maxError, check.minPSNR, check.maxOver * 100, referenceMs, optimisedMs,
+		       referenceMs / std::max(optimisedMs, 1e-6), pass ? "pass" : "FAIL");
+	}
+
+	printf("\nFusion (the same engine with and without fusion, must be identical)\n");
+	FusionCheck fusionCheck = CheckFusion(images, defaults, threads);
+	bool fusionPass = (fusionCheck.notFused == 0 && fusionCheck.mismatches == 0);
+	printf("  %d chains, %d passes fused against %d unfused, %d not fused, %d with different results  %s\n", fusionCheck.chains,
+	       fusionCheck.fusedPasses, fusionCheck.unfusedPasses, fusionCheck.notFused, fusionCheck.mismatches, fusionPass ? "pass" : "FAIL");
+	if (!fusionPass)  ++failures;
+
+	printf("\nShader constant buffers (cbuffers each pixel shader reads against the blocks sent)\n");
+	int shaderFailures = 0;
+	int numShaders = CheckShaderConstantBuffers(shaderFolder, shaderFailures);
+	printf("  %d shaders, %d reading the wrong blocks  %s\n", numShaders, shaderFailures, shaderFailures == 0 ? "pass" : "FAIL");
+	failures += shaderFailures;
+
+	printf("\nConstant uploads (memory buffers, as the GPU path sends them)\n");
+	printf("  %-20s %8s %14s %16s %16s %8s\n", "Frames", "Count", "Uploads/frame", "Bytes/frame", "Whole bytes/frame", "Saving");
+	int uploadFailures = 0;
+	for (const UploadCheck& check : CheckConstantUploads(defaults, random, uploadFailures))
+	{
+		bool pass = (check.maxUploads < 0 || check.uploads <= check.maxUploads * check.frames);
+		printf("  %-20s %8d %14.1f %16.0f %16.0f %7.1f%%  %s\n", check.name, check.frames,
+		       static_cast<double>(check.uploads) / check.frames, static_cast<double>(check.uploadedBytes) / check.frames,
+		       static_cast<double>(check.wholeBytes) / check.frames, 100.0 * (1.0 - static_cast<double>(check.uploadedBytes) / check.wholeBytes),
+		       pass && uploadFailures == 0 ? "pass" : "FAIL");
+	}
+	failures += uploadFailures;
+
+	printf("\nState filter (recorded calls, direct against filtered)\n");
+	StateFilterCheck stateCheck = CheckStateFilter(random, 100);
+	bool statesPass = (stateCheck.mismatches == 0 && stateCheck.issued + stateCheck.skipped == stateCheck.unfilteredCalls);
+	printf("  %d passes, %d calls unfiltered, %d issued, %d skipped (%.1f%%), %d draws with different bindings  %s\n",
+	       stateCheck.passes, stateCheck.unfilteredCalls, stateCheck.issued, stateCheck.skipped,
+	       100.0 * stateCheck.skipped / stateCheck.unfilteredCalls, stateCheck.mismatches, statesPass ? "pass" : "FAIL");
+	if (!statesPass)  ++failures;
+
+	printf("\n%s, %d check%s failed\n", failures == 0 ? "Conforms" : "Does not conform", failures, failures == 1 ? "" : "s");
+	return failures == 0 ? 0 : 1;
+}
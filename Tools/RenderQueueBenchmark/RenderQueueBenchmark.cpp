@@ -0,0 +1,394 @@
+//--------------------------------------------------------------------------------------
+// Render queue benchmark - checks the order of the render queue's sort and counts the
+// state changes it saves on scenes of random objects, and times the sort
+//--------------------------------------------------------------------------------------
+// Usage: RenderQueueBenchmark [options]
+//   --objects list      Numbers of opaque objects in the scenes (default 10,100,1000,10000,100000)
+//   --meshes n          Different meshes the objects use (default 64)
+//   --textures n        Different textures the objects use (default 256)
+//   --shaders n         Different shaders the objects use (default 4)
+//   --seed n            Seed for the scenes (default 1)
+//   --repetitions n     Timed sorts of each scene, the fastest is reported (default 5)
+// Lists are separated by commas. Returns 1 if any check fails.
+//
+// Each scene is laid out like the one in Scene.cpp: opaque objects each with a mesh, texture and shader, a sky and a
+// few blended lights, added to a RenderQueue (RenderQueue.h) in a random order at random distances from the camera.
+// After sorting, the queue must:
+//   - hold the same draws in the same order as std::stable_sort on the keys
+//   - give back the pass, shader, texture and mesh of each draw from its key
+//   - have the passes in order, each state group of the opaque and sky passes in one run of draws, the draws of a group
+//     front to back, and the blended draws back to front
+// The scene is then moved a little and sorted again from the order of the last frame, as the queue is in the app, and
+// checked again, as is a copy of the scene with only a few different keys to check draws with equal keys keep their
+// order. Then the binds that walking the queue makes in the colour and the normals and depth passes (Scene.cpp) are
+// counted for the queue in the order the draws were added and sorted, with the radix sort timed against std::sort and
+// std::stable_sort.
+//
+// Only needs the Math and Utility folders, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -IMath -IUtility Tools/RenderQueueBenchmark/RenderQueueBenchmark.cpp Utility/RenderQueue.cpp
+//     Utility/Clock.cpp
+
+#include "RenderQueue.h"
+#include "Clock.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+
+//--------------------------------------------------------------------------------------
+// Scenes
+//--------------------------------------------------------------------------------------
+
+const int NUM_SCENE_LIGHTS = 8;
+
+// A draw as the app keeps it, with the fields its key is made from
+struct BenchmarkDraw
+{
+	RenderPass pass;
+	int        shader;
+	int        texture;
+	int        mesh;
+	float      depth;
+};
+
+struct SceneSettings
+{
+	int numMeshes   = 64;
+	int numTextures = 256;
+	int numShaders  = 4;
+};
+
+// Opaque objects in a random order, then the sky and the lights. The sky and lights use the last shader and textures
+static std::vector<BenchmarkDraw> MakeScene(int numObjects, const SceneSettings& settings, RandomGenerator& random)
+{
+	std::vector<BenchmarkDraw> draws;
+	for (int i = 0; i < numObjects; ++i)
+	{
+		draws.push_back({ RenderPass::Opaque,
+		                  static_cast<int>(random.Range(0u, static_cast<uint32_t>(settings.numShaders  - 1))),
+		                  static_cast<int>(random.Range(0u, static_cast<uint32_t>(settings.numTextures - 1))),
+		                  static_cast<int>(random.Range(0u, static_cast<uint32_t>(settings.numMeshes   - 1))),
+		                  random.Range(1.0f, 1000.0f) });
+	}
+	draws.push_back({ RenderPass::Sky, settings.numShaders, settings.numTextures, settings.numMeshes, 0.0f });
+	for (int i = 0; i < NUM_SCENE_LIGHTS; ++i)
+	{
+		draws.push_back({ RenderPass::Blended, settings.numShaders, settings.numTextures + 1, settings.numMeshes + 1,
+		                  random.Range(1.0f, 1000.0f) });
+	}
+	return draws;
+}
+
+static uint64_t DrawKey(const BenchmarkDraw& draw)
+{
+	return MakeSortKey(draw.pass, draw.shader, draw.texture, draw.mesh, draw.depth);
+}
+
+static void FillQueue(RenderQueue& queue, const std::vector<BenchmarkDraw>& draws)
+{
+	queue.Clear();
+	for (size_t i = 0; i < draws.size(); ++i)  queue.Add(DrawKey(draws[i]), static_cast<uint32_t>(i));
+}
+
+
+//--------------------------------------------------------------------------------------
+// Checks
+//--------------------------------------------------------------------------------------
+
+// Check a sorted queue of the given draws, printing the first problem found. Returns false if there is a problem
+static bool CheckSortedQueue(const RenderQueue& queue, const std::vector<BenchmarkDraw>& draws, const char* name)
+{
+	if (queue.Size() != draws.size())
+	{
+		printf("  %s: queue holds %d draws, expected %d\n", name, static_cast<int>(queue.Size()), static_cast<int>(draws.size()));
+		return false;
+	}
+
+	// Same order as a stable sort of the keys in the order they were added
+	std::vector<RenderQueueItem> expected;
+	for (size_t i = 0; i < draws.size(); ++i)  expected.push_back({ DrawKey(draws[i]), static_cast<uint32_t>(i) });
+	std::stable_sort(expected.begin(), expected.end(), [](const RenderQueueItem& a, const RenderQueueItem& b) { return a.key < b.key; });
+
+	std::vector<bool> seen(draws.size(), false);
+	for (size_t i = 0; i < queue.Size(); ++i)
+	{
+		const RenderQueueItem& item = queue[i];
+		if (item.draw >= draws.size() || seen[item.draw])
+		{
+			printf("  %s: position %d holds draw %u, which is out of range or repeated\n", name, static_cast<int>(i), item.draw);
+			return false;
+		}
+		seen[item.draw] = true;
+
+		if (item.key != expected[i].key || item.draw != expected[i].draw)
+		{
+			printf("  %s: position %d holds draw %u, std::stable_sort puts draw %u there\n", name, static_cast<int>(i),
+			       item.draw, expected[i].draw);
+			return false;
+		}
+
+		const BenchmarkDraw& draw = draws[item.draw];
+		if (SortKeyPass(item.key) != draw.pass || SortKeyShader(item.key) != draw.shader ||
+		    SortKeyTexture(item.key) != draw.texture || SortKeyMesh(item.key) != draw.mesh)
+		{
+			printf("  %s: key of draw %u gives %s %d %d %d, expected %s %d %d %d\n", name, item.draw,
+			       RenderPassName(SortKeyPass(item.key)), SortKeyShader(item.key), SortKeyTexture(item.key), SortKeyMesh(item.key),
+			       RenderPassName(draw.pass), draw.shader, draw.texture, draw.mesh);
+			return false;
+		}
+	}
+
+	// Passes in order, state groups in one run, opaque draws front to back and blended draws back to front. Depths are
+	// quantised in the keys, so depths compare equal within a small fraction
+	const float DEPTH_PRECISION = 1e-4f;
+	std::vector<uint64_t> finishedGroups;
+	for (size_t i = 1; i <= queue.Size(); ++i)
+	{
+		const BenchmarkDraw& previous = draws[queue[i - 1].draw];
+		bool groupEnds = (i == queue.Size());
+		if (!groupEnds)
+		{
+			const BenchmarkDraw& draw = draws[queue[i].draw];
+			if (draw.pass < previous.pass)
+			{
+				printf("  %s: %s draw at position %d after a %s draw\n", name, RenderPassName(draw.pass), static_cast<int>(i),
+				       RenderPassName(previous.pass));
+				return false;
+			}
+
+			if (draw.pass == RenderPass::Blended && previous.pass == RenderPass::Blended)
+			{
+				if (draw.depth > previous.depth * (1 + DEPTH_PRECISION))
+				{
+					printf("  %s: blended draw at position %d is further away than the draw before\n", name, static_cast<int>(i));
+					return false;
+				}
+				continue;
+			}
+
+			groupEnds = (draw.pass != previous.pass || draw.shader != previous.shader ||
+			             draw.texture != previous.texture || draw.mesh != previous.mesh);
+			if (!groupEnds && draw.depth * (1 + DEPTH_PRECISION) < previous.depth)
+			{
+				printf("  %s: opaque draw at position %d is nearer than the draw before in its group\n", name, static_cast<int>(i));
+				return false;
+			}
+		}
+
+		// Blended draws are ordered by depth first, so their state groups may be split
+		if (groupEnds && previous.pass != RenderPass::Blended)
+		{
+			uint64_t group = (static_cast<uint64_t>(previous.pass)    << 48) | (static_cast<uint64_t>(previous.shader) << 32) |
+			                 (static_cast<uint64_t>(previous.texture) << 16) |  static_cast<uint64_t>(previous.mesh);
+			finishedGroups.push_back(group);
+		}
+	}
+	std::sort(finishedGroups.begin(), finishedGroups.end());
+	if (std::adjacent_find(finishedGroups.begin(), finishedGroups.end()) != finishedGroups.end())
+	{
+		printf("  %s: a state group is split over more than one run of draws\n", name);
+		return false;
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// State changes
+//--------------------------------------------------------------------------------------
+
+// Binds made by the passes of Scene.cpp walking a queue
+struct PassBinds
+{
+	int passStates = 0; // Blend, depth and rasterizer states, set together at the start of each pass
+	int shaders    = 0;
+	int textures   = 0;
+	int meshes     = 0; // Vertex and index buffers, bound by each model's render
+};
+
+// Counts the binds of the colour pass, and of the normals and depth pass which draws the opaque models with its own
+// shaders. The focused object pass only draws one model whatever the order so is not counted
+static PassBinds CountBinds(const RenderQueue& queue, const std::vector<BenchmarkDraw>& draws)
+{
+	PassBinds binds;
+	for (size_t i = 0; i < queue.Size(); ++i)
+	{
+		if (i == 0 || SortKeyPass(queue[i].key) != SortKeyPass(queue[i - 1].key))  ++binds.passStates;
+	}
+	binds.shaders  = queue.StateChanges(SortKeyShader);
+	binds.textures = queue.StateChanges(SortKeyTexture);
+	binds.meshes   = queue.StateChanges(SortKeyMesh);
+
+	const BenchmarkDraw* previous = nullptr;
+	for (auto& item : queue)
+	{
+		const BenchmarkDraw& draw = draws[item.draw];
+		if (draw.pass != RenderPass::Opaque)  continue;
+		if (previous == nullptr || draw.mesh != previous->mesh)  ++binds.meshes;
+		previous = &draw;
+	}
+	if (previous != nullptr)  ++binds.passStates; // States and shaders of the normals and depth pass
+	if (previous != nullptr)  ++binds.shaders;
+	return binds;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Timing
+//--------------------------------------------------------------------------------------
+
+// Fastest of the repetitions in milliseconds of sorting a copy of the items with the given function
+template <typename Sort>
+static double TimeSort(const std::vector<RenderQueueItem>& items, int repetitions, Sort sort)
+{
+	std::vector<RenderQueueItem> copy;
+	int64_t fastest = 0;
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+	{
+		copy = items;
+		int64_t start = ClockNanoseconds();
+		sort(copy);
+		int64_t time = ClockNanoseconds() - start;
+		if (repetition == 0 || time < fastest)  fastest = time;
+	}
+	return NanosecondsToSeconds(fastest) * 1000.0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Main
+//--------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)  end = list.size();
+		if (end > start)  items.push_back(list.substr(start, end - start));
+		start = end + 1;
+	}
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<int> objectCounts = { 10, 100, 1000, 10000, 100000 };
+	SceneSettings settings;
+	uint64_t seed = 1;
+	int repetitions = 5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--objects")
+		{
+			objectCounts.clear();
+			for (auto& count : SplitList(value))  objectCounts.push_back(std::max(1, atoi(count.c_str())));
+		}
+		else if (option == "--meshes")       settings.numMeshes   = std::max(1, atoi(value.c_str()));
+		else if (option == "--textures")     settings.numTextures = std::max(1, atoi(value.c_str()));
+		else if (option == "--shaders")      settings.numShaders  = std::max(1, atoi(value.c_str()));
+		else if (option == "--seed")         seed = strtoull(value.c_str(), nullptr, 10);
+		else if (option == "--repetitions")  repetitions = std::max(1, atoi(value.c_str()));
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	// The sky and lights take the ids above the objects'
+	if (settings.numMeshes + 2 > (1 << SORT_KEY_MESH_BITS) || settings.numTextures + 2 > (1 << SORT_KEY_TEXTURE_BITS) ||
+	    settings.numShaders + 1 > (1 << SORT_KEY_SHADER_BITS))
+	{
+		printf("Too many meshes, textures or shaders for the sort key, at most %d, %d and %d\n",
+		       (1 << SORT_KEY_MESH_BITS) - 2, (1 << SORT_KEY_TEXTURE_BITS) - 2, (1 << SORT_KEY_SHADER_BITS) - 1);
+		return 1;
+	}
+
+	RandomGenerator random(seed);
+	bool passed = true;
+
+	printf("Scenes of opaque objects using %d meshes, %d textures and %d shaders, plus a sky and %d lights\n\n",
+	       settings.numMeshes, settings.numTextures, settings.numShaders, NUM_SCENE_LIGHTS);
+	printf("%8s | %-6s | %21s | %21s | %21s | %21s | %9s %9s %9s\n", "Objects", "Check",
+	       "Pass states (added)", "Shaders (added)", "Textures (added)", "Meshes (added)", "Radix ms", "sort ms", "stable ms");
+
+	for (int numObjects : objectCounts)
+	{
+		std::vector<BenchmarkDraw> draws = MakeScene(numObjects, settings, random);
+
+		// Sort from the order the draws were added, then move the scene a little and sort again from that order, as the
+		// app re-sorts each frame from the last frame's draws
+		RenderQueue unsorted, queue;
+		FillQueue(unsorted, draws);
+		FillQueue(queue, draws);
+		queue.Sort();
+		bool ok = CheckSortedQueue(queue, draws, "First frame");
+
+		std::vector<BenchmarkDraw> moved;
+		for (auto& item : queue)  moved.push_back(draws[item.draw]);
+		for (auto& draw : moved)  draw.depth = std::max(0.0f, draw.depth + random.Range(-1.0f, 1.0f));
+		RenderQueue nextFrame;
+		FillQueue(nextFrame, moved);
+		nextFrame.Sort();
+		ok = CheckSortedQueue(nextFrame, moved, "Next frame") && ok;
+
+		// Many draws with the same key, which must stay in the order they were added
+		std::vector<BenchmarkDraw> equal = draws;
+		for (auto& draw : equal)
+		{
+			if (draw.pass != RenderPass::Opaque)  continue;
+			draw.shader  %= 2;
+			draw.texture %= 2;
+			draw.mesh    %= 2;
+			draw.depth = 0.0f;
+		}
+		RenderQueue equalKeys;
+		FillQueue(equalKeys, equal);
+		equalKeys.Sort();
+		ok = CheckSortedQueue(equalKeys, equal, "Equal keys") && ok;
+		passed = passed && ok;
+
+		PassBinds added  = CountBinds(unsorted, draws);
+		PassBinds sorted = CountBinds(queue, draws);
+
+		std::vector<RenderQueueItem> items(unsorted.begin(), unsorted.end());
+		std::vector<RenderQueueItem> scratch(items.size()); // Kept from frame to frame by the queue, so not timed
+		double radixTime = TimeSort(items, repetitions, [&scratch](std::vector<RenderQueueItem>& sortItems)
+		{
+			RadixSortItems(sortItems.data(), scratch.data(), sortItems.size());
+		});
+		double sortTime = TimeSort(items, repetitions, [](std::vector<RenderQueueItem>& sortItems)
+		{
+			std::sort(sortItems.begin(), sortItems.end(), [](const RenderQueueItem& a, const RenderQueueItem& b) { return a.key < b.key; });
+		});
+		double stableTime = TimeSort(items, repetitions, [](std::vector<RenderQueueItem>& sortItems)
+		{
+			std::stable_sort(sortItems.begin(), sortItems.end(), [](const RenderQueueItem& a, const RenderQueueItem& b) { return a.key < b.key; });
+		});
+
+		printf("%8d | %-6s | %9d (%9d) | %9d (%9d) | %9d (%9d) | %9d (%9d) | %9.3f %9.3f %9.3f\n", numObjects,
+		       ok ? "ok" : "FAILED", sorted.passStates, added.passStates, sorted.shaders, added.shaders,
+		       sorted.textures, added.textures, sorted.meshes, added.meshes, radixTime, sortTime, stableTime);
+	}
+
+	printf("\nBinds are for the colour and normals and depth passes walking the sorted queue, then in brackets the queue in\n"
+	       "the order the draws were added. Sort times are the fastest of %d sorts of the draws in the order added\n", repetitions);
+	printf("\n%s\n", passed ? "All checks passed" : "Some checks FAILED");
+	return passed ? 0 : 1;
+}
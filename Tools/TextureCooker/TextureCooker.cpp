@@ -0,0 +1,259 @@
+//--------------------------------------------------------------------------------------
+// Texture cooker - decodes textures and writes them as block compressed DDS files with
+// a full set of mip-maps, into the cache the app loads from
+//--------------------------------------------------------------------------------------
+// Usage: TextureCooker [--format bc1|bc3|bc4|bc5|bc7] [--linear] [--srgb] [files...]
+// Each file is cooked to the name the app looks for (CookedTextureFileName, e.g. TextureCache/Stars.jpg.<hash>.dds),
+// so the app uploads the cooked file instead of decoding the source. The format defaults to BC7. Pass --linear for data
+// textures (noise, distortion offsets etc.) so their mip-maps are not filtered as sRGB colours, and --srgb to write the
+// sRGB version of the format (see TextureCookSettings).
+//
+// With no files the scene's JPG and PNG textures are cooked, each with the settings that suit how the app uses it. Run
+// it from the folder holding them. The scene's DDS textures are left as they are.
+//
+// The compression quality of each texture is printed as the peak signal-to-noise ratio of its top mip-map (higher is
+// better, over 40dB is hard to tell from the source).
+//
+// Decoding uses the Windows Imaging Component, so the tool only cooks on Windows. The cooking itself is in
+// Utility/CookedTexture.cpp and Utility/BlockCompression.cpp, which build anywhere
+
+#include "CookedTexture.h"
+#include "BlockCompression.h"
+#include "AssetLoader.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <wincodec.h>
+#include <atlbase.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+// How the scene uses each of its textures (see StartLoadingAssets in Scene.cpp)
+struct SceneTexture
+{
+	const char*   fileName;
+	TextureFormat format;
+	bool          linear;
+};
+static const SceneTexture SCENE_TEXTURES[] =
+{
+	// Colour textures, no alpha
+	{ "Stars.jpg",    TextureFormat::BC1, false },
+	{ "Flare.jpg",    TextureFormat::BC1, false },
+	{ "brick_35.jpg", TextureFormat::BC1, false },
+	{ "Saturn.jpg",   TextureFormat::BC1, false },
+
+	// Post-processing data. The noise and burn shaders only read red, the distort shader reads an RGB offset
+	{ "Noise.png",    TextureFormat::BC4, true },
+	{ "Noise2.png",   TextureFormat::BC4, true },
+	{ "Burn.png",     TextureFormat::BC4, true },
+	{ "Distort.png",  TextureFormat::BC7, true },
+};
+
+
+//--------------------------------------------------------------------------------------
+// Decoding
+//--------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+// Decode an image file to 8-bit RGBA texels with the Windows Imaging Component. Returns false on failure
+static bool DecodeImage(const std::string& fileName, const std::vector<uint8_t>& fileData, TextureImage& image)
+{
+	CComPtr<IWICImagingFactory> factory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))  return false;
+
+	CComPtr<IWICStream> stream;
+	CComPtr<IWICBitmapDecoder> decoder;
+	CComPtr<IWICBitmapFrameDecode> frame;
+	CComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateStream(&stream)) ||
+	    FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(fileData.data()), static_cast<DWORD>(fileData.size()))) ||
+	    FAILED(factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder)) ||
+	    FAILED(decoder->GetFrame(0, &frame)) ||
+	    FAILED(factory->CreateFormatConverter(&converter)) ||
+	    FAILED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+	{
+		return false;
+	}
+
+	UINT width, height;
+	if (FAILED(converter->GetSize(&width, &height)))  return false;
+	image.width  = static_cast<int>(width);
+	image.height = static_cast<int>(height);
+	image.texels.resize(static_cast<size_t>(width) * height * 4);
+	return SUCCEEDED(converter->CopyPixels(nullptr, width * 4, static_cast<UINT>(image.texels.size()), image.texels.data()));
+}
+
+static void CreateFolder(const std::string& folder)
+{
+	CreateDirectoryA(folder.c_str(), nullptr);
+}
+
+#else
+
+static bool DecodeImage(const std::string& fileName, const std::vector<uint8_t>&, TextureImage&)
+{
+	printf("%s: decoding images needs the Windows Imaging Component\n", fileName.c_str());
+	return false;
+}
+
+static void CreateFolder(const std::string& folder)
+{
+	mkdir(folder.c_str(), 0755);
+}
+
+#endif
+
+
+//--------------------------------------------------------------------------------------
+// Cooking
+//--------------------------------------------------------------------------------------
+
+static const char* FormatName(TextureFormat format)
+{
+	switch (format)
+	{
+		case TextureFormat::BC1:  return "BC1";
+		case TextureFormat::BC3:  return "BC3";
+		case TextureFormat::BC4:  return "BC4";
+		case TextureFormat::BC5:  return "BC5";
+		default:                  return "BC7";
+	}
+}
+
+// Peak signal-to-noise ratio in dB between two images over the channels the format stores
+static double PSNR(const TextureImage& a, const TextureImage& b, TextureFormat format)
+{
+	const int numChannels = (format == TextureFormat::BC1) ? 3 : (format == TextureFormat::BC4) ? 1 :
+	                        (format == TextureFormat::BC5) ? 2 : 4;
+	double squaredError = 0;
+	for (size_t i = 0; i < a.texels.size(); i += 4)
+	{
+		for (int c = 0; c < numChannels; ++c)
+		{
+			double difference = static_cast<double>(a.texels[i + c]) - b.texels[i + c];
+			squaredError += difference * difference;
+		}
+	}
+	double meanSquaredError = squaredError / (a.texels.size() / 4 * numChannels);
+	return (meanSquaredError > 0) ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+}
+
+
+// Cook one texture file into the cache. Returns false on failure
+static bool CookTexture(const std::string& fileName, const TextureCookSettings& settings, ThreadPool& threads)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<uint8_t> fileData;
+	if (!ReadWholeFile(fileName, fileData))
+	{
+		printf("%s: cannot read file\n", fileName.c_str());
+		return false;
+	}
+
+	TextureImage image;
+	if (!DecodeImage(fileName, fileData, image))
+	{
+		printf("%s: cannot decode image\n", fileName.c_str());
+		return false;
+	}
+	if (image.width % 4 != 0 || image.height % 4 != 0)
+	{
+		printf("%s: %dx%d is not a multiple of 4 texels across, as block compressed textures must be\n",
+		       fileName.c_str(), image.width, image.height);
+		return false;
+	}
+
+	std::string cookedFileName = CookedTextureFileName(fileName, HashTextureSource(fileData.data(), fileData.size()));
+	CreateFolder(cookedFileName.substr(0, cookedFileName.find_last_of("/\\")));
+	if (!WriteCookedTexture(cookedFileName, image, settings, &threads))
+	{
+		printf("%s: cannot write %s\n", fileName.c_str(), cookedFileName.c_str());
+		return false;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Measure the quality of the top mip-map
+	std::vector<uint8_t> blocks;
+	TextureImage decompressed;
+	CompressImage(image, settings.format, blocks, &threads);
+	DecompressImage(blocks.data(), image.width, image.height, settings.format, decompressed);
+
+	int numMips = 1;
+	for (int size = std::max(image.width, image.height); size > 1; size /= 2)  ++numMips;
+	printf("%s -> %s: %dx%d, %d mips, %s%s%s, %.2fdB, %.0fms\n", fileName.c_str(), cookedFileName.c_str(),
+	       image.width, image.height, numMips, FormatName(settings.format), settings.srgb ? " sRGB" : "",
+	       settings.linear ? " linear" : "", PSNR(image, decompressed, settings.format), seconds * 1000);
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	TextureCookSettings settings;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			++i;
+			if      (strcmp(argv[i], "bc1") == 0)  settings.format = TextureFormat::BC1;
+			else if (strcmp(argv[i], "bc3") == 0)  settings.format = TextureFormat::BC3;
+			else if (strcmp(argv[i], "bc4") == 0)  settings.format = TextureFormat::BC4;
+			else if (strcmp(argv[i], "bc5") == 0)  settings.format = TextureFormat::BC5;
+			else if (strcmp(argv[i], "bc7") == 0)  settings.format = TextureFormat::BC7;
+			else
+			{
+				printf("Unknown format %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--linear") == 0)  settings.linear = true;
+		else if (strcmp(argv[i], "--srgb") == 0)    settings.srgb = true;
+		else                                        files.push_back(argv[i]);
+	}
+
+#ifdef _WIN32
+	if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+	{
+		printf("Cannot initialise COM\n");
+		return 1;
+	}
+#endif
+
+	ThreadPool threads;
+	bool cooked = true;
+	if (files.empty())
+	{
+		for (auto& texture : SCENE_TEXTURES)
+		{
+			TextureCookSettings sceneSettings;
+			sceneSettings.format = texture.format;
+			sceneSettings.linear = texture.linear;
+			cooked &= CookTexture(texture.fileName, sceneSettings, threads);
+		}
+	}
+	else
+	{
+		for (auto& fileName : files)  cooked &= CookTexture(fileName, settings, threads);
+	}
+
+#ifdef _WIN32
+	CoUninitialize();
+#endif
+	return cooked ? 0 : 1;
+}
@@ -0,0 +1,508 @@
+//--------------------------------------------------------------------------------------
+// Thread pool benchmark - times the work-stealing thread pool on a range of workloads
+// and thread counts, and checks every workload gives the same results on any number of threads
+//--------------------------------------------------------------------------------------
+// Usage: ThreadPoolBenchmark [options]
+//   --workloads list    From uniform, uneven, nested, image, graph and spawn (default all)
+//   --threads list      Thread counts to run with, "max" for all cores or "scaling" for 1, 2, 4... 64 (default scaling)
+//   --grains list       Grain sizes for the ParallelFor workloads (default 1,16,256)
+//   --scale n           Multiplies the amount of work in every workload, e.g. 0.1 for a quick run (default 1)
+//   --warmup n          Untimed runs before timing each case (default 1)
+//   --repetitions n     Timed runs of each case, the median is reported (default 5)
+//   --json file         Write the results as JSON
+// Lists are separated by commas. Returns 1 on error or if any workload gives a different result from the first run.
+//
+// Workloads:
+//   uniform  ParallelFor over items that all take the same time
+//   uneven   ParallelFor over items that take from nothing up to twice the uniform time, the slowest at the end, so
+//            threads only stay busy by stealing
+//   nested   ParallelFor where every item runs a smaller ParallelFor, as effect kernels called from tasks do
+//   image    Horizontal then vertical box blur of a 1080p single channel image by rows and columns, like the CPU
+//            post-processes. Limited by memory bandwidth rather than maths at high thread counts
+//   graph    Layers of tasks where each task depends on two tasks of the layer before (continuations only, no waiting)
+//   spawn    A binary tree of tiny tasks where each task submits one child and waits for it, to time task overhead
+// Speed-up and efficiency are relative to the first thread count. Utilisation is the average fraction of the timed runs
+// the pool's threads spent running work, and steals are tasks taken from another thread's queue per run. Thread counts
+// above the number of cores are run too but can't give more speed.
+//
+// Only needs the Utility folder, so it also builds on Linux, e.g.
+// g++ -std=c++14 -O2 -pthread -IUtility Tools/ThreadPoolBenchmark/ThreadPoolBenchmark.cpp Utility/ThreadPool.cpp
+//     Utility/Clock.cpp
+
+#include "ThreadPool.h"
+#include "Clock.h"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cctype>
+
+
+//--------------------------------------------------------------------------------------
+// Work
+//--------------------------------------------------------------------------------------
+
+// A fixed amount of integer work that can't be optimised away. Each iteration takes a few nanoseconds
+static uint32_t Work(uint32_t value, int iterations)
+{
+	for (int i = 0; i < iterations; ++i)
+	{
+		value ^= value << 13;
+		value ^= value >> 17;
+		value ^= value << 5;
+		value *= 0x9E3779B1u;
+	}
+	return value;
+}
+
+// Combine results in a way that doesn't depend on the order they were produced in
+static uint64_t Checksum(const std::vector<uint32_t>& values)
+{
+	uint64_t sum = 0;
+	for (uint32_t value : values)  sum += value;
+	return sum;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Workloads
+//--------------------------------------------------------------------------------------
+
+// A workload prepared at a given scale, Run can be called repeatedly and returns a checksum of the results
+struct Workload
+{
+	std::string name;
+	bool        usesGrain; // Run once for each grain size
+	int64_t     items;     // Work items in a run, for the throughput
+	std::function<uint64_t(ThreadPool&, int grain)> run;
+};
+
+
+static Workload UniformWorkload(double scale)
+{
+	const int count = std::max(1, static_cast<int>(65536 * scale));
+	const int iterations = 200;
+	auto values = std::make_shared<std::vector<uint32_t>>(count);
+	return { "uniform", true, count, [=](ThreadPool& pool, int grain)
+	{
+		std::vector<uint32_t>& out = *values;
+		pool.ParallelFor(count, grain, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)  out[i] = Work(i + 1, iterations);
+		});
+		return Checksum(out);
+	}};
+}
+
+static Workload UnevenWorkload(double scale)
+{
+	const int count = std::max(1, static_cast<int>(65536 * scale));
+	const int maxIterations = 400;
+	auto values = std::make_shared<std::vector<uint32_t>>(count);
+	return { "uneven", true, count, [=](ThreadPool& pool, int grain)
+	{
+		std::vector<uint32_t>& out = *values;
+		pool.ParallelFor(count, grain, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; ++i)  out[i] = Work(i + 1, static_cast<int>(static_cast<int64_t>(maxIterations) * i / count));
+		});
+		return Checksum(out);
+	}};
+}
+
+static Workload NestedWorkload(double scale)
+{
+	const int outer = 64;
+	const int inner = std::max(1, static_cast<int>(1024 * scale));
+	const int iterations = 200;
+	auto values = std::make_shared<std::vector<uint32_t>>(outer * inner);
+	return { "nested", true, static_cast<int64_t>(outer) * inner, [=](ThreadPool& pool, int grain)
+	{
+		std::vector<uint32_t>& out = *values;
+		pool.ParallelFor(outer, 1, [&](int outerBegin, int outerEnd)
+		{
+			for (int o = outerBegin; o < outerEnd; ++o)
+			{
+				pool.ParallelFor(inner, grain, [&](int begin, int end)
+				{
+					for (int i = begin; i < end; ++i)  out[o * inner + i] = Work(o * inner + i + 1, iterations);
+				});
+			}
+		});
+		return Checksum(out);
+	}};
+}
+
+static Workload ImageWorkload(double scale)
+{
+	const int width = 1920;
+	const int height = std::max(1, static_cast<int>(1080 * scale));
+	const int radius = 8;
+	auto image = std::make_shared<std::vector<float>>(width * height);
+	auto temp = std::make_shared<std::vector<float>>(width * height);
+	for (int i = 0; i < width * height; ++i)  (*image)[i] = static_cast<float>(Work(i + 1, 4) & 0xffff) / 65535.0f;
+
+	// Grain is in rows for the horizontal pass and columns for the vertical one
+	return { "image", true, static_cast<int64_t>(width) * height, [=](ThreadPool& pool, int grain)
+	{
+		const std::vector<float>& in = *image;
+		std::vector<float>& mid = *temp;
+		std::vector<uint32_t> columnSums(width);
+		pool.ParallelFor(height, grain, [&](int begin, int end)
+		{
+			for (int y = begin; y < end; ++y)
+			{
+				const float* row = &in[y * width];
+				for (int x = 0; x < width; ++x)
+				{
+					float sum = 0;
+					for (int i = std::max(0, x - radius); i <= std::min(width - 1, x + radius); ++i)  sum += row[i];
+					mid[y * width + x] = sum / (2 * radius + 1);
+				}
+			}
+		});
+		pool.ParallelFor(width, grain, [&](int begin, int end)
+		{
+			for (int x = begin; x < end; ++x)
+			{
+				uint32_t columnSum = 0;
+				for (int y = 0; y < height; ++y)
+				{
+					float sum = 0;
+					for (int i = std::max(0, y - radius); i <= std::min(height - 1, y + radius); ++i)  sum += mid[i * width + x];
+					columnSum += static_cast<uint32_t>(sum / (2 * radius + 1) * 1024.0f);
+				}
+				columnSums[x] = columnSum;
+			}
+		});
+		return Checksum(columnSums);
+	}};
+}
+
+static Workload GraphWorkload(double scale)
+{
+	const int width = 256;
+	const int depth = std::max(1, static_cast<int>(32 * scale));
+	const int iterations = 2000;
+	return { "graph", false, static_cast<int64_t>(width) * depth, [=](ThreadPool& pool, int)
+	{
+		// Each task reads the results of the two tasks it depends on, so a task running too early gives a wrong checksum
+		std::vector<uint32_t> values(static_cast<size_t>(width) * depth);
+		std::vector<TaskHandle> previous, current;
+		for (int layer = 0; layer < depth; ++layer)
+		{
+			current.clear();
+			for (int i = 0; i < width; ++i)
+			{
+				uint32_t* out = &values[layer * width + i];
+				if (layer == 0)
+				{
+					current.push_back(pool.Submit([=] { *out = Work(i + 1, iterations); }));
+				}
+				else
+				{
+					const uint32_t* a = &values[(layer - 1) * width + i];
+					const uint32_t* b = &values[(layer - 1) * width + (i + 1) % width];
+					current.push_back(pool.Submit([=] { *out = Work(*a ^ (*b >> 1), iterations); },
+					                              { previous[i], previous[(i + 1) % width] }));
+				}
+			}
+			previous.swap(current);
+		}
+		for (auto& task : previous)  pool.Wait(task);
+		return Checksum(values);
+	}};
+}
+
+// Submit one child, do the other half here, then wait for the child
+static uint64_t SpawnTree(ThreadPool& pool, int depth, uint32_t seed)
+{
+	if (depth == 0)  return Work(seed, 20);
+
+	uint64_t childResult = 0;
+	TaskHandle child = pool.Submit([&pool, &childResult, depth, seed] { childResult = SpawnTree(pool, depth - 1, seed * 2); });
+	uint64_t result = SpawnTree(pool, depth - 1, seed * 2 + 1);
+	pool.Wait(child);
+	return result + childResult;
+}
+
+static Workload SpawnWorkload(double scale)
+{
+	int depth = 1;
+	while ((int64_t(1) << (depth + 1)) <= static_cast<int64_t>(65536 * scale))  ++depth;
+	return { "spawn", false, int64_t(1) << depth, [=](ThreadPool& pool, int)
+	{
+		return SpawnTree(pool, depth, 1);
+	}};
+}
+
+
+//--------------------------------------------------------------------------------------
+// Timing
+//--------------------------------------------------------------------------------------
+
+struct BenchmarkResult
+{
+	std::string workload;
+	int    grain; // 0 if the workload doesn't use one
+	int    threads;
+	int    repetitions;
+	double medianMs, minMs, maxMs;
+	double itemsPerSecond;
+	double utilisation;   // Average over the pool's threads
+	double stealsPerRun;
+	uint64_t checksum;
+
+	std::string Name() const { return grain > 0 ? workload + ", grain " + std::to_string(grain) : workload; }
+};
+
+static BenchmarkResult RunCase(const Workload& workload, int grain, ThreadPool& pool, int warmup, int repetitions)
+{
+	BenchmarkResult result;
+	result.workload = workload.name;
+	result.grain = workload.usesGrain ? grain : 0;
+	result.threads = static_cast<int>(pool.NumThreads());
+	result.repetitions = repetitions;
+
+	for (int i = 0; i < warmup; ++i)  workload.run(pool, grain);
+
+	std::vector<double> times;
+	pool.ResetStats();
+	for (int i = 0; i < repetitions; ++i)
+	{
+		int64_t start = ClockNanoseconds();
+		result.checksum = workload.run(pool, grain);
+		times.push_back(NanosecondsToSeconds(ClockNanoseconds() - start) * 1000.0);
+	}
+
+	// Main thread and workers, not the entry for threads outside the pool
+	std::vector<ThreadPoolThreadStats> stats = pool.ThreadStats();
+	double utilisation = 0;
+	uint64_t steals = 0;
+	for (size_t i = 0; i + 1 < stats.size(); ++i)
+	{
+		utilisation += stats[i].utilisation;
+		steals += stats[i].tasksStolen;
+	}
+	result.utilisation = utilisation / (stats.size() - 1);
+	result.stealsPerRun = static_cast<double>(steals) / repetitions;
+
+	std::sort(times.begin(), times.end());
+	result.medianMs = times[times.size() / 2];
+	result.minMs = times.front();
+	result.maxMs = times.back();
+	result.itemsPerSecond = workload.items / (result.medianMs / 1000.0);
+	return result;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Results
+//--------------------------------------------------------------------------------------
+
+// Write the results as JSON, one result to a line. Returns false if the file can't be written
+static bool WriteJSON(const std::string& fileName, const std::vector<BenchmarkResult>& results, int warmup, double scale)
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << "{\"hardwareThreads\":" << std::thread::hardware_concurrency() << ",\"warmup\":" << warmup << ",\"scale\":"
+	     << scale << ",\"results\":[\n";
+	char numbers[256];
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		snprintf(numbers, sizeof(numbers), "\"medianMs\":%.6f,\"minMs\":%.6f,\"maxMs\":%.6f,\"itemsPerSecond\":%.1f,"
+		         "\"utilisation\":%.4f,\"stealsPerRun\":%.1f", r.medianMs, r.minMs, r.maxMs, r.itemsPerSecond, r.utilisation,
+		         r.stealsPerRun);
+		file << "{\"workload\":\"" << r.workload << "\",\"grain\":" << r.grain << ",\"threads\":" << r.threads
+		     << ",\"repetitions\":" << r.repetitions << "," << numbers << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "]}\n";
+	return static_cast<bool>(file);
+}
+
+
+// Speed-up of each case at each thread count, relative to the first thread count
+static void ReportScaling(const std::vector<BenchmarkResult>& results, const std::vector<int>& threadCounts)
+{
+	printf("\nThread scaling (speed-up over %d thread%s)\n", threadCounts[0], threadCounts[0] == 1 ? "" : "s");
+	printf("%-24s", "Case");
+	for (int threads : threadCounts)  printf(" %7d", threads);
+	printf("\n");
+
+	for (const BenchmarkResult& first : results)
+	{
+		if (first.threads != threadCounts[0])  continue;
+		printf("%-24s", first.Name().c_str());
+		for (int threads : threadCounts)
+		{
+			auto found = std::find_if(results.begin(), results.end(), [&](const BenchmarkResult& r)
+			{
+				return r.threads == threads && r.workload == first.workload && r.grain == first.grain;
+			});
+			if (found != results.end())  printf(" %6.2fx", first.medianMs / found->medianMs);
+			else                         printf(" %7s", "-");
+		}
+		printf("\n");
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Options
+//--------------------------------------------------------------------------------------
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		std::transform(item.begin(), item.end(), item.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (!item.empty())  items.push_back(item);
+	}
+	return items;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const int cores = std::max(1u, std::thread::hardware_concurrency());
+	const int MAX_SCALING_THREADS = 64;
+
+	std::vector<std::string> workloadNames = { "uniform", "uneven", "nested", "image", "graph", "spawn" };
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads <= MAX_SCALING_THREADS; threads *= 2)  threadCounts.push_back(threads);
+	std::vector<int> grains = { 1, 16, 256 };
+	double scale = 1.0;
+	int warmup = 1;
+	int repetitions = 5;
+	std::string jsonFile;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (i + 1 >= argc)
+		{
+			printf("Missing value for %s\n", option.c_str());
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		if (option == "--workloads")  workloadNames = SplitList(value);
+		else if (option == "--threads")
+		{
+			threadCounts.clear();
+			for (auto& name : SplitList(value))
+			{
+				if (name == "max")  threadCounts.push_back(cores);
+				else if (name == "scaling")
+				{
+					for (int threads = 1; threads <= MAX_SCALING_THREADS; threads *= 2)  threadCounts.push_back(threads);
+				}
+				else  threadCounts.push_back(std::max(1, atoi(name.c_str())));
+			}
+		}
+		else if (option == "--grains")
+		{
+			grains.clear();
+			for (auto& name : SplitList(value))  grains.push_back(std::max(1, atoi(name.c_str())));
+		}
+		else if (option == "--scale")        scale = std::max(0.0001, atof(value.c_str()));
+		else if (option == "--warmup")       warmup = std::max(0, atoi(value.c_str()));
+		else if (option == "--repetitions")  repetitions = std::max(1, atoi(value.c_str()));
+		else if (option == "--json")         jsonFile = value;
+		else
+		{
+			printf("Unknown option %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<Workload> workloads;
+	for (auto& name : workloadNames)
+	{
+		if      (name == "uniform")  workloads.push_back(UniformWorkload(scale));
+		else if (name == "uneven")   workloads.push_back(UnevenWorkload(scale));
+		else if (name == "nested")   workloads.push_back(NestedWorkload(scale));
+		else if (name == "image")    workloads.push_back(ImageWorkload(scale));
+		else if (name == "graph")    workloads.push_back(GraphWorkload(scale));
+		else if (name == "spawn")    workloads.push_back(SpawnWorkload(scale));
+		else
+		{
+			printf("Unknown workload %s\n", name.c_str());
+			return 1;
+		}
+	}
+	if (workloads.empty() || threadCounts.empty() || grains.empty())
+	{
+		printf("Nothing to run\n");
+		return 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	int mismatches = 0;
+	for (int threads : threadCounts)
+	{
+		ThreadPool pool(threads);
+
+		printf("\n%d thread%s%s\n", threads, threads == 1 ? "" : "s", threads > cores ? " (more than the cores available)" : "");
+		printf("%-24s %10s %10s %10s %8s %8s %8s %10s\n", "Case", "Median ms", "Min ms", "Mitems/s", "Speed-up", "Effic %",
+		       "Use %", "Steals");
+		for (const Workload& workload : workloads)
+		{
+			for (int grain : grains)
+			{
+				BenchmarkResult result = RunCase(workload, grain, pool, warmup, repetitions);
+
+				// Compare with the same case on the first thread count
+				auto first = std::find_if(results.begin(), results.end(), [&](const BenchmarkResult& r)
+				{
+					return r.workload == result.workload && r.grain == result.grain;
+				});
+				double speedUp = (first != results.end()) ? first->medianMs / result.medianMs : 1.0;
+				int baseThreads = (first != results.end()) ? first->threads : threads;
+				const char* check = "";
+				if (first != results.end() && first->checksum != result.checksum)
+				{
+					check = "  WRONG RESULT";
+					++mismatches;
+				}
+
+				printf("%-24s %10.3f %10.3f %10.2f %7.2fx %8.1f %8.1f %10.0f%s\n", result.Name().c_str(), result.medianMs,
+				       result.minMs, result.itemsPerSecond / 1e6, speedUp, speedUp * baseThreads / threads * 100.0,
+				       result.utilisation * 100.0, result.stealsPerRun, check);
+				fflush(stdout);
+				results.push_back(result);
+
+				if (!workload.usesGrain)  break;
+			}
+		}
+	}
+
+	if (threadCounts.size() > 1)  ReportScaling(results, threadCounts);
+
+	if (!jsonFile.empty() && !WriteJSON(jsonFile, results, warmup, scale))
+	{
+		printf("Cannot write %s\n", jsonFile.c_str());
+		return 1;
+	}
+
+	if (mismatches > 0)
+	{
+		printf("\n%d case%s gave a different result from the first thread count\n", mismatches, mismatches == 1 ? "" : "s");
+		return 1;
+	}
+	return 0;
+}
@@ -14,6 +14,22 @@ Texture2D SceneTexture : register(t0);
 SamplerState PointSample : register(s0); // We don't usually want to filter (bilinear, trilinear etc.) the scene texture when
 										  // post-processing so this sampler will use "point sampling" - no filtering
 
+//--------------------------------------------------------------------------------------
+// Settings
+//--------------------------------------------------------------------------------------
+
+// Sent from the C++ side when they change, must match UnderwaterBlock in PostProcessConstantBlocks.cpp
+cbuffer UnderwaterConstants : register(b2)
+{
+	float  gUnderwaterHue;
+	float2 gUnderwaterBrightness;
+	float  gWobbleStrength;
+
+	float  gWobbleTimer;
+	float3 paddingUnderwater;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Shader code
 //--------------------------------------------------------------------------------------
@@ -0,0 +1,236 @@
+//--------------------------------------------------------------------------------------
+// Asset loader - loads assets on a thread pool in the background
+//--------------------------------------------------------------------------------------
+
+#include "AssetLoader.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+
+// Error message of the asset whose stage is running on this thread
+static thread_local std::string* tAssetError = nullptr;
+
+
+// Constructor - pass the number of threads to load with, 0 for one per hardware core
+AssetLoader::AssetLoader(unsigned int numThreads /*= 0*/)
+	// The creating thread is one of the pool's threads but carries on with other work after Start, so add one more
+	: mThreads((numThreads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : numThreads) + 1)
+{
+}
+
+// Destructor - waits for any load stages still running
+AssetLoader::~AssetLoader()
+{
+	WaitForLoads();
+}
+
+
+// Add an asset with the given load and create stages. Returns the new asset's index
+int AssetLoader::Add(const std::string& name, Stage load, Stage create, const std::vector<int>& dependencies /*= {}*/)
+{
+	int index = static_cast<int>(mAssets.size());
+	if (mStarted)  return -1;
+
+	mAssets.emplace_back();
+	Asset& asset = mAssets.back();
+	asset.name   = name;
+	asset.load   = std::move(load);
+	asset.create = std::move(create);
+	for (int dependency : dependencies)
+	{
+		// Only earlier assets, so the loader can never wait on itself
+		if (dependency >= 0 && dependency < index)  asset.dependencies.push_back(dependency);
+	}
+	return index;
+}
+
+
+// Start the load stages in the background and return immediately
+void AssetLoader::Start()
+{
+	if (mStarted)  return;
+	mStarted = true;
+	mStartTime = std::chrono::steady_clock::now();
+
+	// A load task is only queued once the tasks of its dependencies have finished, so no pool thread is ever blocked
+	// waiting for another asset
+	for (int i = 0; i < static_cast<int>(mAssets.size()); ++i)
+	{
+		std::vector<TaskHandle> dependencies;
+		for (int dependency : mAssets[i].dependencies)  dependencies.push_back(mAssets[dependency].loadTask);
+		mAssets[i].loadTask = mThreads.Submit([this, i]() { LoadAsset(i); }, dependencies);
+	}
+}
+
+
+// Run the load stage of one asset after its dependencies, on a pool thread
+void AssetLoader::LoadAsset(int index)
+{
+	Asset& asset = mAssets[index];
+
+	// Dependencies have finished loading before this task was queued
+	bool dependencyFailed = false;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (int dependency : asset.dependencies)
+		{
+			if (mAssets[dependency].failed)  dependencyFailed = true;
+		}
+	}
+
+	asset.loadStart = Now();
+	bool failed = false;
+	if (dependencyFailed)
+	{
+		failed = true;
+		asset.error = "Cannot load " + asset.name + " as an asset it depends on failed";
+	}
+	else if (asset.load)
+	{
+		tAssetError = &asset.error;
+		failed = !asset.load();
+		tAssetError = nullptr;
+		if (failed && asset.error.empty())  asset.error = "Error loading " + asset.name;
+	}
+	asset.loadEnd = Now();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		asset.failed = failed;
+		asset.loaded = true;
+	}
+	mAssetLoaded.notify_all();
+}
+
+
+// Wait for each asset in turn and run its create stage. Returns false if any stage failed
+bool AssetLoader::Finish()
+{
+	Start();
+
+	for (auto& asset : mAssets)
+	{
+		double waitStart = Now();
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mAssetLoaded.wait(lock, [&] { return asset.loaded; });
+		}
+		asset.waited = Now() - waitStart;
+
+		if (asset.failed)
+		{
+			mLastError = asset.error;
+			WaitForLoads();
+			return false;
+		}
+
+		// Dependencies were added earlier so have already been created
+		if (asset.create)
+		{
+			double createStart = Now();
+			tAssetError = &asset.error;
+			bool created = asset.create();
+			tAssetError = nullptr;
+			asset.createTime = Now() - createStart;
+			if (!created)
+			{
+				mLastError = asset.error.empty() ? "Error creating " + asset.name : asset.error;
+				WaitForLoads();
+				return false;
+			}
+		}
+	}
+
+	return WaitForLoads();
+}
+
+
+// Wait for the load stages only, the create stages are not run. Returns false if any load stage failed
+bool AssetLoader::LoadOnly()
+{
+	Start();
+	return WaitForLoads();
+}
+
+
+// Wait for all the load stages to finish, then report the first failure
+bool AssetLoader::WaitForLoads()
+{
+	if (mStarted && mFinishTime == 0)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		for (auto& asset : mAssets)
+		{
+			mAssetLoaded.wait(lock, [&] { return asset.loaded; });
+		}
+		mFinishTime = Now();
+	}
+
+	for (auto& asset : mAssets)
+	{
+		if (asset.failed)
+		{
+			if (mLastError.empty())  mLastError = asset.error;
+			return false;
+		}
+	}
+	return mLastError.empty();
+}
+
+
+// Set the error message for the asset whose stage is running on this thread
+void AssetLoader::SetError(const std::string& error)
+{
+	if (tAssetError != nullptr)  *tAssetError = error;
+}
+
+
+// Seconds since Start
+double AssetLoader::Now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStartTime).count();
+}
+
+
+// A table of the times for each asset in milliseconds
+std::string AssetLoader::Timings()
+{
+	size_t nameWidth = 5;
+	for (auto& asset : mAssets)  nameWidth = std::max(nameWidth, asset.name.size());
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+	out << std::left << std::setw(nameWidth) << "Asset" << std::right
+	    << std::setw(10) << "Start" << std::setw(10) << "Load" << std::setw(10) << "Waited" << std::setw(10) << "Create" << "\n";
+
+	double totalLoad = 0, totalCreate = 0;
+	for (auto& asset : mAssets)
+	{
+		out << std::left << std::setw(nameWidth) << asset.name << std::right
+		    << std::setw(10) << asset.loadStart * 1000 << std::setw(10) << (asset.loadEnd - asset.loadStart) * 1000
+		    << std::setw(10) << asset.waited * 1000 << std::setw(10) << asset.createTime * 1000 << "\n";
+		totalLoad   += asset.loadEnd - asset.loadStart;
+		totalCreate += asset.createTime;
+	}
+
+	out << mAssets.size() << " assets on " << NumThreads() << " threads: " << mFinishTime * 1000 << "ms total, "
+	    << totalLoad * 1000 << "ms loading, " << totalCreate * 1000 << "ms creating\n";
+	return out.str();
+}
+
+
+// Read a whole file into memory, for use in load stages. Returns false if the file cannot be read
+bool ReadWholeFile(const std::string& fileName, std::vector<uint8_t>& data)
+{
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file)  return false;
+
+	std::streamoff size = file.tellg();
+	if (size < 0)  return false;
+	data.resize(static_cast<size_t>(size));
+	file.seekg(0);
+	return size == 0 || static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), size));
+}
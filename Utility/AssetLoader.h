@@ -0,0 +1,128 @@
+//--------------------------------------------------------------------------------------
+// Asset loader - loads assets on a thread pool in the background
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each asset is loaded in two stages:
+// - The load stage reads, decodes and parses the asset's files. It runs as a task on the loader's thread pool so assets
+//   load side by side, and it can start before the Direct3D device exists. It must not use the device context
+// - The create stage turns the loaded data into GPU resources. It runs on the thread that calls Finish, once the asset's
+//   load stage and the create stages of its dependencies are done
+// An asset can depend on assets added before it. Its load task depends on theirs so is only queued once they finish, and
+// its create stage comes after theirs.
+// Create stages run in the order assets were added, each one as soon as its asset is loaded, so GPU work overlaps the
+// loading of later assets.
+//
+// Call LoadOnly instead of Finish to run just the load stages, e.g. to time loading without a device.
+// Times for each asset are kept, see Timings
+
+#ifndef _ASSET_LOADER_H_INCLUDED_
+#define _ASSET_LOADER_H_INCLUDED_
+
+#include "ThreadPool.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+
+class AssetLoader
+{
+public:
+	// Asset stages return false on failure, see SetError
+	using Stage = std::function<bool()>;
+
+	// Constructor - pass the number of threads to load with, 0 for one per hardware core
+	AssetLoader(unsigned int numThreads = 0);
+
+	// Destructor - waits for any load stages still running
+	~AssetLoader();
+
+	// Prevent copying, the loading thread refers back to this object
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+
+	// Add an asset with the given load and create stages, either can be empty. Dependencies are indexes returned by
+	// earlier calls. Returns the new asset's index. Assets cannot be added after Start
+	int Add(const std::string& name, Stage load, Stage create, const std::vector<int>& dependencies = {});
+
+	// Start the load stages in the background and return immediately
+	void Start();
+
+	// Wait for each asset in turn and run its create stage. Starts loading if Start hasn't been called.
+	// Returns false if any stage failed, see LastError
+	bool Finish();
+
+	// Wait for the load stages only, the create stages are not run. Returns false if any load stage failed
+	bool LoadOnly();
+
+	// Set the error message for the asset whose stage is running on this thread. Stages can call this before returning
+	// false to explain the failure, otherwise a general message is used
+	static void SetError(const std::string& error);
+
+
+	// Description of the first failure, in the order assets were added
+	const std::string& LastError() { return mLastError; }
+
+	// Number of threads the load stages run on
+	unsigned int NumThreads() { return mThreads.NumThreads() - 1; }
+
+	// A table of the times for each asset in milliseconds: load stage start and duration (from Start), time Finish
+	// waited for it, and create stage duration. Then the total time and the sum of the load stages, i.e. roughly the
+	// time loading would take on one thread
+	std::string Timings();
+
+
+private:
+	struct Asset
+	{
+		std::string      name;
+		Stage            load;
+		Stage            create;
+		std::vector<int> dependencies;
+
+		TaskHandle  loadTask;
+		bool        loaded = false; // Load stage finished (or skipped), protected by mMutex
+		bool        failed = false;
+		std::string error;
+
+		// Times in seconds from Start
+		double loadStart = 0, loadEnd = 0;
+		double waited = 0, createTime = 0;
+	};
+
+	// Run the load stage of one asset after its dependencies, on a pool thread
+	void LoadAsset(int index);
+
+	// Wait for all the load stages to finish, then report the first failure
+	bool WaitForLoads();
+
+	// Seconds since Start
+	double Now();
+
+
+	ThreadPool         mThreads; // The thread that creates the loader only runs create stages, see the constructor
+	std::vector<Asset> mAssets;
+	bool               mStarted = false;
+
+	std::mutex              mMutex;
+	std::condition_variable mAssetLoaded;
+
+	std::chrono::steady_clock::time_point mStartTime;
+	double mFinishTime = 0;
+
+	std::string mLastError;
+};
+
+
+// Read a whole file into memory, for use in load stages. Returns false if the file cannot be read
+bool ReadWholeFile(const std::string& fileName, std::vector<uint8_t>& data);
+
+
+#endif //_ASSET_LOADER_H_INCLUDED_
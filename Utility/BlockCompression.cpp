@@ -0,0 +1,550 @@
+//--------------------------------------------------------------------------------------
+// Block compression - encoders and decoders for the BC1, BC3, BC4, BC5 and BC7 texture formats
+//--------------------------------------------------------------------------------------
+
+#include "BlockCompression.h"
+
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+
+//--------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------
+
+static int Clamp(int value, int low, int high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+static float ClampTexel(float value)
+{
+	return value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value);
+}
+
+
+// The mean of C channels of the 16 texels and the main axis through them (unit length, or zero if the texels are all
+// the same), found by power iteration on their covariance
+template <int C>
+static void PrincipalAxis(const float values[16][C], float mean[C], float axis[C])
+{
+	for (int c = 0; c < C; ++c)
+	{
+		mean[c] = 0.0f;
+		for (int i = 0; i < 16; ++i)  mean[c] += values[i][c];
+		mean[c] *= 1.0f / 16.0f;
+	}
+
+	float covariance[C][C] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		float d[C];
+		for (int c = 0; c < C; ++c)  d[c] = values[i][c] - mean[c];
+		for (int r = 0; r < C; ++r)
+			for (int c = 0; c < C; ++c)
+				covariance[r][c] += d[r] * d[c];
+	}
+
+	// Start from the channel that varies most, which is rarely at right angles to the main axis
+	int start = 0;
+	for (int c = 1; c < C; ++c)  if (covariance[c][c] > covariance[start][start])  start = c;
+	for (int c = 0; c < C; ++c)  axis[c] = covariance[start][c];
+
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[C] = {};
+		float largest = 0.0f;
+		for (int r = 0; r < C; ++r)
+		{
+			for (int c = 0; c < C; ++c)  next[r] += covariance[r][c] * axis[c];
+			largest = std::fmax(largest, std::fabs(next[r]));
+		}
+		if (largest == 0.0f)
+		{
+			for (int c = 0; c < C; ++c)  axis[c] = 0.0f;
+			return;
+		}
+		for (int c = 0; c < C; ++c)  axis[c] = next[c] / largest;
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < C; ++c)  length += axis[c] * axis[c];
+	length = std::sqrt(length);
+	for (int c = 0; c < C; ++c)  axis[c] /= length;
+}
+
+
+// End points at either end of the texels' spread along their main axis, low then high
+template <int C>
+static void AxisEndPoints(const float values[16][C], float low[C], float high[C])
+{
+	float mean[C], axis[C];
+	PrincipalAxis<C>(values, mean, axis);
+
+	float tMin = 0.0f, tMax = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < C; ++c)  t += (values[i][c] - mean[c]) * axis[c];
+		tMin = std::fmin(tMin, t);
+		tMax = std::fmax(tMax, t);
+	}
+	for (int c = 0; c < C; ++c)
+	{
+		low[c]  = ClampTexel(mean[c] + tMin * axis[c]);
+		high[c] = ClampTexel(mean[c] + tMax * axis[c]);
+	}
+}
+
+
+// Least squares end points for texels already given weights along the line from e0 (weight 0) to e1 (weight 1)
+// Returns false if the weights don't pin down two end points, e.g. all the same
+template <int C>
+static bool LeastSquaresEndPoints(const float values[16][C], const float weights[16], float e0[C], float e1[C])
+{
+	float a = 0.0f, b = 0.0f, c2 = 0.0f;
+	float x0[C] = {}, x1[C] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		float w = weights[i], v = 1.0f - w;
+		a  += v * v;
+		b  += v * w;
+		c2 += w * w;
+		for (int c = 0; c < C; ++c)
+		{
+			x0[c] += v * values[i][c];
+			x1[c] += w * values[i][c];
+		}
+	}
+
+	float determinant = a * c2 - b * b;
+	if (std::fabs(determinant) < 1e-6f)  return false;
+	for (int c = 0; c < C; ++c)
+	{
+		e0[c] = ClampTexel((c2 * x0[c] - b * x1[c]) / determinant);
+		e1[c] = ClampTexel((a * x1[c] - b * x0[c]) / determinant);
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// BC1 colour blocks
+//--------------------------------------------------------------------------------------
+
+static uint16_t To565(const float colour[3])
+{
+	int r = Clamp(static_cast<int>(colour[0] * (31.0f / 255.0f) + 0.5f), 0, 31);
+	int g = Clamp(static_cast<int>(colour[1] * (63.0f / 255.0f) + 0.5f), 0, 63);
+	int b = Clamp(static_cast<int>(colour[2] * (31.0f / 255.0f) + 0.5f), 0, 31);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void From565(uint16_t value, int colour[3])
+{
+	int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+// The four colours of a block. With three colours (BC1 only, when c0 <= c1) the fourth is transparent black
+static void ColourPalette(uint16_t c0, uint16_t c1, bool fourColours, int palette[4][3])
+{
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		if (fourColours)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+}
+
+// Choose the nearest of the four colours for each texel, returns the total squared error
+static int ColourIndices(const float colours[16][3], uint16_t c0, uint16_t c1, int indices[16])
+{
+	int palette[4][3];
+	ColourPalette(c0, c1, true, palette);
+
+	int total = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int bestError = 0x7fffffff;
+		for (int p = 0; p < 4; ++p)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				int d = palette[p][c] - static_cast<int>(colours[i][c]);
+				error += d * d;
+			}
+			if (error < bestError)  { bestError = error;  indices[i] = p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+// Encode the colours of a block in four colour mode, as BC1 and BC3 use
+static void CompressColourBlock(const uint8_t texels[64], uint8_t* block)
+{
+	float colours[16][3];
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 3; ++c)
+			colours[i][c] = texels[i * 4 + c];
+
+	float low[3], high[3];
+	AxisEndPoints<3>(colours, low, high);
+	uint16_t c0 = To565(high), c1 = To565(low);
+	int indices[16];
+	int error = ColourIndices(colours, c0, c1, indices);
+
+	// Refine the end points from the chosen indices, keep them if they are better
+	static const float INDEX_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float weights[16];
+	for (int i = 0; i < 16; ++i)  weights[i] = INDEX_WEIGHTS[indices[i]];
+	float e0[3], e1[3];
+	if (LeastSquaresEndPoints<3>(colours, weights, e0, e1))
+	{
+		uint16_t r0 = To565(e0), r1 = To565(e1);
+		int refinedIndices[16];
+		int refinedError = ColourIndices(colours, r0, r1, refinedIndices);
+		if (refinedError < error)
+		{
+			c0 = r0;  c1 = r1;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// Four colour mode needs c0 > c1. Swapping the end points swaps indices 0 and 1, and 2 and 3. If they are equal the
+	// block is one colour, but the decoder would use three colour mode so every index must be 0
+	if (c0 < c1)
+	{
+		uint16_t swap = c0;  c0 = c1;  c1 = swap;
+		for (int i = 0; i < 16; ++i)  indices[i] ^= 1;
+	}
+	uint32_t packed = 0;
+	if (c0 != c1)
+	{
+		for (int i = 0; i < 16; ++i)  packed |= static_cast<uint32_t>(indices[i]) << (2 * i);
+	}
+
+	block[0] = static_cast<uint8_t>(c0);  block[1] = static_cast<uint8_t>(c0 >> 8);
+	block[2] = static_cast<uint8_t>(c1);  block[3] = static_cast<uint8_t>(c1 >> 8);
+	for (int b = 0; b < 4; ++b)  block[4 + b] = static_cast<uint8_t>(packed >> (8 * b));
+}
+
+static void DecompressColourBlock(const uint8_t* block, bool alwaysFourColours, uint8_t texels[64])
+{
+	uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+	uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+	uint32_t packed = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+	bool fourColours = alwaysFourColours || c0 > c1;
+
+	int palette[4][3];
+	ColourPalette(c0, c1, fourColours, palette);
+	for (int i = 0; i < 16; ++i)
+	{
+		int index = (packed >> (2 * i)) & 3;
+		for (int c = 0; c < 3; ++c)  texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+		texels[i * 4 + 3] = (!fourColours && index == 3) ? 0 : 255;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// BC4 single channel blocks
+//--------------------------------------------------------------------------------------
+
+// The eight values of a block with a0 > a1, or six values and 0 and 255 otherwise
+static void ChannelPalette(int a0, int a1, int palette[8])
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (int p = 2; p < 8; ++p)  palette[p] = ((8 - p) * a0 + (p - 1) * a1 + 3) / 7;
+	}
+	else
+	{
+		for (int p = 2; p < 6; ++p)  palette[p] = ((6 - p) * a0 + (p - 1) * a1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// Encode one channel of a block using the eight value mode with the channel's range as end points
+static void CompressChannelBlock(const uint8_t texels[64], int channel, uint8_t* block)
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int value = texels[i * 4 + channel];
+		if (value < low)   low = value;
+		if (value > high)  high = value;
+	}
+
+	int palette[8];
+	ChannelPalette(high, low, palette);
+
+	uint64_t packed = 0;
+	if (high != low) // Otherwise every index is 0
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			int value = texels[i * 4 + channel];
+			int best = 0, bestError = 256;
+			for (int p = 0; p < 8; ++p)
+			{
+				int error = std::abs(palette[p] - value);
+				if (error < bestError)  { bestError = error;  best = p; }
+			}
+			packed |= static_cast<uint64_t>(best) << (3 * i);
+		}
+	}
+
+	block[0] = static_cast<uint8_t>(high);
+	block[1] = static_cast<uint8_t>(low);
+	for (int b = 0; b < 6; ++b)  block[2 + b] = static_cast<uint8_t>(packed >> (8 * b));
+}
+
+static void DecompressChannelBlock(const uint8_t* block, int channel, uint8_t texels[64])
+{
+	int palette[8];
+	ChannelPalette(block[0], block[1], palette);
+
+	uint64_t packed = 0;
+	for (int b = 0; b < 6; ++b)  packed |= static_cast<uint64_t>(block[2 + b]) << (8 * b);
+	for (int i = 0; i < 16; ++i)  texels[i * 4 + channel] = static_cast<uint8_t>(palette[(packed >> (3 * i)) & 7]);
+}
+
+
+//--------------------------------------------------------------------------------------
+// BC7 mode 6 blocks
+//--------------------------------------------------------------------------------------
+
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// A mode 6 end point - 7 bits for each channel and a low bit shared by all four
+struct BC7EndPoint
+{
+	int values[4];
+	int pBit;
+	int Channel(int c) const { return (values[c] << 1) | pBit; }
+};
+
+// The nearest end point to the given RGBA values, trying both low bits
+static BC7EndPoint QuantiseBC7(const float colour[4])
+{
+	BC7EndPoint best = {};
+	float bestError = 1e30f;
+	for (int pBit = 0; pBit < 2; ++pBit)
+	{
+		BC7EndPoint endPoint;
+		endPoint.pBit = pBit;
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			endPoint.values[c] = Clamp(static_cast<int>((colour[c] - pBit) * 0.5f + 0.5f), 0, 127);
+			float d = endPoint.Channel(c) - colour[c];
+			error += d * d;
+		}
+		if (error < bestError)  { bestError = error;  best = endPoint; }
+	}
+	return best;
+}
+
+// Choose the nearest of the 16 steps between the end points for each texel, returns the total squared error
+static int BC7Indices(const float colours[16][4], const BC7EndPoint& e0, const BC7EndPoint& e1, int indices[16])
+{
+	int palette[16][4];
+	for (int p = 0; p < 16; ++p)
+		for (int c = 0; c < 4; ++c)
+			palette[p][c] = ((64 - BC7_WEIGHTS[p]) * e0.Channel(c) + BC7_WEIGHTS[p] * e1.Channel(c) + 32) >> 6;
+
+	int total = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int bestError = 0x7fffffff;
+		for (int p = 0; p < 16; ++p)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				int d = palette[p][c] - static_cast<int>(colours[i][c]);
+				error += d * d;
+			}
+			if (error < bestError)  { bestError = error;  indices[i] = p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+// Writes bits into a 128-bit block, lowest first
+struct BitWriter
+{
+	uint8_t* block;
+	int      position = 0;
+
+	void Write(uint32_t value, int bits)
+	{
+		for (int b = 0; b < bits; ++b, ++position)
+		{
+			if ((value >> b) & 1)  block[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+		}
+	}
+};
+
+struct BitReader
+{
+	const uint8_t* block;
+	int            position = 0;
+
+	uint32_t Read(int bits)
+	{
+		uint32_t value = 0;
+		for (int b = 0; b < bits; ++b, ++position)  value |= ((block[position >> 3] >> (position & 7)) & 1u) << b;
+		return value;
+	}
+};
+
+
+//--------------------------------------------------------------------------------------
+// Encoding
+//--------------------------------------------------------------------------------------
+
+void CompressBlockBC1(const uint8_t texels[64], uint8_t* block)
+{
+	CompressColourBlock(texels, block);
+}
+
+void CompressBlockBC3(const uint8_t texels[64], uint8_t* block)
+{
+	CompressChannelBlock(texels, 3, block);
+	CompressColourBlock(texels, block + 8);
+}
+
+void CompressBlockBC4(const uint8_t texels[64], uint8_t* block)
+{
+	CompressChannelBlock(texels, 0, block);
+}
+
+void CompressBlockBC5(const uint8_t texels[64], uint8_t* block)
+{
+	CompressChannelBlock(texels, 0, block);
+	CompressChannelBlock(texels, 1, block + 8);
+}
+
+void CompressBlockBC7(const uint8_t texels[64], uint8_t* block)
+{
+	float colours[16][4];
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)
+			colours[i][c] = texels[i * 4 + c];
+
+	float low[4], high[4];
+	AxisEndPoints<4>(colours, low, high);
+	BC7EndPoint e0 = QuantiseBC7(low), e1 = QuantiseBC7(high);
+	int indices[16];
+	int error = BC7Indices(colours, e0, e1, indices);
+
+	// Refine the end points from the chosen indices, keep them if they are better
+	float weights[16];
+	for (int i = 0; i < 16; ++i)  weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+	float r0[4], r1[4];
+	if (error > 0 && LeastSquaresEndPoints<4>(colours, weights, r0, r1))
+	{
+		BC7EndPoint refined0 = QuantiseBC7(r0), refined1 = QuantiseBC7(r1);
+		int refinedIndices[16];
+		int refinedError = BC7Indices(colours, refined0, refined1, refinedIndices);
+		if (refinedError < error)
+		{
+			e0 = refined0;  e1 = refined1;
+			memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// The first texel's index has an implied top bit of 0, swap the end points if it would be 1
+	if (indices[0] & 8)
+	{
+		BC7EndPoint swap = e0;  e0 = e1;  e1 = swap;
+		for (int i = 0; i < 16; ++i)  indices[i] = 15 - indices[i];
+	}
+
+	memset(block, 0, BC7_BLOCK_BYTES);
+	BitWriter writer = { block };
+	writer.Write(1 << 6, 7); // Mode 6
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.Write(e0.values[c], 7);
+		writer.Write(e1.values[c], 7);
+	}
+	writer.Write(e0.pBit, 1);
+	writer.Write(e1.pBit, 1);
+	writer.Write(indices[0], 3);
+	for (int i = 1; i < 16; ++i)  writer.Write(indices[i], 4);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Decoding
+//--------------------------------------------------------------------------------------
+
+void DecompressBlockBC1(const uint8_t* block, uint8_t texels[64])
+{
+	DecompressColourBlock(block, false, texels);
+}
+
+void DecompressBlockBC3(const uint8_t* block, uint8_t texels[64])
+{
+	DecompressColourBlock(block + 8, true, texels);
+	DecompressChannelBlock(block, 3, texels);
+}
+
+void DecompressBlockBC4(const uint8_t* block, uint8_t texels[64])
+{
+	memset(texels, 0, 64);
+	DecompressChannelBlock(block, 0, texels);
+	for (int i = 0; i < 16; ++i)  texels[i * 4 + 3] = 255;
+}
+
+void DecompressBlockBC5(const uint8_t* block, uint8_t texels[64])
+{
+	memset(texels, 0, 64);
+	DecompressChannelBlock(block, 0, texels);
+	DecompressChannelBlock(block + 8, 1, texels);
+	for (int i = 0; i < 16; ++i)  texels[i * 4 + 3] = 255;
+}
+
+void DecompressBlockBC7(const uint8_t* block, uint8_t texels[64])
+{
+	memset(texels, 0, 64);
+	if ((block[0] & 0x7f) != (1 << 6))  return; // Not mode 6
+
+	BitReader reader = { block };
+	reader.Read(7);
+	BC7EndPoint e0, e1;
+	for (int c = 0; c < 4; ++c)
+	{
+		e0.values[c] = reader.Read(7);
+		e1.values[c] = reader.Read(7);
+	}
+	e0.pBit = reader.Read(1);
+	e1.pBit = reader.Read(1);
+	for (int i = 0; i < 16; ++i)
+	{
+		int weight = BC7_WEIGHTS[reader.Read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; ++c)
+			texels[i * 4 + c] = static_cast<uint8_t>(((64 - weight) * e0.Channel(c) + weight * e1.Channel(c) + 32) >> 6);
+	}
+}
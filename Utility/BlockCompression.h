@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// Block compression - encoders and decoders for the BC1, BC3, BC4, BC5 and BC7 texture formats
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each function works on one 4x4 block of texels. Blocks are given as 16 RGBA texels of 8 bits per channel, in rows
+// from the top left. The GPU formats these produce are:
+//   BC1  8 bytes  RGB, 4 colours per block from two 5:6:5 end points. For opaque colour textures
+//   BC3 16 bytes  BC1 colour plus a BC4 block for alpha. For colour with alpha
+//   BC4  8 bytes  One channel (red), 8 values per block from two 8-bit end points. For masks and height maps
+//   BC5 16 bytes  Two BC4 blocks (red and green). For normal maps and other two-channel data
+//   BC7 16 bytes  RGBA. Encoded using mode 6 only - one line through RGBA space with 7-bit end points plus a shared
+//                 low bit each and 16 steps along it. A good general purpose choice, though other modes would do better
+//                 on blocks with several distinct colours
+// End points are found along the main axis of each block's texels, then refined by least squares where that helps.
+// Decoders are included to measure the quality of the encoding
+
+#ifndef _BLOCK_COMPRESSION_H_INCLUDED_
+#define _BLOCK_COMPRESSION_H_INCLUDED_
+
+#include <cstdint>
+
+
+// Size in bytes of one compressed block
+const int BC1_BLOCK_BYTES = 8;
+const int BC3_BLOCK_BYTES = 16;
+const int BC4_BLOCK_BYTES = 8;
+const int BC5_BLOCK_BYTES = 16;
+const int BC7_BLOCK_BYTES = 16;
+
+
+//--------------------------------------------------------------------------------------
+// Encoding - texels are 16 RGBA texels of 8 bits per channel
+//--------------------------------------------------------------------------------------
+
+void CompressBlockBC1(const uint8_t texels[64], uint8_t* block);
+void CompressBlockBC3(const uint8_t texels[64], uint8_t* block);
+void CompressBlockBC4(const uint8_t texels[64], uint8_t* block); // Red channel
+void CompressBlockBC5(const uint8_t texels[64], uint8_t* block); // Red and green channels
+void CompressBlockBC7(const uint8_t texels[64], uint8_t* block);
+
+
+//--------------------------------------------------------------------------------------
+// Decoding - fills in 16 RGBA texels. Missing channels are 0, and alpha is 255 where the format has none
+//--------------------------------------------------------------------------------------
+
+void DecompressBlockBC1(const uint8_t* block, uint8_t texels[64]);
+void DecompressBlockBC3(const uint8_t* block, uint8_t texels[64]);
+void DecompressBlockBC4(const uint8_t* block, uint8_t texels[64]);
+void DecompressBlockBC5(const uint8_t* block, uint8_t texels[64]);
+void DecompressBlockBC7(const uint8_t* block, uint8_t texels[64]); // Mode 6 blocks only, others decode as black
+
+
+#endif //_BLOCK_COMPRESSION_H_INCLUDED_
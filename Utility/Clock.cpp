@@ -0,0 +1,22 @@
+//--------------------------------------------------------------------------------------
+// Clock - portable high-resolution time stamps
+//--------------------------------------------------------------------------------------
+
+#include "Clock.h"
+
+#include <chrono>
+
+
+// Time stamps are measured from the first use of the clock, so it is ready even for code run before main
+static std::chrono::steady_clock::time_point ClockStart()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return start;
+}
+
+
+// Nanoseconds since the clock was first used
+int64_t ClockNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - ClockStart()).count();
+}
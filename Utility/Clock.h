@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------------------------
+// Clock - portable high-resolution time stamps
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Uses std::chrono::steady_clock, which is the performance counter on Windows and the monotonic clock on Linux, so code
+// timed with it also runs in headless builds on other systems. Time stamps only ever increase and are in nanoseconds
+// from the first time the clock is used, so differences can be taken without worrying about the counter frequency
+
+#ifndef _CLOCK_H_INCLUDED_
+#define _CLOCK_H_INCLUDED_
+
+#include <cstdint>
+
+
+// Nanoseconds since the clock was first used
+int64_t ClockNanoseconds();
+
+// Convert between nanoseconds and seconds
+inline double NanosecondsToSeconds(int64_t nanoseconds) { return static_cast<double>(nanoseconds) * 1e-9; }
+inline int64_t SecondsToNanoseconds(double seconds)     { return static_cast<int64_t>(seconds * 1e9); }
+
+
+#endif //_CLOCK_H_INCLUDED_
@@ -38,5 +38,46 @@ public:
         a = pfElts[3];
     }
 };
+
+
+/*-----------------------------------------------------------------------------------------
+    Non-member operators - component-wise, as used by the CPU post-processing code
+-----------------------------------------------------------------------------------------*/
+
+inline ColourRGBA operator+ (const ColourRGBA& c, const ColourRGBA& d)
+{
+	return { c.r + d.r, c.g + d.g, c.b + d.b, c.a + d.a };
+}
+
+inline ColourRGBA operator- (const ColourRGBA& c, const ColourRGBA& d)
+{
+	return { c.r - d.r, c.g - d.g, c.b - d.b, c.a - d.a };
+}
+
+inline ColourRGBA operator* (const ColourRGBA& c, const ColourRGBA& d)
+{
+	return { c.r * d.r, c.g * d.g, c.b * d.b, c.a * d.a };
+}
+
+inline ColourRGBA operator* (const ColourRGBA& c, float s)
+{
+	return { c.r * s, c.g * s, c.b * s, c.a * s };
+}
+
+inline ColourRGBA operator* (float s, const ColourRGBA& c)
+{
+	return { c.r * s, c.g * s, c.b * s, c.a * s };
+}
+
+inline ColourRGBA operator/ (const ColourRGBA& c, float s)
+{
+	return { c.r / s, c.g / s, c.b / s, c.a / s };
+}
+
+inline ColourRGBA& operator+= (ColourRGBA& c, const ColourRGBA& d)
+{
+	c.r += d.r;  c.g += d.g;  c.b += d.b;  c.a += d.a;
+	return c;
+}
 	
 #endif // _COLOURRGBA_H_DEFINED_
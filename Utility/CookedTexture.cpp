@@ -0,0 +1,391 @@
+//--------------------------------------------------------------------------------------
+// Cooked textures - mip generation, block compression and the cooked DDS cache
+//--------------------------------------------------------------------------------------
+
+#include "CookedTexture.h"
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+#include "Float4.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+
+//--------------------------------------------------------------------------------------
+// sRGB conversion
+//--------------------------------------------------------------------------------------
+
+static float SRGBToLinear(float c)
+{
+	return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// Tables to convert 8-bit sRGB values to linear and back, built on first use
+struct SRGBTables
+{
+	float toLinear[256];
+	float thresholds[255]; // Linear value halfway between each 8-bit sRGB value and the next
+
+	SRGBTables()
+	{
+		for (int i = 0; i < 256; ++i)  toLinear[i] = SRGBToLinear(i / 255.0f);
+		for (int i = 0; i < 255; ++i)  thresholds[i] = SRGBToLinear((i + 0.5f) / 255.0f);
+	}
+
+	// Nearest 8-bit sRGB value to a linear value - the same result as converting with pow, without calling it
+	uint8_t FromLinear(float linear) const
+	{
+		return static_cast<uint8_t>(std::upper_bound(thresholds, thresholds + 255, linear) - thresholds);
+	}
+};
+
+static const SRGBTables& GetSRGBTables()
+{
+	static const SRGBTables tables;
+	return tables;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Mip generation
+//--------------------------------------------------------------------------------------
+
+// Up to three source texels, and their weights, that make up one texel of the next mip-map along one axis
+struct MipTaps
+{
+	int   first;
+	int   count;
+	float weights[3];
+};
+
+// Work out the taps for each texel of a line halving in size. Even lines average pairs of texels. Odd lines use three
+// texels weighted by how much of each the larger target texel covers, so no source texel is dropped
+static std::vector<MipTaps> BuildMipTaps(int size)
+{
+	int targetSize = std::max(1, size / 2);
+	std::vector<MipTaps> taps(targetSize);
+	for (int i = 0; i < targetSize; ++i)
+	{
+		if (size == 1)
+		{
+			taps[i] = { 0, 1, { 1.0f, 0.0f, 0.0f } };
+		}
+		else if (size % 2 == 0)
+		{
+			taps[i] = { 2 * i, 2, { 0.5f, 0.5f, 0.0f } };
+		}
+		else
+		{
+			float n = static_cast<float>(targetSize);
+			float total = 2.0f * n + 1.0f;
+			taps[i] = { 2 * i, 3, { (n - i) / total, n / total, (i + 1) / total } };
+		}
+	}
+	return taps;
+}
+
+
+// Filter a mip-map of RGBA floats down to the next. Each target texel is a Float4 of the weighted source texels
+static void FilterMip(const std::vector<float>& source, int sourceWidth, int sourceHeight,
+                      std::vector<float>& target, int targetWidth, int targetHeight, ThreadPool* threads)
+{
+	std::vector<MipTaps> tapsX = BuildMipTaps(sourceWidth);
+	std::vector<MipTaps> tapsY = BuildMipTaps(sourceHeight);
+	target.resize(static_cast<size_t>(targetWidth) * targetHeight * 4);
+
+	auto filterRows = [&](int begin, int end)
+	{
+		for (int y = begin; y < end; ++y)
+		{
+			const MipTaps& tapY = tapsY[y];
+			float* targetRow = target.data() + static_cast<size_t>(y) * targetWidth * 4;
+			for (int x = 0; x < targetWidth; ++x)
+			{
+				const MipTaps& tapX = tapsX[x];
+				Float4 sum = Float4::Set(0.0f);
+				for (int j = 0; j < tapY.count; ++j)
+				{
+					const float* sourceRow = source.data() + static_cast<size_t>(tapY.first + j) * sourceWidth * 4;
+					Float4 rowSum = Float4::Set(0.0f);
+					for (int i = 0; i < tapX.count; ++i)
+					{
+						rowSum = rowSum + Float4::Load(sourceRow + (tapX.first + i) * 4) * Float4::Set(tapX.weights[i]);
+					}
+					sum = sum + rowSum * Float4::Set(tapY.weights[j]);
+				}
+				sum.Store(targetRow + x * 4);
+			}
+		}
+	};
+
+	if (threads != nullptr)  threads->ParallelFor(targetHeight, 16, filterRows);
+	else                     filterRows(0, targetHeight);
+}
+
+
+// Make the full chain of mip-maps for an image, down to 1x1. mips[0] is a copy of the image. Set linear for data
+// textures, otherwise the colour channels are filtered in linear light. Pass a thread pool to split the work
+void GenerateMips(const TextureImage& image, bool linear, std::vector<TextureImage>& mips, ThreadPool* threads /*= nullptr*/)
+{
+	mips.clear();
+	mips.push_back(image);
+	if (image.width <= 0 || image.height <= 0)  return;
+
+	const SRGBTables& srgb = GetSRGBTables();
+
+	// Filter in floats from one level to the next, so rounding to 8 bits doesn't build up down the chain
+	const size_t numTexels = static_cast<size_t>(image.width) * image.height;
+	std::vector<float> level(numTexels * 4);
+	for (size_t i = 0; i < numTexels * 4; ++i)
+	{
+		uint8_t value = image.texels[i];
+		level[i] = (linear || (i & 3) == 3) ? value / 255.0f : srgb.toLinear[value];
+	}
+
+	int width  = image.width;
+	int height = image.height;
+	std::vector<float> nextLevel;
+	while (width > 1 || height > 1)
+	{
+		int nextWidth  = std::max(1, width / 2);
+		int nextHeight = std::max(1, height / 2);
+		FilterMip(level, width, height, nextLevel, nextWidth, nextHeight, threads);
+		level.swap(nextLevel);
+		width  = nextWidth;
+		height = nextHeight;
+
+		mips.emplace_back();
+		TextureImage& mip = mips.back();
+		mip.width  = width;
+		mip.height = height;
+		mip.texels.resize(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < mip.texels.size(); ++i)
+		{
+			float value = std::min(std::max(level[i], 0.0f), 1.0f);
+			mip.texels[i] = (linear || (i & 3) == 3) ? static_cast<uint8_t>(value * 255.0f + 0.5f) : srgb.FromLinear(value);
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Block compression
+//--------------------------------------------------------------------------------------
+
+static int BlockBytes(TextureFormat format)
+{
+	switch (format)
+	{
+		case TextureFormat::BC1:  return BC1_BLOCK_BYTES;
+		case TextureFormat::BC3:  return BC3_BLOCK_BYTES;
+		case TextureFormat::BC4:  return BC4_BLOCK_BYTES;
+		case TextureFormat::BC5:  return BC5_BLOCK_BYTES;
+		default:                  return BC7_BLOCK_BYTES;
+	}
+}
+
+// Block compress an image into the given format. Images that aren't a multiple of 4 texels across are padded by
+// repeating the edge texels
+void CompressImage(const TextureImage& image, TextureFormat format, std::vector<uint8_t>& blocks, ThreadPool* threads /*= nullptr*/)
+{
+	const int blocksX = (image.width  + 3) / 4;
+	const int blocksY = (image.height + 3) / 4;
+	const int blockBytes = BlockBytes(format);
+	blocks.resize(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+	auto compressRows = [&](int begin, int end)
+	{
+		uint8_t texels[64];
+		for (int by = begin; by < end; ++by)
+		{
+			for (int bx = 0; bx < blocksX; ++bx)
+			{
+				for (int y = 0; y < 4; ++y)
+				{
+					int sourceY = std::min(by * 4 + y, image.height - 1);
+					for (int x = 0; x < 4; ++x)
+					{
+						int sourceX = std::min(bx * 4 + x, image.width - 1);
+						memcpy(texels + (y * 4 + x) * 4, image.texels.data() + (static_cast<size_t>(sourceY) * image.width + sourceX) * 4, 4);
+					}
+				}
+
+				uint8_t* block = blocks.data() + (static_cast<size_t>(by) * blocksX + bx) * blockBytes;
+				switch (format)
+				{
+					case TextureFormat::BC1:  CompressBlockBC1(texels, block);  break;
+					case TextureFormat::BC3:  CompressBlockBC3(texels, block);  break;
+					case TextureFormat::BC4:  CompressBlockBC4(texels, block);  break;
+					case TextureFormat::BC5:  CompressBlockBC5(texels, block);  break;
+					case TextureFormat::BC7:  CompressBlockBC7(texels, block);  break;
+				}
+			}
+		}
+	};
+
+	if (threads != nullptr)  threads->ParallelFor(blocksY, 1, compressRows);
+	else                     compressRows(0, blocksY);
+}
+
+
+// Decompress blocks back into an image, e.g. to measure the quality of the compression
+void DecompressImage(const uint8_t* blocks, int width, int height, TextureFormat format, TextureImage& image)
+{
+	image.width  = width;
+	image.height = height;
+	image.texels.resize(static_cast<size_t>(width) * height * 4);
+
+	const int blocksX = (width  + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const int blockBytes = BlockBytes(format);
+	uint8_t texels[64];
+	for (int by = 0; by < blocksY; ++by)
+	{
+		for (int bx = 0; bx < blocksX; ++bx)
+		{
+			const uint8_t* block = blocks + (static_cast<size_t>(by) * blocksX + bx) * blockBytes;
+			switch (format)
+			{
+				case TextureFormat::BC1:  DecompressBlockBC1(block, texels);  break;
+				case TextureFormat::BC3:  DecompressBlockBC3(block, texels);  break;
+				case TextureFormat::BC4:  DecompressBlockBC4(block, texels);  break;
+				case TextureFormat::BC5:  DecompressBlockBC5(block, texels);  break;
+				case TextureFormat::BC7:  DecompressBlockBC7(block, texels);  break;
+			}
+
+			// Padding texels beyond the edge of the image are dropped
+			for (int y = 0; y < 4 && by * 4 + y < height; ++y)
+			{
+				for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+				{
+					memcpy(image.texels.data() + (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// DDS files
+//--------------------------------------------------------------------------------------
+
+// DXGI_FORMAT values, so this file doesn't need the Direct3D headers
+static uint32_t DXGIFormat(TextureFormat format, bool srgb)
+{
+	switch (format)
+	{
+		case TextureFormat::BC1:  return srgb ? 72 : 71; // DXGI_FORMAT_BC1_UNORM(_SRGB)
+		case TextureFormat::BC3:  return srgb ? 78 : 77; // DXGI_FORMAT_BC3_UNORM(_SRGB)
+		case TextureFormat::BC4:  return 80;             // DXGI_FORMAT_BC4_UNORM
+		case TextureFormat::BC5:  return 83;             // DXGI_FORMAT_BC5_UNORM
+		default:                  return srgb ? 99 : 98; // DXGI_FORMAT_BC7_UNORM(_SRGB)
+	}
+}
+
+// The DDS file header followed by the DX10 extension header, which every cooked file has so the exact DXGI format can be given
+struct DDSHeader
+{
+	uint32_t magic;
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	uint32_t pixelFormatSize;
+	uint32_t pixelFormatFlags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t bitMasks[4];
+	uint32_t caps[4];
+	uint32_t reserved2;
+
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+static_assert(sizeof(DDSHeader) == 4 + 124 + 20, "DDS header must match the file layout");
+
+
+// Make the mip-maps of an image, compress them and write them to a DDS file. Returns false if the image is not a
+// multiple of 4 texels across, as Direct3D requires for block compressed textures, or if the file can't be written
+bool WriteCookedTexture(const std::string& fileName, const TextureImage& image, const TextureCookSettings& settings,
+                        ThreadPool* threads /*= nullptr*/)
+{
+	if (image.width <= 0 || image.height <= 0 || image.width % 4 != 0 || image.height % 4 != 0)  return false;
+
+	std::vector<TextureImage> mips;
+	GenerateMips(image, settings.linear, mips, threads);
+
+	std::vector<std::vector<uint8_t>> levels(mips.size());
+	for (size_t i = 0; i < mips.size(); ++i)  CompressImage(mips[i], settings.format, levels[i], threads);
+
+	DDSHeader header = {};
+	header.magic             = 0x20534444; // "DDS "
+	header.size              = 124;
+	header.flags             = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // Caps, height, width, pixel format, mip count, linear size
+	header.height            = image.height;
+	header.width             = image.width;
+	header.pitchOrLinearSize = static_cast<uint32_t>(levels[0].size());
+	header.mipMapCount       = static_cast<uint32_t>(mips.size());
+	header.pixelFormatSize   = 32;
+	header.pixelFormatFlags  = 0x4;        // Four CC
+	header.fourCC            = 0x30315844; // "DX10"
+	header.caps[0]           = 0x1000 | 0x400000 | 0x8; // Texture, mip-map, complex
+	header.dxgiFormat        = DXGIFormat(settings.format, settings.srgb);
+	header.resourceDimension = 3; // D3D11_RESOURCE_DIMENSION_TEXTURE2D
+	header.arraySize         = 1;
+
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file)  return false;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (auto& level : levels)  file.write(reinterpret_cast<const char*>(level.data()), level.size());
+	return static_cast<bool>(file);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Cache
+//--------------------------------------------------------------------------------------
+
+// Hash of a source texture file's contents, including the cooker version. FNV-1a taken 8 bytes at a time, plenty to tell
+// versions of a file apart and quick enough to run on every texture at startup
+uint64_t HashTextureSource(const uint8_t* data, size_t size)
+{
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = (hash ^ TEXTURE_COOKER_VERSION) * prime;
+	hash = (hash ^ size) * prime;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; ++i)  hash = (hash ^ data[i]) * prime;
+	return hash;
+}
+
+
+// Name of the cooked file for a source texture file with the given contents hash, e.g.
+// TextureCache/Stars.jpg.0123456789abcdef.dds for Stars.jpg
+std::string CookedTextureFileName(const std::string& sourceFileName, uint64_t hash)
+{
+	size_t nameStart = sourceFileName.find_last_of("/\\");
+	nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+
+	char hashText[17];
+	snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash));
+	return sourceFileName.substr(0, nameStart) + TEXTURE_CACHE_FOLDER + "/" + sourceFileName.substr(nameStart) + "." + hashText + ".dds";
+}
@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// Cooked textures - mip generation, block compression and the cooked DDS cache
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Textures in JPG, PNG and similar formats are slow to load - they are decoded on every run, uploaded uncompressed and
+// may not get a full set of mip-maps. The TextureCooker tool (Tools/TextureCooker) decodes them once and writes a cooked
+// DDS file with every mip-map, block compressed, which the app uploads as it is.
+//
+// Mip-maps are made with a box filter. Colour textures are filtered in linear light (converting from and back to sRGB)
+// so dark and bright areas average correctly, data textures (noise, distortion offsets etc.) are filtered as they are.
+//
+// Cooked files live in a TextureCache folder next to the source file, named after the source file and a hash of its
+// contents (CookedTextureFileName). A changed source gets a new name so stale cooked files are never used, and the app
+// falls back to decoding the source until it is cooked again.
+
+#ifndef _COOKED_TEXTURE_H_INCLUDED_
+#define _COOKED_TEXTURE_H_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+
+// Changes whenever cooking would give different results, so old cooked files are not used
+const uint32_t TEXTURE_COOKER_VERSION = 1;
+
+// Folder holding the cooked files, next to the source files
+const char* const TEXTURE_CACHE_FOLDER = "TextureCache";
+
+
+// Block compressed formats the cooker writes
+enum class TextureFormat
+{
+	BC1, // RGB, 4 bits per texel
+	BC3, // RGBA, 8 bits per texel
+	BC4, // Red only, 4 bits per texel
+	BC5, // Red and green, 8 bits per texel
+	BC7, // RGBA, 8 bits per texel, higher quality than BC1/BC3
+};
+
+struct TextureCookSettings
+{
+	TextureFormat format = TextureFormat::BC7;
+	bool linear = false; // Data rather than colour - filter mip-maps without converting from sRGB
+	bool srgb   = false; // Write the sRGB version of the format, so the GPU converts to linear when sampling. Leave false
+	                     // to sample the stored values as they are, as the app's shaders expect
+};
+
+
+// An uncompressed image, 8-bit RGBA texels in rows from the top left
+struct TextureImage
+{
+	int width  = 0;
+	int height = 0;
+	std::vector<uint8_t> texels;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Cooking
+//--------------------------------------------------------------------------------------
+
+// Make the full chain of mip-maps for an image, down to 1x1. mips[0] is a copy of the image. Set linear for data
+// textures, otherwise the colour channels are filtered in linear light. Pass a thread pool to split the work
+void GenerateMips(const TextureImage& image, bool linear, std::vector<TextureImage>& mips, ThreadPool* threads = nullptr);
+
+// Block compress an image into the given format. Images that aren't a multiple of 4 texels across are padded by
+// repeating the edge texels
+void CompressImage(const TextureImage& image, TextureFormat format, std::vector<uint8_t>& blocks, ThreadPool* threads = nullptr);
+
+// Decompress blocks back into an image, e.g. to measure the quality of the compression
+void DecompressImage(const uint8_t* blocks, int width, int height, TextureFormat format, TextureImage& image);
+
+// Make the mip-maps of an image, compress them and write them to a DDS file. Returns false if the image is not a
+// multiple of 4 texels across, as Direct3D requires for block compressed textures, or if the file can't be written
+bool WriteCookedTexture(const std::string& fileName, const TextureImage& image, const TextureCookSettings& settings,
+                        ThreadPool* threads = nullptr);
+
+
+//--------------------------------------------------------------------------------------
+// Cache
+//--------------------------------------------------------------------------------------
+
+// Hash of a source texture file's contents, including the cooker version
+uint64_t HashTextureSource(const uint8_t* data, size_t size);
+
+// Name of the cooked file for a source texture file with the given contents hash, e.g.
+// TextureCache/Stars.jpg.0123456789abcdef.dds for Stars.jpg
+std::string CookedTextureFileName(const std::string& sourceFileName, uint64_t hash);
+
+
+#endif //_COOKED_TEXTURE_H_INCLUDED_
@@ -0,0 +1,259 @@
+//--------------------------------------------------------------------------------------
+// Frame statistics - frame time percentiles, jitter and frame pacing problems
+//--------------------------------------------------------------------------------------
+
+#include "FrameStatistics.h"
+#include "Clock.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+
+//--------------------------------------------------------------------------------------
+// Histogram
+//--------------------------------------------------------------------------------------
+
+// Values below 2 * HISTOGRAM_HALF get a bucket each. Above that each power of two is split into HISTOGRAM_HALF buckets,
+// so a bucket is under 1/HISTOGRAM_HALF of its values wide
+static const int HISTOGRAM_SUB_BITS = 8;
+static const int HISTOGRAM_HALF = 1 << (HISTOGRAM_SUB_BITS - 1);
+static const int HISTOGRAM_MAX_BITS = 40; // Values up to 2^40ns, about 18 minutes
+static const int HISTOGRAM_BUCKETS = 2 * HISTOGRAM_HALF + (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_HALF;
+
+
+TimeHistogram::TimeHistogram()
+	: mBuckets(HISTOGRAM_BUCKETS, 0)
+{
+	Clear();
+}
+
+void TimeHistogram::Clear()
+{
+	std::fill(mBuckets.begin(), mBuckets.end(), 0);
+	mCount = 0;
+	mMin = INT64_MAX;
+	mMax = 0;
+	mSum = 0;
+	mSumSquares = 0;
+}
+
+
+int TimeHistogram::BucketIndex(int64_t value)
+{
+	if (value < 2 * HISTOGRAM_HALF)  return static_cast<int>(std::max<int64_t>(value, 0));
+
+	int topBit = 0;
+	for (uint64_t v = static_cast<uint64_t>(value); v > 1; v >>= 1)  ++topBit;
+	int shift = topBit - (HISTOGRAM_SUB_BITS - 1);
+	int index = 2 * HISTOGRAM_HALF + (shift - 1) * HISTOGRAM_HALF + static_cast<int>((value >> shift) - HISTOGRAM_HALF);
+	return std::min(index, HISTOGRAM_BUCKETS - 1);
+}
+
+// Value in the middle of a bucket
+int64_t TimeHistogram::BucketMiddle(int index)
+{
+	if (index < 2 * HISTOGRAM_HALF)  return index;
+
+	int shift = (index - 2 * HISTOGRAM_HALF) / HISTOGRAM_HALF + 1;
+	int64_t subBucket = (index - 2 * HISTOGRAM_HALF) % HISTOGRAM_HALF + HISTOGRAM_HALF;
+	return (subBucket << shift) + (int64_t(1) << (shift - 1));
+}
+
+
+void TimeHistogram::Add(int64_t nanoseconds)
+{
+	nanoseconds = std::max<int64_t>(nanoseconds, 0);
+	++mBuckets[BucketIndex(nanoseconds)];
+	++mCount;
+	mMin = std::min(mMin, nanoseconds);
+	mMax = std::max(mMax, nanoseconds);
+	mSum += static_cast<double>(nanoseconds);
+	mSumSquares += static_cast<double>(nanoseconds) * nanoseconds;
+}
+
+
+double TimeHistogram::StandardDeviation() const
+{
+	if (mCount == 0)  return 0.0;
+	double mean = mSum / mCount;
+	return std::sqrt(std::max(0.0, mSumSquares / mCount - mean * mean));
+}
+
+
+// Time that the given percentage (0-100) of values are at or below
+int64_t TimeHistogram::Percentile(double percentage) const
+{
+	if (mCount == 0)  return 0;
+
+	uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(percentage, 0.0), 100.0) / 100.0 * mCount));
+	rank = std::max<uint64_t>(rank, 1);
+	uint64_t total = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+	{
+		total += mBuckets[i];
+		if (total >= rank)  return std::min(std::max(BucketMiddle(i), mMin), mMax);
+	}
+	return mMax;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Frame statistics
+//--------------------------------------------------------------------------------------
+
+FrameStatistics::FrameStatistics()
+	: mFrames(0)
+{
+}
+
+void FrameStatistics::Clear()
+{
+	for (auto& mode : mModes)  mode = Mode();
+	mAnomalies.clear();
+	mFrames = 0;
+}
+
+
+// Add the time of one frame
+void FrameStatistics::AddFrame(double frameSeconds, FramePacing pacing)
+{
+	Mode& mode = mModes[static_cast<int>(pacing)];
+	double frameMs = frameSeconds * 1000.0;
+	mode.histogram.Add(SecondsToNanoseconds(frameSeconds));
+
+	if (mode.lastFrameMs >= 0)  mode.totalChangeMs += std::abs(frameMs - mode.lastFrameMs);
+	mode.lastFrameMs = frameMs;
+
+	// Compare with the median of the recent frames once there are enough of them
+	if (mode.numRecent == RECENT_FRAMES)
+	{
+		double recent[RECENT_FRAMES];
+		std::copy(mode.recentMs, mode.recentMs + RECENT_FRAMES, recent);
+		std::nth_element(recent, recent + RECENT_FRAMES / 2, recent + RECENT_FRAMES);
+		double expectedMs = recent[RECENT_FRAMES / 2];
+
+		bool anomaly = true;
+		FrameAnomalyType type = FrameAnomalyType::Stutter;
+		if (pacing == FramePacing::VSync && frameMs >= 1.5 * expectedMs)       type = FrameAnomalyType::MissedVSync;
+		else if (pacing == FramePacing::VSync && frameMs <= 0.5 * expectedMs)  type = FrameAnomalyType::EarlyFrame;
+		else if (pacing == FramePacing::Unlocked && frameMs >= 2.0 * expectedMs)  type = FrameAnomalyType::Stutter;
+		else  anomaly = false;
+
+		if (anomaly)
+		{
+			++mode.anomalies;
+			if (mAnomalies.size() < MAX_ANOMALIES)  mAnomalies.push_back({ mFrames, pacing, type, frameMs, expectedMs });
+		}
+	}
+
+	mode.recentMs[mode.nextRecent] = frameMs;
+	mode.nextRecent = (mode.nextRecent + 1) % RECENT_FRAMES;
+	if (mode.numRecent < RECENT_FRAMES)  ++mode.numRecent;
+	++mFrames;
+}
+
+
+// Summary of the frames added in one mode
+FrameTimeSummary FrameStatistics::Summary(FramePacing pacing) const
+{
+	const Mode& mode = mModes[static_cast<int>(pacing)];
+	const TimeHistogram& histogram = mode.histogram;
+	const double toMs = 1e-6;
+
+	FrameTimeSummary summary;
+	summary.frames = histogram.Count();
+	summary.meanMs = histogram.Mean() * toMs;
+	summary.minMs  = histogram.Min() * toMs;
+	summary.p50Ms  = histogram.Percentile(50.0) * toMs;
+	summary.p90Ms  = histogram.Percentile(90.0) * toMs;
+	summary.p99Ms  = histogram.Percentile(99.0) * toMs;
+	summary.p999Ms = histogram.Percentile(99.9) * toMs;
+	summary.maxMs  = histogram.Max() * toMs;
+	summary.standardDeviationMs = histogram.StandardDeviation() * toMs;
+	summary.jitterMs  = (summary.frames > 1) ? mode.totalChangeMs / (summary.frames - 1) : 0.0;
+	summary.anomalies = mode.anomalies;
+	return summary;
+}
+
+
+// A table of the summaries for each mode that has frames
+std::string FrameStatistics::Report() const
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+	out << std::left << std::setw(10) << "Mode" << std::right << std::setw(9) << "Frames" << std::setw(9) << "Mean"
+	    << std::setw(9) << "Min" << std::setw(9) << "p50" << std::setw(9) << "p90" << std::setw(9) << "p99"
+	    << std::setw(9) << "p99.9" << std::setw(9) << "Max" << std::setw(9) << "Jitter" << std::setw(11) << "Anomalies" << "\n";
+	for (int i = 0; i < NUM_FRAME_PACINGS; ++i)
+	{
+		FrameTimeSummary summary = Summary(static_cast<FramePacing>(i));
+		if (summary.frames == 0)  continue;
+		out << std::left << std::setw(10) << FramePacingName(static_cast<FramePacing>(i)) << std::right
+		    << std::setw(9) << summary.frames << std::setw(9) << summary.meanMs << std::setw(9) << summary.minMs
+		    << std::setw(9) << summary.p50Ms << std::setw(9) << summary.p90Ms << std::setw(9) << summary.p99Ms
+		    << std::setw(9) << summary.p999Ms << std::setw(9) << summary.maxMs << std::setw(9) << summary.jitterMs
+		    << std::setw(11) << summary.anomalies << "\n";
+	}
+	return out.str();
+}
+
+
+// Write the summaries for each mode as CSV, one row for each. Returns false if the file can't be written
+bool FrameStatistics::WriteCSV(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << std::fixed << std::setprecision(4);
+	file << "mode,frames,mean_ms,min_ms,p50_ms,p90_ms,p99_ms,p99.9_ms,max_ms,std_dev_ms,jitter_ms,anomalies\n";
+	for (int i = 0; i < NUM_FRAME_PACINGS; ++i)
+	{
+		FrameTimeSummary summary = Summary(static_cast<FramePacing>(i));
+		file << FramePacingName(static_cast<FramePacing>(i)) << "," << summary.frames << "," << summary.meanMs << ","
+		     << summary.minMs << "," << summary.p50Ms << "," << summary.p90Ms << "," << summary.p99Ms << ","
+		     << summary.p999Ms << "," << summary.maxMs << "," << summary.standardDeviationMs << ","
+		     << summary.jitterMs << "," << summary.anomalies << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+// Write the anomalies as CSV, one row for each. Returns false if the file can't be written
+bool FrameStatistics::WriteAnomaliesCSV(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << std::fixed << std::setprecision(4);
+	file << "frame,mode,type,frame_ms,expected_ms\n";
+	for (auto& anomaly : mAnomalies)
+	{
+		file << anomaly.frame << "," << FramePacingName(anomaly.pacing) << "," << FrameAnomalyTypeName(anomaly.type) << ","
+		     << anomaly.frameMs << "," << anomaly.expectedMs << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+
+const char* FramePacingName(FramePacing pacing)
+{
+	switch (pacing)
+	{
+	case FramePacing::VSync:    return "VSync";
+	case FramePacing::Unlocked: return "Unlocked";
+	}
+	return "Unknown";
+}
+
+const char* FrameAnomalyTypeName(FrameAnomalyType type)
+{
+	switch (type)
+	{
+	case FrameAnomalyType::MissedVSync: return "MissedVSync";
+	case FrameAnomalyType::EarlyFrame:  return "EarlyFrame";
+	case FrameAnomalyType::Stutter:     return "Stutter";
+	}
+	return "Unknown";
+}
@@ -0,0 +1,166 @@
+//--------------------------------------------------------------------------------------
+// Frame statistics - frame time percentiles, jitter and frame pacing problems
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// An average frame time hides the occasional long frame that is seen as a stutter. Feed every frame's time to
+// FrameStatistics and it keeps a histogram of them, from which percentiles can be read at any time: p99 is the frame
+// time that 99% of frames beat. Jitter is the average change in frame time from one frame to the next, which is what
+// makes motion look uneven even when the average is fine.
+//
+// Frames are kept separately for vsync-locked and unlocked rendering as they behave differently:
+//  - Locked to vsync, frames should take one refresh interval. A frame taking 1.5 intervals or more missed a vsync,
+//    one taking half an interval or less was not held to vsync at all
+//  - Unlocked, a frame taking twice as long as the recent frames or more is a stutter
+// The expected frame time is the median of the recent frames in the same mode. Each problem is kept as an anomaly.
+//
+// The histogram works like an HDR histogram: buckets are exact for small values and then a fixed fraction of the value
+// wide (under 1%), so memory and the cost of adding a frame stay small and fixed however many frames are added
+
+#ifndef _FRAME_STATISTICS_H_INCLUDED_
+#define _FRAME_STATISTICS_H_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+//--------------------------------------------------------------------------------------
+// Histogram
+//--------------------------------------------------------------------------------------
+
+// Histogram of times in nanoseconds, accurate to under 1% up to about 18 minutes
+class TimeHistogram
+{
+public:
+	TimeHistogram();
+
+	void Add(int64_t nanoseconds);
+	void Clear();
+
+	uint64_t Count() const { return mCount; }
+	int64_t  Min()   const { return mCount > 0 ? mMin : 0; }
+	int64_t  Max()   const { return mMax; }
+	double   Mean()  const { return mCount > 0 ? mSum / mCount : 0.0; }
+	double   StandardDeviation() const;
+
+	// Time that the given percentage (0-100) of values are at or below
+	int64_t Percentile(double percentage) const;
+
+private:
+	static int     BucketIndex(int64_t value);
+	static int64_t BucketMiddle(int index);
+
+	std::vector<uint64_t> mBuckets;
+	uint64_t mCount;
+	int64_t  mMin;
+	int64_t  mMax;
+	double   mSum;
+	double   mSumSquares;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Frame statistics
+//--------------------------------------------------------------------------------------
+
+enum class FramePacing
+{
+	VSync,    // Presented locked to vsync
+	Unlocked, // Presented as fast as possible
+};
+const int NUM_FRAME_PACINGS = 2;
+
+enum class FrameAnomalyType
+{
+	MissedVSync, // Locked to vsync but took at least 1.5 refresh intervals
+	EarlyFrame,  // Locked to vsync but took half an interval or less
+	Stutter,     // Unlocked and took at least twice as long as recent frames
+};
+
+struct FrameAnomaly
+{
+	uint64_t         frame;      // Number of the frame among all frames added
+	FramePacing      pacing;
+	FrameAnomalyType type;
+	double           frameMs;
+	double           expectedMs; // Median of the recent frames
+};
+
+// Summary of the frames in one pacing mode, times in milliseconds
+struct FrameTimeSummary
+{
+	uint64_t frames;
+	double   meanMs;
+	double   minMs;
+	double   p50Ms;
+	double   p90Ms;
+	double   p99Ms;
+	double   p999Ms;
+	double   maxMs;
+	double   standardDeviationMs;
+	double   jitterMs;   // Mean change in frame time from one frame to the next
+	uint64_t anomalies;
+};
+
+
+class FrameStatistics
+{
+public:
+	FrameStatistics();
+
+	// Add the time of one frame
+	void AddFrame(double frameSeconds, FramePacing pacing);
+
+	// Forget all frames
+	void Clear();
+
+
+	// Frames added so far in each mode
+	const TimeHistogram& Histogram(FramePacing pacing) const { return mModes[static_cast<int>(pacing)].histogram; }
+
+	// Summary of the frames added in one mode
+	FrameTimeSummary Summary(FramePacing pacing) const;
+
+	// Frame pacing problems found, oldest first. Only the first MAX_ANOMALIES are kept, though all are counted
+	const std::vector<FrameAnomaly>& Anomalies() const { return mAnomalies; }
+	static const size_t MAX_ANOMALIES = 10000;
+
+
+	// A table of the summaries for each mode that has frames
+	std::string Report() const;
+
+	// Write the summaries for each mode as CSV, one row for each. Returns false if the file can't be written
+	bool WriteCSV(const std::string& fileName) const;
+
+	// Write the anomalies as CSV, one row for each. Returns false if the file can't be written
+	bool WriteAnomaliesCSV(const std::string& fileName) const;
+
+
+private:
+	// Number of recent frames the expected frame time is taken from
+	static const int RECENT_FRAMES = 31;
+
+	struct Mode
+	{
+		TimeHistogram histogram;
+		double   totalChangeMs = 0; // For jitter
+		double   lastFrameMs = -1;  // Negative before the first frame
+		uint64_t anomalies = 0;
+
+		double recentMs[RECENT_FRAMES];
+		int    numRecent = 0;
+		int    nextRecent = 0;
+	};
+
+	Mode mModes[NUM_FRAME_PACINGS];
+	std::vector<FrameAnomaly> mAnomalies;
+	uint64_t mFrames;
+};
+
+
+const char* FramePacingName(FramePacing pacing);
+const char* FrameAnomalyTypeName(FrameAnomalyType type);
+
+
+#endif //_FRAME_STATISTICS_H_INCLUDED_
@@ -36,6 +36,23 @@ bool LoadTexture(std::string filename, ID3D11Resource** texture, ID3D11ShaderRes
 }
 
 
+// As LoadTexture, but for a texture file already read into memory. The filename selects the file type and is not read
+bool LoadTextureFromMemory(std::string filename, const uint8_t* data, size_t size,
+                           ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV)
+{
+    std::string dds = ".dds";
+    if (filename.size() >= 4 &&
+        std::equal(dds.rbegin(), dds.rend(), filename.rbegin(), [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); }))
+    {
+        return SUCCEEDED(DirectX::CreateDDSTextureFromMemory(gD3DDevice, data, size, texture, textureSRV));
+    }
+    else
+    {
+        return SUCCEEDED(DirectX::CreateWICTextureFromMemory(gD3DDevice, gD3DContext, data, size, texture, textureSRV));
+    }
+}
+
+
 //--------------------------------------------------------------------------------------
 // Camera Helpers
 //--------------------------------------------------------------------------------------
@@ -9,6 +9,7 @@
 #include "CMatrix4x4.h"
 #include "../Common.h"
 #include <d3d11.h>
+#include <cstdint>
 
 
 //--------------------------------------------------------------------------------------
@@ -38,6 +39,11 @@ void UpdateConstantBuffer(ID3D11Buffer* buffer, const T& bufferData)
 // The function will fill in these pointers with usable data. Returns false on failure
 bool LoadTexture(std::string filename, ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV);
 
+// As LoadTexture, but for a texture file already read into memory, e.g. by a load stage of the AssetLoader. The filename
+// selects the file type and is not read
+bool LoadTextureFromMemory(std::string filename, const uint8_t* data, size_t size,
+                           ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV);
+
 
 //--------------------------------------------------------------------------------------
 // Camera helpers
@@ -4,6 +4,7 @@
 //--------------------------------------------------------------------------------------
 
 #include "Input.h"
+#include "InputRecording.h"
 
 
 //////////////////////////////////
@@ -15,6 +16,15 @@ KeyState gKeyStates[NumKeyCodes];
 // Current position of mouse
 int gMouseX, gMouseY;
 
+// Recording and replay of the events above
+InputRecorder  gInputRecorder;
+InputRecording gInputReplay;
+bool           gReplayingInput = false;
+bool           gReplayFinished = false;
+size_t         gNextReplayEvent = 0;
+int64_t        gInputTime = 0; // Scene time in microseconds, the total of the frame times passed to InputFrame
+std::string    gInputLastError;
+
 
 
 //////////////////////////////////
@@ -35,8 +45,8 @@ void InitInput()
 //////////////////////////////////
 // Events
 
-// Event called to indicate that a key has been pressed down
-void KeyDownEvent(KeyCode Key)
+// Change the key states, from either the window or a replay
+static void ApplyKeyDown(KeyCode Key)
 {
     if (gKeyStates[Key] == NotPressed)
     {
@@ -48,17 +58,40 @@ void KeyDownEvent(KeyCode Key)
     }
 }
 
+static void ApplyKeyUp(KeyCode Key)
+{
+    gKeyStates[Key] = NotPressed;
+}
+
+static void ApplyMouseMove(int X, int Y)
+{
+    gMouseX = X;
+    gMouseY = Y;
+}
+
+
+// Event called to indicate that a key has been pressed down
+void KeyDownEvent(KeyCode Key)
+{
+    if (gReplayingInput && Key != Key_Escape)  return;
+    gInputRecorder.Add({ InputEventType::KeyDown, gInputTime, Key, 0, 0 });
+    ApplyKeyDown(Key);
+}
+
 // Event called to indicate that a key has been lifted up
 void KeyUpEvent(KeyCode Key)
 {
-   gKeyStates[Key] = NotPressed;
+    if (gReplayingInput && Key != Key_Escape)  return;
+    gInputRecorder.Add({ InputEventType::KeyUp, gInputTime, Key, 0, 0 });
+    ApplyKeyUp(Key);
 }
 
 // Event called to indicate that the mouse has been moved
 void MouseMoveEvent(int X, int Y)
 {
-    gMouseX = X;
-    gMouseY = Y;
+    if (gReplayingInput)  return;
+    gInputRecorder.Add({ InputEventType::MouseMove, gInputTime, static_cast<KeyCode>(0), X, Y });
+    ApplyMouseMove(X, Y);
 }
 
 
@@ -103,3 +136,109 @@ int GetMouseY()
 {
     return gMouseY;
 }
+
+
+//////////////////////////////////
+// Recording and replay
+
+// Start writing every input event to a recording file, along with the seed the random numbers were started with so a
+// replay can repeat them. Returns false if the file can't be created, see InputLastError
+bool StartInputRecording(const std::string& fileName, uint64_t seed)
+{
+    gInputTime = 0;
+    if (!gInputRecorder.Open(fileName, seed))
+    {
+        gInputLastError = gInputRecorder.LastError();
+        return false;
+    }
+    return true;
+}
+
+// Finish the recording. Returns false if it could not all be written
+bool StopInputRecording()
+{
+    if (!gInputRecorder.IsOpen())  return true;
+    if (!gInputRecorder.Close(gInputTime))
+    {
+        gInputLastError = gInputRecorder.LastError();
+        return false;
+    }
+    return true;
+}
+
+
+// Replay a recording instead of taking input from the window. Window events are ignored until the replay ends, apart
+// from Escape so a replay can be stopped. Returns false if the recording can't be read, see InputLastError
+bool StartInputReplay(const std::string& fileName)
+{
+    if (!gInputReplay.Load(fileName))
+    {
+        gInputLastError = gInputReplay.LastError();
+        return false;
+    }
+
+    // Start from the state the recording did
+    InitInput();
+    gReplayingInput = true;
+    gReplayFinished = false;
+    gNextReplayEvent = 0;
+    gInputTime = 0;
+    return true;
+}
+
+// True from StartInputReplay until the end of the recording is reached
+bool IsReplayingInput()
+{
+    return gReplayingInput;
+}
+
+// Random number seed stored in the recording being replayed
+uint64_t InputReplaySeed()
+{
+    return gInputReplay.Seed();
+}
+
+
+// Call once a frame before updating the scene, frameTime is the time the scene will be updated by. Keeps the time for
+// recorded events and when replaying sends the events due by the start of this frame. An event is held over to the next
+// frame if its key already changed this frame, so quick taps still give a KeyHit when replayed with a longer timestep.
+// Returns false once a replay has reached the end of its recording
+bool InputFrame(float frameTime)
+{
+    if (gReplayingInput)
+    {
+        const std::vector<InputEvent>& events = gInputReplay.Events();
+        bool keyChanged[NumKeyCodes] = {};
+        while (gNextReplayEvent < events.size() && events[gNextReplayEvent].time <= gInputTime)
+        {
+            const InputEvent& event = events[gNextReplayEvent];
+            if (event.type == InputEventType::MouseMove)
+            {
+                ApplyMouseMove(event.x, event.y);
+            }
+            else
+            {
+                if (keyChanged[event.key])  break;
+                keyChanged[event.key] = true;
+                if (event.type == InputEventType::KeyDown)  ApplyKeyDown(event.key);
+                else                                        ApplyKeyUp(event.key);
+            }
+            ++gNextReplayEvent;
+        }
+
+        if (gNextReplayEvent == events.size() && gInputTime >= gInputReplay.Length())
+        {
+            gReplayingInput = false;
+            gReplayFinished = true;
+        }
+    }
+
+    gInputTime += static_cast<int64_t>(static_cast<double>(frameTime) * 1000000.0 + 0.5);
+    return !gReplayFinished;
+}
+
+// Description of the last recording or replay error
+const std::string& InputLastError()
+{
+    return gInputLastError;
+}
@@ -7,6 +7,9 @@
 #ifndef _INPUT_H_DEFINED_
 #define _INPUT_H_DEFINED_
 
+#include <string>
+#include <cstdint>
+
 
 //////////////////////////////////
 // Constants
@@ -202,4 +205,34 @@ int GetMouseX();
 int GetMouseY();
 
 
+//////////////////////////////////
+// Recording and replay (see InputRecording.h for the file format)
+
+// Start writing every input event to a recording file, along with the seed the random numbers were started with so a
+// replay can repeat them. Returns false if the file can't be created, see InputLastError
+bool StartInputRecording(const std::string& fileName, uint64_t seed);
+
+// Finish the recording. Returns false if it could not all be written
+bool StopInputRecording();
+
+// Replay a recording instead of taking input from the window. Window events are ignored until the replay ends, apart
+// from Escape so a replay can be stopped. Returns false if the recording can't be read, see InputLastError
+bool StartInputReplay(const std::string& fileName);
+
+// True from StartInputReplay until the end of the recording is reached
+bool IsReplayingInput();
+
+// Random number seed stored in the recording being replayed
+uint64_t InputReplaySeed();
+
+// Call once a frame before updating the scene, frameTime is the time the scene will be updated by. Keeps the time for
+// recorded events and when replaying sends the events due by the start of this frame. An event is held over to the next
+// frame if its key already changed this frame, so quick taps still give a KeyHit when replayed with a longer timestep.
+// Returns false once a replay has reached the end of its recording
+bool InputFrame(float frameTime);
+
+// Description of the last recording or replay error
+const std::string& InputLastError();
+
+
 #endif // _INPUT_H_DEFINED_
@@ -0,0 +1,261 @@
+//--------------------------------------------------------------------------------------
+// Input recordings - a compact binary log of key, button and mouse events for replaying
+//--------------------------------------------------------------------------------------
+
+#include "InputRecording.h"
+
+#include <iterator>
+
+
+static const char INPUT_RECORDING_MAGIC[4] = { 'P', 'P', 'I', 'N' };
+
+// Buffered events are written once there are this many bytes
+static const size_t FLUSH_BYTES = 64 * 1024;
+
+
+//--------------------------------------------------------------------------------------
+// Encoding
+//--------------------------------------------------------------------------------------
+
+static void WriteVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+// Zig-zag encoding keeps small negative numbers small: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+static void WriteSignedVarint(std::vector<uint8_t>& out, int64_t value)
+{
+	WriteVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static void WriteLittleEndian(std::vector<uint8_t>& out, uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i)  out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+
+// Reads values from a loaded file, remembering if it ran off the end
+class ByteReader
+{
+public:
+	ByteReader(const std::vector<uint8_t>& data) : mData(data) {}
+
+	bool AtEnd() const { return mPos >= mData.size(); }
+	bool Failed() const { return mFailed; }
+
+	uint8_t Byte()
+	{
+		if (AtEnd())
+		{
+			mFailed = true;
+			return 0;
+		}
+		return mData[mPos++];
+	}
+
+	uint64_t LittleEndian(int bytes)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; ++i)  value |= static_cast<uint64_t>(Byte()) << (8 * i);
+		return value;
+	}
+
+	uint64_t Varint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = Byte();
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)  return value;
+		}
+		mFailed = true;
+		return 0;
+	}
+
+	int64_t SignedVarint()
+	{
+		uint64_t value = Varint();
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+private:
+	const std::vector<uint8_t>& mData;
+	size_t mPos = 0;
+	bool   mFailed = false;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Writing
+//--------------------------------------------------------------------------------------
+
+InputRecorder::~InputRecorder()
+{
+	if (IsOpen())  Close(mLastTime);
+}
+
+
+// Start a new recording, replacing any file with the same name. Returns false if the file can't be created
+bool InputRecorder::Open(const std::string& fileName, uint64_t seed)
+{
+	if (IsOpen())  Close(mLastTime);
+
+	mFile.open(fileName, std::ios::binary | std::ios::trunc);
+	if (!mFile)
+	{
+		mLastError = "Error creating input recording " + fileName;
+		return false;
+	}
+
+	mBuffer.clear();
+	for (char c : INPUT_RECORDING_MAGIC)  mBuffer.push_back(static_cast<uint8_t>(c));
+	WriteLittleEndian(mBuffer, INPUT_RECORDING_VERSION, 2);
+	WriteLittleEndian(mBuffer, 0, 2);
+	WriteLittleEndian(mBuffer, seed, 8);
+	mLastTime = 0;
+	mLastX = mLastY = 0;
+	return true;
+}
+
+
+// Add an event, times must not go backwards
+void InputRecorder::Add(const InputEvent& event)
+{
+	if (!IsOpen())  return;
+
+	int64_t time = (event.time > mLastTime) ? event.time : mLastTime;
+	mBuffer.push_back(static_cast<uint8_t>(event.type));
+	WriteVarint(mBuffer, static_cast<uint64_t>(time - mLastTime));
+	mLastTime = time;
+
+	if (event.type == InputEventType::KeyDown || event.type == InputEventType::KeyUp)
+	{
+		mBuffer.push_back(static_cast<uint8_t>(event.key));
+	}
+	else if (event.type == InputEventType::MouseMove)
+	{
+		WriteSignedVarint(mBuffer, event.x - mLastX);
+		WriteSignedVarint(mBuffer, event.y - mLastY);
+		mLastX = event.x;
+		mLastY = event.y;
+	}
+
+	if (mBuffer.size() >= FLUSH_BYTES)  Flush();
+}
+
+
+// Add the End event at the given time and close the file. Returns false if any of the file could not be written
+bool InputRecorder::Close(int64_t endTime)
+{
+	if (!IsOpen())  return false;
+
+	Add({ InputEventType::End, endTime, static_cast<KeyCode>(0), 0, 0 });
+	Flush();
+	bool written = static_cast<bool>(mFile);
+	mFile.close();
+	if (!written)  mLastError = "Error writing input recording";
+	return written;
+}
+
+
+void InputRecorder::Flush()
+{
+	mFile.write(reinterpret_cast<const char*>(mBuffer.data()), mBuffer.size());
+	mBuffer.clear();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Reading
+//--------------------------------------------------------------------------------------
+
+// Read a recording file. Returns false if it can't be read, is not a recording or is from a different version
+bool InputRecording::Load(const std::string& fileName)
+{
+	mEvents.clear();
+	mSeed = 0;
+	mLength = 0;
+
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+	{
+		mLastError = "Error opening input recording " + fileName;
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	ByteReader reader(data);
+	for (char c : INPUT_RECORDING_MAGIC)
+	{
+		if (reader.Byte() != static_cast<uint8_t>(c))
+		{
+			mLastError = fileName + " is not an input recording";
+			return false;
+		}
+	}
+	uint16_t version = static_cast<uint16_t>(reader.LittleEndian(2));
+	reader.LittleEndian(2);
+	mSeed = reader.LittleEndian(8);
+	if (version != INPUT_RECORDING_VERSION)
+	{
+		mLastError = "Input recording " + fileName + " is version " + std::to_string(version) + ", expected version " +
+		             std::to_string(INPUT_RECORDING_VERSION);
+		return false;
+	}
+
+	int64_t time = 0;
+	int x = 0, y = 0;
+	while (!reader.AtEnd() && !reader.Failed())
+	{
+		InputEvent event = { static_cast<InputEventType>(reader.Byte()), 0, static_cast<KeyCode>(0), 0, 0 };
+		time += static_cast<int64_t>(reader.Varint());
+		event.time = time;
+
+		switch (event.type)
+		{
+		case InputEventType::KeyDown:
+		case InputEventType::KeyUp:
+			event.key = static_cast<KeyCode>(reader.Byte());
+			break;
+
+		case InputEventType::MouseMove:
+			x += static_cast<int>(reader.SignedVarint());
+			y += static_cast<int>(reader.SignedVarint());
+			event.x = x;
+			event.y = y;
+			break;
+
+		case InputEventType::End:
+			if (reader.Failed())  break;
+			mLength = time;
+			return true;
+
+		default:
+			mLastError = "Input recording " + fileName + " has an unknown event type";
+			return false;
+		}
+		mEvents.push_back(event);
+	}
+
+	mLastError = "Input recording " + fileName + " is incomplete";
+	return false;
+}
+
+
+const char* InputEventTypeName(InputEventType type)
+{
+	switch (type)
+	{
+	case InputEventType::KeyDown:   return "KeyDown";
+	case InputEventType::KeyUp:     return "KeyUp";
+	case InputEventType::MouseMove: return "MouseMove";
+	case InputEventType::End:       return "End";
+	}
+	return "Unknown";
+}
@@ -0,0 +1,120 @@
+//--------------------------------------------------------------------------------------
+// Input recordings - a compact binary log of key, button and mouse events for replaying
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Everything the scene does is driven by input, so a performance run can only be repeated if the input is. The input
+// system (Input.h) writes every event it is sent to a recording with the time it arrived, and can replay a recording
+// instead of taking input from the window, which turns a session into a benchmark scenario that runs by itself.
+//
+// Times are scene time - the total of the frame times passed to the scene - in microseconds. Replays step the scene by
+// a fixed time each frame and send the events that are due before each frame, so what the scene does is the same
+// however fast the build or machine renders it. The seed for the random numbers is kept so they repeat too.
+//
+// File layout, all values little-endian:
+//   Header: "PPIN", uint16 version, uint16 reserved, uint64 random seed
+//   Events: uint8 type, then the time since the previous event as a varint, then for
+//     - KeyDown/KeyUp: uint8 key code
+//     - MouseMove:     change in X and Y since the previous mouse move as zig-zag varints
+//     - End:           nothing, the time is the length of the recording. Always the last event
+// Varints hold 7 bits a byte with the top bit set on all but the last byte, so most events take 3 to 5 bytes
+
+#ifndef _INPUT_RECORDING_H_INCLUDED_
+#define _INPUT_RECORDING_H_INCLUDED_
+
+#include "Input.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+
+// Changes whenever the file layout does, older recordings are refused
+const uint16_t INPUT_RECORDING_VERSION = 1;
+
+
+enum class InputEventType : uint8_t
+{
+	KeyDown,
+	KeyUp,
+	MouseMove,
+	End,
+};
+
+struct InputEvent
+{
+	InputEventType type;
+	int64_t        time; // Scene time in microseconds since the recording started
+	KeyCode        key;  // KeyDown and KeyUp only
+	int            x, y; // MouseMove only
+};
+
+
+//--------------------------------------------------------------------------------------
+// Writing
+//--------------------------------------------------------------------------------------
+
+// Writes events to a recording file as they happen. Events are buffered and written in blocks
+class InputRecorder
+{
+public:
+	~InputRecorder();
+
+	// Start a new recording, replacing any file with the same name. Returns false if the file can't be created
+	bool Open(const std::string& fileName, uint64_t seed);
+
+	// Add an event, times must not go backwards
+	void Add(const InputEvent& event);
+
+	// Add the End event at the given time and close the file. Returns false if any of the file could not be written
+	bool Close(int64_t endTime);
+
+	bool IsOpen() const { return mFile.is_open(); }
+
+	const std::string& LastError() const { return mLastError; }
+
+private:
+	void Flush();
+
+	std::ofstream        mFile;
+	std::vector<uint8_t> mBuffer;
+	int64_t              mLastTime = 0;
+	int                  mLastX = 0, mLastY = 0;
+	std::string          mLastError;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Reading
+//--------------------------------------------------------------------------------------
+
+// A whole recording read into memory
+class InputRecording
+{
+public:
+	// Read a recording file. Returns false if it can't be read, is not a recording or is from a different version
+	bool Load(const std::string& fileName);
+
+	uint64_t Seed() const { return mSeed; }
+
+	// Events in time order, not including the End event
+	const std::vector<InputEvent>& Events() const { return mEvents; }
+
+	// Time of the End event
+	int64_t Length() const { return mLength; }
+
+	const std::string& LastError() const { return mLastError; }
+
+private:
+	uint64_t                mSeed = 0;
+	std::vector<InputEvent> mEvents;
+	int64_t                 mLength = 0;
+	std::string             mLastError;
+};
+
+
+const char* InputEventTypeName(InputEventType type);
+
+
+#endif //_INPUT_RECORDING_H_INCLUDED_
@@ -0,0 +1,175 @@
+//--------------------------------------------------------------------------------------
+// Instance batcher - draws many models that share a mesh with one draw per mesh node
+//--------------------------------------------------------------------------------------
+
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+#include <utility>
+
+
+// Name of a usage, used for reports and log output
+const char* InstanceUsageName(InstanceUsage usage)
+{
+	switch (usage)
+	{
+	case InstanceUsage::Static:  return "Static";
+	case InstanceUsage::Dynamic: return "Dynamic";
+	}
+	return "Unknown";
+}
+
+
+//--------------------------------------------------------------------------------------
+// Batcher
+//--------------------------------------------------------------------------------------
+
+InstanceBatcher::InstanceBatcher(InstanceBackend* backend, int modelConstantBytes)
+	: mBackend(backend), mModelConstantBytes(modelConstantBytes) {}
+
+
+// Add a set for instances of a mesh with the given number of nodes, returns the number of the set
+int InstanceBatcher::AddSet(void* mesh, int numNodes, InstanceUsage usage)
+{
+	InstanceSet set;
+	set.mesh     = mesh;
+	set.numNodes = std::max(1, numNodes);
+	set.usage    = usage;
+	mSets.push_back(std::move(set));
+	return static_cast<int>(mSets.size()) - 1;
+}
+
+
+// Remove the instances of a set, keeping the memory for refilling it
+void InstanceBatcher::ClearInstances(int set)
+{
+	auto& instanceSet = mSets[set];
+	if (instanceSet.matrices.empty())  return;
+	instanceSet.matrices.clear();
+	instanceSet.changed = true;
+}
+
+
+// Add an instance, given the absolute world matrix of each node of the mesh. Returns the index of the instance
+int InstanceBatcher::AddInstance(int set, const CMatrix4x4* nodeMatrices)
+{
+	auto& instanceSet = mSets[set];
+	instanceSet.matrices.insert(instanceSet.matrices.end(), nodeMatrices, nodeMatrices + instanceSet.numNodes);
+	instanceSet.changed = true;
+	return NumInstances(set) - 1;
+}
+
+
+// Change the matrices of an instance
+void InstanceBatcher::SetInstance(int set, int instance, const CMatrix4x4* nodeMatrices)
+{
+	auto& instanceSet = mSets[set];
+	std::copy(nodeMatrices, nodeMatrices + instanceSet.numNodes, instanceSet.matrices.begin() + instance * instanceSet.numNodes);
+	instanceSet.changed = true;
+}
+
+
+int InstanceBatcher::NumInstances(int set) const
+{
+	return static_cast<int>(mSets[set].matrices.size()) / mSets[set].numNodes;
+}
+
+
+// Draw every instance of a set, sending its matrices first if they changed since last sent
+bool InstanceBatcher::Render(int set)
+{
+	auto& instanceSet = mSets[set];
+	int numInstances = NumInstances(set);
+	if (numInstances == 0)  return true;
+
+	if (instanceSet.changed)
+	{
+		// A draw reads the instances of one node, so the buffer holds each node's matrices together
+		const CMatrix4x4* matrices = instanceSet.matrices.data();
+		if (instanceSet.numNodes > 1)
+		{
+			instanceSet.nodeOrder.resize(instanceSet.matrices.size());
+			for (int instance = 0; instance < numInstances; ++instance)
+			{
+				for (int node = 0; node < instanceSet.numNodes; ++node)
+				{
+					instanceSet.nodeOrder[node * numInstances + instance] = instanceSet.matrices[instance * instanceSet.numNodes + node];
+				}
+			}
+			matrices = instanceSet.nodeOrder.data();
+		}
+
+		int count = static_cast<int>(instanceSet.matrices.size());
+		if (!mBackend->UploadInstances(set, instanceSet.usage, matrices, count))
+		{
+			mLastError = "Error sending " + std::to_string(count) + " matrices to the instance buffer of set " + std::to_string(set);
+			return false;
+		}
+		instanceSet.changed = false;
+		++mFrameStats.uploads;
+		mFrameStats.uploadedBytes += count * static_cast<int>(sizeof(CMatrix4x4));
+	}
+
+	for (int node = 0; node < instanceSet.numNodes; ++node)
+	{
+		mBackend->DrawInstances(set, instanceSet.mesh, node, node * numInstances, numInstances);
+	}
+	mFrameStats.draws     += instanceSet.numNodes;
+	mFrameStats.instances += numInstances;
+	mFrameStats.modelDraws         += numInstances * instanceSet.numNodes;
+	mFrameStats.modelUploadedBytes += numInstances * instanceSet.numNodes * mModelConstantBytes;
+	return true;
+}
+
+
+// Call at the end of each frame to update the stats
+void InstanceBatcher::EndFrame()
+{
+	mStats.draws              = mFrameStats.draws;
+	mStats.instances          = mFrameStats.instances;
+	mStats.uploads            = mFrameStats.uploads;
+	mStats.uploadedBytes      = mFrameStats.uploadedBytes;
+	mStats.modelDraws         = mFrameStats.modelDraws;
+	mStats.modelUploadedBytes = mFrameStats.modelUploadedBytes;
+	mStats.totalDraws              += mFrameStats.draws;
+	mStats.totalUploadedBytes      += mFrameStats.uploadedBytes;
+	mStats.totalModelDraws         += mFrameStats.modelDraws;
+	mStats.totalModelUploadedBytes += mFrameStats.modelUploadedBytes;
+	++mStats.numFrames;
+
+	mFrameStats = InstanceBatchStats();
+}
+
+// Restart the totals from now
+void InstanceBatcher::ResetStats()
+{
+	mStats.totalDraws              = 0;
+	mStats.totalUploadedBytes      = 0;
+	mStats.totalModelDraws         = 0;
+	mStats.totalModelUploadedBytes = 0;
+	mStats.numFrames               = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Memory backend
+//--------------------------------------------------------------------------------------
+
+bool MemoryInstanceBackend::UploadInstances(int set, InstanceUsage /*usage*/, const CMatrix4x4* matrices, int count)
+{
+	if (set >= static_cast<int>(mBuffers.size()))  mBuffers.resize(set + 1);
+	mBuffers[set].assign(matrices, matrices + count);
+	return true;
+}
+
+void MemoryInstanceBackend::DrawInstances(int set, void* mesh, int node, int firstInstance, int numInstances)
+{
+	mDraws.push_back({ set, mesh, node, firstInstance, numInstances });
+}
+
+// What a set's buffer holds, empty if nothing has been sent
+const std::vector<CMatrix4x4>& MemoryInstanceBackend::Buffer(int set) const
+{
+	static const std::vector<CMatrix4x4> empty;
+	return set < static_cast<int>(mBuffers.size()) ? mBuffers[set] : empty;
+}
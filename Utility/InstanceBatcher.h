@@ -0,0 +1,177 @@
+//--------------------------------------------------------------------------------------
+// Instance batcher - draws many models that share a mesh with one draw per mesh node
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Rendering a Model sends its world matrices in the per-model constants (over 4KB with the bone matrices) and draws each
+// node of its mesh, so a thousand identical crates take a thousand draws and megabytes of constants. A set of instances
+// here holds the absolute world matrix of each node for every instance of one mesh. Its matrices are sent to an instance
+// buffer, one matrix per instance and node, and each node is drawn once for all the instances, the vertex shader reading
+// the world matrix from the buffer (e.g. PixelLightingInstanced_vs.hlsl).
+//
+// A set's matrices are only sent when they have changed since they were last sent, so a set can be drawn in several
+// passes of a frame (colour, normals and depth) for one upload. Static sets are for instances that rarely move, e.g.
+// scenery, dynamic sets for instances that change every frame, often cleared and refilled each frame. The backend keeps
+// a buffer suited to each (see InstanceUsage).
+//
+// The uploads and draws are made by a backend - Scene.cpp uses Direct3D buffers and Mesh::RenderInstanced,
+// MemoryInstanceBackend below keeps the buffers in memory and records the draws, so batching can be checked and counted
+// without a GPU. Handles for meshes are only passed on to the backend.
+
+#ifndef _INSTANCE_BATCHER_H_INCLUDED_
+#define _INSTANCE_BATCHER_H_INCLUDED_
+
+#include "CMatrix4x4.h"
+
+#include <vector>
+#include <string>
+
+
+// How often the instances of a set change
+enum class InstanceUsage
+{
+	Static,  // Rarely, sent to a buffer only the GPU accesses, e.g. D3D11_USAGE_DEFAULT with UpdateSubresource
+	Dynamic, // Most frames, sent to a buffer the CPU writes, e.g. D3D11_USAGE_DYNAMIC mapped with discard
+};
+
+// Name of a usage, used for reports and log output
+const char* InstanceUsageName(InstanceUsage usage);
+
+
+//--------------------------------------------------------------------------------------
+// Backend
+//--------------------------------------------------------------------------------------
+
+class InstanceBackend
+{
+public:
+	virtual ~InstanceBackend() {}
+
+	// Send the matrices of a set to its instance buffer, making or growing the buffer if needed. The matrices are in node
+	// order, all the instances of node 0, then all of node 1 and so on. Returns false on error
+	virtual bool UploadInstances(int set, InstanceUsage usage, const CMatrix4x4* matrices, int count) = 0;
+
+	// Draw a node of a mesh for numInstances instances, reading their world matrices from the set's buffer from
+	// firstInstance on. Shaders, states and textures must already be set
+	virtual void DrawInstances(int set, void* mesh, int node, int firstInstance, int numInstances) = 0;
+};
+
+
+// Work done by a batcher, with what rendering each instance as a Model would have done
+struct InstanceBatchStats
+{
+	int draws         = 0; // Instanced draws in the last frame, one per node of each set rendered
+	int instances     = 0; // Instances drawn in the last frame, counted once for each time their set is rendered
+	int uploads       = 0; // Sets sent to their instance buffer in the last frame
+	int uploadedBytes = 0; // Bytes of matrices sent in the last frame
+	int modelDraws         = 0; // Draws Model::Render would have made for the same instances, one per node
+	int modelUploadedBytes = 0; // Per-model constants it would have sent, one block per draw
+
+	long long totalDraws         = 0; // As above, over all frames counted
+	long long totalUploadedBytes = 0;
+	long long totalModelDraws         = 0;
+	long long totalModelUploadedBytes = 0;
+	int       numFrames = 0;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Batcher
+//--------------------------------------------------------------------------------------
+
+class InstanceBatcher
+{
+public:
+	// The backend must stay valid for the life of the batcher. modelConstantBytes is the size of the per-model constants
+	// rendering a Model sends for each draw, only used for the stats
+	InstanceBatcher(InstanceBackend* backend, int modelConstantBytes);
+
+	// Add a set for instances of a mesh with the given number of nodes, returns the number of the set
+	int AddSet(void* mesh, int numNodes, InstanceUsage usage);
+
+	// Remove the instances of a set, keeping the memory for refilling it
+	void ClearInstances(int set);
+
+	// Add an instance, given the absolute world matrix of each node of the mesh. Returns the index of the instance
+	int AddInstance(int set, const CMatrix4x4* nodeMatrices);
+
+	// Change the matrices of an instance
+	void SetInstance(int set, int instance, const CMatrix4x4* nodeMatrices);
+
+	int NumSets() const { return static_cast<int>(mSets.size()); }
+	int NumInstances(int set) const;
+
+	// Draw every instance of a set, sending its matrices first if they changed since last sent. Returns false if the
+	// matrices could not be sent, LastError says why
+	bool Render(int set);
+
+	// Call at the end of each frame to update the stats
+	void EndFrame();
+
+	// Work done by the batcher
+	const InstanceBatchStats& Stats() const { return mStats; }
+
+	// Restart the totals from now
+	void ResetStats();
+
+	const std::string& LastError() const { return mLastError; }
+
+
+private:
+	struct InstanceSet
+	{
+		void*         mesh;
+		int           numNodes;
+		InstanceUsage usage;
+
+		std::vector<CMatrix4x4> matrices;      // Instance order, the nodes of instance 0, then of instance 1...
+		std::vector<CMatrix4x4> nodeOrder;     // The matrices in the order they are sent, reused each time
+		bool                    changed = true; // Since last sent
+	};
+
+	InstanceBackend*         mBackend;
+	int                      mModelConstantBytes;
+	std::vector<InstanceSet> mSets;
+
+	InstanceBatchStats mFrameStats; // Counts for the frame in progress
+	InstanceBatchStats mStats;
+
+	std::string mLastError;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Memory backend
+//--------------------------------------------------------------------------------------
+
+// An instanced draw made by a backend
+struct RecordedInstanceDraw
+{
+	int   set;
+	void* mesh;
+	int   node;
+	int   firstInstance;
+	int   numInstances;
+};
+
+// Backend that keeps each set's buffer in memory and records the draws, to check a batcher without a GPU
+class MemoryInstanceBackend : public InstanceBackend
+{
+public:
+	bool UploadInstances(int set, InstanceUsage usage, const CMatrix4x4* matrices, int count) override;
+	void DrawInstances(int set, void* mesh, int node, int firstInstance, int numInstances) override;
+
+	// What a set's buffer holds, empty if nothing has been sent
+	const std::vector<CMatrix4x4>& Buffer(int set) const;
+
+	// Draws made so far, in order
+	const std::vector<RecordedInstanceDraw>& Draws() const { return mDraws; }
+	void ClearDraws() { mDraws.clear(); }
+
+private:
+	std::vector<std::vector<CMatrix4x4>> mBuffers; // Indexed by set
+	std::vector<RecordedInstanceDraw>    mDraws;
+};
+
+
+#endif //_INSTANCE_BATCHER_H_INCLUDED_
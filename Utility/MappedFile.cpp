@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// Mapped file - read-only view of a whole file in memory
+//--------------------------------------------------------------------------------------
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+#ifdef _WIN32
+
+// Map the given file, closing any already open
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		mLastError = "Cannot open " + fileName;
+		return false;
+	}
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		mLastError = "Empty or unreadable file " + fileName;
+		Close();
+		return false;
+	}
+
+	mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping != nullptr)  mData = static_cast<const unsigned char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		mLastError = "Cannot map " + fileName;
+		Close();
+		return false;
+	}
+	mSize = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+// Unmap the file
+void MappedFile::Close()
+{
+	if (mData    != nullptr)  UnmapViewOfFile(mData);
+	if (mMapping != nullptr)  CloseHandle(mMapping);
+	if (mFile    != nullptr)  CloseHandle(mFile);
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mSize = 0;
+}
+
+// Get the size and last modification time of a file
+bool GetFileSizeAndTime(const std::string& fileName, uint64_t& size, uint64_t& time)
+{
+	struct _stat64 info;
+	if (_stat64(fileName.c_str(), &info) != 0)  return false;
+	size = static_cast<uint64_t>(info.st_size);
+	time = static_cast<uint64_t>(info.st_mtime);
+	return true;
+}
+
+#else
+
+// Map the given file, closing any already open
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+	mFile = open(fileName.c_str(), O_RDONLY);
+	if (mFile < 0)
+	{
+		mLastError = "Cannot open " + fileName;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(mFile, &info) != 0 || info.st_size == 0)
+	{
+		mLastError = "Empty or unreadable file " + fileName;
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (data == MAP_FAILED)
+	{
+		mLastError = "Cannot map " + fileName;
+		Close();
+		return false;
+	}
+	mData = static_cast<const unsigned char*>(data);
+	mSize = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+// Unmap the file
+void MappedFile::Close()
+{
+	if (mData != nullptr)  munmap(const_cast<unsigned char*>(mData), mSize);
+	if (mFile >= 0)        close(mFile);
+	mData = nullptr;
+	mFile = -1;
+	mSize = 0;
+}
+
+// Get the size and last modification time of a file
+bool GetFileSizeAndTime(const std::string& fileName, uint64_t& size, uint64_t& time)
+{
+	struct stat info;
+	if (stat(fileName.c_str(), &info) != 0)  return false;
+	size = static_cast<uint64_t>(info.st_size);
+	time = static_cast<uint64_t>(info.st_mtime);
+	return true;
+}
+
+#endif
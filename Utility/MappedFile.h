@@ -0,0 +1,63 @@
+//--------------------------------------------------------------------------------------
+// Mapped file - read-only view of a whole file in memory
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// The file is mapped into memory rather than read, so opening costs almost nothing and pages are only loaded from disk
+// (or the file cache) when touched. The data stays valid until the file is closed. Uses a Windows file mapping, or mmap
+// on other systems
+
+#ifndef _MAPPED_FILE_H_INCLUDED_
+#define _MAPPED_FILE_H_INCLUDED_
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+
+	// Prevent copying, the mapping belongs to one object
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+
+	// Map the given file, closing any already open. Returns false on failure, see LastError
+	bool Open(const std::string& fileName);
+
+	// Unmap the file. Pointers into the data are no longer valid
+	void Close();
+
+	// Start of the file's data, on a page boundary. nullptr if no file is open
+	const unsigned char* Data() { return mData; }
+
+	// Size of the file in bytes
+	size_t Size() { return mSize; }
+
+	// Description of the last error
+	const std::string& LastError() { return mLastError; }
+
+
+private:
+	const unsigned char* mData = nullptr;
+	size_t               mSize = 0;
+#ifdef _WIN32
+	void*                mFile = nullptr;    // Windows file handle
+	void*                mMapping = nullptr; // Windows file mapping handle
+#else
+	int                  mFile = -1;
+#endif
+	std::string          mLastError;
+};
+
+
+// Get the size and last modification time of a file (in seconds, only for comparing with other times from this function)
+// Returns false if the file doesn't exist
+bool GetFileSizeAndTime(const std::string& fileName, uint64_t& size, uint64_t& time);
+
+
+#endif //_MAPPED_FILE_H_INCLUDED_
@@ -0,0 +1,241 @@
+//--------------------------------------------------------------------------------------
+// Profiler - nestable timed zones on any thread, with statistics and Chrome trace export
+//--------------------------------------------------------------------------------------
+
+#include "Profiler.h"
+#include "Clock.h"
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Recording
+//--------------------------------------------------------------------------------------
+
+// One finished zone
+struct ZoneRecord
+{
+	const char* name;
+	const char* tags[2];
+	int64_t     start; // Nanoseconds
+	int64_t     end;
+	int         depth;
+};
+
+// The zones recorded by one thread. Only that thread writes to it
+struct ThreadZones
+{
+	int         id;
+	std::string name;
+	std::vector<ZoneRecord> zones;
+	std::atomic<uint64_t>   count{ 0 }; // Total zones recorded, the latest are at (count - 1) % size and before
+
+	// Visit the recorded zones, oldest first
+	template <typename Function>
+	void ForEach(Function function) const
+	{
+		uint64_t end = count.load(std::memory_order_acquire);
+		uint64_t begin = (end > zones.size()) ? end - zones.size() : 0;
+		for (uint64_t i = begin; i < end; ++i)  function(zones[i % zones.size()]);
+	}
+};
+
+// Every thread that has recorded a zone. Threads' records outlive them so they can still be reported
+static std::mutex gProfilerMutex;
+static std::vector<std::unique_ptr<ThreadZones>> gProfilerThreads;
+
+// This thread's records, and the number of zones open on it
+static thread_local ThreadZones* tThreadZones = nullptr;
+static thread_local int tZoneDepth = 0;
+
+
+static ThreadZones* CurrentThreadZones()
+{
+	if (tThreadZones == nullptr)
+	{
+		std::unique_ptr<ThreadZones> threadZones(new ThreadZones);
+		threadZones->zones.resize(PROFILER_ZONES_PER_THREAD);
+
+		std::lock_guard<std::mutex> lock(gProfilerMutex);
+		threadZones->id = static_cast<int>(gProfilerThreads.size());
+		threadZones->name = "Thread " + std::to_string(threadZones->id);
+		tThreadZones = threadZones.get();
+		gProfilerThreads.push_back(std::move(threadZones));
+	}
+	return tThreadZones;
+}
+
+
+ProfileZone::ProfileZone(const char* name, const char* tag1 /*= nullptr*/, const char* tag2 /*= nullptr*/)
+	: mName(name), mTags{ tag1, tag2 }
+{
+	++tZoneDepth;
+	mStart = ClockNanoseconds();
+}
+
+ProfileZone::~ProfileZone()
+{
+	int64_t end = ClockNanoseconds();
+	--tZoneDepth;
+
+	ThreadZones* threadZones = CurrentThreadZones();
+	uint64_t index = threadZones->count.load(std::memory_order_relaxed);
+	threadZones->zones[index % threadZones->zones.size()] = { mName, { mTags[0], mTags[1] }, mStart, end, tZoneDepth };
+	threadZones->count.store(index + 1, std::memory_order_release);
+}
+
+
+// Name the current thread in traces and reports, e.g. "Main". Threads are numbered otherwise
+void ProfilerSetThreadName(const std::string& name)
+{
+	ThreadZones* threadZones = CurrentThreadZones();
+	std::lock_guard<std::mutex> lock(gProfilerMutex);
+	threadZones->name = name;
+}
+
+// Forget all recorded zones
+void ProfilerClear()
+{
+	std::lock_guard<std::mutex> lock(gProfilerMutex);
+	for (auto& threadZones : gProfilerThreads)  threadZones->count.store(0, std::memory_order_release);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Reporting
+//--------------------------------------------------------------------------------------
+
+// Zone name followed by its tags, e.g. "ApplyPostProcess [Bloom, Fullscreen]"
+static std::string ZoneLabel(const ZoneRecord& zone)
+{
+	std::string label = zone.name;
+	if (zone.tags[0] != nullptr)
+	{
+		label += std::string(" [") + zone.tags[0];
+		if (zone.tags[1] != nullptr)  label += std::string(", ") + zone.tags[1];
+		label += "]";
+	}
+	return label;
+}
+
+
+// Statistics for each zone in the order they were first recorded on each thread
+std::vector<ProfileZoneStatistics> ProfilerStatistics()
+{
+	std::vector<ProfileZoneStatistics> statistics;
+
+	std::lock_guard<std::mutex> lock(gProfilerMutex);
+	for (auto& threadZones : gProfilerThreads)
+	{
+		// Zones are recorded as they end, so inner zones come before the zones they are in. List them by start time
+		// instead so each zone is followed by the zones nested in it
+		std::map<std::tuple<std::string, int>, size_t> zoneIndices;
+		std::vector<int64_t> firstStarts;
+		size_t firstZone = statistics.size();
+		threadZones->ForEach([&](const ZoneRecord& zone)
+		{
+			double ms = NanosecondsToSeconds(zone.end - zone.start) * 1000.0;
+			auto key = std::make_tuple(ZoneLabel(zone), zone.depth);
+			auto found = zoneIndices.find(key);
+			if (found == zoneIndices.end())
+			{
+				zoneIndices[key] = statistics.size();
+				statistics.push_back({ threadZones->name, std::get<0>(key), zone.depth, 1, ms, 0.0, ms, ms });
+				firstStarts.push_back(zone.start);
+				return;
+			}
+			ProfileZoneStatistics& zoneStatistics = statistics[found->second];
+			++zoneStatistics.count;
+			zoneStatistics.totalMs += ms;
+			zoneStatistics.minMs = std::min(zoneStatistics.minMs, ms);
+			zoneStatistics.maxMs = std::max(zoneStatistics.maxMs, ms);
+			firstStarts[found->second - firstZone] = std::min(firstStarts[found->second - firstZone], zone.start);
+		});
+
+		std::vector<size_t> order(statistics.size() - firstZone);
+		for (size_t i = 0; i < order.size(); ++i)  order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return firstStarts[a] < firstStarts[b]; });
+		std::vector<ProfileZoneStatistics> threadStatistics;
+		for (size_t i : order)  threadStatistics.push_back(statistics[firstZone + i]);
+		std::copy(threadStatistics.begin(), threadStatistics.end(), statistics.begin() + firstZone);
+	}
+
+	for (auto& zoneStatistics : statistics)  zoneStatistics.meanMs = zoneStatistics.totalMs / zoneStatistics.count;
+	return statistics;
+}
+
+
+// A table of the statistics, with nested zones indented under the zones they are in
+std::string ProfilerReport()
+{
+	std::vector<ProfileZoneStatistics> statistics = ProfilerStatistics();
+
+	size_t nameWidth = 4;
+	for (auto& zone : statistics)  nameWidth = std::max(nameWidth, zone.name.size() + 2 * zone.depth);
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3);
+	std::string thread;
+	for (auto& zone : statistics)
+	{
+		if (zone.thread != thread || thread.empty())
+		{
+			thread = zone.thread;
+			out << thread << "\n" << std::left << std::setw(nameWidth) << "Zone" << std::right << std::setw(8) << "Count"
+			    << std::setw(12) << "Total ms" << std::setw(10) << "Mean" << std::setw(10) << "Min" << std::setw(10) << "Max" << "\n";
+		}
+		out << std::left << std::setw(nameWidth) << std::string(2 * zone.depth, ' ') + zone.name << std::right
+		    << std::setw(8) << zone.count << std::setw(12) << zone.totalMs << std::setw(10) << zone.meanMs
+		    << std::setw(10) << zone.minMs << std::setw(10) << zone.maxMs << "\n";
+	}
+	return out.str();
+}
+
+
+// Quote a string for JSON
+static std::string JSONString(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')  quoted += '\\';
+		if (static_cast<unsigned char>(c) >= 0x20)  quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// Write the recorded zones as a Chrome trace event file. Returns false if the file can't be written
+bool ProfilerWriteChromeTrace(const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	// Complete ("X") events with times in microseconds, plus the name of each thread
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	std::lock_guard<std::mutex> lock(gProfilerMutex);
+	for (auto& threadZones : gProfilerThreads)
+	{
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadZones->id
+		     << ",\"args\":{\"name\":" << JSONString(threadZones->name) << "}}";
+		first = false;
+
+		threadZones->ForEach([&](const ZoneRecord& zone)
+		{
+			file << ",\n{\"name\":" << JSONString(ZoneLabel(zone)) << ",\"cat\":" << JSONString(zone.name)
+			     << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadZones->id
+			     << ",\"ts\":" << zone.start / 1000.0 << ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+		});
+	}
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
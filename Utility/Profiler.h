@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------
+// Profiler - nestable timed zones on any thread, with statistics and Chrome trace export
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Time a block of code by putting a zone at the top of it, the zone ends when the block does:
+//     void RenderScene()
+//     {
+//         PROFILE_ZONE("RenderScene");
+//         ...
+// Zones can be nested and given up to two tags to tell calls apart, e.g. the type and mode of a post-process. Names and
+// tags must be string literals or other strings that live for the whole program, as only the pointers are stored.
+//
+// Each thread records its zones into its own ring buffer, so timing a zone is two clock reads and a store with no
+// locking. Once a buffer is full the oldest zones are overwritten, the statistics and trace cover the most recent ones.
+// Read them with ProfilerStatistics / ProfilerReport or write a trace with ProfilerWriteChromeTrace, which can be opened
+// in chrome://tracing or https://ui.perfetto.dev. Only read them while no other thread is timing zones
+//
+// Times are from the portable clock in Clock.h
+
+#ifndef _PROFILER_H_INCLUDED_
+#define _PROFILER_H_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// Number of zones each thread keeps
+const int PROFILER_ZONES_PER_THREAD = 1 << 16;
+
+
+// Times the block it is declared in, use PROFILE_ZONE rather than declaring one directly
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name, const char* tag1 = nullptr, const char* tag2 = nullptr);
+	~ProfileZone();
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* mName;
+	const char* mTags[2];
+	int64_t     mStart;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b)       PROFILE_CONCAT_INNER(a, b)
+
+// Time the rest of the current block: PROFILE_ZONE(name), PROFILE_ZONE(name, tag) or PROFILE_ZONE(name, tag1, tag2)
+#define PROFILE_ZONE(...)  ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(__VA_ARGS__)
+
+
+// Name the current thread in traces and reports, e.g. "Main". Threads are numbered otherwise
+void ProfilerSetThreadName(const std::string& name);
+
+// Forget all recorded zones
+void ProfilerClear();
+
+
+// Timings for all the recorded zones with the same thread, name, tags and nesting depth
+struct ProfileZoneStatistics
+{
+	std::string thread;
+	std::string name;  // Zone name followed by its tags, e.g. "ApplyPostProcess [Bloom, Fullscreen]"
+	int         depth; // Number of zones this one is nested in
+
+	int    count;
+	double totalMs;
+	double meanMs;
+	double minMs;
+	double maxMs;
+};
+
+// Statistics for each zone in the order they were first recorded on each thread
+std::vector<ProfileZoneStatistics> ProfilerStatistics();
+
+// A table of the statistics, with nested zones indented under the zones they are in
+std::string ProfilerReport();
+
+// Write the recorded zones as a Chrome trace event file. Returns false if the file can't be written
+bool ProfilerWriteChromeTrace(const std::string& fileName);
+
+
+#endif //_PROFILER_H_INCLUDED_
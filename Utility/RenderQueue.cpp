@@ -0,0 +1,180 @@
+//--------------------------------------------------------------------------------------
+// Render queue - orders the draws of a frame by a 64-bit sort key
+//--------------------------------------------------------------------------------------
+
+#include "RenderQueue.h"
+
+#include <utility>
+#include <cstring>
+
+
+// Name of a pass, used for reports and log output
+const char* RenderPassName(RenderPass pass)
+{
+	switch (pass)
+	{
+	case RenderPass::Opaque:  return "Opaque";
+	case RenderPass::Sky:     return "Sky";
+	case RenderPass::Blended: return "Blended";
+	}
+	return "Unknown";
+}
+
+
+//--------------------------------------------------------------------------------------
+// Keys
+//--------------------------------------------------------------------------------------
+
+static const int PASS_SHIFT = 62;
+
+// Position of each field in a key, see the layout in RenderQueue.h
+struct SortKeyLayout
+{
+	int shaderShift;
+	int textureShift;
+	int meshShift;
+	int depthShift;
+};
+
+static const SortKeyLayout STATE_FIRST_LAYOUT = { 52, 38, 24, 0 };
+static const SortKeyLayout DEPTH_FIRST_LAYOUT = { 28, 14, 0, 38 };
+
+static const SortKeyLayout& Layout(RenderPass pass)
+{
+	return pass == RenderPass::Blended ? DEPTH_FIRST_LAYOUT : STATE_FIRST_LAYOUT;
+}
+
+static uint64_t FieldMask(int bits)
+{
+	return (uint64_t(1) << bits) - 1;
+}
+
+
+// Make the key for a draw
+uint64_t MakeSortKey(RenderPass pass, int shader, int texture, int mesh, float depth)
+{
+	// The bits of a float that is not negative sort in the same order as its value, so its top bits are a depth with
+	// the most precision close to the camera
+	uint32_t depthBits = 0;
+	if (depth > 0)  memcpy(&depthBits, &depth, sizeof(depthBits));
+	uint64_t depthKey = depthBits >> (31 - SORT_KEY_DEPTH_BITS);
+	if (pass == RenderPass::Blended)  depthKey = FieldMask(SORT_KEY_DEPTH_BITS) - depthKey; // Far to near
+
+	const SortKeyLayout& layout = Layout(pass);
+	return (static_cast<uint64_t>(pass) << PASS_SHIFT) |
+	       ((static_cast<uint64_t>(shader)  & FieldMask(SORT_KEY_SHADER_BITS))  << layout.shaderShift) |
+	       ((static_cast<uint64_t>(texture) & FieldMask(SORT_KEY_TEXTURE_BITS)) << layout.textureShift) |
+	       ((static_cast<uint64_t>(mesh)    & FieldMask(SORT_KEY_MESH_BITS))    << layout.meshShift) |
+	       (depthKey << layout.depthShift);
+}
+
+
+// Fields of a key
+
+RenderPass SortKeyPass(uint64_t key)
+{
+	return static_cast<RenderPass>(key >> PASS_SHIFT);
+}
+
+int SortKeyShader(uint64_t key)
+{
+	return static_cast<int>((key >> Layout(SortKeyPass(key)).shaderShift) & FieldMask(SORT_KEY_SHADER_BITS));
+}
+
+int SortKeyTexture(uint64_t key)
+{
+	return static_cast<int>((key >> Layout(SortKeyPass(key)).textureShift) & FieldMask(SORT_KEY_TEXTURE_BITS));
+}
+
+int SortKeyMesh(uint64_t key)
+{
+	return static_cast<int>((key >> Layout(SortKeyPass(key)).meshShift) & FieldMask(SORT_KEY_MESH_BITS));
+}
+
+
+int SortKeyIds::Id(const void* object)
+{
+	auto found = mIds.find(object);
+	if (found != mIds.end())  return found->second;
+
+	int id = static_cast<int>(mIds.size());
+	mIds[object] = id;
+	return id;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Queue
+//--------------------------------------------------------------------------------------
+
+// Below this many items clearing and reading the byte counts takes longer than an insertion sort
+static const size_t RADIX_SORT_MIN_ITEMS = 64;
+
+// Sort items by key with a least significant byte first radix sort
+void RadixSortItems(RenderQueueItem* items, RenderQueueItem* scratch, size_t count)
+{
+	if (count < RADIX_SORT_MIN_ITEMS)
+	{
+		for (size_t i = 1; i < count; ++i)
+		{
+			RenderQueueItem item = items[i];
+			size_t j = i;
+			for (; j > 0 && items[j - 1].key > item.key; --j)  items[j] = items[j - 1];
+			items[j] = item;
+		}
+		return;
+	}
+
+	// Count every byte of every key in one read of the items
+	uint32_t counts[8][256] = {};
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = items[i].key;
+		for (int byte = 0; byte < 8; ++byte)  ++counts[byte][(key >> (byte * 8)) & 0xff];
+	}
+
+	RenderQueueItem* source = items;
+	RenderQueueItem* target = scratch;
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		// A byte that is the same in every key doesn't change the order
+		uint32_t* byteCounts = counts[byte];
+		if (byteCounts[(source[0].key >> (byte * 8)) & 0xff] == count)  continue;
+
+		uint32_t offsets[256];
+		uint32_t offset = 0;
+		for (int value = 0; value < 256; ++value)
+		{
+			offsets[value] = offset;
+			offset += byteCounts[value];
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			target[offsets[(source[i].key >> (byte * 8)) & 0xff]++] = source[i];
+		}
+		std::swap(source, target);
+	}
+
+	if (source != items)  memcpy(items, source, count * sizeof(RenderQueueItem));
+}
+
+
+// Sort the draws by key
+void RenderQueue::Sort()
+{
+	mScratch.resize(mItems.size());
+	RadixSortItems(mItems.data(), mScratch.data(), mItems.size());
+}
+
+
+// Times a field of the key or the pass changes from one draw to the next, counting the first draw
+int RenderQueue::StateChanges(int (*field)(uint64_t key)) const
+{
+	int changes = 0;
+	for (size_t i = 0; i < mItems.size(); ++i)
+	{
+		uint64_t key = mItems[i].key;
+		if (i == 0 || SortKeyPass(key) != SortKeyPass(mItems[i - 1].key) || field(key) != field(mItems[i - 1].key))  ++changes;
+	}
+	return changes;
+}
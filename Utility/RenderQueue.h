@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------
+// Render queue - orders the draws of a frame by a 64-bit sort key
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each draw is added with a key made from its pass, shader, texture, mesh and depth, and the index of the draw in the
+// caller's own list. Sorting the keys groups draws that use the same state so it only has to be bound once per group,
+// and within a group puts opaque draws front to back so the depth buffer rejects hidden pixels early. Blended draws are
+// ordered back to front first, as they must be to blend correctly, then by state.
+//
+// Key layout, most significant bits first:
+//   Opaque and Sky: pass (2) | shader (10) | texture (14) | mesh (14) | depth near to far (24)
+//   Blended:        pass (2) | depth far to near (24) | shader (10) | texture (14) | mesh (14)
+// Shader, texture and mesh are small ids, e.g. from SortKeyIds. Depth is the top bits of the float, so any distance
+// from the camera can be used without a range. The keys are sorted with a radix sort, a pass for each byte that
+// differs between the keys, so sorting takes the same time however the draws were added.
+
+#ifndef _RENDER_QUEUE_H_INCLUDED_
+#define _RENDER_QUEUE_H_INCLUDED_
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+
+// Passes of a frame, in the order they are drawn
+enum class RenderPass
+{
+	Opaque,  // Front to back within each state
+	Sky,     // After the opaque draws, so only the pixels they don't cover are drawn
+	Blended, // Back to front
+};
+
+// Name of a pass, used for reports and log output
+const char* RenderPassName(RenderPass pass);
+
+
+// Sizes of the id fields of a key, ids too large for their field are wrapped, which only loses grouping
+const int SORT_KEY_SHADER_BITS  = 10;
+const int SORT_KEY_TEXTURE_BITS = 14;
+const int SORT_KEY_MESH_BITS    = 14;
+const int SORT_KEY_DEPTH_BITS   = 24;
+
+// Make the key for a draw. Depth is the distance from the camera, negative distances are treated as 0
+uint64_t MakeSortKey(RenderPass pass, int shader, int texture, int mesh, float depth);
+
+// Fields of a key
+RenderPass SortKeyPass(uint64_t key);
+int        SortKeyShader(uint64_t key);
+int        SortKeyTexture(uint64_t key);
+int        SortKeyMesh(uint64_t key);
+
+
+// Gives each object a small id for the keys, the first object seen is 0, the next 1 and so on. Ids are kept for the
+// life of the SortKeyIds so keys stay the same from frame to frame
+class SortKeyIds
+{
+public:
+	int Id(const void* object);
+	int NumIds() const { return static_cast<int>(mIds.size()); }
+
+private:
+	std::unordered_map<const void*, int> mIds;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Queue
+//--------------------------------------------------------------------------------------
+
+// A draw in a queue, the index of the draw in the caller's list with its key
+struct RenderQueueItem
+{
+	uint64_t key;
+	uint32_t draw;
+};
+
+// Sort items by key with a least significant byte first radix sort. Keeps the order of items with equal keys. Skips
+// the bytes that are the same in every key, and uses an insertion sort for a few items. Scratch must hold count items,
+// the result is left in items
+void RadixSortItems(RenderQueueItem* items, RenderQueueItem* scratch, size_t count);
+
+
+class RenderQueue
+{
+public:
+	// Remove all the draws, keeping the memory for the next frame
+	void Clear() { mItems.clear(); }
+
+	// Add a draw, an index into the caller's own list of draws
+	void Add(uint64_t key, uint32_t draw) { mItems.push_back({ key, draw }); }
+
+	// Sort the draws by key, draws with equal keys stay in the order they were added
+	void Sort();
+
+	size_t                 Size()  const { return mItems.size(); }
+	const RenderQueueItem* begin() const { return mItems.data(); }
+	const RenderQueueItem* end()   const { return mItems.data() + mItems.size(); }
+	const RenderQueueItem& operator[](size_t i) const { return mItems[i]; }
+
+	// Times a field of the key (e.g. SortKeyTexture) or the pass changes from one draw to the next, counting the first
+	// draw, i.e. how many times that state is bound if it is only bound when it changes. Works on sorted or unsorted draws
+	int StateChanges(int (*field)(uint64_t key)) const;
+
+private:
+	std::vector<RenderQueueItem> mItems;
+	std::vector<RenderQueueItem> mScratch;
+};
+
+
+#endif //_RENDER_QUEUE_H_INCLUDED_
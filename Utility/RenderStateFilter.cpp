@@ -0,0 +1,304 @@
+//--------------------------------------------------------------------------------------
+// Render state filter - drops calls that bind what is already bound
+//--------------------------------------------------------------------------------------
+
+#include "RenderStateFilter.h"
+
+#include <algorithm>
+
+
+// Name of a kind of call, used for reports and log output
+const char* StateCallName(StateCall call)
+{
+	switch (call)
+	{
+	case StateCall::RenderTarget:      return "RenderTarget";
+	case StateCall::ShaderResource:    return "ShaderResource";
+	case StateCall::Sampler:           return "Sampler";
+	case StateCall::ConstantBuffer:    return "ConstantBuffer";
+	case StateCall::VertexShader:      return "VertexShader";
+	case StateCall::GeometryShader:    return "GeometryShader";
+	case StateCall::PixelShader:       return "PixelShader";
+	case StateCall::BlendState:        return "BlendState";
+	case StateCall::DepthStencilState: return "DepthStencilState";
+	case StateCall::RasterizerState:   return "RasterizerState";
+	case StateCall::InputLayout:       return "InputLayout";
+	case StateCall::Topology:          return "Topology";
+	}
+	return "Unknown";
+}
+
+
+bool operator==(const RenderStateBindings& a, const RenderStateBindings& b)
+{
+	return a.renderTarget == b.renderTarget && a.depthStencil == b.depthStencil &&
+	       std::equal(a.shaderResources, a.shaderResources + STATE_SHADER_RESOURCE_SLOTS, b.shaderResources) &&
+	       std::equal(a.samplers, a.samplers + STATE_SAMPLER_SLOTS, b.samplers) &&
+	       std::equal(a.constantBuffers[0], a.constantBuffers[0] + STATE_CONSTANT_BUFFER_SLOTS, b.constantBuffers[0]) &&
+	       std::equal(a.constantBuffers[1], a.constantBuffers[1] + STATE_CONSTANT_BUFFER_SLOTS, b.constantBuffers[1]) &&
+	       a.vertexShader == b.vertexShader && a.geometryShader == b.geometryShader && a.pixelShader == b.pixelShader &&
+	       a.blendState == b.blendState && a.depthStencilState == b.depthStencilState &&
+	       a.rasterizerState == b.rasterizerState && a.inputLayout == b.inputLayout && a.topology == b.topology;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Filter
+//--------------------------------------------------------------------------------------
+
+RenderStateFilter::RenderStateFilter(RenderStateBackend* backend) : mBackend(backend) {}
+
+
+// Bind something, only calling the backend if it is not already bound
+
+void RenderStateFilter::SetRenderTarget(void* renderTarget, void* depthStencil)
+{
+	bool changed = !mRenderTarget.known || mRenderTarget.value != renderTarget ||
+	               !mDepthStencil.known || mDepthStencil.value != depthStencil;
+	Count(StateCall::RenderTarget, changed);
+	if (!changed)  return;
+
+	mRenderTarget = { renderTarget, true };
+	mDepthStencil = { depthStencil, true };
+	mBackend->SetRenderTarget(renderTarget, depthStencil);
+
+	// The device may have unbound views of the new target, which can't be told apart from other views
+	for (auto& shaderResource : mShaderResources)  shaderResource.known = false;
+}
+
+void RenderStateFilter::SetShaderResource(int slot, void* shaderResource)
+{
+	if (slot < 0 || slot >= STATE_SHADER_RESOURCE_SLOTS)
+	{
+		Count(StateCall::ShaderResource, true);
+		mBackend->SetShaderResource(slot, shaderResource);
+	}
+	else if (Change(mShaderResources[slot], shaderResource, StateCall::ShaderResource))
+	{
+		mBackend->SetShaderResource(slot, shaderResource);
+	}
+}
+
+void RenderStateFilter::SetSampler(int slot, void* sampler)
+{
+	if (slot < 0 || slot >= STATE_SAMPLER_SLOTS)
+	{
+		Count(StateCall::Sampler, true);
+		mBackend->SetSampler(slot, sampler);
+	}
+	else if (Change(mSamplers[slot], sampler, StateCall::Sampler))
+	{
+		mBackend->SetSampler(slot, sampler);
+	}
+}
+
+void RenderStateFilter::SetConstantBuffer(ShaderStage stage, int slot, void* buffer)
+{
+	if (slot < 0 || slot >= STATE_CONSTANT_BUFFER_SLOTS)
+	{
+		Count(StateCall::ConstantBuffer, true);
+		mBackend->SetConstantBuffer(stage, slot, buffer);
+	}
+	else if (Change(mConstantBuffers[static_cast<int>(stage)][slot], buffer, StateCall::ConstantBuffer))
+	{
+		mBackend->SetConstantBuffer(stage, slot, buffer);
+	}
+}
+
+void RenderStateFilter::SetVertexShader(void* shader)
+{
+	if (Change(mVertexShader, shader, StateCall::VertexShader))  mBackend->SetVertexShader(shader);
+}
+
+void RenderStateFilter::SetGeometryShader(void* shader)
+{
+	if (Change(mGeometryShader, shader, StateCall::GeometryShader))  mBackend->SetGeometryShader(shader);
+}
+
+void RenderStateFilter::SetPixelShader(void* shader)
+{
+	if (Change(mPixelShader, shader, StateCall::PixelShader))  mBackend->SetPixelShader(shader);
+}
+
+void RenderStateFilter::SetBlendState(void* state)
+{
+	if (Change(mBlendState, state, StateCall::BlendState))  mBackend->SetBlendState(state);
+}
+
+void RenderStateFilter::SetDepthStencilState(void* state)
+{
+	if (Change(mDepthStencilState, state, StateCall::DepthStencilState))  mBackend->SetDepthStencilState(state);
+}
+
+void RenderStateFilter::SetRasterizerState(void* state)
+{
+	if (Change(mRasterizerState, state, StateCall::RasterizerState))  mBackend->SetRasterizerState(state);
+}
+
+void RenderStateFilter::SetInputLayout(void* layout)
+{
+	if (Change(mInputLayout, layout, StateCall::InputLayout))  mBackend->SetInputLayout(layout);
+}
+
+void RenderStateFilter::SetTopology(int topology)
+{
+	bool changed = !mTopologyKnown || mTopology != topology;
+	Count(StateCall::Topology, changed);
+	if (!changed)  return;
+
+	mTopology = topology;
+	mTopologyKnown = true;
+	mBackend->SetTopology(topology);
+}
+
+
+// Forget everything bound, so the next call of each kind is passed on
+void RenderStateFilter::Invalidate()
+{
+	mRenderTarget.known = false;
+	mDepthStencil.known = false;
+	for (auto& shaderResource : mShaderResources)  shaderResource.known = false;
+	for (auto& sampler : mSamplers)  sampler.known = false;
+	for (auto& stage : mConstantBuffers)
+	{
+		for (auto& buffer : stage)  buffer.known = false;
+	}
+	mVertexShader.known      = false;
+	mGeometryShader.known    = false;
+	mPixelShader.known       = false;
+	mBlendState.known        = false;
+	mDepthStencilState.known = false;
+	mRasterizerState.known   = false;
+	mInputLayout.known       = false;
+	mTopologyKnown           = false;
+}
+
+
+// Call at the end of each frame to update the stats
+void RenderStateFilter::EndFrame()
+{
+	mStats.issued  = mFrameStats.issued;
+	mStats.skipped = mFrameStats.skipped;
+	std::copy(mFrameStats.issuedByCall,  mFrameStats.issuedByCall  + NUM_STATE_CALLS, mStats.issuedByCall);
+	std::copy(mFrameStats.skippedByCall, mFrameStats.skippedByCall + NUM_STATE_CALLS, mStats.skippedByCall);
+	mStats.totalIssued  += mFrameStats.issued;
+	mStats.totalSkipped += mFrameStats.skipped;
+	++mStats.numFrames;
+
+	mFrameStats = StateFilterStats();
+}
+
+// Restart the totals from now
+void RenderStateFilter::ResetStats()
+{
+	mStats.totalIssued  = 0;
+	mStats.totalSkipped = 0;
+	mStats.numFrames    = 0;
+}
+
+
+// Record a binding, returns true if it changed and the call must be made. Counts the call either way
+bool RenderStateFilter::Change(Binding& binding, void* value, StateCall call)
+{
+	bool changed = !binding.known || binding.value != value;
+	Count(call, changed);
+	if (changed)  binding = { value, true };
+	return changed;
+}
+
+void RenderStateFilter::Count(StateCall call, bool issued)
+{
+	if (issued)
+	{
+		++mFrameStats.issued;
+		++mFrameStats.issuedByCall[static_cast<int>(call)];
+	}
+	else
+	{
+		++mFrameStats.skipped;
+		++mFrameStats.skippedByCall[static_cast<int>(call)];
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Recording backend
+//--------------------------------------------------------------------------------------
+
+void RecordingStateBackend::SetRenderTarget(void* renderTarget, void* depthStencil)
+{
+	Record(StateCall::RenderTarget, ShaderStage::Pixel, 0, renderTarget, depthStencil);
+	mBindings.renderTarget = renderTarget;
+	mBindings.depthStencil = depthStencil;
+}
+
+void RecordingStateBackend::SetShaderResource(int slot, void* shaderResource)
+{
+	Record(StateCall::ShaderResource, ShaderStage::Pixel, slot, shaderResource);
+	if (slot >= 0 && slot < STATE_SHADER_RESOURCE_SLOTS)  mBindings.shaderResources[slot] = shaderResource;
+}
+
+void RecordingStateBackend::SetSampler(int slot, void* sampler)
+{
+	Record(StateCall::Sampler, ShaderStage::Pixel, slot, sampler);
+	if (slot >= 0 && slot < STATE_SAMPLER_SLOTS)  mBindings.samplers[slot] = sampler;
+}
+
+void RecordingStateBackend::SetConstantBuffer(ShaderStage stage, int slot, void* buffer)
+{
+	Record(StateCall::ConstantBuffer, stage, slot, buffer);
+	if (slot >= 0 && slot < STATE_CONSTANT_BUFFER_SLOTS)  mBindings.constantBuffers[static_cast<int>(stage)][slot] = buffer;
+}
+
+void RecordingStateBackend::SetVertexShader(void* shader)
+{
+	Record(StateCall::VertexShader, ShaderStage::Vertex, 0, shader);
+	mBindings.vertexShader = shader;
+}
+
+void RecordingStateBackend::SetGeometryShader(void* shader)
+{
+	Record(StateCall::GeometryShader, ShaderStage::Vertex, 0, shader);
+	mBindings.geometryShader = shader;
+}
+
+void RecordingStateBackend::SetPixelShader(void* shader)
+{
+	Record(StateCall::PixelShader, ShaderStage::Pixel, 0, shader);
+	mBindings.pixelShader = shader;
+}
+
+void RecordingStateBackend::SetBlendState(void* state)
+{
+	Record(StateCall::BlendState, ShaderStage::Pixel, 0, state);
+	mBindings.blendState = state;
+}
+
+void RecordingStateBackend::SetDepthStencilState(void* state)
+{
+	Record(StateCall::DepthStencilState, ShaderStage::Pixel, 0, state);
+	mBindings.depthStencilState = state;
+}
+
+void RecordingStateBackend::SetRasterizerState(void* state)
+{
+	Record(StateCall::RasterizerState, ShaderStage::Pixel, 0, state);
+	mBindings.rasterizerState = state;
+}
+
+void RecordingStateBackend::SetInputLayout(void* layout)
+{
+	Record(StateCall::InputLayout, ShaderStage::Vertex, 0, layout);
+	mBindings.inputLayout = layout;
+}
+
+void RecordingStateBackend::SetTopology(int topology)
+{
+	Record(StateCall::Topology, ShaderStage::Vertex, 0, nullptr, nullptr, topology);
+	mBindings.topology = topology;
+}
+
+void RecordingStateBackend::Record(StateCall call, ShaderStage stage, int slot, void* value, void* value2, int topology)
+{
+	mCalls.push_back({ call, stage, slot, value, value2, topology });
+}
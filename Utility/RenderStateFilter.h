@@ -0,0 +1,243 @@
+//--------------------------------------------------------------------------------------
+// Render state filter - drops calls that bind what is already bound
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each post-processing pass sets its render target, textures, samplers, shaders, states, input layout and topology,
+// though most of them are the same as the pass before. RenderStateFilter keeps what it last bound for each and only
+// passes a call on to the device when the value differs, counting the calls issued and skipped.
+//
+// Handles are the device's own object pointers, the filter only compares them. It can only know what is bound if every
+// binding goes through it, so call Invalidate after any code that binds things directly (e.g. model rendering). Direct3D
+// unbinds a texture's shader resource views when the texture becomes a render target, and the filter can't tell which
+// views belong to which texture, so a change of render target forgets the shader resources bound.
+//
+// The calls are made by a backend - Scene.cpp calls the Direct3D context, RecordingStateBackend below records the calls
+// and what they leave bound so the filtering can be checked without a GPU
+
+#ifndef _RENDER_STATE_FILTER_H_INCLUDED_
+#define _RENDER_STATE_FILTER_H_INCLUDED_
+
+#include <vector>
+
+
+// Kinds of binding call
+enum class StateCall
+{
+	RenderTarget,     // Render target and depth buffer, together as in OMSetRenderTargets
+	ShaderResource,   // Pixel shader texture
+	Sampler,          // Pixel shader sampler
+	ConstantBuffer,   // Vertex or pixel shader constant buffer
+	VertexShader,
+	GeometryShader,
+	PixelShader,
+	BlendState,
+	DepthStencilState,
+	RasterizerState,
+	InputLayout,
+	Topology,
+};
+const int NUM_STATE_CALLS = static_cast<int>(StateCall::Topology) + 1;
+
+// Name of a kind of call, used for reports and log output
+const char* StateCallName(StateCall call);
+
+
+// Shader stages that constant buffers are bound to
+enum class ShaderStage
+{
+	Vertex,
+	Pixel,
+};
+
+// Slots the filter tracks, calls for higher slots are always passed on
+const int STATE_SHADER_RESOURCE_SLOTS = 8;
+const int STATE_SAMPLER_SLOTS         = 4;
+const int STATE_CONSTANT_BUFFER_SLOTS = 14;
+
+
+// What is bound on a device. Handles are nullptr and topology 0 (undefined) when nothing has been bound
+struct RenderStateBindings
+{
+	void* renderTarget = nullptr;
+	void* depthStencil = nullptr;
+	void* shaderResources[STATE_SHADER_RESOURCE_SLOTS] = {};
+	void* samplers[STATE_SAMPLER_SLOTS] = {};
+	void* constantBuffers[2][STATE_CONSTANT_BUFFER_SLOTS] = {}; // Indexed by ShaderStage
+	void* vertexShader      = nullptr;
+	void* geometryShader    = nullptr;
+	void* pixelShader       = nullptr;
+	void* blendState        = nullptr;
+	void* depthStencilState = nullptr;
+	void* rasterizerState   = nullptr;
+	void* inputLayout       = nullptr;
+	int   topology          = 0;
+};
+
+bool operator==(const RenderStateBindings& a, const RenderStateBindings& b);
+inline bool operator!=(const RenderStateBindings& a, const RenderStateBindings& b) { return !(a == b); }
+
+
+//--------------------------------------------------------------------------------------
+// Backend
+//--------------------------------------------------------------------------------------
+
+// Makes the binding calls the filter lets through. Blend states are set with no blend factor and all samples, depth
+// stencil states with a stencil reference of 0
+class RenderStateBackend
+{
+public:
+	virtual ~RenderStateBackend() {}
+
+	virtual void SetRenderTarget(void* renderTarget, void* depthStencil) = 0;
+	virtual void SetShaderResource(int slot, void* shaderResource) = 0;
+	virtual void SetSampler(int slot, void* sampler) = 0;
+	virtual void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) = 0;
+	virtual void SetVertexShader(void* shader) = 0;
+	virtual void SetGeometryShader(void* shader) = 0;
+	virtual void SetPixelShader(void* shader) = 0;
+	virtual void SetBlendState(void* state) = 0;
+	virtual void SetDepthStencilState(void* state) = 0;
+	virtual void SetRasterizerState(void* state) = 0;
+	virtual void SetInputLayout(void* layout) = 0;
+	virtual void SetTopology(int topology) = 0;
+};
+
+
+// Calls made through a filter
+struct StateFilterStats
+{
+	int issued  = 0; // Calls passed on to the device in the last frame
+	int skipped = 0; // Calls dropped in the last frame as they bound what was already bound
+	int issuedByCall[NUM_STATE_CALLS]  = {}; // As above for each kind of call
+	int skippedByCall[NUM_STATE_CALLS] = {};
+
+	long long totalIssued  = 0; // As above, over all frames counted
+	long long totalSkipped = 0;
+	int       numFrames    = 0;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Filter
+//--------------------------------------------------------------------------------------
+
+// A backend itself, so code can bind through a filter or straight to a backend alike
+class RenderStateFilter : public RenderStateBackend
+{
+public:
+	// The backend must stay valid for the life of the filter. Nothing is known to be bound until the first call of each
+	// kind, which is always passed on
+	RenderStateFilter(RenderStateBackend* backend);
+
+	// Bind something, only calling the backend if it is not already bound
+	void SetRenderTarget(void* renderTarget, void* depthStencil) override;
+	void SetShaderResource(int slot, void* shaderResource) override;
+	void SetSampler(int slot, void* sampler) override;
+	void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) override;
+	void SetVertexShader(void* shader) override;
+	void SetGeometryShader(void* shader) override;
+	void SetPixelShader(void* shader) override;
+	void SetBlendState(void* state) override;
+	void SetDepthStencilState(void* state) override;
+	void SetRasterizerState(void* state) override;
+	void SetInputLayout(void* layout) override;
+	void SetTopology(int topology) override;
+
+	// Forget everything bound, so the next call of each kind is passed on. Call after binding anything directly
+	void Invalidate();
+
+	// Call at the end of each frame to update the stats
+	void EndFrame();
+
+	// Calls made through the filter
+	const StateFilterStats& Stats() const { return mStats; }
+
+	// Restart the totals from now
+	void ResetStats();
+
+
+private:
+	// A bound handle, or not known
+	struct Binding
+	{
+		void* value = nullptr;
+		bool  known = false;
+	};
+
+	// Record a binding, returns true if it changed and the call must be made. Counts the call either way
+	bool Change(Binding& binding, void* value, StateCall call);
+	void Count(StateCall call, bool issued);
+
+	RenderStateBackend* mBackend;
+
+	Binding mRenderTarget;
+	Binding mDepthStencil;
+	Binding mShaderResources[STATE_SHADER_RESOURCE_SLOTS];
+	Binding mSamplers[STATE_SAMPLER_SLOTS];
+	Binding mConstantBuffers[2][STATE_CONSTANT_BUFFER_SLOTS];
+	Binding mVertexShader;
+	Binding mGeometryShader;
+	Binding mPixelShader;
+	Binding mBlendState;
+	Binding mDepthStencilState;
+	Binding mRasterizerState;
+	Binding mInputLayout;
+	int     mTopology = 0;
+	bool    mTopologyKnown = false;
+
+	StateFilterStats mFrameStats; // Counts for the frame in progress
+	StateFilterStats mStats;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Recording backend
+//--------------------------------------------------------------------------------------
+
+// A call made to a backend. value2 is the depth buffer of a render target call, slot and stage are only used by
+// shader resource, sampler and constant buffer calls, topology by topology calls
+struct RecordedStateCall
+{
+	StateCall   call;
+	ShaderStage stage;
+	int         slot;
+	void*       value;
+	void*       value2;
+	int         topology;
+};
+
+// Backend that records each call and keeps what the calls leave bound, to check a filter without a GPU
+class RecordingStateBackend : public RenderStateBackend
+{
+public:
+	void SetRenderTarget(void* renderTarget, void* depthStencil) override;
+	void SetShaderResource(int slot, void* shaderResource) override;
+	void SetSampler(int slot, void* sampler) override;
+	void SetConstantBuffer(ShaderStage stage, int slot, void* buffer) override;
+	void SetVertexShader(void* shader) override;
+	void SetGeometryShader(void* shader) override;
+	void SetPixelShader(void* shader) override;
+	void SetBlendState(void* state) override;
+	void SetDepthStencilState(void* state) override;
+	void SetRasterizerState(void* state) override;
+	void SetInputLayout(void* layout) override;
+	void SetTopology(int topology) override;
+
+	// Calls made so far, in order
+	const std::vector<RecordedStateCall>& Calls() const { return mCalls; }
+	void ClearCalls() { mCalls.clear(); }
+
+	// What the calls have left bound. Non-const so a device's own changes can be copied, e.g. unbinding a shader
+	// resource when its texture becomes a render target
+	RenderStateBindings& Bindings() { return mBindings; }
+
+private:
+	void Record(StateCall call, ShaderStage stage, int slot, void* value, void* value2 = nullptr, int topology = 0);
+
+	std::vector<RecordedStateCall> mCalls;
+	RenderStateBindings            mBindings;
+};
+
+
+#endif //_RENDER_STATE_FILTER_H_INCLUDED_
@@ -0,0 +1,486 @@
+//--------------------------------------------------------------------------------------
+// Thread pool - work-stealing task scheduler that splits work across all cores
+//--------------------------------------------------------------------------------------
+
+#include "ThreadPool.h"
+#include "Clock.h"
+
+#include <deque>
+#include <sstream>
+#include <iomanip>
+
+
+//--------------------------------------------------------------------------------------
+// Internal types
+//--------------------------------------------------------------------------------------
+
+struct ThreadPoolTask
+{
+	std::function<void()> function;
+	TaskAffinity          affinity;
+
+	// Dependencies still to finish, plus one while the task is being submitted. Queued when it reaches 0
+	std::atomic<int> unfinishedDependencies;
+
+	// Tasks that depend on this one, queued as it finishes. Protected by mutex along with done
+	std::mutex              mutex;
+	std::vector<TaskHandle> dependents;
+	std::atomic<bool>       done;
+};
+
+// Queue and counters for one thread. Each is allocated separately so threads don't share cache lines
+struct ThreadPool::ThreadData
+{
+	std::mutex             mutex;
+	std::deque<TaskHandle> tasks;           // Owner works from the back, thieves take from the front
+	std::deque<TaskHandle> mainThreadTasks; // MainThread tasks, only used for the main thread
+
+	std::atomic<uint64_t> tasksRun;
+	std::atomic<uint64_t> tasksStolen;
+	std::atomic<int64_t>  busyNanoseconds;
+
+	ThreadData() : tasksRun(0), tasksStolen(0), busyNanoseconds(0) {}
+};
+
+// A ParallelFor in progress, lives on the stack of the thread that called it
+struct ThreadPool::ParallelForJob
+{
+	const std::function<void(int, int)>* function;
+	int              grainSize;
+	std::atomic<int> remaining; // Items not yet processed, the call returns when this reaches 0
+};
+
+
+// Pool and index of the current thread if it is a worker
+static thread_local const ThreadPool* tWorkerPool = nullptr;
+static thread_local int               tWorkerIndex = -1;
+
+// Tasks (or ParallelFor ranges) running on this thread, one inside another when a task waits. Only the outermost is
+// timed so waiting tasks aren't counted twice
+static thread_local int tRunDepth = 0;
+
+// Cheap random numbers for choosing which thread to steal from
+static thread_local uint32_t tStealRandom = 0;
+
+static uint32_t NextStealRandom()
+{
+	if (tStealRandom == 0)  tStealRandom = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+	tStealRandom ^= tStealRandom << 13;
+	tStealRandom ^= tStealRandom >> 17;
+	tStealRandom ^= tStealRandom << 5;
+	return tStealRandom;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+// Constructor - starts the worker threads. Pass 0 to use one thread per hardware core
+ThreadPool::ThreadPool(unsigned int numThreads)
+	: mMainThread(std::this_thread::get_id()), mSleeping(0), mWaiting(0), mQueued(0), mMainQueued(0), mUnfinished(0),
+	  mStopping(false), mStatsStart(ClockNanoseconds())
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::thread::hardware_concurrency();
+		if (numThreads == 0)  numThreads = 1;
+	}
+
+	// Main thread, workers, then threads outside the pool
+	for (unsigned int i = 0; i < numThreads + 1; ++i)
+	{
+		mThreads.push_back(std::make_unique<ThreadData>());
+	}
+
+	for (unsigned int i = 1; i < numThreads; ++i)
+	{
+		mWorkers.push_back(std::thread(&ThreadPool::WorkerThread, this, static_cast<int>(i)));
+	}
+}
+
+// Destructor - runs any tasks still queued then stops the workers
+ThreadPool::~ThreadPool()
+{
+	WaitAll();
+
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Parallel for
+//--------------------------------------------------------------------------------------
+
+// Run function(begin, end) over the range 0->count, split into chunks of up to grainSize items
+void ThreadPool::ParallelFor(int count, int grainSize, const std::function<void(int, int)>& function)
+{
+	if (count <= 0)  return;
+	if (grainSize < 1)  grainSize = 1;
+
+	// Not worth involving the workers when there are none
+	if (mWorkers.empty())  grainSize = count;
+
+	ParallelForJob job;
+	job.function  = &function;
+	job.grainSize = grainSize;
+	job.remaining = count;
+
+	// Calling thread works on the first piece, queueing the rest for other threads
+	int64_t start = (tRunDepth++ == 0) ? ClockNanoseconds() : -1;
+	RunRange(&job, 0, count);
+	--tRunDepth;
+	ThreadData& thread = *mThreads[CurrentThreadIndex()];
+	thread.tasksRun.fetch_add(1, std::memory_order_relaxed);
+	if (start >= 0)  thread.busyNanoseconds.fetch_add(ClockNanoseconds() - start, std::memory_order_relaxed);
+
+	// Help with the queued pieces until every one is done so the job and function can safely go out of scope
+	WaitUntil([&job] { return job.remaining.load() == 0; });
+}
+
+
+// Run part of a ParallelFor, queueing halves of the range for other threads until it is no larger than the grain size
+void ThreadPool::RunRange(ParallelForJob* job, int begin, int end)
+{
+	while (end - begin > job->grainSize)
+	{
+		// Split on a multiple of the grain size so every piece but the last is exactly one grain
+		int chunks = (end - begin + job->grainSize - 1) / job->grainSize;
+		int middle = begin + (chunks / 2) * job->grainSize;
+		Submit([this, job, middle, end] { RunRange(job, middle, end); });
+		end = middle;
+	}
+
+	(*job->function)(begin, end);
+
+	// The job may be gone as soon as remaining reaches 0, so this must be the last use of it
+	job->remaining.fetch_sub(end - begin);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Tasks
+//--------------------------------------------------------------------------------------
+
+// Queue a function to run once all of the given tasks have finished
+TaskHandle ThreadPool::Submit(std::function<void()> function, const std::vector<TaskHandle>& dependencies /*= {}*/,
+                              TaskAffinity affinity /*= TaskAffinity::AnyThread*/)
+{
+	TaskHandle task = std::make_shared<ThreadPoolTask>();
+	task->function = std::move(function);
+	task->affinity = affinity;
+	task->unfinishedDependencies = 1; // Stops the task being queued by a dependency finishing during this loop
+	task->done = false;
+	++mUnfinished;
+
+	for (auto& dependency : dependencies)
+	{
+		if (dependency == nullptr)  continue;
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->done)
+		{
+			++task->unfinishedDependencies;
+			dependency->dependents.push_back(task);
+		}
+	}
+
+	if (--task->unfinishedDependencies == 0)  Schedule(task);
+	return task;
+}
+
+
+// True once a task has finished running
+bool ThreadPool::IsDone(const TaskHandle& task) const
+{
+	return task == nullptr || task->done;
+}
+
+// Wait for a task to finish, running other queued tasks meanwhile
+void ThreadPool::Wait(const TaskHandle& task)
+{
+	if (task == nullptr)  return;
+	WaitUntil([&task] { return task->done.load(); });
+}
+
+// Wait for every task submitted so far to finish, running queued tasks meanwhile
+void ThreadPool::WaitAll()
+{
+	WaitUntil([this] { return mUnfinished.load() == 0; });
+}
+
+
+// Run the MainThread tasks that are ready. Does nothing on other threads
+void ThreadPool::RunMainThreadTasks()
+{
+	if (!IsMainThread())  return;
+
+	ThreadData& mainThread = *mThreads[0];
+	while (mMainQueued > 0)
+	{
+		TaskHandle task;
+		{
+			std::lock_guard<std::mutex> lock(mainThread.mutex);
+			if (mainThread.mainThreadTasks.empty())  return;
+			task = std::move(mainThread.mainThreadTasks.front());
+			mainThread.mainThreadTasks.pop_front();
+		}
+		--mMainQueued;
+		RunTask(task, 0, false);
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Scheduling
+//--------------------------------------------------------------------------------------
+
+// Index of the calling thread in mThreads, the last entry for threads outside the pool
+int ThreadPool::CurrentThreadIndex() const
+{
+	if (tWorkerPool == this)  return tWorkerIndex;
+	if (IsMainThread())       return 0;
+	return static_cast<int>(mThreads.size()) - 1;
+}
+
+
+// Add a task whose dependencies have all finished to a queue
+void ThreadPool::Schedule(const TaskHandle& task)
+{
+	if (task->affinity == TaskAffinity::MainThread)
+	{
+		ThreadData& mainThread = *mThreads[0];
+		{
+			std::lock_guard<std::mutex> lock(mainThread.mutex);
+			mainThread.mainThreadTasks.push_back(task);
+		}
+		++mMainQueued;
+		WakeThreads(true); // Only the main thread can run it, so make sure it wakes
+		return;
+	}
+
+	// Threads outside the pool share the last queue
+	ThreadData& thread = *mThreads[CurrentThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(thread.mutex);
+		thread.tasks.push_back(task);
+	}
+	++mQueued;
+	WakeThreads(false);
+}
+
+
+// Find a task the given thread can run. Returns false if there are none
+bool ThreadPool::FindTask(int threadIndex, TaskHandle& task, bool& stolen)
+{
+	const int sharedIndex = static_cast<int>(mThreads.size()) - 1;
+	stolen = false;
+
+	// Own newest task
+	if (threadIndex != sharedIndex && mQueued > 0)
+	{
+		ThreadData& thread = *mThreads[threadIndex];
+		std::lock_guard<std::mutex> lock(thread.mutex);
+		if (!thread.tasks.empty())
+		{
+			task = std::move(thread.tasks.back());
+			thread.tasks.pop_back();
+			--mQueued;
+			return true;
+		}
+	}
+
+	// Tasks only the main thread can run
+	if (threadIndex == 0 && mMainQueued > 0)
+	{
+		ThreadData& thread = *mThreads[0];
+		std::lock_guard<std::mutex> lock(thread.mutex);
+		if (!thread.mainThreadTasks.empty())
+		{
+			task = std::move(thread.mainThreadTasks.front());
+			thread.mainThreadTasks.pop_front();
+			--mMainQueued;
+			return true;
+		}
+	}
+
+	// Oldest task from the shared queue, then from the other threads starting from a random one
+	if (mQueued > 0)
+	{
+		const int numThreads = static_cast<int>(mThreads.size());
+		const int start = static_cast<int>(NextStealRandom() % (numThreads - 1));
+		for (int i = -1; i < numThreads - 1; ++i)
+		{
+			int victim = (i < 0) ? sharedIndex : (start + i) % (numThreads - 1);
+			if (victim == threadIndex && victim != sharedIndex)  continue;
+
+			ThreadData& thread = *mThreads[victim];
+			std::lock_guard<std::mutex> lock(thread.mutex);
+			if (!thread.tasks.empty())
+			{
+				task = std::move(thread.tasks.front());
+				thread.tasks.pop_front();
+				--mQueued;
+				stolen = (victim != sharedIndex);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+// Run a task on the given thread and queue anything waiting for it
+void ThreadPool::RunTask(const TaskHandle& task, int threadIndex, bool stolen)
+{
+	int64_t start = (tRunDepth++ == 0) ? ClockNanoseconds() : -1;
+	task->function();
+	task->function = nullptr; // Release anything the function captured
+	--tRunDepth;
+
+	ThreadData& thread = *mThreads[threadIndex];
+	thread.tasksRun.fetch_add(1, std::memory_order_relaxed);
+	if (stolen)  thread.tasksStolen.fetch_add(1, std::memory_order_relaxed);
+	if (start >= 0)  thread.busyNanoseconds.fetch_add(ClockNanoseconds() - start, std::memory_order_relaxed);
+
+	std::vector<TaskHandle> dependents;
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		task->done = true;
+		dependents.swap(task->dependents);
+	}
+	for (auto& dependent : dependents)
+	{
+		if (--dependent->unfinishedDependencies == 0)  Schedule(dependent);
+	}
+
+	--mUnfinished;
+	if (mWaiting > 0)  WakeThreads(true); // Let waiting threads check if what they are waiting for is done
+}
+
+
+// Wake sleeping threads after queueing tasks or finishing one
+void ThreadPool::WakeThreads(bool all)
+{
+	// A thread going to sleep counts itself in mSleeping before checking for work, under the mutex. So either it sees
+	// the new work, or it is counted here and locking the mutex waits until it is asleep and can be woken
+	if (mSleeping == 0)  return;
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+	}
+	if (all)  mWake.notify_all();
+	else      mWake.notify_one();
+}
+
+
+// Run queued tasks until finished returns true, sleeping when there are none
+void ThreadPool::WaitUntil(const std::function<bool()>& finished)
+{
+	const int threadIndex = CurrentThreadIndex();
+	while (!finished())
+	{
+		TaskHandle task;
+		bool stolen;
+		if (FindTask(threadIndex, task, stolen))
+		{
+			RunTask(task, threadIndex, stolen);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		++mSleeping;
+		++mWaiting;
+		mWake.wait(lock, [&] { return finished() || mQueued > 0 || (threadIndex == 0 && mMainQueued > 0); });
+		--mWaiting;
+		--mSleeping;
+	}
+}
+
+
+// Worker thread loop
+void ThreadPool::WorkerThread(int index)
+{
+	tWorkerPool = this;
+	tWorkerIndex = index;
+
+	while (true)
+	{
+		TaskHandle task;
+		bool stolen;
+		if (FindTask(index, task, stolen))
+		{
+			RunTask(task, index, stolen);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mWakeMutex);
+		++mSleeping;
+		mWake.wait(lock, [this] { return mStopping || mQueued > 0; });
+		--mSleeping;
+		if (mStopping && mQueued == 0)  return;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Statistics
+//--------------------------------------------------------------------------------------
+
+// Work done by each thread: the main thread, the workers, then all threads outside the pool
+std::vector<ThreadPoolThreadStats> ThreadPool::ThreadStats() const
+{
+	double elapsed = NanosecondsToSeconds(ClockNanoseconds() - mStatsStart);
+
+	std::vector<ThreadPoolThreadStats> stats;
+	for (auto& thread : mThreads)
+	{
+		ThreadPoolThreadStats threadStats;
+		threadStats.tasksRun    = thread->tasksRun;
+		threadStats.tasksStolen = thread->tasksStolen;
+		threadStats.busySeconds = NanosecondsToSeconds(thread->busyNanoseconds);
+		threadStats.utilisation = (elapsed > 0) ? threadStats.busySeconds / elapsed : 0.0;
+		stats.push_back(threadStats);
+	}
+	return stats;
+}
+
+// Restart the counts and times from now
+void ThreadPool::ResetStats()
+{
+	for (auto& thread : mThreads)
+	{
+		thread->tasksRun = 0;
+		thread->tasksStolen = 0;
+		thread->busyNanoseconds = 0;
+	}
+	mStatsStart = ClockNanoseconds();
+}
+
+
+// A table of the ThreadStats
+std::string ThreadPool::StatsReport() const
+{
+	std::vector<ThreadPoolThreadStats> stats = ThreadStats();
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1);
+	out << std::left << std::setw(10) << "Thread" << std::right << std::setw(12) << "Tasks" << std::setw(12) << "Stolen"
+	    << std::setw(12) << "Busy ms" << std::setw(8) << "Use %" << "\n";
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		std::string name = (i == 0) ? "Main" : (i + 1 == stats.size()) ? "Other" : "Worker " + std::to_string(i);
+		out << std::left << std::setw(10) << name << std::right << std::setw(12) << stats[i].tasksRun
+		    << std::setw(12) << stats[i].tasksStolen << std::setw(12) << stats[i].busySeconds * 1000
+		    << std::setw(8) << stats[i].utilisation * 100 << "\n";
+	}
+	return out.str();
+}
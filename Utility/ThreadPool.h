@@ -0,0 +1,187 @@
+//--------------------------------------------------------------------------------------
+// Thread pool - work-stealing task scheduler that splits work across all cores
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+//
+// Each thread in the pool has its own queue of tasks. A thread adds the tasks it creates to the back of its own queue
+// and takes its next task from the back too, so it works on the most recent (and most likely cached) work. A thread
+// that runs out of tasks steals from the front of another thread's queue, where the oldest and usually largest pieces
+// of work are. Threads outside the pool add tasks to a shared queue that all the pool threads take from.
+//
+// ParallelFor splits its range in half repeatedly, queueing one half and carrying on with the other, until pieces are
+// no bigger than the grain size. Idle threads steal the large halves first so the work spreads out quickly, and a
+// thread that finishes early steals more rather than waiting, so uneven work still balances.
+//
+// Tasks can depend on other tasks - a task is only queued once all of its dependencies have finished, so chains and
+// graphs of work (continuations) need no waiting in between. Tasks marked MainThread only run on the thread that created
+// the pool, e.g. for Direct3D device context calls, either in RunMainThreadTasks or while that thread waits.
+//
+// A thread waiting for a task or ParallelFor runs other queued tasks until it is done, so tasks can safely wait for
+// other tasks and nested ParallelFor calls share the same threads.
+//
+// Each thread counts the tasks it runs, how many it stole and how long it was busy, see ThreadStats
+
+#ifndef _THREAD_POOL_H_INCLUDED_
+#define _THREAD_POOL_H_INCLUDED_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+// Which threads can run a task
+enum class TaskAffinity
+{
+	AnyThread,  // Any thread in the pool
+	MainThread, // Only the thread that created the pool
+};
+
+// A task submitted to a thread pool, used to wait for it or make other tasks depend on it
+struct ThreadPoolTask;
+using TaskHandle = std::shared_ptr<ThreadPoolTask>;
+
+
+// Work done by one thread since the pool was created or the stats were reset
+struct ThreadPoolThreadStats
+{
+	uint64_t tasksRun;    // Including ParallelFor pieces
+	uint64_t tasksStolen; // Tasks taken from another thread's queue
+	double   busySeconds; // Time spent running tasks
+	double   utilisation; // Fraction of the time since the stats were reset spent running tasks
+};
+
+
+class ThreadPool
+{
+public:
+	// Constructor - starts the worker threads. Pass 0 to use one thread per hardware core
+	// The calling thread also works during ParallelFor, so numThreads - 1 workers are created
+	ThreadPool(unsigned int numThreads = 0);
+
+	// Destructor - runs any tasks still queued then stops the workers. Destroy the pool on the thread that created it
+	// so that any MainThread tasks can still run
+	~ThreadPool();
+
+	// Prevent copying, the workers refer back to this object
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+
+	// Number of threads that take part in ParallelFor, including the calling thread
+	unsigned int NumThreads() const { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+
+	// True if called on the thread that created the pool
+	bool IsMainThread() const { return std::this_thread::get_id() == mMainThread; }
+
+
+	//-------------------------------------
+	// Parallel for
+	//-------------------------------------
+
+	// Run function(begin, end) over the range 0->count, split into chunks of up to grainSize items
+	// Chunks are shared between the workers and the calling thread, the function returns when all are complete.
+	// Can be called from any thread, including from inside tasks and other ParallelFor calls
+	void ParallelFor(int count, int grainSize, const std::function<void(int, int)>& function);
+
+
+	//-------------------------------------
+	// Tasks
+	//-------------------------------------
+
+	// Queue a function to run once all of the given tasks have finished. Can be called from any thread
+	TaskHandle Submit(std::function<void()> function, const std::vector<TaskHandle>& dependencies = {},
+	                  TaskAffinity affinity = TaskAffinity::AnyThread);
+
+	// Queue a function to run when the given task has finished (a continuation)
+	TaskHandle Then(const TaskHandle& task, std::function<void()> function, TaskAffinity affinity = TaskAffinity::AnyThread)
+	{
+		return Submit(std::move(function), { task }, affinity);
+	}
+
+	// True once a task has finished running
+	bool IsDone(const TaskHandle& task) const;
+
+	// Wait for a task to finish, running other queued tasks meanwhile
+	void Wait(const TaskHandle& task);
+
+	// Wait for every task submitted so far to finish, running queued tasks meanwhile. Not from inside a task, which
+	// would wait for itself
+	void WaitAll();
+
+	// Run the MainThread tasks that are ready. Call regularly from the main thread, e.g. once a frame. Does nothing on
+	// other threads
+	void RunMainThreadTasks();
+
+
+	//-------------------------------------
+	// Statistics
+	//-------------------------------------
+
+	// Work done by each thread: the thread that created the pool first, then the workers, then one entry for all
+	// threads outside the pool that ran tasks while waiting
+	std::vector<ThreadPoolThreadStats> ThreadStats() const;
+
+	// Restart the counts and times from now
+	void ResetStats();
+
+	// A table of the ThreadStats
+	std::string StatsReport() const;
+
+
+private:
+	struct ParallelForJob;
+	struct ThreadData;
+
+	// Worker thread loop, index is the worker's position in mThreads
+	void WorkerThread(int index);
+
+	// Index of the calling thread in mThreads, the last entry for threads outside the pool
+	int CurrentThreadIndex() const;
+
+	// Add a task whose dependencies have all finished to a queue
+	void Schedule(const TaskHandle& task);
+
+	// Find a task the given thread can run: its own newest task, then a MainThread task if it is the main thread, then
+	// the shared queue, then the oldest task of another thread. Returns false if there are none
+	bool FindTask(int threadIndex, TaskHandle& task, bool& stolen);
+
+	// Run a task on the given thread and queue anything waiting for it
+	void RunTask(const TaskHandle& task, int threadIndex, bool stolen);
+
+	// Run queued tasks until finished returns true, sleeping when there are none
+	void WaitUntil(const std::function<bool()>& finished);
+
+	// Run part of a ParallelFor, queueing halves of the range for other threads until it is no larger than the grain size
+	void RunRange(ParallelForJob* job, int begin, int end);
+
+	// Wake sleeping threads after queueing tasks or finishing one
+	void WakeThreads(bool all);
+
+
+	std::thread::id          mMainThread;
+	std::vector<std::thread> mWorkers;
+
+	// Queues and stats for the main thread, each worker, then threads outside the pool
+	std::vector<std::unique_ptr<ThreadData>> mThreads;
+
+	// Threads sleep here when there are no tasks they can run
+	std::mutex              mWakeMutex;
+	std::condition_variable mWake;
+	std::atomic<int>        mSleeping;    // Threads asleep or about to sleep
+	std::atomic<int>        mWaiting;     // Of those, threads waiting for something to finish rather than idle workers
+	std::atomic<int>        mQueued;      // Tasks in the queues that any thread can run
+	std::atomic<int>        mMainQueued;  // MainThread tasks queued
+	std::atomic<int>        mUnfinished;  // Tasks submitted and not finished
+	bool                    mStopping;
+
+	std::atomic<int64_t> mStatsStart; // ClockNanoseconds when the stats were reset
+};
+
+
+#endif //_THREAD_POOL_H_INCLUDED_
@@ -1,6 +1,7 @@
 //--------------------------------------------------------------------------------------
 // Timer class - works like a stopwatch
 //--------------------------------------------------------------------------------------
+// Uses the portable clock in Clock.h, so it also works outside Windows
 
 #ifndef _TIMER_H_INCLUDED_
 #define _TIMER_H_INCLUDED_
@@ -45,25 +46,12 @@ private:
 	// Is the timer running
 	bool mRunning;
 
+	// Start time and last lap start time, in nanoseconds from ClockNanoseconds
+	int64_t mStart;
+	int64_t mLap;
 
-	// Using high resolution timer and if so its frequency
-	bool     mHighRes;
-	uint64_t mHighResFreq;
-
-	// Start time and last lap start time of high-resolution timer
-	uint64_t mHighResStart;
-	uint64_t mHighResLap;
-
-	// Time when high-resolution timer was stopped (if it has been)
-	uint64_t mHighResStop;
-
-
-	// Start time and last lap start time of low-resolution timer
-	uint32_t mLowResStart;
-	uint32_t mLowResLap;
-
-	// Time when low-resolution timer was stopped (if it has been)
-	uint32_t mLowResStop;
+	// Time when the timer was stopped (if it has been)
+	int64_t mStop;
 };
 
 